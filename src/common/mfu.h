@@ -26,8 +26,16 @@ extern "C" {
 #include "mfu_io.h"
 #include "mfu_param_path.h"
 #include "mfu_flist.h"
+#include "mfu_itemmap.h"
+#include "mfu_digest.h"
+#include "mfu_sidecar.h"
+#include "mfu_digestcache.h"
+#include "mfu_blockhash.h"
+#include "mfu_dircache.h"
+#include "mfu_changes.h"
 #include "mfu_pred.h"
 #include "mfu_progress.h"
+#include "mfu_throttle.h"
 #include "mfu_bz2.h"
 
 #endif /* MFU_H */
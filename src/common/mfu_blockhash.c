@@ -0,0 +1,928 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "mfu.h"
+
+/* version of the sidecar file format */
+#define BLOCKHASH_VERSION (2)
+
+/* number of uint64 values in the file header:
+ * version, block size, number of files, bytes of file records */
+#define BLOCKHASH_HEADER_VALUES (4)
+
+/* The header is followed by a table with the offset of each file record
+ * from the start of the records, then by the records.  Each record starts
+ * with the values below, followed by the path padded to a multiple of 8
+ * bytes and by the digest of each block of the file, so that readers can
+ * split the table evenly and read whole records. */
+
+/* number of uint64 values at the start of each file record:
+ * size, mtime, mtime_nsec, ctime, ctime_nsec, bytes in path */
+#define BLOCKHASH_FILE_VALUES (6)
+
+/* number of uint64 values that start a lookup request, followed by the path:
+ * store, index, size, mtime, mtime_nsec, ctime, ctime_nsec, bytes in path */
+#define BLOCKHASH_REQUEST_VALUES (8)
+
+/* number of uint64 values in a lookup reply (store, index, block, digest)
+ * and in the result of hashing a block (index, block, success, digest) */
+#define BLOCKHASH_REPLY_VALUES (5)
+
+/*
+=========================================
+Allocate, query, and compare stores
+=========================================
+*/
+
+mfu_blockhash* mfu_blockhash_new(mfu_flist list, uint64_t block_size, mfu_digest_alg alg)
+{
+    mfu_blockhash* bh = (mfu_blockhash*) MFU_MALLOC(sizeof(mfu_blockhash));
+    bh->list       = list;
+    bh->block_size = block_size;
+    bh->alg        = alg;
+
+    /* lay out digests of all items back to back */
+    uint64_t size = mfu_flist_size(list);
+    bh->first = (uint64_t*) MFU_MALLOC(size * sizeof(uint64_t));
+    bh->found = (uint64_t*) MFU_MALLOC(size * sizeof(uint64_t));
+
+    uint64_t total = 0;
+    uint64_t idx;
+    for (idx = 0; idx < size; idx++) {
+        bh->first[idx] = total;
+        bh->found[idx] = 0;
+        total += mfu_blockhash_blocks(bh, idx);
+    }
+
+    bh->digests = (mfu_blockhash_digest*) MFU_MALLOC(total * sizeof(mfu_blockhash_digest));
+
+    return bh;
+}
+
+void mfu_blockhash_delete(mfu_blockhash** pbh)
+{
+    if (pbh != NULL) {
+        mfu_blockhash* bh = *pbh;
+        if (bh != NULL) {
+            mfu_free(&bh->digests);
+            mfu_free(&bh->found);
+            mfu_free(&bh->first);
+        }
+        mfu_free(pbh);
+    }
+}
+
+uint64_t mfu_blockhash_blocks(const mfu_blockhash* bh, uint64_t idx)
+{
+    mfu_filetype type = mfu_flist_file_get_type(bh->list, idx);
+    if (type != MFU_TYPE_FILE) {
+        return 0;
+    }
+
+    uint64_t size = mfu_flist_file_get_size(bh->list, idx);
+    uint64_t blocks = size / bh->block_size;
+    if (blocks * bh->block_size < size) {
+        blocks++;
+    }
+    return blocks;
+}
+
+int mfu_blockhash_valid(const mfu_blockhash* bh, uint64_t idx)
+{
+    return (bh->found[idx] == mfu_blockhash_blocks(bh, idx));
+}
+
+const mfu_blockhash_digest* mfu_blockhash_get(const mfu_blockhash* bh, uint64_t idx)
+{
+    if (! mfu_blockhash_valid(bh, idx)) {
+        return NULL;
+    }
+    return &bh->digests[bh->first[idx]];
+}
+
+void mfu_blockhash_clear(mfu_blockhash* bh, uint64_t idx)
+{
+    /* empty files remain valid, they have no blocks to hash */
+    bh->found[idx] = 0;
+}
+
+int mfu_blockhash_compare(
+    const mfu_blockhash* a, uint64_t ia,
+    const mfu_blockhash* b, uint64_t ib)
+{
+    if (! mfu_blockhash_valid(a, ia) || ! mfu_blockhash_valid(b, ib)) {
+        return -1;
+    }
+
+    /* files of different sizes differ, whatever their digests */
+    uint64_t size_a = mfu_flist_file_get_size(a->list, ia);
+    uint64_t size_b = mfu_flist_file_get_size(b->list, ib);
+    if (size_a != size_b || a->block_size != b->block_size) {
+        return 1;
+    }
+
+    uint64_t blocks = mfu_blockhash_blocks(a, ia);
+    const mfu_blockhash_digest* da = &a->digests[a->first[ia]];
+    const mfu_blockhash_digest* db = &b->digests[b->first[ib]];
+    if (memcmp(da, db, blocks * sizeof(mfu_blockhash_digest)) != 0) {
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+=========================================
+Exchange data between ranks
+=========================================
+*/
+
+/* rank that is responsible for records of the given path */
+static int blockhash_home(const char* name, int ranks)
+{
+    return (int) (mfu_hash_jenkins(name, strlen(name)) % (uint32_t) ranks);
+}
+
+/*
+=========================================
+Read digests from a sidecar file
+=========================================
+*/
+
+/* round bytes in a path up to a multiple of 8 */
+static uint64_t blockhash_padded(uint64_t len)
+{
+    return (len + 7) / 8 * 8;
+}
+
+/* a file record from the sidecar file, its values unpacked */
+typedef struct {
+    const char* name;
+    uint64_t values[BLOCKHASH_FILE_VALUES];
+    const char* digests;  /* packed digest of each block */
+} blockhash_record;
+
+/* parse the file record at the start of bytes bytes of buf, returns
+ * the number of bytes in the record, or 0 if it does not fit */
+static uint64_t blockhash_parse(const char* buf, uint64_t bytes, uint64_t block_size, blockhash_record* rec)
+{
+    uint64_t head = BLOCKHASH_FILE_VALUES * 8;
+    if (bytes < head) {
+        return 0;
+    }
+
+    const char* ptr = buf;
+    int k;
+    for (k = 0; k < BLOCKHASH_FILE_VALUES; k++) {
+        mfu_unpack_uint64(&ptr, &rec->values[k]);
+    }
+
+    uint64_t len = rec->values[5];
+    uint64_t blocks = (rec->values[0] + block_size - 1) / block_size;
+    if (len == 0 || len > bytes - head ||
+        blockhash_padded(len) > bytes - head ||
+        blocks > (bytes - head - blockhash_padded(len)) / (2 * 8))
+    {
+        return 0;
+    }
+
+    rec->name    = buf + head;
+    rec->digests = rec->name + blockhash_padded(len);
+    if (rec->name[len - 1] != '\0') {
+        return 0;
+    }
+
+    return head + blockhash_padded(len) + blocks * 2 * 8;
+}
+
+/* order records by name */
+static int blockhash_record_cmp(const void* a, const void* b)
+{
+    const blockhash_record* ra = (const blockhash_record*) a;
+    const blockhash_record* rb = (const blockhash_record*) b;
+    return strcmp(ra->name, rb->name);
+}
+
+int mfu_blockhash_read(const char* name, int count, mfu_blockhash** bhs)
+{
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* sidecar files only hold MurmurHash3 digests */
+    int i;
+    for (i = 0; i < count; i++) {
+        if (bhs[i]->alg != MFU_DIGEST_MURMUR3) {
+            if (rank == 0) {
+                MFU_LOG(MFU_LOG_ERR, "Block hash file `%s' can only record %s digests",
+                    name, mfu_digest_alg_name(MFU_DIGEST_MURMUR3));
+            }
+            return -1;
+        }
+    }
+
+    MPI_File fh;
+    uint64_t header[BLOCKHASH_HEADER_VALUES];
+    int rc = mfu_sidecar_open(name, "block hash file", BLOCKHASH_VERSION,
+        BLOCKHASH_HEADER_VALUES, header, &fh);
+    if (rc > 0) {
+        /* a missing file just means nothing has been recorded yet */
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_INFO, "Block hash file `%s' does not exist, hashing all files", name);
+        }
+        return 0;
+    }
+    if (rc < 0) {
+        return -1;
+    }
+
+    uint64_t block_size = header[1];
+    uint64_t all_files  = header[2];
+    uint64_t all_bytes  = header[3];
+
+    /* digests are only comparable if they cover the same blocks */
+    for (i = 0; i < count; i++) {
+        if (bhs[i]->block_size != block_size) {
+            if (rank == 0) {
+                MFU_LOG(MFU_LOG_WARN, "Ignoring block hash file `%s' written with block size %llu",
+                    name, (unsigned long long) block_size);
+            }
+            MPI_File_close(&fh);
+            return 0;
+        }
+    }
+
+    /* read offsets of our portion of the file records, along with the
+     * offset of the record that follows our last one to know where they end */
+    uint64_t start;
+    uint64_t file_count = mfu_sidecar_split(all_files, &start);
+    uint64_t entries = file_count;
+    if (file_count > 0 && start + file_count < all_files) {
+        entries++;
+    }
+    char* table = (char*) MFU_MALLOC(entries * 8 + 1);
+    MPI_Offset table_offset = (MPI_Offset) (BLOCKHASH_HEADER_VALUES * 8);
+    mfu_sidecar_read(name, fh, table_offset + (MPI_Offset) (start * 8), table, entries * 8);
+
+    uint64_t first = 0;
+    uint64_t end   = 0;
+    if (file_count > 0) {
+        const char* ptr = table;
+        mfu_unpack_uint64(&ptr, &first);
+        end = all_bytes;
+        if (entries > file_count) {
+            ptr = table + file_count * 8;
+            mfu_unpack_uint64(&ptr, &end);
+        }
+    }
+    mfu_free(&table);
+    if (end < first || end > all_bytes) {
+        MFU_ABORT(1, "Invalid record offsets in block hash file `%s'", name);
+    }
+
+    /* read our file records */
+    uint64_t read_bytes = end - first;
+    char* readbuf = (char*) MFU_MALLOC(read_bytes + 1);
+    MPI_Offset records_offset = table_offset + (MPI_Offset) (all_files * 8);
+    mfu_sidecar_read(name, fh, records_offset + (MPI_Offset) first, readbuf, read_bytes);
+
+    MPI_File_close(&fh);
+
+    int* sendcounts = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* recvcounts = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* homes      = (int*) MFU_MALLOC(file_count * sizeof(int) + 1);
+    uint64_t* sizes = (uint64_t*) MFU_MALLOC(file_count * sizeof(uint64_t) + 1);
+    int* offsets    = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+
+    /* send each record to the rank responsible for its path */
+    uint64_t r;
+    int j;
+    for (j = 0; j < ranks; j++) {
+        sendcounts[j] = 0;
+    }
+    uint64_t pos = 0;
+    for (r = 0; r < file_count; r++) {
+        blockhash_record rec;
+        sizes[r] = blockhash_parse(readbuf + pos, read_bytes - pos, block_size, &rec);
+        if (sizes[r] == 0) {
+            MFU_ABORT(1, "Invalid file record in block hash file `%s'", name);
+        }
+        homes[r] = blockhash_home(rec.name, ranks);
+        sendcounts[homes[r]] += (int) sizes[r];
+        pos += sizes[r];
+    }
+
+    int disp = 0;
+    for (j = 0; j < ranks; j++) {
+        offsets[j] = disp;
+        disp += sendcounts[j];
+    }
+
+    char* sendbuf = (char*) MFU_MALLOC(read_bytes + 1);
+    pos = 0;
+    for (r = 0; r < file_count; r++) {
+        memcpy(sendbuf + offsets[homes[r]], readbuf + pos, sizes[r]);
+        offsets[homes[r]] += (int) sizes[r];
+        pos += sizes[r];
+    }
+    mfu_free(&readbuf);
+    mfu_free(&sizes);
+    mfu_free(&homes);
+
+    char* recbuf = mfu_sidecar_alltoallv(sendbuf, sendcounts, recvcounts);
+    mfu_free(&sendbuf);
+
+    /* index and sort the records we are responsible for */
+    uint64_t rec_bytes = 0;
+    for (j = 0; j < ranks; j++) {
+        rec_bytes += (uint64_t) recvcounts[j];
+    }
+    uint64_t rec_count = 0;
+    uint64_t rec_cap = 16;
+    blockhash_record* records = (blockhash_record*) MFU_MALLOC(rec_cap * sizeof(blockhash_record));
+    pos = 0;
+    while (pos < rec_bytes) {
+        if (rec_count == rec_cap) {
+            rec_cap *= 2;
+            blockhash_record* grown = (blockhash_record*) MFU_MALLOC(rec_cap * sizeof(blockhash_record));
+            memcpy(grown, records, rec_count * sizeof(blockhash_record));
+            mfu_free(&records);
+            records = grown;
+        }
+        uint64_t bytes = blockhash_parse(recbuf + pos, rec_bytes - pos, block_size, &records[rec_count]);
+        if (bytes == 0) {
+            MFU_ABORT(1, "Invalid file record received for block hash file `%s'", name);
+        }
+        pos += bytes;
+        rec_count++;
+    }
+    qsort(records, rec_count, sizeof(blockhash_record), blockhash_record_cmp);
+
+    /* send a lookup request for each file to the rank responsible for its path */
+    size_t req_head = BLOCKHASH_REQUEST_VALUES * 8;
+    for (j = 0; j < ranks; j++) {
+        sendcounts[j] = 0;
+    }
+    uint64_t req_bytes = 0;
+    for (i = 0; i < count; i++) {
+        mfu_blockhash* bh = bhs[i];
+        if (! mfu_flist_have_detail(bh->list)) {
+            continue;
+        }
+        uint64_t size = mfu_flist_size(bh->list);
+        uint64_t idx;
+        for (idx = 0; idx < size; idx++) {
+            const char* file = mfu_flist_file_get_name(bh->list, idx);
+            if (mfu_blockhash_blocks(bh, idx) > 0) {
+                uint64_t bytes = req_head + blockhash_padded(strlen(file) + 1);
+                sendcounts[blockhash_home(file, ranks)] += (int) bytes;
+                req_bytes += bytes;
+            }
+        }
+    }
+
+    disp = 0;
+    for (j = 0; j < ranks; j++) {
+        offsets[j] = disp;
+        disp += sendcounts[j];
+    }
+
+    sendbuf = (char*) MFU_MALLOC(req_bytes + 1);
+    for (i = 0; i < count; i++) {
+        mfu_blockhash* bh = bhs[i];
+        if (! mfu_flist_have_detail(bh->list)) {
+            continue;
+        }
+        uint64_t size = mfu_flist_size(bh->list);
+        uint64_t idx;
+        for (idx = 0; idx < size; idx++) {
+            const char* file = mfu_flist_file_get_name(bh->list, idx);
+            if (mfu_blockhash_blocks(bh, idx) > 0) {
+                int home = blockhash_home(file, ranks);
+                uint64_t len = (uint64_t) strlen(file) + 1;
+                char* ptr = sendbuf + offsets[home];
+                mfu_pack_uint64(&ptr, (uint64_t) i);
+                mfu_pack_uint64(&ptr, idx);
+                mfu_pack_uint64(&ptr, mfu_flist_file_get_size(bh->list, idx));
+                mfu_pack_uint64(&ptr, mfu_flist_file_get_mtime(bh->list, idx));
+                mfu_pack_uint64(&ptr, mfu_flist_file_get_mtime_nsec(bh->list, idx));
+                mfu_pack_uint64(&ptr, mfu_flist_file_get_ctime(bh->list, idx));
+                mfu_pack_uint64(&ptr, mfu_flist_file_get_ctime_nsec(bh->list, idx));
+                mfu_pack_uint64(&ptr, len);
+                memset(ptr, 0, blockhash_padded(len));
+                memcpy(ptr, file, len);
+                offsets[home] += (int) (req_head + blockhash_padded(len));
+            }
+        }
+    }
+
+    char* reqbuf = mfu_sidecar_alltoallv(sendbuf, sendcounts, recvcounts);
+    mfu_free(&sendbuf);
+
+    /* find the record for each request whose metadata still matches,
+     * and count replies for each requesting rank */
+    size_t reply_size = BLOCKHASH_REPLY_VALUES * sizeof(uint64_t);
+    uint64_t* replies = NULL;
+    uint64_t reply_count = 0;
+    uint64_t reply_cap = 0;
+
+    const char* reqptr = reqbuf;
+    for (j = 0; j < ranks; j++) {
+        sendcounts[j] = 0;
+        const char* reqend = reqptr + recvcounts[j];
+        while (reqptr < reqend) {
+            const char* ptr = reqptr;
+            uint64_t values[BLOCKHASH_REQUEST_VALUES];
+            int k;
+            for (k = 0; k < BLOCKHASH_REQUEST_VALUES; k++) {
+                mfu_unpack_uint64(&ptr, &values[k]);
+            }
+            const char* file = ptr;
+            reqptr += req_head + blockhash_padded(values[7]);
+
+            /* binary search for first record of this path */
+            uint64_t lo = 0;
+            uint64_t hi = rec_count;
+            while (lo < hi) {
+                uint64_t mid = lo + (hi - lo) / 2;
+                if (strcmp(records[mid].name, file) < 0) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+
+            /* reply with each block of the first record of this path
+             * that has the current metadata, the same path may be
+             * recorded more than once */
+            for (r = lo; r < rec_count && strcmp(records[r].name, file) == 0; r++) {
+                const uint64_t* rv = records[r].values;
+                if (rv[0] != values[2] ||
+                    rv[1] != values[3] || rv[2] != values[4] ||
+                    rv[3] != values[5] || rv[4] != values[6])
+                {
+                    continue;
+                }
+
+                uint64_t blocks = (rv[0] + block_size - 1) / block_size;
+                if (reply_count + blocks > reply_cap) {
+                    reply_cap = reply_cap * 2 + blocks + 16;
+                    uint64_t* grown = (uint64_t*) MFU_MALLOC(reply_cap * reply_size);
+                    if (reply_count > 0) {
+                        memcpy(grown, replies, reply_count * reply_size);
+                    }
+                    mfu_free(&replies);
+                    replies = grown;
+                }
+
+                const char* dptr = records[r].digests;
+                uint64_t block;
+                for (block = 0; block < blocks; block++) {
+                    uint64_t* reply = replies + reply_count * BLOCKHASH_REPLY_VALUES;
+                    reply[0] = values[0];
+                    reply[1] = values[1];
+                    reply[2] = block;
+                    mfu_unpack_uint64(&dptr, &reply[3]);
+                    mfu_unpack_uint64(&dptr, &reply[4]);
+                    reply_count++;
+                }
+                sendcounts[j] += (int) (blocks * reply_size);
+                break;
+            }
+        }
+    }
+    mfu_free(&reqbuf);
+    mfu_free(&records);
+    mfu_free(&recbuf);
+
+    /* replies were generated in order of requesting rank */
+    char* replybuf = mfu_sidecar_alltoallv((const char*)replies, sendcounts, recvcounts);
+    mfu_free(&replies);
+
+    /* record digests we got back */
+    uint64_t received = 0;
+    for (j = 0; j < ranks; j++) {
+        received += (uint64_t) recvcounts[j] / reply_size;
+    }
+    const uint64_t* reply = (const uint64_t*) replybuf;
+    for (r = 0; r < received; r++) {
+        mfu_blockhash* bh = bhs[reply[0]];
+        uint64_t idx = reply[1];
+        bh->digests[bh->first[idx] + reply[2]].h[0] = reply[3];
+        bh->digests[bh->first[idx] + reply[2]].h[1] = reply[4];
+        bh->found[idx]++;
+        reply += BLOCKHASH_REPLY_VALUES;
+    }
+    mfu_free(&replybuf);
+
+    mfu_free(&offsets);
+    mfu_free(&recvcounts);
+    mfu_free(&sendcounts);
+
+    /* report how many files we can skip */
+    uint64_t counts[2] = {0, 0};
+    for (i = 0; i < count; i++) {
+        mfu_blockhash* bh = bhs[i];
+        uint64_t size = mfu_flist_size(bh->list);
+        uint64_t idx;
+        for (idx = 0; idx < size; idx++) {
+            if (mfu_blockhash_blocks(bh, idx) > 0) {
+                counts[0] += (uint64_t) mfu_blockhash_valid(bh, idx);
+                counts[1]++;
+            }
+        }
+    }
+    uint64_t all_counts[2];
+    MPI_Allreduce(counts, all_counts, 2, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Read block hashes for %llu of %llu files from `%s'",
+            (unsigned long long) all_counts[0], (unsigned long long) all_counts[1], name);
+    }
+
+    return 0;
+}
+
+/*
+=========================================
+Hash file data
+=========================================
+*/
+
+/* hash length bytes of file starting at offset, which is the start
+ * of a block, storing a digest for each block of block_size bytes,
+ * returns 0 on success */
+static int blockhash_file(
+    const char* name,
+    uint64_t offset,
+    uint64_t length,
+    uint64_t block_size,
+    mfu_digest_alg alg,
+    void* buf,
+    size_t bufsize,
+    mfu_blockhash_digest* digests,
+    uint64_t* bytes_read,
+    mfu_progress* prg)
+{
+    /* avoid updating atime, which tools like dsync copy to the other
+     * side and which would then change its ctime on every run,
+     * O_NOATIME is only allowed for the owner of the file */
+    int fd = -1;
+#ifdef O_NOATIME
+    fd = mfu_open(name, O_RDONLY | O_NOATIME);
+    if (fd < 0 && errno == EPERM) {
+        fd = mfu_open(name, O_RDONLY);
+    }
+#else
+    fd = mfu_open(name, O_RDONLY);
+#endif
+    if (fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open `%s' (errno=%d %s)",
+            name, errno, strerror(errno));
+        return -1;
+    }
+
+    /* hint that we'll read from file sequentially */
+    posix_fadvise(fd, (off_t)offset, (off_t)length, POSIX_FADV_SEQUENTIAL);
+
+    if (mfu_lseek(name, fd, (off_t)offset, SEEK_SET) == (off_t)-1) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to lseek `%s', offset: %llx (errno=%d %s)",
+            name, (unsigned long long)offset, errno, strerror(errno));
+        mfu_close(name, fd);
+        return -1;
+    }
+
+    int rc = 0;
+    mfu_digest_ctx ctx;
+    mfu_digest_init(&ctx, alg);
+
+    uint64_t total = 0;
+    uint64_t block = 0;
+    uint64_t in_block = 0;
+    while (total < length) {
+        /* don't read past the end of the current block */
+        uint64_t left = length - total;
+        if (left > block_size - in_block) {
+            left = block_size - in_block;
+        }
+        if (left > (uint64_t)bufsize) {
+            left = (uint64_t)bufsize;
+        }
+
+        ssize_t nread = mfu_read(name, fd, buf, (size_t)left);
+        if (nread < 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to read `%s' at offset %llx (errno=%d %s)",
+                name, (unsigned long long)(offset + total), errno, strerror(errno));
+            rc = -1;
+            break;
+        }
+        if (nread == 0) {
+            /* file is shorter than the list says, it must have changed */
+            MFU_LOG(MFU_LOG_ERR, "Unexpected end of file `%s' at offset %llx",
+                name, (unsigned long long)(offset + total));
+            rc = -1;
+            break;
+        }
+
+        mfu_digest_update(&ctx, buf, (size_t)nread);
+        total    += (uint64_t)nread;
+        in_block += (uint64_t)nread;
+
+        /* finish the digest at the end of each block */
+        if (in_block == block_size || total == length) {
+            mfu_digest_final(&ctx, &digests[block]);
+            mfu_digest_init(&ctx, alg);
+            block++;
+            in_block = 0;
+        }
+
+        /* update number of bytes read for progress messages */
+        *bytes_read += (uint64_t)nread;
+        uint64_t count_bytes[2];
+        count_bytes[0] = *bytes_read;
+        count_bytes[1] = 0;
+        mfu_progress_update(count_bytes, prg);
+    }
+
+    mfu_close(name, fd);
+
+    return rc;
+}
+
+int mfu_blockhash_compute(
+    mfu_blockhash* bh,
+    size_t bufsize,
+    uint64_t* bytes_read,
+    mfu_progress* prg)
+{
+    int rc = 0;
+
+    int ranks;
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* gather files that lack digests into a new list,
+     * remembering the index of each in our list */
+    uint64_t size = mfu_flist_size(bh->list);
+    uint64_t* todo_index = (uint64_t*) MFU_MALLOC(size * sizeof(uint64_t));
+    uint64_t todo_count = 0;
+    mfu_flist todo = mfu_flist_subset(bh->list);
+    uint64_t idx;
+    for (idx = 0; idx < size; idx++) {
+        if (mfu_blockhash_blocks(bh, idx) > 0 && ! mfu_blockhash_valid(bh, idx)) {
+            bh->found[idx] = 0;
+            mfu_flist_file_copy(bh->list, idx, todo);
+            todo_index[todo_count] = idx;
+            todo_count++;
+        }
+    }
+    mfu_flist_summarize(todo);
+
+    /* spread blocks evenly over ranks */
+    mfu_file_chunk* head = mfu_file_chunk_list_alloc(todo, bh->block_size);
+    uint64_t chunk_count = mfu_file_chunk_list_size(head);
+
+    /* count blocks in our sections, a section may hold
+     * several consecutive blocks of the same file */
+    uint64_t block_count = 0;
+    uint64_t i;
+    const mfu_file_chunk* p = head;
+    for (i = 0; i < chunk_count; i++) {
+        block_count += (p->length + bh->block_size - 1) / bh->block_size;
+        p = p->next;
+    }
+
+    /* hash each section, recording results to send to the owner of its file */
+    int* sendcounts = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* recvcounts = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* offsets    = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int j;
+    for (j = 0; j < ranks; j++) {
+        sendcounts[j] = 0;
+    }
+
+    size_t result_size = BLOCKHASH_REPLY_VALUES * sizeof(uint64_t);
+    uint64_t* results = (uint64_t*) MFU_MALLOC(block_count * result_size);
+    int* owners = (int*) MFU_MALLOC(block_count * sizeof(int));
+    mfu_blockhash_digest* digests = (mfu_blockhash_digest*) MFU_MALLOC(
+        block_count * sizeof(mfu_blockhash_digest));
+    void* buf = MFU_MALLOC(bufsize);
+
+    uint64_t b = 0;
+    p = head;
+    for (i = 0; i < chunk_count; i++) {
+        uint64_t blocks = (p->length + bh->block_size - 1) / bh->block_size;
+        int hash_rc = blockhash_file(p->name, p->offset, p->length, bh->block_size,
+            bh->alg, buf, bufsize, &digests[b], bytes_read, prg);
+        if (hash_rc != 0) {
+            rc = -1;
+        }
+
+        uint64_t k;
+        for (k = 0; k < blocks; k++) {
+            uint64_t* result = results + b * BLOCKHASH_REPLY_VALUES;
+            result[0] = p->index_of_owner;
+            result[1] = p->offset / bh->block_size + k;
+            result[2] = (hash_rc == 0);
+            result[3] = digests[b].h[0];
+            result[4] = digests[b].h[1];
+            owners[b] = (int) p->rank_of_owner;
+            sendcounts[owners[b]] += (int) result_size;
+            b++;
+        }
+
+        p = p->next;
+    }
+    mfu_free(&buf);
+    mfu_free(&digests);
+
+    /* order results by owner rank */
+    int disp = 0;
+    for (j = 0; j < ranks; j++) {
+        offsets[j] = disp;
+        disp += sendcounts[j];
+    }
+    char* sendbuf = (char*) MFU_MALLOC(block_count * result_size);
+    for (b = 0; b < block_count; b++) {
+        int owner = owners[b];
+        memcpy(sendbuf + offsets[owner], results + b * BLOCKHASH_REPLY_VALUES, result_size);
+        offsets[owner] += (int) result_size;
+    }
+    mfu_free(&owners);
+    mfu_free(&results);
+
+    char* recvbuf = mfu_sidecar_alltoallv(sendbuf, sendcounts, recvcounts);
+    mfu_free(&sendbuf);
+
+    /* record digests of blocks of files we own */
+    uint64_t received = 0;
+    for (j = 0; j < ranks; j++) {
+        received += (uint64_t) recvcounts[j] / result_size;
+    }
+    const uint64_t* result = (const uint64_t*) recvbuf;
+    for (i = 0; i < received; i++) {
+        if (result[2]) {
+            idx = todo_index[result[0]];
+            bh->digests[bh->first[idx] + result[1]].h[0] = result[3];
+            bh->digests[bh->first[idx] + result[1]].h[1] = result[4];
+            bh->found[idx]++;
+        }
+        result += BLOCKHASH_REPLY_VALUES;
+    }
+    mfu_free(&recvbuf);
+
+    mfu_free(&offsets);
+    mfu_free(&recvcounts);
+    mfu_free(&sendcounts);
+    mfu_file_chunk_list_free(&head);
+    mfu_flist_free(&todo);
+    mfu_free(&todo_index);
+
+    /* determine whether any process hit an error */
+    int all_rc;
+    MPI_Allreduce(&rc, &all_rc, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    return all_rc;
+}
+
+/*
+=========================================
+Write digests to a sidecar file
+=========================================
+*/
+
+int mfu_blockhash_write(const char* name, int count, mfu_blockhash** bhs)
+{
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* sidecar files only hold MurmurHash3 digests */
+    int i;
+    for (i = 0; i < count; i++) {
+        if (bhs[i]->alg != MFU_DIGEST_MURMUR3) {
+            if (rank == 0) {
+                MFU_LOG(MFU_LOG_ERR, "Block hash file `%s' can only record %s digests",
+                    name, mfu_digest_alg_name(MFU_DIGEST_MURMUR3));
+            }
+            return -1;
+        }
+    }
+
+    static const char zeros[8] = {0};
+
+    /* count our files with digests and the bytes of their records */
+    uint64_t block_size = bhs[0]->block_size;
+    uint64_t head = BLOCKHASH_FILE_VALUES * 8;
+    uint64_t file_count = 0;
+    uint64_t rec_bytes = 0;
+    uint64_t digest_count = 0;
+    for (i = 0; i < count; i++) {
+        mfu_blockhash* bh = bhs[i];
+        uint64_t size = mfu_flist_size(bh->list);
+        uint64_t idx;
+        for (idx = 0; idx < size; idx++) {
+            uint64_t blocks = mfu_blockhash_blocks(bh, idx);
+            if (blocks > 0 && mfu_blockhash_valid(bh, idx)) {
+                const char* file = mfu_flist_file_get_name(bh->list, idx);
+                uint64_t len = (uint64_t) strlen(file) + 1;
+                rec_bytes += head + blockhash_padded(len) + blocks * 2 * 8;
+                digest_count += blocks;
+                file_count++;
+            }
+        }
+    }
+
+    uint64_t values[3] = {file_count, rec_bytes, digest_count};
+    uint64_t all_values[3], offsets[2];
+    MPI_Allreduce(values, all_values, 3, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Exscan(values, offsets, 2, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) {
+        offsets[0] = 0;
+        offsets[1] = 0;
+    }
+
+    uint64_t header[BLOCKHASH_HEADER_VALUES];
+    header[0] = BLOCKHASH_VERSION;
+    header[1] = block_size;
+    header[2] = all_values[0];
+    header[3] = all_values[1];
+    mfu_sidecar* sc = mfu_sidecar_create(name, "block hash file", BLOCKHASH_HEADER_VALUES, header);
+    if (sc == NULL) {
+        return -1;
+    }
+
+    /* write the offset of each of our records in the table */
+    mfu_sidecar_start(sc, offsets[0] * 8, file_count * 8);
+    uint64_t rec_offset = offsets[1];
+    for (i = 0; i < count; i++) {
+        mfu_blockhash* bh = bhs[i];
+        uint64_t size = mfu_flist_size(bh->list);
+        uint64_t idx;
+        for (idx = 0; idx < size; idx++) {
+            uint64_t blocks = mfu_blockhash_blocks(bh, idx);
+            if (blocks > 0 && mfu_blockhash_valid(bh, idx)) {
+                const char* file = mfu_flist_file_get_name(bh->list, idx);
+                uint64_t len = (uint64_t) strlen(file) + 1;
+
+                char packed[8];
+                char* ptr = packed;
+                mfu_pack_uint64(&ptr, rec_offset);
+                mfu_sidecar_append(sc, packed, sizeof(packed));
+
+                rec_offset += head + blockhash_padded(len) + blocks * 2 * 8;
+            }
+        }
+    }
+
+    /* then a record for each file, with the digest of each of its blocks */
+    mfu_sidecar_start(sc, all_values[0] * 8 + offsets[1], rec_bytes);
+    char* buf = (char*) MFU_MALLOC((size_t) head);
+    for (i = 0; i < count; i++) {
+        mfu_blockhash* bh = bhs[i];
+        uint64_t size = mfu_flist_size(bh->list);
+        uint64_t idx;
+        for (idx = 0; idx < size; idx++) {
+            uint64_t blocks = mfu_blockhash_blocks(bh, idx);
+            if (blocks == 0 || ! mfu_blockhash_valid(bh, idx)) {
+                continue;
+            }
+
+            const char* file = mfu_flist_file_get_name(bh->list, idx);
+            uint64_t len = (uint64_t) strlen(file) + 1;
+
+            char* ptr = buf;
+            mfu_pack_uint64(&ptr, mfu_flist_file_get_size(bh->list, idx));
+            mfu_pack_uint64(&ptr, mfu_flist_file_get_mtime(bh->list, idx));
+            mfu_pack_uint64(&ptr, mfu_flist_file_get_mtime_nsec(bh->list, idx));
+            mfu_pack_uint64(&ptr, mfu_flist_file_get_ctime(bh->list, idx));
+            mfu_pack_uint64(&ptr, mfu_flist_file_get_ctime_nsec(bh->list, idx));
+            mfu_pack_uint64(&ptr, len);
+            mfu_sidecar_append(sc, buf, (size_t) head);
+
+            /* path, padded with zeros */
+            mfu_sidecar_append(sc, file, (size_t) len);
+            mfu_sidecar_append(sc, zeros, (size_t) (blockhash_padded(len) - len));
+
+            uint64_t block;
+            for (block = 0; block < blocks; block++) {
+                const mfu_blockhash_digest* digest = &bh->digests[bh->first[idx] + block];
+                char packed[16];
+                ptr = packed;
+                mfu_pack_uint64(&ptr, digest->h[0]);
+                mfu_pack_uint64(&ptr, digest->h[1]);
+                mfu_sidecar_append(sc, packed, sizeof(packed));
+            }
+        }
+    }
+    mfu_free(&buf);
+
+    int rc = mfu_sidecar_commit(&sc);
+    if (rc == 0 && rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Wrote %llu block hashes of %llu files to `%s'",
+            (unsigned long long) all_values[2], (unsigned long long) all_values[0], name);
+    }
+    return rc;
+}
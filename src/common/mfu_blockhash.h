@@ -0,0 +1,100 @@
+/* enable C++ codes to include this header directly */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef MFU_BLOCKHASH_H
+#define MFU_BLOCKHASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "mfu_digest.h"
+#include "mfu_flist.h"
+#include "mfu_progress.h"
+
+/* A block-hash store records a digest for each fixed-size block of
+ * the regular files in a list, so that file contents can be compared
+ * without reading them.  Stores can be saved to and loaded from a
+ * sidecar file, which holds a record for each file with its full path,
+ * size, mtime, and ctime, followed by the digests of its blocks.  When
+ * loading, records are spread over ranks by a hash of their path, and
+ * digests are only accepted for items whose metadata in the list matches
+ * what was recorded, so only files that changed since the store was
+ * written need to be read again.
+ *
+ * Digests are computed with the algorithm given when the store is
+ * created, see mfu_digest.h.  Sidecar files only hold MurmurHash3
+ * digests.
+ *
+ * The list must have stat detail and it must outlive the store. */
+
+/* digest of one block of data */
+typedef mfu_digest_value mfu_blockhash_digest;
+
+/* Even though the structure is defined here, consider it to be
+ * opaque and only use functions in this file to modify it. */
+typedef struct mfu_blockhash_struct {
+    mfu_flist list;                 /* list the store describes */
+    uint64_t block_size;            /* number of bytes covered by each digest */
+    mfu_digest_alg alg;             /* algorithm used to compute digests */
+    uint64_t* first;                /* index in digests of first block of each item */
+    uint64_t* found;                /* number of blocks of each item that have a digest */
+    mfu_blockhash_digest* digests;  /* digest of each block of each item */
+} mfu_blockhash;
+
+/* allocate an empty store for the items in list */
+mfu_blockhash* mfu_blockhash_new(mfu_flist list, uint64_t block_size, mfu_digest_alg alg);
+
+/* free store and set pointer to NULL */
+void mfu_blockhash_delete(mfu_blockhash** pbh);
+
+/* return number of blocks of given item, 0 for empty files and other types */
+uint64_t mfu_blockhash_blocks(const mfu_blockhash* bh, uint64_t idx);
+
+/* return 1 if all blocks of given item have a digest, 0 otherwise */
+int mfu_blockhash_valid(const mfu_blockhash* bh, uint64_t idx);
+
+/* return digests of all blocks of given item, in order,
+ * or NULL if the item lacks digests */
+const mfu_blockhash_digest* mfu_blockhash_get(const mfu_blockhash* bh, uint64_t idx);
+
+/* forget digests of given item, e.g., after its file is modified */
+void mfu_blockhash_clear(mfu_blockhash* bh, uint64_t idx);
+
+/* compare digests of item ia in a with item ib in b,
+ * returns -1 if either item lacks digests, 0 if equal, 1 if different */
+int mfu_blockhash_compare(
+    const mfu_blockhash* a, uint64_t ia,
+    const mfu_blockhash* b, uint64_t ib
+);
+
+/* fill count stores from the sidecar file name, a missing file or one
+ * written with a different block size is treated as empty,
+ * returns 0 on success and -1 if the file could not be read
+ * or a store does not use MurmurHash3, must be called by all ranks */
+int mfu_blockhash_read(const char* name, int count, mfu_blockhash** bhs);
+
+/* read and hash all blocks of files in the store that lack digests,
+ * spreading the work evenly over ranks, adds to bytes_read and
+ * reports progress through prg as it goes, returns 0 on success
+ * and -1 if any rank failed to read a file, files that could not
+ * be read are left without digests, must be called by all ranks */
+int mfu_blockhash_compute(
+    mfu_blockhash* bh,
+    size_t bufsize,
+    uint64_t* bytes_read,
+    mfu_progress* prg
+);
+
+/* write digests of all items of count stores to the sidecar file
+ * name, replacing it once complete, returns -1 if a store does not
+ * use MurmurHash3, must be called by all ranks */
+int mfu_blockhash_write(const char* name, int count, mfu_blockhash** bhs);
+
+#endif /* MFU_BLOCKHASH_H */
+
+/* enable C++ codes to include this header directly */
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
@@ -0,0 +1,569 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <ctype.h>
+
+#include "mfu.h"
+#include "mfu_flist_internal.h"
+
+/* number of bytes to read from the change log at a time */
+#define CHANGES_READ_BYTES (1024 * 1024)
+
+/* read the lines of the file that start within this rank's share of its
+ * bytes, returns an allocated buffer and its length in len,
+ * returns NULL if the file could not be read on any rank */
+static char* changes_read_lines(const char* name, size_t* len)
+{
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    *len = 0;
+
+    /* rank 0 looks up file size */
+    uint64_t size = 0;
+    int valid = 1;
+    if (rank == 0) {
+        struct stat st;
+        if (mfu_lstat(name, &st) != 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to stat change log: `%s' (errno=%d %s)",
+                name, errno, strerror(errno));
+            valid = 0;
+        } else {
+            size = (uint64_t) st.st_size;
+        }
+    }
+    MPI_Bcast(&valid, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (! valid) {
+        return NULL;
+    }
+    MPI_Bcast(&size, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+
+    /* each rank takes the lines that start within an even share of bytes */
+    off_t start = (off_t) (size * (uint64_t) rank / (uint64_t) ranks);
+    off_t end   = (off_t) (size * (uint64_t) (rank + 1) / (uint64_t) ranks);
+
+    int fd = mfu_open(name, O_RDONLY);
+    if (fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open change log: `%s' (errno=%d %s)",
+            name, errno, strerror(errno));
+        valid = 0;
+    }
+
+    /* read from the byte before our share, which tells whether our
+     * first line starts there or belongs to the previous rank, until
+     * we find the end of the line that holds the last byte of our share */
+    off_t base = (start > 0) ? start - 1 : 0;
+    size_t bufsize = CHANGES_READ_BYTES;
+    char* buf = (char*) MFU_MALLOC(bufsize + 1);
+    size_t count = 0;
+    size_t stop = 0;
+    int found = 0;
+    if (valid && start < end && mfu_lseek(name, fd, base, SEEK_SET) != base) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to seek in change log: `%s' (errno=%d %s)",
+            name, errno, strerror(errno));
+        valid = 0;
+    }
+    while (valid && start < end && ! found) {
+        if (count + CHANGES_READ_BYTES > bufsize) {
+            bufsize *= 2;
+            buf = (char*) realloc(buf, bufsize + 1);
+            if (buf == NULL) {
+                MFU_ABORT(1, "Failed to allocate %llu bytes for change log", (unsigned long long) bufsize);
+            }
+        }
+
+        ssize_t n = mfu_read(name, fd, buf + count, CHANGES_READ_BYTES);
+        if (n < 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to read change log: `%s' (errno=%d %s)",
+                name, errno, strerror(errno));
+            valid = 0;
+            break;
+        }
+
+        /* look for a newline at or after the last byte of our share */
+        size_t last = (size_t) (end - 1 - base);
+        size_t i = (count > last) ? count : last;
+        for (; i < count + (size_t) n; i++) {
+            if (buf[i] == '\n') {
+                stop = i + 1;
+                found = 1;
+                break;
+            }
+        }
+        count += (size_t) n;
+
+        /* the last line may lack a newline */
+        if (n == 0) {
+            stop = count;
+            found = 1;
+        }
+    }
+
+    /* find where our first line starts */
+    size_t first = 0;
+    if (valid && start > 0) {
+        first = stop;
+        size_t i;
+        for (i = 0; i < stop; i++) {
+            if (buf[i] == '\n') {
+                first = i + 1;
+                break;
+            }
+        }
+    }
+
+    /* the lines from first to stop are ours, unless the first
+     * starts beyond our share */
+    size_t ours = 0;
+    if (valid && first < stop && base + (off_t) first < end) {
+        ours = stop - first;
+        memmove(buf, buf + first, ours);
+    }
+    count = ours;
+
+    if (fd >= 0) {
+        mfu_close(name, fd);
+    }
+
+    /* bail out if any rank failed */
+    int all_valid;
+    MPI_Allreduce(&valid, &all_valid, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+    if (! all_valid) {
+        mfu_free(&buf);
+        return NULL;
+    }
+
+    buf[count] = '\0';
+    *len = count;
+    return buf;
+}
+
+/* add name and each of its parent directories up to prefix to list */
+static void changes_add_parents(mfu_flist list, const char* name, size_t prefix_len)
+{
+    char* path = MFU_STRDUP(name);
+    while (1) {
+        uint64_t idx = mfu_flist_file_create(list);
+        mfu_flist_file_set_name(list, idx, path);
+
+        /* stop once we have added the prefix directory */
+        size_t len = strlen(path);
+        if (len <= prefix_len) {
+            break;
+        }
+
+        char* slash = strrchr(path, '/');
+        if (slash == NULL || (size_t)(slash - path) < prefix_len) {
+            break;
+        }
+        *slash = '\0';
+    }
+    mfu_free(&path);
+}
+
+/* parse records from the lines in buf and add each path and its parent
+ * directories to list, returns number of malformed records */
+static uint64_t changes_parse(
+    char* buf,
+    const char* src_prefix,
+    mfu_flist list,
+    uint64_t* records)
+{
+    size_t prefix_len = strlen(src_prefix);
+    uint64_t errors = 0;
+
+    char* line = buf;
+    while (*line != '\0') {
+        /* terminate this line */
+        char* next = strchr(line, '\n');
+        if (next != NULL) {
+            *next = '\0';
+            next++;
+        } else {
+            next = line + strlen(line);
+        }
+
+        /* drop trailing carriage return and whitespace */
+        size_t len = strlen(line);
+        while (len > 0 && isspace((unsigned char) line[len - 1])) {
+            line[len - 1] = '\0';
+            len--;
+        }
+
+        /* skip leading whitespace, empty lines, and comments */
+        char* event = line;
+        while (isspace((unsigned char) *event)) {
+            event++;
+        }
+        if (*event == '\0' || *event == '#') {
+            line = next;
+            continue;
+        }
+
+        /* split event from path */
+        char* path = event;
+        while (*path != '\0' && ! isspace((unsigned char) *path)) {
+            path++;
+        }
+        if (*path != '\0') {
+            *path = '\0';
+            path++;
+            while (isspace((unsigned char) *path)) {
+                path++;
+            }
+        }
+        if (*path == '\0') {
+            MFU_LOG(MFU_LOG_ERR, "Change record has no path: `%s'", event);
+            errors++;
+            line = next;
+            continue;
+        }
+
+        /* resolve path relative to the source directory */
+        char* full;
+        if (path[0] == '/') {
+            full = mfu_path_strdup_reduce_str(path);
+        } else {
+            mfu_path* p = mfu_path_from_str(src_prefix);
+            mfu_path_append_str(p, path);
+            mfu_path_reduce(p);
+            full = mfu_path_strdup(p);
+            mfu_path_delete(&p);
+        }
+
+        /* only accept paths within the source directory */
+        if (strncmp(full, src_prefix, prefix_len) != 0 ||
+            (full[prefix_len] != '\0' && full[prefix_len] != '/'))
+        {
+            MFU_LOG(MFU_LOG_ERR, "Change record path is not within `%s': `%s'", src_prefix, path);
+            errors++;
+        } else {
+            changes_add_parents(list, full, prefix_len);
+            (*records)++;
+        }
+        mfu_free(&full);
+
+        line = next;
+    }
+
+    return errors;
+}
+
+/* map each path to a rank by hashing the part following the prefix */
+static int changes_map_fn(mfu_flist flist, uint64_t idx, int ranks, const void* args)
+{
+    size_t prefix_len = *(const size_t*) args;
+    const char* name = mfu_flist_file_get_name(flist, idx);
+    const char* ptr = name + prefix_len;
+    uint32_t hash = mfu_hash_jenkins(ptr, strlen(ptr));
+    return (int) (hash % (uint32_t) ranks);
+}
+
+/* compare two strings for qsort */
+static int changes_strcmp(const void* a, const void* b)
+{
+    return strcmp(*(const char* const*) a, *(const char* const*) b);
+}
+
+/* return 1 if key is or lies within one of the sorted roots */
+static int changes_within(const char* key, char** roots, uint64_t count)
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    /* check key and each of its parents, the empty key is the top */
+    char* path = MFU_STRDUP(key);
+    int found = 0;
+    while (1) {
+        if (bsearch(&path, roots, (size_t) count, sizeof(char*), changes_strcmp) != NULL) {
+            found = 1;
+            break;
+        }
+        char* slash = strrchr(path, '/');
+        if (slash == NULL) {
+            break;
+        }
+        *slash = '\0';
+    }
+    mfu_free(&path);
+    return found;
+}
+
+/* gather local keys from all ranks into a sorted array,
+ * dropping keys that lie within another key */
+static char** changes_allgather_roots(char** keys, uint64_t count, uint64_t* all_count)
+{
+    int ranks;
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* pack keys including terminating NUL */
+    uint64_t bytes = 0;
+    uint64_t i;
+    for (i = 0; i < count; i++) {
+        bytes += strlen(keys[i]) + 1;
+    }
+    char* sendbuf = (char*) MFU_MALLOC(bytes + 1);
+    char* ptr = sendbuf;
+    for (i = 0; i < count; i++) {
+        strcpy(ptr, keys[i]);
+        ptr += strlen(keys[i]) + 1;
+    }
+
+    int sendcount = (int) bytes;
+    int* recvcounts = (int*) MFU_MALLOC(ranks * sizeof(int));
+    int* displs     = (int*) MFU_MALLOC(ranks * sizeof(int));
+    MPI_Allgather(&sendcount, 1, MPI_INT, recvcounts, 1, MPI_INT, MPI_COMM_WORLD);
+
+    int total = 0;
+    int r;
+    for (r = 0; r < ranks; r++) {
+        displs[r] = total;
+        total += recvcounts[r];
+    }
+    char* recvbuf = (char*) MFU_MALLOC(total + 1);
+    MPI_Allgatherv(sendbuf, sendcount, MPI_CHAR, recvbuf, recvcounts, displs, MPI_CHAR, MPI_COMM_WORLD);
+
+    /* split into strings and sort them */
+    uint64_t n = 0;
+    int off;
+    for (off = 0; off < total; off++) {
+        if (recvbuf[off] == '\0') {
+            n++;
+        }
+    }
+    char** roots = (char**) MFU_MALLOC((n + 1) * sizeof(char*));
+    ptr = recvbuf;
+    for (i = 0; i < n; i++) {
+        roots[i] = MFU_STRDUP(ptr);
+        ptr += strlen(ptr) + 1;
+    }
+    qsort(roots, (size_t) n, sizeof(char*), changes_strcmp);
+
+    /* drop keys within another key, since walking that one finds them,
+     * a parent sorts before its children, so we only check keys we kept */
+    uint64_t kept = 0;
+    for (i = 0; i < n; i++) {
+        if (changes_within(roots[i], roots, kept)) {
+            mfu_free(&roots[i]);
+            continue;
+        }
+        roots[kept] = roots[i];
+        kept++;
+    }
+
+    mfu_free(&recvbuf);
+    mfu_free(&displs);
+    mfu_free(&recvcounts);
+    mfu_free(&sendbuf);
+
+    *all_count = kept;
+    return roots;
+}
+
+/* walk each root under prefix and copy the items into list */
+static void changes_walk(
+    char** roots,
+    uint64_t count,
+    const char* prefix,
+    mfu_walk_opts_t* walk_opts,
+    mfu_flist list,
+    mfu_file_t* mfu_file)
+{
+    if (count == 0) {
+        return;
+    }
+
+    const char** paths = (const char**) MFU_MALLOC(count * sizeof(char*));
+    uint64_t i;
+    for (i = 0; i < count; i++) {
+        size_t len = strlen(prefix) + strlen(roots[i]) + 1;
+        char* path = (char*) MFU_MALLOC(len);
+        snprintf(path, len, "%s%s", prefix, roots[i]);
+        paths[i] = path;
+    }
+
+    mfu_flist walked = mfu_flist_new();
+    mfu_flist_walk_paths(count, paths, walk_opts, walked, mfu_file);
+
+    uint64_t size = mfu_flist_size(walked);
+    uint64_t idx;
+    for (idx = 0; idx < size; idx++) {
+        mfu_flist_file_copy(walked, idx, list);
+    }
+    mfu_flist_free(&walked);
+
+    for (i = 0; i < count; i++) {
+        mfu_free(&paths[i]);
+    }
+    mfu_free(&paths);
+}
+
+int mfu_changes_read(
+    const char* name,
+    const char* src_prefix,
+    const char* dst_prefix,
+    mfu_walk_opts_t* walk_opts,
+    mfu_flist src_list,
+    mfu_flist dst_list,
+    mfu_file_t* src_file,
+    mfu_file_t* dst_file)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    /* read our share of the records */
+    size_t len;
+    char* buf = changes_read_lines(name, &len);
+    if (buf == NULL) {
+        return -1;
+    }
+
+    /* collect each named path and its parents */
+    size_t prefix_len = strlen(src_prefix);
+    uint64_t records = 0;
+    mfu_flist names = mfu_flist_new();
+    uint64_t errors = changes_parse(buf, src_prefix, names, &records);
+    mfu_free(&buf);
+
+    uint64_t all_errors, all_records;
+    MPI_Allreduce(&errors, &all_errors, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(&records, &all_records, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (all_errors > 0) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "Found %llu malformed records in change log `%s'",
+                (unsigned long long) all_errors, name);
+        }
+        mfu_flist_free(&names);
+        return -1;
+    }
+
+    /* send each path to a single rank and drop duplicates */
+    mfu_flist_summarize(names);
+    mfu_flist mapped = mfu_flist_remap(names, changes_map_fn, &prefix_len);
+    mfu_flist_free(&names);
+
+    uint64_t size = mfu_flist_size(mapped);
+    const char** sorted = (const char**) MFU_MALLOC((size + 1) * sizeof(char*));
+    uint64_t idx;
+    for (idx = 0; idx < size; idx++) {
+        sorted[idx] = mfu_flist_file_get_name(mapped, idx);
+    }
+    qsort(sorted, (size_t) size, sizeof(char*), changes_strcmp);
+
+    uint64_t count = 0;
+    for (idx = 0; idx < size; idx++) {
+        if (count == 0 || strcmp(sorted[count - 1], sorted[idx]) != 0) {
+            sorted[count] = sorted[idx];
+            count++;
+        }
+    }
+
+    /* stat each path on both sides, note directories that exist on only
+     * one side, since their contents are not named in the change log */
+    struct stat* src_st = (struct stat*) MFU_MALLOC((count + 1) * sizeof(struct stat));
+    struct stat* dst_st = (struct stat*) MFU_MALLOC((count + 1) * sizeof(struct stat));
+    int* src_found = (int*) MFU_MALLOC((count + 1) * sizeof(int));
+    int* dst_found = (int*) MFU_MALLOC((count + 1) * sizeof(int));
+    char** src_roots = (char**) MFU_MALLOC((count + 1) * sizeof(char*));
+    char** dst_roots = (char**) MFU_MALLOC((count + 1) * sizeof(char*));
+    uint64_t src_root_count = 0;
+    uint64_t dst_root_count = 0;
+    for (idx = 0; idx < count; idx++) {
+        const char* key = sorted[idx] + prefix_len;
+        src_found[idx] = (mfu_file_lstat(sorted[idx], &src_st[idx], src_file) == 0);
+
+        size_t dst_len = strlen(dst_prefix) + strlen(key) + 1;
+        char* dst_path = (char*) MFU_MALLOC(dst_len);
+        snprintf(dst_path, dst_len, "%s%s", dst_prefix, key);
+        dst_found[idx] = (mfu_file_lstat(dst_path, &dst_st[idx], dst_file) == 0);
+        mfu_free(&dst_path);
+
+        int src_dir = src_found[idx] && S_ISDIR(src_st[idx].st_mode);
+        int dst_dir = dst_found[idx] && S_ISDIR(dst_st[idx].st_mode);
+        if (src_dir && ! dst_dir) {
+            src_roots[src_root_count] = (char*) key;
+            src_root_count++;
+        }
+        if (dst_dir && ! src_dir) {
+            dst_roots[dst_root_count] = (char*) key;
+            dst_root_count++;
+        }
+    }
+
+    uint64_t all_src_roots, all_dst_roots;
+    char** src_all = changes_allgather_roots(src_roots, src_root_count, &all_src_roots);
+    char** dst_all = changes_allgather_roots(dst_roots, dst_root_count, &all_dst_roots);
+    mfu_free(&dst_roots);
+    mfu_free(&src_roots);
+
+    /* walk directories that exist on only one side */
+    changes_walk(src_all, all_src_roots, src_prefix, walk_opts, src_list, src_file);
+    changes_walk(dst_all, all_dst_roots, dst_prefix, walk_opts, dst_list, dst_file);
+
+    /* insert remaining paths using the stat data we already have */
+    flist_t* src_flist = (flist_t*) src_list;
+    flist_t* dst_flist = (flist_t*) dst_list;
+    src_flist->detail = 1;
+    dst_flist->detail = 1;
+    if (src_flist->have_users == 0) {
+        mfu_flist_usrgrp_get_users(src_flist);
+    }
+    if (src_flist->have_groups == 0) {
+        mfu_flist_usrgrp_get_groups(src_flist);
+    }
+    if (dst_flist->have_users == 0) {
+        mfu_flist_usrgrp_get_users(dst_flist);
+    }
+    if (dst_flist->have_groups == 0) {
+        mfu_flist_usrgrp_get_groups(dst_flist);
+    }
+
+    for (idx = 0; idx < count; idx++) {
+        const char* key = sorted[idx] + prefix_len;
+        if (src_found[idx] && ! changes_within(key, src_all, all_src_roots)) {
+            mfu_flist_insert_stat(src_flist, sorted[idx], src_st[idx].st_mode, &src_st[idx]);
+        }
+        if (dst_found[idx] && ! changes_within(key, dst_all, all_dst_roots)) {
+            size_t dst_len = strlen(dst_prefix) + strlen(key) + 1;
+            char* dst_path = (char*) MFU_MALLOC(dst_len);
+            snprintf(dst_path, dst_len, "%s%s", dst_prefix, key);
+            mfu_flist_insert_stat(dst_flist, dst_path, dst_st[idx].st_mode, &dst_st[idx]);
+            mfu_free(&dst_path);
+        }
+    }
+
+    mfu_flist_summarize(src_list);
+    mfu_flist_summarize(dst_list);
+
+    uint64_t all_count;
+    MPI_Allreduce(&count, &all_count, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Read %llu change records naming %llu paths and parent directories",
+            (unsigned long long) all_records, (unsigned long long) all_count);
+        MFU_LOG(MFU_LOG_INFO, "Walked %llu source and %llu destination directories found on one side only",
+            (unsigned long long) all_src_roots, (unsigned long long) all_dst_roots);
+    }
+
+    for (idx = 0; idx < all_src_roots; idx++) {
+        mfu_free(&src_all[idx]);
+    }
+    for (idx = 0; idx < all_dst_roots; idx++) {
+        mfu_free(&dst_all[idx]);
+    }
+    mfu_free(&src_all);
+    mfu_free(&dst_all);
+    mfu_free(&dst_found);
+    mfu_free(&src_found);
+    mfu_free(&dst_st);
+    mfu_free(&src_st);
+    mfu_free(&sorted);
+    mfu_flist_free(&mapped);
+
+    return 0;
+}
@@ -0,0 +1,54 @@
+/* enable C++ codes to include this header directly */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef MFU_CHANGES_H
+#define MFU_CHANGES_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "mfu_flist.h"
+#include "mfu_param_path.h"
+
+/* A change log is a text file that names paths under a source directory
+ * that may have changed since it was last synchronized with a destination,
+ * e.g., as recorded by a Lustre changelog consumer or an inotify daemon.
+ * Each line holds one record of the form
+ *
+ *   EVENT PATH
+ *
+ * where EVENT is a single word, like CREATE, MODIFY, DELETE, or RENAME,
+ * and PATH is the rest of the line.  PATH is either absolute and within
+ * the source directory or relative to it.  For a rename, list both the
+ * old and the new path.  Empty lines and lines starting with '#' are
+ * ignored.
+ *
+ * The event is only informational.  The current state of each path is
+ * found by calling lstat on it under both the source and the destination,
+ * so records that are duplicated, out of order, or describe events that
+ * were later undone lead to the same result. */
+
+/* read the change log name and fill src_list and dst_list with each named
+ * path and its parent directories that exist under src_prefix and
+ * dst_prefix, respectively, a directory that exists on only one side is
+ * walked in full with walk_opts, returns 0 on success and -1 if the file
+ * could not be read or held malformed records, must be called by all ranks */
+int mfu_changes_read(
+    const char* name,
+    const char* src_prefix,
+    const char* dst_prefix,
+    mfu_walk_opts_t* walk_opts,
+    mfu_flist src_list,
+    mfu_flist dst_list,
+    mfu_file_t* src_file,
+    mfu_file_t* dst_file
+);
+
+#endif /* MFU_CHANGES_H */
+
+/* enable C++ codes to include this header directly */
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
@@ -0,0 +1,529 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mfu.h"
+
+/* the fast digest has SSE2 and AVX2 versions on x86-64 with
+ * GCC-compatible compilers, the AVX2 version is picked at run time */
+#if defined(__GNUC__) && defined(__x86_64__)
+#define DIGEST_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+static inline uint64_t digest_rotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t digest_fmix(uint64_t k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+/*
+=========================================
+128-bit MurmurHash3 (x64 variant), computed incrementally,
+uses state[0..1] and the first 16 bytes of buf
+=========================================
+*/
+
+#define DIGEST_C1 (0x87c37b91114253d5ULL)
+#define DIGEST_C2 (0x4cf5ad432745937fULL)
+
+/* mix one 16-byte block into the state */
+static inline void digest_murmur_body(uint64_t* state, const unsigned char* p)
+{
+    uint64_t k1, k2;
+    memcpy(&k1, p, 8);
+    memcpy(&k2, p + 8, 8);
+
+    k1 *= DIGEST_C1;
+    k1  = digest_rotl(k1, 31);
+    k1 *= DIGEST_C2;
+    state[0] ^= k1;
+
+    state[0]  = digest_rotl(state[0], 27);
+    state[0] += state[1];
+    state[0]  = state[0] * 5 + 0x52dce729;
+
+    k2 *= DIGEST_C2;
+    k2  = digest_rotl(k2, 33);
+    k2 *= DIGEST_C1;
+    state[1] ^= k2;
+
+    state[1]  = digest_rotl(state[1], 31);
+    state[1] += state[0];
+    state[1]  = state[1] * 5 + 0x38495ab5;
+}
+
+static void digest_murmur_update(mfu_digest_ctx* ctx, const unsigned char* p, size_t len)
+{
+    /* top up bytes left over from the previous call */
+    if (ctx->buf_len > 0) {
+        size_t n = 16 - ctx->buf_len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(ctx->buf + ctx->buf_len, p, n);
+        ctx->buf_len += n;
+        p   += n;
+        len -= n;
+        if (ctx->buf_len < 16) {
+            return;
+        }
+        digest_murmur_body(ctx->state, ctx->buf);
+        ctx->buf_len = 0;
+    }
+
+    while (len >= 16) {
+        digest_murmur_body(ctx->state, p);
+        p   += 16;
+        len -= 16;
+    }
+
+    memcpy(ctx->buf, p, len);
+    ctx->buf_len = len;
+}
+
+static void digest_murmur_final(mfu_digest_ctx* ctx, mfu_digest_value* value)
+{
+    const unsigned char* t = ctx->buf;
+    size_t n = ctx->buf_len;
+    size_t i;
+
+    uint64_t k2 = 0;
+    for (i = n; i > 8; i--) {
+        k2 ^= (uint64_t) t[i - 1] << ((i - 9) * 8);
+    }
+    if (n > 8) {
+        k2 *= DIGEST_C2;
+        k2  = digest_rotl(k2, 33);
+        k2 *= DIGEST_C1;
+        ctx->state[1] ^= k2;
+    }
+
+    uint64_t k1 = 0;
+    for (i = (n < 8) ? n : 8; i > 0; i--) {
+        k1 ^= (uint64_t) t[i - 1] << ((i - 1) * 8);
+    }
+    if (n > 0) {
+        k1 *= DIGEST_C1;
+        k1  = digest_rotl(k1, 31);
+        k1 *= DIGEST_C2;
+        ctx->state[0] ^= k1;
+    }
+
+    uint64_t h1 = ctx->state[0] ^ ctx->len;
+    uint64_t h2 = ctx->state[1] ^ ctx->len;
+    h1 += h2;
+    h2 += h1;
+    h1 = digest_fmix(h1);
+    h2 = digest_fmix(h2);
+    h1 += h2;
+    h2 += h1;
+
+    value->h[0] = h1;
+    value->h[1] = h2;
+}
+
+/*
+=========================================
+Fast lane hash, uses all of state as eight accumulators
+=========================================
+*/
+
+/* number of bytes mixed into the accumulators in one step */
+#define DIGEST_STRIPE (64)
+
+/* number of stripes between scrambles of the accumulators */
+#define DIGEST_SCRAMBLE_STRIPES (16)
+
+/* 32-bit prime used to scramble accumulators */
+#define DIGEST_P32 (0x9e3779b1ULL)
+
+static const uint64_t digest_keys[8] = {
+    0x9e3779b97f4a7c15ULL, 0xc2b2ae3d27d4eb4fULL,
+    0x165667b19e3779f9ULL, 0x85ebca77c2b2ae63ULL,
+    0x27d4eb2f165667c5ULL, 0xff51afd7ed558ccdULL,
+    0xc4ceb9fe1a85ec53ULL, 0x87c37b91114253d5ULL,
+};
+
+/* keys of each stripe between scrambles, adds to the accumulators are
+ * the same whatever the order of the stripes, so without a key for each
+ * position, swapping two stripes would give the same digest */
+static uint64_t digest_stripe_keys[DIGEST_SCRAMBLE_STRIPES][8];
+static int digest_stripe_keys_set = 0;
+
+static void digest_fast_keys(void)
+{
+    if (digest_stripe_keys_set) {
+        return;
+    }
+
+    int s, j;
+    for (s = 0; s < DIGEST_SCRAMBLE_STRIPES; s++) {
+        for (j = 0; j < 8; j++) {
+            digest_stripe_keys[s][j] = digest_fmix(digest_keys[j] + (uint64_t)(s + 1) * DIGEST_C1);
+        }
+    }
+    digest_stripe_keys_set = 1;
+}
+
+/* mix stripes consecutive stripes from p into the accumulators, using
+ * 8 keys for each stripe starting at keys, each lane only uses 32x32-bit
+ * multiplies, adds, and a swap of neighboring lanes, which map directly
+ * onto SIMD instructions, this version is built everywhere so that the
+ * others can be checked against it */
+static void digest_fast_stripes_generic(uint64_t* acc, const unsigned char* p, size_t stripes, const uint64_t* keys)
+{
+    size_t s;
+    int j;
+    for (s = 0; s < stripes; s++) {
+        for (j = 0; j < 8; j++) {
+            uint64_t v;
+            memcpy(&v, p + j * 8, 8);
+            uint64_t k = v ^ keys[j];
+            acc[j ^ 1] += v;
+            acc[j]     += (k & 0xffffffffULL) * (k >> 32);
+        }
+        p    += DIGEST_STRIPE;
+        keys += 8;
+    }
+}
+
+#ifdef DIGEST_HAVE_X86
+/* the SSE2 and AVX2 versions below compute the same as the scalar
+ * version, each lane adds the 32x32-bit product of the low and high
+ * halves of its data xor'd with a key, plus the data of its neighbor:
+ *
+ *   for (j = 0; j < 8; j++) {
+ *       uint64_t k = v[j] ^ keys[j];
+ *       acc[j ^ 1] += v[j];
+ *       acc[j]     += (k & 0xffffffff) * (k >> 32);
+ *   }
+ */
+
+/* mix stripes consecutive stripes from p into the accumulators,
+ * two lanes per register */
+static void digest_fast_stripes_sse2(uint64_t* acc, const unsigned char* p, size_t stripes, const uint64_t* keys)
+{
+    __m128i a[4];
+    int j;
+    for (j = 0; j < 4; j++) {
+        a[j] = _mm_loadu_si128((const __m128i*)(acc + j * 2));
+    }
+
+    size_t s;
+    for (s = 0; s < stripes; s++) {
+        for (j = 0; j < 4; j++) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(p + j * 16));
+            __m128i k = _mm_loadu_si128((const __m128i*)(keys + j * 2));
+            __m128i x = _mm_xor_si128(v, k);
+            __m128i m = _mm_mul_epu32(x, _mm_srli_epi64(x, 32));
+            __m128i w = _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+            a[j] = _mm_add_epi64(a[j], _mm_add_epi64(m, w));
+        }
+        p    += DIGEST_STRIPE;
+        keys += 8;
+    }
+
+    for (j = 0; j < 4; j++) {
+        _mm_storeu_si128((__m128i*)(acc + j * 2), a[j]);
+    }
+}
+
+/* same as digest_fast_stripes_sse2, four lanes per register */
+__attribute__((target("avx2")))
+static void digest_fast_stripes_avx2(uint64_t* acc, const unsigned char* p, size_t stripes, const uint64_t* keys)
+{
+    __m256i a0 = _mm256_loadu_si256((const __m256i*)(acc + 0));
+    __m256i a1 = _mm256_loadu_si256((const __m256i*)(acc + 4));
+
+    size_t s;
+    for (s = 0; s < stripes; s++) {
+        __m256i v0 = _mm256_loadu_si256((const __m256i*)(p + 0));
+        __m256i v1 = _mm256_loadu_si256((const __m256i*)(p + 32));
+        __m256i k0 = _mm256_loadu_si256((const __m256i*)(keys + 0));
+        __m256i k1 = _mm256_loadu_si256((const __m256i*)(keys + 4));
+        __m256i x0 = _mm256_xor_si256(v0, k0);
+        __m256i x1 = _mm256_xor_si256(v1, k1);
+        __m256i m0 = _mm256_mul_epu32(x0, _mm256_srli_epi64(x0, 32));
+        __m256i m1 = _mm256_mul_epu32(x1, _mm256_srli_epi64(x1, 32));
+        __m256i w0 = _mm256_shuffle_epi32(v0, _MM_SHUFFLE(1, 0, 3, 2));
+        __m256i w1 = _mm256_shuffle_epi32(v1, _MM_SHUFFLE(1, 0, 3, 2));
+        a0 = _mm256_add_epi64(a0, _mm256_add_epi64(m0, w0));
+        a1 = _mm256_add_epi64(a1, _mm256_add_epi64(m1, w1));
+        p    += DIGEST_STRIPE;
+        keys += 8;
+    }
+
+    _mm256_storeu_si256((__m256i*)(acc + 0), a0);
+    _mm256_storeu_si256((__m256i*)(acc + 4), a1);
+}
+#endif
+
+/* version of the stripe loop picked for this processor */
+typedef void (*digest_stripes_fn)(uint64_t* acc, const unsigned char* p, size_t stripes, const uint64_t* keys);
+static digest_stripes_fn digest_fast_stripes = NULL;
+static const char* digest_fast_impl = NULL;
+
+static void digest_fast_select(void)
+{
+    digest_fast_keys();
+    if (digest_fast_stripes != NULL) {
+        return;
+    }
+
+#ifdef DIGEST_HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        digest_fast_impl    = "avx2";
+        digest_fast_stripes = digest_fast_stripes_avx2;
+    } else {
+        digest_fast_impl    = "sse2";
+        digest_fast_stripes = digest_fast_stripes_sse2;
+    }
+#else
+    digest_fast_impl    = "generic";
+    digest_fast_stripes = digest_fast_stripes_generic;
+#endif
+}
+
+int mfu_digest_set_impl(const char* name)
+{
+    if (strcmp(name, "generic") == 0) {
+        digest_fast_impl    = "generic";
+        digest_fast_stripes = digest_fast_stripes_generic;
+        return 0;
+    }
+
+#ifdef DIGEST_HAVE_X86
+    if (strcmp(name, "sse2") == 0) {
+        digest_fast_impl    = "sse2";
+        digest_fast_stripes = digest_fast_stripes_sse2;
+        return 0;
+    }
+
+    __builtin_cpu_init();
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+        digest_fast_impl    = "avx2";
+        digest_fast_stripes = digest_fast_stripes_avx2;
+        return 0;
+    }
+#endif
+
+    return -1;
+}
+
+/* spread high bits of each accumulator into its low bits, so that they
+ * feed the next round of multiplies */
+static void digest_fast_scramble(uint64_t* acc)
+{
+    int j;
+    for (j = 0; j < 8; j++) {
+        uint64_t a = acc[j];
+        a ^= a >> 47;
+        a ^= digest_keys[7 - j];
+        a *= DIGEST_P32;
+        acc[j] = a;
+    }
+}
+
+/* mix whole stripes into the state, scrambling at fixed stripe counts
+ * so that the result does not depend on how data was split into calls */
+static void digest_fast_blocks(mfu_digest_ctx* ctx, const unsigned char* p, size_t stripes)
+{
+    while (stripes > 0) {
+        size_t first = (size_t)(ctx->stripes % DIGEST_SCRAMBLE_STRIPES);
+        size_t n = DIGEST_SCRAMBLE_STRIPES - first;
+        if (n > stripes) {
+            n = stripes;
+        }
+
+        digest_fast_stripes(ctx->state, p, n, digest_stripe_keys[first]);
+        ctx->stripes += (uint64_t) n;
+        p       += n * DIGEST_STRIPE;
+        stripes -= n;
+
+        if (ctx->stripes % DIGEST_SCRAMBLE_STRIPES == 0) {
+            digest_fast_scramble(ctx->state);
+        }
+    }
+}
+
+static void digest_fast_update(mfu_digest_ctx* ctx, const unsigned char* p, size_t len)
+{
+    /* top up bytes left over from the previous call */
+    if (ctx->buf_len > 0) {
+        size_t n = DIGEST_STRIPE - ctx->buf_len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(ctx->buf + ctx->buf_len, p, n);
+        ctx->buf_len += n;
+        p   += n;
+        len -= n;
+        if (ctx->buf_len < DIGEST_STRIPE) {
+            return;
+        }
+        digest_fast_blocks(ctx, ctx->buf, 1);
+        ctx->buf_len = 0;
+    }
+
+    size_t stripes = len / DIGEST_STRIPE;
+    digest_fast_blocks(ctx, p, stripes);
+    p   += stripes * DIGEST_STRIPE;
+    len -= stripes * DIGEST_STRIPE;
+
+    memcpy(ctx->buf, p, len);
+    ctx->buf_len = len;
+}
+
+static void digest_fast_final(mfu_digest_ctx* ctx, mfu_digest_value* value)
+{
+    /* pad the last partial stripe with zeros, the length is mixed in
+     * below, so padding cannot be confused with data */
+    if (ctx->buf_len > 0) {
+        memset(ctx->buf + ctx->buf_len, 0, DIGEST_STRIPE - ctx->buf_len);
+        digest_fast_blocks(ctx, ctx->buf, 1);
+        ctx->buf_len = 0;
+    }
+
+    /* fold the accumulators into two words */
+    uint64_t h1 = ctx->len * DIGEST_C1;
+    uint64_t h2 = ~ctx->len * DIGEST_C2;
+    int j;
+    for (j = 0; j < 8; j++) {
+        h1 ^= digest_fmix(ctx->state[j] + digest_keys[j]);
+        h1  = digest_rotl(h1, 27) * 5 + 0x52dce729;
+        h2 += digest_fmix(ctx->state[j] ^ digest_keys[7 - j]);
+        h2  = digest_rotl(h2, 31) * 5 + 0x38495ab5;
+    }
+    h1 += h2;
+    h2 += h1;
+    h1 = digest_fmix(h1);
+    h2 = digest_fmix(h2);
+    h1 += h2;
+    h2 += h1;
+
+    value->h[0] = h1;
+    value->h[1] = h2;
+}
+
+/*
+=========================================
+Public interface
+=========================================
+*/
+
+int mfu_digest_alg_parse(const char* name, mfu_digest_alg* alg)
+{
+    if (strcmp(name, "murmur3") == 0) {
+        *alg = MFU_DIGEST_MURMUR3;
+        return 0;
+    }
+    if (strcmp(name, "fast") == 0) {
+        *alg = MFU_DIGEST_FAST;
+        return 0;
+    }
+    return -1;
+}
+
+const char* mfu_digest_alg_name(mfu_digest_alg alg)
+{
+    switch (alg) {
+    case MFU_DIGEST_MURMUR3:
+        return "murmur3";
+    case MFU_DIGEST_FAST:
+        return "fast";
+    }
+    return "unknown";
+}
+
+const char* mfu_digest_impl(mfu_digest_alg alg)
+{
+    if (alg == MFU_DIGEST_FAST) {
+        digest_fast_select();
+        return digest_fast_impl;
+    }
+    return "generic";
+}
+
+void mfu_digest_init(mfu_digest_ctx* ctx, mfu_digest_alg alg)
+{
+    memset(ctx, 0, sizeof(mfu_digest_ctx));
+    ctx->alg = alg;
+
+    if (alg == MFU_DIGEST_FAST) {
+        digest_fast_select();
+
+        /* start each lane from a different key */
+        int j;
+        for (j = 0; j < 8; j++) {
+            ctx->state[j] = digest_keys[(j + 3) % 8];
+        }
+    }
+}
+
+void mfu_digest_update(mfu_digest_ctx* ctx, const void* buf, size_t len)
+{
+    const unsigned char* p = (const unsigned char*) buf;
+    ctx->len += (uint64_t) len;
+
+    if (ctx->alg == MFU_DIGEST_FAST) {
+        digest_fast_update(ctx, p, len);
+    } else {
+        digest_murmur_update(ctx, p, len);
+    }
+}
+
+void mfu_digest_final(mfu_digest_ctx* ctx, mfu_digest_value* value)
+{
+    if (ctx->alg == MFU_DIGEST_FAST) {
+        digest_fast_final(ctx, value);
+    } else {
+        digest_murmur_final(ctx, value);
+    }
+}
+
+void mfu_digest_buf(mfu_digest_alg alg, const void* buf, size_t len, mfu_digest_value* value)
+{
+    mfu_digest_ctx ctx;
+    mfu_digest_init(&ctx, alg);
+    mfu_digest_update(&ctx, buf, len);
+    mfu_digest_final(&ctx, value);
+}
+
+uint64_t mfu_digest_tree_leaves(uint64_t file_size, uint64_t leaf_size)
+{
+    return (file_size + leaf_size - 1) / leaf_size;
+}
+
+void mfu_digest_tree_combine(
+    mfu_digest_alg alg,
+    uint64_t leaf_size,
+    uint64_t file_size,
+    const mfu_digest_value* leaves,
+    mfu_digest_value* value)
+{
+    mfu_digest_ctx ctx;
+    mfu_digest_init(&ctx, alg);
+
+    /* hash the leaf digests in order, followed by the
+     * leaf size and file size that define the tree */
+    uint64_t count = mfu_digest_tree_leaves(file_size, leaf_size);
+    uint64_t i;
+    for (i = 0; i < count; i++) {
+        mfu_digest_update(&ctx, leaves[i].h, sizeof(leaves[i].h));
+    }
+    mfu_digest_update(&ctx, &leaf_size, sizeof(leaf_size));
+    mfu_digest_update(&ctx, &file_size, sizeof(file_size));
+
+    mfu_digest_final(&ctx, value);
+}
@@ -0,0 +1,111 @@
+/* enable C++ codes to include this header directly */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef MFU_DIGEST_H
+#define MFU_DIGEST_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Digests are 128-bit hashes used to compare file data.  They reliably
+ * detect accidental differences, but they are not cryptographic, so
+ * callers that must rule out deliberate collisions should confirm a
+ * match with a byte-for-byte comparison or a cryptographic hash.
+ *
+ * MFU_DIGEST_MURMUR3 is the x64 variant of 128-bit MurmurHash3.
+ *
+ * MFU_DIGEST_FAST processes data in 64-byte stripes over eight
+ * independent 64-bit lanes, using only operations that map onto SIMD
+ * instructions.  On x86-64 it has SSE2 and AVX2 versions, and the AVX2
+ * version is picked at run time when the processor supports it.  Other
+ * processors use a scalar version.  All versions produce the same digest.
+ * Each stripe is mixed with keys that depend on its position, so that
+ * reordering data changes the digest.
+ *
+ * Unlike MurmurHash3, the fast digest is not an established hash, and
+ * its quality rests on the avalanche, collision, and distribution checks
+ * in test/tests/test_common/digest_check.c.  Only use it to find
+ * candidates that are then confirmed by a byte-for-byte comparison or a
+ * cryptographic hash, as ddup does.  Never let a match on its own decide
+ * that data is equal, e.g., to skip writing a copy.
+ *
+ * Digest values depend on byte order, so they should only be compared
+ * between hosts of the same endianness.
+ *
+ * A tree digest splits a file into leaves of a fixed size, computes
+ * a digest of each leaf, and then combines the leaf digests in order.
+ * Leaves can be hashed by different processes, so that a single large
+ * file can be read in parallel. */
+
+typedef enum {
+    MFU_DIGEST_MURMUR3 = 0,
+    MFU_DIGEST_FAST    = 1,
+} mfu_digest_alg;
+
+/* value of a digest */
+typedef struct mfu_digest_value_struct {
+    uint64_t h[2];
+} mfu_digest_value;
+
+/* Even though the structure is defined here, consider it to be
+ * opaque and only use functions in this file to modify it. */
+typedef struct mfu_digest_ctx_struct {
+    mfu_digest_alg alg;     /* algorithm */
+    uint64_t len;           /* number of bytes hashed so far */
+    uint64_t state[8];      /* running state */
+    uint64_t stripes;       /* number of stripes mixed into state */
+    unsigned char buf[64];  /* bytes that do not yet fill a block */
+    size_t buf_len;         /* number of bytes in buf */
+} mfu_digest_ctx;
+
+/* look up algorithm by name, one of "murmur3" or "fast",
+ * returns 0 on success and -1 if name is not known */
+int mfu_digest_alg_parse(const char* name, mfu_digest_alg* alg);
+
+/* return name of algorithm */
+const char* mfu_digest_alg_name(mfu_digest_alg alg);
+
+/* return name of the code path picked for algorithm on this
+ * processor, e.g., "avx2" or "generic" */
+const char* mfu_digest_impl(mfu_digest_alg alg);
+
+/* use the named code path for the fast digest from now on, one of
+ * "generic", "sse2" or "avx2", returns 0 on success and -1 if it is
+ * not available on this processor, all paths give the same digest */
+int mfu_digest_set_impl(const char* name);
+
+/* start a new digest */
+void mfu_digest_init(mfu_digest_ctx* ctx, mfu_digest_alg alg);
+
+/* add len bytes from buf to the digest */
+void mfu_digest_update(mfu_digest_ctx* ctx, const void* buf, size_t len);
+
+/* compute digest value of all bytes added since init,
+ * call init again before reusing ctx */
+void mfu_digest_final(mfu_digest_ctx* ctx, mfu_digest_value* value);
+
+/* compute digest value of len bytes in buf */
+void mfu_digest_buf(mfu_digest_alg alg, const void* buf, size_t len, mfu_digest_value* value);
+
+/* return number of leaves in a tree digest of a file of file_size bytes,
+ * an empty file has no leaves */
+uint64_t mfu_digest_tree_leaves(uint64_t file_size, uint64_t leaf_size);
+
+/* combine the digests of each leaf of a file, given in order, into the
+ * tree digest of the file, leaves must hold mfu_digest_tree_leaves entries */
+void mfu_digest_tree_combine(
+    mfu_digest_alg alg,
+    uint64_t leaf_size,
+    uint64_t file_size,
+    const mfu_digest_value* leaves,
+    mfu_digest_value* value
+);
+
+#endif /* MFU_DIGEST_H */
+
+/* enable C++ codes to include this header directly */
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
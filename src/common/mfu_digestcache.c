@@ -0,0 +1,417 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "mfu.h"
+
+/* version of the sidecar file format */
+#define DIGESTCACHE_VERSION (1)
+
+/* number of uint64 values in the file header:
+ * version, value bytes, number of records */
+#define DIGESTCACHE_HEADER_VALUES (3)
+
+/* number of bytes in a key */
+#define DIGESTCACHE_KEY_BYTES (MFU_DIGESTCACHE_KEY_VALUES * 8)
+
+/* size of a record in memory: key, value, and a flag
+ * recording whether it was used in this run */
+static size_t digestcache_rec_size(const mfu_digestcache* dc)
+{
+    return DIGESTCACHE_KEY_BYTES + (size_t) dc->value_bytes + 1;
+}
+
+/* size of a record in the file: packed key and value */
+static size_t digestcache_file_rec_size(const mfu_digestcache* dc)
+{
+    return DIGESTCACHE_KEY_BYTES + (size_t) dc->value_bytes;
+}
+
+/* order records by the bytes of their key, which is all
+ * that lookups need, as long as it is used consistently */
+static int digestcache_key_cmp(const void* a, const void* b)
+{
+    return memcmp(a, b, DIGESTCACHE_KEY_BYTES);
+}
+
+/* rank that holds the record with the given key */
+static int digestcache_home(const void* key, int ranks)
+{
+    return (int) (mfu_hash_jenkins((const char*)key, DIGESTCACHE_KEY_BYTES) % (uint32_t) ranks);
+}
+
+/* send count items of item_size bytes from items to the rank that
+ * holds records with the key at the start of each item, order[k] is
+ * set to the index of the k-th item sent and sendcounts to the bytes
+ * sent to each rank, returns buffer of items received and sets
+ * recvcounts to the bytes received from each rank */
+static char* digestcache_send_home(
+    uint64_t count,
+    const char* items,
+    size_t item_size,
+    uint64_t* order,
+    int* sendcounts,
+    int* recvcounts)
+{
+    int ranks;
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    int* home = (int*) MFU_MALLOC(count * sizeof(int));
+    int* offsets = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int j;
+    for (j = 0; j < ranks; j++) {
+        sendcounts[j] = 0;
+    }
+
+    uint64_t i;
+    for (i = 0; i < count; i++) {
+        home[i] = digestcache_home(items + i * item_size, ranks);
+        sendcounts[home[i]]++;
+    }
+
+    int disp = 0;
+    for (j = 0; j < ranks; j++) {
+        offsets[j] = disp;
+        disp += sendcounts[j];
+        sendcounts[j] *= (int) item_size;
+    }
+
+    char* sendbuf = (char*) MFU_MALLOC(count * item_size);
+    for (i = 0; i < count; i++) {
+        int k = offsets[home[i]]++;
+        memcpy(sendbuf + (size_t)k * item_size, items + i * item_size, item_size);
+        if (order != NULL) {
+            order[k] = i;
+        }
+    }
+
+    char* recvbuf = mfu_sidecar_alltoallv(sendbuf, sendcounts, recvcounts);
+
+    mfu_free(&sendbuf);
+    mfu_free(&offsets);
+    mfu_free(&home);
+
+    return recvbuf;
+}
+
+/* add count records of key and value in items to our records, replacing
+ * those with the same key, and mark them as used if used is set */
+static void digestcache_merge(mfu_digestcache* dc, uint64_t count, const char* items, int used)
+{
+    size_t rec_size = digestcache_rec_size(dc);
+    size_t item_size = digestcache_file_rec_size(dc);
+
+    /* replace values of records we have, set aside the rest */
+    char* added = (char*) MFU_MALLOC((dc->count + count) * rec_size);
+    memcpy(added, dc->records, dc->count * rec_size);
+    uint64_t added_count = dc->count;
+
+    uint64_t i;
+    for (i = 0; i < count; i++) {
+        const char* item = items + i * item_size;
+        char* rec = NULL;
+        if (dc->count > 0) {
+            rec = (char*) bsearch(item, added, (size_t)dc->count, rec_size, digestcache_key_cmp);
+        }
+        if (rec == NULL) {
+            rec = added + added_count * rec_size;
+            added_count++;
+        }
+        memcpy(rec, item, item_size);
+        rec[item_size] = (char) used;
+    }
+
+    mfu_free(&dc->records);
+    dc->records = added;
+    dc->count = added_count;
+
+    qsort(dc->records, (size_t)dc->count, rec_size, digestcache_key_cmp);
+}
+
+mfu_digestcache* mfu_digestcache_new(uint64_t value_bytes)
+{
+    mfu_digestcache* dc = (mfu_digestcache*) MFU_MALLOC(sizeof(mfu_digestcache));
+    dc->value_bytes = value_bytes;
+    dc->count       = 0;
+    dc->records     = NULL;
+    return dc;
+}
+
+void mfu_digestcache_delete(mfu_digestcache** pdc)
+{
+    if (pdc != NULL) {
+        mfu_digestcache* dc = *pdc;
+        if (dc != NULL) {
+            mfu_free(&dc->records);
+        }
+        mfu_free(pdc);
+    }
+}
+
+void mfu_digestcache_key(const struct stat* st, uint64_t* key)
+{
+    key[0] = (uint64_t) st->st_dev;
+    key[1] = (uint64_t) st->st_ino;
+    key[2] = (uint64_t) st->st_size;
+    key[3] = (uint64_t) st->st_mtim.tv_sec;
+    key[4] = (uint64_t) st->st_mtim.tv_nsec;
+    key[5] = (uint64_t) st->st_ctim.tv_sec;
+    key[6] = (uint64_t) st->st_ctim.tv_nsec;
+}
+
+int mfu_digestcache_read(const char* name, mfu_digestcache* dc)
+{
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    MPI_File fh;
+    uint64_t header[DIGESTCACHE_HEADER_VALUES];
+    int rc = mfu_sidecar_open(name, "digest cache", DIGESTCACHE_VERSION,
+        DIGESTCACHE_HEADER_VALUES, header, &fh);
+    if (rc > 0) {
+        /* a missing file just means nothing has been recorded yet */
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_INFO, "Digest cache `%s' does not exist, hashing all files", name);
+        }
+        return 0;
+    }
+    if (rc < 0) {
+        return -1;
+    }
+
+    uint64_t value_bytes = header[1];
+    uint64_t all_count   = header[2];
+
+    /* values written by a different tool or with a different layout */
+    if (value_bytes != dc->value_bytes) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_WARN, "Ignoring digest cache `%s' written with %llu byte values",
+                name, (unsigned long long) value_bytes);
+        }
+        MPI_File_close(&fh);
+        return 0;
+    }
+
+    /* split records evenly among ranks */
+    uint64_t start;
+    uint64_t base = mfu_sidecar_split(all_count, &start);
+
+    size_t item_size = digestcache_file_rec_size(dc);
+    char* buf = (char*) MFU_MALLOC(base * (uint64_t) item_size + 1);
+    MPI_Offset offset = (MPI_Offset) (DIGESTCACHE_HEADER_VALUES * 8) +
+        (MPI_Offset) (start * (uint64_t) item_size);
+    mfu_sidecar_read(name, fh, offset, buf, base * (uint64_t) item_size);
+
+    MPI_File_close(&fh);
+
+    /* convert packed keys to native byte order */
+    uint64_t i;
+    for (i = 0; i < base; i++) {
+        char* item = buf + i * item_size;
+        uint64_t key[MFU_DIGESTCACHE_KEY_VALUES];
+        const char* ptr = item;
+        int k;
+        for (k = 0; k < MFU_DIGESTCACHE_KEY_VALUES; k++) {
+            mfu_unpack_uint64(&ptr, &key[k]);
+        }
+        memcpy(item, key, DIGESTCACHE_KEY_BYTES);
+    }
+
+    /* send each record to the rank that holds its key */
+    int* sendcounts = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* recvcounts = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    char* recvbuf = digestcache_send_home(base, buf, item_size, NULL, sendcounts, recvcounts);
+    mfu_free(&buf);
+
+    uint64_t received = 0;
+    int j;
+    for (j = 0; j < ranks; j++) {
+        received += (uint64_t) recvcounts[j] / item_size;
+    }
+    digestcache_merge(dc, received, recvbuf, 0);
+
+    mfu_free(&recvbuf);
+    mfu_free(&recvcounts);
+    mfu_free(&sendcounts);
+
+    if (rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Read %llu records from digest cache `%s'",
+            (unsigned long long) all_count, name);
+    }
+
+    return 0;
+}
+
+void mfu_digestcache_lookup(
+    mfu_digestcache* dc,
+    uint64_t count,
+    const uint64_t* keys,
+    void* values,
+    int* found)
+{
+    int ranks;
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    size_t rec_size = digestcache_rec_size(dc);
+    size_t reply_size = 1 + (size_t) dc->value_bytes;
+
+    /* send keys to the ranks that hold their records */
+    int* sendcounts = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* recvcounts = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    uint64_t* order = (uint64_t*) MFU_MALLOC(count * sizeof(uint64_t));
+    char* requests = digestcache_send_home(count, (const char*)keys, DIGESTCACHE_KEY_BYTES,
+        order, sendcounts, recvcounts);
+
+    /* reply with a found flag and value for each key, in the
+     * order they came in, and mark records found as used */
+    uint64_t received = 0;
+    int j;
+    for (j = 0; j < ranks; j++) {
+        received += (uint64_t) recvcounts[j] / DIGESTCACHE_KEY_BYTES;
+        sendcounts[j] = recvcounts[j] / DIGESTCACHE_KEY_BYTES * (int) reply_size;
+    }
+
+    char* replies = (char*) MFU_MALLOC(received * reply_size);
+    uint64_t i;
+    for (i = 0; i < received; i++) {
+        const char* key = requests + i * DIGESTCACHE_KEY_BYTES;
+        char* reply = replies + i * reply_size;
+        char* rec = NULL;
+        if (dc->count > 0) {
+            rec = (char*) bsearch(key, dc->records, (size_t)dc->count, rec_size, digestcache_key_cmp);
+        }
+        if (rec != NULL) {
+            reply[0] = 1;
+            memcpy(reply + 1, rec + DIGESTCACHE_KEY_BYTES, (size_t)dc->value_bytes);
+            rec[rec_size - 1] = 1;
+        } else {
+            memset(reply, 0, reply_size);
+        }
+    }
+    mfu_free(&requests);
+
+    char* answers = mfu_sidecar_alltoallv(replies, sendcounts, recvcounts);
+    mfu_free(&replies);
+
+    /* replies come back in the order we sent the keys */
+    char* out = (char*) values;
+    for (i = 0; i < count; i++) {
+        const char* answer = answers + i * reply_size;
+        uint64_t idx = order[i];
+        found[idx] = (answer[0] != 0);
+        if (found[idx]) {
+            memcpy(out + idx * dc->value_bytes, answer + 1, (size_t)dc->value_bytes);
+        }
+    }
+
+    mfu_free(&answers);
+    mfu_free(&order);
+    mfu_free(&recvcounts);
+    mfu_free(&sendcounts);
+}
+
+void mfu_digestcache_store(
+    mfu_digestcache* dc,
+    uint64_t count,
+    const uint64_t* keys,
+    const void* values)
+{
+    int ranks;
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* pack each key with its value */
+    size_t item_size = digestcache_file_rec_size(dc);
+    char* items = (char*) MFU_MALLOC(count * item_size);
+    uint64_t i;
+    for (i = 0; i < count; i++) {
+        char* item = items + i * item_size;
+        memcpy(item, keys + i * MFU_DIGESTCACHE_KEY_VALUES, DIGESTCACHE_KEY_BYTES);
+        memcpy(item + DIGESTCACHE_KEY_BYTES,
+            (const char*)values + i * dc->value_bytes, (size_t)dc->value_bytes);
+    }
+
+    /* send them to the ranks that hold their keys */
+    int* sendcounts = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* recvcounts = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    char* recvbuf = digestcache_send_home(count, items, item_size, NULL, sendcounts, recvcounts);
+    mfu_free(&items);
+
+    uint64_t received = 0;
+    int j;
+    for (j = 0; j < ranks; j++) {
+        received += (uint64_t) recvcounts[j] / item_size;
+    }
+    digestcache_merge(dc, received, recvbuf, 1);
+
+    mfu_free(&recvbuf);
+    mfu_free(&recvcounts);
+    mfu_free(&sendcounts);
+}
+
+int mfu_digestcache_write(const char* name, mfu_digestcache* dc)
+{
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    size_t rec_size  = digestcache_rec_size(dc);
+    size_t item_size = digestcache_file_rec_size(dc);
+
+    /* count records used in this run */
+    uint64_t rec_count = 0;
+    uint64_t i;
+    for (i = 0; i < dc->count; i++) {
+        if (dc->records[i * rec_size + rec_size - 1]) {
+            rec_count++;
+        }
+    }
+
+    uint64_t all_count, offset;
+    MPI_Allreduce(&rec_count, &all_count, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Exscan(&rec_count, &offset, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) {
+        offset = 0;
+    }
+
+    uint64_t header[DIGESTCACHE_HEADER_VALUES];
+    header[0] = DIGESTCACHE_VERSION;
+    header[1] = dc->value_bytes;
+    header[2] = all_count;
+    mfu_sidecar* sc = mfu_sidecar_create(name, "digest cache", DIGESTCACHE_HEADER_VALUES, header);
+    if (sc == NULL) {
+        return -1;
+    }
+    mfu_sidecar_start(sc, offset * item_size, rec_count * item_size);
+
+    /* pack each record used in this run */
+    char* item = (char*) MFU_MALLOC(item_size);
+    for (i = 0; i < dc->count; i++) {
+        const char* rec = dc->records + i * rec_size;
+        if (! rec[rec_size - 1]) {
+            continue;
+        }
+
+        char* ptr = item;
+        uint64_t key[MFU_DIGESTCACHE_KEY_VALUES];
+        memcpy(key, rec, DIGESTCACHE_KEY_BYTES);
+        int k;
+        for (k = 0; k < MFU_DIGESTCACHE_KEY_VALUES; k++) {
+            mfu_pack_uint64(&ptr, key[k]);
+        }
+        memcpy(ptr, rec + DIGESTCACHE_KEY_BYTES, (size_t)dc->value_bytes);
+
+        mfu_sidecar_append(sc, item, item_size);
+    }
+    mfu_free(&item);
+
+    int rc = mfu_sidecar_commit(&sc);
+    if (rc == 0 && rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Wrote %llu records to digest cache `%s'",
+            (unsigned long long) all_count, name);
+    }
+    return rc;
+}
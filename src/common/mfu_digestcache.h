@@ -0,0 +1,80 @@
+/* enable C++ codes to include this header directly */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef MFU_DIGESTCACHE_H
+#define MFU_DIGESTCACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/stat.h>
+
+/* A digest cache records values computed from the contents of files,
+ * like hashes, so that they need not be computed again on the next run.
+ * Each record is keyed by the device, inode, size, mtime, and ctime of
+ * its file, so a record is only found while its file is unchanged, and
+ * it follows the file across renames.  Records are saved to a sidecar
+ * file with MPI-IO.
+ *
+ * Records are spread over ranks by hashing their key.  Only records that
+ * were looked up or stored since the cache was read are written back, so
+ * records of files that were deleted or that are no longer of interest
+ * are dropped. */
+
+/* number of uint64 values in a key:
+ * dev, ino, size, mtime, mtime_nsec, ctime, ctime_nsec */
+#define MFU_DIGESTCACHE_KEY_VALUES (7)
+
+typedef struct mfu_digestcache_struct {
+    uint64_t value_bytes;  /* number of bytes in each value */
+    uint64_t count;        /* number of records held by this rank */
+    char* records;         /* key, value, and used flag of each record, sorted by key */
+} mfu_digestcache;
+
+/* allocate an empty cache whose values are value_bytes long */
+mfu_digestcache* mfu_digestcache_new(uint64_t value_bytes);
+
+/* free cache and set pointer to NULL */
+void mfu_digestcache_delete(mfu_digestcache** pdc);
+
+/* fill key with MFU_DIGESTCACHE_KEY_VALUES values from stat data */
+void mfu_digestcache_key(const struct stat* st, uint64_t* key);
+
+/* read records from the sidecar file name, a missing file or one
+ * written with a different value size is treated as empty, returns 0
+ * on success and -1 if the file could not be read, must be called by
+ * all ranks */
+int mfu_digestcache_read(const char* name, mfu_digestcache* dc);
+
+/* look up count keys, each MFU_DIGESTCACHE_KEY_VALUES long, for each
+ * key found, set found[i] to 1 and copy its value to values at offset
+ * i * value_bytes, otherwise set found[i] to 0, must be called by all
+ * ranks */
+void mfu_digestcache_lookup(
+    mfu_digestcache* dc,
+    uint64_t count,
+    const uint64_t* keys,
+    void* values,
+    int* found
+);
+
+/* add count records, replacing any with the same key, values holds
+ * value_bytes for each key, must be called by all ranks */
+void mfu_digestcache_store(
+    mfu_digestcache* dc,
+    uint64_t count,
+    const uint64_t* keys,
+    const void* values
+);
+
+/* write records that were looked up or stored to the sidecar file
+ * name, replacing it once complete, must be called by all ranks */
+int mfu_digestcache_write(const char* name, mfu_digestcache* dc);
+
+#endif /* MFU_DIGESTCACHE_H */
+
+/* enable C++ codes to include this header directly */
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
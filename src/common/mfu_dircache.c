@@ -0,0 +1,671 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "mfu.h"
+
+/* version of the sidecar file format */
+#define DIRCACHE_VERSION (1)
+
+/* number of uint64 values in the file header:
+ * version, runs since last full walk, number of records, chars in key */
+#define DIRCACHE_HEADER_VALUES (4)
+
+/* number of uint64 values recorded for each side of a directory:
+ * mtime, mtime_nsec, ctime, ctime_nsec, size */
+#define DIRCACHE_SIDE_VALUES (5)
+
+/* number of uint64 values that follow the key in each record,
+ * values of the source side, then of the destination side */
+#define DIRCACHE_RECORD_VALUES (2 * DIRCACHE_SIDE_VALUES)
+
+/* fill side values from stat data */
+static void dircache_values(const struct stat* st, uint64_t* vals)
+{
+    mfu_stat_get_mtimes(st, &vals[0], &vals[1]);
+    mfu_stat_get_ctimes(st, &vals[2], &vals[3]);
+    vals[4] = (uint64_t) st->st_size;
+}
+
+/* return 1 if stat data matches recorded side values, 0 otherwise */
+static int dircache_match(const uint64_t* vals, const struct stat* st)
+{
+    uint64_t cur[DIRCACHE_SIDE_VALUES];
+    dircache_values(st, cur);
+    return (memcmp(cur, vals, sizeof(cur)) == 0);
+}
+
+/* rank that holds the record with the given key */
+static int dircache_home(const char* key, int ranks)
+{
+    return (int) (mfu_hash_jenkins(key, strlen(key)) % (uint32_t) ranks);
+}
+
+/* size of a record in memory, a key of chars bytes
+ * followed by the values of both sides */
+static size_t dircache_rec_size(uint64_t chars)
+{
+    return (size_t) chars + DIRCACHE_RECORD_VALUES * sizeof(uint64_t);
+}
+
+/* size of an entry of the walk table, a key of chars bytes
+ * followed by a flag padded to 8 bytes */
+static size_t dircache_entry_size(uint64_t chars)
+{
+    return (size_t) chars + 8;
+}
+
+/* order records or entries by their key, which comes first */
+static int dircache_key_cmp(const void* a, const void* b)
+{
+    return strcmp((const char*) a, (const char*) b);
+}
+
+/* look up key in count items of size bytes that start with their key
+ * and are sorted by it, returns 0 and sets idx if found, -1 otherwise */
+static int dircache_find(const char* items, uint64_t count, size_t size, const char* key, uint64_t* idx)
+{
+    uint64_t low  = 0;
+    uint64_t high = count;
+    while (low < high) {
+        uint64_t mid = low + (high - low) / 2;
+        int cmp = strcmp(items + mid * size, key);
+        if (cmp == 0) {
+            *idx = mid;
+            return 0;
+        } else if (cmp < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return -1;
+}
+
+/* return pointer to values of given side of record idx */
+static uint64_t* dircache_side(const mfu_dircache* dc, uint64_t idx, int side)
+{
+    char* rec = dc->records + idx * dircache_rec_size(dc->chars);
+    return (uint64_t*) (rec + dc->chars) + side * DIRCACHE_SIDE_VALUES;
+}
+
+/* return key of walk table entry idx */
+static const char* dircache_walk_key(const mfu_dircache* dc, uint64_t idx)
+{
+    return dc->walk + idx * dircache_entry_size(dc->chars);
+}
+
+/* copy the key of item to parent_key without its last component,
+ * returns -1 if the key has no parent, which is the case for
+ * the top directory, whose key is empty */
+static int dircache_parent(const char* key, char* parent_key)
+{
+    const char* slash = strrchr(key, '/');
+    if (slash == NULL) {
+        return -1;
+    }
+    size_t len = (size_t)(slash - key);
+    memcpy(parent_key, key, len);
+    parent_key[len] = '\0';
+    return 0;
+}
+
+/* gather bytes from every rank on every rank, returns newly allocated
+ * buffer holding the data of all ranks in rank order and sets total to
+ * its size, must be called by all ranks */
+static char* dircache_allgather(const char* sendbuf, uint64_t bytes, uint64_t* total)
+{
+    int ranks;
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    int sendcount = (int) bytes;
+    int* recvcounts = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* recvdisps  = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    MPI_Allgather(&sendcount, 1, MPI_INT, recvcounts, 1, MPI_INT, MPI_COMM_WORLD);
+
+    uint64_t disp = 0;
+    int i;
+    for (i = 0; i < ranks; i++) {
+        recvdisps[i] = (int) disp;
+        disp += (uint64_t) recvcounts[i];
+    }
+
+    char* recvbuf = (char*) MFU_MALLOC(disp + 1);
+    MPI_Allgatherv((void*)sendbuf, sendcount, MPI_BYTE,
+                   recvbuf, recvcounts, recvdisps, MPI_BYTE, MPI_COMM_WORLD);
+
+    mfu_free(&recvdisps);
+    mfu_free(&recvcounts);
+
+    *total = disp;
+    return recvbuf;
+}
+
+/* send count items of size bytes, each starting with its key, to the
+ * rank that holds records of that key, returns buffer of items received
+ * and sets received to their number, must be called by all ranks */
+static char* dircache_send_home(const char* items, uint64_t count, size_t size, uint64_t* received)
+{
+    int ranks;
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    int* sendcounts = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* recvcounts = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* offsets    = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* homes      = (int*) MFU_MALLOC(count * sizeof(int) + 1);
+
+    int j;
+    for (j = 0; j < ranks; j++) {
+        sendcounts[j] = 0;
+    }
+    uint64_t i;
+    for (i = 0; i < count; i++) {
+        homes[i] = dircache_home(items + i * size, ranks);
+        sendcounts[homes[i]] += (int) size;
+    }
+
+    int disp = 0;
+    for (j = 0; j < ranks; j++) {
+        offsets[j] = disp;
+        disp += sendcounts[j];
+    }
+
+    char* sendbuf = (char*) MFU_MALLOC(count * size + 1);
+    for (i = 0; i < count; i++) {
+        memcpy(sendbuf + offsets[homes[i]], items + i * size, size);
+        offsets[homes[i]] += (int) size;
+    }
+
+    char* recvbuf = mfu_sidecar_alltoallv(sendbuf, sendcounts, recvcounts);
+
+    uint64_t n = 0;
+    for (j = 0; j < ranks; j++) {
+        n += (uint64_t) recvcounts[j] / size;
+    }
+    *received = n;
+
+    mfu_free(&sendbuf);
+    mfu_free(&homes);
+    mfu_free(&offsets);
+    mfu_free(&recvcounts);
+    mfu_free(&sendcounts);
+
+    return recvbuf;
+}
+
+/* check both sides of each record we hold against the file system, and
+ * mark those that are unchanged so that their entries are skipped */
+static uint64_t dircache_check(mfu_dircache* dc)
+{
+    uint64_t skipped = 0;
+    uint64_t i;
+    for (i = 0; i < dc->count; i++) {
+        const char* key = dc->records + i * dircache_rec_size(dc->chars);
+
+        size_t src_len = strlen(dc->src_prefix) + strlen(key) + 1;
+        size_t dst_len = strlen(dc->dst_prefix) + strlen(key) + 1;
+        char* src_path = (char*) MFU_MALLOC(src_len);
+        char* dst_path = (char*) MFU_MALLOC(dst_len);
+        snprintf(src_path, src_len, "%s%s", dc->src_prefix, key);
+        snprintf(dst_path, dst_len, "%s%s", dc->dst_prefix, key);
+
+        struct stat src_st, dst_st;
+        dc->skip[i] = (mfu_lstat(src_path, &src_st) == 0 && S_ISDIR(src_st.st_mode) &&
+                       dircache_match(dircache_side(dc, i, 0), &src_st) &&
+                       mfu_lstat(dst_path, &dst_st) == 0 && S_ISDIR(dst_st.st_mode) &&
+                       dircache_match(dircache_side(dc, i, 1), &dst_st));
+        skipped += dc->skip[i];
+
+        mfu_free(&dst_path);
+        mfu_free(&src_path);
+    }
+    return skipped;
+}
+
+/* give every rank the keys of directories whose entries are skipped,
+ * along with the keys of their recorded subdirectories, which the walks
+ * visit in place of the entries, since any rank may walk any directory */
+static void dircache_build_walk(mfu_dircache* dc)
+{
+    size_t rec_size   = dircache_rec_size(dc->chars);
+    size_t entry_size = dircache_entry_size(dc->chars);
+
+    /* gather keys of all skipped directories */
+    char* keys = (char*) MFU_MALLOC(dc->count * dc->chars + 1);
+    uint64_t n = 0;
+    uint64_t i;
+    for (i = 0; i < dc->count; i++) {
+        if (dc->skip[i]) {
+            memcpy(keys + n * dc->chars, dc->records + i * rec_size, dc->chars);
+            n++;
+        }
+    }
+    uint64_t total;
+    char* skipped = dircache_allgather(keys, n * dc->chars, &total);
+    uint64_t skipped_count = total / dc->chars;
+    qsort(skipped, (size_t) skipped_count, (size_t) dc->chars, dircache_key_cmp);
+    mfu_free(&keys);
+
+    /* gather entries for records that are skipped or whose parent is */
+    char* entries = (char*) MFU_MALLOC(dc->count * entry_size + 1);
+    char* parent_key = (char*) MFU_MALLOC(dc->chars);
+    n = 0;
+    for (i = 0; i < dc->count; i++) {
+        const char* key = dc->records + i * rec_size;
+        uint64_t parent;
+        int child = (dircache_parent(key, parent_key) == 0 &&
+                     dircache_find(skipped, skipped_count, dc->chars, parent_key, &parent) == 0);
+        if (dc->skip[i] || child) {
+            char* entry = entries + n * entry_size;
+            memset(entry, 0, entry_size);
+            memcpy(entry, key, dc->chars);
+            entry[dc->chars] = (char) dc->skip[i];
+            n++;
+        }
+    }
+    mfu_free(&skipped);
+
+    dc->walk = dircache_allgather(entries, n * entry_size, &total);
+    dc->walk_count = total / entry_size;
+    qsort(dc->walk, (size_t) dc->walk_count, entry_size, dircache_key_cmp);
+    mfu_free(&entries);
+
+    /* index subdirectories of each entry, the top directory has an empty key */
+    uint64_t count = dc->walk_count;
+    uint64_t* parents = (uint64_t*) MFU_MALLOC(count * sizeof(uint64_t) + 1);
+    dc->child_start = (uint64_t*) MFU_MALLOC((count + 1) * sizeof(uint64_t));
+    for (i = 0; i <= count; i++) {
+        dc->child_start[i] = 0;
+    }
+    for (i = 0; i < count; i++) {
+        parents[i] = UINT64_MAX;
+        uint64_t parent;
+        if (dircache_parent(dircache_walk_key(dc, i), parent_key) == 0 &&
+            dircache_find(dc->walk, count, entry_size, parent_key, &parent) == 0)
+        {
+            parents[i] = parent;
+            dc->child_start[parent + 1]++;
+        }
+    }
+    mfu_free(&parent_key);
+
+    /* group children by parent */
+    for (i = 0; i < count; i++) {
+        dc->child_start[i + 1] += dc->child_start[i];
+    }
+    uint64_t* fill = (uint64_t*) MFU_MALLOC((count + 1) * sizeof(uint64_t));
+    memcpy(fill, dc->child_start, (count + 1) * sizeof(uint64_t));
+    dc->children = (uint64_t*) MFU_MALLOC((dc->child_start[count] + 1) * sizeof(uint64_t));
+    for (i = 0; i < count; i++) {
+        if (parents[i] != UINT64_MAX) {
+            dc->children[fill[parents[i]]] = i;
+            fill[parents[i]]++;
+        }
+    }
+    mfu_free(&fill);
+    mfu_free(&parents);
+}
+
+/* free paths handed to the walk on the previous call */
+static void dircache_free_paths(mfu_dircache* dc)
+{
+    uint64_t i;
+    for (i = 0; i < dc->paths_count; i++) {
+        mfu_free(&dc->paths[i]);
+    }
+    mfu_free(&dc->paths);
+    dc->paths_count = 0;
+}
+
+/* called for each directory of a walk, skips its entries if it is
+ * unchanged on both sides, and returns its recorded subdirectories
+ * under prefix to walk instead */
+static const char** dircache_walk_fn(mfu_dircache* dc, const char* prefix, const char* path, uint64_t* count)
+{
+    /* find entry for this directory */
+    size_t prefix_len = strlen(prefix);
+    if (strncmp(path, prefix, prefix_len) != 0) {
+        return NULL;
+    }
+    const char* key = path + prefix_len;
+    size_t entry_size = dircache_entry_size(dc->chars);
+    uint64_t idx;
+    if (dircache_find(dc->walk, dc->walk_count, entry_size, key, &idx) != 0 ||
+        ! dc->walk[idx * entry_size + dc->chars])
+    {
+        return NULL;
+    }
+
+    /* skip entries, walk subdirectories we had last time */
+    dircache_free_paths(dc);
+
+    uint64_t start = dc->child_start[idx];
+    uint64_t n     = dc->child_start[idx + 1] - start;
+    dc->paths = (char**) MFU_MALLOC((n + 1) * sizeof(char*));
+
+    uint64_t i;
+    for (i = 0; i < n; i++) {
+        const char* child = dircache_walk_key(dc, dc->children[start + i]);
+        size_t len = prefix_len + strlen(child) + 1;
+        dc->paths[i] = (char*) MFU_MALLOC(len);
+        snprintf(dc->paths[i], len, "%s%s", prefix, child);
+    }
+    dc->paths_count = n;
+
+    *count = n;
+    return (const char**) dc->paths;
+}
+
+static const char** dircache_walk_src_fn(const char* path, const struct stat* st, uint64_t* count, void* arg)
+{
+    mfu_dircache* dc = (mfu_dircache*) arg;
+    return dircache_walk_fn(dc, dc->src_prefix, path, count);
+}
+
+static const char** dircache_walk_dst_fn(const char* path, const struct stat* st, uint64_t* count, void* arg)
+{
+    mfu_dircache* dc = (mfu_dircache*) arg;
+    return dircache_walk_fn(dc, dc->dst_prefix, path, count);
+}
+
+mfu_dircache* mfu_dircache_read(
+    const char* name,
+    const char* src_prefix,
+    const char* dst_prefix,
+    uint64_t full_every)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    mfu_dircache* dc = (mfu_dircache*) MFU_MALLOC(sizeof(mfu_dircache));
+    dc->src_prefix  = MFU_STRDUP(src_prefix);
+    dc->dst_prefix  = MFU_STRDUP(dst_prefix);
+    dc->runs        = 0;
+    dc->use         = 0;
+    dc->chars       = 8;
+    dc->count       = 0;
+    dc->records     = NULL;
+    dc->skip        = NULL;
+    dc->walk_count  = 0;
+    dc->walk        = NULL;
+    dc->child_start = NULL;
+    dc->children    = NULL;
+    dc->paths       = NULL;
+    dc->paths_count = 0;
+
+    MPI_File fh;
+    uint64_t header[DIRCACHE_HEADER_VALUES];
+    int rc = mfu_sidecar_open(name, "directory cache", DIRCACHE_VERSION,
+        DIRCACHE_HEADER_VALUES, header, &fh);
+    if (rc > 0) {
+        /* a missing file just means nothing has been recorded yet */
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_INFO, "Directory cache `%s' does not exist, walking all directories", name);
+        }
+        return dc;
+    }
+    if (rc < 0) {
+        return dc;
+    }
+
+    uint64_t runs      = header[1];
+    uint64_t all_count = header[2];
+    uint64_t chars     = header[3];
+
+    if (chars == 0 || chars % 8 != 0) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "Directory cache `%s' has invalid key size %llu, walking all directories",
+                name, (unsigned long long) chars);
+        }
+        MPI_File_close(&fh);
+        return dc;
+    }
+    dc->runs = runs;
+
+    /* periodically walk everything to find changes to files,
+     * which do not show up in the directories that hold them */
+    if (full_every <= 1 || runs + 1 >= full_every) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_INFO, "Walking all directories, %llu runs since last full walk",
+                (unsigned long long) runs);
+        }
+        MPI_File_close(&fh);
+        return dc;
+    }
+
+    /* read our share of the records */
+    size_t file_rec_size = (size_t) chars + DIRCACHE_RECORD_VALUES * 8;
+    uint64_t start;
+    uint64_t read_count = mfu_sidecar_split(all_count, &start);
+    char* buf = (char*) MFU_MALLOC(read_count * file_rec_size + 1);
+    MPI_Offset offset = (MPI_Offset) (DIRCACHE_HEADER_VALUES * 8) +
+        (MPI_Offset) (start * file_rec_size);
+    mfu_sidecar_read(name, fh, offset, buf, read_count * file_rec_size);
+    MPI_File_close(&fh);
+
+    /* unpack records */
+    size_t rec_size = dircache_rec_size(chars);
+    char* recs = (char*) MFU_MALLOC(read_count * rec_size + 1);
+    uint64_t r;
+    for (r = 0; r < read_count; r++) {
+        const char* ptr = buf + r * file_rec_size;
+        char* rec = recs + r * rec_size;
+        memcpy(rec, ptr, chars);
+        rec[chars - 1] = '\0';
+        ptr += chars;
+
+        uint64_t* vals = (uint64_t*) (rec + chars);
+        int j;
+        for (j = 0; j < DIRCACHE_RECORD_VALUES; j++) {
+            mfu_unpack_uint64(&ptr, &vals[j]);
+        }
+    }
+    mfu_free(&buf);
+
+    /* send each record to the rank responsible for its key */
+    dc->chars   = chars;
+    dc->records = dircache_send_home(recs, read_count, rec_size, &dc->count);
+    qsort(dc->records, (size_t) dc->count, rec_size, dircache_key_cmp);
+    mfu_free(&recs);
+
+    /* check our records, then share which directories to skip */
+    dc->skip = (uint8_t*) MFU_MALLOC(dc->count + 1);
+    uint64_t skipped = dircache_check(dc);
+    dircache_build_walk(dc);
+    dc->use = 1;
+
+    uint64_t all_skipped;
+    MPI_Allreduce(&skipped, &all_skipped, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Read %llu directory records from `%s', skipping entries of %llu unchanged directories",
+            (unsigned long long) all_count, name, (unsigned long long) all_skipped);
+    }
+
+    return dc;
+}
+
+void mfu_dircache_delete(mfu_dircache** pdc)
+{
+    if (pdc != NULL) {
+        mfu_dircache* dc = *pdc;
+        if (dc != NULL) {
+            dircache_free_paths(dc);
+            mfu_free(&dc->children);
+            mfu_free(&dc->child_start);
+            mfu_free(&dc->walk);
+            mfu_free(&dc->skip);
+            mfu_free(&dc->records);
+            mfu_free(&dc->dst_prefix);
+            mfu_free(&dc->src_prefix);
+        }
+        mfu_free(pdc);
+    }
+}
+
+void mfu_dircache_walk_src(mfu_dircache* dc, mfu_walk_opts_t* opts)
+{
+    opts->dir_fn  = NULL;
+    opts->dir_arg = NULL;
+    if (dc->use) {
+        opts->dir_fn  = dircache_walk_src_fn;
+        opts->dir_arg = dc;
+    }
+}
+
+void mfu_dircache_walk_dst(mfu_dircache* dc, mfu_walk_opts_t* opts)
+{
+    opts->dir_fn  = NULL;
+    opts->dir_arg = NULL;
+    if (dc->use) {
+        opts->dir_fn  = dircache_walk_dst_fn;
+        opts->dir_arg = dc;
+    }
+}
+
+int mfu_dircache_write(const char* name, mfu_dircache* dc, mfu_flist src_list)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    /* find the longest key of a source directory */
+    size_t prefix_len = strlen(dc->src_prefix);
+    uint64_t size = mfu_flist_size(src_list);
+    uint64_t max_key = 0;
+    uint64_t idx;
+    for (idx = 0; idx < size; idx++) {
+        const char* file = mfu_flist_file_get_name(src_list, idx);
+        if (mfu_flist_file_get_type(src_list, idx) == MFU_TYPE_DIR &&
+            strncmp(file, dc->src_prefix, prefix_len) == 0)
+        {
+            uint64_t keylen = (uint64_t) strlen(file + prefix_len) + 1;
+            if (keylen > max_key) {
+                max_key = keylen;
+            }
+        }
+    }
+
+    /* pad keys to a multiple of 8 bytes, and keep room
+     * for the keys of records we still hold */
+    uint64_t all_max_key;
+    MPI_Allreduce(&max_key, &all_max_key, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
+    uint64_t chars = (all_max_key + 7) / 8 * 8;
+    if (chars < dc->chars) {
+        chars = dc->chars;
+    }
+    size_t rec_size = dircache_rec_size(chars);
+
+    /* build records for source directories that exist in the destination,
+     * take source values from the walk, since a change made to the source
+     * after the walk was not synced, and destination values from now,
+     * since the sync changed them */
+    char* recs = (char*) MFU_MALLOC(size * rec_size + 1);
+    uint64_t count = 0;
+    for (idx = 0; idx < size; idx++) {
+        if (mfu_flist_file_get_type(src_list, idx) != MFU_TYPE_DIR) {
+            continue;
+        }
+
+        const char* file = mfu_flist_file_get_name(src_list, idx);
+        if (strncmp(file, dc->src_prefix, prefix_len) != 0) {
+            continue;
+        }
+        const char* key = file + prefix_len;
+
+        size_t len = strlen(dc->dst_prefix) + strlen(key) + 1;
+        char* dst_path = (char*) MFU_MALLOC(len);
+        snprintf(dst_path, len, "%s%s", dc->dst_prefix, key);
+        struct stat dst_st;
+        int found = (mfu_lstat(dst_path, &dst_st) == 0 && S_ISDIR(dst_st.st_mode));
+        mfu_free(&dst_path);
+        if (! found) {
+            continue;
+        }
+
+        char* rec = recs + count * rec_size;
+        memset(rec, 0, chars);
+        strncpy(rec, key, chars);
+
+        uint64_t* vals = (uint64_t*) (rec + chars);
+        vals[0] = mfu_flist_file_get_mtime(src_list, idx);
+        vals[1] = mfu_flist_file_get_mtime_nsec(src_list, idx);
+        vals[2] = mfu_flist_file_get_ctime(src_list, idx);
+        vals[3] = mfu_flist_file_get_ctime_nsec(src_list, idx);
+        vals[4] = mfu_flist_file_get_size(src_list, idx);
+        dircache_values(&dst_st, vals + DIRCACHE_SIDE_VALUES);
+
+        count++;
+    }
+
+    /* send records to the ranks that hold the old ones */
+    uint64_t rec_count;
+    char* home = dircache_send_home(recs, count, rec_size, &rec_count);
+    mfu_free(&recs);
+
+    /* a source directory whose entries were skipped may have changed
+     * after we checked it, keep its old values so that the change is found
+     * on the next run, rather than recording a state whose entries we never
+     * saw, the destination values are taken from now, since setting the
+     * attributes of the directory during the sync changes its ctime */
+    size_t old_size = dircache_rec_size(dc->chars);
+    uint64_t r;
+    for (r = 0; r < rec_count; r++) {
+        char* rec = home + r * rec_size;
+        uint64_t old;
+        if (dc->use &&
+            dircache_find(dc->records, dc->count, old_size, rec, &old) == 0 &&
+            dc->skip[old])
+        {
+            memcpy(rec + chars, dircache_side(dc, old, 0), DIRCACHE_SIDE_VALUES * sizeof(uint64_t));
+        }
+    }
+
+    uint64_t all_count, offset;
+    MPI_Allreduce(&rec_count, &all_count, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Exscan(&rec_count, &offset, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) {
+        offset = 0;
+    }
+
+    /* count this run toward the next full walk unless we just did one */
+    uint64_t header[DIRCACHE_HEADER_VALUES];
+    header[0] = DIRCACHE_VERSION;
+    header[1] = dc->use ? dc->runs + 1 : 0;
+    header[2] = all_count;
+    header[3] = chars;
+    mfu_sidecar* sc = mfu_sidecar_create(name, "directory cache", DIRCACHE_HEADER_VALUES, header);
+    if (sc == NULL) {
+        mfu_free(&home);
+        return -1;
+    }
+
+    size_t file_rec_size = (size_t) chars + DIRCACHE_RECORD_VALUES * 8;
+    mfu_sidecar_start(sc, offset * file_rec_size, rec_count * file_rec_size);
+
+    char* packed = (char*) MFU_MALLOC(file_rec_size);
+    for (r = 0; r < rec_count; r++) {
+        const char* rec = home + r * rec_size;
+        char* ptr = packed;
+        memcpy(ptr, rec, chars);
+        ptr += chars;
+
+        const uint64_t* vals = (const uint64_t*) (rec + chars);
+        int j;
+        for (j = 0; j < DIRCACHE_RECORD_VALUES; j++) {
+            mfu_pack_uint64(&ptr, vals[j]);
+        }
+
+        mfu_sidecar_append(sc, packed, file_rec_size);
+    }
+    mfu_free(&packed);
+    mfu_free(&home);
+
+    int rc = mfu_sidecar_commit(&sc);
+    if (rc == 0 && rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Wrote %llu directory records to `%s'",
+            (unsigned long long) all_count, name);
+    }
+    return rc;
+}
@@ -0,0 +1,83 @@
+/* enable C++ codes to include this header directly */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef MFU_DIRCACHE_H
+#define MFU_DIRCACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "mfu_flist.h"
+#include "mfu_param_path.h"
+
+/* A directory cache records the mtime, ctime, and size of each directory
+ * that exists under both a source and a destination path after they were
+ * synchronized.  Records are keyed by the directory path relative to the
+ * source and destination paths, and they are saved to a sidecar file.
+ *
+ * On the next run, the cache hooks into the walks of both paths.  When a
+ * directory matches its record on both sides, nothing has been added to,
+ * removed from, or renamed within it on either side, so the walks skip
+ * its entries and only descend into the subdirectories it had last time.
+ * Both walks skip the same directories, so items in them are missing from
+ * both lists and are treated as identical.
+ *
+ * Changes to the contents or attributes of files do not update the
+ * directory that holds them, so such changes are only found by a full
+ * walk.  To bound how long they go unnoticed, every full_every-th run
+ * ignores the cache and walks everything.
+ *
+ * Records are spread over ranks by a hash of their key.  Each rank checks
+ * the records it holds against both sides when the file is read, then
+ * every rank is given the keys of the directories to skip and of their
+ * recorded subdirectories, since any rank may walk any directory. */
+
+typedef struct mfu_dircache_struct {
+    char* src_prefix;       /* source path, stripped from names to form keys */
+    char* dst_prefix;       /* destination path, stripped from names to form keys */
+    uint64_t runs;          /* runs since the last full walk when the file was written */
+    int use;                /* whether records may be used to skip directories this run */
+    uint64_t count;         /* number of records held by this rank */
+    uint64_t chars;         /* number of bytes for each key */
+    char* records;          /* key and stat values of both sides of each record held, sorted by key */
+    uint8_t* skip;          /* whether entries of each record held are skipped in this run */
+    uint64_t walk_count;    /* number of entries in walk table */
+    char* walk;             /* key and skip flag of skipped directories and their subdirectories, sorted */
+    uint64_t* child_start;  /* index in children of first subdirectory of each walk entry, walk_count + 1 entries */
+    uint64_t* children;     /* walk entry index of subdirectories, grouped by parent */
+    char** paths;           /* paths handed to the walk in place of entries */
+    uint64_t paths_count;   /* number of allocated paths */
+} mfu_dircache;
+
+/* read records from the sidecar file name, full_every gives how often
+ * a full walk is forced, where 1 walks everything on every run, a missing
+ * file gives an empty cache, must be called by all ranks */
+mfu_dircache* mfu_dircache_read(
+    const char* name,
+    const char* src_prefix,
+    const char* dst_prefix,
+    uint64_t full_every
+);
+
+/* free cache and set pointer to NULL */
+void mfu_dircache_delete(mfu_dircache** pdc);
+
+/* set walk options to skip unchanged directories when walking the source */
+void mfu_dircache_walk_src(mfu_dircache* dc, mfu_walk_opts_t* opts);
+
+/* set walk options to skip the same directories when walking the destination */
+void mfu_dircache_walk_dst(mfu_dircache* dc, mfu_walk_opts_t* opts);
+
+/* write a record for each directory in src_list that also exists
+ * in the destination, to the sidecar file name, replacing it once
+ * complete, call after the sync is complete, must be called by all ranks */
+int mfu_dircache_write(const char* name, mfu_dircache* dc, mfu_flist src_list);
+
+#endif /* MFU_DIRCACHE_H */
+
+/* enable C++ codes to include this header directly */
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
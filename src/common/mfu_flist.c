@@ -64,6 +64,14 @@ mfu_walk_opts_t* mfu_walk_opts_new(void)
     /* Don't stat files in walk by default */
     opts->use_stat = 1;
 
+    /* No per-item callback by default */
+    opts->item_fn  = NULL;
+    opts->item_arg = NULL;
+
+    /* Read every directory by default */
+    opts->dir_fn  = NULL;
+    opts->dir_arg = NULL;
+
     return opts;
 }
 
@@ -389,6 +397,11 @@ static elem_t* list_get_elem(flist_t* flist, uint64_t idx)
     return NULL;
 }
 
+elem_t* mfu_flist_get_elem(flist_t* flist, uint64_t idx)
+{
+    return list_get_elem(flist, idx);
+}
+
 static void list_compute_summary(flist_t* flist)
 {
     /* initialize summary values */
@@ -65,6 +65,13 @@ extern "C" {
 /* default buffer size to read/write data to file system */
 #define FD_BLOCK_SIZE (1*1024*1024)
 
+/* minimum file size to bypass or drop the page cache with --adaptive-io,
+ * smaller files go through the page cache as usual */
+#define FD_ADAPTIVE_MIN_SIZE (64*1024*1024)
+
+/* alignment of file offsets, lengths, and buffers for O_DIRECT */
+#define FD_DIRECT_ALIGN (4096)
+
 /*
  * FIXME: Is this description correct?
  *
@@ -272,6 +279,12 @@ void mfu_flist_read_cache(
     mfu_flist flist
 );
 
+/* return the deepest path that is or contains every item in the
+ * list, such as the root that was walked to create a cache file,
+ * returns a newly allocated string that the caller must free, or
+ * NULL if the list is empty on all ranks, must be called by all ranks */
+char* mfu_flist_common_prefix(mfu_flist flist);
+
 /* write file list to file */
 void mfu_flist_write_cache(
     const char* name,
@@ -284,6 +297,47 @@ void mfu_flist_write_text(
     mfu_flist flist
 );
 
+/* A writer streams selected items of one or more lists to a file in the
+ * format of mfu_flist_write_cache or mfu_flist_write_text without first
+ * copying them into a new list.  Items are written in the order they are
+ * added, with all items of rank 0 first, then those of rank 1, and so on.
+ * Since offsets depend on what every rank writes, each item is passed
+ * twice, first to count it and then to add it:
+ *
+ *   w = mfu_flist_writer_new(name, flist, cache)
+ *   for each item: mfu_flist_writer_count(w, list, idx)
+ *   mfu_flist_writer_start(w)
+ *   for each item: mfu_flist_writer_add(w, list, idx)
+ *     and now and then mfu_flist_writer_flush(w)
+ *   mfu_flist_writer_close(&w)
+ *
+ * Added items are buffered until the next flush, so the caller bounds
+ * memory use by how many items it adds between flushes.  Each list
+ * passed in must have the same detail as flist, whose user and group
+ * names are recorded in cache files. */
+typedef struct mfu_flist_writer_struct mfu_flist_writer;
+
+/* create a writer to the file name, cache=1 for the format of
+ * mfu_flist_write_cache, cache=0 for that of mfu_flist_write_text */
+mfu_flist_writer* mfu_flist_writer_new(const char* name, mfu_flist flist, int cache);
+
+/* count an item that this rank will add */
+void mfu_flist_writer_count(mfu_flist_writer* w, mfu_flist flist, uint64_t idx);
+
+/* open the file and write its header once all items are counted,
+ * must be called by all ranks */
+void mfu_flist_writer_start(mfu_flist_writer* w);
+
+/* buffer an item to be written, in the order it was counted */
+void mfu_flist_writer_add(mfu_flist_writer* w, mfu_flist flist, uint64_t idx);
+
+/* write buffered items, must be called by all ranks the same number of times */
+void mfu_flist_writer_flush(mfu_flist_writer* w);
+
+/* write remaining items, close the file, and free the writer,
+ * must be called by all ranks */
+void mfu_flist_writer_close(mfu_flist_writer** pw);
+
 /* given a list of files print from start and end of the list */
 void mfu_flist_print(mfu_flist flist);
 
@@ -463,6 +517,22 @@ int mfu_flist_copy(
     mfu_file_t* mfu_dst_file        /* IN - I/O filesystem functions to use for copy of dst */
 );
 
+/* walk source paths and copy items to destination while the walk
+ * is still running, directories, links, and files that fit in a single
+ * chunk are copied by the process that finds them, larger files are
+ * copied in chunks once the walk completes, walked items are recorded
+ * in flist, returns 0 on success -1 on error */
+int mfu_flist_walk_copy(
+    int numpaths,                   /* IN - number of source paths */
+    const mfu_param_path* paths,    /* IN - array of source paths */
+    const mfu_param_path* destpath, /* IN - destination path */
+    mfu_walk_opts_t* walk_opts,     /* IN - options to be used during walk */
+    mfu_flist flist,                /* OUT - flist of walked items */
+    mfu_copy_opts_t* mfu_copy_opts, /* IN - options to be used during copy */
+    mfu_file_t* mfu_src_file,       /* IN - I/O filesystem functions to use for copy of src */
+    mfu_file_t* mfu_dst_file        /* IN - I/O filesystem functions to use for copy of dst */
+);
+
 /* link items in list from source paths to destination,
  * each item in source list must come from the
  * source path, returns 0 on success -1 on error */
@@ -537,6 +607,9 @@ int mfu_flist_file_sync_meta(mfu_flist src_list, uint64_t src_index,
                              mfu_file_t* mfu_file);
 
 /* TODO: integrate this into the file list proper, or otherwise move it to another file */
+/* value of ost in a chunk whose OST is not known */
+#define MFU_FILE_CHUNK_OST_UNKNOWN (UINT64_MAX)
+
 /* element structure in linked list returned by mfu_file_chunk_list_alloc */
 typedef struct mfu_file_chunk_struct {
   const char* name;        /* full path to file name */
@@ -545,6 +618,7 @@ typedef struct mfu_file_chunk_struct {
   uint64_t file_size;      /* full size of target file */
   uint64_t rank_of_owner;  /* MPI rank acting as the owner of this file */
   uint64_t index_of_owner; /* index value of file in original flist on its owner rank */
+  uint64_t ost;            /* index of OST holding first byte of chunk, or MFU_FILE_CHUNK_OST_UNKNOWN */
   struct mfu_file_chunk_struct* next; /* pointer to next chunk element */
 } mfu_file_chunk;
 
@@ -553,6 +627,32 @@ typedef struct mfu_file_chunk_struct {
  * is responsbile for */
 mfu_file_chunk* mfu_file_chunk_list_alloc(mfu_flist list, uint64_t chunk_size);
 
+/* like mfu_file_chunk_list_alloc, but queries the stripe layout of each file
+ * and cuts chunks at stripe boundaries, each chunk is either a whole number of
+ * stripes or an even fraction of one, and it records the OST holding its first
+ * byte, if sim_osts > 0, every file is instead assumed to have sim_stripe_count
+ * stripes of sim_stripe_size bytes starting on an OST picked by hashing its name
+ * out of sim_osts OSTs, which allows testing without a Lustre file system */
+mfu_file_chunk* mfu_file_chunk_list_alloc_stripe(
+    mfu_flist list,            /* IN - input flist */
+    uint64_t chunk_size,       /* IN - requested chunk size in bytes */
+    uint64_t sim_stripe_size,  /* IN - simulated stripe size in bytes */
+    uint64_t sim_stripe_count, /* IN - simulated number of stripes per file */
+    uint64_t sim_osts          /* IN - simulated number of OSTs, 0 to query real layout */
+);
+
+/* given a chunk list, compute the order in which this process should work
+ * through its chunks so that at each step, processes tend to target distinct
+ * OSTs, chunks whose OST is not known come last in list order, order must
+ * have space for one entry per chunk and on return order[k] is the position
+ * in the list of the k-th chunk to process, this is collective */
+void mfu_file_chunk_list_ost_order(const mfu_file_chunk* head, uint64_t* order);
+
+/* print the number of processes targeting each OST at each step when processing
+ * chunks in the given order, along with the number of steps at which two or more
+ * processes target the same OST, this is collective */
+void mfu_file_chunk_list_print_ost_schedule(const mfu_file_chunk* head, const uint64_t* order);
+
 /* free the linked list allocated with mfu_file_chunk_list_alloc */
 void mfu_file_chunk_list_free(mfu_file_chunk** phead);
 
@@ -570,6 +670,27 @@ void mfu_file_chunk_list_lor(
     int* results                /* OUT - array of output, storing logical OR across all chunks for each item in flist */
 );
 
+/* given an flist, a file chunk list generated from that flist,
+ * and an input array of values with one element per chunk,
+ * compute the minimum per item in the flist, and return the result
+ * to the process owning that item in the flist */
+void mfu_file_chunk_list_min(
+    mfu_flist list,             /* IN  - input flist */
+    const mfu_file_chunk* head, /* IN  - chunk list generated from flist */
+    const uint64_t* vals,       /* IN  - array of values, one element for each chunk in the chunk list */
+    uint64_t* results           /* OUT - array of output, storing minimum across all chunks for each item in flist */
+);
+
+/* given an flist, a file chunk list generated from that flist,
+ * and the offset of the first differing byte found in each chunk,
+ * UINT64_MAX if none, log the offset at which each file first differs,
+ * collective */
+void mfu_file_chunk_list_print_offsets(
+    mfu_flist list,             /* IN  - input flist */
+    const mfu_file_chunk* head, /* IN  - chunk list generated from flist */
+    const uint64_t* offsets     /* IN  - array of offsets, one element for each chunk in the chunk list */
+);
+
 #endif /* MFU_FLIST_H */
 
 /* enable C++ codes to include this header directly */
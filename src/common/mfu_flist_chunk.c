@@ -32,16 +32,131 @@ static int map_chunk_to_rank(uint64_t offset, uint64_t cutoff, uint64_t chunks_p
     return rank;
 }
 
+/* describes how the chunks of a single file are laid out */
+typedef struct {
+    uint64_t chunk_size;   /* number of bytes in each chunk of this file */
+    uint64_t stripe_size;  /* stripe size of file, 0 if not striped */
+    uint64_t stripe_count; /* number of stripes in file */
+    uint64_t* osts;        /* OST index of each stripe */
+} mfu_chunk_layout;
+
+/* given a stripe size and the chunk size requested by the user,
+ * compute a chunk size that does not straddle stripe boundaries,
+ * either a multiple of the stripe size or a divisor of it */
+static uint64_t stripe_align_chunk_size(uint64_t chunk_size, uint64_t stripe_size)
+{
+    /* round down to a whole number of stripes if chunk is at least one stripe */
+    if (chunk_size >= stripe_size) {
+        return (chunk_size / stripe_size) * stripe_size;
+    }
+
+    /* otherwise split stripe into equal pieces no larger than the chunk size */
+    uint64_t aligned = stripe_size;
+    while (aligned > chunk_size && aligned % 2 == 0) {
+        aligned /= 2;
+    }
+    return aligned;
+}
+
+/* compute layout for each file in the list, if stripe is set, query
+ * striping info of each file (or apply simulated striping if sim_osts > 0)
+ * to align chunks to stripe boundaries and record the OST of each stripe */
+static mfu_chunk_layout* chunk_layouts_alloc(mfu_flist list, uint64_t chunk_size,
+    int stripe, uint64_t sim_stripe_size, uint64_t sim_stripe_count, uint64_t sim_osts)
+{
+    uint64_t idx;
+    uint64_t size = mfu_flist_size(list);
+    mfu_chunk_layout* layouts = (mfu_chunk_layout*) MFU_MALLOC(size * sizeof(mfu_chunk_layout));
+    for (idx = 0; idx < size; idx++) {
+        mfu_chunk_layout* layout = &layouts[idx];
+        layout->chunk_size   = chunk_size;
+        layout->stripe_size  = 0;
+        layout->stripe_count = 0;
+        layout->osts         = NULL;
+
+        /* only regular files are striped */
+        mfu_filetype type = mfu_flist_file_get_type(list, idx);
+        if (! stripe || type != MFU_TYPE_FILE) {
+            continue;
+        }
+
+        const char* name = mfu_flist_file_get_name(list, idx);
+        uint64_t stripe_size  = 0;
+        uint64_t stripe_count = 0;
+        if (sim_osts > 0) {
+            /* simulate a layout that starts each file on an OST
+             * picked by hashing its name, like the Lustre allocator
+             * spreading new files over OSTs */
+            stripe_size  = sim_stripe_size;
+            stripe_count = (sim_stripe_count < sim_osts) ? sim_stripe_count : sim_osts;
+            if (stripe_size > 0 && stripe_count > 0) {
+                uint64_t first = (uint64_t) mfu_hash_jenkins(name, strlen(name)) % sim_osts;
+                layout->osts = (uint64_t*) MFU_MALLOC(stripe_count * sizeof(uint64_t));
+                uint64_t i;
+                for (i = 0; i < stripe_count; i++) {
+                    layout->osts[i] = (first + i) % sim_osts;
+                }
+            }
+        } else if (mfu_stripe_get(name, &stripe_size, &stripe_count) == 0 &&
+                   stripe_size > 0 && stripe_count > 0)
+        {
+            /* look up OST of each stripe */
+            layout->osts = (uint64_t*) MFU_MALLOC(stripe_count * sizeof(uint64_t));
+            if (mfu_stripe_get_osts(name, stripe_count, layout->osts) != 0) {
+                MFU_LOG(MFU_LOG_WARN, "Failed to get OST list for `%s'", name);
+                mfu_free(&layout->osts);
+            }
+        }
+
+        /* align chunks to stripe boundaries if we found a layout */
+        if (layout->osts != NULL) {
+            layout->chunk_size   = stripe_align_chunk_size(chunk_size, stripe_size);
+            layout->stripe_size  = stripe_size;
+            layout->stripe_count = stripe_count;
+        }
+    }
+    return layouts;
+}
+
+/* free layouts allocated in chunk_layouts_alloc */
+static void chunk_layouts_free(mfu_flist list, mfu_chunk_layout** playouts)
+{
+    uint64_t idx;
+    uint64_t size = mfu_flist_size(list);
+    mfu_chunk_layout* layouts = *playouts;
+    for (idx = 0; idx < size; idx++) {
+        mfu_free(&layouts[idx].osts);
+    }
+    mfu_free(playouts);
+}
+
+/* return OST index holding the first byte at given offset,
+ * or MFU_FILE_CHUNK_OST_UNKNOWN if the layout is not known */
+static uint64_t chunk_layout_ost(const mfu_chunk_layout* layout, uint64_t offset)
+{
+    if (layout->osts == NULL) {
+        return MFU_FILE_CHUNK_OST_UNKNOWN;
+    }
+    uint64_t stripe_id = (offset / layout->stripe_size) % layout->stripe_count;
+    return layout->osts[stripe_id];
+}
+
 /* This is a long routine, but the idea is simple.  All tasks sum up
  * the number of file chunks they have, and those are then evenly
- * distributed amongst the processes.  */
-mfu_file_chunk* mfu_file_chunk_list_alloc(mfu_flist list, uint64_t chunk_size)
+ * distributed amongst the processes.  When stripe is set, chunks are
+ * aligned to stripe boundaries and each chunk records its OST. */
+static mfu_file_chunk* chunk_list_alloc(mfu_flist list, uint64_t chunk_size,
+    int stripe, uint64_t sim_stripe_size, uint64_t sim_stripe_count, uint64_t sim_osts)
 {
     /* get our rank and number of ranks */
     int rank, ranks;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &ranks);
 
+    /* determine chunk size and striping for each file */
+    mfu_chunk_layout* layouts = chunk_layouts_alloc(list, chunk_size,
+        stripe, sim_stripe_size, sim_stripe_count, sim_osts);
+
     /* total up number of file chunks for all files in our list */
     uint64_t count = 0;
     uint64_t idx;
@@ -56,8 +171,9 @@ mfu_file_chunk* mfu_file_chunk_list_alloc(mfu_flist list, uint64_t chunk_size)
             uint64_t file_size = mfu_flist_file_get_size(list, idx);
 
             /* compute number of chunks to copy for this file */
-            uint64_t chunks = file_size / chunk_size;
-            if (chunks * chunk_size < file_size || file_size == 0) {
+            uint64_t file_chunk_size = layouts[idx].chunk_size;
+            uint64_t chunks = file_size / file_chunk_size;
+            if (chunks * file_chunk_size < file_size || file_size == 0) {
                 /* this accounts for the last chunk, which may be
                  * partial or it adds a chunk for 0-size files */
                 chunks++;
@@ -153,8 +269,10 @@ mfu_file_chunk* mfu_file_chunk_list_alloc(mfu_flist list, uint64_t chunk_size)
             uint64_t file_size = mfu_flist_file_get_size(list, idx);
 
             /* compute number of chunks to copy for this file */
-            uint64_t chunks = file_size / chunk_size;
-            if (chunks * chunk_size < file_size || file_size == 0) {
+            const mfu_chunk_layout* layout = &layouts[idx];
+            uint64_t file_chunk_size = layout->chunk_size;
+            uint64_t chunks = file_size / file_chunk_size;
+            if (chunks * file_chunk_size < file_size || file_size == 0) {
                 chunks++;
             }
 
@@ -171,13 +289,14 @@ mfu_file_chunk* mfu_file_chunk_list_alloc(mfu_flist list, uint64_t chunk_size)
 
                 /* if this chunk goes to a rank we've already created
                  * an element for, just update that element, otherwise
-                 * create a new element */
-                if (current_rank == prev_rank) {
+                 * create a new element, chunks aligned to stripes
+                 * are kept separate so each targets a single OST */
+                if (current_rank == prev_rank && layout->osts == NULL) {
                     /* we've already got an element started for this
                      * file and rank, just update its count field to
                      * append this element */
                     mfu_file_chunk* elem = tails[rank_index];
-                    elem->length += chunk_size;
+                    elem->length += file_chunk_size;
 
                     /* adjusting length in case chunk is a partial chunk */
                     uint64_t remainder = file_size - elem->offset;
@@ -189,11 +308,12 @@ mfu_file_chunk* mfu_file_chunk_list_alloc(mfu_flist list, uint64_t chunk_size)
                      * of a new file, either way allocate a new element */
                     mfu_file_chunk* elem = (mfu_file_chunk*) MFU_MALLOC(sizeof(mfu_file_chunk));
                     elem->name             = mfu_flist_file_get_name(list, idx);
-                    elem->offset           = chunk_id * chunk_size;
-                    elem->length           = chunk_size;
+                    elem->offset           = chunk_id * file_chunk_size;
+                    elem->length           = file_chunk_size;
                     elem->file_size        = file_size;
                     elem->rank_of_owner    = rank;
                     elem->index_of_owner   = idx;
+                    elem->ost              = chunk_layout_ost(layout, elem->offset);
                     elem->next             = NULL;
 
                     /* adjusting length in case chunk is a partial chunk */
@@ -203,10 +323,10 @@ mfu_file_chunk* mfu_file_chunk_list_alloc(mfu_flist list, uint64_t chunk_size)
                     }
 
                     /* compute bytes needed to pack this item,
-                     * full name NUL-terminated, chunk id,
-                     * number of chunks, and file size */
+                     * full name NUL-terminated, offset, length,
+                     * file size, owner rank and index, and OST */
                     size_t pack_size = strlen(elem->name) + 1;
-                    pack_size += 5 * 8;
+                    pack_size += 6 * 8;
 
                     /* append element to list */
                     if (heads[rank_index] == NULL) {
@@ -313,6 +433,7 @@ mfu_file_chunk* mfu_file_chunk_list_alloc(mfu_flist list, uint64_t chunk_size)
             mfu_pack_uint64(&sendptr, elem->file_size);
             mfu_pack_uint64(&sendptr, elem->rank_of_owner);
             mfu_pack_uint64(&sendptr, elem->index_of_owner);
+            mfu_pack_uint64(&sendptr, elem->ost);
 
             /* go to next element */
             elem = elem->next;
@@ -360,12 +481,13 @@ mfu_file_chunk* mfu_file_chunk_list_alloc(mfu_flist list, uint64_t chunk_size)
         packptr += strlen(name) + 1;
 
         /* unpack chunk offset, count, and file size */
-        uint64_t offset, length, file_size, rank_of_owner, index_of_owner;
+        uint64_t offset, length, file_size, rank_of_owner, index_of_owner, ost;
         mfu_unpack_uint64(&packptr, &offset);
         mfu_unpack_uint64(&packptr, &length);
         mfu_unpack_uint64(&packptr, &file_size);
         mfu_unpack_uint64(&packptr, &rank_of_owner);
         mfu_unpack_uint64(&packptr, &index_of_owner);
+        mfu_unpack_uint64(&packptr, &ost);
 
         /* allocate memory for new struct and set next pointer to null */
         mfu_file_chunk* p = malloc(sizeof(mfu_file_chunk));
@@ -378,6 +500,7 @@ mfu_file_chunk* mfu_file_chunk_list_alloc(mfu_flist list, uint64_t chunk_size)
         p->file_size = file_size;
         p->rank_of_owner = rank_of_owner;
         p->index_of_owner = index_of_owner;
+        p->ost = ost;
 
         /* if the tail is not null then point the tail at the latest struct */
         if (tail != NULL) {
@@ -393,9 +516,328 @@ mfu_file_chunk* mfu_file_chunk_list_alloc(mfu_flist list, uint64_t chunk_size)
         tail = p;
     }
 
+    /* free per-file layout info */
+    chunk_layouts_free(list, &layouts);
+
     return head;
 }
 
+/* given a file list and a chunk size, split files at chunk boundaries and evenly
+ * spread chunks to processes, returns a linked list of file sections each process
+ * is responsbile for */
+mfu_file_chunk* mfu_file_chunk_list_alloc(mfu_flist list, uint64_t chunk_size)
+{
+    return chunk_list_alloc(list, chunk_size, 0, 0, 0, 0);
+}
+
+/* like mfu_file_chunk_list_alloc, but aligns chunk boundaries to the
+ * stripe boundaries of each file and records the OST of each chunk */
+mfu_file_chunk* mfu_file_chunk_list_alloc_stripe(
+    mfu_flist list,
+    uint64_t chunk_size,
+    uint64_t sim_stripe_size,
+    uint64_t sim_stripe_count,
+    uint64_t sim_osts)
+{
+    return chunk_list_alloc(list, chunk_size, 1, sim_stripe_size, sim_stripe_count, sim_osts);
+}
+
+/* returns number of OSTs referenced by chunk lists across all ranks,
+ * counting up to the highest known OST, or 0 if no OST is known */
+static uint64_t chunk_list_ost_count(const mfu_file_chunk* head)
+{
+    uint64_t osts = 0;
+    const mfu_file_chunk* p = head;
+    while (p != NULL) {
+        if (p->ost != MFU_FILE_CHUNK_OST_UNKNOWN && p->ost + 1 > osts) {
+            osts = p->ost + 1;
+        }
+        p = p->next;
+    }
+
+    uint64_t all_osts;
+    MPI_Allreduce(&osts, &all_osts, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
+    return all_osts;
+}
+
+/* given a chunk list, compute the order in which this process should
+ * work through its chunks so that at any step, processes tend to target
+ * distinct OSTs, processes start on OSTs spaced evenly over all N OSTs,
+ * and at step t, rank r picks a chunk from OST (start_r + t) mod N
+ * if it has one, and otherwise the next OST after that which it does have,
+ * chunks whose OST is not known are left out of this and come last in list
+ * order, order[k] records the list index of the k-th chunk to process */
+void mfu_file_chunk_list_ost_order(const mfu_file_chunk* head, uint64_t* order)
+{
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    uint64_t osts = chunk_list_ost_count(head);
+    uint64_t list_count = mfu_file_chunk_list_size(head);
+
+    /* without any known OST, work through the list in order */
+    uint64_t i;
+    if (osts == 0) {
+        for (i = 0; i < list_count; i++) {
+            order[i] = i;
+        }
+        return;
+    }
+
+    /* space starting OSTs of processes evenly over all OSTs */
+    uint64_t first = ((uint64_t) rank * osts) / (uint64_t) ranks;
+
+    /* count number of chunks we have on each OST */
+    uint64_t* counts = (uint64_t*) MFU_MALLOC(osts * sizeof(uint64_t));
+    uint64_t* starts = (uint64_t*) MFU_MALLOC(osts * sizeof(uint64_t));
+    for (i = 0; i < osts; i++) {
+        counts[i] = 0;
+    }
+    uint64_t unknown_count = 0;
+    const mfu_file_chunk* p = head;
+    while (p != NULL) {
+        if (p->ost == MFU_FILE_CHUNK_OST_UNKNOWN) {
+            unknown_count++;
+        } else {
+            counts[p->ost]++;
+        }
+        p = p->next;
+    }
+
+    /* bucket list indices by OST, preserving list order within an OST */
+    uint64_t* buckets = (uint64_t*) MFU_MALLOC(list_count * sizeof(uint64_t));
+    uint64_t sum = 0;
+    for (i = 0; i < osts; i++) {
+        starts[i] = sum;
+        sum += counts[i];
+    }
+    uint64_t* next = (uint64_t*) MFU_MALLOC(osts * sizeof(uint64_t));
+    for (i = 0; i < osts; i++) {
+        next[i] = starts[i];
+    }
+    uint64_t unknown_next = sum;
+    p = head;
+    for (i = 0; i < list_count; i++) {
+        if (p->ost == MFU_FILE_CHUNK_OST_UNKNOWN) {
+            buckets[unknown_next++] = i;
+        } else {
+            buckets[next[p->ost]++] = i;
+        }
+        p = p->next;
+    }
+
+    /* build sorted list of OSTs for which we still have chunks */
+    uint64_t* active = (uint64_t*) MFU_MALLOC(osts * sizeof(uint64_t));
+    uint64_t active_count = 0;
+    for (i = 0; i < osts; i++) {
+        next[i] = starts[i];
+        if (counts[i] > 0) {
+            active[active_count++] = i;
+        }
+    }
+
+    /* step through, each time picking the first active OST at or
+     * after our target OST for this step */
+    uint64_t known_count = list_count - unknown_count;
+    uint64_t step;
+    for (step = 0; step < known_count; step++) {
+        uint64_t target = (first + step) % osts;
+
+        /* binary search for first active OST >= target, wrap to 0 */
+        uint64_t lo = 0;
+        uint64_t hi = active_count;
+        while (lo < hi) {
+            uint64_t mid = lo + (hi - lo) / 2;
+            if (active[mid] < target) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if (lo == active_count) {
+            lo = 0;
+        }
+
+        /* take next chunk from this OST */
+        uint64_t ost = active[lo];
+        order[step] = buckets[next[ost]++];
+
+        /* drop this OST from active list once we've used all its chunks */
+        if (next[ost] == starts[ost] + counts[ost]) {
+            memmove(&active[lo], &active[lo + 1], (active_count - lo - 1) * sizeof(uint64_t));
+            active_count--;
+        }
+    }
+
+    /* then the chunks whose OST is not known */
+    for (step = known_count; step < list_count; step++) {
+        order[step] = buckets[step];
+    }
+
+    mfu_free(&active);
+    mfu_free(&next);
+    mfu_free(&buckets);
+    mfu_free(&starts);
+    mfu_free(&counts);
+}
+
+/* walk steps of given order (NULL for list order) in windows, reducing the
+ * count of processes that target each OST at each step to rank 0,
+ * rank 0 records number of steps where two or more processes target the
+ * same OST, largest such count, and total chunks per OST (if totals != NULL),
+ * if print_steps > 0, rank 0 prints load on each OST for that many steps */
+static void chunk_list_ost_load(const uint64_t* osts_by_index, uint64_t list_count,
+    const uint64_t* order, uint64_t osts, uint64_t steps, uint64_t print_steps,
+    uint64_t* out_conflicts, uint64_t* out_max_load, uint64_t* totals)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    /* limit size of our reduction buffer */
+    uint64_t window = 65536 / osts;
+    if (window == 0) {
+        window = 1;
+    }
+    uint64_t* loads = (uint64_t*) MFU_MALLOC(window * osts * sizeof(uint64_t));
+    uint64_t* sums  = (uint64_t*) MFU_MALLOC(window * osts * sizeof(uint64_t));
+
+    uint64_t conflicts = 0;
+    uint64_t max_load  = 0;
+    uint64_t start;
+    for (start = 0; start < steps; start += window) {
+        uint64_t end = start + window;
+        if (end > steps) {
+            end = steps;
+        }
+
+        /* record OST we target at each step in this window */
+        uint64_t i;
+        for (i = 0; i < window * osts; i++) {
+            loads[i] = 0;
+        }
+        uint64_t step;
+        for (step = start; step < end && step < list_count; step++) {
+            uint64_t idx = (order != NULL) ? order[step] : step;
+            if (osts_by_index[idx] != MFU_FILE_CHUNK_OST_UNKNOWN) {
+                loads[(step - start) * osts + osts_by_index[idx]]++;
+            }
+        }
+
+        /* sum up load on each OST at each step */
+        int n = (int) ((end - start) * osts);
+        MPI_Reduce(loads, sums, n, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+
+        if (rank == 0) {
+            for (step = start; step < end; step++) {
+                const uint64_t* step_loads = &sums[(step - start) * osts];
+                uint64_t busiest = 0;
+                uint64_t ost;
+                for (ost = 0; ost < osts; ost++) {
+                    if (step_loads[ost] > busiest) {
+                        busiest = step_loads[ost];
+                    }
+                    if (totals != NULL) {
+                        totals[ost] += step_loads[ost];
+                    }
+                }
+                if (busiest > 1) {
+                    conflicts++;
+                }
+                if (busiest > max_load) {
+                    max_load = busiest;
+                }
+
+                /* print number of processes on each OST for this step */
+                if (step < print_steps) {
+                    char line[1024];
+                    size_t len = 0;
+                    line[0] = '\0';
+                    for (ost = 0; ost < osts && len < sizeof(line) - 32; ost++) {
+                        len += snprintf(line + len, sizeof(line) - len, " %llu",
+                            (unsigned long long) step_loads[ost]);
+                    }
+                    MFU_LOG(MFU_LOG_INFO, "  step %llu:%s",
+                        (unsigned long long) step, line);
+                }
+            }
+        }
+    }
+
+    *out_conflicts = conflicts;
+    *out_max_load  = max_load;
+
+    mfu_free(&sums);
+    mfu_free(&loads);
+}
+
+/* print the number of processes targeting each OST at each step when
+ * processing chunks in the given order, along with how often two or
+ * more processes target the same OST compared to list order */
+void mfu_file_chunk_list_print_ost_schedule(const mfu_file_chunk* head, const uint64_t* order)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    uint64_t osts = chunk_list_ost_count(head);
+    uint64_t list_count = mfu_file_chunk_list_size(head);
+
+    /* nothing to schedule if no chunk has a known OST */
+    if (osts == 0) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_INFO, "OST schedule: no chunk has a known OST");
+        }
+        return;
+    }
+
+    /* the number of steps is set by the process with the most chunks */
+    uint64_t steps, total_chunks;
+    MPI_Allreduce(&list_count, &steps, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
+    MPI_Allreduce(&list_count, &total_chunks, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+    /* record the OST of each chunk for random access */
+    uint64_t* osts_by_index = (uint64_t*) MFU_MALLOC(list_count * sizeof(uint64_t));
+    uint64_t i = 0;
+    const mfu_file_chunk* p = head;
+    while (p != NULL) {
+        osts_by_index[i++] = p->ost;
+        p = p->next;
+    }
+
+    uint64_t* totals = (uint64_t*) MFU_MALLOC(osts * sizeof(uint64_t));
+    for (i = 0; i < osts; i++) {
+        totals[i] = 0;
+    }
+
+    if (rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "OST schedule: %llu chunks over %llu OSTs in %llu steps, processes per OST at each step:",
+            (unsigned long long) total_chunks, (unsigned long long) osts, (unsigned long long) steps);
+    }
+
+    /* evaluate schedule with the given order */
+    uint64_t conflicts, max_load;
+    chunk_list_ost_load(osts_by_index, list_count, order, osts, steps, 16,
+        &conflicts, &max_load, totals);
+
+    /* evaluate schedule if we had just walked the list in order */
+    uint64_t list_conflicts, list_max_load;
+    chunk_list_ost_load(osts_by_index, list_count, NULL, osts, steps, 0,
+        &list_conflicts, &list_max_load, NULL);
+
+    if (rank == 0) {
+        for (i = 0; i < osts; i++) {
+            MFU_LOG(MFU_LOG_INFO, "  OST %llu: %llu chunks",
+                (unsigned long long) i, (unsigned long long) totals[i]);
+        }
+        MFU_LOG(MFU_LOG_INFO, "OST conflicts: %llu of %llu steps, max %llu processes per OST (list order: %llu steps, max %llu)",
+            (unsigned long long) conflicts, (unsigned long long) steps, (unsigned long long) max_load,
+            (unsigned long long) list_conflicts, (unsigned long long) list_max_load);
+    }
+
+    mfu_free(&totals);
+    mfu_free(&osts_by_index);
+}
+
 /* free the linked list of structs (copy elem's) */
 void mfu_file_chunk_list_free(mfu_file_chunk** phead)
 {
@@ -434,10 +876,11 @@ uint64_t mfu_file_chunk_list_size(const mfu_file_chunk* p)
 }
 
 /* given an flist, a file chunk list generated from that flist,
- * and an input array of flags with one element per chunk,
- * execute a LOR per item in the flist, and return the result
- * to the process owning that item in the flist */
-void mfu_file_chunk_list_lor(mfu_flist list, const mfu_file_chunk* head, const int* vals, int* results)
+ * and an input array of values with one element per chunk,
+ * reduce values with op per item in the flist, and return the result
+ * to the process owning that item in the flist, entries of results
+ * for items that have no chunks are left as they are */
+static void file_chunk_list_reduce(mfu_flist list, const mfu_file_chunk* head, const uint64_t* vals, MPI_Op op, uint64_t* results)
 {
     /* get the largest filename */
     uint64_t max_name = mfu_flist_file_max_name(list);
@@ -455,7 +898,7 @@ void mfu_file_chunk_list_lor(mfu_flist list, const mfu_file_chunk* head, const i
     char* keys = (char*) MFU_MALLOC(list_count * max_name);
 
     /* ltr pointer for the output of the left-to-right-segmented scan */
-    int* ltr = (int*) MFU_MALLOC(list_count * sizeof(int));
+    uint64_t* ltr = (uint64_t*) MFU_MALLOC(list_count * sizeof(uint64_t));
 
     /* copy file names into comparison buffer for segmented scan */
     uint64_t i;
@@ -474,7 +917,7 @@ void mfu_file_chunk_list_lor(mfu_flist list, const mfu_file_chunk* head, const i
     /* execute segmented scan of comparison flags across file names */
     DTCMP_Segmented_scanv_ltr(
         (int)list_count, keys, keytype, keyop,
-        vals, ltr, MPI_INT, MPI_LOR,
+        vals, ltr, MPI_UINT64_T, op,
         DTCMP_FLAG_NONE, MPI_COMM_WORLD
     );
     
@@ -517,7 +960,7 @@ void mfu_file_chunk_list_lor(mfu_flist list, const mfu_file_chunk* head, const i
 
             /* copy index and flag value to send buffer */
             uint64_t file_index = p->index_of_owner;
-            uint64_t flag       = (uint64_t) ltr[i];
+            uint64_t flag       = ltr[i];
             sendbuf[disp    ]   = file_index;
             sendbuf[disp + 1]   = flag;
             
@@ -563,7 +1006,7 @@ void mfu_file_chunk_list_lor(mfu_flist list, const mfu_file_chunk* head, const i
         uint64_t flag = recvbuf[disp + 1];
 
         /* set value in output array for corresponding item */
-        results[idx] = (int)flag;
+        results[idx] = flag;
 
         /* go to next id & flag */
         disp += 2;
@@ -582,3 +1025,74 @@ void mfu_file_chunk_list_lor(mfu_flist list, const mfu_file_chunk* head, const i
 
     return;
 }
+
+/* given an flist, a file chunk list generated from that flist,
+ * and an input array of flags with one element per chunk,
+ * execute a LOR per item in the flist, and return the result
+ * to the process owning that item in the flist */
+void mfu_file_chunk_list_lor(mfu_flist list, const mfu_file_chunk* head, const int* vals, int* results)
+{
+    /* widen flags to the type the reduction works on */
+    uint64_t list_count = mfu_file_chunk_list_size(head);
+    uint64_t* vals64 = (uint64_t*) MFU_MALLOC(list_count * sizeof(uint64_t));
+    uint64_t i;
+    for (i = 0; i < list_count; i++) {
+        vals64[i] = (uint64_t) vals[i];
+    }
+
+    /* mark entries so we only copy back results we receive */
+    uint64_t size = mfu_flist_size(list);
+    uint64_t* results64 = (uint64_t*) MFU_MALLOC(size * sizeof(uint64_t));
+    for (i = 0; i < size; i++) {
+        results64[i] = UINT64_MAX;
+    }
+
+    file_chunk_list_reduce(list, head, vals64, MPI_LOR, results64);
+
+    for (i = 0; i < size; i++) {
+        if (results64[i] != UINT64_MAX) {
+            results[i] = (int) results64[i];
+        }
+    }
+
+    mfu_free(&results64);
+    mfu_free(&vals64);
+
+    return;
+}
+
+/* given an flist, a file chunk list generated from that flist,
+ * and an input array of values with one element per chunk,
+ * compute the minimum per item in the flist, and return the result
+ * to the process owning that item in the flist */
+void mfu_file_chunk_list_min(mfu_flist list, const mfu_file_chunk* head, const uint64_t* vals, uint64_t* results)
+{
+    file_chunk_list_reduce(list, head, vals, MPI_MIN, results);
+    return;
+}
+
+/* given an flist, a file chunk list generated from that flist,
+ * and the offset of the first differing byte found in each chunk,
+ * UINT64_MAX if none, log the offset at which each file first differs,
+ * collective */
+void mfu_file_chunk_list_print_offsets(mfu_flist list, const mfu_file_chunk* head, const uint64_t* offsets)
+{
+    /* take the smallest offset over the chunks of each file */
+    uint64_t size = mfu_flist_size(list);
+    uint64_t* first = (uint64_t*) MFU_MALLOC(size * sizeof(uint64_t));
+    uint64_t i;
+    for (i = 0; i < size; i++) {
+        first[i] = UINT64_MAX;
+    }
+    mfu_file_chunk_list_min(list, head, offsets, first);
+
+    for (i = 0; i < size; i++) {
+        if (first[i] != UINT64_MAX) {
+            const char* name = mfu_flist_file_get_name(list, i);
+            MFU_LOG(MFU_LOG_INFO, "Contents differ at offset %llu: `%s'",
+                (unsigned long long)first[i], name);
+        }
+    }
+
+    mfu_free(&first);
+}
@@ -102,6 +102,9 @@ static mfu_copy_stats_t mfu_copy_stats;
 static mfu_copy_file_cache_t mfu_copy_src_cache;
 static mfu_copy_file_cache_t mfu_copy_dst_cache;
 
+/* rate limits bytes copied and items created in the current phase */
+static mfu_throttle* copy_throttle;
+
 static void mfu_copy_open_file(const char* file, int read_flag,
         mfu_copy_file_cache_t* cache, mfu_copy_opts_t* mfu_copy_opts,
         mfu_file_t* mfu_file)
@@ -879,6 +882,7 @@ static int mfu_create_directory(mfu_flist list, uint64_t idx,
     /* create the destination directory */
     MFU_LOG(MFU_LOG_DBG, "Creating directory `%s'", dest_path);
     int mkdir_rc = mfu_file_mkdir(dest_path, DCOPY_DEF_PERMS_DIR, mfu_dst_file);
+    mfu_throttle_update(0, 1, copy_throttle);
     if(mkdir_rc < 0) {
         if(errno == EEXIST) {
             MFU_LOG(MFU_LOG_WARN,
@@ -952,6 +956,9 @@ static int mfu_create_directories(int levels, int minlevel, mfu_flist* lists,
         /* get list of items for this level */
         mfu_flist list = lists[level];
 
+        /* limit rate at which we create items */
+        copy_throttle = mfu_throttle_start(MPI_COMM_WORLD);
+
         /* create each directory we have at this level */
         uint64_t idx;
         uint64_t size = mfu_flist_size(list);
@@ -974,6 +981,10 @@ static int mfu_create_directories(int levels, int minlevel, mfu_flist* lists,
         /* add items to our running total */
         total_count += count;
 
+        /* finish the throttle before the barrier, so that idle
+         * processes keep rebalancing shares among busy ones */
+        mfu_throttle_complete(&copy_throttle);
+
         /* wait for all procs to finish before we start
          * creating directories at next level */
         MPI_Barrier(MPI_COMM_WORLD);
@@ -1063,6 +1074,7 @@ static int mfu_create_link(mfu_flist list, uint64_t idx,
 
     /* create new link */
     int symlink_rc = mfu_symlink(path, dest_path);
+    mfu_throttle_update(0, 1, copy_throttle);
     if(symlink_rc < 0) {
         if(errno == EEXIST) {
             MFU_LOG(MFU_LOG_WARN,
@@ -1094,6 +1106,51 @@ static int mfu_create_link(mfu_flist list, uint64_t idx,
     return rc;
 }
 
+/* allocate blocks for the final size of a newly created file, so that
+ * concurrent writers fill in a few large extents rather than growing the
+ * file piecemeal, failures are not fatal since the copy still works */
+static void mfu_preallocate_file(mfu_flist list, uint64_t idx,
+        const char* dest_path, mfu_file_t* mfu_dst_file)
+{
+    /* only have fallocate on POSIX file systems */
+    if (mfu_dst_file->type != POSIX) {
+        return;
+    }
+
+    /* nothing to allocate for an empty file */
+    uint64_t size = mfu_flist_file_get_size(list, idx);
+    if (size == 0) {
+        return;
+    }
+
+    int fd = mfu_open(dest_path, O_WRONLY);
+    if (fd < 0) {
+        MFU_LOG(MFU_LOG_WARN, "Failed to open file to preallocate: `%s' (errno=%d %s)",
+                dest_path, errno, strerror(errno));
+        return;
+    }
+
+    if (mfu_fallocate(dest_path, fd, (off_t) size) != 0) {
+        /* warn only once per process if the file system can't do this */
+        static int warned_unsupported = 0;
+        if (errno == EOPNOTSUPP || errno == ENOSYS) {
+            if (!warned_unsupported) {
+                MFU_LOG(MFU_LOG_WARN, "File system does not support preallocation: `%s'",
+                        dest_path);
+                warned_unsupported = 1;
+            }
+        } else {
+            MFU_LOG(MFU_LOG_WARN, "Failed to preallocate %llu bytes: `%s' (errno=%d %s)",
+                    (unsigned long long) size, dest_path, errno, strerror(errno));
+        }
+    } else {
+        MFU_LOG(MFU_LOG_DBG, "Preallocated %llu bytes: `%s'",
+                (unsigned long long) size, dest_path);
+    }
+
+    mfu_close(dest_path, fd);
+}
+
 /* creates inode in destpath for specified file, identifies source path
  * that contains source file, computes relative path to file under source path,
  * and creates file at same relative path under destpath, copies xattrs
@@ -1128,6 +1185,7 @@ static int mfu_create_file(mfu_flist list, uint64_t idx,
     dev_t dev;
     memset(&dev, 0, sizeof(dev_t));
     int mknod_rc = mfu_file_mknod(dest_path, DCOPY_DEF_PERMS_FILE | S_IFREG, dev, mfu_dst_file);
+    mfu_throttle_update(0, 1, copy_throttle);
     if(mknod_rc < 0) {
         if(errno == EEXIST) {
             /* destination already exists, no big deal, but print warning */
@@ -1178,6 +1236,9 @@ static int mfu_create_file(mfu_flist list, uint64_t idx,
             MFU_LOG(MFU_LOG_ERR, "mfu_lstat() file: `%s' (errno=%d %s)",
                       dest_path, errno, strerror(errno));
         }
+    } else if (mfu_copy_opts->preallocate) {
+        /* allocate blocks for the full file before any rank writes to it */
+        mfu_preallocate_file(list, idx, dest_path, mfu_dst_file);
     }
 
     /* free destination path */
@@ -1212,6 +1273,7 @@ static int mfu_create_hardlink(mfu_flist list, uint64_t idx,
     }
 
     rc = mfu_hardlink(src_path, dest_path);
+    mfu_throttle_update(0, 1, copy_throttle);
     if (rc != 0) {
         MFU_LOG(MFU_LOG_ERR, "Failed to create hardlink %s --> %s",
                 dest_path, src_path);
@@ -1299,6 +1361,9 @@ static int mfu_create_files(int levels, int minlevel,
         /* get list of items for this level */
         mfu_flist list = lists[level];
 
+        /* limit rate at which we create items */
+        copy_throttle = mfu_throttle_start(MPI_COMM_WORLD);
+
         /* iterate over items and set write bit on directories if needed */
         uint64_t idx;
         uint64_t size = mfu_flist_size(list);
@@ -1332,6 +1397,10 @@ static int mfu_create_files(int levels, int minlevel,
             mfu_progress_update(&total_count, create_prog);
         }
 
+        /* finish the throttle before the barrier, so that idle
+         * processes keep rebalancing shares among busy ones */
+        mfu_throttle_complete(&copy_throttle);
+
         /* wait for all procs to finish before we start
          * with files at next level */
         MPI_Barrier(MPI_COMM_WORLD);
@@ -1418,6 +1487,9 @@ static int mfu_create_hardlinks(int levels, int minlevel, mfu_flist* lists,
         /* get list of items for this level */
         mfu_flist list = lists[level];
 
+        /* limit rate at which we create items */
+        copy_throttle = mfu_throttle_start(MPI_COMM_WORLD);
+
         /* iterate over items and create hardlink for each */
         uint64_t idx;
         uint64_t size = mfu_flist_size(list);
@@ -1444,6 +1516,10 @@ static int mfu_create_hardlinks(int levels, int minlevel, mfu_flist* lists,
         /* add items to our running total */
         total_count += count;
 
+        /* finish the throttle before the barrier, so that idle
+         * processes keep rebalancing shares among busy ones */
+        mfu_throttle_complete(&copy_throttle);
+
         /* wait for all procs to finish before we start
          * with files at next level */
         MPI_Barrier(MPI_COMM_WORLD);
@@ -1580,6 +1656,59 @@ static int mfu_is_eof(const char* file, mfu_file_t* mfu_file)
     return 0;
 }
 
+/* set or clear O_DIRECT on an open file descriptor,
+ * returns 0 on success and -1 if the file system does not allow it */
+static int mfu_copy_set_direct(int fd, int direct)
+{
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0) {
+        return -1;
+    }
+
+    int newflags = direct ? (flags | O_DIRECT) : (flags & ~O_DIRECT);
+    if (newflags == flags) {
+        return 0;
+    }
+
+    return fcntl(fd, F_SETFL, newflags);
+}
+
+/* state for --adaptive-io while copying one chunk of a file */
+typedef struct {
+    int src_fd;        /* source file descriptor */
+    int dst_fd;        /* destination file descriptor */
+    int direct;        /* whether O_DIRECT may be used for aligned blocks */
+    off_t wb_offset;   /* start of buffered range whose writeback was started */
+    off_t wb_length;   /* length of that range, 0 if none */
+} mfu_copy_adaptive_t;
+
+/* drop source pages just read with buffered I/O */
+static void mfu_copy_adaptive_read_done(mfu_copy_adaptive_t* a, off_t pos, size_t bytes)
+{
+    posix_fadvise(a->src_fd, pos, (off_t) bytes, POSIX_FADV_DONTNEED);
+}
+
+/* wait for writeback of the range started last time and drop its pages */
+static void mfu_copy_adaptive_flush(mfu_copy_adaptive_t* a)
+{
+    if (a->wb_length > 0) {
+        sync_file_range(a->dst_fd, a->wb_offset, a->wb_length,
+            SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+        posix_fadvise(a->dst_fd, a->wb_offset, a->wb_length, POSIX_FADV_DONTNEED);
+        a->wb_length = 0;
+    }
+}
+
+/* start writeback of a range just written with buffered I/O and retire
+ * the range before it, so at most two blocks of dirty pages are held */
+static void mfu_copy_adaptive_write_done(mfu_copy_adaptive_t* a, off_t pos, size_t bytes)
+{
+    sync_file_range(a->dst_fd, pos, (off_t) bytes, SYNC_FILE_RANGE_WRITE);
+    mfu_copy_adaptive_flush(a);
+    a->wb_offset = pos;
+    a->wb_length = (off_t) bytes;
+}
+
 static int mfu_copy_file_normal(
     const char* src,
     const char* dest,
@@ -1608,6 +1737,22 @@ static int mfu_copy_file_normal(
     size_t buf_size = mfu_copy_opts->block_size;
     void* buf       = mfu_copy_opts->block_buf1;
 
+    /* with adaptive I/O on a large file, move full aligned blocks with
+     * O_DIRECT and keep only the unaligned head and tail in the page
+     * cache, dropping those pages again once they have been written */
+    int adaptive = (mfu_copy_opts->adaptive_io && ! mfu_copy_opts->synchronous &&
+        file_size >= FD_ADAPTIVE_MIN_SIZE &&
+        mfu_src_file->type == POSIX && mfu_dst_file->type == POSIX);
+    mfu_copy_adaptive_t adapt;
+    if (adaptive) {
+        adapt.src_fd    = mfu_src_file->fd;
+        adapt.dst_fd    = mfu_dst_file->fd;
+        adapt.direct    = (buf_size % FD_DIRECT_ALIGN == 0 &&
+                           (uintptr_t) buf % FD_DIRECT_ALIGN == 0);
+        adapt.wb_offset = 0;
+        adapt.wb_length = 0;
+    }
+
     /* write data */
     size_t total_bytes = 0;
     while(total_bytes < (size_t)length) {
@@ -1624,6 +1769,24 @@ static int mfu_copy_file_normal(
             left_to_read = buf_size;
         }
 
+        /* use O_DIRECT only for a full block at an aligned offset, fall
+         * back to buffered I/O for good if the file system refuses it */
+        off_t pos = (off_t)offset + (off_t)total_bytes;
+        int direct = 0;
+        if (adaptive && adapt.direct) {
+            direct = (left_to_read == buf_size && pos % FD_DIRECT_ALIGN == 0);
+            if (mfu_copy_set_direct(adapt.src_fd, direct) != 0 ||
+                mfu_copy_set_direct(adapt.dst_fd, direct) != 0)
+            {
+                MFU_LOG(MFU_LOG_DBG, "O_DIRECT not supported, using buffered I/O: `%s' to `%s'",
+                    src, dest);
+                mfu_copy_set_direct(adapt.src_fd, 0);
+                mfu_copy_set_direct(adapt.dst_fd, 0);
+                adapt.direct = 0;
+                direct = 0;
+            }
+        }
+
         /* read data from source file */
         ssize_t num_of_bytes_read = mfu_file_read(src, buf, left_to_read, mfu_src_file);
 
@@ -1632,6 +1795,12 @@ static int mfu_copy_file_normal(
             break;
         }
 
+        /* a short read leaves an unaligned length, write it buffered */
+        if (direct && (size_t) num_of_bytes_read != left_to_read) {
+            mfu_copy_set_direct(adapt.dst_fd, 0);
+            direct = 0;
+        }
+
         /* compute number of bytes to write */
         size_t bytes_to_write = (size_t) num_of_bytes_read;
         if(mfu_copy_opts->synchronous) {
@@ -1659,6 +1828,13 @@ static int mfu_copy_file_normal(
         /* TODO: add code for daos api to support sparse files? */
         ssize_t num_of_bytes_written = (ssize_t)bytes_to_write;
         if (mfu_copy_opts->sparse && mfu_is_all_null(buf, bytes_to_write)) {
+            /* the one byte read and write below are not allowed with O_DIRECT */
+            if (direct) {
+                mfu_copy_set_direct(adapt.src_fd, 0);
+                mfu_copy_set_direct(adapt.dst_fd, 0);
+                direct = 0;
+            }
+
             /* TODO: isn't there a better way to know if we're at EOF,
              * e.g., by using file size? */
             /* determine whether we're at the end of the file */
@@ -1709,11 +1885,30 @@ static int mfu_copy_file_normal(
             return -1;
         }
 
+        /* keep buffered pages from piling up behind the cursor */
+        if (adaptive && ! direct) {
+            mfu_copy_adaptive_read_done(&adapt, pos, (size_t) num_of_bytes_read);
+            mfu_copy_adaptive_write_done(&adapt, pos, bytes_to_write);
+        }
+
         total_bytes += (size_t) num_of_bytes_read;
 
         /* update number of bytes we have copied for progress messages */
         copy_count += (uint64_t) num_of_bytes_read;
         mfu_progress_update(&copy_count, copy_prog);
+
+        /* hold to our share of the bandwidth limit */
+        mfu_throttle_update((uint64_t) num_of_bytes_read, 0, copy_throttle);
+    }
+
+    /* retire the last buffered range and leave the cached
+     * descriptors in buffered mode for whoever uses them next */
+    if (adaptive) {
+        mfu_copy_adaptive_flush(&adapt);
+        if (adapt.direct) {
+            mfu_copy_set_direct(adapt.src_fd, 0);
+            mfu_copy_set_direct(adapt.dst_fd, 0);
+        }
     }
 
     /* Increment the global counter. */
@@ -1768,6 +1963,12 @@ static int mfu_copy_file_fiemap(
         goto fail_normal_copy;
     }
 
+    /* the normal copy skips holes too, and with adaptive I/O
+     * it keeps large files out of the page cache */
+    if (mfu_copy_opts->adaptive_io && file_size >= FD_ADAPTIVE_MIN_SIZE) {
+        goto fail_normal_copy;
+    }
+
     size_t last_ext_start = offset;
     size_t last_ext_len = 0;
 
@@ -1895,6 +2096,9 @@ static int mfu_copy_file_fiemap(
 
             ext_len -= (size_t)num_written;
             mfu_copy_stats.total_bytes_copied += (int64_t) num_written;
+
+            /* hold to our share of the bandwidth limit */
+            mfu_throttle_update((uint64_t) num_written, 0, copy_throttle);
         }
     }
 
@@ -2006,32 +2210,65 @@ static int mfu_copy_files(mfu_flist list, uint64_t chunk_size,
     /* start up progress messages for the copy */
     copy_count = 0;
     copy_prog = mfu_progress_start(mfu_progress_timeout, 1, MPI_COMM_WORLD, copy_progress_fn);
+    copy_throttle = mfu_throttle_start(MPI_COMM_WORLD);
 
     /* split file list into a linked list of file sections,
-     * this evenly spreads the file sections across processes */
-    mfu_file_chunk* head = mfu_file_chunk_list_alloc(list, chunk_size);
+     * this evenly spreads the file sections across processes,
+     * optionally cutting sections at stripe boundaries */
+    mfu_file_chunk* head;
+    if (mfu_copy_opts->stripe_align) {
+        head = mfu_file_chunk_list_alloc_stripe(list, chunk_size,
+            mfu_copy_opts->stripe_sim_size, mfu_copy_opts->stripe_sim_count,
+            mfu_copy_opts->stripe_sim_osts);
+    } else {
+        head = mfu_file_chunk_list_alloc(list, chunk_size);
+    }
 
     /* get a count of how many items are the chunk list */
     uint64_t list_count = mfu_file_chunk_list_size(head);
 
+    /* record pointer to each chunk so we can visit them in any order */
+    uint64_t i;
+    const mfu_file_chunk** chunks = (const mfu_file_chunk**) MFU_MALLOC(list_count * sizeof(mfu_file_chunk*));
+    const mfu_file_chunk* p = head;
+    for (i = 0; i < list_count; i++) {
+        chunks[i] = p;
+        p = p->next;
+    }
+
+    /* when aligned to stripes, order chunks so that processes
+     * spread their accesses over distinct OSTs at each step */
+    uint64_t* order = NULL;
+    if (mfu_copy_opts->stripe_align) {
+        order = (uint64_t*) MFU_MALLOC(list_count * sizeof(uint64_t));
+        mfu_file_chunk_list_ost_order(head, order);
+
+        /* print schedule when simulating or debugging */
+        if (mfu_copy_opts->stripe_sim_osts > 0 || mfu_debug_level >= MFU_LOG_DBG) {
+            mfu_file_chunk_list_print_ost_schedule(head, order);
+        }
+    }
+
     /* allocate a flag for each element in chunk list,
      * will store 0 to mean copy of this chunk succeeded and 1 otherwise
      * to be used as input to logical OR to determine state of entire file */
     int* vals = (int*) MFU_MALLOC(list_count * sizeof(int));
+    for (i = 0; i < list_count; i++) {
+        vals[i] = 0;
+    }
 
     /* loop over and copy data for each file section we're responsible for */
-    uint64_t i;
-    const mfu_file_chunk* p = head;
-    for (i = 0; i < list_count; i++) {
-         /* assume we'll succeed in copying this chunk */
-         vals[i] = 0;
+    uint64_t step;
+    for (step = 0; step < list_count; step++) {
+        /* get next chunk to process */
+        i = (order != NULL) ? order[step] : step;
+        p = chunks[i];
 
         /* get name of destination file */
         char* dest = mfu_param_path_copy_dest(p->name, numpaths,
                 paths, destpath, mfu_copy_opts, mfu_src_file, mfu_dst_file);
         if (dest == NULL) {
             /* No need to copy it */
-            p = p->next;
             continue;
         }
 
@@ -2050,15 +2287,20 @@ static int mfu_copy_files(mfu_flist list, uint64_t chunk_size,
 
         /* free the dest name */
         mfu_free(&dest);
-
-        /* update pointer to next element */
-        p = p->next;
     }
 
+    /* free chunk order */
+    mfu_free(&order);
+    mfu_free(&chunks);
+
     /* close files */
     mfu_copy_close_file(&mfu_copy_src_cache, mfu_src_file);
     mfu_copy_close_file(&mfu_copy_dst_cache, mfu_dst_file);
 
+    /* finish the throttle before the barrier, so that idle
+     * processes keep rebalancing shares among busy ones */
+    mfu_throttle_complete(&copy_throttle);
+
     /* barrier to ensure all files are closed,
      * may try to unlink bad destination files below */
     MPI_Barrier(MPI_COMM_WORLD);
@@ -2108,6 +2350,7 @@ static int mfu_copy_files(mfu_flist list, uint64_t chunk_size,
 
     /* free copy flags */
     mfu_free(&results);
+    mfu_free(&vals);
 
     /* free the list of file chunks */
     mfu_file_chunk_list_free(&head);
@@ -2274,35 +2517,12 @@ static void print_summary(mfu_flist flist)
     return;
 }
 
-int mfu_flist_copy(mfu_flist src_cp_list, int numpaths,
-        const mfu_param_path* paths, const mfu_param_path* destpath,
-        mfu_copy_opts_t* mfu_copy_opts, mfu_file_t* mfu_src_file, mfu_file_t* mfu_dst_file)
+/* set up buffers, statistics, and timers for a copy operation */
+static void mfu_copy_begin(const mfu_param_path* destpath, mfu_copy_opts_t* mfu_copy_opts)
 {
-    /* assume we'll succeed */
-    int rc = 0;
-
-    /* DAOS only supports using one source path */
-    if (mfu_src_file->type == DAOS || mfu_dst_file->type == DAOS) {
-        if (numpaths != 1) {
-            MFU_LOG(MFU_LOG_ERR, "Only one source can be specified when using DAOS");
-        }
-    }
-
-    /* get our rank */
-    int rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-
-    /* set mfu_copy options in mfu_copy_opts_t struct */
-
     /* copy the destination path to user opts structure */
     mfu_copy_opts->dest_path = MFU_STRDUP((*destpath).path);
 
-    /* print note about what we're doing and the amount of files/data to be moved */
-    if (rank == 0) {
-        MFU_LOG(MFU_LOG_INFO, "Copying to %s", mfu_copy_opts->dest_path);
-    }
-    mfu_flist_print_summary(src_cp_list);
-
     /* TODO: consider file system striping params here */
     /* hard code some configurables for now */
 
@@ -2328,6 +2548,127 @@ int mfu_flist_copy(mfu_flist src_cp_list, int numpaths,
     /* Initialize file cache */
     mfu_copy_src_cache.name = NULL;
     mfu_copy_dst_cache.name = NULL;
+}
+
+/* free buffers, print statistics for a copy operation, and
+ * return -1 if any process reported an error in rc */
+static int mfu_copy_end(int rc, mfu_copy_opts_t* mfu_copy_opts)
+{
+    /* get our rank */
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    /* free buffers */
+    mfu_free(&mfu_copy_opts->block_buf1);
+    mfu_free(&mfu_copy_opts->block_buf2);
+
+    /* Determine the actual and relative end time for the epilogue. */
+    mfu_copy_stats.wtime_ended = MPI_Wtime();
+    time(&(mfu_copy_stats.time_ended));
+
+    /* compute time */
+    double rel_time = mfu_copy_stats.wtime_ended - \
+                      mfu_copy_stats.wtime_started;
+
+    /* prep our values into buffer */
+    int64_t values[5];
+    values[0] = mfu_copy_stats.total_dirs;
+    values[1] = mfu_copy_stats.total_files;
+    values[2] = mfu_copy_stats.total_links;
+    values[3] = mfu_copy_stats.total_size;
+    values[4] = mfu_copy_stats.total_bytes_copied;
+
+    /* sum values across processes */
+    int64_t sums[5];
+    MPI_Allreduce(values, sums, 5, MPI_INT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+    /* extract results from allreduce */
+    int64_t agg_dirs   = sums[0];
+    int64_t agg_files  = sums[1];
+    int64_t agg_links  = sums[2];
+    int64_t agg_size   = sums[3];
+    int64_t agg_copied = sums[4];
+
+    /* compute rate of copy */
+    double agg_rate = (double)agg_copied / rel_time;
+    if (rel_time > 0.0) {
+        agg_rate = (double)agg_copied / rel_time;
+    }
+
+    if(rank == 0) {
+        /* format start time */
+        char starttime_str[256];
+        struct tm* localstart = localtime(&(mfu_copy_stats.time_started));
+        strftime(starttime_str, 256, "%b-%d-%Y,%H:%M:%S", localstart);
+
+        /* format end time */
+        char endtime_str[256];
+        struct tm* localend = localtime(&(mfu_copy_stats.time_ended));
+        strftime(endtime_str, 256, "%b-%d-%Y,%H:%M:%S", localend);
+
+        /* total number of items */
+        int64_t agg_items = agg_dirs + agg_files + agg_links;
+
+        /* convert size to units */
+        double agg_size_tmp;
+        const char* agg_size_units;
+        mfu_format_bytes((uint64_t)agg_size, &agg_size_tmp, &agg_size_units);
+
+        /* convert bandwidth to units */
+        double agg_rate_tmp;
+        const char* agg_rate_units;
+        mfu_format_bw(agg_rate, &agg_rate_tmp, &agg_rate_units);
+
+        MFU_LOG(MFU_LOG_INFO, "Started: %s", starttime_str);
+        MFU_LOG(MFU_LOG_INFO, "Completed: %s", endtime_str);
+        MFU_LOG(MFU_LOG_INFO, "Seconds: %.3lf", rel_time);
+        MFU_LOG(MFU_LOG_INFO, "Items: %" PRId64, agg_items);
+        MFU_LOG(MFU_LOG_INFO, "  Directories: %" PRId64, agg_dirs);
+        MFU_LOG(MFU_LOG_INFO, "  Files: %" PRId64, agg_files);
+        MFU_LOG(MFU_LOG_INFO, "  Links: %" PRId64, agg_links);
+        MFU_LOG(MFU_LOG_INFO, "Data: %.3lf %s (%" PRId64 " bytes)",
+            agg_size_tmp, agg_size_units, agg_size);
+
+        MFU_LOG(MFU_LOG_INFO, "Rate: %.3lf %s " \
+            "(%.3" PRId64 " bytes in %.3lf seconds)", \
+            agg_rate_tmp, agg_rate_units, agg_copied, rel_time);
+    }
+
+    /* determine whether any process reported an error,
+     * inputs should are either 0 or -1, so min will be -1 on any -1 */
+    int all_rc;
+    MPI_Allreduce(&rc, &all_rc, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    rc = all_rc;
+
+    return rc;
+}
+
+int mfu_flist_copy(mfu_flist src_cp_list, int numpaths,
+        const mfu_param_path* paths, const mfu_param_path* destpath,
+        mfu_copy_opts_t* mfu_copy_opts, mfu_file_t* mfu_src_file, mfu_file_t* mfu_dst_file)
+{
+    /* assume we'll succeed */
+    int rc = 0;
+
+    /* DAOS only supports using one source path */
+    if (mfu_src_file->type == DAOS || mfu_dst_file->type == DAOS) {
+        if (numpaths != 1) {
+            MFU_LOG(MFU_LOG_ERR, "Only one source can be specified when using DAOS");
+        }
+    }
+
+    /* get our rank */
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    /* set up buffers, statistics, and timers */
+    mfu_copy_begin(destpath, mfu_copy_opts);
+
+    /* print note about what we're doing and the amount of files/data to be moved */
+    if (rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Copying to %s", mfu_copy_opts->dest_path);
+    }
+    mfu_flist_print_summary(src_cp_list);
 
     /* split items in file list into sublists depending on their
      * directory depth */
@@ -2543,87 +2884,205 @@ int mfu_flist_copy(mfu_flist src_cp_list, int numpaths,
     /* free our lists of levels */
     mfu_flist_array_free(levels, &lists);
 
-    /* free buffers */
-    mfu_free(&mfu_copy_opts->block_buf1);
-    mfu_free(&mfu_copy_opts->block_buf2);
+    /* free buffers, print statistics, and check for errors */
+    rc = mfu_copy_end(rc, mfu_copy_opts);
 
-    /* Determine the actual and relative end time for the epilogue. */
-    mfu_copy_stats.wtime_ended = MPI_Wtime();
-    time(&(mfu_copy_stats.time_ended));
+    return rc;
+}
 
-    /* compute time */
-    double rel_time = mfu_copy_stats.wtime_ended - \
-                      mfu_copy_stats.wtime_started;
+/* state handed to the walk when copying items as they are found */
+typedef struct {
+    int numpaths;                   /* number of source paths */
+    const mfu_param_path* paths;    /* array of source paths */
+    const mfu_param_path* destpath; /* destination path */
+    mfu_copy_opts_t* mfu_copy_opts; /* options to be used during copy */
+    mfu_file_t* mfu_src_file;       /* I/O functions for source */
+    mfu_file_t* mfu_dst_file;       /* I/O functions for destination */
+    uint64_t count;                 /* number of items this process copied during the walk */
+    int rc;                         /* set to -1 if any copy failed */
+} mfu_copy_stream_t;
+
+/* a regular file is copied during the walk if it fits in a single chunk,
+ * anything larger is split into chunks after the walk */
+static int mfu_copy_stream_is_small(uint64_t size, const mfu_copy_opts_t* mfu_copy_opts)
+{
+    return (size <= (uint64_t) mfu_copy_opts->chunk_size);
+}
 
-    /* prep our values into buffer */
-    int64_t values[5];
-    values[0] = mfu_copy_stats.total_dirs;
-    values[1] = mfu_copy_stats.total_files;
-    values[2] = mfu_copy_stats.total_links;
-    values[3] = mfu_copy_stats.total_size;
-    values[4] = mfu_copy_stats.total_bytes_copied;
+/* called by the walk for each item it records, the walk reports a
+ * directory before it reads any of its entries, so the parent of every
+ * item already exists in the destination by the time we get here */
+static void mfu_copy_stream_item(const char* path, mode_t mode, const struct stat* st, void* arg)
+{
+    mfu_copy_stream_t* stream = (mfu_copy_stream_t*) arg;
+    mfu_copy_opts_t* mfu_copy_opts = stream->mfu_copy_opts;
+
+    /* we ask the walk to stat every item, so this should not happen */
+    if (st == NULL) {
+        return;
+    }
+
+    /* skip large files, they are copied in chunks after the walk */
+    if (S_ISREG(mode) && ! mfu_copy_stream_is_small((uint64_t) st->st_size, mfu_copy_opts)) {
+        return;
+    }
+
+    /* the create and copy routines work on list items, so build a
+     * list holding just this item rather than index the list that the
+     * walk is still appending to */
+    mfu_flist list = mfu_flist_new();
+    ((flist_t*) list)->detail = 1;
+    mfu_flist_insert_stat((flist_t*) list, path, mode, st);
+
+    int tmp_rc = 0;
+    if (S_ISDIR(mode)) {
+        tmp_rc = mfu_create_directory(list, 0, stream->numpaths, stream->paths,
+            stream->destpath, mfu_copy_opts, stream->mfu_src_file, stream->mfu_dst_file);
+    } else if (S_ISLNK(mode)) {
+        tmp_rc = mfu_create_link(list, 0, stream->numpaths, stream->paths,
+            stream->destpath, mfu_copy_opts, stream->mfu_src_file, stream->mfu_dst_file);
+    } else if (S_ISREG(mode)) {
+        tmp_rc = mfu_create_file(list, 0, stream->numpaths, stream->paths,
+            stream->destpath, mfu_copy_opts, stream->mfu_src_file, stream->mfu_dst_file);
+
+        /* copy the whole file as one chunk */
+        char* dest = mfu_param_path_copy_dest(path, stream->numpaths, stream->paths,
+            stream->destpath, mfu_copy_opts, stream->mfu_src_file, stream->mfu_dst_file);
+        if (dest != NULL) {
+            uint64_t size = (uint64_t) st->st_size;
+            if (mfu_copy_file(path, dest, 0, size, size, mfu_copy_opts,
+                stream->mfu_src_file, stream->mfu_dst_file) < 0)
+            {
+                tmp_rc = -1;
+            }
+            mfu_free(&dest);
+        }
+    }
 
-    /* sum values across processes */
-    int64_t sums[5];
-    MPI_Allreduce(values, sums, 5, MPI_INT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (tmp_rc < 0) {
+        stream->rc = -1;
+    }
+    stream->count++;
 
-    /* extract results from allreduce */
-    int64_t agg_dirs   = sums[0];
-    int64_t agg_files  = sums[1];
-    int64_t agg_links  = sums[2];
-    int64_t agg_size   = sums[3];
-    int64_t agg_copied = sums[4];
+    mfu_flist_free(&list);
+}
 
-    /* compute rate of copy */
-    double agg_rate = (double)agg_copied / rel_time;
-    if (rel_time > 0.0) {
-        agg_rate = (double)agg_copied / rel_time;
-    }
+int mfu_flist_walk_copy(int numpaths, const mfu_param_path* paths,
+        const mfu_param_path* destpath, mfu_walk_opts_t* walk_opts, mfu_flist flist,
+        mfu_copy_opts_t* mfu_copy_opts, mfu_file_t* mfu_src_file, mfu_file_t* mfu_dst_file)
+{
+    /* assume we'll succeed */
+    int rc = 0;
 
-    if(rank == 0) {
-        /* format start time */
-        char starttime_str[256];
-        struct tm* localstart = localtime(&(mfu_copy_stats.time_started));
-        strftime(starttime_str, 256, "%b-%d-%Y,%H:%M:%S", localstart);
+    /* get our rank */
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
-        /* format end time */
-        char endtime_str[256];
-        struct tm* localend = localtime(&(mfu_copy_stats.time_ended));
-        strftime(endtime_str, 256, "%b-%d-%Y,%H:%M:%S", localend);
+    /* set up buffers, statistics, and timers */
+    mfu_copy_begin(destpath, mfu_copy_opts);
 
-        /* total number of items */
-        int64_t agg_items = agg_dirs + agg_files + agg_links;
+    if (rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Copying to %s while walking", mfu_copy_opts->dest_path);
+    }
+
+    /* we need file sizes to decide what to copy during the walk */
+    mfu_copy_stream_t stream;
+    stream.numpaths      = numpaths;
+    stream.paths         = paths;
+    stream.destpath      = destpath;
+    stream.mfu_copy_opts = mfu_copy_opts;
+    stream.mfu_src_file  = mfu_src_file;
+    stream.mfu_dst_file  = mfu_dst_file;
+    stream.count         = 0;
+    stream.rc            = 0;
+
+    mfu_walk_item_fn item_fn = walk_opts->item_fn;
+    void* item_arg = walk_opts->item_arg;
+    int use_stat = walk_opts->use_stat;
+    walk_opts->item_fn  = mfu_copy_stream_item;
+    walk_opts->item_arg = &stream;
+    walk_opts->use_stat = 1;
+
+    /* walk and copy directories, links, and small files as we go */
+    copy_throttle = mfu_throttle_start(MPI_COMM_WORLD);
+    mfu_flist_walk_param_paths((uint64_t) numpaths, paths, walk_opts, flist, mfu_src_file);
+    mfu_throttle_complete(&copy_throttle);
+
+    walk_opts->item_fn  = item_fn;
+    walk_opts->item_arg = item_arg;
+    walk_opts->use_stat = use_stat;
+
+    /* close files left open by the last copy in the walk */
+    mfu_copy_close_file(&mfu_copy_src_cache, mfu_src_file);
+    mfu_copy_close_file(&mfu_copy_dst_cache, mfu_dst_file);
 
-        /* convert size to units */
-        double agg_size_tmp;
-        const char* agg_size_units;
-        mfu_format_bytes((uint64_t)agg_size, &agg_size_tmp, &agg_size_units);
+    if (stream.rc < 0) {
+        rc = -1;
+    }
 
-        /* convert bandwidth to units */
-        double agg_rate_tmp;
-        const char* agg_rate_units;
-        mfu_format_bw(agg_rate, &agg_rate_tmp, &agg_rate_units);
+    /* report how much we got done during the walk */
+    mfu_flist_print_summary(flist);
+    uint64_t streamed;
+    MPI_Allreduce(&stream.count, &streamed, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) {
+        double secs = MPI_Wtime() - mfu_copy_stats.wtime_started;
+        MFU_LOG(MFU_LOG_INFO, "Copied %llu items during walk in %f seconds",
+            (unsigned long long) streamed, secs);
+    }
 
-        MFU_LOG(MFU_LOG_INFO, "Started: %s", starttime_str);
-        MFU_LOG(MFU_LOG_INFO, "Completed: %s", endtime_str);
-        MFU_LOG(MFU_LOG_INFO, "Seconds: %.3lf", rel_time);
-        MFU_LOG(MFU_LOG_INFO, "Items: %" PRId64, agg_items);
-        MFU_LOG(MFU_LOG_INFO, "  Directories: %" PRId64, agg_dirs);
-        MFU_LOG(MFU_LOG_INFO, "  Files: %" PRId64, agg_files);
-        MFU_LOG(MFU_LOG_INFO, "  Links: %" PRId64, agg_links);
-        MFU_LOG(MFU_LOG_INFO, "Data: %.3lf %s (%" PRId64 " bytes)",
-            agg_size_tmp, agg_size_units, agg_size);
+    /* gather the files that were too large to copy during the walk */
+    mfu_flist biglist = mfu_flist_subset(flist);
+    uint64_t idx;
+    uint64_t size = mfu_flist_size(flist);
+    for (idx = 0; idx < size; idx++) {
+        mfu_filetype type = mfu_flist_file_get_type(flist, idx);
+        uint64_t filesize = mfu_flist_file_get_size(flist, idx);
+        if (type == MFU_TYPE_FILE && ! mfu_copy_stream_is_small(filesize, mfu_copy_opts)) {
+            mfu_flist_file_copy(flist, idx, biglist);
+        }
+    }
+    mfu_flist_summarize(biglist);
 
-        MFU_LOG(MFU_LOG_INFO, "Rate: %.3lf %s " \
-            "(%.3" PRId64 " bytes in %.3lf seconds)", \
-            agg_rate_tmp, agg_rate_units, agg_copied, rel_time);
+    /* create and copy the large files in chunks */
+    if (mfu_flist_global_size(biglist) > 0) {
+        int biglevels, bigminlevel;
+        mfu_flist* biglists;
+        mfu_flist_array_by_depth(biglist, &biglevels, &bigminlevel, &biglists);
+
+        int tmp_rc = mfu_create_files(biglevels, bigminlevel, biglists, numpaths,
+                paths, destpath, mfu_copy_opts, mfu_src_file, mfu_dst_file);
+        if (tmp_rc < 0) {
+            rc = -1;
+        }
+
+        tmp_rc = mfu_copy_files(biglist, mfu_copy_opts->chunk_size,
+                numpaths, paths, destpath, mfu_copy_opts, mfu_src_file, mfu_dst_file);
+        if (tmp_rc < 0) {
+            rc = -1;
+        }
+
+        mfu_flist_array_free(biglevels, &biglists);
     }
+    mfu_flist_free(&biglist);
 
-    /* determine whether any process reported an error,
-     * inputs should are either 0 or -1, so min will be -1 on any -1 */
-    int all_rc;
-    MPI_Allreduce(&rc, &all_rc, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
-    rc = all_rc;
+    /* force data to backend to avoid the following metadata
+     * setting mismatch, which may happen on lustre */
+    mfu_sync_all("Syncing data to disk.");
+
+    /* set permissions, ownership, and timestamps on everything,
+     * directories are done last from the bottom up */
+    int levels, minlevel;
+    mfu_flist* lists;
+    mfu_flist_array_by_depth(flist, &levels, &minlevel, &lists);
+    mfu_copy_set_metadata(levels, minlevel, lists, numpaths,
+            paths, destpath, mfu_copy_opts, mfu_src_file, mfu_dst_file);
+    mfu_flist_array_free(levels, &lists);
+
+    /* force updates to disk */
+    mfu_sync_all("Syncing directory updates to disk.");
+
+    /* free buffers, print statistics, and check for errors */
+    rc = mfu_copy_end(rc, mfu_copy_opts);
 
     return rc;
 }
@@ -3186,9 +3645,15 @@ mfu_copy_opts_t* mfu_copy_opts_new(void)
     /* By default, don't use O_DIRECT. */
     opts->synchronous   = false;
 
+    /* By default, leave page cache management to the kernel */
+    opts->adaptive_io   = false;
+
     /* By default, don't use sparse file. */
     opts->sparse        = false;
 
+    /* By default, let destination files grow as data is written */
+    opts->preallocate   = false;
+
     /* Set default chunk size */
     opts->chunk_size    = FD_CHUNK_SIZE;
 
@@ -3203,6 +3668,12 @@ mfu_copy_opts_t* mfu_copy_opts_new(void)
     /* By default, do not limit the batch size */
     opts->batch_files   = 0;
 
+    /* By default, chunk files without regard to striping */
+    opts->stripe_align     = false;
+    opts->stripe_sim_size  = 0;
+    opts->stripe_sim_count = 0;
+    opts->stripe_sim_osts  = 0;
+
     return opts;
 }
 
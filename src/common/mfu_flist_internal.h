@@ -18,7 +18,7 @@ extern "C" {
 #include "mpi.h"
 
 #include "mfu.h"
-#include "strmap.h"
+#include "strhash.h"
 
 /****************************************
  * Define types
@@ -76,8 +76,8 @@ typedef struct flist {
     buf_t groups;
     int have_users;        /* set to 1 if user map is valid */
     int have_groups;       /* set to 1 if group map is valid */
-    strmap* user_id2name;  /* map linux uid to user name */
-    strmap* group_id2name; /* map linux gid to group name */
+    strhash* user_id2name;  /* map linux uid to user name */
+    strhash* group_id2name; /* map linux gid to group name */
 } flist_t;
 
 /* create a type consisting of chars number of characters
@@ -85,11 +85,11 @@ typedef struct flist {
 void mfu_flist_usrgrp_create_stridtype(int chars, MPI_Datatype* dt);
 
 /* build a name-to-id map and an id-to-name map */
-void mfu_flist_usrgrp_create_map(const buf_t* items, strmap* id2name);
+void mfu_flist_usrgrp_create_map(const buf_t* items, strhash* id2name);
 
 /* given an id, lookup its corresponding name, returns id converted
  * to a string if no matching name is found */
-const char* mfu_flist_usrgrp_get_name_from_id(strmap* id2name, uint64_t id);
+const char* mfu_flist_usrgrp_get_name_from_id(strhash* id2name, uint64_t id);
 
 /* read user array from file system using getpwent() */
 void mfu_flist_usrgrp_get_users(flist_t* flist);
@@ -109,6 +109,10 @@ void mfu_flist_usrgrp_copy(flist_t* srclist, flist_t* flist);
 /* append element to tail of linked list */
 void mfu_flist_insert_elem(flist_t* flist, elem_t* elem);
 
+/* given an index, return pointer to that file element,
+ * NULL if index is not in range */
+elem_t* mfu_flist_get_elem(flist_t* flist, uint64_t idx);
+
 /* insert a file given its mode and optional stat data */
 void mfu_flist_insert_stat(flist_t* flist, const char* fpath, mode_t mode, const struct stat* sb);
 
@@ -1326,16 +1326,63 @@ static void write_cache_readdir_variable(
     return;
 }
 
-static void write_cache_stat_v4(
+/* write the header, users, and groups of a cache file with stat detail
+ * from rank 0, where all_count is the total number of items and chars
+ * is the number of chars in each file name, returns the number of bytes
+ * in the header, users, and groups, which is the offset of the first
+ * record */
+static MPI_Offset write_cache_stat_header(
+    MPI_File fh,
     const char* name,
-    flist_t* flist)
+    flist_t* flist,
+    uint64_t all_count,
+    uint64_t chars)
 {
     buf_t* users  = &flist->users;
     buf_t* groups = &flist->groups;
 
-    /* get our rank in job & number of ranks */
-    int rank, ranks;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    int header_bytes = 7 * 8;
+    int user_buf_size  = (users->dt  != MPI_DATATYPE_NULL) ? (int) buft_pack_size(users)  : 0;
+    int group_buf_size = (groups->dt != MPI_DATATYPE_NULL) ? (int) buft_pack_size(groups) : 0;
+    size_t size = (size_t) header_bytes + (size_t) user_buf_size + (size_t) group_buf_size;
+
+    if (mfu_rank == 0) {
+        char* header = (char*) MFU_MALLOC(size);
+        char* ptr = header;
+        mfu_pack_io_uint64(&ptr, 4);               /* file version */
+        mfu_pack_io_uint64(&ptr, users->count);    /* number of user records */
+        mfu_pack_io_uint64(&ptr, users->chars);    /* number of chars in user name */
+        mfu_pack_io_uint64(&ptr, groups->count);   /* number of group records */
+        mfu_pack_io_uint64(&ptr, groups->chars);   /* number of chars in group name */
+        mfu_pack_io_uint64(&ptr, all_count);       /* total number of stat entries */
+        mfu_pack_io_uint64(&ptr, chars);           /* number of chars in file name */
+        if (user_buf_size > 0) {
+            buft_pack(ptr, users);
+            ptr += user_buf_size;
+        }
+        if (group_buf_size > 0) {
+            buft_pack(ptr, groups);
+            ptr += group_buf_size;
+        }
+
+        MPI_Status status;
+        int mpirc = MPI_File_write_at(fh, 0, header, (int) size, MPI_BYTE, &status);
+        if (mpirc != MPI_SUCCESS) {
+            MPI_Error_string(mpirc, mpierrstr, &mpierrlen);
+            MFU_ABORT(1, "Failed to write to file: `%s' rc=%d %s", name, mpirc, mpierrstr);
+        }
+        mfu_free(&header);
+    }
+
+    return (MPI_Offset) size;
+}
+
+static void write_cache_stat_v4(
+    const char* name,
+    flist_t* flist)
+{
+    /* get number of ranks */
+    int ranks;
     MPI_Comm_size(MPI_COMM_WORLD, &ranks);
 
     /* use mpi io hints to stripe across OSTs */
@@ -1385,81 +1432,8 @@ static void write_cache_stat_v4(
         MFU_ABORT(1, "Failed to truncate file: `%s' rc=%d %s", name, mpirc, mpierrstr);
     }
 
-    /* prepare header */
-    int header_bytes = 7 * 8;
-    uint64_t header[7];
-    char* ptr = (char*) header;
-    mfu_pack_io_uint64(&ptr, 4);               /* file version */
-    mfu_pack_io_uint64(&ptr, users->count);    /* number of user records */
-    mfu_pack_io_uint64(&ptr, users->chars);    /* number of chars in user name */
-    mfu_pack_io_uint64(&ptr, groups->count);   /* number of group records */
-    mfu_pack_io_uint64(&ptr, groups->chars);   /* number of chars in group name */
-    mfu_pack_io_uint64(&ptr, all_count);       /* total number of stat entries */
-    mfu_pack_io_uint64(&ptr, (uint64_t)chars); /* number of chars in file name */
-
-    /* set view to write the header */
-    MPI_Offset disp = 0;
-    mpirc = MPI_File_set_view(fh, disp, MPI_BYTE, MPI_BYTE, datarep, MPI_INFO_NULL);
-    if (mpirc != MPI_SUCCESS) {
-        MPI_Error_string(mpirc, mpierrstr, &mpierrlen);
-        MFU_ABORT(1, "Failed to set view on file: `%s' rc=%d %s", name, mpirc, mpierrstr);
-    }
-
-    /* write the header */
-    if (rank == 0) {
-        mpirc = MPI_File_write_at(fh, 0, header, header_bytes, MPI_BYTE, &status);
-        if (mpirc != MPI_SUCCESS) {
-            MPI_Error_string(mpirc, mpierrstr, &mpierrlen);
-            MFU_ABORT(1, "Failed to write to file: `%s' rc=%d %s", name, mpirc, mpierrstr);
-        }
-    }
-    disp += header_bytes;
-
-    if (users->dt != MPI_DATATYPE_NULL) {
-        /* set view to write out users */
-        mpirc = MPI_File_set_view(fh, disp, MPI_BYTE, MPI_BYTE, datarep, MPI_INFO_NULL);
-        if (mpirc != MPI_SUCCESS) {
-            MPI_Error_string(mpirc, mpierrstr, &mpierrlen);
-            MFU_ABORT(1, "Failed to set view on file: `%s' rc=%d %s", name, mpirc, mpierrstr);
-        }
-
-        /* write out users */
-        int user_buf_size = (int) buft_pack_size(users);
-        if (rank == 0) {
-            char* user_buf = (char*) MFU_MALLOC(user_buf_size);
-            buft_pack(user_buf, users);
-            mpirc = MPI_File_write_at(fh, 0, user_buf, user_buf_size, MPI_BYTE, &status);
-            if (mpirc != MPI_SUCCESS) {
-                MPI_Error_string(mpirc, mpierrstr, &mpierrlen);
-                MFU_ABORT(1, "Failed to write to file: `%s' rc=%d %s", name, mpirc, mpierrstr);
-            }
-            mfu_free(&user_buf);
-        }
-        disp += (MPI_Offset)user_buf_size;
-    }
-
-    if (groups->dt != MPI_DATATYPE_NULL) {
-        /* set view to write out groups */
-        mpirc = MPI_File_set_view(fh, disp, MPI_BYTE, MPI_BYTE, datarep, MPI_INFO_NULL);
-        if (mpirc != MPI_SUCCESS) {
-            MPI_Error_string(mpirc, mpierrstr, &mpierrlen);
-            MFU_ABORT(1, "Failed to set view on file: `%s' rc=%d %s", name, mpirc, mpierrstr);
-        }
-
-        /* write out groups */
-        int group_buf_size = (int) buft_pack_size(groups);
-        if (rank == 0) {
-            char* group_buf = (char*) MFU_MALLOC(group_buf_size);
-            buft_pack(group_buf, groups);
-            mpirc = MPI_File_write_at(fh, 0, group_buf, group_buf_size, MPI_BYTE, &status);
-            if (mpirc != MPI_SUCCESS) {
-                MPI_Error_string(mpirc, mpierrstr, &mpierrlen);
-                MFU_ABORT(1, "Failed to write to file: `%s' rc=%d %s", name, mpirc, mpierrstr);
-            }
-            mfu_free(&group_buf);
-        }
-        disp += (MPI_Offset)group_buf_size;
-    }
+    /* write header, users, and groups */
+    MPI_Offset disp = write_cache_stat_header(fh, name, flist, all_count, (uint64_t)chars);
 
     /* in order to avoid blowing out memory, we'll pack into a smaller
      * buffer and iteratively make many collective writes */
@@ -1502,7 +1476,7 @@ static void write_cache_stat_v4(
     const elem_t* current = flist->list_head;
     while (all_iters > 0) {
         /* copy stat data into write buffer */
-        ptr = (char*) buf;
+        char* ptr = (char*) buf;
         uint64_t packcount = 0;
         while (current != NULL && packcount < bufbytes) {
             /* pack item into buffer and advance pointer */
@@ -1543,6 +1517,102 @@ static void write_cache_stat_v4(
     return;
 }
 
+/* shorten prefix of length len to the longest path that is or contains name,
+ * returns the new length */
+static size_t common_prefix_len(const char* prefix, size_t len, const char* name)
+{
+    /* count characters in common */
+    size_t i = 0;
+    while (i < len && name[i] != '\0' && name[i] == prefix[i]) {
+        i++;
+    }
+
+    /* back up until the common part ends at a full path component in both */
+    while (i > 0) {
+        int prefix_end = (i == len || prefix[i] == '/');
+        int name_end   = (name[i] == '\0' || name[i] == '/');
+        if (prefix_end && name_end) {
+            break;
+        }
+        i--;
+    }
+
+    /* keep the root directory rather than returning an empty string */
+    if (i == 0 && prefix[0] == '/' && name[0] == '/') {
+        return 1;
+    }
+    return i;
+}
+
+char* mfu_flist_common_prefix(mfu_flist flist)
+{
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* compute common prefix of our local items */
+    const char* prefix = NULL;
+    size_t len = 0;
+    uint64_t idx;
+    uint64_t size = mfu_flist_size(flist);
+    for (idx = 0; idx < size; idx++) {
+        const char* name = mfu_flist_file_get_name(flist, idx);
+        if (prefix == NULL) {
+            prefix = name;
+            len = strlen(name);
+        } else {
+            len = common_prefix_len(prefix, len, name);
+        }
+    }
+
+    /* gather local prefixes, ranks without items send nothing */
+    int count = (prefix != NULL) ? (int) len + 1 : 0;
+    int* counts = (int*) MFU_MALLOC(ranks * sizeof(int));
+    int* displs = (int*) MFU_MALLOC(ranks * sizeof(int));
+    MPI_Allgather(&count, 1, MPI_INT, counts, 1, MPI_INT, MPI_COMM_WORLD);
+
+    int total = 0;
+    int i;
+    for (i = 0; i < ranks; i++) {
+        displs[i] = total;
+        total += counts[i];
+    }
+
+    char* sendbuf = (char*) MFU_MALLOC((size_t) count + 1);
+    if (prefix != NULL) {
+        memcpy(sendbuf, prefix, len);
+        sendbuf[len] = '\0';
+    }
+    char* recvbuf = (char*) MFU_MALLOC((size_t) total + 1);
+    MPI_Allgatherv(sendbuf, count, MPI_CHAR, recvbuf, counts, displs, MPI_CHAR, MPI_COMM_WORLD);
+
+    /* reduce gathered prefixes to a single prefix */
+    char* result = NULL;
+    len = 0;
+    for (i = 0; i < ranks; i++) {
+        if (counts[i] == 0) {
+            continue;
+        }
+        const char* name = recvbuf + displs[i];
+        if (result == NULL) {
+            result = MFU_STRDUP(name);
+            len = strlen(result);
+        } else {
+            len = common_prefix_len(result, len, name);
+        }
+    }
+    if (result != NULL) {
+        result[len] = '\0';
+    }
+
+    mfu_free(&recvbuf);
+    mfu_free(&sendbuf);
+    mfu_free(&displs);
+    mfu_free(&counts);
+
+    return result;
+}
+
 void mfu_flist_write_cache(
     const char* name,
     mfu_flist bflist)
@@ -1828,3 +1898,239 @@ void mfu_flist_write_text(
 
     return;
 }
+
+/****************************************
+ * Stream selected items to a file
+ ***************************************/
+
+struct mfu_flist_writer_struct {
+    char* name;          /* name of file to write */
+    flist_t* flist;      /* list that defines detail, users, and groups */
+    int cache;           /* 1 to write cache format, 0 for text */
+    int detail;          /* whether items have stat detail */
+    uint64_t count;      /* number of items this rank counted */
+    uint64_t bytes;      /* number of bytes this rank counted for variable-length records */
+    uint64_t max_name;   /* longest name this rank counted, including terminating NUL */
+    uint64_t all_count;  /* number of items counted on all ranks */
+    uint64_t chars;      /* number of chars for each name in fixed-length records */
+    int open;            /* whether the file has been opened */
+    MPI_File fh;         /* file handle */
+    MPI_Info info;       /* hints used to open the file */
+    MPI_Offset offset;   /* offset of next byte this rank writes */
+    char* buf;           /* buffered records */
+    size_t bufsize;      /* number of bytes allocated in buf */
+    size_t buflen;       /* number of bytes in buf */
+    double start;        /* time the writer was created */
+};
+
+/* return number of bytes to encode item in file */
+static size_t writer_item_size(mfu_flist_writer* w, mfu_flist flist, uint64_t idx)
+{
+    if (! w->cache) {
+        return print_file_text(flist, idx, NULL, 0);
+    }
+
+    elem_t* elem = mfu_flist_get_elem((flist_t*) flist, idx);
+    if (w->detail) {
+        return list_elem_pack_size(w->detail, w->chars, elem);
+    }
+    return list_elem_encode_size(elem);
+}
+
+mfu_flist_writer* mfu_flist_writer_new(const char* name, mfu_flist flist, int cache)
+{
+    mfu_flist_writer* w = (mfu_flist_writer*) MFU_MALLOC(sizeof(mfu_flist_writer));
+    w->name      = MFU_STRDUP(name);
+    w->flist     = (flist_t*) flist;
+    w->cache     = cache;
+    w->detail    = w->flist->detail;
+    w->count     = 0;
+    w->bytes     = 0;
+    w->max_name  = 0;
+    w->all_count = 0;
+    w->chars     = 0;
+    w->open      = 0;
+    w->offset    = 0;
+    w->buf       = NULL;
+    w->bufsize   = 0;
+    w->buflen    = 0;
+    w->start     = MPI_Wtime();
+    return w;
+}
+
+void mfu_flist_writer_count(mfu_flist_writer* w, mfu_flist flist, uint64_t idx)
+{
+    w->count++;
+
+    const char* file = mfu_flist_file_get_name(flist, idx);
+    uint64_t len = (uint64_t) strlen(file) + 1;
+    if (len > w->max_name) {
+        w->max_name = len;
+    }
+
+    /* fixed-length records are sized once we know the longest name */
+    if (! w->cache || ! w->detail) {
+        w->bytes += (uint64_t) writer_item_size(w, flist, idx);
+    }
+}
+
+void mfu_flist_writer_start(mfu_flist_writer* w)
+{
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    uint64_t all_max_name;
+    MPI_Allreduce(&w->count, &w->all_count, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(&w->max_name, &all_max_name, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
+
+    /* find smallest length that fits max and consists of integer
+     * number of 8 byte segments */
+    w->chars = (all_max_name + 7) / 8 * 8;
+
+    /* compute number of bytes we write, fixed-length records
+     * can be sized now that we know the longest name */
+    uint64_t bytes = w->bytes;
+    if (w->cache && w->detail) {
+        bytes = w->count * (uint64_t) list_elem_pack_size(w->detail, w->chars, NULL);
+    }
+    uint64_t offset = 0;
+    MPI_Exscan(&bytes, &offset, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) {
+        offset = 0;
+    }
+
+    /* report the filename we're writing to */
+    if (mfu_rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Writing to output file: %s", w->name);
+    }
+
+    /* like mfu_flist_write_cache, do not create an empty cache file */
+    if (w->cache && w->all_count == 0) {
+        return;
+    }
+
+    /* use mpi io hints to stripe across OSTs */
+    MPI_Info_create(&w->info);
+
+    /* no. of I/O devices for lustre striping is number of ranks */
+    char str_buf[12];
+    sprintf(str_buf, "%d", ranks);
+    MPI_Info_set(w->info, "striping_factor", str_buf);
+
+    /* open file */
+    int amode = MPI_MODE_WRONLY | MPI_MODE_CREATE;
+    int mpirc = MPI_File_open(MPI_COMM_WORLD, w->name, amode, w->info, &w->fh);
+    if (mpirc != MPI_SUCCESS) {
+        MPI_Error_string(mpirc, mpierrstr, &mpierrlen);
+        MFU_ABORT(1, "Failed to open file for writing: `%s' rc=%d %s", w->name, mpirc, mpierrstr);
+    }
+    w->open = 1;
+
+    /* truncate file to 0 bytes */
+    mpirc = MPI_File_set_size(w->fh, 0);
+    if (mpirc != MPI_SUCCESS) {
+        MPI_Error_string(mpirc, mpierrstr, &mpierrlen);
+        MFU_ABORT(1, "Failed to truncate file: `%s' rc=%d %s", w->name, mpirc, mpierrstr);
+    }
+
+    /* write header, users, and groups of a cache file with stat detail */
+    MPI_Offset disp = 0;
+    if (w->cache && w->detail) {
+        disp = write_cache_stat_header(w->fh, w->name, w->flist, w->all_count, w->chars);
+    }
+
+    /* set file view to be sequence of records past header */
+    mpirc = MPI_File_set_view(w->fh, disp, MPI_BYTE, MPI_BYTE, datarep_native, MPI_INFO_NULL);
+    if (mpirc != MPI_SUCCESS) {
+        MPI_Error_string(mpirc, mpierrstr, &mpierrlen);
+        MFU_ABORT(1, "Failed to set view on file: `%s' rc=%d %s", w->name, mpirc, mpierrstr);
+    }
+
+    w->offset = (MPI_Offset) offset;
+}
+
+void mfu_flist_writer_add(mfu_flist_writer* w, mfu_flist flist, uint64_t idx)
+{
+    /* make room for the record, text records need room for a NUL */
+    size_t size = writer_item_size(w, flist, idx);
+    if (w->buflen + size + 1 > w->bufsize) {
+        size_t bufsize = (w->bufsize > 0) ? w->bufsize : 1024 * 1024;
+        while (w->buflen + size + 1 > bufsize) {
+            bufsize *= 2;
+        }
+        char* buf = (char*) MFU_MALLOC(bufsize);
+        if (w->buflen > 0) {
+            memcpy(buf, w->buf, w->buflen);
+        }
+        mfu_free(&w->buf);
+        w->buf = buf;
+        w->bufsize = bufsize;
+    }
+
+    char* ptr = w->buf + w->buflen;
+    if (! w->cache) {
+        w->buflen += print_file_text(flist, idx, ptr, w->bufsize - w->buflen);
+    } else {
+        elem_t* elem = mfu_flist_get_elem((flist_t*) flist, idx);
+        if (w->detail) {
+            w->buflen += list_elem_pack(ptr, w->detail, w->chars, elem);
+        } else {
+            w->buflen += list_elem_encode(ptr, elem);
+        }
+    }
+}
+
+void mfu_flist_writer_flush(mfu_flist_writer* w)
+{
+    if (! w->open) {
+        w->buflen = 0;
+        return;
+    }
+
+    /* collective write of buffered records */
+    MPI_Status status;
+    int write_count = (int) w->buflen;
+    int mpirc = MPI_File_write_at_all(w->fh, w->offset, w->buf, write_count, MPI_BYTE, &status);
+    if (mpirc != MPI_SUCCESS) {
+        MPI_Error_string(mpirc, mpierrstr, &mpierrlen);
+        MFU_ABORT(1, "Failed to write to file: `%s' rc=%d %s", w->name, mpirc, mpierrstr);
+    }
+
+    /* update our offset with the number of bytes we just wrote */
+    w->offset += (MPI_Offset) w->buflen;
+    w->buflen = 0;
+}
+
+void mfu_flist_writer_close(mfu_flist_writer** pw)
+{
+    mfu_flist_writer* w = *pw;
+
+    /* write what remains */
+    mfu_flist_writer_flush(w);
+
+    if (w->open) {
+        int mpirc = MPI_File_close(&w->fh);
+        if (mpirc != MPI_SUCCESS) {
+            MPI_Error_string(mpirc, mpierrstr, &mpierrlen);
+            MFU_ABORT(1, "Failed to close file: `%s' rc=%d %s", w->name, mpirc, mpierrstr);
+        }
+        MPI_Info_free(&w->info);
+    }
+
+    /* report write count, time, and rate */
+    if (mfu_rank == 0) {
+        double secs = MPI_Wtime() - w->start;
+        double rate = 0.0;
+        if (secs > 0.0) {
+            rate = ((double)w->all_count) / secs;
+        }
+        MFU_LOG(MFU_LOG_INFO, "Wrote %lu files in %f seconds (%f files/sec)",
+            w->all_count, secs, rate
+        );
+    }
+
+    mfu_free(&w->buf);
+    mfu_free(&w->name);
+    mfu_free(pw);
+}
@@ -32,6 +32,9 @@ uint64_t remove_count_total;
 /* remove progress request */
 mfu_progress* rmprog;
 
+/* rate limits items removed */
+static mfu_throttle* rmthrottle;
+
 /* prints progress messages while deleting items */
 static void remove_progress_fn(const uint64_t* vals, int count, int complete, int ranks, double secs)
 {
@@ -98,6 +101,9 @@ static void remove_type(char type, const char* name)
                  );
     }
 
+    /* hold to our share of the metadata rate limit */
+    mfu_throttle_update(0, 1, rmthrottle);
+
     return;
 }
 
@@ -565,6 +571,9 @@ void mfu_flist_unlink(mfu_flist flist, bool traceless)
         /* get list of items for this level */
         mfu_flist list = lists[level];
 
+        /* limit rate at which we remove items */
+        rmthrottle = mfu_throttle_start(MPI_COMM_WORLD);
+
         uint64_t count = 0;
         //remove_direct(list, &count);
         remove_spread(list, &count);
@@ -573,6 +582,10 @@ void mfu_flist_unlink(mfu_flist flist, bool traceless)
 //        remove_libcircle(list, &count);
 //        TODO: remove sort w/ spread
 
+        /* finish the throttle before the barrier, so that idle
+         * processes keep rebalancing shares among busy ones */
+        mfu_throttle_complete(&rmthrottle);
+
         /* wait for all procs to finish before we start
          * with files at next level */
         MPI_Barrier(MPI_COMM_WORLD);
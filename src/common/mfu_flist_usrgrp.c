@@ -38,7 +38,7 @@
 #include "dtcmp.h"
 #include "mfu.h"
 #include "mfu_flist_internal.h"
-#include "strmap.h"
+#include "strhash.h"
 
 /****************************************
  * Functions on types
@@ -86,7 +86,7 @@ static void buft_free(buf_t* items)
 }
 
 /* build a name-to-id map and an id-to-name map */
-void mfu_flist_usrgrp_create_map(const buf_t* items, strmap* id2name)
+void mfu_flist_usrgrp_create_map(const buf_t* items, strhash* id2name)
 {
     uint64_t i;
     const char* ptr = (const char*)items->buf;
@@ -111,14 +111,14 @@ void mfu_flist_usrgrp_create_map(const buf_t* items, strmap* id2name)
             MFU_LOG(MFU_LOG_ERR, "Converting id %llu to string needs buffer of at least %d chars", (unsigned long long) id, len_int+1);
         }
 
-        strmap_set(id2name, id_str, name);
+        strhash_set(id2name, id_str, name);
     }
     return;
 }
 
 /* given an id, lookup its corresponding name, returns id converted
  * to a string if no matching name is found */
-const char* mfu_flist_usrgrp_get_name_from_id(strmap* id2name, uint64_t id)
+const char* mfu_flist_usrgrp_get_name_from_id(strhash* id2name, uint64_t id)
 {
     /* convert id number to string representation */
     char id_str[32];
@@ -135,12 +135,12 @@ const char* mfu_flist_usrgrp_get_name_from_id(strmap* id2name, uint64_t id)
     }
 
     /* lookup name by id */
-    const char* name = strmap_get(id2name, id_str);
+    const char* name = strhash_get(id2name, id_str);
 
     /* if not found, store id as name and return that */
     if (name == NULL) {
-        strmap_set(id2name, id_str, id_str);
-        name = strmap_get(id2name, id_str);
+        strhash_set(id2name, id_str, id_str);
+        name = strhash_get(id2name, id_str);
     }
 
     return name;
@@ -471,8 +471,8 @@ void mfu_flist_usrgrp_init(flist_t* flist)
     /* allocate memory for maps */
     flist->have_users  = 0;
     flist->have_groups = 0;
-    flist->user_id2name  = strmap_new();
-    flist->group_id2name = strmap_new();
+    flist->user_id2name  = strhash_new();
+    flist->group_id2name = strhash_new();
 
     return;
 }
@@ -483,8 +483,8 @@ void mfu_flist_usrgrp_free(flist_t* flist)
     buft_free(&flist->users);
     buft_free(&flist->groups);
 
-    strmap_delete(&flist->user_id2name);
-    strmap_delete(&flist->group_id2name);
+    strhash_delete(&flist->user_id2name);
+    strhash_delete(&flist->group_id2name);
 
     return;
 }
@@ -494,8 +494,8 @@ void mfu_flist_usrgrp_copy(flist_t* srclist, flist_t* flist)
 {
     buft_copy(&srclist->users, &flist->users);
     buft_copy(&srclist->groups, &flist->groups);
-    strmap_merge(flist->user_id2name, srclist->user_id2name);
-    strmap_merge(flist->group_id2name, srclist->group_id2name);
+    strhash_merge(flist->user_id2name, srclist->user_id2name);
+    strhash_merge(flist->group_id2name, srclist->group_id2name);
     flist->have_users  = 1;
     flist->have_groups = 1;
 
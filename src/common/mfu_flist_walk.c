@@ -51,6 +51,18 @@ static flist_t* CURRENT_LIST;
 static int SET_DIR_PERMS;
 static int REMOVE_FILES;
 static mfu_file_t** CURRENT_PFILE;
+static mfu_walk_item_fn ITEM_FN;
+static void* ITEM_ARG;
+static mfu_walk_dir_fn DIR_FN;
+static void* DIR_ARG;
+
+/* report an item that was just recorded to the caller's callback */
+static void walk_item(const char* path, mode_t mode, const struct stat* st)
+{
+    if (ITEM_FN != NULL) {
+        ITEM_FN(path, mode, st, ITEM_ARG);
+    }
+}
 
 /****************************************
  * Global counter and callbacks for LIBCIRCLE reductions
@@ -226,6 +238,7 @@ static void walk_getdents_process_dir(const char* dir, CIRCLE_handle* handle)
 
                     /* insert a record for this item into our list */
                     mfu_flist_insert_stat(CURRENT_LIST, newpath, mode, NULL);
+                    walk_item(newpath, mode, NULL);
 
                     /* recurse on directory if we have one */
                     if (d_type == DT_DIR) {
@@ -271,6 +284,7 @@ static void walk_getdents_create(CIRCLE_handle* handle)
 
         /* record item info */
         mfu_flist_insert_stat(CURRENT_LIST, path, st.st_mode, &st);
+        walk_item(path, st.st_mode, &st);
 
         /* recurse into directory */
         if (S_ISDIR(st.st_mode)) {
@@ -360,6 +374,7 @@ static void walk_readdir_process_dir(const char* dir, CIRCLE_handle* handle)
                             have_mode = 1;
                             mode = DTTOIF(entry->d_type);
                             mfu_flist_insert_stat(CURRENT_LIST, newpath, mode, NULL);
+                            walk_item(newpath, mode, NULL);
                         }
                     }
                     else {
@@ -375,6 +390,7 @@ static void walk_readdir_process_dir(const char* dir, CIRCLE_handle* handle)
                                 mfu_unlink(newpath);
                             } else {
                                 mfu_flist_insert_stat(CURRENT_LIST, newpath, mode, &st);
+                                walk_item(newpath, mode, &st);
                             }
                         }
                         else {
@@ -426,6 +442,7 @@ static void walk_readdir_create(CIRCLE_handle* handle)
 
         /* record item info */
         mfu_flist_insert_stat(CURRENT_LIST, path, st.st_mode, &st);
+        walk_item(path, st.st_mode, &st);
 
         /* recurse into directory */
         if (S_ISDIR(st.st_mode)) {
@@ -531,6 +548,7 @@ static void walk_stat_process(CIRCLE_handle* handle)
     } else {
         /* record info for item in list */
         mfu_flist_insert_stat(CURRENT_LIST, path, st.st_mode, &st);
+        walk_item(path, st.st_mode, &st);
     }
 
     /* recurse into directory */
@@ -548,6 +566,20 @@ static void walk_stat_process(CIRCLE_handle* handle)
                 mfu_file_chmod(path, st.st_mode, mfu_file);
             }
         }
+
+        /* let caller replace the entries of this directory */
+        if (DIR_FN != NULL) {
+            uint64_t count;
+            const char** paths = DIR_FN(path, &st, &count, DIR_ARG);
+            if (paths != NULL) {
+                uint64_t i;
+                for (i = 0; i < count; i++) {
+                    handle->enqueue((char*)paths[i]);
+                }
+                return;
+            }
+        }
+
         /* TODO: check that we can recurse into directory */
         walk_stat_process_dir(path, handle);
     }
@@ -628,6 +660,14 @@ void mfu_flist_walk_paths(uint64_t num_paths, const char** paths,
         }
     }
 
+    /* hand items to caller as we find them */
+    ITEM_FN  = walk_opts->item_fn;
+    ITEM_ARG = walk_opts->item_arg;
+
+    /* let caller skip reading directories */
+    DIR_FN  = walk_opts->dir_fn;
+    DIR_ARG = walk_opts->dir_arg;
+
     /* register callbacks */
     CURRENT_PFILE = &mfu_file;
     if (walk_opts->use_stat) {
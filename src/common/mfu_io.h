@@ -146,6 +146,10 @@ int mfu_file_ftruncate(mfu_file_t* mfu_file, off_t length);
 int daos_ftruncate(mfu_file_t* mfu_file, off_t length);
 int mfu_ftruncate(int fd, off_t length);
 
+/* allocate blocks for the first length bytes of a file,
+ * fails with EOPNOTSUPP if the file system does not support it */
+int mfu_fallocate(const char* file, int fd, off_t length);
+
 /* delete a file */
 int mfu_unlink(const char* file);
 
@@ -0,0 +1,443 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "mfu.h"
+
+/* find bucket holding key, or the empty bucket where it belongs */
+static uint64_t mfu_itemmap_probe(const mfu_itemmap* map, const char* key, uint32_t hash)
+{
+    /* linear probing, table is never more than half full */
+    uint64_t mask = map->buckets - 1;
+    uint64_t bucket = (uint64_t)hash & mask;
+    while (map->table[bucket] != 0) {
+        uint64_t slot = map->table[bucket] - 1;
+        if (map->hashes[slot] == hash && strcmp(map->keys[slot], key) == 0) {
+            break;
+        }
+        bucket = (bucket + 1) & mask;
+    }
+    return bucket;
+}
+
+mfu_itemmap* mfu_itemmap_new(mfu_flist list, size_t prefix_len)
+{
+    mfu_itemmap* map = (mfu_itemmap*) MFU_MALLOC(sizeof(mfu_itemmap));
+
+    /* size hash table to at least twice the number of items */
+    uint64_t size = mfu_flist_size(list);
+    uint64_t buckets = 16;
+    while (buckets < size * 2) {
+        buckets <<= 1;
+    }
+
+    map->list       = list;
+    map->prefix_len = prefix_len;
+    map->cursor     = 0;
+    map->count      = 0;
+    map->buckets    = buckets;
+    map->table   = (uint64_t*) MFU_MALLOC(buckets * sizeof(uint64_t));
+    memset(map->table, 0, buckets * sizeof(uint64_t));
+
+    /* allocate a slot for every item, fewer are used if there are duplicates */
+    map->hashes = (uint32_t*)    MFU_MALLOC(size * sizeof(uint32_t));
+    map->keys   = (const char**) MFU_MALLOC(size * sizeof(const char*));
+    map->index  = (uint64_t*)    MFU_MALLOC(size * sizeof(uint64_t));
+    map->states = (uint64_t*)    MFU_MALLOC(size * sizeof(uint64_t));
+
+    uint64_t idx;
+    for (idx = 0; idx < size; idx++) {
+        /* ignore prefix portion of path */
+        const char* key = mfu_flist_file_get_name(list, idx) + prefix_len;
+        uint32_t hash = mfu_hash_jenkins(key, strlen(key));
+
+        uint64_t bucket = mfu_itemmap_probe(map, key, hash);
+        if (map->table[bucket] != 0) {
+            /* duplicate key, point existing slot at the later item */
+            uint64_t slot = map->table[bucket] - 1;
+            map->keys[slot]  = key;
+            map->index[slot] = idx;
+            continue;
+        }
+
+        uint64_t slot = map->count;
+        map->hashes[slot] = hash;
+        map->keys[slot]   = key;
+        map->index[slot]  = idx;
+        map->states[slot] = 0;
+        map->table[bucket] = slot + 1;
+        map->count++;
+    }
+
+    return map;
+}
+
+/* key and original list position of an item, used to sort slots */
+typedef struct {
+    const char* key;
+    uint64_t idx;
+} mfu_itemmap_elem;
+
+/* order by key, and by list position for equal keys */
+static int mfu_itemmap_elem_cmp(const void* a, const void* b)
+{
+    const mfu_itemmap_elem* x = (const mfu_itemmap_elem*) a;
+    const mfu_itemmap_elem* y = (const mfu_itemmap_elem*) b;
+    int cmp = strcmp(x->key, y->key);
+    if (cmp != 0) {
+        return cmp;
+    }
+    if (x->idx < y->idx) {
+        return -1;
+    }
+    return (x->idx > y->idx);
+}
+
+mfu_itemmap* mfu_itemmap_new_sorted(mfu_flist list, size_t prefix_len)
+{
+    mfu_itemmap* map = (mfu_itemmap*) MFU_MALLOC(sizeof(mfu_itemmap));
+
+    uint64_t size = mfu_flist_size(list);
+
+    map->list       = list;
+    map->prefix_len = prefix_len;
+    map->cursor     = 0;
+    map->count      = 0;
+    map->buckets    = 0;
+    map->table      = NULL;
+    map->hashes     = NULL;
+    map->keys       = NULL;
+    map->index      = (uint64_t*) MFU_MALLOC(size * sizeof(uint64_t));
+    map->states     = (uint64_t*) MFU_MALLOC(size * sizeof(uint64_t));
+
+    /* check whether the list is already in order, which is
+     * the common case when it comes from mfu_flist_sort */
+    int in_order = 1;
+    uint64_t idx;
+    for (idx = 1; idx < size; idx++) {
+        const char* prev = mfu_flist_file_get_name(list, idx - 1) + prefix_len;
+        const char* key  = mfu_flist_file_get_name(list, idx) + prefix_len;
+        if (strcmp(prev, key) >= 0) {
+            in_order = 0;
+            break;
+        }
+    }
+
+    if (in_order) {
+        for (idx = 0; idx < size; idx++) {
+            map->index[idx]  = idx;
+            map->states[idx] = 0;
+        }
+        map->count = size;
+        return map;
+    }
+
+    /* otherwise sort keys locally */
+    mfu_itemmap_elem* elems = (mfu_itemmap_elem*) MFU_MALLOC(size * sizeof(mfu_itemmap_elem));
+    for (idx = 0; idx < size; idx++) {
+        elems[idx].key = mfu_flist_file_get_name(list, idx) + prefix_len;
+        elems[idx].idx = idx;
+    }
+    qsort(elems, (size_t) size, sizeof(mfu_itemmap_elem), mfu_itemmap_elem_cmp);
+
+    for (idx = 0; idx < size; idx++) {
+        /* duplicate key, point existing slot at the later item */
+        if (map->count > 0 && strcmp(elems[idx].key, elems[idx - 1].key) == 0) {
+            map->index[map->count - 1] = elems[idx].idx;
+            continue;
+        }
+
+        uint64_t slot = map->count;
+        map->index[slot]  = elems[idx].idx;
+        map->states[slot] = 0;
+        map->count++;
+    }
+
+    mfu_free(&elems);
+
+    return map;
+}
+
+/* state passed to the map function of mfu_itemmap_partition */
+typedef struct {
+    size_t prefix_len;  /* prefix length of names in list being mapped */
+    int rank;           /* rank of calling process */
+    int ranks;          /* number of ranks with items in ref */
+    int* owners;        /* rank that owns each splitter */
+    char** splitters;   /* first key of ref on each rank that has items */
+} mfu_itemmap_partition_args;
+
+/* return the last rank whose first key is not larger than the item key */
+static int mfu_itemmap_partition_fn(mfu_flist list, uint64_t idx, int ranks, void* args)
+{
+    mfu_itemmap_partition_args* part = (mfu_itemmap_partition_args*) args;
+
+    /* keep items in place if ref is empty everywhere */
+    if (part->ranks == 0) {
+        return part->rank;
+    }
+
+    const char* key = mfu_flist_file_get_name(list, idx) + part->prefix_len;
+
+    /* binary search for last splitter <= key, keys below the
+     * first splitter go to the first rank that has items */
+    int low  = 0;
+    int high = part->ranks - 1;
+    while (low < high) {
+        int mid = (low + high + 1) / 2;
+        if (strcmp(part->splitters[mid], key) <= 0) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    return part->owners[low];
+}
+
+mfu_flist mfu_itemmap_partition(mfu_flist ref, size_t ref_prefix_len, mfu_flist list, size_t prefix_len)
+{
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* our splitter is the first key in our portion of ref,
+     * we send an empty string and a 0 flag if we have no items */
+    const char* first = "";
+    int have = 0;
+    if (mfu_flist_size(ref) > 0) {
+        first = mfu_flist_file_get_name(ref, 0) + ref_prefix_len;
+        have  = 1;
+    }
+    int len = (int) strlen(first) + 1;
+
+    /* gather flags and lengths from all ranks */
+    int sendvals[2] = {have, len};
+    int* recvvals = (int*) MFU_MALLOC(2 * ranks * sizeof(int));
+    MPI_Allgather(sendvals, 2, MPI_INT, recvvals, 2, MPI_INT, MPI_COMM_WORLD);
+
+    int* counts = (int*) MFU_MALLOC(ranks * sizeof(int));
+    int* displs = (int*) MFU_MALLOC(ranks * sizeof(int));
+    int total = 0;
+    int i;
+    for (i = 0; i < ranks; i++) {
+        counts[i] = recvvals[2 * i + 1];
+        displs[i] = total;
+        total += counts[i];
+    }
+
+    /* gather the splitter strings */
+    char* buf = (char*) MFU_MALLOC((size_t) total);
+    MPI_Allgatherv((void*) first, len, MPI_CHAR, buf, counts, displs, MPI_CHAR, MPI_COMM_WORLD);
+
+    /* record splitters of ranks that have items, in rank order,
+     * which is also key order since ref is sorted */
+    mfu_itemmap_partition_args part;
+    part.prefix_len = prefix_len;
+    part.rank       = rank;
+    part.ranks      = 0;
+    part.owners     = (int*)   MFU_MALLOC(ranks * sizeof(int));
+    part.splitters  = (char**) MFU_MALLOC(ranks * sizeof(char*));
+    for (i = 0; i < ranks; i++) {
+        if (recvvals[2 * i]) {
+            part.owners[part.ranks]    = i;
+            part.splitters[part.ranks] = buf + displs[i];
+            part.ranks++;
+        }
+    }
+
+    mfu_flist newlist = mfu_flist_remap(list, (mfu_flist_map_fn) mfu_itemmap_partition_fn, (const void*) &part);
+
+    mfu_free(&part.splitters);
+    mfu_free(&part.owners);
+    mfu_free(&buf);
+    mfu_free(&displs);
+    mfu_free(&counts);
+    mfu_free(&recvvals);
+
+    return newlist;
+}
+
+void mfu_itemmap_delete(mfu_itemmap** pmap)
+{
+    if (pmap != NULL && *pmap != NULL) {
+        mfu_itemmap* map = *pmap;
+        mfu_free(&map->table);
+        mfu_free(&map->hashes);
+        mfu_free(&map->keys);
+        mfu_free(&map->index);
+        mfu_free(&map->states);
+        mfu_free(pmap);
+    }
+}
+
+uint64_t mfu_itemmap_size(const mfu_itemmap* map)
+{
+    return map->count;
+}
+
+size_t mfu_itemmap_memory(const mfu_itemmap* map)
+{
+    size_t bytes = sizeof(mfu_itemmap);
+    bytes += map->count * (sizeof(uint64_t) + sizeof(uint64_t));
+    if (map->table != NULL) {
+        bytes += map->buckets * sizeof(uint64_t);
+        bytes += map->count * (sizeof(uint32_t) + sizeof(const char*));
+    }
+    return bytes;
+}
+
+/* compare key to the key of a slot in a sorted map */
+static int mfu_itemmap_cmp_slot(const mfu_itemmap* map, const char* key, uint64_t slot)
+{
+    const char* name = mfu_flist_file_get_name(map->list, map->index[slot]);
+    return strcmp(key, name + map->prefix_len);
+}
+
+/* search slots of a sorted map, starting at the cursor and galloping
+ * outwards, so that lookups in increasing key order cost O(1) each */
+static int mfu_itemmap_lookup_sorted(mfu_itemmap* map, const char* key, uint64_t* slot)
+{
+    if (map->count == 0) {
+        return -1;
+    }
+
+    /* find range low < target <= high that brackets the key */
+    uint64_t pos = map->cursor;
+    int cmp = mfu_itemmap_cmp_slot(map, key, pos);
+    if (cmp == 0) {
+        *slot = pos;
+        return 0;
+    }
+
+    /* slots low and high are sentinels that may lie outside of the map */
+    int64_t low, high;
+    uint64_t step = 1;
+    if (cmp > 0) {
+        low  = (int64_t) pos;
+        high = (int64_t) map->count;
+        while (pos + step < map->count) {
+            if (mfu_itemmap_cmp_slot(map, key, pos + step) <= 0) {
+                high = (int64_t) (pos + step);
+                break;
+            }
+            low = (int64_t) (pos + step);
+            step *= 2;
+        }
+    } else {
+        low  = -1;
+        high = (int64_t) pos;
+        while (pos >= step) {
+            if (mfu_itemmap_cmp_slot(map, key, pos - step) > 0) {
+                low = (int64_t) (pos - step);
+                break;
+            }
+            high = (int64_t) (pos - step);
+            step *= 2;
+        }
+    }
+
+    /* binary search for first slot whose key is not less than key */
+    while (high - low > 1) {
+        int64_t mid = low + (high - low) / 2;
+        if (mfu_itemmap_cmp_slot(map, key, (uint64_t) mid) <= 0) {
+            high = mid;
+        } else {
+            low = mid;
+        }
+    }
+
+    /* leave cursor where the key is or would be */
+    if (high >= (int64_t) map->count) {
+        map->cursor = map->count - 1;
+        return -1;
+    }
+    map->cursor = (uint64_t) high;
+    if (mfu_itemmap_cmp_slot(map, key, (uint64_t) high) != 0) {
+        return -1;
+    }
+    *slot = (uint64_t) high;
+    return 0;
+}
+
+int mfu_itemmap_lookup(mfu_itemmap* map, const char* key, uint64_t* slot)
+{
+    if (map->table == NULL) {
+        return mfu_itemmap_lookup_sorted(map, key, slot);
+    }
+
+    uint32_t hash = mfu_hash_jenkins(key, strlen(key));
+    uint64_t bucket = mfu_itemmap_probe(map, key, hash);
+    if (map->table[bucket] == 0) {
+        return -1;
+    }
+    *slot = map->table[bucket] - 1;
+    return 0;
+}
+
+const char* mfu_itemmap_key(const mfu_itemmap* map, uint64_t slot)
+{
+    assert(slot < map->count);
+    if (map->keys == NULL) {
+        const char* name = mfu_flist_file_get_name(map->list, map->index[slot]);
+        return name + map->prefix_len;
+    }
+    return map->keys[slot];
+}
+
+uint64_t* mfu_itemmap_order(const mfu_itemmap* map)
+{
+    uint64_t* order = (uint64_t*) MFU_MALLOC(map->count * sizeof(uint64_t) + 1);
+
+    /* slots of a sorted map are already in key order */
+    uint64_t slot;
+    if (map->keys == NULL) {
+        for (slot = 0; slot < map->count; slot++) {
+            order[slot] = slot;
+        }
+        return order;
+    }
+
+    mfu_itemmap_elem* elems = (mfu_itemmap_elem*) MFU_MALLOC(map->count * sizeof(mfu_itemmap_elem) + 1);
+    for (slot = 0; slot < map->count; slot++) {
+        elems[slot].key = map->keys[slot];
+        elems[slot].idx = slot;
+    }
+    qsort(elems, (size_t) map->count, sizeof(mfu_itemmap_elem), mfu_itemmap_elem_cmp);
+
+    for (slot = 0; slot < map->count; slot++) {
+        order[slot] = elems[slot].idx;
+    }
+    mfu_free(&elems);
+
+    return order;
+}
+
+uint64_t mfu_itemmap_index(const mfu_itemmap* map, uint64_t slot)
+{
+    assert(slot < map->count);
+    return map->index[slot];
+}
+
+void mfu_itemmap_set(mfu_itemmap* map, uint64_t slot, int field, int state)
+{
+    assert(slot < map->count);
+    assert(field >= 0 && field < MFU_ITEMMAP_FIELDS);
+    assert(state >= 0 && state <= MFU_ITEMMAP_STATE_MAX);
+
+    int shift = field * 4;
+    uint64_t bits = map->states[slot];
+    bits &= ~((uint64_t)0xF << shift);
+    bits |= (uint64_t)state << shift;
+    map->states[slot] = bits;
+}
+
+int mfu_itemmap_get(const mfu_itemmap* map, uint64_t slot, int field)
+{
+    assert(slot < map->count);
+    assert(field >= 0 && field < MFU_ITEMMAP_FIELDS);
+
+    int shift = field * 4;
+    return (int)((map->states[slot] >> shift) & 0xF);
+}
@@ -0,0 +1,102 @@
+/* enable C++ codes to include this header directly */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef MFU_ITEMMAP_H
+#define MFU_ITEMMAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "mfu_flist.h"
+
+/* An item map indexes the items of a file list by their path relative
+ * to a prefix, and records a small comparison state for each of up
+ * to MFU_ITEMMAP_FIELDS fields per item.  It is what dcmp and dsync
+ * use to match source and destination items.
+ *
+ * Each item is assigned a slot.  Slots are numbered from 0 in the order
+ * items appear in the list, so iterating over slots visits items in
+ * list order.  Keys are not copied, they point into the file list, so
+ * the list must outlive the map.  States are 4-bit values packed into
+ * one 64-bit word per item, all fields start as 0.
+ *
+ * A map created with mfu_itemmap_new_sorted has no hash table.  Its
+ * slots are numbered in key order, and lookups search the sorted
+ * slots starting from where the previous lookup ended, so scanning
+ * two sorted maps side by side is a merge join that costs O(1) per
+ * item and needs no memory beyond the index and states. */
+
+/* max number of fields per item */
+#define MFU_ITEMMAP_FIELDS (16)
+
+/* max value of a state */
+#define MFU_ITEMMAP_STATE_MAX (15)
+
+typedef struct mfu_itemmap_struct {
+    mfu_flist list;        /* list the map indexes */
+    size_t prefix_len;     /* number of leading characters of names to ignore */
+    uint64_t count;        /* number of slots in use */
+    uint64_t buckets;      /* number of hash buckets, power of two, 0 if sorted */
+    uint64_t* table;       /* hash buckets, slot + 1 or 0 if empty, NULL if sorted */
+    uint32_t* hashes;      /* hash of key for each slot, NULL if sorted */
+    const char** keys;     /* key for each slot, points into file list, NULL if sorted */
+    uint64_t* index;       /* index in file list for each slot */
+    uint64_t* states;      /* packed state fields for each slot */
+    uint64_t cursor;       /* slot where last lookup ended, if sorted */
+} mfu_itemmap;
+
+/* build a map over all items in list, keyed by their name with
+ * the first prefix_len characters dropped, if two items share
+ * the same key, the later one replaces the earlier one */
+mfu_itemmap* mfu_itemmap_new(mfu_flist list, size_t prefix_len);
+
+/* build a map over all items in list like mfu_itemmap_new, but
+ * order slots by key and look keys up by searching the sorted
+ * slots instead of building a hash table, the list need not be
+ * sorted locally, though no sort is needed if it already is */
+mfu_itemmap* mfu_itemmap_new_sorted(mfu_flist list, size_t prefix_len);
+
+/* given ref, which is sorted by name across ranks (e.g., with
+ * mfu_flist_sort), return a new list with the items of list moved
+ * to the rank whose range of ref keys would contain them, so that
+ * items with matching keys in both lists end up on the same rank,
+ * keys are names with the first ref_prefix_len and prefix_len
+ * characters dropped, respectively, must be called by all ranks */
+mfu_flist mfu_itemmap_partition(mfu_flist ref, size_t ref_prefix_len, mfu_flist list, size_t prefix_len);
+
+/* free map and set pointer to NULL */
+void mfu_itemmap_delete(mfu_itemmap** map);
+
+/* return number of slots in map */
+uint64_t mfu_itemmap_size(const mfu_itemmap* map);
+
+/* return number of bytes allocated for map */
+size_t mfu_itemmap_memory(const mfu_itemmap* map);
+
+/* look up key, returns 0 and sets slot if found, -1 otherwise */
+int mfu_itemmap_lookup(mfu_itemmap* map, const char* key, uint64_t* slot);
+
+/* return key of given slot */
+const char* mfu_itemmap_key(const mfu_itemmap* map, uint64_t slot);
+
+/* return a newly allocated array of all slots ordered by key,
+ * caller must free it with mfu_free */
+uint64_t* mfu_itemmap_order(const mfu_itemmap* map);
+
+/* return index in file list of given slot */
+uint64_t mfu_itemmap_index(const mfu_itemmap* map, uint64_t slot);
+
+/* set state of field for given slot */
+void mfu_itemmap_set(mfu_itemmap* map, uint64_t slot, int field, int state);
+
+/* return state of field for given slot */
+int mfu_itemmap_get(const mfu_itemmap* map, uint64_t slot, int field);
+
+#endif /* MFU_ITEMMAP_H */
+
+/* enable C++ codes to include this header directly */
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
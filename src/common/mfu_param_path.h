@@ -95,11 +95,26 @@ void mfu_param_path_check_copy(
     int* flag_copy_into_dir         /* OUT - flag indicating whether source items should be copied into destination directory (1) or not (0) */
 );
 
+/* callback invoked on the walking process as each item is recorded,
+ * st is NULL if the walk did not stat the item, a directory is reported
+ * before any of its entries are read */
+typedef void (*mfu_walk_item_fn)(const char* path, mode_t mode, const struct stat* st, void* arg);
+
+/* callback invoked on the walking process for each directory found when
+ * walking with stat, before its entries are read, return NULL to read the
+ * directory, or return an array of count paths to walk instead of its
+ * entries, the array must remain valid until the next call */
+typedef const char** (*mfu_walk_dir_fn)(const char* path, const struct stat* st, uint64_t* count, void* arg);
+
 /* options passed to walk that effect how the walk is executed */
 typedef struct {
     int    dir_perms;          /* flag option to update dir perms during walk */
     int    remove;             /* flag option to remove files during walk */
     int    use_stat;           /* flag option on whether or not to stat files during walk */
+    mfu_walk_item_fn item_fn;  /* optional callback for each item found, NULL for none */
+    void*  item_arg;           /* argument passed through to item_fn */
+    mfu_walk_dir_fn dir_fn;    /* optional callback to skip reading directories, NULL for none */
+    void*  dir_arg;            /* argument passed through to dir_fn */
 } mfu_walk_opts_t;
 
 /* options passed to mfu_ */
@@ -110,13 +125,19 @@ typedef struct {
     char*  input_file;    /* file name of input list */
     bool   preserve;      /* whether to preserve timestamps, ownership, permissions, etc. */
     bool   synchronous;   /* whether to use O_DIRECT */
+    bool   adaptive_io;   /* whether to use O_DIRECT on aligned blocks and drop cached pages of large files */
     bool   sparse;        /* whether to create sparse files */
+    bool   preallocate;   /* whether to fallocate destination files when they are created */
     size_t chunk_size;    /* size to chunk files by */
     size_t block_size;    /* block size to read/write to file system */
     char*  block_buf1;    /* buffer to read / write data */
     char*  block_buf2;    /* another buffer to read / write data */
     int    grouplock_id;  /* Lustre grouplock ID */
     uint64_t batch_files; /* max batch size to copy files, 0 implies no limit */
+    bool   stripe_align;  /* whether to cut chunks at stripe boundaries and order copies by OST */
+    uint64_t stripe_sim_size;  /* simulated stripe size in bytes */
+    uint64_t stripe_sim_count; /* simulated number of stripes per file */
+    uint64_t stripe_sim_osts;  /* simulated number of OSTs, 0 to use real layout */
 } mfu_copy_opts_t;
 
 /* Given a source item name, determine which source path this item
@@ -0,0 +1,300 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "mfu.h"
+
+static char mpierrstr[MPI_MAX_ERROR_STRING];
+static int mpierrlen;
+
+int mfu_sidecar_open(
+    const char* name,
+    const char* desc,
+    uint64_t version,
+    int count,
+    uint64_t* header,
+    MPI_File* fh)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    /* a missing file just means nothing has been recorded yet */
+    int exists = 0;
+    if (rank == 0) {
+        exists = (access(name, F_OK) == 0);
+    }
+    MPI_Bcast(&exists, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (! exists) {
+        return 1;
+    }
+
+    int mpirc = MPI_File_open(MPI_COMM_WORLD, (char*)name, MPI_MODE_RDONLY, MPI_INFO_NULL, fh);
+    if (mpirc != MPI_SUCCESS) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to open %s `%s'", desc, name);
+        }
+        return -1;
+    }
+
+    /* rank 0 reads and broadcasts header */
+    if (rank == 0) {
+        int header_bytes = count * 8;
+        char* packed = (char*) MFU_MALLOC((size_t) header_bytes);
+        MPI_Status status;
+        mpirc = MPI_File_read_at(*fh, 0, packed, header_bytes, MPI_BYTE, &status);
+        if (mpirc != MPI_SUCCESS) {
+            MPI_Error_string(mpirc, mpierrstr, &mpierrlen);
+            MFU_ABORT(1, "Failed to read file: `%s' rc=%d %s", name, mpirc, mpierrstr);
+        }
+
+        const char* ptr = packed;
+        int i;
+        for (i = 0; i < count; i++) {
+            mfu_unpack_uint64(&ptr, &header[i]);
+        }
+        mfu_free(&packed);
+    }
+    MPI_Bcast(header, count, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+
+    if (header[0] != version) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "Unknown version %llu of %s `%s'",
+                (unsigned long long) header[0], desc, name);
+        }
+        MPI_File_close(fh);
+        return -1;
+    }
+
+    return 0;
+}
+
+uint64_t mfu_sidecar_split(uint64_t count, uint64_t* start)
+{
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    uint64_t base  = count / (uint64_t) ranks;
+    uint64_t extra = count % (uint64_t) ranks;
+    *start = (uint64_t) rank * base;
+    if ((uint64_t) rank < extra) {
+        base++;
+        *start += (uint64_t) rank;
+    } else {
+        *start += extra;
+    }
+    return base;
+}
+
+void mfu_sidecar_read(const char* name, MPI_File fh, MPI_Offset offset, void* buf, uint64_t bytes)
+{
+    /* read in pieces with the same number of collective calls on all ranks */
+    uint64_t iters = (bytes + MFU_SIDECAR_IO_BYTES - 1) / MFU_SIDECAR_IO_BYTES;
+    uint64_t all_iters;
+    MPI_Allreduce(&iters, &all_iters, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
+
+    uint64_t done = 0;
+    while (all_iters > 0) {
+        uint64_t n = bytes - done;
+        if (n > MFU_SIDECAR_IO_BYTES) {
+            n = MFU_SIDECAR_IO_BYTES;
+        }
+
+        MPI_Status status;
+        int mpirc = MPI_File_read_at_all(fh, offset, (char*)buf + done, (int) n, MPI_BYTE, &status);
+        if (mpirc != MPI_SUCCESS) {
+            MPI_Error_string(mpirc, mpierrstr, &mpierrlen);
+            MFU_ABORT(1, "Failed to read file: `%s' rc=%d %s", name, mpirc, mpierrstr);
+        }
+
+        done   += n;
+        offset += (MPI_Offset) n;
+        all_iters--;
+    }
+}
+
+char* mfu_sidecar_alltoallv(const char* sendbuf, const int* sendcounts, int* recvcounts)
+{
+    int ranks;
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    MPI_Alltoall((void*)sendcounts, 1, MPI_INT, recvcounts, 1, MPI_INT, MPI_COMM_WORLD);
+
+    int* senddisps = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* recvdisps = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+
+    int i;
+    size_t sendbytes = 0;
+    size_t recvbytes = 0;
+    for (i = 0; i < ranks; i++) {
+        senddisps[i] = (int) sendbytes;
+        recvdisps[i] = (int) recvbytes;
+        sendbytes += (size_t) sendcounts[i];
+        recvbytes += (size_t) recvcounts[i];
+    }
+
+    char* recvbuf = (char*) MFU_MALLOC(recvbytes + 1);
+    MPI_Alltoallv((void*)sendbuf, (int*)sendcounts, senddisps, MPI_BYTE,
+                  recvbuf, recvcounts, recvdisps, MPI_BYTE, MPI_COMM_WORLD);
+
+    mfu_free(&recvdisps);
+    mfu_free(&senddisps);
+
+    return recvbuf;
+}
+
+mfu_sidecar* mfu_sidecar_create(const char* name, const char* desc, int count, const uint64_t* header)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    /* write to a temporary file and rename it once complete,
+     * so that an interrupted run leaves the previous file intact */
+    size_t tmplen = strlen(name) + 5;
+    char* tmpname = (char*) MFU_MALLOC(tmplen);
+    snprintf(tmpname, tmplen, "%s.tmp", name);
+
+    MPI_File fh;
+    int amode = MPI_MODE_WRONLY | MPI_MODE_CREATE;
+    int mpirc = MPI_File_open(MPI_COMM_WORLD, tmpname, amode, MPI_INFO_NULL, &fh);
+    if (mpirc != MPI_SUCCESS) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to open %s `%s' for writing", desc, tmpname);
+        }
+        mfu_free(&tmpname);
+        return NULL;
+    }
+
+    mpirc = MPI_File_set_size(fh, 0);
+    if (mpirc != MPI_SUCCESS) {
+        MPI_Error_string(mpirc, mpierrstr, &mpierrlen);
+        MFU_ABORT(1, "Failed to truncate file: `%s' rc=%d %s", tmpname, mpirc, mpierrstr);
+    }
+
+    /* rank 0 writes the header */
+    int header_bytes = count * 8;
+    if (rank == 0) {
+        char* packed = (char*) MFU_MALLOC((size_t) header_bytes);
+        char* ptr = packed;
+        int i;
+        for (i = 0; i < count; i++) {
+            mfu_pack_uint64(&ptr, header[i]);
+        }
+
+        MPI_Status status;
+        mpirc = MPI_File_write_at(fh, 0, packed, header_bytes, MPI_BYTE, &status);
+        if (mpirc != MPI_SUCCESS) {
+            MPI_Error_string(mpirc, mpierrstr, &mpierrlen);
+            MFU_ABORT(1, "Failed to write to file: `%s' rc=%d %s", tmpname, mpirc, mpierrstr);
+        }
+        mfu_free(&packed);
+    }
+
+    mfu_sidecar* sc = (mfu_sidecar*) MFU_MALLOC(sizeof(mfu_sidecar));
+    sc->name    = MFU_STRDUP(name);
+    sc->tmpname = tmpname;
+    sc->fh      = fh;
+    sc->base    = (MPI_Offset) header_bytes;
+    sc->offset  = (MPI_Offset) header_bytes;
+    sc->buf     = NULL;
+    sc->bufsize = 0;
+    sc->used    = 0;
+    sc->iters   = 0;
+    return sc;
+}
+
+/* write the bytes in the buffer with one collective call */
+static void sidecar_flush(mfu_sidecar* sc)
+{
+    MPI_Status status;
+    int mpirc = MPI_File_write_at_all(sc->fh, sc->offset, sc->buf, (int) sc->used, MPI_BYTE, &status);
+    if (mpirc != MPI_SUCCESS) {
+        MPI_Error_string(mpirc, mpierrstr, &mpierrlen);
+        MFU_ABORT(1, "Failed to write to file: `%s' rc=%d %s", sc->tmpname, mpirc, mpierrstr);
+    }
+
+    sc->offset += (MPI_Offset) sc->used;
+    sc->used = 0;
+    sc->iters--;
+}
+
+void mfu_sidecar_start(mfu_sidecar* sc, uint64_t offset, uint64_t bytes)
+{
+    /* finish the previous section, if any */
+    while (sc->iters > 0) {
+        sidecar_flush(sc);
+    }
+    mfu_free(&sc->buf);
+
+    /* all ranks make as many collective writes as the one with
+     * the most bytes, ranks with fewer write nothing in the rest */
+    uint64_t iters = (bytes + MFU_SIDECAR_IO_BYTES - 1) / MFU_SIDECAR_IO_BYTES;
+    MPI_Allreduce(&iters, &sc->iters, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
+
+    sc->offset = sc->base + (MPI_Offset) offset;
+
+    /* no need for a full piece if we have fewer bytes */
+    sc->bufsize = MFU_SIDECAR_IO_BYTES;
+    if (bytes < (uint64_t) sc->bufsize) {
+        sc->bufsize = (size_t) bytes;
+    }
+    sc->buf = (char*) MFU_MALLOC(sc->bufsize + 1);
+}
+
+void mfu_sidecar_append(mfu_sidecar* sc, const void* data, size_t len)
+{
+    const char* ptr = (const char*) data;
+    while (len > 0) {
+        size_t n = sc->bufsize - sc->used;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(sc->buf + sc->used, ptr, n);
+        sc->used += n;
+        ptr += n;
+        len -= n;
+
+        if (sc->used == sc->bufsize) {
+            sidecar_flush(sc);
+        }
+    }
+}
+
+int mfu_sidecar_commit(mfu_sidecar** psc)
+{
+    mfu_sidecar* sc = *psc;
+
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    /* write what is left, and match the collective calls of other ranks */
+    while (sc->iters > 0) {
+        sidecar_flush(sc);
+    }
+
+    int mpirc = MPI_File_close(&sc->fh);
+    if (mpirc != MPI_SUCCESS) {
+        MPI_Error_string(mpirc, mpierrstr, &mpierrlen);
+        MFU_ABORT(1, "Failed to close file: `%s' rc=%d %s", sc->tmpname, mpirc, mpierrstr);
+    }
+
+    /* replace the previous file */
+    int rc = 0;
+    if (rank == 0) {
+        if (rename(sc->tmpname, sc->name) != 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to rename `%s' to `%s' (errno=%d %s)",
+                sc->tmpname, sc->name, errno, strerror(errno));
+            rc = -1;
+        }
+    }
+    MPI_Bcast(&rc, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    mfu_free(&sc->buf);
+    mfu_free(&sc->tmpname);
+    mfu_free(&sc->name);
+    mfu_free(psc);
+    return rc;
+}
@@ -0,0 +1,100 @@
+/* enable C++ codes to include this header directly */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef MFU_SIDECAR_H
+#define MFU_SIDECAR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "mpi.h"
+
+/* A sidecar file holds records that a tool keeps from one run to the
+ * next, like digests of file contents, next to the data they describe.
+ * It starts with a header of packed uint64 values, the first of which
+ * is the version of the format, followed by the records of each rank
+ * laid end to end.  All ranks read and write it collectively with
+ * MPI-IO, in pieces of bounded size.
+ *
+ * A new file is written under a temporary name and renamed over the
+ * previous one once complete, so an interrupted run leaves the previous
+ * file intact.  Records are usually spread over ranks by hashing their
+ * key, see mfu_sidecar_alltoallv to move them. */
+
+/* max number of bytes to read or write in one MPI-IO call */
+#define MFU_SIDECAR_IO_BYTES (64 * 1024 * 1024)
+
+/* Even though the structure is defined here, consider it to be
+ * opaque and only use functions in this file to modify it. */
+typedef struct mfu_sidecar_struct {
+    char* name;         /* name of the file to replace */
+    char* tmpname;      /* name of the file being written */
+    MPI_File fh;        /* open handle to tmpname */
+    MPI_Offset base;    /* file offset of the first byte after the header */
+    MPI_Offset offset;  /* file offset of the next write of this rank */
+    char* buf;          /* bytes waiting to be written */
+    size_t bufsize;     /* number of bytes buf can hold */
+    size_t used;        /* number of bytes in buf */
+    uint64_t iters;     /* collective writes left to make */
+} mfu_sidecar;
+
+/* open sidecar file name for reading, then read its header of count
+ * values on rank 0 and broadcast it, desc names the kind of file in
+ * messages, returns 1 if the file does not exist, 0 if it was opened
+ * with the given version, and -1 on an error, which is reported,
+ * the caller must close fh with MPI_File_close if 0 is returned,
+ * must be called by all ranks */
+int mfu_sidecar_open(
+    const char* name,
+    const char* desc,
+    uint64_t version,
+    int count,
+    uint64_t* header,
+    MPI_File* fh
+);
+
+/* split count records evenly over ranks, sets start to the index of
+ * the first record of the calling rank and returns its number of records */
+uint64_t mfu_sidecar_split(uint64_t count, uint64_t* start);
+
+/* read bytes from open file fh starting at offset into buf, in pieces
+ * of bounded size, ranks may read different amounts,
+ * must be called by all ranks */
+void mfu_sidecar_read(const char* name, MPI_File fh, MPI_Offset offset, void* buf, uint64_t bytes);
+
+/* send sendcounts[i] bytes from sendbuf to rank i, where data for
+ * each rank is stored in rank order, returns newly allocated buffer
+ * of data received, sorted by source rank, with recvcounts[i] bytes
+ * from rank i, must be called by all ranks */
+char* mfu_sidecar_alltoallv(const char* sendbuf, const int* sendcounts, int* recvcounts);
+
+/* create a temporary file to replace sidecar file name, where rank 0
+ * writes a header of count values, desc names the kind of file in
+ * messages, returns NULL if the file could not be created,
+ * must be called by all ranks */
+mfu_sidecar* mfu_sidecar_create(const char* name, const char* desc, int count, const uint64_t* header);
+
+/* set the number of bytes this rank appends, and the offset of its first
+ * record in the records that follow the header, in bytes, a file laid out
+ * in sections calls this again for each section once all ranks appended
+ * the bytes of the previous one, must be called by all ranks */
+void mfu_sidecar_start(mfu_sidecar* sc, uint64_t offset, uint64_t bytes);
+
+/* append len bytes to the records of this rank, collective writes are
+ * made as pieces fill, so all ranks must append the bytes they gave
+ * to mfu_sidecar_start before calling mfu_sidecar_commit */
+void mfu_sidecar_append(mfu_sidecar* sc, const void* data, size_t len);
+
+/* write any bytes left, close the file, and rename it over the previous
+ * one, frees sc and sets it to NULL, returns 0 on success and -1 if the
+ * rename failed, must be called by all ranks */
+int mfu_sidecar_commit(mfu_sidecar** psc);
+
+#endif /* MFU_SIDECAR_H */
+
+/* enable C++ codes to include this header directly */
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
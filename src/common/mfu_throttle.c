@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mfu.h"
+
+/* aggregate limits, 0 means unlimited */
+uint64_t mfu_throttle_bytes = 0;
+uint64_t mfu_throttle_ops   = 0;
+
+/* number of seconds between recomputing shares across processes */
+#define MFU_THROTTLE_PERIOD (1.0)
+
+/* number of seconds worth of tokens a bucket may save up,
+ * which bounds the burst after a process has been idle */
+#define MFU_THROTTLE_BURST (0.1)
+
+/* longest we sleep at a time while in debt, so that we keep
+ * making progress on outstanding reductions */
+#define MFU_THROTTLE_NAP (0.05)
+
+/* set our share of each limit given the number of active processes */
+static void mfu_throttle_set_rates(mfu_throttle* thr, uint64_t active)
+{
+    if (active == 0) {
+        active = 1;
+    }
+
+    int i;
+    for (i = 0; i < 2; i++) {
+        thr->rate[i] = thr->limit[i] / (double) active;
+    }
+}
+
+/* add tokens for the time since the last refill */
+static void mfu_throttle_refill(mfu_throttle* thr)
+{
+    double now = MPI_Wtime();
+    double secs = now - thr->time_fill;
+    thr->time_fill = now;
+
+    int i;
+    for (i = 0; i < 2; i++) {
+        if (thr->limit[i] > 0.0) {
+            double cap = thr->rate[i] * MFU_THROTTLE_BURST;
+            thr->tokens[i] += secs * thr->rate[i];
+            if (thr->tokens[i] > cap) {
+                thr->tokens[i] = cap;
+            }
+        }
+    }
+}
+
+/* return number of seconds until all buckets are out of debt */
+static double mfu_throttle_debt(const mfu_throttle* thr)
+{
+    double secs = 0.0;
+
+    int i;
+    for (i = 0; i < 2; i++) {
+        if (thr->limit[i] > 0.0 && thr->tokens[i] < 0.0) {
+            double wait = -thr->tokens[i] / thr->rate[i];
+            if (wait > secs) {
+                secs = wait;
+            }
+        }
+    }
+
+    return secs;
+}
+
+/* fallback to a NOP if non-blocking collectives aren't available */
+#if MPI_VERSION >= 3
+static void mfu_throttle_reduce(uint64_t complete, mfu_throttle* thr)
+{
+    /* contribute our complete flag and whether we were active
+     * since our last contribution */
+    thr->values[0] = complete;
+    thr->values[1] = (uint64_t) thr->active;
+    thr->active = 0;
+
+    MPI_Ireduce(thr->values, thr->global_vals, 2,
+                MPI_UINT64_T, MPI_SUM, 0, thr->comm, &(thr->reduce_req));
+}
+#endif
+
+/* make progress on the bcast/reduce that rebalances shares,
+ * rank 0 starts a new round once per period and broadcasts the
+ * number of active processes it counted in the previous round */
+static void mfu_throttle_progress(mfu_throttle* thr)
+{
+#if MPI_VERSION >= 3
+    int rank;
+    MPI_Comm_rank(thr->comm, &rank);
+
+    int bcast_done  = 0;
+    int reduce_done = 0;
+
+    if (rank == 0) {
+        if (thr->bcast_req == MPI_REQUEST_NULL && thr->reduce_req == MPI_REQUEST_NULL) {
+            /* start a new round if the period has expired */
+            double now = MPI_Wtime();
+            if (now - thr->time_last < thr->period) {
+                return;
+            }
+
+            MPI_Ibcast(thr->bcast_vals, 2, MPI_UINT64_T, 0, thr->comm, &(thr->bcast_req));
+            mfu_throttle_reduce(0, thr);
+            thr->time_last = now;
+        } else {
+            MPI_Test(&(thr->bcast_req), &bcast_done, MPI_STATUS_IGNORE);
+            MPI_Test(&(thr->reduce_req), &reduce_done, MPI_STATUS_IGNORE);
+
+            /* record the active count for the next bcast and use it ourselves,
+             * keep the old count if nobody did any work in this round */
+            if (bcast_done && reduce_done && thr->global_vals[1] > 0) {
+                thr->bcast_vals[1] = thr->global_vals[1];
+                mfu_throttle_set_rates(thr, thr->bcast_vals[1]);
+            }
+        }
+    } else {
+        MPI_Test(&(thr->reduce_req), &reduce_done, MPI_STATUS_IGNORE);
+        MPI_Test(&(thr->bcast_req), &bcast_done, MPI_STATUS_IGNORE);
+
+        /* wait for rank 0 to signal us with a bcast */
+        if (!reduce_done || !bcast_done) {
+            return;
+        }
+
+        /* pick up the active count from the last round */
+        mfu_throttle_set_rates(thr, thr->bcast_vals[1]);
+
+        /* to get here, the bcast must have completed,
+         * so call reduce to contribute our active flag */
+        mfu_throttle_reduce(0, thr);
+        thr->time_last = MPI_Wtime();
+
+        /* since we are not in complete, keep_going must be 1,
+         * so initiate new bcast for another round */
+        MPI_Ibcast(thr->bcast_vals, 2, MPI_UINT64_T, 0, thr->comm, &(thr->bcast_req));
+    }
+#endif
+}
+
+/* start a throttle */
+mfu_throttle* mfu_throttle_start(MPI_Comm comm)
+{
+    /* nothing to do if no limits are set */
+    if (mfu_throttle_bytes == 0 && mfu_throttle_ops == 0) {
+        return NULL;
+    }
+
+    mfu_throttle* thr = (mfu_throttle*) MFU_MALLOC(sizeof(mfu_throttle));
+
+    /* dup input communicator so our non-blocking collectives
+     * don't interfere with caller's MPI communication */
+    MPI_Comm_dup(comm, &thr->comm);
+
+    int rank, ranks;
+    MPI_Comm_rank(thr->comm, &rank);
+    MPI_Comm_size(thr->comm, &ranks);
+
+    thr->bcast_req  = MPI_REQUEST_NULL;
+    thr->reduce_req = MPI_REQUEST_NULL;
+
+    thr->period    = MFU_THROTTLE_PERIOD;
+    thr->time_last = MPI_Wtime();
+    thr->time_fill = thr->time_last;
+    thr->active    = 0;
+
+    /* until we hear otherwise, assume all processes are active */
+    thr->bcast_vals[0] = 1;
+    thr->bcast_vals[1] = (uint64_t) ranks;
+
+    thr->limit[0] = (double) mfu_throttle_bytes;
+    thr->limit[1] = (double) mfu_throttle_ops;
+    mfu_throttle_set_rates(thr, (uint64_t) ranks);
+
+    /* start with a full bucket */
+    int i;
+    for (i = 0; i < 2; i++) {
+        thr->tokens[i] = thr->rate[i] * MFU_THROTTLE_BURST;
+    }
+
+#if MPI_VERSION >= 3
+    /* post buffer for incoming bcast */
+    if (rank != 0) {
+        MPI_Ibcast(thr->bcast_vals, 2, MPI_UINT64_T, 0, thr->comm, &(thr->bcast_req));
+    }
+#endif
+
+    return thr;
+}
+
+/* charge work against our share and sleep while in debt */
+void mfu_throttle_update(uint64_t bytes, uint64_t ops, mfu_throttle* thr)
+{
+    /* return immediately if throttling is disabled */
+    if (thr == NULL) {
+        return;
+    }
+
+    thr->active = 1;
+
+    mfu_throttle_refill(thr);
+    thr->tokens[0] -= (double) bytes;
+    thr->tokens[1] -= (double) ops;
+
+    mfu_throttle_progress(thr);
+
+    /* pay off any debt in short naps so that shares keep being updated */
+    double secs = mfu_throttle_debt(thr);
+    while (secs > 0.0) {
+        if (secs > MFU_THROTTLE_NAP) {
+            secs = MFU_THROTTLE_NAP;
+        }
+        usleep((useconds_t) (secs * 1000000.0));
+
+        mfu_throttle_refill(thr);
+        mfu_throttle_progress(thr);
+        secs = mfu_throttle_debt(thr);
+    }
+}
+
+/* continue rounds until all processes have completed */
+void mfu_throttle_complete(mfu_throttle** pthr)
+{
+    mfu_throttle* thr = *pthr;
+
+    /* return immediately if throttling is disabled */
+    if (thr == NULL) {
+        return;
+    }
+
+#if MPI_VERSION >= 3
+    int rank, ranks;
+    MPI_Comm_rank(thr->comm, &rank);
+    MPI_Comm_size(thr->comm, &ranks);
+
+    if (rank == 0) {
+        while (1) {
+            if (thr->bcast_req == MPI_REQUEST_NULL && thr->reduce_req == MPI_REQUEST_NULL) {
+                /* initiate a new round, flagging that we are complete */
+                MPI_Ibcast(thr->bcast_vals, 2, MPI_UINT64_T, 0, thr->comm, &(thr->bcast_req));
+                mfu_throttle_reduce(1, thr);
+            } else {
+                MPI_Wait(&(thr->bcast_req), MPI_STATUS_IGNORE);
+                MPI_Wait(&(thr->reduce_req), MPI_STATUS_IGNORE);
+
+                /* once the bcast in which we cleared keep going
+                 * has finished, we can stop */
+                if (thr->bcast_vals[0] == 0) {
+                    break;
+                }
+
+                /* keep rebalancing shares for processes that are still busy */
+                if (thr->global_vals[1] > 0) {
+                    thr->bcast_vals[1] = thr->global_vals[1];
+                }
+
+                /* when all processes are complete, tell them
+                 * to stop with the next round */
+                if (thr->global_vals[0] == (uint64_t) ranks) {
+                    thr->bcast_vals[0] = 0;
+                }
+            }
+        }
+    } else {
+        while (1) {
+            /* if have an outstanding reduce, wait for that to finish */
+            MPI_Wait(&(thr->reduce_req), MPI_STATUS_IGNORE);
+
+            /* wait for bcast to finish */
+            MPI_Wait(&(thr->bcast_req), MPI_STATUS_IGNORE);
+
+            /* contribute our complete flag */
+            mfu_throttle_reduce(1, thr);
+
+            /* if keep going flag is set then wait for another bcast */
+            if (thr->bcast_vals[0]) {
+                MPI_Ibcast(thr->bcast_vals, 2, MPI_UINT64_T, 0, thr->comm, &(thr->bcast_req));
+            } else {
+                /* everyone is finished, wait on the reduce we just started */
+                MPI_Wait(&(thr->reduce_req), MPI_STATUS_IGNORE);
+                break;
+            }
+        }
+    }
+#endif
+
+    /* release communicator we dup'ed during start */
+    MPI_Comm_free(&thr->comm);
+
+    /* free our structure */
+    mfu_free(pthr);
+}
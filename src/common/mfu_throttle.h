@@ -0,0 +1,59 @@
+/* enable C++ codes to include this header directly */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef MFU_THROTTLE_H
+#define MFU_THROTTLE_H
+
+#include <stdint.h>
+#include "mpi.h"
+
+/* aggregate limits across all processes, 0 disables a limit,
+ * tools set these from command line options */
+extern uint64_t mfu_throttle_bytes; /* bytes per second */
+extern uint64_t mfu_throttle_ops;   /* metadata operations per second */
+
+/* (opaque) struct that holds state for a token bucket throttle,
+ * each process gets an equal share of the global limits among the
+ * processes that were active in the last period, shares are
+ * recomputed with a non-blocking bcast/reduce every period */
+typedef struct {
+    MPI_Comm comm;          /* dup'ed communicator to execute bcast/reduce */
+    MPI_Request bcast_req;  /* request for outstanding bcast */
+    MPI_Request reduce_req; /* request for outstanding reduce */
+    double period;          /* number of seconds between rebalancing */
+    double time_last;       /* time when last reduce was started */
+    double time_fill;       /* time when buckets were last refilled */
+    int active;             /* whether we used the throttle since the last reduce */
+    uint64_t bcast_vals[2]; /* keep going flag and number of active processes */
+    uint64_t values[2];     /* our complete flag and active flag */
+    uint64_t global_vals[2];/* sums of complete and active flags */
+    double limit[2];        /* global limits for bytes and ops */
+    double rate[2];         /* our share of the limits per second */
+    double tokens[2];       /* current level of each bucket, may go negative */
+} mfu_throttle;
+
+/* start a throttle, returns NULL if no limits are set,
+ * must be called by all processes in comm
+ *   comm - IN communicator to dup on which to execute ibcast/ireduce */
+mfu_throttle* mfu_throttle_start(MPI_Comm comm);
+
+/* charge bytes moved and metadata ops issued against our share of the
+ * limits, sleeps until our buckets are no longer in debt
+ *   bytes - IN number of bytes just read or written
+ *   ops   - IN number of metadata operations just issued
+ *   thr   - IN pointer to struct returned in start */
+void mfu_throttle_update(uint64_t bytes, uint64_t ops, mfu_throttle* thr);
+
+/* finish outstanding reductions once all processes are done,
+ * and free structure allocated in start
+ *   pthr - IN address of pointer to struct returned in start */
+void mfu_throttle_complete(mfu_throttle** pthr);
+
+#endif /* MFU_THROTTLE_H */
+
+/* enable C++ codes to include this header directly */
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
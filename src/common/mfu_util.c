@@ -801,6 +801,48 @@ void mfu_stat_set_ctimes (struct stat* sb, uint64_t secs, uint64_t nsecs)
 #endif
 }
 
+/* number of bytes memcmp checks at a time when looking for the first
+ * byte that differs, after memcmp found that two buffers differ */
+#define MFU_COMPARE_BLOCK (256)
+
+size_t mfu_compare_bytes(const void* a, const void* b, size_t n)
+{
+    /* check the whole buffer at once, memcmp uses vector
+     * instructions and most buffers we compare are equal */
+    if (memcmp(a, b, n) == 0) {
+        return n;
+    }
+
+    /* find the block holding the first difference, then the byte */
+    const unsigned char* pa = (const unsigned char*) a;
+    const unsigned char* pb = (const unsigned char*) b;
+    size_t start = 0;
+    while (n - start > MFU_COMPARE_BLOCK &&
+           memcmp(pa + start, pb + start, MFU_COMPARE_BLOCK) == 0)
+    {
+        start += MFU_COMPARE_BLOCK;
+    }
+    while (pa[start] == pb[start]) {
+        start++;
+    }
+    return start;
+}
+
+/* ask the kernel to read up to bufsize bytes of both files starting at
+ * next, without going past the end of the range of length bytes starting
+ * at offset, a length of 0 means the range runs to the end of the files */
+static void compare_prefetch(int src_fd, int dst_fd, off_t offset, off_t length, off_t next, size_t bufsize)
+{
+    off_t next_len = (off_t)bufsize;
+    if (length > 0 && offset + length - next < next_len) {
+        next_len = offset + length - next;
+    }
+    if (next_len > 0) {
+        posix_fadvise(src_fd, next, next_len, POSIX_FADV_WILLNEED);
+        posix_fadvise(dst_fd, next, next_len, POSIX_FADV_WILLNEED);
+    }
+}
+
 /* compares contents of two files and optionally overwrite dest with source,
  * returns -1 on error, 0 if equal, 1 if different */
 int mfu_compare_contents(
@@ -812,8 +854,12 @@ int mfu_compare_contents(
     int overwrite,                 /* IN  - whether to replace dest with source contents (1) or not (0) */
     uint64_t* count_bytes_read,    /* OUT - number of bytes read (src + dest) */
     uint64_t* count_bytes_written, /* OUT - number of bytes written to dest */
+    off_t* diff_offset,            /* OUT - offset of first byte that differs, -1 if none */
     mfu_progress* prg)             /* IN  - progress message structure */
 {
+    /* we have not found a difference yet */
+    *diff_offset = (off_t)-1;
+
     /* open source file */
     int src_fd = mfu_open(src_name, O_RDONLY);
     if (src_fd < 0) {
@@ -887,6 +933,10 @@ int mfu_compare_contents(
             }
         }
 
+        /* ask for the following window of both files now, so that the
+         * kernel reads them in parallel while we compare this one */
+        compare_prefetch(src_fd, dst_fd, offset, length, pos + (off_t)left_to_read, bufsize);
+
         /* read data from source file */
         ssize_t src_read = mfu_read(src_name, src_fd, (ssize_t*)src_buf, left_to_read);
         if (src_read < 0) {
@@ -917,9 +967,17 @@ int mfu_compare_contents(
          * of bytes we compare and update offset to shorter of the two values
          * numread = min(src_read, dst_read) */
 
-        /* check that we got the same number of bytes from each */
-        if (src_read != dst_read) {
-            /* one read came up shorter than the other */
+        /* compare the bytes we got from both files, a shorter read
+         * differs from the other at the first byte it lacks */
+        size_t common = (size_t)(src_read < dst_read ? src_read : dst_read);
+        size_t same = mfu_compare_bytes(src_buf, dest_buf, common);
+        if (same < common || src_read != dst_read) {
+            /* remember where the first difference is */
+            if (*diff_offset == (off_t)-1) {
+                *diff_offset = pos + (off_t)same;
+            }
+
+            /* contents are different */
             rc = 1;
             if (! overwrite) {
                 break;
@@ -933,18 +991,6 @@ int mfu_compare_contents(
             break;
         }
 
-        /* if have same size buffers, and read some data, let's check the contents */
-        if (src_read == dst_read) {
-            if (memcmp((ssize_t*)src_buf, (ssize_t*)dest_buf, (size_t)src_read) != 0) {
-                /* memory contents are different */
-                rc = 1;
-                if (! overwrite) {
-                    break;
-                }
-                need_copy = 1;
-            }
-        }
-
         /* if the bytes are different,
          * then copy the bytes from the source into the destination */
         if (overwrite && need_copy == 1) {
@@ -993,6 +1039,246 @@ int mfu_compare_contents(
     return rc;
 }
 
+/* write len bytes of buf to dst at pos, used to flush coalesced writes */
+static int compare_write(
+    const char* dst_name,
+    int dst_fd,
+    off_t pos,
+    const void* buf,
+    size_t len,
+    off_t* dst_pos,
+    uint64_t* count_bytes_written,
+    uint64_t* count_writes)
+{
+    /* seek to position to write to in destination file */
+    if (mfu_lseek(dst_name, dst_fd, pos, SEEK_SET) == (off_t)-1) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to lseek `%s', offset: %llx (errno=%d %s)",
+          dst_name, (unsigned long long)pos, errno, strerror(errno));
+        return -1;
+    }
+
+    /* write data to destination file */
+    ssize_t bytes_written = mfu_write(dst_name, dst_fd, buf, len);
+    if (bytes_written < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to write `%s' at offset %llx (errno=%d %s)",
+          dst_name, (unsigned long long)pos, errno, strerror(errno));
+        return -1;
+    }
+
+    /* file pointer is now at end of what we wrote */
+    *dst_pos = pos + (off_t)bytes_written;
+
+    /* tally up number of bytes and writes */
+    *count_bytes_written += (uint64_t) bytes_written;
+    *count_writes += 1;
+
+    return 0;
+}
+
+int mfu_compare_contents_delta(
+    const char* src_name,          /* IN  - path name to souce file */
+    const char* dst_name,          /* IN  - path name to destination file */
+    off_t offset,                  /* IN  - offset with file to start comparison */
+    off_t length,                  /* IN  - number of bytes to be compared */
+    size_t bufsize,                /* IN  - size of I/O buffer, largest write issued */
+    size_t blocksize,              /* IN  - size of blocks compared and rewritten */
+    uint64_t* count_bytes_read,    /* OUT - number of bytes read (src + dest) */
+    uint64_t* count_bytes_written, /* OUT - number of bytes written to dest */
+    uint64_t* count_blocks,        /* OUT - number of blocks rewritten in dest */
+    uint64_t* count_writes,        /* OUT - number of writes issued to dest */
+    off_t* diff_offset,            /* OUT - offset of first byte that differs, -1 if none */
+    mfu_progress* prg)             /* IN  - progress message structure */
+{
+    /* we have not found a difference yet */
+    *diff_offset = (off_t)-1;
+
+    /* open source file */
+    int src_fd = mfu_open(src_name, O_RDONLY);
+    if (src_fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open `%s' (errno=%d %s)",
+          src_name, errno, strerror(errno));
+        return -1;
+    }
+
+    /* open destination file */
+    int dst_fd = mfu_open(dst_name, O_RDWR);
+    if (dst_fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open `%s' (errno=%d %s)",
+          dst_name, errno, strerror(errno));
+        mfu_close(src_name, src_fd);
+        return -1;
+    }
+
+    /* hint that we'll read from file sequentially */
+    posix_fadvise(src_fd, offset, length, POSIX_FADV_SEQUENTIAL);
+    posix_fadvise(dst_fd, offset, length, POSIX_FADV_SEQUENTIAL);
+
+    /* seek to offset in source file, we read it sequentially from here,
+     * the destination is repositioned whenever a write moved its pointer */
+    if (mfu_lseek(src_name, src_fd, offset, SEEK_SET) == (off_t)-1) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to lseek `%s', offset: %lx (errno=%d %s)",
+          src_name, (unsigned long)offset, errno, strerror(errno));
+        mfu_close(dst_name, dst_fd);
+        mfu_close(src_name, src_fd);
+        return -1;
+    }
+    off_t dst_pos = (off_t)-1;
+
+    /* assume we'll find that file contents are the same */
+    int rc = 0;
+
+    /* allocate buffers to read file data, and one to gather
+     * adjacent differing blocks into a single write */
+    void* src_buf   = MFU_MALLOC(bufsize);
+    void* dest_buf  = MFU_MALLOC(bufsize);
+    void* write_buf = MFU_MALLOC(bufsize);
+    off_t write_pos  = 0;
+    size_t write_len = 0;
+
+    /* read and compare data from files */
+    off_t total_bytes = 0;
+    while (length == 0 || total_bytes < length) {
+        /* track current position in file for error reporting and seeking */
+        off_t pos = offset + total_bytes;
+
+        /* determine number of bytes to read in this iteration */
+        size_t left_to_read = bufsize;
+        if (length > 0) {
+            if (length - total_bytes < (off_t)bufsize) {
+                left_to_read = (size_t)(length - total_bytes);
+            }
+        }
+
+        /* ask for the following window of both files now, so that the
+         * kernel reads them in parallel while we compare this one */
+        compare_prefetch(src_fd, dst_fd, offset, length, pos + (off_t)left_to_read, bufsize);
+
+        /* read data from source file */
+        ssize_t src_read = mfu_read(src_name, src_fd, src_buf, left_to_read);
+        if (src_read < 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to read `%s' at offset %llx (errno=%d %s)",
+              src_name, (unsigned long long)pos, errno, strerror(errno));
+            rc = -1;
+            break;
+        }
+        *count_bytes_read += (uint64_t) src_read;
+
+        /* read data from destination file */
+        if (dst_pos != pos) {
+            if (mfu_lseek(dst_name, dst_fd, pos, SEEK_SET) == (off_t)-1) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to lseek `%s', offset: %llx (errno=%d %s)",
+                  dst_name, (unsigned long long)pos, errno, strerror(errno));
+                rc = -1;
+                break;
+            }
+        }
+        ssize_t dst_read = mfu_read(dst_name, dst_fd, dest_buf, left_to_read);
+        if (dst_read < 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to read `%s' at offset %llx (errno=%d %s)",
+              dst_name, (unsigned long long)pos, errno, strerror(errno));
+            rc = -1;
+            break;
+        }
+        dst_pos = pos + (off_t)dst_read;
+        *count_bytes_read += (uint64_t) dst_read;
+
+        /* one read came up shorter than the other */
+        if (src_read != dst_read) {
+            rc = 1;
+            if (*diff_offset == (off_t)-1 && src_read > dst_read) {
+                *diff_offset = pos + (off_t)dst_read;
+            }
+        }
+
+        /* check for EOF */
+        if (src_read == 0) {
+            break;
+        }
+
+        /* compare block by block, bytes past the end of the
+         * destination data count as different */
+        size_t start;
+        for (start = 0; start < (size_t)src_read; start += blocksize) {
+            size_t n = blocksize;
+            if ((size_t)src_read - start < n) {
+                n = (size_t)src_read - start;
+            }
+            const char* src_block = (const char*)src_buf + start;
+            const char* dst_block = (const char*)dest_buf + start;
+            if (start + n <= (size_t)dst_read && memcmp(src_block, dst_block, n) == 0) {
+                continue;
+            }
+            rc = 1;
+
+            /* remember where the first difference is */
+            if (*diff_offset == (off_t)-1 || *diff_offset > pos + (off_t)start) {
+                size_t common = n;
+                if ((size_t)dst_read <= start) {
+                    common = 0;
+                } else if ((size_t)dst_read < start + n) {
+                    common = (size_t)dst_read - start;
+                }
+                *diff_offset = pos + (off_t)(start + mfu_compare_bytes(src_block, dst_block, common));
+            }
+
+            /* write out what we have gathered so far if this block
+             * does not extend it or would overflow the buffer */
+            off_t block_pos = pos + (off_t)start;
+            if (write_len > 0 &&
+                (write_pos + (off_t)write_len != block_pos || write_len + n > bufsize))
+            {
+                if (compare_write(dst_name, dst_fd, write_pos, write_buf, write_len,
+                    &dst_pos, count_bytes_written, count_writes) != 0)
+                {
+                    rc = -1;
+                    break;
+                }
+                write_len = 0;
+            }
+
+            /* add source bytes of this block to the pending write */
+            if (write_len == 0) {
+                write_pos = block_pos;
+            }
+            memcpy((char*)write_buf + write_len, src_block, n);
+            write_len += n;
+            *count_blocks += 1;
+        }
+        if (rc < 0) {
+            break;
+        }
+
+        /* add bytes to our total */
+        total_bytes += (off_t)src_read;
+
+        /* update number of bytes read and written for progress messages */
+        uint64_t count_bytes[2];
+        count_bytes[0] = *count_bytes_read;
+        count_bytes[1] = *count_bytes_written;
+        mfu_progress_update(count_bytes, prg);
+    }
+
+    /* write any blocks still pending */
+    if (rc >= 0 && write_len > 0) {
+        if (compare_write(dst_name, dst_fd, write_pos, write_buf, write_len,
+            &dst_pos, count_bytes_written, count_writes) != 0)
+        {
+            rc = -1;
+        }
+    }
+
+    /* free buffers */
+    mfu_free(&write_buf);
+    mfu_free(&dest_buf);
+    mfu_free(&src_buf);
+
+    /* close files */
+    mfu_close(dst_name, dst_fd);
+    mfu_close(src_name, src_fd);
+
+    return rc;
+}
+
 /* uses the lustre api to obtain stripe count and stripe size of a file */
 int mfu_stripe_get(const char *path, uint64_t *stripe_size, uint64_t *stripe_count)
 {
@@ -1042,6 +1328,69 @@ int mfu_stripe_get(const char *path, uint64_t *stripe_size, uint64_t *stripe_cou
     return 0;
 }
 
+/* uses the lustre api to obtain the OST index holding each of the first
+ * count stripes of a file, osts must have space for count entries */
+int mfu_stripe_get_osts(const char *path, uint64_t count, uint64_t *osts)
+{
+    /* without layout information, assume stripes are laid out
+     * on consecutive OSTs starting from index 0 */
+    uint64_t i;
+    for (i = 0; i < count; i++) {
+        osts[i] = i;
+    }
+
+#ifdef LUSTRE_SUPPORT
+#if defined(HAVE_LLAPI_LAYOUT)
+    /* obtain the llapi_layout for a file by path */
+    struct llapi_layout *layout = llapi_layout_get_by_path(path, 0);
+
+    /* if no llapi_layout is returned, then some problem occured */
+    if (layout == NULL) {
+        return ENOENT;
+    }
+
+    /* look up OST index of each stripe */
+    int rc = 0;
+    for (i = 0; i < count; i++) {
+        if (llapi_layout_ost_index_get(layout, (int) i, &osts[i]) != 0) {
+            rc = errno;
+            break;
+        }
+    }
+
+    /* free the alloced llapi_layout */
+    llapi_layout_free(layout);
+
+    return rc;
+#elif defined(HAVE_LLAPI_FILE_GET_STRIPE)
+    int rc;
+    int lumsz = lov_user_md_size(LOV_MAX_STRIPE_COUNT, LOV_USER_MAGIC_V3);
+    struct lov_user_md *lum = malloc(lumsz);
+    if (lum == NULL)
+        return ENOMEM;
+
+    rc = llapi_file_get_stripe(path, lum);
+    if (rc) {
+        free(lum);
+        return rc;
+    }
+
+    for (i = 0; i < count && i < lum->lmm_stripe_count; i++) {
+        osts[i] = lum->lmm_objects[i].l_ost_idx;
+    }
+    free(lum);
+
+    return 0;
+#else
+    fprintf(stderr, "Unexpected Lustre version.\n");
+    fflush(stderr);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+#endif
+#endif
+
+    return 0;
+}
+
 /* create a striped lustre file at the path provided with the specified stripe size and count */
 void mfu_stripe_set(const char *path, uint64_t stripe_size, int stripe_count)
 {
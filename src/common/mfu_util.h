@@ -264,7 +264,14 @@ void mfu_stat_set_atimes(struct stat* sb, uint64_t secs, uint64_t nsecs);
 void mfu_stat_set_mtimes(struct stat* sb, uint64_t secs, uint64_t nsecs);
 void mfu_stat_set_ctimes(struct stat* sb, uint64_t secs, uint64_t nsecs);
 
+/* compare n bytes of a and b, returns offset of the first byte
+ * that differs, or n if they are the same */
+size_t mfu_compare_bytes(const void* a, const void* b, size_t n);
+
 /* compares contents of two files and optionally overwrite dest with source,
+ * the next buffer of both files is read ahead while the current one is
+ * compared, diff_offset is set to the offset of the first byte found to
+ * differ, or -1 if none,
  * returns -1 on error, 0 if equal, 1 if different */
 int mfu_compare_contents(
     const char* src,          /* IN  - path name to souce file */
@@ -275,12 +282,38 @@ int mfu_compare_contents(
     int overwrite,            /* IN  - whether to replace dest with source contents (1) or not (0) */
     uint64_t* bytes_read,     /* OUT - number of bytes read (src + dest) */
     uint64_t* bytes_written,  /* OUT - number of bytes written to dest */
+    off_t* diff_offset,       /* OUT - offset of first byte that differs, -1 if none */
+    mfu_progress* prg         /* IN  - progress message structure */
+);
+
+/* compares contents of two files and overwrites dest with source like
+ * mfu_compare_contents, but compares blocksize bytes at a time and only
+ * rewrites the blocks that differ, adjacent differing blocks are gathered
+ * into writes of up to bufsize bytes, and the next buffer of both files
+ * is read ahead while the current one is compared,
+ * returns -1 on error, 0 if equal, 1 if different */
+int mfu_compare_contents_delta(
+    const char* src,          /* IN  - path name to souce file */
+    const char* dst,          /* IN  - path name to destination file */
+    off_t offset,             /* IN  - offset with file to start comparison */
+    off_t length,             /* IN  - number of bytes to be compared */
+    size_t bufsize,           /* IN  - size of I/O buffer, largest write issued */
+    size_t blocksize,         /* IN  - size of blocks compared and rewritten */
+    uint64_t* bytes_read,     /* OUT - number of bytes read (src + dest) */
+    uint64_t* bytes_written,  /* OUT - number of bytes written to dest */
+    uint64_t* blocks,         /* OUT - number of blocks rewritten in dest */
+    uint64_t* writes,         /* OUT - number of writes issued to dest */
+    off_t* diff_offset,       /* OUT - offset of first byte that differs, -1 if none */
     mfu_progress* prg         /* IN  - progress message structure */
 );
 
 /* uses the lustre api to obtain stripe count and stripe size of a file */
 int mfu_stripe_get(const char *path, uint64_t *stripe_size, uint64_t *stripe_count);
 
+/* uses the lustre api to obtain the OST index holding each of the first
+ * count stripes of a file, osts must have space for count entries */
+int mfu_stripe_get_osts(const char *path, uint64_t count, uint64_t *osts);
+
 /* create a striped lustre file at the path provided with the specified stripe size and count */
 void mfu_stripe_set(const char *path, uint64_t stripe_size, int stripe_count);
 
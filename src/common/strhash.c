@@ -0,0 +1,438 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "strhash.h"
+#include "mfu.h"
+
+#define STRHASH_FAILURE (1)
+
+/* number of entries in a newly allocated table */
+#define STRHASH_MIN_CAPACITY (16)
+
+/* minimum number of bytes in an arena block */
+#define STRHASH_BLOCK_SIZE (64 * 1024)
+
+/*
+=========================================
+Arena memory for key and value strings
+=========================================
+*/
+
+/* return space for len bytes from the arena, allocating a new block if needed */
+static char* strhash_arena_alloc(strhash* map, size_t len)
+{
+    strhash_block* block = map->arena;
+    if (block == NULL || block->size - block->used < len) {
+        /* allocate a new block large enough for this string */
+        size_t size = STRHASH_BLOCK_SIZE;
+        if (len > size) {
+            size = len;
+        }
+        block = (strhash_block*) MFU_MALLOC(sizeof(strhash_block) + size);
+        block->next = map->arena;
+        block->size = size;
+        block->used = 0;
+        map->arena  = block;
+    }
+
+    char* ptr = block->data + block->used;
+    block->used += len;
+    return ptr;
+}
+
+/* copy string into the arena and return pointer to the copy */
+static char* strhash_arena_strdup(strhash* map, const char* str, size_t len)
+{
+    char* copy = strhash_arena_alloc(map, len);
+    memcpy(copy, str, len);
+    return copy;
+}
+
+/*
+=========================================
+Hash table internals
+=========================================
+*/
+
+/* find entry holding key, or the empty entry where it belongs */
+static strhash_entry* strhash_probe(const strhash* map, const char* key, uint32_t hash)
+{
+    /* linear probing, table is never more than 3/4 full */
+    uint64_t mask = map->capacity - 1;
+    uint64_t idx = (uint64_t)hash & mask;
+    while (1) {
+        strhash_entry* entry = &map->table[idx];
+        if (entry->key == NULL) {
+            return entry;
+        }
+        if (entry->hash == hash && strcmp(entry->key, key) == 0) {
+            return entry;
+        }
+        idx = (idx + 1) & mask;
+    }
+}
+
+/* allocate a table with the given number of entries and move existing entries into it */
+static void strhash_resize(strhash* map, uint64_t capacity)
+{
+    strhash_entry* old_table = map->table;
+    uint64_t old_capacity    = map->capacity;
+
+    map->table    = (strhash_entry*) MFU_MALLOC(capacity * sizeof(strhash_entry));
+    map->capacity = capacity;
+    memset(map->table, 0, capacity * sizeof(strhash_entry));
+
+    /* strings stay where they are in the arena, only entries move */
+    uint64_t i;
+    for (i = 0; i < old_capacity; i++) {
+        strhash_entry* entry = &old_table[i];
+        if (entry->key != NULL) {
+            strhash_entry* slot = strhash_probe(map, entry->key, entry->hash);
+            *slot = *entry;
+        }
+    }
+
+    mfu_free(&old_table);
+}
+
+/*
+=========================================
+Allocate and delete map objects
+=========================================
+*/
+
+/* allocates a new, empty map */
+strhash* strhash_new()
+{
+    strhash* map = (strhash*) MFU_MALLOC(sizeof(strhash));
+    map->table    = NULL;
+    map->capacity = 0;
+    map->size     = 0;
+    map->arena    = NULL;
+    strhash_resize(map, STRHASH_MIN_CAPACITY);
+    return map;
+}
+
+/* copies entries from src into dst */
+void strhash_merge(strhash* dst, const strhash* src)
+{
+    const strhash_entry* entry;
+    strhash_foreach(src, entry) {
+        const char* key = strhash_entry_key(entry);
+        const char* val = strhash_entry_value(entry);
+        strhash_set(dst, key, val);
+    }
+    return;
+}
+
+/* frees a map */
+void strhash_delete(strhash** pmap)
+{
+    if (pmap != NULL) {
+        strhash* map = *pmap;
+        if (map != NULL) {
+            /* free arena blocks */
+            strhash_block* block = map->arena;
+            while (block != NULL) {
+                strhash_block* next = block->next;
+                mfu_free(&block);
+                block = next;
+            }
+            map->arena = NULL;
+
+            mfu_free(&map->table);
+        }
+        mfu_free(&map);
+        *pmap = NULL;
+    }
+    return;
+}
+
+/*
+=========================================
+iterate over key/value pairs
+=========================================
+*/
+
+/* return first used entry at or after idx, NULL if none */
+static const strhash_entry* strhash_entry_scan(const strhash* map, uint64_t idx)
+{
+    for (; idx < map->capacity; idx++) {
+        const strhash_entry* entry = &map->table[idx];
+        if (entry->key != NULL) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/* return first entry in map */
+const strhash_entry* strhash_entry_first(const strhash* map)
+{
+    if (map == NULL) {
+        return NULL;
+    }
+    return strhash_entry_scan(map, 0);
+}
+
+/* return entry following given entry */
+const strhash_entry* strhash_entry_next(const strhash* map, const strhash_entry* entry)
+{
+    if (map == NULL || entry == NULL) {
+        return NULL;
+    }
+    uint64_t idx = (uint64_t)(entry - map->table);
+    return strhash_entry_scan(map, idx + 1);
+}
+
+/* returns pointer to key string */
+const char* strhash_entry_key(const strhash_entry* entry)
+{
+    if (entry != NULL) {
+        return entry->key;
+    }
+    return NULL;
+}
+
+/* returns pointer to value string */
+const char* strhash_entry_value(const strhash_entry* entry)
+{
+    if (entry != NULL) {
+        return entry->value;
+    }
+    return NULL;
+}
+
+/*
+=========================================
+set, get, unset functions
+=========================================
+*/
+
+/* return number of key/value pairs in map */
+uint64_t strhash_size(const strhash* map)
+{
+    if (map != NULL) {
+        return map->size;
+    }
+    return 0;
+}
+
+/* insert the specified key and value into the map */
+int strhash_set(strhash* map, const char* key, const char* value)
+{
+    if (map == NULL || key == NULL) {
+        return STRHASH_FAILURE;
+    }
+
+    /* grow table before it gets more than 3/4 full */
+    if ((map->size + 1) * 4 > map->capacity * 3) {
+        strhash_resize(map, map->capacity * 2);
+    }
+
+    size_t key_len = strlen(key) + 1;
+    uint32_t hash = mfu_hash_jenkins(key, key_len - 1);
+    strhash_entry* entry = strhash_probe(map, key, hash);
+
+    size_t value_len = 0;
+    if (value != NULL) {
+        value_len = strlen(value) + 1;
+    }
+
+    if (entry->key == NULL) {
+        /* key does not exist, copy key and value into arena */
+        entry->key  = strhash_arena_strdup(map, key, key_len);
+        entry->hash = hash;
+        entry->value     = NULL;
+        entry->value_cap = 0;
+        map->size++;
+    }
+
+    if (value == NULL) {
+        /* previous value space is abandoned, so it can not be reused */
+        entry->value     = NULL;
+        entry->value_cap = 0;
+    } else if (value_len <= entry->value_cap) {
+        /* reuse space of previous value */
+        memcpy((char*)entry->value, value, value_len);
+    } else {
+        /* previous value space is abandoned until map is deleted */
+        entry->value     = strhash_arena_strdup(map, value, value_len);
+        entry->value_cap = value_len;
+    }
+
+    return STRHASH_SUCCESS;
+}
+
+/* insert key/value into map as "key=value" with printf formatting */
+int strhash_setf(strhash* map, const char* format, ...)
+{
+    va_list args;
+    char* str = NULL;
+
+    /* check that we have a format string */
+    if (format == NULL) {
+        return STRHASH_FAILURE;
+    }
+
+    /* compute the size of the string we need to allocate */
+    va_start(args, format);
+    int size = vsnprintf(NULL, 0, format, args) + 1;
+    va_end(args);
+
+    /* allocate and print the string */
+    if (size > 0) {
+        str = (char*) MFU_MALLOC((size_t)size);
+
+        va_start(args, format);
+        vsnprintf(str, (size_t)size, format, args);
+        va_end(args);
+
+        /* break into key/value strings at '=' sign */
+        char* key = str;
+        char* val = str;
+        char delim[] = "=";
+        strsep(&val, delim);
+
+        /* if we have a key and value, insert into map */
+        int rc = STRHASH_FAILURE;
+        if (val != NULL) {
+            rc = strhash_set(map, key, val);
+        }
+
+        mfu_free(&str);
+        return rc;
+    }
+
+    return STRHASH_FAILURE;
+}
+
+/* return value associated with key, NULL if not found */
+const char* strhash_get(const strhash* map, const char* key)
+{
+    if (map != NULL && key != NULL) {
+        uint32_t hash = mfu_hash_jenkins(key, strlen(key));
+        const strhash_entry* entry = strhash_probe(map, key, hash);
+        if (entry->key != NULL) {
+            return entry->value;
+        }
+    }
+    return NULL;
+}
+
+/* returns pointer to value string if found, NULL otherwise,
+ * key can use printf formatting */
+const char* strhash_getf(strhash* map, const char* format, ...)
+{
+    va_list args;
+    char* str = NULL;
+
+    /* check that we have a format string */
+    if (format == NULL) {
+        return strhash_get(map, NULL);
+    }
+
+    /* compute the size of the string we need to allocate */
+    va_start(args, format);
+    int size = vsnprintf(NULL, 0, format, args) + 1;
+    va_end(args);
+
+    /* allocate and print the string */
+    if (size > 0) {
+        str = (char*) MFU_MALLOC((size_t)size);
+
+        va_start(args, format);
+        vsnprintf(str, (size_t)size, format, args);
+        va_end(args);
+
+        const char* val = strhash_get(map, str);
+
+        mfu_free(&str);
+        return val;
+    }
+
+    return strhash_get(map, NULL);
+}
+
+/* remove the entry corresponding to the specified key */
+int strhash_unset(strhash* map, const char* key)
+{
+    if (map == NULL || key == NULL) {
+        return STRHASH_SUCCESS;
+    }
+
+    uint32_t hash = mfu_hash_jenkins(key, strlen(key));
+    strhash_entry* entry = strhash_probe(map, key, hash);
+    if (entry->key == NULL) {
+        /* key is not in map, nothing to do */
+        return STRHASH_SUCCESS;
+    }
+
+    /* shift later entries of the same probe run back into the hole,
+     * so that lookups never need tombstones */
+    uint64_t mask = map->capacity - 1;
+    uint64_t hole = (uint64_t)(entry - map->table);
+    uint64_t idx  = hole;
+    while (1) {
+        idx = (idx + 1) & mask;
+        strhash_entry* next = &map->table[idx];
+        if (next->key == NULL) {
+            break;
+        }
+
+        /* an entry may fill the hole only if its home bucket
+         * does not lie cyclically within (hole, idx] */
+        uint64_t home = (uint64_t)next->hash & mask;
+        int stays;
+        if (hole <= idx) {
+            stays = (hole < home && home <= idx);
+        } else {
+            stays = (hole < home || home <= idx);
+        }
+        if (! stays) {
+            map->table[hole] = *next;
+            hole = idx;
+        }
+    }
+
+    /* key and value strings are abandoned until map is deleted */
+    memset(&map->table[hole], 0, sizeof(strhash_entry));
+    map->size--;
+
+    return STRHASH_SUCCESS;
+}
+
+/* deletes specified key using printf formatting */
+int strhash_unsetf(strhash* map, const char* format, ...)
+{
+    va_list args;
+    char* str = NULL;
+
+    /* check that we have a format string */
+    if (format == NULL) {
+        return strhash_unset(map, NULL);
+    }
+
+    /* compute the size of the string we need to allocate */
+    va_start(args, format);
+    int size = vsnprintf(NULL, 0, format, args) + 1;
+    va_end(args);
+
+    /* allocate and print the string */
+    if (size > 0) {
+        str = (char*) MFU_MALLOC((size_t)size);
+
+        va_start(args, format);
+        vsnprintf(str, (size_t)size, format, args);
+        va_end(args);
+
+        int rc = strhash_unset(map, str);
+
+        mfu_free(&str);
+        return rc;
+    }
+
+    return strhash_unset(map, NULL);
+}
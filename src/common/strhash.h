@@ -0,0 +1,130 @@
+#ifndef STRHASH_H
+#define STRHASH_H
+
+/* Stores a set of key/value pairs, where key and value are both
+ * stored as strings.  Provides the same interface as strmap, but
+ * entries are kept in an open-addressing hash table rather than in
+ * a balanced tree, so iteration visits entries in no particular order.
+ * Use strmap when ordered iteration is required.
+ *
+ * Key and value strings are copied into large arena blocks that are
+ * only released when the map is deleted.  Pointers returned by get
+ * remain valid until the key is unset or its value is overwritten. */
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STRHASH_SUCCESS (0)
+
+/*
+=========================================
+Define hash table data structures
+=========================================
+*/
+
+/* Even though the structure is defined here,
+ * consider these types to be opaque and only
+ * use functions in this file to modify them. */
+
+/* define the structure for an entry in the table */
+typedef struct strhash_entry_struct {
+  const char* key;   /* pointer to key string in arena, NULL if entry is empty */
+  const char* value; /* pointer to value string in arena */
+  size_t value_cap;  /* number of bytes reserved for value (including terminating NUL) */
+  uint32_t hash;     /* hash of key string */
+} strhash_entry;
+
+/* define the structure for a block of arena memory */
+typedef struct strhash_block_struct {
+  struct strhash_block_struct* next; /* pointer to previously allocated block */
+  size_t size;                       /* number of bytes in data */
+  size_t used;                       /* number of bytes handed out from data */
+  char data[];                       /* storage for key and value strings */
+} strhash_block;
+
+/* structure to track table and arena */
+typedef struct strhash_struct {
+  strhash_entry* table;  /* array of entries, length is a power of two */
+  uint64_t capacity;     /* number of entries in table */
+  uint64_t size;         /* number of entries in use */
+  strhash_block* arena;  /* most recently allocated arena block */
+} strhash;
+
+/*
+=========================================
+Allocate and delete map objects
+=========================================
+*/
+
+/* allocates a new map */
+strhash* strhash_new(void);
+
+/* copies entries from src into dst */
+void strhash_merge(strhash* dst, const strhash* src);
+
+/* frees a map */
+void strhash_delete(strhash** map);
+
+/*
+=========================================
+iterate over key/value pairs
+=========================================
+*/
+
+/* return first entry in map, NULL if map is empty */
+const strhash_entry* strhash_entry_first(const strhash* map);
+
+/* return entry following given entry, NULL if there are no more */
+const strhash_entry* strhash_entry_next(const strhash* map, const strhash_entry* entry);
+
+/* returns pointer to key string */
+const char* strhash_entry_key(const strhash_entry* entry);
+
+/* returns pointer to value string */
+const char* strhash_entry_value(const strhash_entry* entry);
+
+/*
+=========================================
+set, get, and unset key/value pairs
+=========================================
+*/
+
+/* return number of key/value pairs in map */
+uint64_t strhash_size(const strhash* map);
+
+/* insert key/value into map, overwrites existing key */
+int strhash_set(strhash* map, const char* key, const char* value);
+
+/* insert key/value into map as "key=value" with printf formatting,
+ * overwrites existing key */
+int strhash_setf(strhash* map, const char* format, ...);
+
+/* returns pointer to value string if found, NULL otherwise */
+const char* strhash_get(const strhash* map, const char* key);
+
+/* returns pointer to value string if found, NULL otherwise,
+ * key can use printf formatting */
+const char* strhash_getf(strhash* map, const char* format, ...);
+
+/* deletes specified key */
+int strhash_unset(strhash* map, const char* key);
+
+/* deletes specified key using printf formatting */
+int strhash_unsetf(strhash* map, const char* format, ...);
+
+/* entries must not be set or unset while iterating */
+#define strhash_foreach(strhash, entry)         \
+  for ((entry) = strhash_entry_first(strhash); \
+    (entry) != NULL;                           \
+    (entry) = strhash_entry_next(strhash, entry))
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* STRHASH_H */
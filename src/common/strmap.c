@@ -773,9 +773,11 @@ int strmap_unset(strmap* tree, const char* key)
                 /* update the left child of this node to point to our left child,
                  * (note that this works correctly even if the replacement is our
                  * original left child, because the extract call would update our
-                 * left child to be our left grandchild) */
+                 * left child to be our left grandchild, which may be NULL) */
                 replacement->left = node->left;
-                node->left->parent = replacement;
+                if (node->left != NULL) {
+                    node->left->parent = replacement;
+                }
 
                 /* update the right child of this node to point to our right child,
                  * (we're guaranteed that the rightmost node from our left subtree
@@ -21,9 +21,12 @@
 // mmap and friends for shared memory
 #include <sys/mman.h>
 
+// SHA256 to compare blocks with existing copies
+#include <openssl/sha.h>
+
 //#include "gcs.h"
 #include "mfu.h"
-#include "strmap.h"
+#include "strhash.h"
 #include "dtcmp.h"
 
 /* Run with two or more procs per node.  The task of one proc on each
@@ -36,7 +39,7 @@
 
 static int gcs_shm_file_key = MPI_KEYVAL_INVALID;
 
-static strmap* gcs_shm_ptr_tree = NULL;
+static strhash* gcs_shm_ptr_tree = NULL;
 
 /* split input communicator into subcommunicators using string as a color,
  * str cannot be NULL */
@@ -264,7 +267,7 @@ static void* GCS_Shmem_alloc(size_t size, MPI_Comm comm)
 
   /* allocate a tree to associate sizes with pointer values (if we don't have one already) */
   if (gcs_shm_ptr_tree == NULL) {
-    gcs_shm_ptr_tree = strmap_new();
+    gcs_shm_ptr_tree = strhash_new();
   }
 
   /* ensure that all the processes in comm make it this far before we create the file */
@@ -332,7 +335,7 @@ static void* GCS_Shmem_alloc(size_t size, MPI_Comm comm)
 
   /* record the size of the segment that is associated with this address
    * so that we can call munmap later in GCS_Shmem_free() */
-  strmap_setf(gcs_shm_ptr_tree, "%x=%llu", ptr, (unsigned long long) size);
+  strhash_setf(gcs_shm_ptr_tree, "%x=%llu", ptr, (unsigned long long) size);
 
   return ptr;
 }
@@ -346,7 +349,7 @@ static int GCS_Shmem_free(void* ptr, MPI_Comm comm)
 
   if (gcs_shm_ptr_tree != NULL) {
     /* lookup size based on pointer address, then call munmap */
-    const char* size_str = strmap_getf(gcs_shm_ptr_tree, "%x", ptr);
+    const char* size_str = strhash_getf(gcs_shm_ptr_tree, "%x", ptr);
     if (size_str != NULL) {
       /* TODO: should code a function to extract this value */
       size_t size = strtoull(size_str, NULL, 10);
@@ -359,7 +362,7 @@ static int GCS_Shmem_free(void* ptr, MPI_Comm comm)
       }
 
       /* after the memory is unmapped, remove it from the cache */
-      strmap_unsetf(gcs_shm_ptr_tree, "%x", ptr);
+      strhash_unsetf(gcs_shm_ptr_tree, "%x", ptr);
     } else {
       /* error: this pointer is not registered */
       return (! GCS_SUCCESS);
@@ -423,6 +426,1071 @@ void compute_offset_size(
     return;
 }
 
+/* an item of a directory tree being broadcast */
+typedef struct {
+    char* name;          /* path relative to source directory, "" for the directory itself */
+    char* target;        /* target of a symlink, NULL for other items */
+    mfu_filetype type;   /* file, directory, or symlink */
+    int depth;           /* number of components in name */
+    uint64_t mode;       /* mode bits */
+    uint64_t size;       /* size in bytes of a regular file */
+    uint64_t offset;     /* offset of file data in the stream */
+    uint64_t atime;
+    uint64_t atime_nsec;
+    uint64_t mtime;
+    uint64_t mtime_nsec;
+} bcast_item;
+
+/* a directory tree being broadcast, the data of all regular files
+ * is concatenated into a single stream, which is moved through the
+ * pipeline as if it were one file, so that many small files share
+ * a chunk, every process holds the full list of items */
+typedef struct {
+    const char* src;     /* source directory */
+    const char* dest;    /* destination directory */
+    uint64_t count;      /* number of items */
+    bcast_item* items;   /* items sorted by name */
+    uint64_t file_count; /* number of regular files with data */
+    uint64_t* files;     /* index of each file in items, in stream order */
+    uint64_t bytes;      /* total size of stream */
+    int fd;              /* file opened last, to read or write */
+    uint64_t fd_file;    /* index in files of file opened last */
+    char* fd_path;       /* path of file opened last */
+} bcast_tree;
+
+static int tree_item_cmp(const void* a, const void* b)
+{
+    const bcast_item* ia = (const bcast_item*) a;
+    const bcast_item* ib = (const bcast_item*) b;
+    return strcmp(ia->name, ib->name);
+}
+
+/* return newly allocated path of item idx under base */
+static char* tree_path(const bcast_tree* tree, const char* base, uint64_t idx)
+{
+    const char* name = tree->items[idx].name;
+    if (name[0] == '\0') {
+        return MFU_STRDUP(base);
+    }
+    size_t len = strlen(base) + strlen(name) + 2;
+    char* path = (char*) MFU_MALLOC(len);
+    snprintf(path, len, "%s/%s", base, name);
+    return path;
+}
+
+/* pack items of flist that are under src into a newly allocated
+ * buffer, sets bytes to its size and count to number of items */
+static char* tree_pack(mfu_flist flist, const char* src, size_t* bytes, uint64_t* count)
+{
+    size_t srclen = strlen(src);
+    uint64_t size = mfu_flist_size(flist);
+
+    /* first pass to size the buffer, second pass to fill it */
+    char* buf = NULL;
+    int pass;
+    for (pass = 0; pass < 2; pass++) {
+        size_t total = 0;
+        uint64_t n = 0;
+        uint64_t idx;
+        for (idx = 0; idx < size; idx++) {
+            const char* name = mfu_flist_file_get_name(flist, idx);
+            mfu_filetype type = mfu_flist_file_get_type(flist, idx);
+
+            /* skip items outside of the source directory */
+            if (strncmp(name, src, srclen) != 0 ||
+                (name[srclen] != '/' && name[srclen] != '\0'))
+            {
+                continue;
+            }
+            const char* rel = name + srclen;
+            if (*rel == '/') {
+                rel++;
+            }
+
+            /* skip items we can't create on the destination */
+            if (type != MFU_TYPE_FILE && type != MFU_TYPE_DIR && type != MFU_TYPE_LINK) {
+                if (pass == 0) {
+                    MFU_LOG(MFU_LOG_WARN, "Skipping `%s`, not a file, directory, or symlink", name);
+                }
+                continue;
+            }
+
+            /* read target of symlink */
+            char target[PATH_MAX + 1];
+            size_t target_len = 0;
+            if (type == MFU_TYPE_LINK) {
+                ssize_t rc = mfu_readlink(name, target, sizeof(target) - 1);
+                if (rc < 0) {
+                    if (pass == 0) {
+                        MFU_LOG(MFU_LOG_ERR, "Failed to read link `%s` (%s)", name, strerror(errno));
+                    }
+                    continue;
+                }
+                target_len = (size_t) rc;
+            }
+
+            size_t rel_len = strlen(rel);
+            if (pass == 1) {
+                char* ptr = buf + total;
+                mfu_pack_uint64(&ptr, (uint64_t) type);
+                mfu_pack_uint64(&ptr, mfu_flist_file_get_mode(flist, idx));
+                mfu_pack_uint64(&ptr, (type == MFU_TYPE_FILE) ? mfu_flist_file_get_size(flist, idx) : 0);
+                mfu_pack_uint64(&ptr, mfu_flist_file_get_atime(flist, idx));
+                mfu_pack_uint64(&ptr, mfu_flist_file_get_atime_nsec(flist, idx));
+                mfu_pack_uint64(&ptr, mfu_flist_file_get_mtime(flist, idx));
+                mfu_pack_uint64(&ptr, mfu_flist_file_get_mtime_nsec(flist, idx));
+                mfu_pack_uint64(&ptr, (uint64_t) rel_len);
+                mfu_pack_uint64(&ptr, (uint64_t) target_len);
+                memcpy(ptr, rel, rel_len);
+                memcpy(ptr + rel_len, target, target_len);
+            }
+            total += 9 * 8 + rel_len + target_len;
+            n++;
+        }
+
+        if (pass == 0) {
+            buf = (char*) MFU_MALLOC(total);
+        }
+        *bytes = total;
+        *count = n;
+    }
+
+    return buf;
+}
+
+/* largest number of bytes sent in one message when exchanging the
+ * packed list, counts of MPI calls are ints */
+#define TREE_MSG_MAX (1024 * 1024 * 1024)
+
+/* send bytes from buf to dest in messages of at most TREE_MSG_MAX bytes */
+static void tree_send(const char* buf, uint64_t bytes, int dest, MPI_Comm comm)
+{
+    while (bytes > 0) {
+        int n = (bytes > TREE_MSG_MAX) ? TREE_MSG_MAX : (int) bytes;
+        MPI_Send((void*) buf, n, MPI_BYTE, dest, 0, comm);
+        buf   += n;
+        bytes -= (uint64_t) n;
+    }
+}
+
+/* receive bytes into buf from src as sent by tree_send */
+static void tree_recv(char* buf, uint64_t bytes, int src, MPI_Comm comm)
+{
+    while (bytes > 0) {
+        int n = (bytes > TREE_MSG_MAX) ? TREE_MSG_MAX : (int) bytes;
+        MPI_Recv(buf, n, MPI_BYTE, src, 0, comm, MPI_STATUS_IGNORE);
+        buf   += n;
+        bytes -= (uint64_t) n;
+    }
+}
+
+/* broadcast bytes of buf from root in messages of at most TREE_MSG_MAX bytes */
+static void tree_bcast(char* buf, uint64_t bytes, int root, MPI_Comm comm)
+{
+    while (bytes > 0) {
+        int n = (bytes > TREE_MSG_MAX) ? TREE_MSG_MAX : (int) bytes;
+        MPI_Bcast(buf, n, MPI_BYTE, root, comm);
+        buf   += n;
+        bytes -= (uint64_t) n;
+    }
+}
+
+/* collect the packed items of all procs on all procs, sets total to the
+ * number of bytes in the returned buffer, items from each node are
+ * gathered on the node leader, the leaders exchange the lists of their
+ * nodes, and each leader then passes the full list to the procs on its
+ * node, level_comm is only used on node leaders, must be called by all
+ * ranks */
+static char* tree_exchange(
+    char* packed,
+    uint64_t packed_bytes,
+    MPI_Comm node_comm,
+    MPI_Comm level_comm,
+    uint64_t* total)
+{
+    int node_rank, node_size;
+    MPI_Comm_rank(node_comm, &node_rank);
+    MPI_Comm_size(node_comm, &node_size);
+
+    /* gather items of our node on its leader */
+    uint64_t* node_bytes = NULL;
+    if (node_rank == 0) {
+        node_bytes = (uint64_t*) MFU_MALLOC(node_size * sizeof(uint64_t));
+    }
+    MPI_Gather(&packed_bytes, 1, MPI_UINT64_T, node_bytes, 1, MPI_UINT64_T, 0, node_comm);
+
+    char* all = NULL;
+    uint64_t all_bytes = 0;
+    if (node_rank == 0) {
+        uint64_t bytes = 0;
+        int i;
+        for (i = 0; i < node_size; i++) {
+            bytes += node_bytes[i];
+        }
+
+        /* exchange sizes of the lists of each node among leaders */
+        int level_rank, level_size;
+        MPI_Comm_rank(level_comm, &level_rank);
+        MPI_Comm_size(level_comm, &level_size);
+        uint64_t* level_bytes = (uint64_t*) MFU_MALLOC(level_size * sizeof(uint64_t));
+        MPI_Allgather(&bytes, 1, MPI_UINT64_T, level_bytes, 1, MPI_UINT64_T, level_comm);
+
+        uint64_t* level_disps = (uint64_t*) MFU_MALLOC(level_size * sizeof(uint64_t));
+        for (i = 0; i < level_size; i++) {
+            level_disps[i] = all_bytes;
+            all_bytes += level_bytes[i];
+        }
+        all = (char*) MFU_MALLOC(all_bytes);
+
+        /* place our items and those of the other procs on our node */
+        char* ptr = all + level_disps[level_rank];
+        memcpy(ptr, packed, packed_bytes);
+        ptr += packed_bytes;
+        for (i = 1; i < node_size; i++) {
+            tree_recv(ptr, node_bytes[i], i, node_comm);
+            ptr += node_bytes[i];
+        }
+
+        /* send the list of each node to the other leaders */
+        for (i = 0; i < level_size; i++) {
+            tree_bcast(all + level_disps[i], level_bytes[i], i, level_comm);
+        }
+
+        mfu_free(&level_disps);
+        mfu_free(&level_bytes);
+        mfu_free(&node_bytes);
+    } else {
+        tree_send(packed, packed_bytes, 0, node_comm);
+    }
+
+    /* pass full list to the other procs on the node */
+    MPI_Bcast(&all_bytes, 1, MPI_UINT64_T, 0, node_comm);
+    if (node_rank != 0) {
+        all = (char*) MFU_MALLOC(all_bytes);
+    }
+    tree_bcast(all, all_bytes, 0, node_comm);
+
+    *total = all_bytes;
+    return all;
+}
+
+/* walk src, or read the list of items from the input file, and gather
+ * the list on all processes, must be called by all ranks */
+static bcast_tree* tree_build(
+    const char* src,
+    const char* dest,
+    const char* input,
+    MPI_Comm node_comm,
+    MPI_Comm level_comm)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    /* get list of items */
+    mfu_flist flist = mfu_flist_new();
+    if (input != NULL) {
+        mfu_flist_read_cache(input, flist);
+    } else {
+        mfu_walk_opts_t* walk_opts = mfu_walk_opts_new();
+        mfu_file_t* mfu_file = mfu_file_new();
+        mfu_flist_walk_path(src, walk_opts, flist, mfu_file);
+        mfu_file_delete(&mfu_file);
+        mfu_walk_opts_delete(&walk_opts);
+    }
+
+    /* pack our items and gather them on all ranks */
+    size_t packed_bytes;
+    uint64_t packed_count;
+    char* packed = tree_pack(flist, src, &packed_bytes, &packed_count);
+    mfu_flist_free(&flist);
+
+    uint64_t total_bytes;
+    char* all = tree_exchange(packed, (uint64_t) packed_bytes, node_comm, level_comm, &total_bytes);
+
+    uint64_t count;
+    MPI_Allreduce(&packed_count, &count, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+    mfu_free(&packed);
+
+    /* unpack items */
+    bcast_tree* tree = (bcast_tree*) MFU_MALLOC(sizeof(bcast_tree));
+    tree->src     = src;
+    tree->dest    = dest;
+    tree->count   = count;
+    tree->items   = (bcast_item*) MFU_MALLOC(count * sizeof(bcast_item));
+    tree->fd      = -1;
+    tree->fd_file = 0;
+    tree->fd_path = NULL;
+
+    const char* ptr = all;
+    uint64_t idx;
+    for (idx = 0; idx < count; idx++) {
+        bcast_item* item = &tree->items[idx];
+        uint64_t type, name_len, target_len;
+        mfu_unpack_uint64(&ptr, &type);
+        mfu_unpack_uint64(&ptr, &item->mode);
+        mfu_unpack_uint64(&ptr, &item->size);
+        mfu_unpack_uint64(&ptr, &item->atime);
+        mfu_unpack_uint64(&ptr, &item->atime_nsec);
+        mfu_unpack_uint64(&ptr, &item->mtime);
+        mfu_unpack_uint64(&ptr, &item->mtime_nsec);
+        mfu_unpack_uint64(&ptr, &name_len);
+        mfu_unpack_uint64(&ptr, &target_len);
+        item->type = (mfu_filetype) type;
+
+        item->name = (char*) MFU_MALLOC(name_len + 1);
+        memcpy(item->name, ptr, name_len);
+        item->name[name_len] = '\0';
+        ptr += name_len;
+
+        item->target = NULL;
+        if (item->type == MFU_TYPE_LINK) {
+            item->target = (char*) MFU_MALLOC(target_len + 1);
+            memcpy(item->target, ptr, target_len);
+            item->target[target_len] = '\0';
+        }
+        ptr += target_len;
+
+        /* count components in name */
+        item->depth = 0;
+        if (name_len > 0) {
+            item->depth = 1;
+            const char* c;
+            for (c = item->name; *c != '\0'; c++) {
+                if (*c == '/') {
+                    item->depth++;
+                }
+            }
+        }
+    }
+    mfu_free(&all);
+
+    /* order items the same way on all ranks */
+    qsort(tree->items, (size_t) count, sizeof(bcast_item), tree_item_cmp);
+
+    /* lay out file data in the stream in name order */
+    tree->files = (uint64_t*) MFU_MALLOC(count * sizeof(uint64_t));
+    tree->file_count = 0;
+    tree->bytes = 0;
+    uint64_t dirs = 0;
+    for (idx = 0; idx < count; idx++) {
+        bcast_item* item = &tree->items[idx];
+        item->offset = tree->bytes;
+        if (item->type == MFU_TYPE_FILE && item->size > 0) {
+            tree->files[tree->file_count++] = idx;
+            tree->bytes += item->size;
+        }
+        if (item->type == MFU_TYPE_DIR) {
+            dirs++;
+        }
+    }
+
+    if (rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Broadcasting %llu items (%llu directories) with %llu bytes from `%s` to `%s`",
+            (unsigned long long) count, (unsigned long long) dirs,
+            (unsigned long long) tree->bytes, src, dest
+        );
+    }
+
+    return tree;
+}
+
+static void tree_close(bcast_tree* tree)
+{
+    if (tree->fd >= 0) {
+        errno = 0;
+        if (mfu_close(tree->fd_path, tree->fd) != 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to close file `%s` (%s)", tree->fd_path, strerror(errno));
+        }
+        tree->fd = -1;
+    }
+    mfu_free(&tree->fd_path);
+}
+
+static void tree_free(bcast_tree** ptree)
+{
+    bcast_tree* tree = *ptree;
+    tree_close(tree);
+
+    uint64_t idx;
+    for (idx = 0; idx < tree->count; idx++) {
+        mfu_free(&tree->items[idx].target);
+        mfu_free(&tree->items[idx].name);
+    }
+    mfu_free(&tree->files);
+    mfu_free(&tree->items);
+    mfu_free(ptree);
+}
+
+/* return index in files of the file holding byte pos of the stream */
+static uint64_t tree_find(const bcast_tree* tree, uint64_t pos)
+{
+    uint64_t lo = 0;
+    uint64_t hi = tree->file_count - 1;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo + 1) / 2;
+        if (tree->items[tree->files[mid]].offset <= pos) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
+/* open file k of the stream under base, keeping it open for the
+ * next chunk, returns -1 on error */
+static int tree_open(bcast_tree* tree, const char* base, uint64_t k, int flags)
+{
+    if (tree->fd >= 0 && tree->fd_file == k) {
+        return 0;
+    }
+    tree_close(tree);
+
+    tree->fd_path = tree_path(tree, base, tree->files[k]);
+    errno = 0;
+    tree->fd = mfu_open(tree->fd_path, flags);
+    if (tree->fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open file `%s` (%s)", tree->fd_path, strerror(errno));
+        mfu_free(&tree->fd_path);
+        return -1;
+    }
+    tree->fd_file = k;
+    return 0;
+}
+
+/* read size bytes at pos of the stream from source files into buf,
+ * returns -1 on error */
+static int tree_read(bcast_tree* tree, char* buf, uint64_t pos, size_t size)
+{
+    uint64_t k = tree_find(tree, pos);
+    while (size > 0) {
+        const bcast_item* item = &tree->items[tree->files[k]];
+        uint64_t file_pos = pos - item->offset;
+        size_t n = size;
+        if ((uint64_t) n > item->size - file_pos) {
+            n = (size_t) (item->size - file_pos);
+        }
+
+        if (tree_open(tree, tree->src, k, O_RDONLY) != 0) {
+            return -1;
+        }
+
+        errno = 0;
+        if (mfu_lseek(tree->fd_path, tree->fd, (off_t) file_pos, SEEK_SET) == (off_t)-1) {
+            MFU_LOG(MFU_LOG_ERR, "Seek failed on file `%s` (%s)", tree->fd_path, strerror(errno));
+            return -1;
+        }
+
+        errno = 0;
+        ssize_t return_size = mfu_read(tree->fd_path, tree->fd, buf, n);
+        if (return_size != (ssize_t) n) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to read contents from `%s` (%s)", tree->fd_path, strerror(errno));
+            return -1;
+        }
+
+        buf  += n;
+        pos  += (uint64_t) n;
+        size -= n;
+        k++;
+    }
+    return 0;
+}
+
+/* write size bytes at pos of the stream from buf to destination files,
+ * returns -1 on error */
+static int tree_write(bcast_tree* tree, const char* buf, uint64_t pos, size_t size)
+{
+    uint64_t k = tree_find(tree, pos);
+    while (size > 0) {
+        const bcast_item* item = &tree->items[tree->files[k]];
+        uint64_t file_pos = pos - item->offset;
+        size_t n = size;
+        if ((uint64_t) n > item->size - file_pos) {
+            n = (size_t) (item->size - file_pos);
+        }
+
+        if (tree_open(tree, tree->dest, k, O_WRONLY) != 0) {
+            return -1;
+        }
+
+        errno = 0;
+        if (mfu_lseek(tree->fd_path, tree->fd, (off_t) file_pos, SEEK_SET) == (off_t)-1) {
+            MFU_LOG(MFU_LOG_ERR, "Seek failed on file `%s` (%s)", tree->fd_path, strerror(errno));
+            return -1;
+        }
+
+        errno = 0;
+        ssize_t return_size = mfu_write(tree->fd_path, tree->fd, buf, n);
+        if (return_size != (ssize_t) n) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to write contents to `%s` (%s)", tree->fd_path, strerror(errno));
+            return -1;
+        }
+
+        buf  += n;
+        pos  += (uint64_t) n;
+        size -= n;
+        k++;
+    }
+    return 0;
+}
+
+/* create directories, symlinks, and empty files of the tree on this
+ * node, spreading items over all procs on the node, directories are
+ * created one level at a time so that parents exist before children,
+ * any file or symlink already at the path of an item is unlinked and
+ * created again, even if it holds the same data, so the data of every
+ * file is written on each broadcast, returns the number of items that
+ * failed on the node, must be called by all procs in node_comm */
+static int tree_create(bcast_tree* tree, MPI_Comm node_comm)
+{
+    int node_rank, node_size;
+    MPI_Comm_rank(node_comm, &node_rank);
+    MPI_Comm_size(node_comm, &node_size);
+
+    int errors = 0;
+
+    /* find deepest directory */
+    int max_depth = 0;
+    uint64_t idx;
+    for (idx = 0; idx < tree->count; idx++) {
+        if (tree->items[idx].depth > max_depth) {
+            max_depth = tree->items[idx].depth;
+        }
+    }
+
+    /* create directories level by level, the destination
+     * directory itself already exists */
+    int depth;
+    for (depth = 1; depth <= max_depth; depth++) {
+        uint64_t n = 0;
+        for (idx = 0; idx < tree->count; idx++) {
+            const bcast_item* item = &tree->items[idx];
+            if (item->type != MFU_TYPE_DIR || item->depth != depth) {
+                continue;
+            }
+            if (n++ % (uint64_t) node_size != (uint64_t) node_rank) {
+                continue;
+            }
+
+            /* create directory with owner access, the mode is set
+             * once all items inside of it have been written */
+            char* path = tree_path(tree, tree->dest, idx);
+            errno = 0;
+            if (mfu_mkdir(path, S_IRWXU) != 0) {
+                if (errno != EEXIST) {
+                    MFU_LOG(MFU_LOG_ERR, "Failed to create directory `%s` (%s)", path, strerror(errno));
+                    errors++;
+                } else {
+                    /* left by an earlier broadcast, which may have
+                     * set a mode that keeps us from writing into it */
+                    mfu_chmod(path, S_IRWXU);
+                }
+            }
+            mfu_free(&path);
+        }
+        MPI_Barrier(node_comm);
+    }
+
+    /* create files at their full size and symlinks */
+    uint64_t n = 0;
+    for (idx = 0; idx < tree->count; idx++) {
+        const bcast_item* item = &tree->items[idx];
+        if (item->type == MFU_TYPE_DIR) {
+            continue;
+        }
+        if (n++ % (uint64_t) node_size != (uint64_t) node_rank) {
+            continue;
+        }
+
+        /* replace any existing item, which may be read-only */
+        char* path = tree_path(tree, tree->dest, idx);
+        mfu_unlink(path);
+        if (item->type == MFU_TYPE_FILE) {
+            errno = 0;
+            int fd = mfu_open(path, O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR);
+            if (fd < 0) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to create file `%s` (%s)", path, strerror(errno));
+                errors++;
+            } else {
+                if (mfu_ftruncate(fd, (off_t) item->size) != 0) {
+                    MFU_LOG(MFU_LOG_ERR, "Failed to truncate file `%s` (%s)", path, strerror(errno));
+                    errors++;
+                }
+                mfu_close(path, fd);
+            }
+        } else {
+            errno = 0;
+            if (mfu_symlink(item->target, path) != 0) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to create link `%s` (%s)", path, strerror(errno));
+                errors++;
+            }
+        }
+        mfu_free(&path);
+    }
+
+    int all_errors;
+    MPI_Allreduce(&errors, &all_errors, 1, MPI_INT, MPI_SUM, node_comm);
+    return all_errors;
+}
+
+/* set mode and timestamps on one item of the tree, returns -1 on error */
+static int tree_set_meta(bcast_tree* tree, uint64_t idx)
+{
+    int rc = 0;
+    const bcast_item* item = &tree->items[idx];
+    char* path = tree_path(tree, tree->dest, idx);
+
+    if (item->type != MFU_TYPE_LINK) {
+        errno = 0;
+        if (mfu_chmod(path, (mode_t) (item->mode & 07777)) != 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to chmod `%s` (%s)", path, strerror(errno));
+            rc = -1;
+        }
+    }
+
+    struct timespec times[2];
+    times[0].tv_sec  = (time_t) item->atime;
+    times[0].tv_nsec = (long) item->atime_nsec;
+    times[1].tv_sec  = (time_t) item->mtime;
+    times[1].tv_nsec = (long) item->mtime_nsec;
+    errno = 0;
+    if (mfu_utimensat(AT_FDCWD, path, times, AT_SYMLINK_NOFOLLOW) != 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to set timestamps on `%s` (%s)", path, strerror(errno));
+        rc = -1;
+    }
+
+    mfu_free(&path);
+    return rc;
+}
+
+/* set mode and timestamps of all items on this node, spreading items
+ * over all procs on the node, directories are done last, after the items
+ * inside of them, since creating those items changes their timestamps,
+ * returns number of items that failed on the node, must be called
+ * by all procs in node_comm */
+static int tree_finish(bcast_tree* tree, MPI_Comm node_comm)
+{
+    int node_rank, node_size;
+    MPI_Comm_rank(node_comm, &node_rank);
+    MPI_Comm_size(node_comm, &node_size);
+
+    int errors = 0;
+
+    uint64_t n = 0;
+    uint64_t idx;
+    for (idx = 0; idx < tree->count; idx++) {
+        if (tree->items[idx].type == MFU_TYPE_DIR) {
+            continue;
+        }
+        if (n++ % (uint64_t) node_size == (uint64_t) node_rank) {
+            if (tree_set_meta(tree, idx) != 0) {
+                errors++;
+            }
+        }
+    }
+    MPI_Barrier(node_comm);
+
+    /* items are sorted by name, so children follow their parent */
+    n = 0;
+    for (idx = tree->count; idx > 0; idx--) {
+        if (tree->items[idx - 1].type != MFU_TYPE_DIR) {
+            continue;
+        }
+        if (n++ % (uint64_t) node_size == (uint64_t) node_rank) {
+            if (tree_set_meta(tree, idx - 1) != 0) {
+                errors++;
+            }
+        }
+    }
+
+    int all_errors;
+    MPI_Allreduce(&errors, &all_errors, 1, MPI_INT, MPI_SUM, node_comm);
+    return all_errors;
+}
+
+/* blocks to send when nodes already hold a copy of the file,
+ * blocks have the size of a chunk, and the blocks to send are laid
+ * end to end in a stream, which moves through the pipeline in place
+ * of the file */
+typedef struct {
+    size_t block_size; /* size of each block in bytes */
+    uint64_t blocks;   /* number of blocks in the file */
+    uint64_t count;    /* number of blocks to send */
+    uint64_t* send;    /* index of each block to send, in stream order */
+    uint8_t* need;     /* whether this node needs each block */
+    uint64_t bytes;    /* total size of stream */
+    uint64_t matched;  /* bytes of the copy on this node that match */
+    int active;        /* whether this node needs any block */
+} bcast_skip;
+
+/* return offset in file of byte pos of the stream */
+static off_t skip_file_pos(const bcast_skip* skip, off_t pos)
+{
+    if (skip == NULL) {
+        return pos;
+    }
+    uint64_t block = skip->send[(uint64_t) pos / skip->block_size];
+    return (off_t) (block * skip->block_size + (uint64_t) pos % skip->block_size);
+}
+
+/* number of 64-bit words in the digest of a block */
+#define SKIP_DIGEST_WORDS (SHA256_DIGEST_LENGTH / 8)
+
+/* compute SHA256 digest of len bytes at offset of an open file, a
+ * matching digest decides that a block is not written, so this uses
+ * a cryptographic hash, returns -1 on a read error or short read */
+static int skip_digest(const char* path, int fd, uint64_t offset, size_t len, char* buf, uint64_t* value)
+{
+    errno = 0;
+    if (mfu_lseek(path, fd, (off_t) offset, SEEK_SET) == (off_t)-1) {
+        return -1;
+    }
+    errno = 0;
+    ssize_t return_size = mfu_read(path, fd, buf, len);
+    if (return_size != (ssize_t) len) {
+        return -1;
+    }
+    SHA256((const unsigned char*) buf, len, (unsigned char*) value);
+    return 0;
+}
+
+/* compare digests of the blocks of the source file with those of the
+ * copy already on each node, readers hash blocks of the source, and
+ * all procs on a node hash blocks of the local copy, has_copy is set on
+ * node_rank 0 of nodes whose copy is open, and copy_size to its size,
+ * returns NULL if no node holds a copy, must be called by all ranks */
+static bcast_skip* skip_plan(
+    const char* in_file_path,
+    int in_file,
+    const char* out_file_path,
+    uint64_t file_size,
+    size_t block_size,
+    int has_copy,
+    uint64_t copy_size,
+    int write_error,
+    MPI_Comm node_comm,
+    int reader_rank,
+    int reader_size)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    int node_rank, node_size;
+    MPI_Comm_rank(node_comm, &node_rank);
+    MPI_Comm_size(node_comm, &node_size);
+
+    /* hashing the source costs one extra read of the file,
+     * which is only worth it if some node has a copy */
+    if (! gcs_anytrue(has_copy, MPI_COMM_WORLD)) {
+        return NULL;
+    }
+
+    double time_start = MPI_Wtime();
+
+    /* let all procs on the node know about the local copy */
+    uint64_t copy_info[3] = {(uint64_t) has_copy, copy_size, (uint64_t) write_error};
+    MPI_Bcast(copy_info, 3, MPI_UINT64_T, 0, node_comm);
+
+    uint64_t blocks = (file_size + block_size - 1) / block_size;
+    char* buf = (char*) MFU_MALLOC(block_size);
+
+    /* readers hash their share of blocks of the source */
+    uint64_t words = blocks * SKIP_DIGEST_WORDS;
+    uint64_t* src_digests = (uint64_t*) MFU_MALLOC(words * sizeof(uint64_t) + 1);
+    memset(src_digests, 0, words * sizeof(uint64_t));
+    uint64_t b;
+    if (node_rank != 0) {
+        for (b = (uint64_t) reader_rank; b < blocks; b += (uint64_t) reader_size) {
+            uint64_t offset = b * block_size;
+            size_t len = (size_t) ((file_size - offset < block_size) ? file_size - offset : block_size);
+            if (skip_digest(in_file_path, in_file, offset, len, buf, &src_digests[b * SKIP_DIGEST_WORDS]) != 0) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to read contents from `%s` (%s)", in_file_path, strerror(errno));
+                file_bcast_exit();
+            }
+        }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, src_digests, (int) words, MPI_UINT64_T, MPI_BOR, MPI_COMM_WORLD);
+
+    /* all procs on the node hash their share of blocks of the local copy
+     * and mark those that differ, a node that failed to open its file
+     * can't write, so it needs nothing, and one without a copy needs all */
+    uint8_t* need = (uint8_t*) MFU_MALLOC(blocks + 1);
+    memset(need, 0, blocks);
+    if (copy_info[2]) {
+        /* write error, needs nothing */
+    } else if (! copy_info[0]) {
+        memset(need, 1, blocks);
+    } else {
+        int fd = -1;
+        if (blocks > (uint64_t) node_rank) {
+            errno = 0;
+            fd = mfu_open(out_file_path, O_RDONLY);
+            if (fd < 0) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to open file `%s` for reading (%s)", out_file_path, strerror(errno));
+            }
+        }
+        for (b = (uint64_t) node_rank; b < blocks; b += (uint64_t) node_size) {
+            uint64_t offset = b * block_size;
+            size_t len = (size_t) ((file_size - offset < block_size) ? file_size - offset : block_size);
+
+            /* send blocks we can't read or that extend past our copy */
+            uint64_t value[SKIP_DIGEST_WORDS];
+            if (fd < 0 || offset + len > copy_info[1] ||
+                skip_digest(out_file_path, fd, offset, len, buf, value) != 0 ||
+                memcmp(value, &src_digests[b * SKIP_DIGEST_WORDS], sizeof(value)) != 0)
+            {
+                need[b] = 1;
+            }
+        }
+        if (fd >= 0) {
+            mfu_close(out_file_path, fd);
+        }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, need, (int) blocks, MPI_UNSIGNED_CHAR, MPI_BOR, node_comm);
+
+    mfu_free(&src_digests);
+    mfu_free(&buf);
+
+    /* send a block if any node needs it */
+    uint8_t* any_need = (uint8_t*) MFU_MALLOC(blocks + 1);
+    memcpy(any_need, need, blocks);
+    MPI_Allreduce(MPI_IN_PLACE, any_need, (int) blocks, MPI_UNSIGNED_CHAR, MPI_BOR, MPI_COMM_WORLD);
+
+    bcast_skip* skip = (bcast_skip*) MFU_MALLOC(sizeof(bcast_skip));
+    skip->block_size = block_size;
+    skip->blocks = blocks;
+    skip->need   = need;
+    skip->send   = (uint64_t*) MFU_MALLOC(blocks * sizeof(uint64_t) + 1);
+    skip->count  = 0;
+    skip->bytes  = 0;
+    skip->matched = 0;
+    skip->active = 0;
+    for (b = 0; b < blocks; b++) {
+        uint64_t offset = b * block_size;
+        uint64_t len = (file_size - offset < block_size) ? file_size - offset : block_size;
+        if (any_need[b]) {
+            skip->send[skip->count++] = b;
+            skip->bytes += len;
+        }
+        if (need[b]) {
+            skip->active = 1;
+        } else if (copy_info[0] && ! copy_info[2]) {
+            skip->matched += len;
+        }
+    }
+    mfu_free(&any_need);
+
+    /* count nodes that need any block */
+    int active = (node_rank == 0 && skip->active);
+    int nodes = (node_rank == 0);
+    int counts[2] = {active, nodes};
+    int all_counts[2];
+    MPI_Reduce(counts, all_counts, 2, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        double time_diff = MPI_Wtime() - time_start;
+        MFU_LOG(MFU_LOG_INFO, "Compared %llu blocks in %f secs: sending %llu blocks (%llu bytes) to %d of %d nodes",
+            (unsigned long long) blocks, time_diff, (unsigned long long) skip->count,
+            (unsigned long long) skip->bytes, all_counts[0], all_counts[1]
+        );
+    }
+
+    return skip;
+}
+
+static void skip_free(bcast_skip** pskip)
+{
+    bcast_skip* skip = *pskip;
+    if (skip != NULL) {
+        mfu_free(&skip->send);
+        mfu_free(&skip->need);
+    }
+    mfu_free(pskip);
+}
+
+/* compute offset and size of the chunk read by a reader in a given
+ * round of the pipeline, each round moves one chunk from every reader,
+ * and consecutive rounds walk through one stripe of each reader before
+ * moving on to the next set of stripes */
+static void compute_round_offset_size(
+  uint64_t round,       /* round of the pipeline */
+  uint64_t file_size,   /* file size in bytes */
+  uint64_t stripe_size, /* stripe size in bytes */
+  size_t   chunk_size,  /* chunk size in bytes */
+  int      reader_size, /* number of readers */
+  int      rank,        /* rank of reader */
+  off_t*   outpos,      /* offset where rank will read this chunk from */
+  size_t*  outsize)     /* size which rank will read */
+{
+    uint64_t chunks   = stripe_size / (uint64_t) chunk_size;
+    uint64_t chunk_id = round % chunks;
+    uint64_t bytes_read = (round / chunks) * stripe_size * (uint64_t) reader_size;
+    uint64_t stripe_read = chunk_id * (uint64_t) chunk_size;
+    compute_offset_size(
+        bytes_read, stripe_read, file_size, stripe_size, chunk_size, rank, chunk_id,
+        outpos, outsize
+    );
+}
+
+/* time spent and bytes moved in each stage of the pipeline */
+typedef struct {
+    double   read_secs;   /* time spent reading from the input file */
+    uint64_t read_bytes;  /* bytes read from the input file */
+    double   bcast_secs;  /* time spent waiting on data from other nodes */
+    uint64_t bcast_bytes; /* bytes received from other nodes */
+    double   write_secs;  /* time spent comparing and writing output */
+    uint64_t write_bytes; /* bytes written to the output file */
+    uint64_t skip_bytes;  /* bytes not written, since the copy matched */
+} bcast_stats;
+
+/* read a chunk from the input file, or from the files of a tree, into buf */
+static void read_chunk(bcast_tree* tree, const char* path, int fd, void* buf, off_t pos, size_t size, bcast_stats* stats)
+{
+    if (size == 0) {
+        return;
+    }
+
+    double start = MPI_Wtime();
+
+    if (tree != NULL) {
+        if (tree_read(tree, (char*) buf, (uint64_t) pos, size) != 0) {
+            file_bcast_exit();
+        }
+        stats->read_secs  += MPI_Wtime() - start;
+        stats->read_bytes += (uint64_t) size;
+        return;
+    }
+
+    /* seek to offset in input file */
+    errno = 0;
+    off_t rc = mfu_lseek(path, fd, pos, SEEK_SET);
+    if (rc == (off_t)-1) {
+        MFU_LOG(MFU_LOG_ERR, "Seek failed on file `%s` (%s)", path, strerror(errno));
+        file_bcast_exit();
+    }
+
+    /* read chunk from file */
+    errno = 0;
+    ssize_t return_size = mfu_read(path, fd, buf, size);
+    if (return_size != (ssize_t)size) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to read contents from `%s` (%s)", path, strerror(errno));
+        file_bcast_exit();
+    }
+
+    stats->read_secs  += MPI_Wtime() - start;
+    stats->read_bytes += (uint64_t) size;
+}
+
+/* chunk buffers of one reader, each buffer is free, held by the
+ * reader while it is filled and sent on, or queued at the writer,
+ * which returns buffers in the order it was given them */
+typedef struct {
+    int* free;     /* stack of ids of free buffers */
+    int count;     /* number of free buffers */
+    int queued;    /* number of buffers queued at the writer */
+    MPI_Comm comm; /* node communicator, the writer is rank 0 */
+} bcast_pool;
+
+static void pool_init(bcast_pool* pool, int first, int depth, MPI_Comm comm)
+{
+    pool->free = (int*) MFU_MALLOC(depth * sizeof(int));
+    pool->count = 0;
+    pool->queued = 0;
+    pool->comm = comm;
+
+    int i;
+    for (i = depth - 1; i >= 0; i--) {
+        pool->free[pool->count++] = first + i;
+    }
+}
+
+/* get a free buffer, waiting for the writer to return one if needed */
+static int pool_get(bcast_pool* pool)
+{
+    if (pool->count > 0) {
+        pool->count--;
+        return pool->free[pool->count];
+    }
+
+    int shmid;
+    MPI_Status status;
+    MPI_Recv(&shmid, 1, MPI_INT, 0, 0, pool->comm, &status);
+    pool->queued--;
+    return shmid;
+}
+
+/* get a free buffer if one is available now, returns -1 otherwise */
+static int pool_try_get(bcast_pool* pool)
+{
+    if (pool->count == 0 && pool->queued > 0) {
+        int flag;
+        MPI_Status status;
+        MPI_Iprobe(0, 0, pool->comm, &flag, &status);
+        if (flag) {
+            return pool_get(pool);
+        }
+    }
+
+    if (pool->count > 0) {
+        return pool_get(pool);
+    }
+    return -1;
+}
+
+/* hand a filled buffer to the writer */
+static void pool_queue(bcast_pool* pool, int shmid)
+{
+    MPI_Send(&shmid, 1, MPI_INT, 0, 0, pool->comm);
+    pool->queued++;
+}
+
+/* wait for the writer to return all buffers, and free the pool */
+static void pool_fini(bcast_pool* pool)
+{
+    while (pool->queued > 0) {
+        int shmid;
+        MPI_Status status;
+        MPI_Recv(&shmid, 1, MPI_INT, 0, 0, pool->comm, &status);
+        pool->queued--;
+    }
+    mfu_free(&pool->free);
+}
+
+/* report bytes moved and throughput of each stage of the pipeline,
+ * the slowest stage bounds the speed of the broadcast */
+static void report_stats(const bcast_stats* stats)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    uint64_t bytes[3] = {stats->read_bytes, stats->bcast_bytes, stats->write_bytes};
+    double secs[3] = {stats->read_secs, stats->bcast_secs, stats->write_secs};
+    uint64_t all_bytes[3];
+    double all_secs[3];
+    MPI_Reduce(bytes, all_bytes, 3, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(secs, all_secs, 3, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    uint64_t all_skip_bytes;
+    MPI_Reduce((void*) &stats->skip_bytes, &all_skip_bytes, 1, MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    if (rank == 0) {
+        const char* names[3] = {"Read", "Bcast", "Write"};
+        int i;
+        for (i = 0; i < 3; i++) {
+            double mb = (double) all_bytes[i] / (1024.0 * 1024.0);
+            double rate = (all_secs[i] > 0.0) ? mb / all_secs[i] : 0.0;
+            MFU_LOG(MFU_LOG_INFO, "%s stage: %f MB, busy=%f secs, speed=%f MB/sec",
+                names[i], mb, all_secs[i], rate
+            );
+        }
+        if (all_skip_bytes > 0) {
+            MFU_LOG(MFU_LOG_INFO, "Skipped %f MB that matched existing copies",
+                (double) all_skip_bytes / (1024.0 * 1024.0)
+            );
+        }
+    }
+}
+
 int mkdirp(const char* path)
 {
     /* assume we'll succeed */
@@ -466,7 +1534,10 @@ static void print_usage(void)
     printf("Usage: dbcast [options] <SRC> <DEST>\n");
     printf("\n");
     printf("Options:\n");
+    printf("  -i, --input <FILE> - broadcast items under SRC listed in FILE\n");
     printf("  -s, --size <SIZE>  - block size to divide files (default 1MB)\n");
+    printf("  -c, --chunk <SIZE> - size of each read, send, and write (default 1MB)\n");
+    printf("  -D, --depth <N>    - number of chunk buffers per reader (default 4)\n");
     printf("  -h, --help         - print usage\n");
     printf("For more information see https://mpifileutils.readthedocs.io.");
     printf("\n");
@@ -501,19 +1572,36 @@ int main (int argc, char *argv[])
     /* TODO: set this to size of lustre stripe of the file/system */
     uint64_t stripe_size = 1024 * 1024;
 
+    /* size of a single read from the input file, which should be
+     * efficient as a single read but small enough to send via MPI */
+    size_t chunk_size = 1024 * 1024;
+
+    /* number of chunk buffers in the pipeline of each reader,
+     * two buffers keep data moving between nodes, more let reads
+     * and writes run ahead of the data moving between nodes */
+    int depth = 4;
+
+    /* file list to read instead of walking a source directory */
+    char* input_file = NULL;
+
     /* process any options */
     int option_index = 0;
     static struct option long_options[] = {
         {"size",         1, 0, 's'},
+        {"chunk",        1, 0, 'c'},
+        {"depth",        1, 0, 'D'},
+        {"input",        1, 0, 'i'},
         {"help",         0, 0, 'h'},
         {0, 0, 0, 0}
     };
 
     unsigned long long byte_val;
+    long long_val;
+    char* endptr = NULL;
     int usage = 0;
     while (1) {
         int c = getopt_long(
-                    argc, argv, "s:h",
+                    argc, argv, "s:c:D:i:h",
                     long_options, &option_index
                 );
 
@@ -532,6 +1620,36 @@ int main (int argc, char *argv[])
                 }
                 stripe_size = (uint64_t) byte_val;
                 break;
+            case 'c':
+                /* parse chunk_size from command line */
+                if (mfu_abtoull(optarg, &byte_val) != MFU_SUCCESS) {
+                    if (rank == 0) {
+                        MFU_LOG(MFU_LOG_ERR, "Failed to parse chunk size: %s", optarg);
+                    }
+                    usage = 1;
+                }
+                chunk_size = (size_t) byte_val;
+                break;
+            case 'D':
+                /* each reader sends from one buffer while it receives
+                 * into another, so it needs at least two */
+                errno = 0;
+                long_val = strtol(optarg, &endptr, 10);
+                if (errno != 0 || endptr == optarg || *endptr != '\0' ||
+                    long_val < 2 || long_val > INT_MAX)
+                {
+                    if (rank == 0) {
+                        MFU_LOG(MFU_LOG_ERR, "Failed to parse pipeline depth, expected a count of at least 2: '%s'", optarg);
+                    }
+                    usage = 1;
+                    break;
+                }
+                depth = (int) long_val;
+                break;
+            case 'i':
+                mfu_free(&input_file);
+                input_file = MFU_STRDUP(optarg);
+                break;
             case 'h':
                 usage = 1;
                 break;
@@ -545,6 +1663,22 @@ int main (int argc, char *argv[])
         }
     }
 
+    /* writers use O_DIRECT, which needs full blocks, and every chunk
+     * but the last must be full, so chunks must evenly divide stripes */
+    if (!usage) {
+        if (chunk_size == 0 || chunk_size % 4096 != 0 || chunk_size > (size_t) INT_MAX) {
+            if (rank == 0) {
+                MFU_LOG(MFU_LOG_ERR, "Chunk size must be a multiple of 4KB and less than 2GB");
+            }
+            usage = 1;
+        } else if (stripe_size == 0 || stripe_size % (uint64_t) chunk_size != 0) {
+            if (rank == 0) {
+                MFU_LOG(MFU_LOG_ERR, "Block size must be a multiple of the chunk size");
+            }
+            usage = 1;
+        }
+    }
+
     /* need source and destination file names */
     if (!usage && (argc - optind) < 2) {
         MFU_LOG(MFU_LOG_ERR, "Failed to find source and/or destination file names");
@@ -648,12 +1782,26 @@ int main (int argc, char *argv[])
         return 0;
     }
 
+    /* a source directory, or a list of items, is broadcast as a tree */
+    int is_dir = 0;
+    if (rank == 0) {
+        struct stat src_stat;
+        if (stat(in_file_path, &src_stat) == 0 && S_ISDIR(src_stat.st_mode)) {
+            is_dir = 1;
+        }
+    }
+    MPI_Bcast(&is_dir, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    int is_tree = (is_dir || input_file != NULL);
+
     /* create destination directory (if needed) */
     int mkdir_rc = 0;
     if (rank == 0) {
         MFU_LOG(MFU_LOG_INFO, "Creating destination directories for `%s`", out_file_path);
     }
-    if (node_rank == 0) {
+    if (node_rank == 0 && is_tree) {
+        /* make the destination directory itself */
+        mkdir_rc = mkdirp(out_file_path);
+    } else if (node_rank == 0) {
         /* define path to destination file */
         mfu_path* parent_path = mfu_path_from_str(out_file_path);
         mfu_path_dirname(parent_path);
@@ -678,22 +1826,24 @@ int main (int argc, char *argv[])
     }
     MPI_Barrier(MPI_COMM_WORLD);
 
-    /* TODO: set this to a value which is efficient as a single read
-     * from Lustre but small enough to send via MPI */
-    size_t chunk_size = 1*1024*1024;
+    /* gather list of items to broadcast on all procs */
+    bcast_tree* tree = NULL;
+    if (is_tree) {
+        tree = tree_build(in_file_path, out_file_path, input_file, node_comm, level_comm);
+    }
 
     size_t alignment = 1024*1024;
 
     /* we'll create multiple shared memory segments,
-     * two for each reader process */
-    int bufcounts = (node_size - 1) * 2;
+     * depth for each reader process */
+    int bufcounts = (node_size - 1) * depth;
     void** shmbuf_base = (void**) malloc(bufcounts * sizeof(void*));
     void** shmbuf      = (void**) malloc(bufcounts * sizeof(void*));
 
     /* initialize our shared memory pointers */
     int i;
     for (i = 0; i < bufcounts; i++) {
-        /* allocate memory (two buffers for each reader) */
+        /* allocate memory (depth buffers for each reader) */
         shmbuf_base[i] = GCS_Shmem_alloc(chunk_size + alignment, node_comm);
 
         /* align buffers */
@@ -703,10 +1853,13 @@ int main (int argc, char *argv[])
     }
 
     /* rank 0 reads flie size and mode */
-    int mode;
-    uint64_t file_size;
+    int mode = 0;
+    uint64_t file_size = 0;
     const char *time_format = "%b %d %T";
-    if (rank == 0) {
+    if (tree != NULL) {
+        /* the data of all files of the tree is moved as a single stream */
+        file_size = tree->bytes;
+    } else if (rank == 0) {
         /* post message to user about the file we're bcasting */
         MFU_LOG(MFU_LOG_INFO, "Broadcasting contents of `%s` to `%s`", in_file_path, out_file_path);
 
@@ -739,10 +1892,36 @@ int main (int argc, char *argv[])
      * each node) */
     int reader_rank = level_rank * (node_size - 1) + (node_rank - 1);
 
+    /* size of any copy of the file that's already on the node */
+    uint64_t existing_file_size = 0;
+
     /* rank 0 on each node will write file, others will read from input */
-    if (node_rank == 0) {
+    if (tree != NULL) {
+        /* all procs on the node create the items of the tree */
+        if (tree_create(tree, node_comm) != 0) {
+            write_error = 1;
+        }
+
+        /* check whether we have space to write the files */
+        if (node_rank == 0 && !write_error) {
+            errno = 0;
+            uint64_t free_size = 0;
+            struct statfs fs_stat;
+            if (statfs(out_file_path, &fs_stat) == 0) {
+                free_size = (uint64_t)fs_stat.f_bavail * (uint64_t)fs_stat.f_bsize;
+            } else {
+                MFU_LOG(MFU_LOG_ERR, "Failed to stat file system for `%s` (%s)", out_file_path, strerror(errno));
+            }
+
+            /* files were created at full size, but most file systems
+             * don't allocate blocks until data is written */
+            if (file_size > free_size) {
+                MFU_LOG(MFU_LOG_ERR, "Insufficient space for `%s` size=%llu free=%llu", out_file_path, file_size, free_size);
+                write_error = 1;
+            }
+        }
+    } else if (node_rank == 0) {
         /* open file for differently depending on whether it already exists */
-        uint64_t existing_file_size = 0;
         if (mfu_access(out_file_path, F_OK) == 0) {
             /* record that file already exists */
             file_exists = 1;
@@ -824,6 +2003,34 @@ int main (int argc, char *argv[])
 
     double time_start = MPI_Wtime();
 
+    /* when nodes already hold a copy of the file, only send the blocks
+     * that differ, and only to the nodes that need them */
+    bcast_skip* skip = NULL;
+    uint64_t stream_size = file_size;
+    MPI_Comm ring_comm = level_comm;
+    if (tree == NULL) {
+        int has_copy = (node_rank == 0 && file_exists && out_file >= 0);
+        skip = skip_plan(
+            in_file_path, in_file, out_file_path, file_size, chunk_size,
+            has_copy, existing_file_size, write_error, node_comm, reader_rank, reader_size
+        );
+    }
+    if (skip != NULL) {
+        /* form a ring of the nodes that need any block, with the
+         * blocks to send laid end to end in place of the file */
+        MPI_Comm_split(level_comm, skip->active ? 0 : MPI_UNDEFINED, level_rank, &ring_comm);
+        if (skip->active) {
+            MPI_Comm_rank(ring_comm, &level_rank);
+            MPI_Comm_size(ring_comm, &level_size);
+            stream_size = skip->bytes;
+        } else {
+            /* nothing to do on this node */
+            stream_size = 0;
+        }
+        reader_size = level_size * (node_size - 1);
+        reader_rank = level_rank * (node_size - 1) + (node_rank - 1);
+    }
+
     /* compute rank on left side */
     int left = level_rank - 1;
     if (left < 0) {
@@ -836,250 +2043,229 @@ int main (int argc, char *argv[])
       right = 0;
     }
 
+/* number of rounds needed to move the whole file, each round moves
+ * one chunk from every reader to every node */
+uint64_t chunks_per_stripe = stripe_size / (uint64_t) chunk_size;
+uint64_t stripe_bytes = stripe_size * (uint64_t) reader_size;
+uint64_t rounds = (stream_size + stripe_bytes - 1) / stripe_bytes * chunks_per_stripe;
+
+/* time spent and bytes moved in each stage */
+bcast_stats stats;
+memset(&stats, 0, sizeof(stats));
+if (skip != NULL && node_rank == 0) {
+    stats.skip_bytes = skip->matched;
+}
+
 /* readers */
 if (node_rank != 0) {
-    /* read back parts of output file and broadcast */
-    MPI_Request request[3];
-    MPI_Status  status[3];
-    size_t bytes_read = 0;
-    while (bytes_read < file_size) {
-        /* process series of chunks in this stripe */
-        uint64_t chunk_id = 0;
-        uint64_t stripe_read = 0;
-        while (stripe_read < stripe_size) {
-            /* we'll send from buf1 and receive into buf2,
-             * read data from file into buf1 to begin */
-            int shmid = (node_rank - 1) * 2;
-            void* buf1 = shmbuf[shmid + 0];
-            void* buf2 = shmbuf[shmid + 1];
-
-            /* get offset and size of bytes to read */
+    /* each buffer is filled by reading from the input file or by
+     * receiving from the right, and it is then sent to the left and
+     * queued at the writer at the same time, while data moves between
+     * nodes, we read our chunk for the next round into a free buffer,
+     * so reads, sends, and writes of different chunks overlap */
+    bcast_pool pool;
+    pool_init(&pool, (node_rank - 1) * depth, depth, node_comm);
+
+    MPI_Request request[2];
+    MPI_Status  status[2];
+    int next_shmid = -1;
+    size_t next_size = 0;
+    uint64_t round;
+    for (round = 0; round < rounds; round++) {
+        /* get our own chunk for this round, unless we read it ahead */
+        int shmid = next_shmid;
+        size_t size1 = next_size;
+        if (shmid < 0) {
+            shmid = pool_get(&pool);
             off_t pos1;
-            size_t size1;
-            compute_offset_size(
-                bytes_read, stripe_read, file_size, stripe_size, chunk_size, reader_rank, chunk_id,
+            compute_round_offset_size(
+                round, stream_size, stripe_size, chunk_size, reader_size, reader_rank,
                 &pos1, &size1
             );
+            pos1 = skip_file_pos(skip, pos1);
+            read_chunk(tree, in_file_path, in_file, shmbuf[shmid], pos1, size1, &stats);
+        }
+        next_shmid = -1;
+
+        /* we send data to the left and receive from the right until
+         * we've received and written all data for this chunk */
+        int lev;
+        for (lev = 1; lev < level_size; lev++) {
+            /* determine source of data we'll receive in this step */
+            int lev_incoming = level_rank + lev;
+            if (lev_incoming >= level_size) {
+                lev_incoming -= level_size;
+            }
+            int read_rank_incoming = lev_incoming * (node_size - 1) + (node_rank - 1);
+
+            /* get offset and size of incoming data */
+            off_t pos2;
+            size_t size2;
+            compute_round_offset_size(
+                round, stream_size, stripe_size, chunk_size, reader_size, read_rank_incoming,
+                &pos2, &size2
+            );
 
-            /* seek to offset in input file */
-            if (size1 > 0) {
-                errno = 0;
-                off_t rc = mfu_lseek(in_file_path, in_file, pos1, SEEK_SET);
-                if (rc == (off_t)-1) {
-                    MFU_LOG(MFU_LOG_ERR, "Seek failed on file `%s` (%s)", out_file_path, strerror(errno));
-                    file_bcast_exit();
-                }
-
-                /* read chunk from file */
-                errno = 0;
-                ssize_t return_size = mfu_read(in_file_path, in_file, buf1, size1);
-                if (return_size != (ssize_t)size1) {
-                    MFU_LOG(MFU_LOG_ERR, "Failed to read contents from `%s` (%s)", out_file_path, strerror(errno));
-                    file_bcast_exit();
-                }
+            /* get a buffer to receive into, and one to read ahead into
+             * if it's free already, before we queue the buffer we send
+             * from, since the writer may return it before the send is done */
+            int recv_shmid = pool_get(&pool);
+            int read_ahead = 0;
+            if (next_shmid < 0 && round + 1 < rounds) {
+                next_shmid = pool_try_get(&pool);
+                read_ahead = (next_shmid >= 0);
             }
 
-            /* we send data to the left and receive from the right until
-             * we've received and written all data for this chunk */
-            int lev;
-            for (lev = 1; lev < level_size; lev++) {
-                /* determine source of data we'll receive in this step */
-                int lev_incoming = level_rank + lev;
-                if (lev_incoming >= level_size) {
-                    lev_incoming -= level_size;
-                }
-                int read_rank_incoming = lev_incoming * (node_size - 1) + (node_rank - 1);
-
-                /* get offset and size of incoming data */
-                off_t pos2;
-                size_t size2;
-                compute_offset_size(
-                    bytes_read, stripe_read, file_size, stripe_size, chunk_size, read_rank_incoming, chunk_id,
-                    &pos2, &size2
-                );
+            /* hand our buffer to the writer on same node */
+            pool_queue(&pool, shmid);
 
-                /* signal writer that our buffer is ready */
-                MPI_Send(&shmid, 1, MPI_INT, 0, 0, node_comm);
-
-                /* receieve data from right, send data to left,
-                 * and send data to writer on same node */
-                MPI_Irecv(buf2, (int) size2, MPI_BYTE, right, 0, level_comm, &request[0]);
-                MPI_Isend(buf1, (int) size1, MPI_BYTE, left,  0, level_comm, &request[1]);
-                MPI_Waitall(2, request, status);
-
-                /* wait for signal from writer to know that it's
-                 * finished with our buffer */
-                MPI_Recv(&shmid, 1, MPI_INT, 0, 0, node_comm, &status[0]);
-
-                /* swap buffers to send data we just received */
-                size1 = size2;
-                char* buftmp = buf1;
-                buf1 = buf2;
-                buf2 = buftmp;
-                shmid = (shmid & 0x1) ? (shmid - 1) : (shmid + 1);
-            }
+            /* receieve data from right, send data to left */
+            MPI_Irecv(shmbuf[recv_shmid], (int) size2, MPI_BYTE, right, 0, ring_comm, &request[0]);
+            MPI_Isend(shmbuf[shmid],      (int) size1, MPI_BYTE, left,  0, ring_comm, &request[1]);
 
-            /* signal writer that our buffer is ready */
-            MPI_Send(&shmid, 1, MPI_INT, 0, 0, node_comm);
+            /* read our chunk of the next round while data moves */
+            if (read_ahead) {
+                off_t next_pos;
+                compute_round_offset_size(
+                    round + 1, stream_size, stripe_size, chunk_size, reader_size, reader_rank,
+                    &next_pos, &next_size
+                );
+                next_pos = skip_file_pos(skip, next_pos);
+                read_chunk(tree, in_file_path, in_file, shmbuf[next_shmid], next_pos, next_size, &stats);
+            }
 
-            /* wait for signal from writer to know that it's
-             * finished with our buffer */
-            MPI_Recv(&shmid, 1, MPI_INT, 0, 0, node_comm, &status[0]);
+            double wait_start = MPI_Wtime();
+            MPI_Waitall(2, request, status);
+            stats.bcast_secs  += MPI_Wtime() - wait_start;
+            stats.bcast_bytes += (uint64_t) size2;
 
-            /* go on to next chunk */
-            stripe_read += chunk_size;
-            chunk_id++;
+            /* send data we just received in the next step */
+            shmid = recv_shmid;
+            size1 = size2;
         }
 
-        /* record total number of bytes processed, the last set of stripes may
-         * not be full but that doesn't matter in this accounting */
-        bytes_read += stripe_size * (uint64_t)reader_size;
+        /* hand the last buffer of this round to the writer */
+        pool_queue(&pool, shmid);
     }
+
+    /* wait for the writer to finish with all of our buffers */
+    pool_fini(&pool);
 }
 
 /* writers */
 if (node_rank == 0) {
     double percent = 2.0;
-    char* readbuf = (char*) malloc(chunk_size);
 //    shmbuf[i] = (char*)base + alignment - ((uint64_t)base & (alignment - 1)) ;
 
     /* read back parts of output file and broadcast */
-    MPI_Request request[2];
     MPI_Status  status[2];
     size_t bytes_read = 0;
-    while (bytes_read < file_size) {
-        /* iterate over all procs on the node,
-         * we process a full stripe one level at at time */
-            /* process series of chunks in this stripe */
-            uint64_t chunk_id = 0;
-            uint64_t stripe_read = 0;
-            while (stripe_read < stripe_size) {
-                /* process this portion of the stripe for all procs at this level */
-                int lev;
-                for (lev = 0; lev < level_size; lev++) {
-                int node;
-                for (node = 1; node < node_size; node++) {
-                    /* determine source of data we'll receive in this step */
-                    int lev_incoming = level_rank + lev;
-                    if (lev_incoming >= level_size) {
-                        lev_incoming -= level_size;
+    uint64_t round;
+    for (round = 0; round < rounds; round++) {
+        /* process this portion of the stripe for all procs at this level */
+        int lev;
+        for (lev = 0; lev < level_size; lev++) {
+            int node;
+            for (node = 1; node < node_size; node++) {
+                /* determine source of data we'll receive in this step */
+                int lev_incoming = level_rank + lev;
+                if (lev_incoming >= level_size) {
+                    lev_incoming -= level_size;
+                }
+                int read_rank_incoming = lev_incoming * (node_size - 1) + (node - 1);
+
+                /* get offset and size of bytes for this reader */
+                off_t pos;
+                size_t size;
+                compute_round_offset_size(
+                    round, stream_size, stripe_size, chunk_size, reader_size, read_rank_incoming,
+                    &pos, &size
+                );
+
+                /* wait for node to signal us */
+                int shmid;
+                MPI_Recv(&shmid, 1, MPI_INT, node, 0, node_comm, &status[0]);
+
+                /* determine buffer to write data from */
+                void* copybuf = shmbuf[shmid];
+
+                /* write data to file */
+                double write_start = MPI_Wtime();
+                if (size > 0 && tree != NULL) {
+                    /* write data to the files of the tree */
+                    stats.write_bytes += (uint64_t) size;
+                    if (!write_error && tree_write(tree, (const char*) copybuf, (uint64_t) pos, size) != 0) {
+                        write_error = 1;
+                    }
+                } else if (size > 0) {
+                    /* assume that we'll be writing data */
+                    int write_data = 1;
+
+                    /* skip blocks that match the copy already on this node,
+                     * which other nodes need */
+                    pos = skip_file_pos(skip, pos);
+                    if (skip != NULL && ! skip->need[(uint64_t) pos / chunk_size]) {
+                        write_data = 0;
                     }
-                    int read_rank_incoming = lev_incoming * (node_size - 1) + (node - 1);
-
-                    /* get offset and size of bytes for this reader */
-                    off_t pos;
-                    size_t size;
-                    compute_offset_size(
-                        bytes_read, stripe_read, file_size, stripe_size, chunk_size, read_rank_incoming, chunk_id,
-                        &pos, &size
-                    );
-
-                    /* wait for node to signal us */
-                    int shmid;
-                    MPI_Recv(&shmid, 1, MPI_INT, node, 0, node_comm, &status[0]);
-
-                    /* determine buffer to write data from */
-                    void* copybuf = shmbuf[shmid];
-
-                    /* write data to file */
-                    if (size > 0) {
-                        /* assume that we'll be writing data */
-                        int write_data = 1;
-
-                        /* if the file already exists, read in this segment and compare
-                         * it to what we should be writing */
-                        if (file_exists) {
-                            /* file exists, now assume it's the same content so that
-                             * we don't need to write this data */
-                            write_data = 0;
-
-                            /* seek to offset in output file */
-                            errno = 0;
-                            int rc = mfu_lseek(out_file_path, out_file, pos, SEEK_SET);
-                            if (rc == (off_t)-1) {
-                                /* consider this a write error since we can't read
-                                 * to determine whether we need to write */
-                                MFU_LOG(MFU_LOG_ERR, "Seek failed on file `%s` (%s)", out_file_path, strerror(errno));
-                                write_error = 1;
-                            }
 
-                            /* read chunk from file */
-                            errno = 0;
-                            ssize_t return_size = mfu_read(out_file_path, out_file, readbuf, size);
-                            if (return_size == (ssize_t)size) {
-                                /* we read the correct number of bytes, now compare them */
-                                if (memcmp(readbuf, copybuf, size) != 0) {
-                                    /* found a difference so overwrite existing data */
-                                    write_data = 1;
-                                }
-                            } else {
-                                /* overwrite data if we got a short read or end of file,
-                                 * otherwise, we got a read error  */
-                                if (return_size >= 0) {
-                                    write_data = 1;
-                                } else {
-                                    /* consider this a write error since we can't read
-                                     * to determine whether we need to write */
-                                    MFU_LOG(MFU_LOG_ERR, "Failed to read from existing file `%s` (%s)", out_file_path, strerror(errno));
-                                    write_error = 1;
-                                }
-                            }
-                        }
+                    /* write data to output file */
+                    if (write_data && !write_error) {
+                        stats.write_bytes += (uint64_t) size;
 
-                        /* write data to output file */
-                        if (write_data && !write_error) {
-                            /* seek to offset in output file */
-                            errno = 0;
-                            int rc = mfu_lseek(out_file_path, out_file, pos, SEEK_SET);
-                            if (rc == (off_t)-1) {
-                                MFU_LOG(MFU_LOG_ERR, "Seek failed on file `%s` (%s)", out_file_path, strerror(errno));
-                                write_error = 1;
-                            }
+                        /* seek to offset in output file */
+                        errno = 0;
+                        int rc = mfu_lseek(out_file_path, out_file, pos, SEEK_SET);
+                        if (rc == (off_t)-1) {
+                            MFU_LOG(MFU_LOG_ERR, "Seek failed on file `%s` (%s)", out_file_path, strerror(errno));
+                            write_error = 1;
+                        }
 
-                            /* to use O_DIRECT, we have to write in full blocks */
-                            if (size != chunk_size) {
-                                if (pos + size < file_size) {
-                                    /* this is bad, so consider it to be fatal */
-                                    MFU_LOG(MFU_LOG_ERR, "Trying to write past end of chunk in middle block `%s`", out_file_path);
-                                    file_bcast_exit();
-                                }
-                                size = chunk_size;
+                        /* to use O_DIRECT, we have to write in full blocks */
+                        if (size != chunk_size) {
+                            if (pos + size < file_size) {
+                                /* this is bad, so consider it to be fatal */
+                                MFU_LOG(MFU_LOG_ERR, "Trying to write past end of chunk in middle block `%s`", out_file_path);
+                                file_bcast_exit();
                             }
+                            size = chunk_size;
+                        }
 
-                            /* write chunk to output file */
-                            errno = 0;
-                            ssize_t return_size = mfu_write(out_file_path, out_file, copybuf, size);
-                            if (return_size == -1) {
-                                /* remember that we had a write error,
-                                 * we'll keep going and delete the
-                                 * file at the end */
-                                MFU_LOG(MFU_LOG_ERR, "Failed to write contents to `%s` (%s)", out_file_path, strerror(errno));
-                                write_error = 1;
-                            }
+                        /* write chunk to output file */
+                        errno = 0;
+                        ssize_t return_size = mfu_write(out_file_path, out_file, copybuf, size);
+                        if (return_size == -1) {
+                            /* remember that we had a write error,
+                             * we'll keep going and delete the
+                             * file at the end */
+                            MFU_LOG(MFU_LOG_ERR, "Failed to write contents to `%s` (%s)", out_file_path, strerror(errno));
+                            write_error = 1;
                         }
                     }
-
-                    /* signal node that we're finished */
-                    MPI_Send(&shmid, 1, MPI_INT, node, 0, node_comm);
-                }
                 }
 
-                /* go on to next chunk */
-                stripe_read += chunk_size;
-                chunk_id++;
+                stats.write_secs += MPI_Wtime() - write_start;
+
+                /* signal node that we're finished */
+                MPI_Send(&shmid, 1, MPI_INT, node, 0, node_comm);
             }
+        }
+
+        /* go on to next chunk, unless we just finished a set of stripes */
+        if ((round + 1) % chunks_per_stripe != 0) {
+            continue;
+        }
 
         /* record total number of bytes processed, the last set of stripes may
          * not be full but that doesn't matter in this accounting */
-        bytes_read += stripe_size * (uint64_t)reader_size;
+        bytes_read += stripe_bytes;
         if (rank == 0) {
-            size_t report_read = (bytes_read < file_size) ? bytes_read: file_size;
-            double percent_read = ((double)(report_read) / (double)(file_size)) * 100.0;
+            size_t report_read = (bytes_read < stream_size) ? bytes_read: stream_size;
+            double percent_read = ((double)(report_read) / (double)(stream_size)) * 100.0;
             if (percent_read >= percent) {
                 double time_end = MPI_Wtime();
                 double time_diff = time_end - time_start;
                 double rate = (double)report_read / (time_diff * 1024.0 * 1024.0);
-                double time_remaining = ((double)(file_size - report_read)) / (rate * 1024.0 * 1024.0);
+                double time_remaining = ((double)(stream_size - report_read)) / (rate * 1024.0 * 1024.0);
                 MFU_LOG(MFU_LOG_INFO, "Progress: %0.1f%% %f MB/s %0.1f secs remaining",
                     percent_read, rate, time_remaining
                 );
@@ -1091,14 +2277,19 @@ if (node_rank == 0) {
             }
         }
     }
-
-    free(readbuf);
 }
 
     MPI_Barrier(MPI_COMM_WORLD);
 
     /* every rank closes output file */
-    if (node_rank == 0) {
+    if (tree != NULL) {
+        /* close files and set metadata of all items, on failure we
+         * leave items in place, since other items may be complete */
+        tree_close(tree);
+        if (tree_finish(tree, node_comm) != 0) {
+            write_error = 1;
+        }
+    } else if (node_rank == 0) {
         /* if we have a file open, sync and close it */
         if (out_file >= 0) {
             errno = 0;
@@ -1153,6 +2344,7 @@ if (node_rank == 0) {
             (unsigned long long) file_size, time_diff, (double) file_size / (time_diff * 1024.0 * 1024.0)
         );
     }
+    report_stats(&stats);
 
     MPI_Barrier(MPI_COMM_WORLD);
 
@@ -1168,7 +2360,20 @@ if (node_rank == 0) {
         GCS_Shmem_free(shmbuf_base[i], node_comm);
     }
 
+    if (tree != NULL) {
+        tree_free(&tree);
+    }
+
+    /* free ring of nodes that needed blocks */
+    if (skip != NULL) {
+        if (ring_comm != MPI_COMM_NULL) {
+            MPI_Comm_free(&ring_comm);
+        }
+        skip_free(&skip);
+    }
+
     /* free paths */
+    mfu_free(&input_file);
     mfu_free(&out_file_path);
     mfu_free(&in_file_path);
 
@@ -17,7 +17,6 @@
 #include <assert.h>
 
 #include "mfu.h"
-#include "strmap.h"
 #include "list.h"
 
 /* Print a usage message */
@@ -25,15 +24,20 @@ static void print_usage(void)
 {
     printf("\n");
     printf("Usage: dcmp [options] source target\n");
+    printf("       dcmp [options] --src-cache <FILE> --dst-cache <FILE>\n");
     printf("\n");
     printf("Options:\n");
     printf("  -o, --output <EXPR:FILE>  - write list of entries matching EXPR to FILE\n");
+    printf("      --src-cache <FILE>    - read source list from cache FILE instead of walking source\n");
+    printf("      --dst-cache <FILE>    - read target list from cache FILE instead of walking target\n");
     printf("  -t, --text                - change output option to write in text format\n");
     printf("  -b, --base                - enable base checks and normal output with --output\n");
     printf("      --progress <N>        - print progress every N seconds\n");
     printf("  -v, --verbose             - verbose output\n");
     printf("  -q, --quiet               - quiet output\n");
     printf("  -l, --lite                - only compares file modification time and size\n");
+    printf("      --sort-join           - match items by sorting both lists instead of hashing\n");
+    printf("      --hash-store <FILE>   - reuse block hashes from FILE for unchanged files and update it\n");
     //printf("  -d, --debug               - run in debug mode\n");
     printf("  -h, --help                - print usage\n");
     printf("\n");
@@ -83,7 +87,7 @@ typedef enum _dcmp_state {
       * This file only exist in dest directory.
       * Only valid for DCMPF_EXIST.
       * Not used yet,
-      * becuase we don't want to waste a loop in dcmp_strmap_compare()
+      * becuase we don't want to waste a loop in dcmp_map_compare()
       */
     DCMPS_ONLY_DEST,
 
@@ -164,6 +168,10 @@ struct dcmp_options {
     int format;			   /* output data format, 0 for text, 1 for raw */
     int base;                      /* whether to do base check */
     int debug;                     /* check result after get result */
+    int sort_join;                 /* match items with a sort-merge join */
+    char* src_cache;               /* cache file to read source list from */
+    char* dst_cache;               /* cache file to read target list from */
+    char* hash_store;              /* file to read and write block hashes */
     int need_compare[DCMPF_MAX];   /* fields that need to be compared  */
 };
 
@@ -175,6 +183,10 @@ struct dcmp_options options = {
     .format       = 1,
     .base         = 0,
     .debug        = 0,
+    .sort_join    = 0,
+    .src_cache    = NULL,
+    .dst_cache    = NULL,
+    .hash_store   = NULL,
     .need_compare = {0,}
 };
 
@@ -348,142 +360,36 @@ static int dcmp_state_from_string(const char* string, dcmp_state *state)
     return -ENOENT;
 }
 
-/* given a filename as the key, encode an index followed
- * by the init state */
-static void dcmp_strmap_item_init(
-    strmap* map,
-    const char *key,
-    uint64_t item_index)
-{
-    /* Should be long enough for 64 bit number and DCMPF_MAX */
-    char val[21 + DCMPF_MAX];
-    int i;
-
-    /* encode the index */
-    int len = snprintf(val, sizeof(val), "%llu",
-                       (unsigned long long) item_index);
-
-    /* encode the state (state characters and trailing NUL) */
-    assert((size_t)len + DCMPF_MAX + 1 <= (sizeof(val)));
-    size_t position = strlen(val);
-    for (i = 0; i < DCMPF_MAX; i++) {
-        val[position] = DCMPS_INIT;
-        position++;
-    }
-    val[position] = '\0';
-
-    /* add item to map */
-    strmap_set(map, key, val);
-}
-
-static void dcmp_strmap_item_update(
-    strmap* map,
-    const char *key,
+/* record state of a field for the item in the given slot of a map */
+static void dcmp_map_item_update(
+    mfu_itemmap* map,
+    uint64_t slot,
     dcmp_field field,
     dcmp_state state)
 {
-    /* Should be long enough for 64 bit number and DCMPF_MAX */
-    char new_val[21 + DCMPF_MAX];
-
-    /* lookup item from map */
-    const char* val = strmap_get(map, key);
-
-    /* copy existing index over */
     assert(field < DCMPF_MAX);
-    assert(strlen(val) + 1 <= sizeof(new_val));
-    strcpy(new_val, val);
-
-    /* set new state value */
-    size_t position = strlen(new_val) - DCMPF_MAX;
-    new_val[position + field] = state;
-
-    /* reinsert item in map */
-    strmap_set(map, key, new_val);
+    mfu_itemmap_set(map, slot, (int) field, (int) (state - DCMPS_INIT));
 }
 
-static int dcmp_strmap_item_index(
-    strmap* map,
-    const char *key,
-    uint64_t *item_index)
+/* return state of a field for the item in the given slot of a map */
+static dcmp_state dcmp_map_item_state(
+    const mfu_itemmap* map,
+    uint64_t slot,
+    dcmp_field field)
 {
-    /* Should be long enough for 64 bit number and DCMPF_MAX */
-    char new_val[21 + DCMPF_MAX];
-
-    /* lookup item from map */
-    const char* val = strmap_get(map, key);
-    if (val == NULL) {
-        return -1;
-    }
-
-    /* extract index */
-    assert(strlen(val) + 1 <= sizeof(new_val));
-    strcpy(new_val, val);
-    new_val[strlen(new_val) - DCMPF_MAX] = '\0';
-    *item_index = strtoull(new_val, NULL, 0);
-
-    return 0;
-}
-
-static int dcmp_strmap_item_state(
-    strmap* map,
-    const char *key,
-    dcmp_field field,
-    dcmp_state *state)
-{
-    /* lookup item from map */
-    const char* val = strmap_get(map, key);
-    if (val == NULL) {
-        return -1;
-    }
-
-    /* extract state */
-    assert(strlen(val) > DCMPF_MAX);
     assert(field < DCMPF_MAX);
-    size_t position = strlen(val) - DCMPF_MAX;
-    *state = val[position + field];
-
-    return 0;
-}
-
-/* map each file name to its index in the file list and initialize
- * its state for comparison operation */
-static strmap* dcmp_strmap_creat(mfu_flist list, const char* prefix)
-{
-    /* create a new string map to map a file name to a string
-     * encoding its index and state */
-    strmap* map = strmap_new();
-
-    /* determine length of prefix string */
-    size_t prefix_len = strlen(prefix);
-
-    /* iterate over each item in the file list */
-    uint64_t i = 0;
-    uint64_t count = mfu_flist_size(list);
-    while (i < count) {
-        /* get full path of file name */
-        const char* name = mfu_flist_file_get_name(list, i);
-
-        /* ignore prefix portion of path */
-        name += prefix_len;
-
-        /* create entry for this file */
-        dcmp_strmap_item_init(map, name, i);
-
-        /* go to next item in list */
-        i++;
-    }
-
-    return map;
+    return (dcmp_state) (DCMPS_INIT + mfu_itemmap_get(map, slot, (int) field));
 }
 
 static void dcmp_compare_acl(
-    const char *key,
     mfu_flist src_list,
     uint64_t src_index,
     mfu_flist dst_list,
     uint64_t dst_index,
-    strmap* src_map,
-    strmap* dst_map,
+    mfu_itemmap* src_map,
+    uint64_t src_slot,
+    mfu_itemmap* dst_map,
+    uint64_t dst_slot,
     int *diff)
 {
     void *src_val, *dst_val;
@@ -537,11 +443,11 @@ out:
 
 #endif
     if (is_same) {
-        dcmp_strmap_item_update(src_map, key, DCMPF_ACL, DCMPS_COMMON);
-        dcmp_strmap_item_update(dst_map, key, DCMPF_ACL, DCMPS_COMMON);
+        dcmp_map_item_update(src_map, src_slot, DCMPF_ACL, DCMPS_COMMON);
+        dcmp_map_item_update(dst_map, dst_slot, DCMPF_ACL, DCMPS_COMMON);
     } else {
-        dcmp_strmap_item_update(src_map, key, DCMPF_ACL, DCMPS_DIFFER);
-        dcmp_strmap_item_update(dst_map, key, DCMPF_ACL, DCMPS_DIFFER);
+        dcmp_map_item_update(src_map, src_slot, DCMPF_ACL, DCMPS_DIFFER);
+        dcmp_map_item_update(dst_map, dst_slot, DCMPF_ACL, DCMPS_DIFFER);
         (*diff)++;
     }
 }
@@ -554,15 +460,18 @@ static int dcmp_option_need_compare(dcmp_field field)
 /* Return -1 when error, return 0 when equal, return > 0 when diff */
 static int dcmp_compare_metadata(
     mfu_flist src_list,
-    strmap* src_map,
-    uint64_t src_index,
+    mfu_itemmap* src_map,
+    uint64_t src_slot,
     mfu_flist dst_list,
-    strmap* dst_map,
-    uint64_t dst_index,
-    const char* key)
+    mfu_itemmap* dst_map,
+    uint64_t dst_slot)
 {
     int diff = 0;
 
+    /* get index of item in each list */
+    uint64_t src_index = mfu_itemmap_index(src_map, src_slot);
+    uint64_t dst_index = mfu_itemmap_index(dst_map, dst_slot);
+
     if (dcmp_option_need_compare(DCMPF_SIZE)) {
         mfu_filetype type = mfu_flist_file_get_type(src_list, src_index);
         if (type != MFU_TYPE_DIR) {
@@ -570,16 +479,16 @@ static int dcmp_compare_metadata(
             uint64_t dst = mfu_flist_file_get_size(dst_list, dst_index);
             if (src != dst) {
                 /* file size is different */
-                dcmp_strmap_item_update(src_map, key, DCMPF_SIZE, DCMPS_DIFFER);
-                dcmp_strmap_item_update(dst_map, key, DCMPF_SIZE, DCMPS_DIFFER);
+                dcmp_map_item_update(src_map, src_slot, DCMPF_SIZE, DCMPS_DIFFER);
+                dcmp_map_item_update(dst_map, dst_slot, DCMPF_SIZE, DCMPS_DIFFER);
                 diff++;
              } else {
-                dcmp_strmap_item_update(src_map, key, DCMPF_SIZE, DCMPS_COMMON);
-                dcmp_strmap_item_update(dst_map, key, DCMPF_SIZE, DCMPS_COMMON);
+                dcmp_map_item_update(src_map, src_slot, DCMPF_SIZE, DCMPS_COMMON);
+                dcmp_map_item_update(dst_map, dst_slot, DCMPF_SIZE, DCMPS_COMMON);
              }
         } else {
-            dcmp_strmap_item_update(src_map, key, DCMPF_SIZE, DCMPS_COMMON);
-            dcmp_strmap_item_update(dst_map, key, DCMPF_SIZE, DCMPS_COMMON);
+            dcmp_map_item_update(src_map, src_slot, DCMPF_SIZE, DCMPS_COMMON);
+            dcmp_map_item_update(dst_map, dst_slot, DCMPF_SIZE, DCMPS_COMMON);
         }
     }
     if (dcmp_option_need_compare(DCMPF_GID)) {
@@ -587,12 +496,12 @@ static int dcmp_compare_metadata(
         uint64_t dst = mfu_flist_file_get_gid(dst_list, dst_index);
         if (src != dst) {
             /* file gid is different */
-            dcmp_strmap_item_update(src_map, key, DCMPF_GID, DCMPS_DIFFER);
-            dcmp_strmap_item_update(dst_map, key, DCMPF_GID, DCMPS_DIFFER);
+            dcmp_map_item_update(src_map, src_slot, DCMPF_GID, DCMPS_DIFFER);
+            dcmp_map_item_update(dst_map, dst_slot, DCMPF_GID, DCMPS_DIFFER);
              diff++;
         } else {
-            dcmp_strmap_item_update(src_map, key, DCMPF_GID, DCMPS_COMMON);
-            dcmp_strmap_item_update(dst_map, key, DCMPF_GID, DCMPS_COMMON);
+            dcmp_map_item_update(src_map, src_slot, DCMPF_GID, DCMPS_COMMON);
+            dcmp_map_item_update(dst_map, dst_slot, DCMPF_GID, DCMPS_COMMON);
         }
     }
     if (dcmp_option_need_compare(DCMPF_UID)) {
@@ -600,12 +509,12 @@ static int dcmp_compare_metadata(
         uint64_t dst = mfu_flist_file_get_uid(dst_list, dst_index);
         if (src != dst) {
             /* file uid is different */
-            dcmp_strmap_item_update(src_map, key, DCMPF_UID, DCMPS_DIFFER);
-            dcmp_strmap_item_update(dst_map, key, DCMPF_UID, DCMPS_DIFFER);
+            dcmp_map_item_update(src_map, src_slot, DCMPF_UID, DCMPS_DIFFER);
+            dcmp_map_item_update(dst_map, dst_slot, DCMPF_UID, DCMPS_DIFFER);
             diff++;
         } else {
-            dcmp_strmap_item_update(src_map, key, DCMPF_UID, DCMPS_COMMON);
-            dcmp_strmap_item_update(dst_map, key, DCMPF_UID, DCMPS_COMMON);
+            dcmp_map_item_update(src_map, src_slot, DCMPF_UID, DCMPS_COMMON);
+            dcmp_map_item_update(dst_map, dst_slot, DCMPF_UID, DCMPS_COMMON);
         }
     }
     if (dcmp_option_need_compare(DCMPF_ATIME)) {
@@ -615,12 +524,12 @@ static int dcmp_compare_metadata(
         uint64_t dst_atime_nsec = mfu_flist_file_get_atime_nsec(dst_list, dst_index);
         if ((src_atime != dst_atime) || (src_atime_nsec != dst_atime_nsec)) {
             /* file atime is different */
-            dcmp_strmap_item_update(src_map, key, DCMPF_ATIME, DCMPS_DIFFER);
-            dcmp_strmap_item_update(dst_map, key, DCMPF_ATIME, DCMPS_DIFFER);
+            dcmp_map_item_update(src_map, src_slot, DCMPF_ATIME, DCMPS_DIFFER);
+            dcmp_map_item_update(dst_map, dst_slot, DCMPF_ATIME, DCMPS_DIFFER);
             diff++;
         } else {
-            dcmp_strmap_item_update(src_map, key, DCMPF_ATIME, DCMPS_COMMON);
-            dcmp_strmap_item_update(dst_map, key, DCMPF_ATIME, DCMPS_COMMON);
+            dcmp_map_item_update(src_map, src_slot, DCMPF_ATIME, DCMPS_COMMON);
+            dcmp_map_item_update(dst_map, dst_slot, DCMPF_ATIME, DCMPS_COMMON);
         }
     }
     if (dcmp_option_need_compare(DCMPF_MTIME)) {
@@ -630,12 +539,12 @@ static int dcmp_compare_metadata(
         uint64_t dst_mtime_nsec = mfu_flist_file_get_mtime_nsec(dst_list, dst_index);
         if ((src_mtime != dst_mtime) || (src_mtime_nsec != dst_mtime_nsec)) {
             /* file mtime is different */
-            dcmp_strmap_item_update(src_map, key, DCMPF_MTIME, DCMPS_DIFFER);
-            dcmp_strmap_item_update(dst_map, key, DCMPF_MTIME, DCMPS_DIFFER);
+            dcmp_map_item_update(src_map, src_slot, DCMPF_MTIME, DCMPS_DIFFER);
+            dcmp_map_item_update(dst_map, dst_slot, DCMPF_MTIME, DCMPS_DIFFER);
             diff++;
         } else {
-            dcmp_strmap_item_update(src_map, key, DCMPF_MTIME, DCMPS_COMMON);
-            dcmp_strmap_item_update(dst_map, key, DCMPF_MTIME, DCMPS_COMMON);
+            dcmp_map_item_update(src_map, src_slot, DCMPF_MTIME, DCMPS_COMMON);
+            dcmp_map_item_update(dst_map, dst_slot, DCMPF_MTIME, DCMPS_COMMON);
         }
     }
     if (dcmp_option_need_compare(DCMPF_CTIME)) {
@@ -645,12 +554,12 @@ static int dcmp_compare_metadata(
         uint64_t dst_ctime_nsec = mfu_flist_file_get_ctime_nsec(dst_list, dst_index);
         if ((src_ctime != dst_ctime) || (src_ctime_nsec != dst_ctime_nsec)) {
             /* file ctime is different */
-            dcmp_strmap_item_update(src_map, key, DCMPF_CTIME, DCMPS_DIFFER);
-            dcmp_strmap_item_update(dst_map, key, DCMPF_CTIME, DCMPS_DIFFER);
+            dcmp_map_item_update(src_map, src_slot, DCMPF_CTIME, DCMPS_DIFFER);
+            dcmp_map_item_update(dst_map, dst_slot, DCMPF_CTIME, DCMPS_DIFFER);
             diff++;
         } else {
-            dcmp_strmap_item_update(src_map, key, DCMPF_CTIME, DCMPS_COMMON);
-            dcmp_strmap_item_update(dst_map, key, DCMPF_CTIME, DCMPS_COMMON);
+            dcmp_map_item_update(src_map, src_slot, DCMPF_CTIME, DCMPS_COMMON);
+            dcmp_map_item_update(dst_map, dst_slot, DCMPF_CTIME, DCMPS_COMMON);
         }
     }
     if (dcmp_option_need_compare(DCMPF_PERM)) {
@@ -658,18 +567,18 @@ static int dcmp_compare_metadata(
         uint64_t dst = mfu_flist_file_get_perm(dst_list, dst_index);
         if (src != dst) {
             /* file perm is different */
-            dcmp_strmap_item_update(src_map, key, DCMPF_PERM, DCMPS_DIFFER);
-            dcmp_strmap_item_update(dst_map, key, DCMPF_PERM, DCMPS_DIFFER);
+            dcmp_map_item_update(src_map, src_slot, DCMPF_PERM, DCMPS_DIFFER);
+            dcmp_map_item_update(dst_map, dst_slot, DCMPF_PERM, DCMPS_DIFFER);
             diff++;
         } else {
-            dcmp_strmap_item_update(src_map, key, DCMPF_PERM, DCMPS_COMMON);
-            dcmp_strmap_item_update(dst_map, key, DCMPF_PERM, DCMPS_COMMON);
+            dcmp_map_item_update(src_map, src_slot, DCMPF_PERM, DCMPS_COMMON);
+            dcmp_map_item_update(dst_map, dst_slot, DCMPF_PERM, DCMPS_COMMON);
         }
     }
     if (dcmp_option_need_compare(DCMPF_ACL)) {
-        dcmp_compare_acl(key, src_list,src_index,
+        dcmp_compare_acl(src_list, src_index,
                          dst_list, dst_index,
-                         src_map, dst_map, &diff);
+                         src_map, src_slot, dst_map, dst_slot, &diff);
     }
 
     return diff;
@@ -746,14 +655,55 @@ static void compare_progress_fn(const uint64_t* vals, int count, int complete, i
     }
 }
 
+/* given a flag for each file in the compare list, 0 if contents
+ * are the same and 1 if different, record the result in both maps */
+static void dcmp_map_set_content(
+    mfu_flist src_compare_list,
+    mfu_itemmap* src_map,
+    mfu_itemmap* dst_map,
+    size_t strlen_prefix,
+    const int* results)
+{
+    uint64_t i;
+    uint64_t size = mfu_flist_size(src_compare_list);
+    for (i = 0; i < size; i++) {
+        /* lookup name of file based on id to find its map slots */
+        const char* name = mfu_flist_file_get_name(src_compare_list, i);
+
+        /* ignore prefix portion of path to use as key */
+        name += strlen_prefix;
+
+        /* get slot of this item in source and destination maps */
+        uint64_t src_slot, dst_slot;
+        int src_rc = mfu_itemmap_lookup(src_map, name, &src_slot);
+        int dst_rc = mfu_itemmap_lookup(dst_map, name, &dst_slot);
+        assert(src_rc == 0 && dst_rc == 0);
+
+        /* get comparison results for this item */
+        int flag = results[i];
+
+        /* set flag in maps to record status of file */
+        if (flag != 0) {
+            /* update to say contents of the files were found to be different */
+            dcmp_map_item_update(src_map, src_slot, DCMPF_CONTENT, DCMPS_DIFFER);
+            dcmp_map_item_update(dst_map, dst_slot, DCMPF_CONTENT, DCMPS_DIFFER);
+
+        } else {
+            /* update to say contents of the files were found to be the same */
+            dcmp_map_item_update(src_map, src_slot, DCMPF_CONTENT, DCMPS_COMMON);
+            dcmp_map_item_update(dst_map, dst_slot, DCMPF_CONTENT, DCMPS_COMMON);
+        }
+    }
+}
+
 /* given a list of source/destination files to compare, spread file
  * sections to processes to compare in parallel, fill
  * in comparison results in source and dest string maps */
-static int dcmp_strmap_compare_data(
+static int dcmp_map_compare_data(
     mfu_flist src_compare_list,
-    strmap* src_map,
+    mfu_itemmap* src_map,
     mfu_flist dst_compare_list,
-    strmap* dst_map,
+    mfu_itemmap* dst_map,
     size_t strlen_prefix)
 {
     /* assume we'll succeed */
@@ -779,6 +729,9 @@ static int dcmp_strmap_compare_data(
      * to be used as input to logical OR to determine state of entire file */
     int* vals = (int*) MFU_MALLOC(list_count * sizeof(int));
 
+    /* offset of first byte that differs in each chunk, UINT64_MAX if none */
+    uint64_t* offsets = (uint64_t*) MFU_MALLOC(list_count * sizeof(uint64_t));
+
     /* start progress messages when comparing data */
     mfu_progress* prg = mfu_progress_start(mfu_progress_timeout, 2, MPI_COMM_WORLD, compare_progress_fn);
 
@@ -797,8 +750,9 @@ static int dcmp_strmap_compare_data(
 
         /* compare the contents of the files */
         int overwrite = 0;
+        off_t diff_offset;
         int compare_rc = mfu_compare_contents(src_p->name, dst_p->name, offset, length,
-                1048576, overwrite, &bytes_read, &bytes_written, prg);
+                1048576, overwrite, &bytes_read, &bytes_written, &diff_offset, prg);
         if (compare_rc == -1) {
             /* we hit an error while reading */
             rc = -1;
@@ -813,6 +767,7 @@ static int dcmp_strmap_compare_data(
 
         /* record results of comparison */
         vals[i] = compare_rc;
+        offsets[i] = (diff_offset == (off_t)-1) ? UINT64_MAX : (uint64_t)diff_offset;
 
         /* update pointers for src and dest in linked list */
         src_p = src_p->next;
@@ -832,32 +787,17 @@ static int dcmp_strmap_compare_data(
     /* execute logical OR over chunks for each file */
     mfu_file_chunk_list_lor(src_compare_list, src_head, vals, results);
 
-    /* unpack contents of recv buffer & store results in strmap */
-    for (i = 0; i < size; i++) {
-        /* lookup name of file based on id to send to strmap updata call */
-        const char* name = mfu_flist_file_get_name(src_compare_list, i);
-
-        /* ignore prefix portion of path to use as key */
-        name += strlen_prefix;
+    /* store results in maps */
+    dcmp_map_set_content(src_compare_list, src_map, dst_map, strlen_prefix, results);
 
-        /* get comparison results for this item */
-        int flag = results[i];
-
-        /* set flag in strmap to record status of file */
-        if (flag != 0) {
-            /* update to say contents of the files were found to be different */
-            dcmp_strmap_item_update(src_map, name, DCMPF_CONTENT, DCMPS_DIFFER);
-            dcmp_strmap_item_update(dst_map, name, DCMPF_CONTENT, DCMPS_DIFFER);
-
-        } else {
-            /* update to say contents of the files were found to be the same */
-            dcmp_strmap_item_update(src_map, name, DCMPF_CONTENT, DCMPS_COMMON);
-            dcmp_strmap_item_update(dst_map, name, DCMPF_CONTENT, DCMPS_COMMON);
-        }
+    /* report where each differing file first differs */
+    if (options.verbose) {
+        mfu_file_chunk_list_print_offsets(src_compare_list, src_head, offsets);
     }
 
     /* free memory */
     mfu_free(&results);
+    mfu_free(&offsets);
     mfu_free(&vals);
     mfu_file_chunk_list_free(&src_head);
     mfu_file_chunk_list_free(&dst_head);
@@ -871,7 +811,72 @@ static int dcmp_strmap_compare_data(
     return rc;
 }
 
-static void time_strmap_compare(mfu_flist src_list, double start_compare,
+/* like dcmp_map_compare_data, but compare digests from the block hash
+ * store, only files that have changed since the store was written are
+ * read and hashed, then write digests of all files back to the store,
+ * adds number of bytes read to bytes_read */
+static int dcmp_map_compare_hashes(
+    mfu_flist src_compare_list,
+    mfu_itemmap* src_map,
+    mfu_flist dst_compare_list,
+    mfu_itemmap* dst_map,
+    size_t strlen_prefix,
+    uint64_t* bytes_read)
+{
+    /* assume we'll succeed */
+    int rc = 0;
+
+    /* let user know what we're doing */
+    if (mfu_debug_level >= MFU_LOG_VERBOSE && mfu_rank == 0) {
+         MFU_LOG(MFU_LOG_INFO, "Comparing file contents using block hashes");
+    }
+
+    /* use the same block size as a regular compare */
+    uint64_t chunk_size = 1024 * 1024;
+    mfu_blockhash* bhs[2];
+    bhs[0] = mfu_blockhash_new(src_compare_list, chunk_size, MFU_DIGEST_MURMUR3);
+    bhs[1] = mfu_blockhash_new(dst_compare_list, chunk_size, MFU_DIGEST_MURMUR3);
+
+    /* pick up digests of files that have not changed, we can
+     * still compare everything by reading it if this fails */
+    mfu_blockhash_read(options.hash_store, 2, bhs);
+
+    /* hash files we have no digests for */
+    mfu_progress* prg = mfu_progress_start(mfu_progress_timeout, 2, MPI_COMM_WORLD, compare_progress_fn);
+    if (mfu_blockhash_compute(bhs[0], 1048576, bytes_read, prg) != 0) {
+        rc = -1;
+    }
+    if (mfu_blockhash_compute(bhs[1], 1048576, bytes_read, prg) != 0) {
+        rc = -1;
+    }
+    uint64_t count_bytes[2];
+    count_bytes[0] = *bytes_read;
+    count_bytes[1] = 0;
+    mfu_progress_complete(count_bytes, &prg);
+
+    /* files we failed to read lack digests, consider them
+     * to be different to draw attention to them */
+    uint64_t i;
+    uint64_t size = mfu_flist_size(src_compare_list);
+    int* results = (int*) MFU_MALLOC(size * sizeof(int));
+    for (i = 0; i < size; i++) {
+        results[i] = (mfu_blockhash_compare(bhs[0], i, bhs[1], i) != 0);
+    }
+
+    /* store results in maps */
+    dcmp_map_set_content(src_compare_list, src_map, dst_map, strlen_prefix, results);
+
+    /* save digests for the next run */
+    mfu_blockhash_write(options.hash_store, 2, bhs);
+
+    mfu_free(&results);
+    mfu_blockhash_delete(&bhs[1]);
+    mfu_blockhash_delete(&bhs[0]);
+
+    return rc;
+}
+
+static void time_map_compare(mfu_flist src_list, double start_compare,
                                 double end_compare, time_t *time_started,
                                 time_t *time_ended, uint64_t total_bytes_read) {
 
@@ -928,10 +933,10 @@ static void time_strmap_compare(mfu_flist src_list, double start_compare,
 }
 
 /* compare entries from src into dst */
-static int dcmp_strmap_compare(mfu_flist src_list,
-                                strmap* src_map,
+static int dcmp_map_compare(mfu_flist src_list,
+                                mfu_itemmap* src_map,
                                 mfu_flist dst_list,
-                                strmap* dst_map,
+                                mfu_itemmap* dst_map,
                                 size_t strlen_prefix,
                                 const mfu_param_path* src_path,
                                 const mfu_param_path* dest_path)
@@ -965,20 +970,27 @@ static int dcmp_strmap_compare(mfu_flist src_list,
     uint64_t dst_mtime_nsec;
 
     /* iterate over each item in source map */
-    const strmap_node* node;
-    strmap_foreach(src_map, node) {
-
+    uint64_t src_slot;
+    uint64_t src_slots = mfu_itemmap_size(src_map);
+    for (src_slot = 0; src_slot < src_slots; src_slot++) {
         /* get file name */
-        const char* key = strmap_node_key(node);
+        const char* key = mfu_itemmap_key(src_map, src_slot);
 
         /* get index of source file */
-        uint64_t src_index;
-        tmp_rc = dcmp_strmap_item_index(src_map, key, &src_index);
-        assert(tmp_rc == 0);
+        uint64_t src_index = mfu_itemmap_index(src_map, src_slot);
+
+        /* get slot of destination file */
+        uint64_t dst_slot;
+        tmp_rc = mfu_itemmap_lookup(dst_map, key, &dst_slot);
+        if (tmp_rc) {
+            dcmp_map_item_update(src_map, src_slot, DCMPF_EXIST, DCMPS_ONLY_SRC);
+
+            /* skip uncommon files, all other states are DCMPS_INIT */
+            continue;
+        }
 
         /* get index of destination file */
-        uint64_t dst_index;
-        tmp_rc = dcmp_strmap_item_index(dst_map, key, &dst_index);
+        uint64_t dst_index = mfu_itemmap_index(dst_map, dst_slot);
 
         /* get mtime seconds and nsecs to check modification times of src & dst */
         src_mtime      = mfu_flist_file_get_mtime(src_list, src_index);
@@ -986,15 +998,8 @@ static int dcmp_strmap_compare(mfu_flist src_list,
         dst_mtime      = mfu_flist_file_get_mtime(dst_list, dst_index);
         dst_mtime_nsec = mfu_flist_file_get_mtime_nsec(dst_list, dst_index);
 
-        if (tmp_rc) {
-            dcmp_strmap_item_update(src_map, key, DCMPF_EXIST, DCMPS_ONLY_SRC);
-
-            /* skip uncommon files, all other states are DCMPS_INIT */
-            continue;
-        }
-
-        dcmp_strmap_item_update(src_map, key, DCMPF_EXIST, DCMPS_COMMON);
-        dcmp_strmap_item_update(dst_map, key, DCMPF_EXIST, DCMPS_COMMON);
+        dcmp_map_item_update(src_map, src_slot, DCMPF_EXIST, DCMPS_COMMON);
+        dcmp_map_item_update(dst_map, dst_slot, DCMPF_EXIST, DCMPS_COMMON);
 
         /* get modes of files */
         mode_t src_mode = (mode_t) mfu_flist_file_get_mode(src_list,
@@ -1002,9 +1007,8 @@ static int dcmp_strmap_compare(mfu_flist src_list,
         mode_t dst_mode = (mode_t) mfu_flist_file_get_mode(dst_list,
             dst_index);
 
-        tmp_rc = dcmp_compare_metadata(src_list, src_map, src_index,
-             dst_list, dst_map, dst_index,
-             key);
+        tmp_rc = dcmp_compare_metadata(src_list, src_map, src_slot,
+             dst_list, dst_map, dst_slot);
 
         assert(tmp_rc >= 0);
 
@@ -1019,21 +1023,21 @@ static int dcmp_strmap_compare(mfu_flist src_list,
         /* check whether files are of the same type */
         if ((src_mode & S_IFMT) != (dst_mode & S_IFMT)) {
             /* file type is different, no need to go any futher */
-            dcmp_strmap_item_update(src_map, key, DCMPF_TYPE, DCMPS_DIFFER);
-            dcmp_strmap_item_update(dst_map, key, DCMPF_TYPE, DCMPS_DIFFER);
+            dcmp_map_item_update(src_map, src_slot, DCMPF_TYPE, DCMPS_DIFFER);
+            dcmp_map_item_update(dst_map, dst_slot, DCMPF_TYPE, DCMPS_DIFFER);
 
             if (!dcmp_option_need_compare(DCMPF_CONTENT)) {
                 continue;
             }
 
             /* take them as differ content */
-            dcmp_strmap_item_update(src_map, key, DCMPF_CONTENT, DCMPS_DIFFER);
-            dcmp_strmap_item_update(dst_map, key, DCMPF_CONTENT, DCMPS_DIFFER);
+            dcmp_map_item_update(src_map, src_slot, DCMPF_CONTENT, DCMPS_DIFFER);
+            dcmp_map_item_update(dst_map, dst_slot, DCMPF_CONTENT, DCMPS_DIFFER);
             continue;
         }
 
-        dcmp_strmap_item_update(src_map, key, DCMPF_TYPE, DCMPS_COMMON);
-        dcmp_strmap_item_update(dst_map, key, DCMPF_TYPE, DCMPS_COMMON);
+        dcmp_map_item_update(src_map, src_slot, DCMPF_TYPE, DCMPS_COMMON);
+        dcmp_map_item_update(dst_map, dst_slot, DCMPF_TYPE, DCMPS_COMMON);
 
         if (!dcmp_option_need_compare(DCMPF_CONTENT)) {
             /* Skip if no need to compare content. */
@@ -1044,18 +1048,16 @@ static int dcmp_strmap_compare(mfu_flist src_list,
         /* TODO: add support for symlinks */
         if (! S_ISREG(dst_mode)) {
             /* not regular file, take them as common content */
-            dcmp_strmap_item_update(src_map, key, DCMPF_CONTENT, DCMPS_COMMON);
-            dcmp_strmap_item_update(dst_map, key, DCMPF_CONTENT, DCMPS_COMMON);
+            dcmp_map_item_update(src_map, src_slot, DCMPF_CONTENT, DCMPS_COMMON);
+            dcmp_map_item_update(dst_map, dst_slot, DCMPF_CONTENT, DCMPS_COMMON);
             continue;
         }
 
-        dcmp_state state;
-        tmp_rc = dcmp_strmap_item_state(src_map, key, DCMPF_SIZE, &state);
-        assert(tmp_rc == 0);
+        dcmp_state state = dcmp_map_item_state(src_map, src_slot, DCMPF_SIZE);
         if (state == DCMPS_DIFFER) {
             /* file size is different, their contents should be different */
-            dcmp_strmap_item_update(src_map, key, DCMPF_CONTENT, DCMPS_DIFFER);
-            dcmp_strmap_item_update(dst_map, key, DCMPF_CONTENT, DCMPS_DIFFER);
+            dcmp_map_item_update(src_map, src_slot, DCMPF_CONTENT, DCMPS_DIFFER);
+            dcmp_map_item_update(dst_map, dst_slot, DCMPF_CONTENT, DCMPS_DIFFER);
             continue;
         }
 
@@ -1065,11 +1067,11 @@ static int dcmp_strmap_compare(mfu_flist src_list,
                  * I don't think we can assume contents are different if the
                  * lite option is not on. Because files can have different
                  * modification times, but still have the same content. */
-                dcmp_strmap_item_update(src_map, key, DCMPF_CONTENT, DCMPS_DIFFER);
-                dcmp_strmap_item_update(dst_map, key, DCMPF_CONTENT, DCMPS_DIFFER);
+                dcmp_map_item_update(src_map, src_slot, DCMPF_CONTENT, DCMPS_DIFFER);
+                dcmp_map_item_update(dst_map, dst_slot, DCMPF_CONTENT, DCMPS_DIFFER);
             } else {
-                dcmp_strmap_item_update(src_map, key, DCMPF_CONTENT, DCMPS_COMMON);
-                dcmp_strmap_item_update(dst_map, key, DCMPF_CONTENT, DCMPS_COMMON);
+                dcmp_map_item_update(src_map, src_slot, DCMPF_CONTENT, DCMPS_COMMON);
+                dcmp_map_item_update(dst_map, dst_slot, DCMPF_CONTENT, DCMPS_COMMON);
             }
             continue;
         }
@@ -1087,11 +1089,19 @@ static int dcmp_strmap_compare(mfu_flist src_list,
     mfu_flist_summarize(dst_compare_list);
 
     uint64_t cmp_global_size = 0;
+    uint64_t bytes_read = 0;
     if (!options.lite) {
         /* compare the contents of the files if we have anything in the compare list */
         cmp_global_size = mfu_flist_global_size(src_compare_list);
-        if (cmp_global_size > 0) {
-            tmp_rc = dcmp_strmap_compare_data(src_compare_list, src_map, dst_compare_list,
+        if (cmp_global_size > 0 && options.hash_store != NULL) {
+            tmp_rc = dcmp_map_compare_hashes(src_compare_list, src_map, dst_compare_list,
+                    dst_map, strlen_prefix, &bytes_read);
+            if (tmp_rc < 0) {
+                /* got a read error, signal that back to caller */
+                rc = -1;
+            }
+        } else if (cmp_global_size > 0) {
+            tmp_rc = dcmp_map_compare_data(src_compare_list, src_map, dst_compare_list,
                     dst_map, strlen_prefix);
             if (tmp_rc < 0) {
                 /* got a read error, signal that back to caller */
@@ -1108,12 +1118,15 @@ static int dcmp_strmap_compare(mfu_flist src_list,
     /* initalize total_bytes_read to zero */
     uint64_t total_bytes_read = 0;
 
-    /* get total bytes read (if any) */
-    if (cmp_global_size > 0) {
+    /* get total bytes read (if any), with a block hash store
+     * we count what was actually read */
+    if (cmp_global_size > 0 && options.hash_store != NULL) {
+        MPI_Allreduce(&bytes_read, &total_bytes_read, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    } else if (cmp_global_size > 0) {
         total_bytes_read = get_total_bytes_read(src_compare_list);
     }
 
-    time_strmap_compare(src_list, start_compare, end_compare, &time_started,
+    time_map_compare(src_list, start_compare, end_compare, &time_started,
                         &time_ended, total_bytes_read);
 
     /* free the compare flists */
@@ -1124,48 +1137,32 @@ static int dcmp_strmap_compare(mfu_flist src_list,
 }
 
 /* loop on the src map to check the results */
-static void dcmp_strmap_check_src(strmap* src_map,
-                                  strmap* dst_map)
+static void dcmp_map_check_src(mfu_itemmap* src_map,
+                               mfu_itemmap* dst_map)
 {
     assert(dcmp_option_need_compare(DCMPF_EXIST));
     /* iterate over each item in source map */
-    const strmap_node* node;
-    strmap_foreach(src_map, node) {
+    uint64_t src_slot;
+    uint64_t src_slots = mfu_itemmap_size(src_map);
+    for (src_slot = 0; src_slot < src_slots; src_slot++) {
         /* get file name */
-        const char* key = strmap_node_key(node);
+        const char* key = mfu_itemmap_key(src_map, src_slot);
         int only_src = 0;
 
-        /* get index of source file */
-        uint64_t src_index;
-        int ret = dcmp_strmap_item_index(src_map, key, &src_index);
-        assert(ret == 0);
-
-        /* get index of destination file */
-        uint64_t dst_index;
-        ret = dcmp_strmap_item_index(dst_map, key, &dst_index);
+        /* get slot of destination file */
+        uint64_t dst_slot;
+        int ret = mfu_itemmap_lookup(dst_map, key, &dst_slot);
         if (ret) {
             only_src = 1;
         }
 
         /* First check exist state */
-        dcmp_state src_exist_state;
-        ret = dcmp_strmap_item_state(src_map, key, DCMPF_EXIST,
-            &src_exist_state);
-        assert(ret == 0);
-
-        dcmp_state dst_exist_state;
-        ret = dcmp_strmap_item_state(dst_map, key, DCMPF_EXIST,
-            &dst_exist_state);
-        if (only_src) {
-            assert(ret);
-        } else {
-            assert(ret == 0);
-        }
-
+        dcmp_state src_exist_state = dcmp_map_item_state(src_map, src_slot, DCMPF_EXIST);
         if (only_src) {
             /* This file never checked for dest */
             assert(src_exist_state == DCMPS_ONLY_SRC);
         } else {
+            dcmp_state dst_exist_state = dcmp_map_item_state(dst_map, dst_slot, DCMPF_EXIST);
             assert(src_exist_state == dst_exist_state);
             assert(dst_exist_state == DCMPS_COMMON);
         }
@@ -1176,24 +1173,15 @@ static void dcmp_strmap_check_src(strmap* src_map,
                 continue;
             }
 
-            /* get state of src and dest */
-            dcmp_state src_state;
-            ret = dcmp_strmap_item_state(src_map, key, field, &src_state);
-            assert(ret == 0);
-
-            dcmp_state dst_state;
-            ret = dcmp_strmap_item_state(dst_map, key, field, &dst_state);
-            if (only_src) {
-                assert(ret);
-            } else {
-                assert(ret == 0);
-            }
+            /* get state of src */
+            dcmp_state src_state = dcmp_map_item_state(src_map, src_slot, field);
 
             if (only_src) {
                 /* all states are not checked */
                 assert(src_state == DCMPS_INIT);
             } else {
                 /* all stats of source and dest are the same */
+                dcmp_state dst_state = dcmp_map_item_state(dst_map, dst_slot, field);
                 assert(src_state == dst_state);
                 /* all states are either common, differ or skiped */
                 if (dcmp_option_need_compare(field)) {
@@ -1211,50 +1199,34 @@ static void dcmp_strmap_check_src(strmap* src_map,
 }
 
 /* loop on the dest map to check the results */
-static void dcmp_strmap_check_dst(strmap* src_map,
-    strmap* dst_map)
+static void dcmp_map_check_dst(mfu_itemmap* src_map,
+    mfu_itemmap* dst_map)
 {
     assert(dcmp_option_need_compare(DCMPF_EXIST));
 
     /* iterate over each item in dest map */
-    const strmap_node* node;
-    strmap_foreach(dst_map, node) {
+    uint64_t dst_slot;
+    uint64_t dst_slots = mfu_itemmap_size(dst_map);
+    for (dst_slot = 0; dst_slot < dst_slots; dst_slot++) {
         /* get file name */
-        const char* key = strmap_node_key(node);
+        const char* key = mfu_itemmap_key(dst_map, dst_slot);
         int only_dest = 0;
 
-        /* get index of destination file */
-        uint64_t dst_index;
-        int ret = dcmp_strmap_item_index(dst_map, key, &dst_index);
-        assert(ret == 0);
-
-        /* get index of source file */
-        uint64_t src_index;
-        ret = dcmp_strmap_item_index(src_map, key, &src_index);
+        /* get slot of source file */
+        uint64_t src_slot;
+        int ret = mfu_itemmap_lookup(src_map, key, &src_slot);
         if (ret) {
             /* This file only exist in dest */
             only_dest = 1;
         }
 
         /* First check exist state */
-        dcmp_state src_exist_state;
-        ret = dcmp_strmap_item_state(src_map, key, DCMPF_EXIST,
-            &src_exist_state);
-        if (only_dest) {
-            assert(ret);
-        } else {
-            assert(ret == 0);
-        }
-
-        dcmp_state dst_exist_state;
-        ret = dcmp_strmap_item_state(dst_map, key, DCMPF_EXIST,
-            &dst_exist_state);
-        assert(ret == 0);
-
+        dcmp_state dst_exist_state = dcmp_map_item_state(dst_map, dst_slot, DCMPF_EXIST);
         if (only_dest) {
             /* This file never checked for dest */
             assert(dst_exist_state == DCMPS_INIT);
         } else {
+            dcmp_state src_exist_state = dcmp_map_item_state(src_map, src_slot, DCMPF_EXIST);
             assert(src_exist_state == dst_exist_state);
             assert(dst_exist_state == DCMPS_COMMON ||
                 dst_exist_state == DCMPS_ONLY_SRC);
@@ -1266,37 +1238,15 @@ static void dcmp_strmap_check_dst(strmap* src_map,
                 continue;
             }
 
-            /* get state of src and dest */
-            dcmp_state src_state;
-            ret = dcmp_strmap_item_state(src_map, key, field,
-                &src_state);
-            if (only_dest) {
-                assert(ret);
-            } else {
-                assert(ret == 0);
-            }
-
-            dcmp_state dst_state;
-            ret = dcmp_strmap_item_state(dst_map, key, field,
-                &dst_state);
-            assert(ret == 0);
-
-            if (only_dest) {
-                /* all states are not checked */
-                assert(dst_state == DCMPS_INIT);
-            } else {
-                assert(src_state == dst_state);
-                /* all states are either common, differ or skiped */
-                assert(src_state == DCMPS_COMMON ||
-                    src_state == DCMPS_DIFFER ||
-                    src_state == DCMPS_INIT);
-            }
+            /* get state of dest */
+            dcmp_state dst_state = dcmp_map_item_state(dst_map, dst_slot, field);
 
             if (only_dest || dst_exist_state == DCMPS_ONLY_SRC) {
                 /* This file never checked for dest */
                 assert(dst_state == DCMPS_INIT);
             } else {
                 /* all stats of source and dest are the same */
+                dcmp_state src_state = dcmp_map_item_state(src_map, src_slot, field);
                 assert(src_state == dst_state);
                 /* all states are either common, differ or skiped */
                 if (dcmp_option_need_compare(field)) {
@@ -1311,12 +1261,12 @@ static void dcmp_strmap_check_dst(strmap* src_map,
 }
 
 /* check the result maps are valid */
-static void dcmp_strmap_check(
-    strmap* src_map,
-    strmap* dst_map)
+static void dcmp_map_check(
+    mfu_itemmap* src_map,
+    mfu_itemmap* dst_map)
 {
-    dcmp_strmap_check_src(src_map, dst_map);
-    dcmp_strmap_check_dst(src_map, dst_map);
+    dcmp_map_check_src(src_map, dst_map);
+    dcmp_map_check_dst(src_map, dst_map);
 }
 
 static int dcmp_map_fn(
@@ -1407,15 +1357,11 @@ static void dcmp_expression_print(
 
 static int dcmp_expression_match(
     struct dcmp_expression *expression,
-    strmap* map,
-    const char* key)
+    mfu_itemmap* map,
+    uint64_t slot)
 {
-    int ret;
     dcmp_state state;
-    dcmp_state exist_state;
-
-    ret = dcmp_strmap_item_state(map, key, DCMPF_EXIST, &exist_state);
-    assert(ret == 0);
+    dcmp_state exist_state = dcmp_map_item_state(map, slot, DCMPF_EXIST);
     if (exist_state == DCMPS_ONLY_SRC) {
         /*
          * Map is source and file only exist in source.
@@ -1454,8 +1400,7 @@ static int dcmp_expression_match(
     assert(exist_state == DCMPS_COMMON);
     assert(expression->field != DCMPF_EXIST);
 
-    ret = dcmp_strmap_item_state(map, key, expression->field, &state);
-    assert(ret == 0);
+    state = dcmp_map_item_state(map, slot, expression->field);
 
      /* All fields should have been compared. */
     assert(state == DCMPS_COMMON || state == DCMPS_DIFFER);
@@ -1536,8 +1481,8 @@ static void dcmp_conjunction_print(
 /* if matched return 1, else return 0 */
 static int dcmp_conjunction_match(
     struct dcmp_conjunction *conjunction,
-    strmap* map,
-    const char* key)
+    mfu_itemmap* map,
+    uint64_t slot)
 {
     struct dcmp_expression* expression;
     int matched;
@@ -1545,7 +1490,7 @@ static int dcmp_conjunction_match(
     list_for_each_entry(expression,
                         &conjunction->expressions,
                         linkage) {
-        matched = dcmp_expression_match(expression, map, key);
+        matched = dcmp_expression_match(expression, map, slot);
         if (!matched) {
             return 0;
         }
@@ -1635,8 +1580,8 @@ static void dcmp_disjunction_print(
 /* if matched return 1, else return 0 */
 static int dcmp_disjunction_match(
     struct dcmp_disjunction* disjunction,
-    strmap* map,
-    const char* key,
+    mfu_itemmap* map,
+    uint64_t slot,
     int is_src)
 {
     struct dcmp_conjunction *conjunction;
@@ -1645,7 +1590,7 @@ static int dcmp_disjunction_match(
     list_for_each_entry(conjunction,
                         &disjunction->conjunctions,
                         linkage) {
-        matched = dcmp_conjunction_match(conjunction, map, key);
+        matched = dcmp_conjunction_match(conjunction, map, slot);
         if (matched) {
             if (is_src)
                 mfu_flist_increase(&conjunction->src_matched_list);
@@ -1726,127 +1671,226 @@ static void dcmp_option_add_comparison(dcmp_field field)
     }
 }
 
-static int dcmp_output_flist_match(
-    struct dcmp_output *output,
-    strmap* map,
-    mfu_flist flist,
-    mfu_flist new_flist,
-    mfu_flist *matched_flist,
-    int is_src)
-{
-    const strmap_node* node;
-    struct dcmp_conjunction *conjunction;
-
-    /* iterate over each item in map */
-    strmap_foreach(map, node) {
-        /* get file name */
-        const char* key = strmap_node_key(node);
-
-        /* get index of file */
-        uint64_t idx;
-        int ret = dcmp_strmap_item_index(map, key, &idx);
-        assert(ret == 0);
+/* number of items to visit between collective writes of output files,
+ * which bounds the memory used to buffer records */
+#define DCMP_OUTPUT_BATCH (64 * 1024)
+
+/* position in the sequence of items visited to write output files,
+ * the slots of each map are visited in key order */
+struct dcmp_output_cursor {
+    uint64_t src_slot;
+    uint64_t dst_slot;
+    uint64_t* src_order;
+    uint64_t* dst_order;
+};
 
-        if (dcmp_disjunction_match(output->disjunction, map, key, is_src)) {
-            mfu_flist_increase(matched_flist);
-            mfu_flist_file_copy(flist, idx, new_flist);
-        }
+/* get the next item to be written to output files, source items come
+ * first in name order and then dest items in name order, except with a
+ * sort-merge join, which merges both so that items are in name order
+ * across the two lists, returns 0 once all items have been visited */
+static int dcmp_output_next(
+    struct dcmp_output_cursor* cursor,
+    mfu_itemmap* src_map,
+    mfu_itemmap* dst_map,
+    int* is_src,
+    uint64_t* slot)
+{
+    uint64_t src_slots = mfu_itemmap_size(src_map);
+    uint64_t dst_slots = mfu_itemmap_size(dst_map);
+    if (cursor->src_slot >= src_slots && cursor->dst_slot >= dst_slots) {
+        return 0;
     }
 
-    list_for_each_entry(conjunction,
-                        &output->disjunction->conjunctions,
-                        linkage) {
-        if (is_src) {
-            mfu_flist_summarize(conjunction->src_matched_list);
-        } else {
-            mfu_flist_summarize(conjunction->dst_matched_list);
-        }
+    /* take the item with the smaller name, source first on ties */
+    int take_src;
+    if (cursor->dst_slot >= dst_slots) {
+        take_src = 1;
+    } else if (cursor->src_slot >= src_slots) {
+        take_src = 0;
+    } else if (! options.sort_join) {
+        take_src = 1;
+    } else {
+        const char* src_key = mfu_itemmap_key(src_map, cursor->src_order[cursor->src_slot]);
+        const char* dst_key = mfu_itemmap_key(dst_map, cursor->dst_order[cursor->dst_slot]);
+        take_src = (strcmp(src_key, dst_key) <= 0);
     }
 
-    return 0;
+    *is_src = take_src;
+    if (take_src) {
+        *slot = cursor->src_order[cursor->src_slot];
+        cursor->src_slot++;
+    } else {
+        *slot = cursor->dst_order[cursor->dst_slot];
+        cursor->dst_slot++;
+    }
+    return 1;
 }
 
 #define DCMP_OUTPUT_PREFIX "Number of items that "
 
-static int dcmp_output_write(
-    struct dcmp_output *output,
-    mfu_flist src_flist,
-    strmap* src_map,
-    mfu_flist dst_flist,
-    strmap* dst_map)
+/* evaluate all outputs in one pass over the items, then stream the
+ * matches of each to its file, rather than building a list per output */
+static int dcmp_outputs_write(
+    mfu_flist src_list,
+    mfu_itemmap* src_map,
+    mfu_flist dst_list,
+    mfu_itemmap* dst_map)
 {
-    int ret = 0;
-    mfu_flist new_flist = mfu_flist_subset(src_flist);
-
-    /* find matched file in source map */
-    mfu_flist src_matched = mfu_flist_new();
-    ret = dcmp_output_flist_match(output, src_map, src_flist,
-                                  new_flist, &src_matched, 1);
-    assert(ret == 0);
-
-    /* find matched file in dest map */
-    mfu_flist dst_matched = mfu_flist_new();
-    ret = dcmp_output_flist_match(output, dst_map, dst_flist,
-                                  new_flist, &dst_matched, 0);
-    assert(ret == 0);
-
-    mfu_flist_summarize(new_flist);
-    mfu_flist_summarize(src_matched);
-    mfu_flist_summarize(dst_matched);
-    if (output->file_name != NULL) {
-        if (options.format) {
-            mfu_flist_write_cache(output->file_name, new_flist);
-        } else {
-            mfu_flist_write_text(output->file_name, new_flist);
-        }
-    }
+    struct dcmp_output* output;
+    struct dcmp_conjunction *conjunction;
 
     int rank;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    if (rank == 0) {
-        printf(DCMP_OUTPUT_PREFIX);
-        dcmp_disjunction_print(output->disjunction, 0,
-                               strlen(DCMP_OUTPUT_PREFIX));
 
-        if (output->disjunction->count > 1)
-            printf(", total number: %lu/%lu",
-                   mfu_flist_global_size(src_matched),
-                   mfu_flist_global_size(dst_matched));
+    /* count outputs */
+    int outputs = 0;
+    list_for_each_entry(output, &options.outputs, linkage) {
+        outputs++;
+    }
 
+    /* allocate a writer for each output that has a file */
+    mfu_flist_writer** writers = (mfu_flist_writer**) MFU_MALLOC((outputs + 1) * sizeof(mfu_flist_writer*));
+    uint64_t* src_matched = (uint64_t*) MFU_MALLOC((outputs + 1) * sizeof(uint64_t));
+    uint64_t* dst_matched = (uint64_t*) MFU_MALLOC((outputs + 1) * sizeof(uint64_t));
+    int k = 0;
+    list_for_each_entry(output, &options.outputs, linkage) {
+        writers[k] = NULL;
         if (output->file_name != NULL) {
-            printf(", dumped to \"%s\"",
-                   output->file_name);
+            writers[k] = mfu_flist_writer_new(output->file_name, src_list, options.format);
+        }
+        src_matched[k] = 0;
+        dst_matched[k] = 0;
+        k++;
+    }
+
+    /* record which outputs each item matches, one bit per output */
+    uint64_t stride = (uint64_t) (outputs + 7) / 8;
+    uint64_t items = mfu_itemmap_size(src_map) + mfu_itemmap_size(dst_map);
+    uint8_t* matched = (uint8_t*) MFU_MALLOC(items * stride + 1);
+    memset(matched, 0, items * stride + 1);
+
+    /* evaluate each output on each item and count the matches */
+    struct dcmp_output_cursor cursor;
+    cursor.src_slot  = 0;
+    cursor.dst_slot  = 0;
+    cursor.src_order = mfu_itemmap_order(src_map);
+    cursor.dst_order = mfu_itemmap_order(dst_map);
+    int is_src;
+    uint64_t slot;
+    uint64_t item = 0;
+    while (dcmp_output_next(&cursor, src_map, dst_map, &is_src, &slot)) {
+        mfu_itemmap* map = is_src ? src_map : dst_map;
+        mfu_flist list   = is_src ? src_list : dst_list;
+        uint64_t idx = mfu_itemmap_index(map, slot);
+
+        k = 0;
+        list_for_each_entry(output, &options.outputs, linkage) {
+            if (dcmp_disjunction_match(output->disjunction, map, slot, is_src)) {
+                matched[item * stride + k / 8] |= (uint8_t) (1 << (k % 8));
+                if (is_src) {
+                    src_matched[k]++;
+                } else {
+                    dst_matched[k]++;
+                }
+                if (writers[k] != NULL) {
+                    mfu_flist_writer_count(writers[k], list, idx);
+                }
+            }
+            k++;
         }
-        printf("\n");
+        item++;
     }
-    mfu_flist_free(&new_flist);
-    mfu_flist_free(&src_matched);
-    mfu_flist_free(&dst_matched);
 
-    return 0;
-}
+    list_for_each_entry(output, &options.outputs, linkage) {
+        list_for_each_entry(conjunction,
+                            &output->disjunction->conjunctions,
+                            linkage) {
+            mfu_flist_summarize(conjunction->src_matched_list);
+            mfu_flist_summarize(conjunction->dst_matched_list);
+        }
+    }
 
-static int dcmp_outputs_write(
-    mfu_flist src_list,
-    strmap* src_map,
-    mfu_flist dst_list,
-    strmap* dst_map)
-{
-    struct dcmp_output* output;
-    int ret = 0;
+    /* open files now that we know how much each rank writes */
+    for (k = 0; k < outputs; k++) {
+        if (writers[k] != NULL) {
+            mfu_flist_writer_start(writers[k]);
+        }
+    }
+
+    /* visit items again in batches, adding matches to each writer,
+     * and write every file after each batch */
+    uint64_t batches = (items + DCMP_OUTPUT_BATCH - 1) / DCMP_OUTPUT_BATCH;
+    uint64_t all_batches;
+    MPI_Allreduce(&batches, &all_batches, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
+
+    cursor.src_slot = 0;
+    cursor.dst_slot = 0;
+    item = 0;
+    uint64_t batch;
+    for (batch = 0; batch < all_batches; batch++) {
+        uint64_t visited = 0;
+        while (visited < DCMP_OUTPUT_BATCH &&
+               dcmp_output_next(&cursor, src_map, dst_map, &is_src, &slot))
+        {
+            mfu_itemmap* map = is_src ? src_map : dst_map;
+            mfu_flist list   = is_src ? src_list : dst_list;
+            uint64_t idx = mfu_itemmap_index(map, slot);
+            for (k = 0; k < outputs; k++) {
+                if (writers[k] != NULL &&
+                    (matched[item * stride + k / 8] & (uint8_t) (1 << (k % 8))))
+                {
+                    mfu_flist_writer_add(writers[k], list, idx);
+                }
+            }
+            item++;
+            visited++;
+        }
 
-    list_for_each_entry(output,
-                        &options.outputs,
-                        linkage) {
-        ret = dcmp_output_write(output, src_list, src_map, dst_list, dst_map);
-        if (ret) {
-            fprintf(stderr,
-                "failed to output to file \"%s\"\n",
-                output->file_name);
-            break;
+        for (k = 0; k < outputs; k++) {
+            if (writers[k] != NULL) {
+                mfu_flist_writer_flush(writers[k]);
+            }
         }
     }
-    return ret;
+
+    for (k = 0; k < outputs; k++) {
+        if (writers[k] != NULL) {
+            mfu_flist_writer_close(&writers[k]);
+        }
+    }
+
+    /* get total number of matches of each output */
+    MPI_Allreduce(MPI_IN_PLACE, src_matched, outputs, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, dst_matched, outputs, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+    if (rank == 0) {
+        k = 0;
+        list_for_each_entry(output, &options.outputs, linkage) {
+            printf(DCMP_OUTPUT_PREFIX);
+            dcmp_disjunction_print(output->disjunction, 0,
+                                   strlen(DCMP_OUTPUT_PREFIX));
+
+            if (output->disjunction->count > 1)
+                printf(", total number: %lu/%lu",
+                       src_matched[k], dst_matched[k]);
+
+            if (output->file_name != NULL) {
+                printf(", dumped to \"%s\"",
+                       output->file_name);
+            }
+            printf("\n");
+            k++;
+        }
+    }
+
+    mfu_free(&cursor.src_order);
+    mfu_free(&cursor.dst_order);
+    mfu_free(&matched);
+    mfu_free(&dst_matched);
+    mfu_free(&src_matched);
+    mfu_free(&writers);
+
+    return 0;
 }
 
 #define DCMP_PATH_DELIMITER        ":"
@@ -2024,6 +2068,47 @@ out:
     return ret;
 }
 
+/* fill flist by reading the cache file if one is given, and otherwise
+ * by walking path, returns the prefix to strip from item names to get
+ * their relative paths, which the caller must free */
+static char* dcmp_get_list(
+    const char* cache,
+    const mfu_param_path* path,
+    const char* desc,
+    mfu_walk_opts_t* walk_opts,
+    mfu_flist flist,
+    mfu_file_t* mfu_file)
+{
+    if (cache == NULL) {
+        if (mfu_rank == 0) {
+            MFU_LOG(MFU_LOG_INFO, "Walking %s path", desc);
+        }
+        mfu_flist_walk_param_paths(1, path, walk_opts, flist, mfu_file);
+        return MFU_STRDUP(path->path);
+    }
+
+    if (mfu_rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Reading %s list from cache", desc);
+    }
+    mfu_flist_read_cache(cache, flist);
+
+    /* metadata comparisons need stat info in the cache */
+    if (! mfu_flist_have_detail(flist)) {
+        MFU_ABORT(1, "Cache file `%s' has no stat info, write it with a walk that stats items", cache);
+    }
+
+    /* the cache holds full paths, take the root that was walked to make
+     * it as the prefix, an empty cache has no names to strip */
+    char* prefix = mfu_flist_common_prefix(flist);
+    if (prefix == NULL) {
+        prefix = MFU_STRDUP("");
+    }
+    if (mfu_rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Using `%s' as %s root", prefix, desc);
+    }
+    return prefix;
+}
+
 int main(int argc, char **argv)
 {
     int rc = 0;
@@ -2064,6 +2149,10 @@ int main(int argc, char **argv)
         {"verbose",  0, 0, 'v'},
         {"quiet",    0, 0, 'q'},
         {"lite",     0, 0, 'l'},
+        {"sort-join", 0, 0, 'J'},
+        {"src-cache", 1, 0, 'S'},
+        {"dst-cache", 1, 0, 'T'},
+        {"hash-store", 1, 0, 'H'},
         {"debug",    0, 0, 'd'},
         {"help",     0, 0, 'h'},
         {0, 0, 0, 0}
@@ -2114,6 +2203,18 @@ int main(int argc, char **argv)
         case 'l':
             options.lite++;
             break;
+        case 'J':
+            options.sort_join = 1;
+            break;
+        case 'S':
+            options.src_cache = MFU_STRDUP(optarg);
+            break;
+        case 'T':
+            options.dst_cache = MFU_STRDUP(optarg);
+            break;
+        case 'H':
+            options.hash_store = MFU_STRDUP(optarg);
+            break;
         case 'd':
             options.debug++;
             break;
@@ -2152,13 +2253,43 @@ int main(int argc, char **argv)
         }
     }
 
-    /* we should have two arguments left, source and dest paths */
+    /* we should have a path left for each side not read from a cache */
     int numargs = argc - optind;
+    int needargs = (options.src_cache == NULL) + (options.dst_cache == NULL);
 
     /* if help flag was thrown, don't bother checking usage */
-    if (numargs != 2 && !help) {
-        MFU_LOG(MFU_LOG_ERR,
-            "You must specify a source and destination path.");
+    if (numargs != needargs && !help) {
+        if (needargs == 2) {
+            MFU_LOG(MFU_LOG_ERR,
+                "You must specify a source and destination path.");
+        } else if (needargs == 1) {
+            MFU_LOG(MFU_LOG_ERR,
+                "You must specify one path along with a cache file.");
+        } else {
+            MFU_LOG(MFU_LOG_ERR,
+                "Paths are not allowed with both --src-cache and --dst-cache.");
+        }
+        usage = 1;
+    }
+
+    /* ACLs and file contents can only be read from the file system,
+     * so when comparing against a cache file, contents are judged by
+     * size and mtime as in lite mode */
+    if (options.src_cache != NULL || options.dst_cache != NULL) {
+        if (dcmp_option_need_compare(DCMPF_ACL)) {
+            if (rank == 0) {
+                MFU_LOG(MFU_LOG_ERR, "ACL cannot be compared with --src-cache or --dst-cache");
+            }
+            usage = 1;
+        }
+        options.lite = 1;
+    }
+
+    /* block hashes are only used when comparing file contents */
+    if (options.hash_store != NULL && options.lite) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "--hash-store cannot be used with --lite, --src-cache, or --dst-cache");
+        }
         usage = 1;
     }
 
@@ -2168,6 +2299,9 @@ int main(int argc, char **argv)
             print_usage();
         }
         dcmp_option_fini();
+        mfu_free(&options.src_cache);
+        mfu_free(&options.dst_cache);
+        mfu_free(&options.hash_store);
         mfu_finalize();
         MPI_Finalize();
         return 1;
@@ -2183,9 +2317,17 @@ int main(int argc, char **argv)
     /* advance to next set of options */
     optind += numargs;
 
-    /* first item is source and second is dest */
-    const mfu_param_path* srcpath  = &paths[0];
-    const mfu_param_path* destpath = &paths[1];
+    /* paths are given in order for the source and dest,
+     * skipping any that are read from a cache */
+    int argidx = 0;
+    const mfu_param_path* srcpath  = NULL;
+    const mfu_param_path* destpath = NULL;
+    if (options.src_cache == NULL) {
+        srcpath = &paths[argidx++];
+    }
+    if (options.dst_cache == NULL) {
+        destpath = &paths[argidx++];
+    }
 
     /* create an empty file list */
     mfu_flist flist1 = mfu_flist_new();
@@ -2195,30 +2337,38 @@ int main(int argc, char **argv)
     mfu_file_t* mfu_src_file = mfu_file_new();
     mfu_file_t* mfu_dst_file = mfu_file_new();
 
-    if (rank == 0) {
-        MFU_LOG(MFU_LOG_INFO, "Walking source path");
-    }
-    mfu_flist_walk_param_paths(1,  srcpath, walk_opts, flist1, mfu_src_file);
+    /* read or walk each side, and get the prefix to strip from its names */
+    char* path1 = dcmp_get_list(options.src_cache, srcpath, "source",
+                                walk_opts, flist1, mfu_src_file);
+    char* path2 = dcmp_get_list(options.dst_cache, destpath, "destination",
+                                walk_opts, flist2, mfu_dst_file);
+
+    mfu_flist flist3;
+    mfu_flist flist4;
+    mfu_itemmap* map1;
+    mfu_itemmap* map2;
+    if (options.sort_join) {
+        /* sort source by name, then send each source and dest item
+         * to the rank holding that range of source names */
+        mfu_flist_sort("name", &flist1);
+        flist3 = mfu_itemmap_partition(flist1, strlen(path1), flist1, strlen(path1));
+        flist4 = mfu_itemmap_partition(flist1, strlen(path1), flist2, strlen(path2));
+
+        /* index items by name in sorted order without hash tables */
+        map1 = mfu_itemmap_new_sorted(flist3, strlen(path1));
+        map2 = mfu_itemmap_new_sorted(flist4, strlen(path2));
+    } else {
+        /* map files to ranks based on portion following prefix directory */
+        flist3 = mfu_flist_remap(flist1, (mfu_flist_map_fn)dcmp_map_fn, (const void*)path1);
+        flist4 = mfu_flist_remap(flist2, (mfu_flist_map_fn)dcmp_map_fn, (const void*)path2);
 
-    if (rank == 0) {
-        MFU_LOG(MFU_LOG_INFO, "Walking destination path");
+        /* map each file name to its index and its comparison state */
+        map1 = mfu_itemmap_new(flist3, strlen(path1));
+        map2 = mfu_itemmap_new(flist4, strlen(path2));
     }
-    mfu_flist_walk_param_paths(1, destpath, walk_opts, flist2, mfu_dst_file);
-
-    /* store src and dest path strings */
-    const char* path1 = srcpath->path;
-    const char* path2 = destpath->path;
-
-    /* map files to ranks based on portion following prefix directory */
-    mfu_flist flist3 = mfu_flist_remap(flist1, (mfu_flist_map_fn)dcmp_map_fn, (const void*)path1);
-    mfu_flist flist4 = mfu_flist_remap(flist2, (mfu_flist_map_fn)dcmp_map_fn, (const void*)path2);
-
-    /* map each file name to its index and its comparison state */
-    strmap* map1 = dcmp_strmap_creat(flist3, path1);
-    strmap* map2 = dcmp_strmap_creat(flist4, path2);
 
     /* compare files in map1 with those in map2 */
-    int tmp_rc = dcmp_strmap_compare(flist3, map1, flist4, map2, strlen(path1), srcpath, destpath);
+    int tmp_rc = dcmp_map_compare(flist3, map1, flist4, map2, strlen(path1), srcpath, destpath);
     if (tmp_rc < 0) {
         /* hit a read error on at least one file */
         rc = 1;
@@ -2226,15 +2376,15 @@ int main(int argc, char **argv)
 
     /* check the results are valid */
     if (options.debug) {
-        dcmp_strmap_check(map1, map2);
+        dcmp_map_check(map1, map2);
     }
 
     /* write data to cache files and print summary */
     dcmp_outputs_write(flist3, map1, flist4, map2);
 
     /* free maps of file names to comparison state info */
-    strmap_delete(&map1);
-    strmap_delete(&map2);
+    mfu_itemmap_delete(&map1);
+    mfu_itemmap_delete(&map2);
 
     /* free file lists */
     mfu_flist_free(&flist1);
@@ -2246,6 +2396,10 @@ int main(int argc, char **argv)
     mfu_file_delete(&mfu_src_file);
     mfu_file_delete(&mfu_dst_file);
 
+    /* free prefix strings */
+    mfu_free(&path1);
+    mfu_free(&path2);
+
     /* free all param paths */
     mfu_param_path_free_all(numargs, paths);
 
@@ -2253,6 +2407,9 @@ int main(int argc, char **argv)
     mfu_free(&paths);
 
     dcmp_option_fini();
+    mfu_free(&options.src_cache);
+    mfu_free(&options.dst_cache);
+    mfu_free(&options.hash_store);
 
     /* free the walk options */
     mfu_walk_opts_delete(&walk_opts);
@@ -144,6 +144,32 @@ static int input_flist_skip(const char* name, void *args)
     return 1;
 }
 
+/* parse a simulated stripe layout given as "size:count:osts",
+ * e.g., "1MB:4:16" for 4 stripes of 1MB over 16 OSTs */
+static int parse_stripe_sim(const char* str, mfu_copy_opts_t* mfu_copy_opts)
+{
+    int rc = MFU_FAILURE;
+    char* copy = MFU_STRDUP(str);
+    char* size_str  = strtok(copy, ":");
+    char* count_str = strtok(NULL, ":");
+    char* osts_str  = strtok(NULL, ":");
+
+    unsigned long long size;
+    if (osts_str != NULL && mfu_abtoull(size_str, &size) == MFU_SUCCESS) {
+        long long count = atoll(count_str);
+        long long osts  = atoll(osts_str);
+        if (size > 0 && count > 0 && osts > 0) {
+            mfu_copy_opts->stripe_sim_size  = (uint64_t) size;
+            mfu_copy_opts->stripe_sim_count = (uint64_t) count;
+            mfu_copy_opts->stripe_sim_osts  = (uint64_t) osts;
+            rc = MFU_SUCCESS;
+        }
+    }
+
+    mfu_free(&copy);
+    return rc;
+}
+
 /** Print a usage message. */
 void print_usage(void)
 {
@@ -157,6 +183,8 @@ void print_usage(void)
     /* printf("  -g, --grouplock <id> - use Lustre grouplock when reading/writing file\n"); */
 #endif
     printf("  -b, --blocksize     - IO buffer size in bytes (default 1MB)\n");
+    printf("      --bwlimit <SIZE>   - limit aggregate bandwidth to SIZE bytes per second\n");
+    printf("      --iopslimit <N>    - limit aggregate metadata operations to N per second\n");
     printf("      --daos-src-pool      - DAOS source pool \n");
     printf("      --daos-dst-pool      - DAOS destination pool \n");
     printf("      --daos-src-cont      - DAOS source container \n");
@@ -167,7 +195,12 @@ void print_usage(void)
     printf("  -k, --chunksize     - work size per task in bytes (default 1MB)\n");
     printf("  -p, --preserve      - preserve permissions, ownership, timestamps, extended attributes\n");
     printf("  -s, --synchronous   - use synchronous read/write calls (O_DIRECT)\n");
+    printf("      --adaptive-io   - use O_DIRECT for aligned blocks of large files and drop cached pages\n");
     printf("  -S, --sparse        - create sparse files when possible\n");
+    printf("      --preallocate   - allocate full size of destination files when created\n");
+    printf("      --stream        - start copying while source is still being walked\n");
+    printf("      --stripe-align  - cut chunks at stripe boundaries and spread copies over OSTs\n");
+    printf("      --stripe-sim <size:count:osts> - simulate striping for --stripe-align and print OST schedule\n");
     printf("      --progress <N>  - print progress every N seconds\n");
     printf("  -v, --verbose       - verbose output\n");
     printf("  -q, --quiet         - quiet output\n");
@@ -210,6 +243,9 @@ int main(int argc, char** argv)
     /* By default, don't have iput file. */
     char* inputname = NULL;
 
+    /* By default, walk the whole tree before copying */
+    int stream = 0;
+
 #ifdef DAOS_SUPPORT
     /* DAOS vars */ 
     daos_handle_t src_poh = DAOS_HDL_INVAL;
@@ -235,6 +271,8 @@ int main(int argc, char** argv)
     int option_index = 0;
     static struct option long_options[] = {
         {"blocksize"            , required_argument, 0, 'b'},
+        {"bwlimit"              , required_argument, 0, 'B'},
+        {"iopslimit"            , required_argument, 0, 'I'},
         {"debug"                , required_argument, 0, 'd'}, // undocumented
         {"grouplock"            , required_argument, 0, 'g'}, // untested
         {"daos-src-pool"        , required_argument, 0, 'x'},
@@ -247,7 +285,12 @@ int main(int argc, char** argv)
         {"chunksize"            , required_argument, 0, 'k'},
         {"preserve"             , no_argument      , 0, 'p'},
         {"synchronous"          , no_argument      , 0, 's'},
+        {"adaptive-io"          , no_argument      , 0, 'C'},
         {"sparse"               , no_argument      , 0, 'S'},
+        {"preallocate"          , no_argument      , 0, 'F'},
+        {"stream"               , no_argument      , 0, 'W'},
+        {"stripe-align"         , no_argument      , 0, 'A'},
+        {"stripe-sim"           , required_argument, 0, 'M'},
         {"progress"             , required_argument, 0, 'P'},
         {"verbose"              , no_argument      , 0, 'v'},
         {"quiet"                , no_argument      , 0, 'q'},
@@ -257,6 +300,7 @@ int main(int argc, char** argv)
 
     /* Parse options */
     unsigned long long bytes = 0;
+    char* endptr = NULL;
     int usage = 0;
     while(1) {
         int c = getopt_long(
@@ -280,6 +324,29 @@ int main(int argc, char** argv)
                     mfu_copy_opts->block_size = (size_t)bytes;
                 }
                 break;
+            case 'B':
+                if (mfu_abtoull(optarg, &bytes) != MFU_SUCCESS) {
+                    if (rank == 0) {
+                        MFU_LOG(MFU_LOG_ERR,
+                                "Failed to parse bandwidth limit: '%s'", optarg);
+                    }
+                    usage = 1;
+                } else {
+                    mfu_throttle_bytes = (uint64_t)bytes;
+                }
+                break;
+            case 'I':
+                errno = 0;
+                mfu_throttle_ops = (uint64_t) strtoull(optarg, &endptr, 10);
+                if (errno != 0 || endptr == optarg || *endptr != '\0' ||
+                    optarg[0] == '-' || mfu_throttle_ops == 0)
+                {
+                    if (rank == 0) {
+                        MFU_LOG(MFU_LOG_ERR, "Failed to parse --iopslimit, expected a count of at least 1: '%s'", optarg);
+                    }
+                    usage = 1;
+                }
+                break;
             case 'd':
                 if(strncmp(optarg, "fatal", 5) == 0) {
                     CIRCLE_debug = CIRCLE_LOG_FATAL;
@@ -407,12 +474,47 @@ int main(int argc, char** argv)
                     MFU_LOG(MFU_LOG_INFO, "Using synchronous read/write (O_DIRECT)");
                 }
                 break;
+            case 'C':
+                mfu_copy_opts->adaptive_io = true;
+                if(rank == 0) {
+                    MFU_LOG(MFU_LOG_INFO, "Using adaptive page cache I/O for large files");
+                }
+                break;
             case 'S':
                 mfu_copy_opts->sparse = 1;
                 if(rank == 0) {
                     MFU_LOG(MFU_LOG_INFO, "Using sparse file");
                 }
                 break;
+            case 'F':
+                mfu_copy_opts->preallocate = true;
+                if(rank == 0) {
+                    MFU_LOG(MFU_LOG_INFO, "Preallocating destination files");
+                }
+                break;
+            case 'W':
+                stream = 1;
+                if(rank == 0) {
+                    MFU_LOG(MFU_LOG_INFO, "Copying while walking");
+                }
+                break;
+            case 'A':
+                mfu_copy_opts->stripe_align = true;
+                if(rank == 0) {
+                    MFU_LOG(MFU_LOG_INFO, "Aligning chunks to stripes");
+                }
+                break;
+            case 'M':
+                if (parse_stripe_sim(optarg, mfu_copy_opts) != MFU_SUCCESS) {
+                    if (rank == 0) {
+                        MFU_LOG(MFU_LOG_ERR,
+                                "Failed to parse stripe simulation, expected size:count:osts: '%s'", optarg);
+                    }
+                    usage = 1;
+                } else {
+                    mfu_copy_opts->stripe_align = true;
+                }
+                break;
             case 'P':
                 mfu_progress_timeout = atoi(optarg);
                 break;
@@ -567,6 +669,14 @@ int main(int argc, char** argv)
         numpaths_src = numpaths - 1;
     }
 
+    /* streaming copies items as the walk finds them */
+    if (stream && inputname != NULL) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "Cannot use --stream with --input");
+        }
+        usage = 1;
+    }
+
     if (usage || numpaths_src == 0) {
         if(rank == 0) {
             if (usage != 1) {
@@ -606,26 +716,34 @@ int main(int argc, char** argv)
     /* create an empty file list */
     mfu_flist flist = mfu_flist_new();
 
-    if (inputname == NULL) {
-        /* if daos is set to SRC then use daos_ functions on walk */
-        mfu_flist_walk_param_paths(numpaths_src, paths, walk_opts, flist, mfu_src_file);
+    int tmp_rc;
+    if (stream) {
+        /* walk source and copy items into destination as they are found */
+        tmp_rc = mfu_flist_walk_copy(numpaths_src, paths, destpath, walk_opts,
+                                     flist, mfu_copy_opts, mfu_src_file,
+                                     mfu_dst_file);
     } else {
-        struct mfu_flist_skip_args skip_args;
+        if (inputname == NULL) {
+            /* if daos is set to SRC then use daos_ functions on walk */
+            mfu_flist_walk_param_paths(numpaths_src, paths, walk_opts, flist, mfu_src_file);
+        } else {
+            struct mfu_flist_skip_args skip_args;
 
-        /* otherwise, read list of files from input, but then stat each one */
-        mfu_flist input_flist = mfu_flist_new();
-        mfu_flist_read_cache(inputname, input_flist);
+            /* otherwise, read list of files from input, but then stat each one */
+            mfu_flist input_flist = mfu_flist_new();
+            mfu_flist_read_cache(inputname, input_flist);
 
-        skip_args.numpaths = numpaths_src;
-        skip_args.paths = paths;
-        mfu_flist_stat(input_flist, flist, input_flist_skip, (void *)&skip_args);
-        mfu_flist_free(&input_flist);
-    }
+            skip_args.numpaths = numpaths_src;
+            skip_args.paths = paths;
+            mfu_flist_stat(input_flist, flist, input_flist_skip, (void *)&skip_args);
+            mfu_flist_free(&input_flist);
+        }
 
-    /* copy flist into destination */ 
-    int tmp_rc = mfu_flist_copy(flist, numpaths_src, paths,
+        /* copy flist into destination */ 
+        tmp_rc = mfu_flist_copy(flist, numpaths_src, paths,
                                 destpath, mfu_copy_opts, mfu_src_file,
                                 mfu_dst_file);
+    }
     if (tmp_rc < 0) {
         /* hit some sort of error during copy */
         rc = 1;
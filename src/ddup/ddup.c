@@ -4,6 +4,10 @@
 #include <openssl/sha.h>
 #include <assert.h>
 #include <inttypes.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
 #include "mpi.h"
 #include "dtcmp.h"
 #include "mfu.h"
@@ -13,9 +17,28 @@
  * 1 for group ID + (SHA256_DIGEST_LENGTH / 8) */
 #define DDUP_KEY_SIZE 5
 
-/* amount of data to read in order to compute hash */
+/* size of the blocks read by the probe, and of each read when hashing */
 #define DDUP_CHUNK_SIZE 1048576
 
+/* size of the leaves of a tree digest, the unit of work when
+ * spreading the data of large files over ranks */
+#define DDUP_LEAF_SIZE (16 * 1048576)
+
+/* max number of bytes to pass to one FIDEDUPERANGE call,
+ * file systems cap the length of a single request */
+#define DDUP_DEDUPE_BYTES (16 * 1048576)
+
+/* probe algorithm recorded in a cache value when it holds no probe */
+#define DDUP_CACHE_NO_PROBE UINT64_MAX
+
+/* what to do with the duplicates in each group */
+typedef enum {
+    DDUP_ACTION_NONE = 0, /* only report duplicates */
+    DDUP_ACTION_HARDLINK, /* replace duplicates with hard links to the keeper */
+    DDUP_ACTION_REFLINK,  /* replace duplicates with clones of the keeper */
+    DDUP_ACTION_DEDUPE,   /* share extents of the keeper with duplicates in place */
+} ddup_action;
+
 /* Print a usage message */
 static void print_usage(void)
 {
@@ -23,6 +46,9 @@ static void print_usage(void)
     printf("Usage: ddup <dir>\n");
     printf("\n");
     printf("Options:\n");
+    printf("  -a, --action <NAME>  - act on duplicates, one of: hardlink,reflink,dedupe-range\n");
+    printf("  -C, --cache <FILE>   - reuse digests of unchanged files recorded in FILE\n");
+    printf("  -D, --digest <NAME>  - find candidates with a faster hash, one of: murmur3,fast\n");
     printf("  -d, --debug <DEBUG>  - set verbosity, one of: fatal,err,warn,info,dbg\n");
     printf("  -v, --verbose        - verbose output\n");
     printf("  -q, --quiet          - quiet output\n");
@@ -76,74 +102,277 @@ static void mtcmp_cmp_fini(DTCMP_Op* cmp)
     DTCMP_Op_free(cmp);
 }
 
-/* open the specified file, read specified chunk, and close file,
- * returns -1 on any read error */
-static int read_data(const char* fname, char* chunk_buf, uint64_t chunk_id,
-                     uint64_t chunk_size, uint64_t file_size,
-                     uint64_t* data_size)
+/* hash state, either SHA256 or one of the faster mfu_digest
+ * algorithms, which fill the first two words of a key */
+struct ddup_hash {
+    const mfu_digest_alg* alg; /* digest algorithm, NULL for SHA256 */
+    SHA256_CTX sha;
+    mfu_digest_ctx digest;
+};
+
+static void ddup_hash_init(struct ddup_hash* h, const mfu_digest_alg* alg)
 {
-    int status = 0;
+    h->alg = alg;
+    if (alg == NULL) {
+        SHA256_Init(&h->sha);
+    } else {
+        mfu_digest_init(&h->digest, *alg);
+    }
+}
+
+static void ddup_hash_update(struct ddup_hash* h, const void* buf, size_t len)
+{
+    if (h->alg == NULL) {
+        SHA256_Update(&h->sha, buf, len);
+    } else {
+        mfu_digest_update(&h->digest, buf, len);
+    }
+}
+
+/* store the final hash in the last (DDUP_KEY_SIZE - 1) words of a key */
+static void ddup_hash_final(struct ddup_hash* h, uint64_t* key)
+{
+    if (h->alg == NULL) {
+        SHA256_Final((unsigned char*)key, &h->sha);
+    } else {
+        mfu_digest_value value;
+        mfu_digest_final(&h->digest, &value);
+        memset(key, 0, (DDUP_KEY_SIZE - 1) * sizeof(uint64_t));
+        key[0] = value.h[0];
+        key[1] = value.h[1];
+    }
+}
+
+/* read length bytes starting at offset from an open file
+ * and add them to the hash, returns -1 on any read error,
+ * including a file that is shorter than expected */
+static int hash_range(const char* fname, int fd, uint64_t offset,
+                      uint64_t length, char* buf, struct ddup_hash* h)
+{
+    /* seek to the correct offset */
+    if (mfu_lseek(fname, fd, (off_t)offset, SEEK_SET) == (off_t) - 1) {
+        return -1;
+    }
+
+    /* stream data through the buffer until we have it all */
+    while (length > 0) {
+        size_t bytes = DDUP_CHUNK_SIZE;
+        if ((uint64_t)bytes > length) {
+            bytes = (size_t) length;
+        }
 
-    assert(chunk_id > 0);
+        ssize_t read_size = mfu_read(fname, fd, buf, bytes);
+        if (read_size != (ssize_t) bytes) {
+            /* read failed or file size has been changed */
+            return -1;
+        }
 
-    /* compute byte offset to read from in file */
-    uint64_t offset = (chunk_id - 1) * chunk_size;
+        ddup_hash_update(h, buf, bytes);
+        length -= (uint64_t) bytes;
+    }
 
-    /* zero out our buffer */
-    memset(chunk_buf, 0, chunk_size);
+    return 0;
+}
 
-    /* open the file */
+/* compute a cheap hash of a file from its first and last blocks
+ * with the given algorithm, or SHA256 if alg is NULL, for a file no
+ * larger than one block this is the hash of the whole file,
+ * returns -1 on any read error */
+static int probe_file(const char* fname, uint64_t file_size,
+                      const mfu_digest_alg* alg, char* buf, uint64_t* key)
+{
     int fd = mfu_open(fname, O_RDONLY);
     if (fd < 0) {
         return -1;
     }
 
-    /* seek to the correct offset */
-    if (mfu_lseek(fname, fd, (off_t)offset, SEEK_SET) == (off_t) - 1) {
-        status = -1;
-        goto out;
-    }
+    struct ddup_hash h;
+    ddup_hash_init(&h, alg);
 
-    /* read data from file */
-    ssize_t read_size = mfu_read(fname, fd, chunk_buf, chunk_size);
-    if (read_size < 0) {
-        /* read failed */
-        status = -1;
-        goto out;
+    /* hash the first block */
+    uint64_t head = file_size;
+    if (head > DDUP_CHUNK_SIZE) {
+        head = DDUP_CHUNK_SIZE;
     }
+    int status = hash_range(fname, fd, 0, head, buf, &h);
 
-    /* compute number of bytes we expect to read */
-    ssize_t expect_size = (ssize_t) chunk_size;
-    if (chunk_id * chunk_size > file_size) {
-        if (offset >= file_size) {
-          /* have gone past the end of the file, expect to read 0 */
-          expect_size = 0;
-        } else {
-          /* read partial chunk */
-          expect_size = (ssize_t) (file_size - offset);
+    /* hash the last block, without reading any bytes twice */
+    if (status == 0 && file_size > head) {
+        uint64_t tail = file_size - DDUP_CHUNK_SIZE;
+        if (tail < head) {
+            tail = head;
         }
+        status = hash_range(fname, fd, tail, file_size - tail, buf, &h);
     }
 
-    /* check that we read all bytes we expected */
-    if (read_size != expect_size) {
-        /* File size has been changed */
-        status = -1;
-        goto out;
+    ddup_hash_final(&h, key);
+
+    mfu_close(fname, fd);
+    return status;
+}
+
+/* compute the SHA256 of a whole file, opening it once and
+ * reading it from start to end, returns -1 on any read error */
+static int hash_file(const char* fname, uint64_t file_size,
+                     char* buf, uint64_t* key)
+{
+    int fd = mfu_open(fname, O_RDONLY);
+    if (fd < 0) {
+        return -1;
     }
 
-    /* return number of bytes read */
-    *data_size = (uint64_t)read_size;
+    posix_fadvise(fd, 0, (off_t)file_size, POSIX_FADV_SEQUENTIAL);
+
+    struct ddup_hash h;
+    ddup_hash_init(&h, NULL);
+    int status = hash_range(fname, fd, 0, file_size, buf, &h);
+    ddup_hash_final(&h, key);
 
-out:
-    /* close our file and return */
     mfu_close(fname, fd);
     return status;
 }
 
-struct file_item {
-    SHA256_CTX ctx;
+/* map function for mfu_flist_remap, args holds the rank for each item */
+static int map_to_rank(mfu_flist flist, uint64_t idx, int ranks, const void* args)
+{
+    const int* dest = (const int*) args;
+    return dest[idx];
+}
+
+/* redistribute files in list so that each rank holds about the
+ * same number of bytes, a file is assigned to the rank whose share
+ * of the global byte range holds the middle of that file */
+static mfu_flist spread_by_bytes(mfu_flist flist)
+{
+    uint64_t idx;
+
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* sum up bytes in our part of the list */
+    uint64_t size = mfu_flist_size(flist);
+    uint64_t bytes = 0;
+    for (idx = 0; idx < size; idx++) {
+        bytes += mfu_flist_file_get_size(flist, idx);
+    }
+
+    /* get offset of our first byte and total bytes in the list */
+    uint64_t offset = 0;
+    uint64_t total;
+    MPI_Exscan(&bytes, &offset, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(&bytes, &total, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) {
+        offset = 0;
+    }
+
+    /* pick a rank for each file */
+    int* dest = (int*) MFU_MALLOC(size * sizeof(int));
+    for (idx = 0; idx < size; idx++) {
+        uint64_t file_size = mfu_flist_file_get_size(flist, idx);
+        double middle = (double)offset + (double)file_size / 2.0;
+        int r = (int)(middle / (double)total * (double)ranks);
+        if (r >= ranks) {
+            r = ranks - 1;
+        }
+        dest[idx] = r;
+        offset += file_size;
+    }
+
+    mfu_flist newlist = mfu_flist_remap(flist, map_to_rank, dest);
+
+    mfu_free(&dest);
+    return newlist;
+}
+
+/* digests of a file recorded in the digest cache */
+struct ddup_cache_value {
+    uint64_t probe_alg;                         /* probe algorithm, see probe_tag */
+    uint64_t probe[DDUP_KEY_SIZE - 1];          /* probe digest */
+    uint64_t have_full;                         /* whether full holds a value */
+    uint64_t full[DDUP_KEY_SIZE - 1];           /* SHA256 of the whole file */
 };
 
+/* value recorded in the cache for probes computed with the
+ * given algorithm, 0 for SHA256 */
+static uint64_t probe_tag(const mfu_digest_alg* alg)
+{
+    if (alg == NULL) {
+        return 0;
+    }
+    return 1 + (uint64_t) *alg;
+}
+
+/* look up the cache records of count files of flist given by their
+ * indices, found[i] is set to 1 if a record was found, 0 if not, and
+ * -1 if the file could not be stat'd, returns number of records found,
+ * must be called by all ranks */
+static uint64_t cache_lookup(mfu_digestcache* dc, mfu_flist flist,
+                             uint64_t count, const uint64_t* idxs,
+                             uint64_t* keys, struct ddup_cache_value* values,
+                             int* found)
+{
+    uint64_t i;
+
+    /* the file list does not hold device and inode numbers,
+     * so build each key from a fresh lstat */
+    int* statted = (int*) MFU_MALLOC(count * sizeof(int));
+    for (i = 0; i < count; i++) {
+        uint64_t* key = keys + i * MFU_DIGESTCACHE_KEY_VALUES;
+        memset(key, 0, MFU_DIGESTCACHE_KEY_VALUES * sizeof(uint64_t));
+
+        struct stat st;
+        const char* fname = mfu_flist_file_get_name(flist, idxs[i]);
+        statted[i] = (mfu_lstat(fname, &st) == 0);
+        if (statted[i]) {
+            mfu_digestcache_key(&st, key);
+        }
+    }
+
+    mfu_digestcache_lookup(dc, count, keys, values, found);
+
+    uint64_t hits = 0;
+    for (i = 0; i < count; i++) {
+        if (! statted[i]) {
+            found[i] = -1;
+        } else if (found[i]) {
+            hits++;
+        }
+    }
+
+    mfu_free(&statted);
+    return hits;
+}
+
+/* add cache records of the files whose dirty flag is set,
+ * must be called by all ranks */
+static void cache_store(mfu_digestcache* dc, uint64_t count,
+                        const uint64_t* keys,
+                        const struct ddup_cache_value* values,
+                        const int* dirty)
+{
+    uint64_t* store_keys = (uint64_t*) MFU_MALLOC(count * MFU_DIGESTCACHE_KEY_VALUES * sizeof(uint64_t));
+    struct ddup_cache_value* store_values = (struct ddup_cache_value*)
+        MFU_MALLOC(count * sizeof(struct ddup_cache_value));
+
+    uint64_t i;
+    uint64_t n = 0;
+    for (i = 0; i < count; i++) {
+        if (dirty[i]) {
+            memcpy(store_keys + n * MFU_DIGESTCACHE_KEY_VALUES,
+                   keys + i * MFU_DIGESTCACHE_KEY_VALUES,
+                   MFU_DIGESTCACHE_KEY_VALUES * sizeof(uint64_t));
+            store_values[n] = values[i];
+            n++;
+        }
+    }
+
+    mfu_digestcache_store(dc, n, store_keys, store_values);
+
+    mfu_free(&store_values);
+    mfu_free(&store_keys);
+}
+
 /* print SHA256 value to stdout */
 static void dump_sha256_digest(char* digest_string, unsigned char digest[])
 {
@@ -153,16 +382,664 @@ static void dump_sha256_digest(char* digest_string, unsigned char digest[])
     }
 }
 
+/* duplicate files found on this rank, recorded when acting on groups */
+struct ddup_dup {
+    uint64_t size;                                      /* file size */
+    unsigned char digest[SHA256_DIGEST_LENGTH];         /* SHA256 of file */
+    const char* name;                                   /* path to file */
+};
+
+struct ddup_dups {
+    uint64_t count;
+    uint64_t capacity;
+    struct ddup_dup* items;
+};
+
+/* print a duplicate file and its SHA256 to stdout,
+ * and record it if dups is not NULL */
+static void report_dup(struct ddup_dups* dups, const char* fname,
+                       uint64_t file_size, const uint64_t* digest)
+{
+    char digest_string[SHA256_DIGEST_LENGTH * 2 + 1];
+    dump_sha256_digest(digest_string, (unsigned char*)digest);
+    printf("%s %s\n", fname, digest_string);
+
+    if (dups == NULL) {
+        return;
+    }
+
+    if (dups->count == dups->capacity) {
+        dups->capacity = (dups->capacity == 0) ? 1024 : dups->capacity * 2;
+        dups->items = (struct ddup_dup*) realloc(dups->items,
+            dups->capacity * sizeof(struct ddup_dup));
+        if (dups->items == NULL) {
+            MFU_ABORT(1, "Failed to allocate memory for duplicate list");
+        }
+    }
+
+    struct ddup_dup* d = &dups->items[dups->count];
+    d->size = file_size;
+    memcpy(d->digest, digest, SHA256_DIGEST_LENGTH);
+    d->name = fname;
+    dups->count++;
+}
+
+/* order duplicates by size and digest, so that each group is
+ * contiguous, then by name, so that the keeper is always the
+ * first path in sort order */
+static int dup_cmp(const void* a, const void* b)
+{
+    const struct ddup_dup* da = (const struct ddup_dup*) a;
+    const struct ddup_dup* db = (const struct ddup_dup*) b;
+    if (da->size != db->size) {
+        return (da->size < db->size) ? -1 : 1;
+    }
+    int cmp = memcmp(da->digest, db->digest, SHA256_DIGEST_LENGTH);
+    if (cmp != 0) {
+        return cmp;
+    }
+    return strcmp(da->name, db->name);
+}
+
+/* build a name for a temporary file next to path */
+static char* tmp_name(const char* path)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    size_t len = strlen(path) + 32;
+    char* tmp = (char*) MFU_MALLOC(len);
+    snprintf(tmp, len, "%s.ddup.%d", path, rank);
+    return tmp;
+}
+
+/* replace dup with a hard link to keep, returns 0 on success */
+static int action_hardlink(const char* keep, const char* dup)
+{
+    /* link to a temporary name and rename it over the duplicate,
+     * so that the path always refers to one of the two files */
+    char* tmp = tmp_name(dup);
+    int rc = mfu_hardlink(keep, tmp);
+    if (rc != 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to link `%s' to `%s' (errno=%d %s)",
+            tmp, keep, errno, strerror(errno));
+    } else if (rename(tmp, dup) != 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to rename `%s' to `%s' (errno=%d %s)",
+            tmp, dup, errno, strerror(errno));
+        mfu_unlink(tmp);
+        rc = -1;
+    }
+
+    mfu_free(&tmp);
+    return rc;
+}
+
+/* replace dup with a clone of keep that shares its extents and
+ * carries the owner, mode, and timestamps of dup, returns 0 on success */
+static int action_reflink(const char* keep, const char* dup,
+                          const struct stat* dup_st)
+{
+#ifdef FICLONE
+    int keep_fd = mfu_open(keep, O_RDONLY);
+    if (keep_fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open `%s' (errno=%d %s)",
+            keep, errno, strerror(errno));
+        return -1;
+    }
+
+    char* tmp = tmp_name(dup);
+    int fd = mfu_open(tmp, O_WRONLY | O_CREAT | O_EXCL, dup_st->st_mode & 07777);
+    if (fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to create `%s' (errno=%d %s)",
+            tmp, errno, strerror(errno));
+        mfu_free(&tmp);
+        mfu_close(keep, keep_fd);
+        return -1;
+    }
+
+    int rc = 0;
+    if (ioctl(fd, FICLONE, keep_fd) != 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to clone `%s' to `%s' (errno=%d %s)",
+            keep, tmp, errno, strerror(errno));
+        rc = -1;
+    }
+
+    /* give the clone the metadata of the file it replaces, the clone
+     * is created with our own owner, so keep dup if it can not be
+     * given back to the owner of dup, only root may give a file away */
+    if (rc == 0 && fchown(fd, dup_st->st_uid, dup_st->st_gid) != 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to change owner of `%s' (errno=%d %s)",
+            tmp, errno, strerror(errno));
+        rc = -1;
+    }
+    if (rc == 0) {
+        if (fchmod(fd, dup_st->st_mode & 07777) != 0) {
+            MFU_LOG(MFU_LOG_WARN, "Failed to change mode of `%s' (errno=%d %s)",
+                tmp, errno, strerror(errno));
+        }
+        struct timespec times[2];
+        times[0].tv_sec  = dup_st->st_atim.tv_sec;
+        times[0].tv_nsec = dup_st->st_atim.tv_nsec;
+        times[1].tv_sec  = dup_st->st_mtim.tv_sec;
+        times[1].tv_nsec = dup_st->st_mtim.tv_nsec;
+        if (futimens(fd, times) != 0) {
+            MFU_LOG(MFU_LOG_WARN, "Failed to change timestamps of `%s' (errno=%d %s)",
+                tmp, errno, strerror(errno));
+        }
+    }
+
+    mfu_close(tmp, fd);
+    mfu_close(keep, keep_fd);
+
+    if (rc == 0 && rename(tmp, dup) != 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to rename `%s' to `%s' (errno=%d %s)",
+            tmp, dup, errno, strerror(errno));
+        rc = -1;
+    }
+    if (rc != 0) {
+        mfu_unlink(tmp);
+    }
+
+    mfu_free(&tmp);
+    return rc;
+#else
+    MFU_LOG(MFU_LOG_ERR, "Cloning files is not supported on this system");
+    return -1;
+#endif
+}
+
+#ifdef FS_IOC_FIEMAP
+/* number of extents to request from FIEMAP at a time */
+#define DDUP_FIEMAP_EXTENTS 256
+
+/* count the bytes in the first length bytes of the file open as fd
+ * that are stored in extents not shared with any other file,
+ * returns 0 on success */
+static int unshared_bytes(const char* path, int fd, uint64_t length, uint64_t* bytes)
+{
+    *bytes = 0;
+
+    size_t size = sizeof(struct fiemap) +
+        DDUP_FIEMAP_EXTENTS * sizeof(struct fiemap_extent);
+    struct fiemap* map = (struct fiemap*) MFU_MALLOC(size);
+
+    int rc = 0;
+    uint64_t start = 0;
+    int last = 0;
+    while (! last && start < length) {
+        memset(map, 0, size);
+        map->fm_start        = start;
+        map->fm_length       = length - start;
+        map->fm_flags        = FIEMAP_FLAG_SYNC;
+        map->fm_extent_count = DDUP_FIEMAP_EXTENTS;
+        if (ioctl(fd, FS_IOC_FIEMAP, map) != 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to map extents of `%s' (errno=%d %s)",
+                path, errno, strerror(errno));
+            rc = -1;
+            break;
+        }
+        if (map->fm_mapped_extents == 0) {
+            break;
+        }
+
+        uint32_t i;
+        for (i = 0; i < map->fm_mapped_extents; i++) {
+            struct fiemap_extent* ext = &map->fm_extents[i];
+            if (ext->fe_flags & FIEMAP_EXTENT_LAST) {
+                last = 1;
+            }
+
+            /* clip the extent to the range we were asked about */
+            uint64_t ext_start = ext->fe_logical;
+            uint64_t ext_end   = ext->fe_logical + ext->fe_length;
+            if (ext_start < start) {
+                ext_start = start;
+            }
+            if (ext_end > length) {
+                ext_end = length;
+            }
+            if (ext_end > ext_start && ! (ext->fe_flags & FIEMAP_EXTENT_SHARED)) {
+                *bytes += ext_end - ext_start;
+            }
+            start = ext->fe_logical + ext->fe_length;
+        }
+    }
+
+    mfu_free(&map);
+    return rc;
+}
+#endif
+
+/* ask the file system to share the extents of keep with dup, which
+ * it only does for ranges whose bytes it finds to be identical, this
+ * keeps dup in place with all of its metadata, sets deduped to the
+ * number of bytes of dup that were not shared before and now are,
+ * returns 0 on success */
+static int action_dedupe(const char* keep, const char* dup,
+                         uint64_t file_size, uint64_t* deduped)
+{
+    *deduped = 0;
+
+#ifdef FIDEDUPERANGE
+    int keep_fd = mfu_open(keep, O_RDONLY);
+    if (keep_fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open `%s' (errno=%d %s)",
+            keep, errno, strerror(errno));
+        return -1;
+    }
+
+    int dup_fd = mfu_open(dup, O_RDWR);
+    if (dup_fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open `%s' (errno=%d %s)",
+            dup, errno, strerror(errno));
+        mfu_close(keep, keep_fd);
+        return -1;
+    }
+
+    /* the file system reports ranges it already shared as deduplicated,
+     * so only count the bytes of dup that have no other owner yet */
+    uint64_t unshared = file_size;
+#ifdef FS_IOC_FIEMAP
+    if (unshared_bytes(dup, dup_fd, file_size, &unshared) != 0) {
+        mfu_close(dup, dup_fd);
+        mfu_close(keep, keep_fd);
+        return -1;
+    }
+#endif
+
+    struct file_dedupe_range* range = (struct file_dedupe_range*) MFU_MALLOC(
+        sizeof(struct file_dedupe_range) + sizeof(struct file_dedupe_range_info));
+
+    int rc = 0;
+    uint64_t offset = 0;
+    while (offset < file_size) {
+        uint64_t length = file_size - offset;
+        if (length > DDUP_DEDUPE_BYTES) {
+            length = DDUP_DEDUPE_BYTES;
+        }
+
+        memset(range, 0, sizeof(struct file_dedupe_range) + sizeof(struct file_dedupe_range_info));
+        range->src_offset = offset;
+        range->src_length = length;
+        range->dest_count = 1;
+        range->info[0].dest_fd     = dup_fd;
+        range->info[0].dest_offset = offset;
+
+        if (ioctl(keep_fd, FIDEDUPERANGE, range) != 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to dedupe `%s' against `%s' (errno=%d %s)",
+                dup, keep, errno, strerror(errno));
+            rc = -1;
+            break;
+        }
+
+        struct file_dedupe_range_info* info = &range->info[0];
+        if (info->status == FILE_DEDUPE_RANGE_DIFFERS) {
+            MFU_LOG(MFU_LOG_ERR, "Contents of `%s' differ from `%s' at offset %" PRIu64,
+                dup, keep, offset);
+            rc = -1;
+            break;
+        }
+        if (info->status < 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to dedupe `%s' against `%s' (errno=%d %s)",
+                dup, keep, -info->status, strerror(-info->status));
+            rc = -1;
+            break;
+        }
+        if (info->bytes_deduped == 0) {
+            /* no progress, avoid looping forever */
+            MFU_LOG(MFU_LOG_ERR, "Failed to dedupe `%s' against `%s' at offset %" PRIu64,
+                dup, keep, offset);
+            rc = -1;
+            break;
+        }
+
+        offset += info->bytes_deduped;
+    }
+
+    /* dedupe only returns once every range is shared with keep */
+    if (rc == 0) {
+        *deduped = unshared;
+    }
+
+    mfu_free(&range);
+    mfu_close(dup, dup_fd);
+    mfu_close(keep, keep_fd);
+    return rc;
+#else
+    MFU_LOG(MFU_LOG_ERR, "Deduplicating file ranges is not supported on this system");
+    return -1;
+#endif
+}
+
+/* check that dup still matches keep before replacing it, returns 1 if
+ * dup is safe to act on, 0 if it is already the same file as keep,
+ * and -1 if it changed or could not be checked */
+static int verify_dup(const char* keep, const char* dup, uint64_t file_size,
+                      const struct stat* keep_st, const struct stat* dup_st,
+                      ddup_action action)
+{
+    /* nothing to do if both paths already refer to the same file */
+    if (keep_st->st_dev == dup_st->st_dev && keep_st->st_ino == dup_st->st_ino) {
+        return 0;
+    }
+
+    if (! S_ISREG(dup_st->st_mode) || (uint64_t)dup_st->st_size != file_size ||
+        ! S_ISREG(keep_st->st_mode) || (uint64_t)keep_st->st_size != file_size)
+    {
+        MFU_LOG(MFU_LOG_ERR, "Skipping `%s', it or `%s' changed since it was hashed",
+            dup, keep);
+        return -1;
+    }
+
+    if (keep_st->st_dev != dup_st->st_dev && action != DDUP_ACTION_DEDUPE) {
+        MFU_LOG(MFU_LOG_ERR, "Skipping `%s', it is on a different file system than `%s'",
+            dup, keep);
+        return -1;
+    }
+
+    /* a hard link gives the duplicate the owner and permissions of the
+     * kept file, so only link files that already agree on them */
+    if (action == DDUP_ACTION_HARDLINK &&
+        (keep_st->st_uid != dup_st->st_uid || keep_st->st_gid != dup_st->st_gid ||
+         (keep_st->st_mode & 07777) != (dup_st->st_mode & 07777)))
+    {
+        MFU_LOG(MFU_LOG_ERR, "Skipping `%s', its owner or mode differs from `%s'",
+            dup, keep);
+        return -1;
+    }
+
+    /* the file system compares bytes itself when deduplicating ranges */
+    if (action == DDUP_ACTION_DEDUPE) {
+        return 1;
+    }
+
+    uint64_t bytes_read = 0;
+    uint64_t bytes_written = 0;
+    off_t diff_offset = -1;
+    int rc = mfu_compare_contents(keep, dup, 0, (off_t)file_size, DDUP_CHUNK_SIZE, 0,
+        &bytes_read, &bytes_written, &diff_offset, NULL);
+    if (rc != 0) {
+        MFU_LOG(MFU_LOG_ERR, "Skipping `%s', its contents no longer match `%s'",
+            dup, keep);
+        return -1;
+    }
+
+    return 1;
+}
+
+/* act on the duplicates in one group, where dups[0] is kept,
+ * adds to counts of files replaced and failed, and to bytes reclaimed */
+static void act_group(const struct ddup_dup* dups, uint64_t count, ddup_action action,
+                      uint64_t* replaced, uint64_t* failed, uint64_t* reclaimed)
+{
+    const char* keep = dups[0].name;
+    uint64_t file_size = dups[0].size;
+
+    uint64_t group_replaced = 0;
+    uint64_t group_reclaimed = 0;
+
+    struct stat keep_st;
+    if (mfu_lstat(keep, &keep_st) != 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to stat `%s' (errno=%d %s)",
+            keep, errno, strerror(errno));
+        *failed += count - 1;
+        return;
+    }
+
+    uint64_t i;
+    for (i = 1; i < count; i++) {
+        const char* dup = dups[i].name;
+
+        struct stat dup_st;
+        if (mfu_lstat(dup, &dup_st) != 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to stat `%s' (errno=%d %s)",
+                dup, errno, strerror(errno));
+            (*failed)++;
+            continue;
+        }
+
+        int verified = verify_dup(keep, dup, file_size, &keep_st, &dup_st, action);
+        if (verified == 0) {
+            continue;
+        }
+        if (verified < 0) {
+            (*failed)++;
+            continue;
+        }
+
+        /* blocks of a replaced file are freed unless another link holds them */
+        uint64_t freed = 0;
+        if (dup_st.st_nlink == 1) {
+            freed = (uint64_t)dup_st.st_blocks * 512;
+        }
+
+        int rc;
+        if (action == DDUP_ACTION_HARDLINK) {
+            rc = action_hardlink(keep, dup);
+        } else if (action == DDUP_ACTION_REFLINK) {
+            rc = action_reflink(keep, dup, &dup_st);
+        } else {
+            rc = action_dedupe(keep, dup, file_size, &freed);
+        }
+
+        if (rc != 0) {
+            (*failed)++;
+            continue;
+        }
+
+        group_replaced++;
+        group_reclaimed += freed;
+    }
+
+    double val;
+    const char* units;
+    mfu_format_bytes(group_reclaimed, &val, &units);
+    MFU_LOG(MFU_LOG_INFO, "Kept `%s', replaced %" PRIu64 " of %" PRIu64
+        " duplicates, reclaimed %.3lf %s",
+        keep, group_replaced, count - 1, val, units);
+
+    *replaced  += group_replaced;
+    *reclaimed += group_reclaimed;
+}
+
+/* gather each group of duplicates on a single rank, picked by hashing
+ * the group's size and digest, and act on all groups in parallel,
+ * then print totals, returns 0 on success and -1 if any duplicate
+ * could not be replaced, must be called by all ranks */
+static int act_on_dups(struct ddup_dups* dups, ddup_action action)
+{
+    uint64_t i;
+
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* pack each record as size, digest, and NUL-terminated name,
+     * sorted by the rank that owns its group */
+    int* sendcounts = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* recvcounts = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* senddisps  = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* recvdisps  = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* owner = (int*) MFU_MALLOC(dups->count * sizeof(int));
+    int r;
+    for (r = 0; r < ranks; r++) {
+        sendcounts[r] = 0;
+    }
+
+    size_t header = 8 + SHA256_DIGEST_LENGTH;
+    for (i = 0; i < dups->count; i++) {
+        const struct ddup_dup* d = &dups->items[i];
+        uint32_t hash = mfu_hash_jenkins((const char*)d->digest, SHA256_DIGEST_LENGTH);
+        owner[i] = (int)((hash ^ (uint32_t)d->size) % (uint32_t)ranks);
+        sendcounts[owner[i]] += (int)(header + strlen(d->name) + 1);
+    }
+
+    int sendbytes = 0;
+    for (r = 0; r < ranks; r++) {
+        senddisps[r] = sendbytes;
+        sendbytes += sendcounts[r];
+    }
+
+    char* sendbuf = (char*) MFU_MALLOC((size_t)sendbytes);
+    int* offsets = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    for (r = 0; r < ranks; r++) {
+        offsets[r] = senddisps[r];
+    }
+    for (i = 0; i < dups->count; i++) {
+        const struct ddup_dup* d = &dups->items[i];
+        char* ptr = sendbuf + offsets[owner[i]];
+        mfu_pack_uint64(&ptr, d->size);
+        memcpy(ptr, d->digest, SHA256_DIGEST_LENGTH);
+        ptr += SHA256_DIGEST_LENGTH;
+        strcpy(ptr, d->name);
+        offsets[owner[i]] += (int)(header + strlen(d->name) + 1);
+    }
+
+    MPI_Alltoall(sendcounts, 1, MPI_INT, recvcounts, 1, MPI_INT, MPI_COMM_WORLD);
+    int recvbytes = 0;
+    for (r = 0; r < ranks; r++) {
+        recvdisps[r] = recvbytes;
+        recvbytes += recvcounts[r];
+    }
+    char* recvbuf = (char*) MFU_MALLOC((size_t)recvbytes);
+    MPI_Alltoallv(sendbuf, sendcounts, senddisps, MPI_BYTE,
+                  recvbuf, recvcounts, recvdisps, MPI_BYTE, MPI_COMM_WORLD);
+
+    mfu_free(&offsets);
+    mfu_free(&sendbuf);
+    mfu_free(&owner);
+
+    /* unpack records of the groups we own, names point into recvbuf */
+    uint64_t count = 0;
+    const char* ptr = recvbuf;
+    while (ptr < recvbuf + recvbytes) {
+        ptr += header;
+        ptr += strlen(ptr) + 1;
+        count++;
+    }
+
+    struct ddup_dup* items = (struct ddup_dup*) MFU_MALLOC(count * sizeof(struct ddup_dup));
+    ptr = recvbuf;
+    for (i = 0; i < count; i++) {
+        mfu_unpack_uint64(&ptr, &items[i].size);
+        memcpy(items[i].digest, ptr, SHA256_DIGEST_LENGTH);
+        ptr += SHA256_DIGEST_LENGTH;
+        items[i].name = ptr;
+        ptr += strlen(ptr) + 1;
+    }
+    qsort(items, (size_t)count, sizeof(struct ddup_dup), dup_cmp);
+
+    /* act on each group */
+    uint64_t counts[4] = {0, 0, 0, 0}; /* groups, replaced, failed, reclaimed */
+    uint64_t start = 0;
+    while (start < count) {
+        uint64_t end = start + 1;
+        while (end < count && items[end].size == items[start].size &&
+               memcmp(items[end].digest, items[start].digest, SHA256_DIGEST_LENGTH) == 0)
+        {
+            end++;
+        }
+
+        act_group(&items[start], end - start, action, &counts[1], &counts[2], &counts[3]);
+        counts[0]++;
+
+        start = end;
+    }
+
+    mfu_free(&items);
+    mfu_free(&recvbuf);
+    mfu_free(&recvdisps);
+    mfu_free(&senddisps);
+    mfu_free(&recvcounts);
+    mfu_free(&sendcounts);
+
+    /* print totals */
+    uint64_t all_counts[4];
+    MPI_Allreduce(counts, all_counts, 4, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) {
+        double val;
+        const char* units;
+        mfu_format_bytes(all_counts[3], &val, &units);
+        MFU_LOG(MFU_LOG_INFO, "Replaced %" PRIu64 " duplicates in %" PRIu64
+            " groups, reclaimed %.3lf %s, %" PRIu64 " failed",
+            all_counts[1], all_counts[0], val, units, all_counts[2]);
+    }
+
+    return (all_counts[2] == 0) ? 0 : -1;
+}
+
+/* compute a tree digest of each file in tree_list with alg, spreading
+ * the leaves of all files evenly over ranks so that even a single
+ * large file is read in parallel, then copy each file that has the
+ * same size and tree digest as another file to match_list */
+static void tree_filter(mfu_flist tree_list, mfu_digest_alg alg,
+                        mfu_flist match_list, MPI_Datatype key,
+                        MPI_Datatype keysat, DTCMP_Op cmp)
+{
+    uint64_t i;
+
+    /* hash each leaf, errors are logged as files are read */
+    mfu_blockhash* bh = mfu_blockhash_new(tree_list, DDUP_LEAF_SIZE, alg);
+    uint64_t bytes_read = 0;
+    mfu_blockhash_compute(bh, DDUP_CHUNK_SIZE, &bytes_read, NULL);
+
+    /* combine leaves of each file into a key of (size, tree digest) */
+    uint64_t size = mfu_flist_size(tree_list);
+    uint64_t* list = (uint64_t*) MFU_MALLOC(size * (DDUP_KEY_SIZE + 1) * sizeof(uint64_t));
+    uint64_t count = 0;
+    uint64_t* ptr = list;
+    for (i = 0; i < size; i++) {
+        const mfu_blockhash_digest* leaves = mfu_blockhash_get(bh, i);
+        if (leaves == NULL) {
+            continue;
+        }
+
+        uint64_t file_size = mfu_flist_file_get_size(tree_list, i);
+        mfu_digest_value value;
+        mfu_digest_tree_combine(alg, DDUP_LEAF_SIZE, file_size, leaves, &value);
+
+        memset(ptr, 0, DDUP_KEY_SIZE * sizeof(uint64_t));
+        ptr[0] = file_size;
+        ptr[1] = value.h[0];
+        ptr[2] = value.h[1];
+        ptr[DDUP_KEY_SIZE] = i;
+
+        count++;
+        ptr += DDUP_KEY_SIZE + 1;
+    }
+    mfu_blockhash_delete(&bh);
+
+    /* group files by size and tree digest */
+    uint64_t groups;
+    uint64_t* group_id    = (uint64_t*) MFU_MALLOC(count * sizeof(uint64_t));
+    uint64_t* group_ranks = (uint64_t*) MFU_MALLOC(count * sizeof(uint64_t));
+    uint64_t* group_rank  = (uint64_t*) MFU_MALLOC(count * sizeof(uint64_t));
+    DTCMP_Rankv(
+        (int)count, list,
+        &groups, group_id, group_ranks, group_rank,
+        key, keysat, cmp, DTCMP_FLAG_NONE, MPI_COMM_WORLD
+    );
+
+    ptr = list;
+    for (i = 0; i < count; i++) {
+        if (group_ranks[i] > 1) {
+            mfu_flist_file_copy(tree_list, ptr[DDUP_KEY_SIZE], match_list);
+        }
+        ptr += DDUP_KEY_SIZE + 1;
+    }
+
+    mfu_free(&group_rank);
+    mfu_free(&group_ranks);
+    mfu_free(&group_id);
+    mfu_free(&list);
+}
+
 int main(int argc, char** argv)
 {
     uint64_t i;
     int status;
     uint64_t file_size;
 
-    uint64_t chunk_size = DDUP_CHUNK_SIZE;
-
-    SHA256_CTX* ctx_ptr;
-
     MPI_Init(NULL, NULL);
     mfu_init();
 
@@ -175,8 +1052,21 @@ int main(int argc, char** argv)
 
     mfu_debug_level = MFU_LOG_VERBOSE;
 
+    /* whether to find candidates with a faster hash before SHA256 */
+    int use_digest = 0;
+    mfu_digest_alg digest_alg = MFU_DIGEST_FAST;
+
+    /* what to do with duplicates, besides reporting them */
+    ddup_action action = DDUP_ACTION_NONE;
+
+    /* file to read and write digests of unchanged files */
+    char* cache_file = NULL;
+
     static struct option long_options[] = {
-        {"debug",    0, 0, 'd'},
+        {"action",   1, 0, 'a'},
+        {"cache",    1, 0, 'C'},
+        {"digest",   1, 0, 'D'},
+        {"debug",    1, 0, 'd'},
         {"verbose",  0, 0, 'v'},
         {"quiet",    0, 0, 'q'},
         {"help",     0, 0, 'h'},
@@ -188,10 +1078,40 @@ int main(int argc, char** argv)
     int help  = 0;
     int c;
     int option_index = 0;
-    while ((c = getopt_long(argc, argv, "d:vqh", \
+    while ((c = getopt_long(argc, argv, "a:C:D:d:vqh", \
                             long_options, &option_index)) != -1)
     {
         switch (c) {
+        case 'a':
+            if (strcmp(optarg, "hardlink") == 0) {
+                action = DDUP_ACTION_HARDLINK;
+            } else if (strcmp(optarg, "reflink") == 0) {
+                action = DDUP_ACTION_REFLINK;
+            } else if (strcmp(optarg, "dedupe-range") == 0) {
+                action = DDUP_ACTION_DEDUPE;
+            } else {
+                if (rank == 0) {
+                    MFU_LOG(MFU_LOG_ERR, "Unknown action `%s'", optarg);
+                }
+                usage = 1;
+            }
+            break;
+        case 'C':
+            mfu_free(&cache_file);
+            cache_file = MFU_STRDUP(optarg);
+            break;
+        case 'D':
+            if (strcmp(optarg, "sha256") == 0) {
+                use_digest = 0;
+            } else if (mfu_digest_alg_parse(optarg, &digest_alg) == 0) {
+                use_digest = 1;
+            } else {
+                if (rank == 0) {
+                    MFU_LOG(MFU_LOG_ERR, "Unknown digest `%s'", optarg);
+                }
+                usage = 1;
+            }
+            break;
         case 'd':
             if (strncmp(optarg, "fatal", 5) == 0) {
                 mfu_debug_level = MFU_LOG_FATAL;
@@ -237,9 +1157,11 @@ int main(int argc, char** argv)
                               "recognized. Defaulting to "
                               "`info'.", optarg);
             }
+            break;
         case 'h':
             usage = 1;
             help  = 1;
+            break;
         case 'v':
             mfu_debug_level = MFU_LOG_VERBOSE;
             break;
@@ -284,6 +1206,13 @@ int main(int argc, char** argv)
     /* get the directory name */
     const char* dir = argv[optind];
 
+    if (use_digest && rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Finding candidates with %s digest (%s), "
+                  "confirming with SHA256",
+                  mfu_digest_alg_name(digest_alg),
+                  mfu_digest_impl(digest_alg));
+    }
+
     /* create MPI datatypes */
     MPI_Datatype key;
     MPI_Datatype keysat;
@@ -296,6 +1225,21 @@ int main(int argc, char** argv)
     /* allocate buffer to read data from file */
     char* chunk_buf = (char*)MFU_MALLOC(DDUP_CHUNK_SIZE);
 
+    /* read digests recorded by earlier runs */
+    mfu_digestcache* dc = NULL;
+    if (cache_file != NULL) {
+        dc = mfu_digestcache_new(sizeof(struct ddup_cache_value));
+        if (mfu_digestcache_read(cache_file, dc) != 0) {
+            /* start over rather than fail, the file is rewritten at the end */
+            mfu_digestcache_delete(&dc);
+            dc = mfu_digestcache_new(sizeof(struct ddup_cache_value));
+        }
+    }
+
+    /* record duplicates found on this rank if we'll act on them */
+    struct ddup_dups dups = {0, 0, NULL};
+    struct ddup_dups* record = (action != DDUP_ACTION_NONE) ? &dups : NULL;
+
     /* allocate a file list */
     mfu_flist flist = mfu_flist_new();
 
@@ -305,14 +1249,9 @@ int main(int argc, char** argv)
     /* Walk the path(s) to build the flist */
     mfu_flist_walk_path(dir, walk_opts, flist, mfu_file);
 
-    /* TODO: spread list among procs? */
-
     /* get local number of items in flist */
     uint64_t checking_files = mfu_flist_size(flist);
 
-    /* allocate memory to hold SHA256 context values */
-    struct file_item* file_items = (struct file_item*) MFU_MALLOC(checking_files * sizeof(*file_items));
-
     /* Allocate two lists of length size, where each
      * element has (DDUP_KEY_SIZE + 1) uint64_t values
      * (id, checksum, index)
@@ -321,8 +1260,16 @@ int main(int argc, char** argv)
     uint64_t* list     = (uint64_t*) MFU_MALLOC(list_bytes);
     uint64_t* new_list = (uint64_t*) MFU_MALLOC(list_bytes);
 
+    /* allocate arrays to hold result from DTCMP_Rankv call to
+     * assign group and rank values to each item */
+    uint64_t output_bytes = checking_files * sizeof(uint64_t);
+    uint64_t* group_id    = (uint64_t*) MFU_MALLOC(output_bytes);
+    uint64_t* group_ranks = (uint64_t*) MFU_MALLOC(output_bytes);
+    uint64_t* group_rank  = (uint64_t*) MFU_MALLOC(output_bytes);
+
     /* Initialize the list */
     uint64_t* ptr = list;
+    uint64_t* new_ptr;
     uint64_t new_checking_files = 0;
     for (i = 0; i < checking_files; i++) {
         /* check that item is a regular file */
@@ -339,16 +1286,12 @@ int main(int argc, char** argv)
         }
 
         /* for first pass, group all files with same file size */
+        memset(ptr, 0, DDUP_KEY_SIZE * sizeof(uint64_t));
         ptr[0] = file_size;
 
-        /* we'll leave the middle part of the key unset */
-
         /* record our index in flist */
         ptr[DDUP_KEY_SIZE] = i;
 
-        /* initialize the SHA256 hash state for this file */
-        SHA256_Init(&file_items[i].ctx);
-
         /* increment our file count */
         new_checking_files++;
 
@@ -359,154 +1302,296 @@ int main(int argc, char** argv)
     /* reduce our list count based on any files filtered out above */
     checking_files = new_checking_files;
 
-    /* allocate arrays to hold result from DTCMP_Rankv call to
-     * assign group and rank values to each item */
-    uint64_t output_bytes = checking_files * sizeof(uint64_t);
-    uint64_t* group_id    = (uint64_t*) MFU_MALLOC(output_bytes);
-    uint64_t* group_ranks = (uint64_t*) MFU_MALLOC(output_bytes);
-    uint64_t* group_rank  = (uint64_t*) MFU_MALLOC(output_bytes);
+    /* Assign group ids by file size */
+    uint64_t groups;
+    DTCMP_Rankv(
+        (int)checking_files, list,
+        &groups, group_id, group_ranks, group_rank,
+        key, keysat, cmp, DTCMP_FLAG_NONE, MPI_COMM_WORLD
+    );
+
+    /* any file with a unique size is unique, look up cached
+     * digests of all others */
+    const mfu_digest_alg* probe_alg = use_digest ? &digest_alg : NULL;
+    uint64_t cands = 0;
+    uint64_t* cand_idx = (uint64_t*) MFU_MALLOC(checking_files * sizeof(uint64_t));
+    ptr = list;
+    for (i = 0; i < checking_files; i++) {
+        if (group_ranks[i] > 1) {
+            cand_idx[cands] = ptr[DDUP_KEY_SIZE];
+            cands++;
+        }
+        ptr += DDUP_KEY_SIZE + 1;
+    }
 
-    /* get total number of items across all tasks */
-    uint64_t sum_checking_files;
-    MPI_Allreduce(&checking_files, &sum_checking_files, 1,
-                  MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    uint64_t* cand_keys = NULL;
+    struct ddup_cache_value* cand_values = NULL;
+    int* cand_found = NULL;
+    int* cand_dirty = NULL;
+    if (dc != NULL) {
+        cand_keys   = (uint64_t*) MFU_MALLOC(cands * MFU_DIGESTCACHE_KEY_VALUES * sizeof(uint64_t));
+        cand_values = (struct ddup_cache_value*) MFU_MALLOC(cands * sizeof(struct ddup_cache_value));
+        cand_found  = (int*) MFU_MALLOC(cands * sizeof(int));
+        cand_dirty  = (int*) MFU_MALLOC(cands * sizeof(int));
+        uint64_t hits = cache_lookup(dc, flist, cands, cand_idx, cand_keys, cand_values, cand_found);
+
+        uint64_t counts[2] = {hits, cands};
+        uint64_t all_counts[2];
+        MPI_Allreduce(counts, all_counts, 2, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_INFO, "Found cached digests for %" PRIu64
+                      " of %" PRIu64 " candidate files",
+                      all_counts[0], all_counts[1]);
+        }
+    }
 
-    uint64_t chunk_id = 0;
-    while (sum_checking_files > 1) {
-        /* update the chunk id we'll read from all files */
-        chunk_id++;
+    /* compute a probe digest from the first and last blocks,
+     * which rejects most files that differ at the cost of
+     * reading at most two blocks */
+    new_checking_files = 0;
+    ptr = list;
+    new_ptr = new_list;
+    uint64_t cand = 0;
+    for (i = 0; i < checking_files; i++) {
+        ptr += DDUP_KEY_SIZE + 1;
 
-        /* iterate over our list and compute SHA256 value for each */
-        ptr = list;
-        for (i = 0; i < checking_files; i++) {
-            /* get the flist index for this item */
-            uint64_t idx = ptr[DDUP_KEY_SIZE];
+        if (group_ranks[i] == 1) {
+            /* only file of this size */
+            continue;
+        }
 
-            /* look up file name */
-            const char* fname = mfu_flist_file_get_name(flist, idx);
+        /* Get index into flist for this item */
+        uint64_t c = cand++;
+        uint64_t idx = cand_idx[c];
 
-            /* look up file size */
-            file_size = mfu_flist_file_get_size(flist, idx);
+        /* look up file name and size */
+        const char* fname = mfu_flist_file_get_name(flist, idx);
+        file_size = mfu_flist_file_get_size(flist, idx);
 
-            /* read a chunk of data from the file into chunk_buf */
-            uint64_t data_size;
-            status = read_data(fname, chunk_buf, chunk_id,
-                               chunk_size, file_size, &data_size);
+        /* use the probe digest as key within the size group,
+         * reusing the cached one if it was computed the same way */
+        struct ddup_cache_value* value = (dc != NULL) ? &cand_values[c] : NULL;
+        if (value != NULL) {
+            cand_dirty[c] = 0;
+        }
+        if (value != NULL && cand_found[c] == 1 &&
+            value->probe_alg == probe_tag(probe_alg))
+        {
+            memcpy(new_ptr + 1, value->probe, sizeof(value->probe));
+        } else {
+            status = probe_file(fname, file_size, probe_alg,
+                                chunk_buf, new_ptr + 1);
             if (status) {
-                /* File size has been changed, TODO: handle */
-                printf("failed to read file %s, maybe file "
-                       "size has been modified during the "
-                       "process", fname);
+                MFU_LOG(MFU_LOG_ERR, "Failed to read `%s', maybe file "
+                          "size has been modified during the process",
+                          fname);
+                continue;
             }
 
-            /* update the SHA256 context for this file */
-            ctx_ptr = &file_items[idx].ctx;
-            SHA256_Update(ctx_ptr, chunk_buf, data_size);
-
-            /*
-             * Use SHA256 value as key.
-             * This is actually an hack, but SHA256_Final can't
-             * be called multiple times with out changing ctx
-             */
-            SHA256_CTX ctx_tmp;
-            memcpy(&ctx_tmp, ctx_ptr, sizeof(ctx_tmp));
-            SHA256_Final((unsigned char*)(ptr + 1), &ctx_tmp);
-
-            /* move on to next file in the list */
-            ptr += DDUP_KEY_SIZE + 1;
-        }
-
-        /* Assign group ids and compute group sizes */
-        uint64_t groups;
-        DTCMP_Rankv(
-            (int)checking_files, list,
-            &groups, group_id, group_ranks, group_rank,
-            key, keysat, cmp, DTCMP_FLAG_NONE, MPI_COMM_WORLD
-        );
-
-        /* any files assigned to a group of size 1 is unique,
-         * any files in groups sizes > 1 for which we've read
-         * all bytes are the same, and filter all other files
-         * into a new list for another iteration */
-        new_checking_files = 0;
-        ptr = list;
-        uint64_t* new_ptr = new_list;
-        for (i = 0; i < checking_files; i++) {
-            /* Get index into flist for this item */
-            uint64_t idx = ptr[DDUP_KEY_SIZE];
+            /* keep a cached full digest, it does not depend on the probe */
+            if (value != NULL && cand_found[c] != -1) {
+                if (cand_found[c] == 0) {
+                    value->have_full = 0;
+                }
+                value->probe_alg = probe_tag(probe_alg);
+                memcpy(value->probe, new_ptr + 1, sizeof(value->probe));
+                cand_dirty[c] = 1;
+            }
+        }
+        new_ptr[0] = group_id[i];
+        new_ptr[DDUP_KEY_SIZE] = idx;
 
-            /* look up file name */
-            const char* fname = mfu_flist_file_get_name(flist, idx);
+        new_checking_files++;
+        new_ptr += DDUP_KEY_SIZE + 1;
+    }
 
-            /* look up file size */
-            file_size = mfu_flist_file_get_size(flist, idx);
+    /* record new probe digests */
+    if (dc != NULL) {
+        cache_store(dc, cands, cand_keys, cand_values, cand_dirty);
+    }
+    mfu_free(&cand_dirty);
+    mfu_free(&cand_found);
+    mfu_free(&cand_values);
+    mfu_free(&cand_keys);
+    mfu_free(&cand_idx);
+
+    /* Swap lists */
+    uint64_t* tmp_list = list;
+    list     = new_list;
+    new_list = tmp_list;
+    checking_files = new_checking_files;
+
+    /* Assign group ids by file size and probe digest */
+    DTCMP_Rankv(
+        (int)checking_files, list,
+        &groups, group_id, group_ranks, group_rank,
+        key, keysat, cmp, DTCMP_FLAG_NONE, MPI_COMM_WORLD
+    );
+
+    /* files that still match another after the probe are either
+     * duplicates already, when the probe covered all of their bytes,
+     * or they must be hashed in full, a faster digest only selects
+     * candidates, which are then confirmed with SHA256, and with
+     * a cache, large files go straight to SHA256 since that is the
+     * digest recorded for the next run */
+    mfu_flist hash_list = mfu_flist_subset(flist);
+    mfu_flist tree_list = mfu_flist_subset(flist);
+    ptr = list;
+    for (i = 0; i < checking_files; i++) {
+        /* Get index into flist for this item */
+        uint64_t idx = ptr[DDUP_KEY_SIZE];
 
-            /* get a pointer to the SHA256 context for this file */
-            ctx_ptr = &file_items[idx].ctx;
-
-            if (group_ranks[i] == 1) {
-                /*
-                 * Only one file in this group,
-                 * mfu_flist_file_name(flist, idx) is unique
-                 */
-            } else if (file_size <= (chunk_id * chunk_size)) {
-                /*
-                 * We've run out of bytes to checksum, and we
-                 * still have a group size > 1
-                 * mfu_flist_file_name(flist, idx) is a
-                 * duplicate with other files that also have
-                 * matching group_id[i]
-                 */
-                unsigned char digest[SHA256_DIGEST_LENGTH];
-                SHA256_Final(digest, ctx_ptr);
-
-                char digest_string[SHA256_DIGEST_LENGTH * 2 + 1];
-                dump_sha256_digest(digest_string, digest);
-                printf("%s %s\n", fname, digest_string);
+        if (group_ranks[i] > 1) {
+            file_size = mfu_flist_file_get_size(flist, idx);
+            if (file_size <= DDUP_CHUNK_SIZE && ! use_digest) {
+                /* mfu_flist_file_name(flist, idx) is a duplicate
+                 * with other files that also have matching
+                 * group_id[i] */
+                const char* fname = mfu_flist_file_get_name(flist, idx);
+                report_dup(record, fname, file_size, ptr + 1);
+            } else if (file_size > DDUP_CHUNK_SIZE && use_digest && dc == NULL) {
+                mfu_flist_file_copy(flist, idx, tree_list);
             } else {
-                /* Have multiple files with the same checksum,
-                 * but still have bytes left to read, so keep
-                 * this file
-                 */
-
-                /* use new group ID to segregate files,
-                 * this id will be unique for all files of the
-                 * same size and having the same hash up to
-                 * this point */
-                new_ptr[0] = group_id[i];
-
-                /* Copy over flist index into new list entry */
-                new_ptr[DDUP_KEY_SIZE] = idx;
-
-                /* got one more in the new list */
-                new_checking_files++;
-
-                /* move on to next item in new list */
-                new_ptr += DDUP_KEY_SIZE + 1;
-
-                MFU_LOG(MFU_LOG_DBG, "checking file "
-                          "\"%s\" for chunk index %d of size %"
-                          PRIu64"\n", fname, (int)chunk_id,
-                          chunk_size);
+                mfu_flist_file_copy(flist, idx, hash_list);
             }
+        }
 
-            /* move on to next file in the list */
-            ptr += DDUP_KEY_SIZE + 1;
+        /* move on to next file in the list */
+        ptr += DDUP_KEY_SIZE + 1;
+    }
+    mfu_flist_summarize(tree_list);
+
+    /* with a faster digest, only large files that also match on
+     * their tree digest need to be confirmed */
+    if (use_digest) {
+        tree_filter(tree_list, digest_alg, hash_list, key, keysat, cmp);
+    }
+    mfu_flist_free(&tree_list);
+    mfu_flist_summarize(hash_list);
+
+    /* give each rank about the same number of bytes to hash, so that
+     * every file is read end to end by a single rank, rather than
+     * advancing all files one chunk at a time in lock step */
+    mfu_flist spread_list = spread_by_bytes(hash_list);
+    mfu_flist_free(&hash_list);
+
+    /* resize our lists to hold the files we were assigned */
+    checking_files = mfu_flist_size(spread_list);
+    mfu_free(&group_rank);
+    mfu_free(&group_ranks);
+    mfu_free(&group_id);
+    mfu_free(&new_list);
+    mfu_free(&list);
+
+    list_bytes   = checking_files * (DDUP_KEY_SIZE + 1) * sizeof(uint64_t);
+    output_bytes = checking_files * sizeof(uint64_t);
+    list        = (uint64_t*) MFU_MALLOC(list_bytes);
+    group_id    = (uint64_t*) MFU_MALLOC(output_bytes);
+    group_ranks = (uint64_t*) MFU_MALLOC(output_bytes);
+    group_rank  = (uint64_t*) MFU_MALLOC(output_bytes);
+
+    /* look up full digests recorded by earlier runs */
+    uint64_t* hash_keys = NULL;
+    struct ddup_cache_value* hash_values = NULL;
+    int* hash_found = NULL;
+    int* hash_dirty = NULL;
+    if (dc != NULL) {
+        uint64_t* hash_idx = (uint64_t*) MFU_MALLOC(checking_files * sizeof(uint64_t));
+        for (i = 0; i < checking_files; i++) {
+            hash_idx[i] = i;
         }
+        hash_keys   = (uint64_t*) MFU_MALLOC(checking_files * MFU_DIGESTCACHE_KEY_VALUES * sizeof(uint64_t));
+        hash_values = (struct ddup_cache_value*) MFU_MALLOC(checking_files * sizeof(struct ddup_cache_value));
+        hash_found  = (int*) MFU_MALLOC(checking_files * sizeof(int));
+        hash_dirty  = (int*) MFU_MALLOC(checking_files * sizeof(int));
+        cache_lookup(dc, spread_list, checking_files, hash_idx, hash_keys, hash_values, hash_found);
+        mfu_free(&hash_idx);
+    }
 
-        /* Swap lists */
-        uint64_t* tmp_list;
-        tmp_list = list;
-        list     = new_list;
-        new_list = tmp_list;
+    /* compute the full digest of each file */
+    new_checking_files = 0;
+    ptr = list;
+    for (i = 0; i < checking_files; i++) {
+        const char* fname = mfu_flist_file_get_name(spread_list, i);
+        file_size = mfu_flist_file_get_size(spread_list, i);
+
+        struct ddup_cache_value* value = (dc != NULL) ? &hash_values[i] : NULL;
+        if (value != NULL) {
+            hash_dirty[i] = 0;
+        }
+        if (value != NULL && hash_found[i] == 1 && value->have_full) {
+            memcpy(ptr + 1, value->full, sizeof(value->full));
+        } else {
+            MFU_LOG(MFU_LOG_DBG, "hashing file \"%s\" of size %"
+                      PRIu64, fname, file_size);
 
-        /* Update size of current list */
-        checking_files = new_checking_files;
+            status = hash_file(fname, file_size, chunk_buf, ptr + 1);
+            if (status) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to read `%s', maybe file "
+                          "size has been modified during the process",
+                          fname);
+                continue;
+            }
 
-        /* Get new global list size */
-        MPI_Allreduce(&checking_files, &sum_checking_files, 1,
-                      MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+            if (value != NULL && hash_found[i] != -1) {
+                if (hash_found[i] == 0) {
+                    value->probe_alg = DDUP_CACHE_NO_PROBE;
+                }
+                value->have_full = 1;
+                memcpy(value->full, ptr + 1, sizeof(value->full));
+                hash_dirty[i] = 1;
+            }
+        }
+
+        /* files with the same size and full digest are duplicates */
+        ptr[0] = file_size;
+        ptr[DDUP_KEY_SIZE] = i;
+
+        new_checking_files++;
+        ptr += DDUP_KEY_SIZE + 1;
+    }
+
+    /* record new full digests and save the cache for the next run */
+    if (dc != NULL) {
+        cache_store(dc, checking_files, hash_keys, hash_values, hash_dirty);
+        mfu_digestcache_write(cache_file, dc);
+        mfu_digestcache_delete(&dc);
+    }
+    mfu_free(&hash_dirty);
+    mfu_free(&hash_found);
+    mfu_free(&hash_values);
+    mfu_free(&hash_keys);
+
+    checking_files = new_checking_files;
+
+    /* find duplicates with a single grouping on the full digest */
+    DTCMP_Rankv(
+        (int)checking_files, list,
+        &groups, group_id, group_ranks, group_rank,
+        key, keysat, cmp, DTCMP_FLAG_NONE, MPI_COMM_WORLD
+    );
+
+    ptr = list;
+    for (i = 0; i < checking_files; i++) {
+        if (group_ranks[i] > 1) {
+            /* mfu_flist_file_name(spread_list, idx) is a duplicate
+             * with other files that also have matching group_id[i] */
+            uint64_t idx = ptr[DDUP_KEY_SIZE];
+            const char* fname = mfu_flist_file_get_name(spread_list, idx);
+            report_dup(record, fname, ptr[0], ptr + 1);
+        }
+
+        /* move on to next file in the list */
+        ptr += DDUP_KEY_SIZE + 1;
+    }
+
+    /* replace or share duplicates in each group with the first */
+    int action_rc = 0;
+    if (action != DDUP_ACTION_NONE) {
+        fflush(stdout);
+        action_rc = act_on_dups(&dups, action);
     }
+    mfu_free(&dups.items);
 
     /* free the walk options */
     mfu_walk_opts_delete(&walk_opts);
@@ -517,18 +1602,19 @@ int main(int argc, char** argv)
     mfu_free(&group_rank);
     mfu_free(&group_ranks);
     mfu_free(&group_id);
-    mfu_free(&new_list);
     mfu_free(&list);
-    mfu_free(&file_items);
     mfu_free(&chunk_buf);
+    mfu_flist_free(&spread_list);
     mfu_flist_free(&flist);
 
     mtcmp_cmp_fini(&cmp);
     mpi_type_fini(&key, &keysat);
 
-    status = 0;
+    status = (action_rc == 0) ? 0 : 1;
 
 out:
+    mfu_free(&cache_file);
+
     mfu_finalize();
     MPI_Finalize();
 
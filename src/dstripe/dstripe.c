@@ -23,6 +23,9 @@ uint64_t stripe_prog_bytes;
 uint64_t stripe_prog_bytes_total;
 mfu_progress* stripe_prog;
 
+/* rate limits file creates and bytes written */
+mfu_throttle* stripe_throttle;
+
 static void create_progress_fn(const uint64_t* vals, int count, int complete, int ranks, double secs)
 {
     /* compute percentage of items removed */
@@ -101,6 +104,8 @@ static void print_usage(void)
     printf("  -s, --size <SIZE>      - stripe size in bytes (default 1MB)\n");
     printf("  -m, --minsize <SIZE>   - minimum file size (default 0MB)\n");
     printf("  -r, --report           - display file size and stripe info\n");
+    printf("      --bwlimit <SIZE>   - limit aggregate bandwidth to SIZE bytes per second\n");
+    printf("      --iopslimit <N>    - limit aggregate metadata operations to N per second\n");
     printf("      --progress <N>     - print progress every N seconds\n");
     printf("  -v, --verbose          - verbose output\n");
     printf("  -q, --quiet            - quiet output\n");
@@ -363,6 +368,9 @@ static void write_file_chunk(mfu_file_chunk* p, const char* out_path)
         stripe_prog_bytes += read_size;
         mfu_progress_update(&stripe_prog_bytes, stripe_prog);
 
+        /* hold to our share of the bandwidth limit */
+        mfu_throttle_update((uint64_t) read_size, 0, stripe_throttle);
+
         /* go on to the next chunk in this stripe, we assume we
          * read the whole chunk size, if we didn't it's because
          * the stripe is smaller or we're at the end of the file,
@@ -415,6 +423,8 @@ int main(int argc, char* argv[])
         {"size",     1, 0, 's'},
         {"minsize",  1, 0, 'm'},
         {"report",   0, 0, 'r'},
+        {"bwlimit",  1, 0, 'B'},
+        {"iopslimit",1, 0, 'I'},
         {"progress", 1, 0, 'P'},
         {"verbose",  0, 0, 'v'},
         {"quiet",    0, 0, 'q'},
@@ -459,6 +469,20 @@ int main(int argc, char* argv[])
                 /* report striping info */
 		report = 1;
                 break;
+            case 'B':
+                /* aggregate bandwidth limit in bytes per second */
+                if (mfu_abtoull(optarg, &bytes) != MFU_SUCCESS) {
+                    if (rank == 0) {
+                        MFU_LOG(MFU_LOG_ERR, "Failed to parse bandwidth limit: %s", optarg);
+                    }
+                    MPI_Abort(MPI_COMM_WORLD, 1);
+                }
+                mfu_throttle_bytes = (uint64_t)bytes;
+                break;
+            case 'I':
+                /* aggregate metadata operation limit per second */
+                mfu_throttle_ops = (uint64_t) strtoull(optarg, NULL, 10);
+                break;
             case 'P':
                 mfu_progress_timeout = atoi(optarg);
                 break;
@@ -616,6 +640,7 @@ int main(int argc, char* argv[])
     /* initialize progress messages while creating files */
     create_prog_count = 0;
     create_prog = mfu_progress_start(mfu_progress_timeout, 1, MPI_COMM_WORLD, create_progress_fn);
+    stripe_throttle = mfu_throttle_start(MPI_COMM_WORLD);
 
     /* create new files so we can restripe */
     uint64_t size = mfu_flist_size(filtered);
@@ -630,16 +655,19 @@ int main(int argc, char* argv[])
         /* update our status for file create progress */
         create_prog_count++;
         mfu_progress_update(&create_prog_count, create_prog);
+        mfu_throttle_update(0, 1, stripe_throttle);
     }
 
     /* finalize file create progress messages */
     mfu_progress_complete(&create_prog_count, &create_prog);
+    mfu_throttle_complete(&stripe_throttle);
 
     MPI_Barrier(MPI_COMM_WORLD);
 
     /* initialize progress messages while copying data */
     stripe_prog_bytes = 0;
     stripe_prog = mfu_progress_start(mfu_progress_timeout, 1, MPI_COMM_WORLD, stripe_progress_fn);
+    stripe_throttle = mfu_throttle_start(MPI_COMM_WORLD);
 
     /* found a suffix, now we need to break our files into chunks based on stripe size */
     mfu_file_chunk* file_chunks = mfu_file_chunk_list_alloc(filtered, stripe_size);
@@ -660,10 +688,12 @@ int main(int argc, char* argv[])
 
     /* finalize progress messages */
     mfu_progress_complete(&stripe_prog_bytes, &stripe_prog);
+    mfu_throttle_complete(&stripe_throttle);
 
     MPI_Barrier(MPI_COMM_WORLD);
 
     /* remove input file and rename temp file */
+    stripe_throttle = mfu_throttle_start(MPI_COMM_WORLD);
     for (idx = 0; idx < size; idx++) {
         /* build path to temp file */
         const char *in_path = mfu_flist_file_get_name(filtered, idx);
@@ -683,7 +713,11 @@ int main(int argc, char* argv[])
             MFU_LOG(MFU_LOG_ERR, "Failed to rename file %s to %s", out_path, in_path);
             MPI_Abort(MPI_COMM_WORLD, 1);
         }
+
+        /* chmod and rename */
+        mfu_throttle_update(0, 2, stripe_throttle);
     }
+    mfu_throttle_complete(&stripe_throttle);
 
     /* wait for everyone to finish */
     MPI_Barrier(MPI_COMM_WORLD);
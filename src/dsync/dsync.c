@@ -38,9 +38,20 @@
 #include <assert.h>
 
 #include "mfu.h"
-#include "strmap.h"
 #include "list.h"
 
+/* with --delta, files are compared in chunks of DSYNC_DELTA_CHUNK_SIZE
+ * bytes per task, data is checked in blocks of DSYNC_DELTA_BLOCK_SIZE,
+ * and adjacent differing blocks are rewritten with writes of up to
+ * DSYNC_DELTA_BUFFER_SIZE bytes */
+#define DSYNC_DELTA_CHUNK_SIZE  (64 * 1024 * 1024)
+#define DSYNC_DELTA_BLOCK_SIZE  (4 * 1024)
+#define DSYNC_DELTA_BUFFER_SIZE (4 * 1024 * 1024)
+
+/* without --delta, files are compared and rewritten in buffers
+ * of DSYNC_COMPARE_BUFFER_SIZE bytes */
+#define DSYNC_COMPARE_BUFFER_SIZE (1024 * 1024)
+
 /* Print a usage message */
 static void print_usage(void)
 {
@@ -49,11 +60,21 @@ static void print_usage(void)
     printf("\n");
     printf("Options:\n");
     printf("      --dryrun          - show differences, but do not synchronize files\n");
+    printf("      --adaptive-io     - use O_DIRECT for aligned blocks of large files and drop cached pages\n");
     printf("  -b  --batch-files <N> - batch files into groups of N during copy\n");
+    printf("      --bwlimit <SIZE>  - limit aggregate bandwidth to SIZE bytes per second\n");
+    printf("      --changes <FILE>  - only sync paths named in change log FILE\n");
     printf("  -c, --contents        - read and compare file contents rather than compare size and mtime\n");
     printf("  -D, --delete          - delete extraneous files from target\n");
+    printf("      --delta           - with --contents, rewrite only blocks that differ\n");
+    printf("      --dir-cache <FILE> - skip reading directories unchanged since last sync recorded in FILE\n");
+    printf("      --dir-cache-full <N> - with --dir-cache, walk all directories every N runs, default 10\n");
+    printf("      --hash-store <FILE> - with --contents, reuse block hashes from FILE for unchanged files\n");
+    printf("      --iopslimit <N>   - limit aggregate metadata operations to N per second\n");
     printf("      --link-dest <DIR> - hardlink to files in DIR when unchanged\n");
+    printf("      --sort-join       - match items by sorting both lists instead of hashing\n");
     printf("  -S, --sparse          - create sparse files when possible\n");
+    printf("      --preallocate     - allocate full size of destination files when created\n");
     printf("      --progress <N>    - print progress every N seconds\n");
     printf("  -v, --verbose         - verbose output\n");
     printf("  -q, --quiet           - quiet output\n");
@@ -83,7 +104,7 @@ typedef enum _dsync_state {
       * This file only exist in dest directory.
       * Only valid for DCMPF_EXIST.
       * Not used yet,
-      * becuase we don't want to waste a loop in dsync_strmap_compare()
+      * becuase we don't want to waste a loop in dsync_map_compare()
       */
     DCMPS_ONLY_DEST,
 
@@ -165,6 +186,12 @@ struct dsync_options {
     int debug;                     /* check result after get result */
     int delete;                    /* delete extraneous files from destination dirs */
     char* link_dest;               /* link dest dir */
+    char* hash_store;              /* file to read and write block hashes */
+    char* dir_cache;               /* file to read and write directory records */
+    char* changes;                 /* change log naming paths to sync */
+    uint64_t dir_cache_full;       /* walk all directories every N runs */
+    int delta;                     /* rewrite only differing blocks of files */
+    int sort_join;                 /* match items with a sort-merge join */
     int need_compare[DCMPF_MAX];   /* fields that need to be compared  */
 };
 
@@ -177,6 +204,12 @@ struct dsync_options options = {
     .debug        = 0,
     .delete       = 0,
     .link_dest    = NULL,
+    .hash_store   = NULL,
+    .dir_cache    = NULL,
+    .changes      = NULL,
+    .dir_cache_full = 10,
+    .delta        = 0,
+    .sort_join    = 0,
     .need_compare = {0,}
 };
 
@@ -350,132 +383,34 @@ static int dsync_state_from_string(const char* string, dsync_state *state)
     return -ENOENT;
 }
 
-/* given a filename as the key, encode an index followed
- * by the init state */
-static void dsync_strmap_item_init(
-    strmap* map,
-    const char *key,
-    uint64_t item_index)
+/* index items of list by name, sorted or hashed depending on join mode */
+static mfu_itemmap* dsync_map_new(mfu_flist list, size_t prefix_len)
 {
-    /* Should be long enough for 64 bit number and DCMPF_MAX */
-    char val[21 + DCMPF_MAX];
-    int i;
-
-    /* encode the index */
-    int len = snprintf(val, sizeof(val), "%llu",
-                       (unsigned long long) item_index);
-
-    /* encode the state (state characters and trailing NUL) */
-    assert((size_t)len + DCMPF_MAX + 1 <= (sizeof(val)));
-    size_t position = strlen(val);
-    for (i = 0; i < DCMPF_MAX; i++) {
-        val[position] = DCMPS_INIT;
-        position++;
+    if (options.sort_join) {
+        return mfu_itemmap_new_sorted(list, prefix_len);
     }
-    val[position] = '\0';
-
-    /* add item to map */
-    strmap_set(map, key, val);
+    return mfu_itemmap_new(list, prefix_len);
 }
 
-static void dsync_strmap_item_update(
-    strmap* map,
-    const char *key,
+/* record state of a field for the item in the given slot of a map */
+static void dsync_map_item_update(
+    mfu_itemmap* map,
+    uint64_t slot,
     dsync_field field,
     dsync_state state)
 {
-    /* Should be long enough for 64 bit number and DCMPF_MAX */
-    char new_val[21 + DCMPF_MAX];
-
-    /* lookup item from map */
-    const char* val = strmap_get(map, key);
-
-    /* copy existing index over */
     assert(field < DCMPF_MAX);
-    assert(strlen(val) + 1 <= sizeof(new_val));
-    strcpy(new_val, val);
-
-    /* set new state value */
-    size_t position = strlen(new_val) - DCMPF_MAX;
-    new_val[position + field] = state;
-
-    /* reinsert item in map */
-    strmap_set(map, key, new_val);
+    mfu_itemmap_set(map, slot, (int) field, (int) (state - DCMPS_INIT));
 }
 
-static int dsync_strmap_item_index(
-    strmap* map,
-    const char *key,
-    uint64_t *item_index)
+/* return state of a field for the item in the given slot of a map */
+static dsync_state dsync_map_item_state(
+    const mfu_itemmap* map,
+    uint64_t slot,
+    dsync_field field)
 {
-    /* Should be long enough for 64 bit number and DCMPF_MAX */
-    char new_val[21 + DCMPF_MAX];
-
-    /* lookup item from map */
-    const char* val = strmap_get(map, key);
-    if (val == NULL) {
-        return -1;
-    }
-
-    /* extract index */
-    assert(strlen(val) + 1 <= sizeof(new_val));
-    strcpy(new_val, val);
-    new_val[strlen(new_val) - DCMPF_MAX] = '\0';
-    *item_index = strtoull(new_val, NULL, 0);
-
-    return 0;
-}
-
-static int dsync_strmap_item_state(
-    strmap* map,
-    const char *key,
-    dsync_field field,
-    dsync_state *state)
-{
-    /* lookup item from map */
-    const char* val = strmap_get(map, key);
-    if (val == NULL) {
-        return -1;
-    }
-
-    /* extract state */
-    assert(strlen(val) > DCMPF_MAX);
     assert(field < DCMPF_MAX);
-    size_t position = strlen(val) - DCMPF_MAX;
-    *state = val[position + field];
-
-    return 0;
-}
-
-/* map each file name to its index in the file list and initialize
- * its state for comparison operation */
-static strmap* dsync_strmap_creat(mfu_flist list, const char* prefix)
-{
-    /* create a new string map to map a file name to a string
-     * encoding its index and state */
-    strmap* map = strmap_new();
-
-    /* determine length of prefix string */
-    size_t prefix_len = strlen(prefix);
-
-    /* iterate over each item in the file list */
-    uint64_t i = 0;
-    uint64_t count = mfu_flist_size(list);
-    while (i < count) {
-        /* get full path of file name */
-        const char* name = mfu_flist_file_get_name(list, i);
-
-        /* ignore prefix portion of path */
-        name += prefix_len;
-
-        /* create entry for this file */
-        dsync_strmap_item_init(map, name, i);
-
-        /* go to next item in list */
-        i++;
-    }
-
-    return map;
+    return (dsync_state) (DCMPS_INIT + mfu_itemmap_get(map, slot, (int) field));
 }
 
 #define dsync_compare_field(field_name, field)                                \
@@ -484,23 +419,24 @@ do {                                                                         \
     uint64_t dst = mfu_flist_file_get_ ## field_name(dst_list, dst_index); \
     if (src != dst) {                                                        \
         /* file type is different */                                         \
-        dsync_strmap_item_update(src_map, key, field, DCMPS_DIFFER);          \
-        dsync_strmap_item_update(dst_map, key, field, DCMPS_DIFFER);          \
+        dsync_map_item_update(src_map, src_slot, field, DCMPS_DIFFER);          \
+        dsync_map_item_update(dst_map, dst_slot, field, DCMPS_DIFFER);          \
         diff++;                                                              \
     } else {                                                                 \
-        dsync_strmap_item_update(src_map, key, field, DCMPS_COMMON);          \
-        dsync_strmap_item_update(dst_map, key, field, DCMPS_COMMON);          \
+        dsync_map_item_update(src_map, src_slot, field, DCMPS_COMMON);          \
+        dsync_map_item_update(dst_map, dst_slot, field, DCMPS_COMMON);          \
     }                                                                        \
 } while(0)
 
 static void dsync_compare_acl(
-    const char *key,
     mfu_flist src_list,
     uint64_t src_index,
     mfu_flist dst_list,
     uint64_t dst_index,
-    strmap* src_map,
-    strmap* dst_map,
+    mfu_itemmap* src_map,
+    uint64_t src_slot,
+    mfu_itemmap* dst_map,
+    uint64_t dst_slot,
     int *diff)
 {
     void *src_val, *dst_val;
@@ -554,11 +490,11 @@ out:
 
 #endif
     if (is_same) {
-        dsync_strmap_item_update(src_map, key, DCMPF_ACL, DCMPS_COMMON);
-        dsync_strmap_item_update(dst_map, key, DCMPF_ACL, DCMPS_COMMON);
+        dsync_map_item_update(src_map, src_slot, DCMPF_ACL, DCMPS_COMMON);
+        dsync_map_item_update(dst_map, dst_slot, DCMPF_ACL, DCMPS_COMMON);
     } else {
-        dsync_strmap_item_update(src_map, key, DCMPF_ACL, DCMPS_DIFFER);
-        dsync_strmap_item_update(dst_map, key, DCMPF_ACL, DCMPS_DIFFER);
+        dsync_map_item_update(src_map, src_slot, DCMPF_ACL, DCMPS_DIFFER);
+        dsync_map_item_update(dst_map, dst_slot, DCMPF_ACL, DCMPS_DIFFER);
         (*diff)++;
     }
 }
@@ -571,22 +507,25 @@ static int dsync_option_need_compare(dsync_field field)
 /* Return -1 when error, return 0 when equal, return > 0 when diff */
 static int dsync_compare_metadata(
     mfu_flist src_list,
-    strmap* src_map,
-    uint64_t src_index,
+    mfu_itemmap* src_map,
+    uint64_t src_slot,
     mfu_flist dst_list,
-    strmap* dst_map,
-    uint64_t dst_index,
-    const char* key)
+    mfu_itemmap* dst_map,
+    uint64_t dst_slot)
 {
     int diff = 0;
 
+    /* get index of item in each list */
+    uint64_t src_index = mfu_itemmap_index(src_map, src_slot);
+    uint64_t dst_index = mfu_itemmap_index(dst_map, dst_slot);
+
     if (dsync_option_need_compare(DCMPF_SIZE)) {
         mfu_filetype type = mfu_flist_file_get_type(src_list, src_index);
         if (type != MFU_TYPE_DIR) {
             dsync_compare_field(size, DCMPF_SIZE);
         } else {
-            dsync_strmap_item_update(src_map, key, DCMPF_SIZE, DCMPS_COMMON);
-            dsync_strmap_item_update(dst_map, key, DCMPF_SIZE, DCMPS_COMMON);
+            dsync_map_item_update(src_map, src_slot, DCMPF_SIZE, DCMPS_COMMON);
+            dsync_map_item_update(dst_map, dst_slot, DCMPF_SIZE, DCMPS_COMMON);
         }
     }
     if (dsync_option_need_compare(DCMPF_GID)) {
@@ -608,9 +547,9 @@ static int dsync_compare_metadata(
         dsync_compare_field(perm, DCMPF_PERM);
     }
     if (dsync_option_need_compare(DCMPF_ACL)) {
-        dsync_compare_acl(key, src_list,src_index,
+        dsync_compare_acl(src_list, src_index,
                          dst_list, dst_index,
-                         src_map, dst_map, &diff);
+                         src_map, src_slot, dst_map, dst_slot, &diff);
     }
 
     return diff;
@@ -678,7 +617,7 @@ static void compare_progress_fn(const uint64_t* vals, int count, int complete, i
 /* given a list of source/destination files to compare, spread file
  * sections to processes to compare in parallel, fill
  * in comparison results in source and dest string maps */
-static void dsync_strmap_compare_data_link_dest(
+static void dsync_map_compare_data_link_dest(
     mfu_flist src_compare_list,
     mfu_flist link_compare_list,
     mfu_flist link_same_list,
@@ -724,8 +663,9 @@ static void dsync_strmap_compare_data_link_dest(
         off_t length = (off_t)src_p->length;
         
         /* compare the contents of the files */
+        off_t diff_offset;
         int compare_rc = mfu_compare_contents(src_p->name, dst_p->name, offset, length,
-                1048576, overwrite, count_bytes_read, count_bytes_written, compare_prog);
+                1048576, overwrite, count_bytes_read, count_bytes_written, &diff_offset, compare_prog);
         if (compare_rc == -1) {
             /* we hit an error while reading */
             rc = -1;
@@ -783,19 +723,45 @@ static void dsync_strmap_compare_data_link_dest(
     rc = all_rc;
 }
 
-static int dsync_strmap_compare_data(
+/* sum delta write-back counters over all ranks and print them,
+ * stats holds bytes compared, bytes rewritten, blocks rewritten,
+ * writes issued, and writes a full rewrite would have issued */
+static void dsync_print_delta(const uint64_t* stats)
+{
+    uint64_t all[5];
+    MPI_Allreduce((void*)stats, all, 5, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank != 0) {
+        return;
+    }
+
+    double compared_tmp, rewritten_tmp, skipped_tmp;
+    const char* compared_units;
+    const char* rewritten_units;
+    const char* skipped_units;
+    mfu_format_bytes(all[0], &compared_tmp, &compared_units);
+    mfu_format_bytes(all[1], &rewritten_tmp, &rewritten_units);
+    mfu_format_bytes(all[0] - all[1], &skipped_tmp, &skipped_units);
+
+    MFU_LOG(MFU_LOG_INFO, "Delta compared %.3lf %s, rewrote %.3lf %s, left %.3lf %s untouched",
+        compared_tmp, compared_units, rewritten_tmp, rewritten_units, skipped_tmp, skipped_units);
+    MFU_LOG(MFU_LOG_INFO, "Delta rewrote %llu blocks in %llu writes, a full rewrite would issue %llu writes",
+        (unsigned long long)all[2], (unsigned long long)all[3], (unsigned long long)all[4]);
+}
+
+/* compare contents of each pair of files in the compare lists chunk
+ * by chunk, overwriting differing bytes in the destination file if
+ * overwrite is set, sets results[i] to 0 if the contents of pair i
+ * were the same and to 1 otherwise, returns -1 on read errors */
+static int dsync_compare_chunks(
     mfu_flist src_compare_list,
-    strmap* src_map,
     mfu_flist dst_compare_list,
-    strmap* dst_map,
-    mfu_flist src_list,
-    mfu_flist src_cp_list,
-    mfu_flist dst_same_list,
-    mfu_flist dst_remove_list,
-    size_t strlen_prefix,
+    int overwrite,
     uint64_t* count_bytes_read,
     uint64_t* count_bytes_written,
-    bool use_hardlinks)
+    int* results)
 {
     /* assume we'll succeed */
     int rc = 0;
@@ -803,6 +769,13 @@ static int dsync_strmap_compare_data(
     /* get chunk size for copying files (just hard-coded for now) */
     uint64_t chunk_size = 1024 * 1024;
 
+    /* in delta mode, hand out larger chunks so that runs of
+     * differing blocks can be gathered into larger writes */
+    int delta = (options.delta && overwrite);
+    if (delta) {
+        chunk_size = DSYNC_DELTA_CHUNK_SIZE;
+    }
+
     /* get the linked list of file chunks for the src and dest */
     mfu_file_chunk* src_head = mfu_file_chunk_list_alloc(src_compare_list, chunk_size);
     mfu_file_chunk* dst_head = mfu_file_chunk_list_alloc(dst_compare_list, chunk_size);
@@ -815,11 +788,13 @@ static int dsync_strmap_compare_data(
      * to be used as input to logical OR to determine state of entire file */
     int* vals = (int*) MFU_MALLOC(list_count * sizeof(int));
 
-    /* whether we should overwrite bytes in destination file during compare */
-    int overwrite = 1;
-    if (options.dry_run || use_hardlinks) {
-        overwrite = 0;
-    }
+    /* offset of first byte that differs in each chunk, UINT64_MAX if none */
+    uint64_t* offsets = (uint64_t*) MFU_MALLOC(list_count * sizeof(uint64_t));
+
+    /* bytes compared, bytes rewritten, blocks rewritten, writes issued,
+     * and writes a full rewrite would have issued in delta mode */
+    uint64_t delta_stats[5] = {0, 0, 0, 0, 0};
+    uint64_t written_before = *count_bytes_written;
 
     /* start progress messages when comparing data */
     uint64_t count_bytes[2];
@@ -839,8 +814,23 @@ static int dsync_strmap_compare_data(
         off_t length = (off_t)src_p->length;
 
         /* compare the contents of the files */
-        int compare_rc = mfu_compare_contents(src_p->name, dst_p->name, offset, length,
-                1048576, overwrite, count_bytes_read, count_bytes_written, compare_prog);
+        int compare_rc;
+        off_t diff_offset;
+        if (delta) {
+            compare_rc = mfu_compare_contents_delta(src_p->name, dst_p->name, offset, length,
+                    DSYNC_DELTA_BUFFER_SIZE, DSYNC_DELTA_BLOCK_SIZE, count_bytes_read,
+                    count_bytes_written, &delta_stats[2], &delta_stats[3], &diff_offset,
+                    compare_prog);
+            delta_stats[0] += (uint64_t)length;
+
+            /* copying the whole chunk writes it one buffer at a time */
+            delta_stats[4] += ((uint64_t)length + DSYNC_COMPARE_BUFFER_SIZE - 1) /
+                              DSYNC_COMPARE_BUFFER_SIZE;
+        } else {
+            compare_rc = mfu_compare_contents(src_p->name, dst_p->name, offset, length,
+                    DSYNC_COMPARE_BUFFER_SIZE, overwrite, count_bytes_read, count_bytes_written, &diff_offset,
+                    compare_prog);
+        }
         if (compare_rc == -1) {
             /* we hit an error while reading */
             rc = -1;
@@ -855,6 +845,7 @@ static int dsync_strmap_compare_data(
 
         /* record results of comparison */
         vals[i] = compare_rc;
+        offsets[i] = (diff_offset == (off_t)-1) ? UINT64_MAX : (uint64_t)diff_offset;
 
         /* update pointers for src and dest in linked list */
         src_p = src_p->next;
@@ -866,29 +857,181 @@ static int dsync_strmap_compare_data(
     count_bytes[1] = *count_bytes_written;
     mfu_progress_complete(count_bytes, &compare_prog);
 
+    /* report where each differing file first differs */
+    if (options.verbose) {
+        mfu_file_chunk_list_print_offsets(src_compare_list, src_head, offsets);
+    }
+
+    /* report how much of the data we had to rewrite */
+    if (delta) {
+        delta_stats[1] = *count_bytes_written - written_before;
+        dsync_print_delta(delta_stats);
+    }
+
+    /* execute logical OR over chunks for each file */
+    mfu_file_chunk_list_lor(src_compare_list, src_head, vals, results);
+
+    /* free memory */
+    mfu_free(&offsets);
+    mfu_free(&vals);
+    mfu_file_chunk_list_free(&src_head);
+    mfu_file_chunk_list_free(&dst_head);
+
+    return rc;
+}
+
+/* like dsync_compare_chunks, but judge contents by digests from the
+ * block hash store, so that only files that changed since the store
+ * was written are read, when overwriting, pairs found to differ are
+ * then compared chunk by chunk to copy the differing bytes, digests
+ * are saved to the store for the next run unless this is a dry run */
+static int dsync_compare_hashes(
+    mfu_flist src_compare_list,
+    mfu_flist dst_compare_list,
+    int overwrite,
+    uint64_t* count_bytes_read,
+    uint64_t* count_bytes_written,
+    int* results)
+{
+    /* assume we'll succeed */
+    int rc = 0;
+
+    /* use the same block size as a regular compare */
+    uint64_t chunk_size = 1024 * 1024;
+    mfu_blockhash* bhs[2];
+    bhs[0] = mfu_blockhash_new(src_compare_list, chunk_size, MFU_DIGEST_MURMUR3);
+    bhs[1] = mfu_blockhash_new(dst_compare_list, chunk_size, MFU_DIGEST_MURMUR3);
+
+    /* pick up digests of files that have not changed, we can
+     * still compare everything by reading it if this fails */
+    mfu_blockhash_read(options.hash_store, 2, bhs);
+
+    /* hash files we have no digests for */
+    uint64_t count_bytes[2];
+    mfu_progress* compare_prog = mfu_progress_start(mfu_progress_timeout, 2, MPI_COMM_WORLD, compare_progress_fn);
+    if (mfu_blockhash_compute(bhs[0], 1048576, count_bytes_read, compare_prog) != 0) {
+        rc = -1;
+    }
+    if (mfu_blockhash_compute(bhs[1], 1048576, count_bytes_read, compare_prog) != 0) {
+        rc = -1;
+    }
+    count_bytes[0] = *count_bytes_read;
+    count_bytes[1] = *count_bytes_written;
+    mfu_progress_complete(count_bytes, &compare_prog);
+
+    /* files we failed to read lack digests, consider them to be
+     * different, collect pairs that differ if we need to fix them */
+    uint64_t size = mfu_flist_size(src_compare_list);
+    uint64_t* redo_index = (uint64_t*) MFU_MALLOC(size * sizeof(uint64_t));
+    uint64_t redo_count = 0;
+    mfu_flist src_redo_list = mfu_flist_subset(src_compare_list);
+    mfu_flist dst_redo_list = mfu_flist_subset(dst_compare_list);
+    uint64_t i;
+    for (i = 0; i < size; i++) {
+        results[i] = (mfu_blockhash_compare(bhs[0], i, bhs[1], i) != 0);
+        if (results[i] && overwrite) {
+            mfu_flist_file_copy(src_compare_list, i, src_redo_list);
+            mfu_flist_file_copy(dst_compare_list, i, dst_redo_list);
+            redo_index[redo_count] = i;
+            redo_count++;
+        }
+    }
+    mfu_flist_summarize(src_redo_list);
+    mfu_flist_summarize(dst_redo_list);
+
+    /* copy differing bytes into destination files */
+    if (mfu_flist_global_size(src_redo_list) > 0) {
+        int* redo_results = (int*) MFU_MALLOC(redo_count * sizeof(int));
+        if (dsync_compare_chunks(src_redo_list, dst_redo_list, overwrite,
+            count_bytes_read, count_bytes_written, redo_results) < 0)
+        {
+            rc = -1;
+        }
+
+        for (i = 0; i < redo_count; i++) {
+            uint64_t idx = redo_index[i];
+            results[idx] = redo_results[i];
+
+            /* the destination file has been written to, so it
+             * must be hashed again on the next run */
+            mfu_blockhash_clear(bhs[1], idx);
+        }
+        mfu_free(&redo_results);
+    }
+
+    /* save digests for the next run */
+    if (! options.dry_run) {
+        mfu_blockhash_write(options.hash_store, 2, bhs);
+    }
+
+    mfu_flist_free(&dst_redo_list);
+    mfu_flist_free(&src_redo_list);
+    mfu_free(&redo_index);
+    mfu_blockhash_delete(&bhs[1]);
+    mfu_blockhash_delete(&bhs[0]);
+
+    return rc;
+}
+
+static int dsync_map_compare_data(
+    mfu_flist src_compare_list,
+    mfu_itemmap* src_map,
+    mfu_flist dst_compare_list,
+    mfu_itemmap* dst_map,
+    mfu_flist src_list,
+    mfu_flist src_cp_list,
+    mfu_flist dst_same_list,
+    mfu_flist dst_remove_list,
+    size_t strlen_prefix,
+    uint64_t* count_bytes_read,
+    uint64_t* count_bytes_written,
+    bool use_hardlinks)
+{
+    /* assume we'll succeed */
+    int rc = 0;
+
+    /* whether we should overwrite bytes in destination file during compare */
+    int overwrite = 1;
+    if (options.dry_run || use_hardlinks) {
+        overwrite = 0;
+    }
+
     /* allocate a flag for each item in our file list */
     uint64_t size = mfu_flist_size(src_compare_list);
     int* results = (int*) MFU_MALLOC(size * sizeof(int));
 
-    /* execute logical OR over chunks for each file */
-    mfu_file_chunk_list_lor(src_compare_list, src_head, vals, results);
+    /* compare contents of each pair of files */
+    if (options.hash_store != NULL) {
+        rc = dsync_compare_hashes(src_compare_list, dst_compare_list, overwrite,
+            count_bytes_read, count_bytes_written, results);
+    } else {
+        rc = dsync_compare_chunks(src_compare_list, dst_compare_list, overwrite,
+            count_bytes_read, count_bytes_written, results);
+    }
 
-    /* unpack contents of recv buffer & store results in strmap */
+    /* store results in maps */
+    uint64_t i;
     for (i = 0; i < size; i++) {
-        /* lookup name of file based on id to send to strmap updata call */
+        /* lookup name of file based on id to find its map slots */
         const char* name = mfu_flist_file_get_name(src_compare_list, i);
 
         /* ignore prefix portion of path to use as key */
         name += strlen_prefix;
 
+        /* get slot of this item in source and destination maps */
+        uint64_t src_slot, dst_slot;
+        int src_rc = mfu_itemmap_lookup(src_map, name, &src_slot);
+        int dst_rc = mfu_itemmap_lookup(dst_map, name, &dst_slot);
+        assert(src_rc == 0 && dst_rc == 0);
+
         /* get comparison results for this item */
         int flag = results[i];
 
-        /* set flag in strmap to record status of file */
+        /* set flag in maps to record status of file */
         if (flag != 0) {
             /* update to say contents of the files were found to be different */
-            dsync_strmap_item_update(src_map, name, DCMPF_CONTENT, DCMPS_DIFFER);
-            dsync_strmap_item_update(dst_map, name, DCMPF_CONTENT, DCMPS_DIFFER);
+            dsync_map_item_update(src_map, src_slot, DCMPF_CONTENT, DCMPS_DIFFER);
+            dsync_map_item_update(dst_map, dst_slot, DCMPF_CONTENT, DCMPS_DIFFER);
 
             /* mark file to be deleted from destination, copied from source */
             if (use_hardlinks) {
@@ -898,11 +1041,11 @@ static int dsync_strmap_compare_data(
 
             /* Note: File does not need to be truncated for syncing because the size
              * of the dst and src will be the same. It is one of the checks in
-             * dsync_strmap_compare */
+             * dsync_map_compare */
         } else {
             /* update to say contents of the files were found to be the same */
-            dsync_strmap_item_update(src_map, name, DCMPF_CONTENT, DCMPS_COMMON);
-            dsync_strmap_item_update(dst_map, name, DCMPF_CONTENT, DCMPS_COMMON);
+            dsync_map_item_update(src_map, src_slot, DCMPF_CONTENT, DCMPS_COMMON);
+            dsync_map_item_update(dst_map, dst_slot, DCMPF_CONTENT, DCMPS_COMMON);
 
             /* record that detination file matches source */
             if (use_hardlinks) {
@@ -913,9 +1056,6 @@ static int dsync_strmap_compare_data(
 
     /* free memory */
     mfu_free(&results);
-    mfu_free(&vals);
-    mfu_file_chunk_list_free(&src_head);
-    mfu_file_chunk_list_free(&dst_head);
 
     /* determine whether any process hit an error,
      * input is either 0 or -1, so MIN will return -1 if any */
@@ -936,7 +1076,7 @@ static void dsync_generate_real_lists(
     size_t src_strlen_prefix,   /* length of prefix string to source directory */
     const mfu_param_path *link_path, /* param path for link-dest directory */
     mfu_flist dst_list,         /* list of files in destination */
-    strmap *dst_map,            /* map each file in destination to its index in dst_list */
+    mfu_itemmap* dst_map,            /* map each file in destination to its index in dst_list */
     mfu_flist src_cp_list,      /* list of files to be copied to destination */
     mfu_flist dst_same_list,    /* list of files in destination that are same as in source */
     mfu_flist link_same_list,   /* list of files in link-dest that are same as in source */
@@ -947,7 +1087,7 @@ static void dsync_generate_real_lists(
     uint64_t idx;
 
     /* create map of item name to index in its respective list */
-    strmap* link_same_map = dsync_strmap_creat(link_same_list, link_path->path);
+    mfu_itemmap* link_same_map = dsync_map_new(link_same_list, strlen(link_path->path));
 
     /* walk list of files we need to copy from source to destination,
      * and split into set that must actually be copied and set that
@@ -970,9 +1110,11 @@ static void dsync_generate_real_lists(
         /* if item is in copy list, check whether the version in link-dest
          * is the same, if so, we'll create a hardlink,
          * otherwise we need to make a fresh copy */
-        uint64_t index;
-        int rc = dsync_strmap_item_index(link_same_map, name, &index);
+        uint64_t slot;
+        int rc = mfu_itemmap_lookup(link_same_map, name, &slot);
         if (rc >= 0) {
+            uint64_t index = mfu_itemmap_index(link_same_map, slot);
+
             /* file in link-dest is same as source,
              * create a hardlink in destination */
             mfu_flist_file_copy(link_same_list, index, link_dst_list);
@@ -1003,13 +1145,16 @@ static void dsync_generate_real_lists(
          * and if item in link-dest is also the same as the source file,
          * remove existing item at destination and replace with hardlink,
          * otherwise, do nothing */
-        uint64_t index;
-        int rc = dsync_strmap_item_index(link_same_map, name, &index);
+        uint64_t slot;
+        int rc = mfu_itemmap_lookup(link_same_map, name, &slot);
         if (rc >= 0) {
+            uint64_t index = mfu_itemmap_index(link_same_map, slot);
+
             /* get index of item in destination list */
-            uint64_t dst_index;
-            rc = dsync_strmap_item_index(dst_map, name, &dst_index);
+            uint64_t dst_slot;
+            rc = mfu_itemmap_lookup(dst_map, name, &dst_slot);
             assert(rc >= 0);
+            uint64_t dst_index = mfu_itemmap_index(dst_map, dst_slot);
 
             /* get full path to destination and link-dest */
             const char* dst_name = mfu_flist_file_get_name(dst_list, dst_index);
@@ -1040,13 +1185,13 @@ static void dsync_generate_real_lists(
     mfu_flist_summarize(dst_remove_list);
 
     /* free the map */
-    strmap_delete(&link_same_map);
+    mfu_itemmap_delete(&link_same_map);
 }
 
 /* given a list of source/destination files to compare, spread file
  * sections to processes to compare in parallel, fill
  * in comparison results in source and dest string maps */
-static void dsync_strmap_compare_lite_link_dest(
+static void dsync_map_compare_lite_link_dest(
     mfu_flist src_compare_list,
     mfu_flist link_compare_list,
     mfu_flist link_same_list)
@@ -1079,14 +1224,14 @@ static void dsync_strmap_compare_lite_link_dest(
 /* given a list of source/destination files to compare, spread file
  * sections to processes to compare in parallel, fill
  * in comparison results in source and dest string maps */
-static int dsync_strmap_compare_lite(
+static int dsync_map_compare_lite(
     mfu_flist src_compare_list,
     mfu_flist src_cp_list,
     mfu_flist dst_same_list,
-    strmap* src_map,
+    mfu_itemmap* src_map,
     mfu_flist dst_compare_list,
     mfu_flist dst_remove_list,
-    strmap* dst_map,
+    mfu_itemmap* dst_map,
     size_t strlen_prefix,
     bool use_hardlinks)
 {
@@ -1099,12 +1244,18 @@ static int dsync_strmap_compare_lite(
     /* check size and mtime of each item */
     uint64_t idx;
     for (idx = 0; idx < size; idx++) {
-        /* lookup name of file based on id to send to strmap updata call */
+        /* lookup name of file based on id to find its map slots */
         const char* name = mfu_flist_file_get_name(src_compare_list, idx);
 
         /* ignore prefix portion of path to use as key */
         name += strlen_prefix;
 
+        /* get slot of this item in source and destination maps */
+        uint64_t src_slot, dst_slot;
+        int src_rc = mfu_itemmap_lookup(src_map, name, &src_slot);
+        int dst_rc = mfu_itemmap_lookup(dst_map, name, &dst_slot);
+        assert(src_rc == 0 && dst_rc == 0);
+
         /* get file sizes */
         uint64_t src_size = mfu_flist_file_get_size(src_compare_list, idx);
         uint64_t dst_size = mfu_flist_file_get_size(dst_compare_list, idx);
@@ -1120,8 +1271,8 @@ static int dsync_strmap_compare_lite(
             (src_mtime != dst_mtime) || (src_mtime_nsec != dst_mtime_nsec))
         {
             /* update to say contents of the files were found to be different */
-            dsync_strmap_item_update(src_map, name, DCMPF_CONTENT, DCMPS_DIFFER);
-            dsync_strmap_item_update(dst_map, name, DCMPF_CONTENT, DCMPS_DIFFER);
+            dsync_map_item_update(src_map, src_slot, DCMPF_CONTENT, DCMPS_DIFFER);
+            dsync_map_item_update(dst_map, dst_slot, DCMPF_CONTENT, DCMPS_DIFFER);
 
             /* mark file to be deleted from destination, copied from source */
             if (!options.dry_run || use_hardlinks) {
@@ -1130,8 +1281,8 @@ static int dsync_strmap_compare_lite(
             }
         } else {
             /* update to say contents of the files were found to be the same */
-            dsync_strmap_item_update(src_map, name, DCMPF_CONTENT, DCMPS_COMMON);
-            dsync_strmap_item_update(dst_map, name, DCMPF_CONTENT, DCMPS_COMMON);
+            dsync_map_item_update(src_map, src_slot, DCMPF_CONTENT, DCMPS_COMMON);
+            dsync_map_item_update(dst_map, dst_slot, DCMPF_CONTENT, DCMPS_COMMON);
 
             /* record that detination file matches source */
             if (use_hardlinks) {
@@ -1227,33 +1378,30 @@ static void print_comparison_stats(
 
 /* loop on the dest map to check for files only in the dst list
  * and copy to a remove_list for the --sync option */
-static void dsync_only_dst(strmap* src_map,
-    strmap* dst_map, mfu_flist dst_list, mfu_flist dst_remove_list)
+static void dsync_only_dst(mfu_itemmap* src_map,
+    mfu_itemmap* dst_map, mfu_flist dst_list, mfu_flist dst_remove_list)
 {
     /* iterate over each item in dest map */
-    const strmap_node* node;
-    strmap_foreach(dst_map, node) {
+    uint64_t dst_slot;
+    uint64_t dst_slots = mfu_itemmap_size(dst_map);
+    for (dst_slot = 0; dst_slot < dst_slots; dst_slot++) {
         /* get file name */
-        const char* key = strmap_node_key(node);
-
-        /* get index of destination file */
-        uint64_t dst_index;
-        int ret = dsync_strmap_item_index(dst_map, key, &dst_index);
-        assert(ret == 0);
+        const char* key = mfu_itemmap_key(dst_map, dst_slot);
 
-        /* get index of source file */
-        uint64_t src_index;
-        ret = dsync_strmap_item_index(src_map, key, &src_index);
+        /* get slot of source file */
+        uint64_t src_slot;
+        int ret = mfu_itemmap_lookup(src_map, key, &src_slot);
         if (ret) {
             /* This file only exist in dest */
+            uint64_t dst_index = mfu_itemmap_index(dst_map, dst_slot);
             mfu_flist_file_copy(dst_list, dst_index, dst_remove_list);
         }
     }
 }
 
 static int dsync_sync_files(
-        strmap* src_map,
-        strmap* dst_map,
+        mfu_itemmap* src_map,
+        mfu_itemmap* dst_map,
         const mfu_param_path* src_path,
         const mfu_param_path* dest_path,
         const mfu_param_path* link_path,
@@ -1348,11 +1496,11 @@ static int dsync_sync_files(
 }
 
 /* compare entries from src to items in link-dest */
-static int dsync_strmap_compare_link_dest(
+static int dsync_map_compare_link_dest(
     mfu_flist src_list,
-    strmap* src_map,
+    mfu_itemmap* src_map,
     mfu_flist link_list,
-    strmap* link_map,
+    mfu_itemmap* link_map,
     mfu_flist link_same_list)
 {
     /* assume we'll succeed */
@@ -1371,27 +1519,28 @@ static int dsync_strmap_compare_link_dest(
     mfu_flist link_compare_list = mfu_flist_subset(link_list);
 
     /* iterate over each item in source map */
-    const strmap_node* node;
-    strmap_foreach(src_map, node) {
+    uint64_t src_slot;
+    uint64_t src_slots = mfu_itemmap_size(src_map);
+    for (src_slot = 0; src_slot < src_slots; src_slot++) {
         /* get file name */
-        const char* key = strmap_node_key(node);
+        const char* key = mfu_itemmap_key(src_map, src_slot);
 
         /* get index of source file */
-        uint64_t src_index;
-        tmp_rc = dsync_strmap_item_index(src_map, key, &src_index);
-        assert(tmp_rc == 0);
+        uint64_t src_index = mfu_itemmap_index(src_map, src_slot);
 
-        /* get index of destination file */
-        uint64_t dst_index;
-        tmp_rc = dsync_strmap_item_index(link_map, key, &dst_index);
+        /* get slot of link-dest file */
+        uint64_t dst_slot;
+        tmp_rc = mfu_itemmap_lookup(link_map, key, &dst_slot);
         if (tmp_rc) {
             /* skip uncommon files, all other states are DCMPS_INIT */
             continue;
         }
 
-        tmp_rc = dsync_compare_metadata(src_list, src_map, src_index,
-             link_list, link_map, dst_index,
-             key);
+        /* get index of link-dest file */
+        uint64_t dst_index = mfu_itemmap_index(link_map, dst_slot);
+
+        tmp_rc = dsync_compare_metadata(src_list, src_map, src_slot,
+             link_list, link_map, dst_slot);
         assert(tmp_rc >= 0);
 
         /* Skip if no need to compare type.
@@ -1423,9 +1572,7 @@ static int dsync_strmap_compare_link_dest(
         }
 
         /* check whether the file sizes are the same */
-        dsync_state state;
-        tmp_rc = dsync_strmap_item_state(src_map, key, DCMPF_SIZE, &state);
-        assert(tmp_rc == 0);
+        dsync_state state = dsync_map_item_state(src_map, src_slot, DCMPF_SIZE);
         if (state == DCMPS_DIFFER) {
             continue;
         }
@@ -1462,7 +1609,7 @@ static int dsync_strmap_compare_link_dest(
 
             /* compare file contents byte-by-byte, overwrites destination
              * file in place if found to be different during comparison */
-            dsync_strmap_compare_data_link_dest(src_compare_list,
+            dsync_map_compare_data_link_dest(src_compare_list,
                 link_compare_list, link_same_list,
                 &total_bytes_read, &total_bytes_written
             );
@@ -1474,7 +1621,7 @@ static int dsync_strmap_compare_link_dest(
 
             /* assume contents are different if size or mtime are different,
              * adds files to remove and copy lists if different */
-            dsync_strmap_compare_lite_link_dest(src_compare_list,
+            dsync_map_compare_lite_link_dest(src_compare_list,
                 link_compare_list, link_same_list
             );
         }
@@ -1496,13 +1643,13 @@ static int dsync_strmap_compare_link_dest(
 }
 
 /* compare entries from src into dst */
-static int dsync_strmap_compare(
+static int dsync_map_compare(
     mfu_flist src_list,
-    strmap* src_map,
+    mfu_itemmap* src_map,
     mfu_flist dst_list,
-    strmap* dst_map,
+    mfu_itemmap* dst_map,
     mfu_flist link_list,
-    strmap* link_map,
+    mfu_itemmap* link_map,
     size_t strlen_prefix,
     mfu_copy_opts_t* mfu_copy_opts,
     const mfu_param_path* src_path,
@@ -1558,27 +1705,22 @@ static int dsync_strmap_compare(
         src_real_cp_list = mfu_flist_subset(src_list);
     }
 
-    /* use a map as a list to record source and destination indices
-     * for entries that need a refresh on metadata */
-    strmap* metadata_refresh = strmap_new();
-
     /* iterate over each item in source map */
-    const strmap_node* node;
-    strmap_foreach(src_map, node) {
+    uint64_t src_slot;
+    uint64_t src_slots = mfu_itemmap_size(src_map);
+    for (src_slot = 0; src_slot < src_slots; src_slot++) {
         /* get file name */
-        const char* key = strmap_node_key(node);
+        const char* key = mfu_itemmap_key(src_map, src_slot);
 
         /* get index of source file */
-        uint64_t src_index;
-        tmp_rc = dsync_strmap_item_index(src_map, key, &src_index);
-        assert(tmp_rc == 0);
+        uint64_t src_index = mfu_itemmap_index(src_map, src_slot);
 
-        /* get index of destination file */
-        uint64_t dst_index;
-        tmp_rc = dsync_strmap_item_index(dst_map, key, &dst_index);
+        /* get slot of destination file */
+        uint64_t dst_slot;
+        tmp_rc = mfu_itemmap_lookup(dst_map, key, &dst_slot);
         if (tmp_rc) {
             /* item only exists in the source */
-            dsync_strmap_item_update(src_map, key, DCMPF_EXIST, DCMPS_ONLY_SRC);
+            dsync_map_item_update(src_map, src_slot, DCMPF_EXIST, DCMPS_ONLY_SRC);
 
             /* add items only in src directory into src copy list,
              * will be later copied into dst dir */
@@ -1590,18 +1732,17 @@ static int dsync_strmap_compare(
             continue;
         }
 
-        /* add any item that is in both source and destination to meta
-         * refresh list */
-        strmap_setf(metadata_refresh, "%llu=%llu", src_index, dst_index);
+        /* get index of destination file */
+        uint64_t dst_index = mfu_itemmap_index(dst_map, dst_slot);
 
         /* item exists in both source and destination,
-         * so update our state to record that fact */
-        dsync_strmap_item_update(src_map, key, DCMPF_EXIST, DCMPS_COMMON);
-        dsync_strmap_item_update(dst_map, key, DCMPF_EXIST, DCMPS_COMMON);
+         * so update our state to record that fact,
+         * these items get a refresh on metadata after the sync */
+        dsync_map_item_update(src_map, src_slot, DCMPF_EXIST, DCMPS_COMMON);
+        dsync_map_item_update(dst_map, dst_slot, DCMPF_EXIST, DCMPS_COMMON);
 
-        tmp_rc = dsync_compare_metadata(src_list, src_map, src_index,
-             dst_list, dst_map, dst_index,
-             key);
+        tmp_rc = dsync_compare_metadata(src_list, src_map, src_slot,
+             dst_list, dst_map, dst_slot);
         assert(tmp_rc >= 0);
 
         /* Skip if no need to compare type.
@@ -1619,8 +1760,8 @@ static int dsync_strmap_compare(
         /* check whether files are of the same type */
         if ((src_mode & S_IFMT) != (dst_mode & S_IFMT)) {
             /* file type is different, no need to go any futher */
-            dsync_strmap_item_update(src_map, key, DCMPF_TYPE, DCMPS_DIFFER);
-            dsync_strmap_item_update(dst_map, key, DCMPF_TYPE, DCMPS_DIFFER);
+            dsync_map_item_update(src_map, src_slot, DCMPF_TYPE, DCMPS_DIFFER);
+            dsync_map_item_update(dst_map, dst_slot, DCMPF_TYPE, DCMPS_DIFFER);
 
             /* if the types are different we need to make sure we delete the
              * file of the same name in the dst dir, and copy the type in
@@ -1635,14 +1776,14 @@ static int dsync_strmap_compare(
             }
 
             /* take them as differ content */
-            dsync_strmap_item_update(src_map, key, DCMPF_CONTENT, DCMPS_DIFFER);
-            dsync_strmap_item_update(dst_map, key, DCMPF_CONTENT, DCMPS_DIFFER);
+            dsync_map_item_update(src_map, src_slot, DCMPF_CONTENT, DCMPS_DIFFER);
+            dsync_map_item_update(dst_map, dst_slot, DCMPF_CONTENT, DCMPS_DIFFER);
             continue;
         }
 
         /* record that items have same type in source and destination */
-        dsync_strmap_item_update(src_map, key, DCMPF_TYPE, DCMPS_COMMON);
-        dsync_strmap_item_update(dst_map, key, DCMPF_TYPE, DCMPS_COMMON);
+        dsync_map_item_update(src_map, src_slot, DCMPF_TYPE, DCMPS_COMMON);
+        dsync_map_item_update(dst_map, dst_slot, DCMPF_TYPE, DCMPS_COMMON);
 
         /* Skip if no need to compare content. */
         if (!dsync_option_need_compare(DCMPF_CONTENT)) {
@@ -1653,19 +1794,17 @@ static int dsync_strmap_compare(
         /* TODO: add support for symlinks */
         if (! S_ISREG(dst_mode)) {
             /* not regular file, take them as common content */
-            dsync_strmap_item_update(src_map, key, DCMPF_CONTENT, DCMPS_COMMON);
-            dsync_strmap_item_update(dst_map, key, DCMPF_CONTENT, DCMPS_COMMON);
+            dsync_map_item_update(src_map, src_slot, DCMPF_CONTENT, DCMPS_COMMON);
+            dsync_map_item_update(dst_map, dst_slot, DCMPF_CONTENT, DCMPS_COMMON);
             continue;
         }
 
         /* first check whether file sizes match */
-        dsync_state state;
-        tmp_rc = dsync_strmap_item_state(src_map, key, DCMPF_SIZE, &state);
-        assert(tmp_rc == 0);
+        dsync_state state = dsync_map_item_state(src_map, src_slot, DCMPF_SIZE);
         if (state == DCMPS_DIFFER) {
             /* file size is different, their contents should be different */
-            dsync_strmap_item_update(src_map, key, DCMPF_CONTENT, DCMPS_DIFFER);
-            dsync_strmap_item_update(dst_map, key, DCMPF_CONTENT, DCMPS_DIFFER);
+            dsync_map_item_update(src_map, src_slot, DCMPF_CONTENT, DCMPS_DIFFER);
+            dsync_map_item_update(dst_map, dst_slot, DCMPF_CONTENT, DCMPS_DIFFER);
 
             /* if the file sizes are different then we need to remove the file in
              * the dst directory, and replace it with the one in the src directory */
@@ -1714,7 +1853,7 @@ static int dsync_strmap_compare(
             /* compare file contents byte-by-byte, overwrites destination
              * file in place if found to be different during comparison
              * and hardlinks are not enabled */
-            tmp_rc = dsync_strmap_compare_data(src_compare_list, src_map,
+            tmp_rc = dsync_map_compare_data(src_compare_list, src_map,
                 dst_compare_list, dst_map, src_list, src_cp_list, dst_same_list,
                 dst_remove_list, strlen_prefix,
                 &total_bytes_read, &total_bytes_written, use_hardlinks
@@ -1730,7 +1869,7 @@ static int dsync_strmap_compare(
 
             /* assume contents are different if size or mtime are different,
              * adds files to remove and copy lists if different */
-            tmp_rc = dsync_strmap_compare_lite(src_compare_list, src_cp_list, dst_same_list,
+            tmp_rc = dsync_map_compare_lite(src_compare_list, src_cp_list, dst_same_list,
                 src_map, dst_compare_list, dst_remove_list, dst_map,
                 strlen_prefix, use_hardlinks
             );
@@ -1746,7 +1885,7 @@ static int dsync_strmap_compare(
     if (link_path != NULL) {
         /* compare files in source and link-dest and create list of items
          * that are the same */
-        rc = dsync_strmap_compare_link_dest(src_list, src_map,
+        rc = dsync_map_compare_link_dest(src_list, src_map,
             link_list, link_map, link_same_list);
 
         /* of the items to be copied, some may be actual copies,
@@ -1803,16 +1942,19 @@ static int dsync_strmap_compare(
             MFU_LOG(MFU_LOG_INFO, "Updating timestamps on newly copied files");
         }
 
-        /* update metadata on files */
-        strmap_foreach(metadata_refresh, node) {
-            /* extract source and destination indices */
-            unsigned long long src_i, dst_i;
-            const char* key = strmap_node_key(node);
-            const char* val = strmap_node_value(node);
-            sscanf(key, "%llu", &src_i);
-            sscanf(val, "%llu", &dst_i);
-            uint64_t src_index = (uint64_t) src_i;
-            uint64_t dst_index = (uint64_t) dst_i;
+        /* update metadata on files that exist in both source and destination */
+        for (src_slot = 0; src_slot < src_slots; src_slot++) {
+            if (dsync_map_item_state(src_map, src_slot, DCMPF_EXIST) != DCMPS_COMMON) {
+                continue;
+            }
+
+            /* get source and destination indices */
+            const char* key = mfu_itemmap_key(src_map, src_slot);
+            uint64_t dst_slot;
+            tmp_rc = mfu_itemmap_lookup(dst_map, key, &dst_slot);
+            assert(tmp_rc == 0);
+            uint64_t src_index = mfu_itemmap_index(src_map, src_slot);
+            uint64_t dst_index = mfu_itemmap_index(dst_map, dst_slot);
 
             /* copy metadata values from source to destination, if needed */
             tmp_rc = mfu_flist_file_sync_meta(src_list, src_index, dst_list,
@@ -1823,9 +1965,6 @@ static int dsync_strmap_compare(
         }
     }
 
-    /* done with our list of files for refreshing metadata */
-    strmap_delete(&metadata_refresh);
-
     /* free lists used for removing and copying files */
     mfu_flist_free(&dst_remove_list);
     mfu_flist_free(&src_cp_list);
@@ -1852,48 +1991,32 @@ static int dsync_strmap_compare(
 }
 
 /* loop on the src map to check the results */
-static void dsync_strmap_check_src(strmap* src_map,
-                                  strmap* dst_map)
+static void dsync_map_check_src(mfu_itemmap* src_map,
+                               mfu_itemmap* dst_map)
 {
     assert(dsync_option_need_compare(DCMPF_EXIST));
     /* iterate over each item in source map */
-    const strmap_node* node;
-    strmap_foreach(src_map, node) {
+    uint64_t src_slot;
+    uint64_t src_slots = mfu_itemmap_size(src_map);
+    for (src_slot = 0; src_slot < src_slots; src_slot++) {
         /* get file name */
-        const char* key = strmap_node_key(node);
+        const char* key = mfu_itemmap_key(src_map, src_slot);
         int only_src = 0;
 
-        /* get index of source file */
-        uint64_t src_index;
-        int ret = dsync_strmap_item_index(src_map, key, &src_index);
-        assert(ret == 0);
-
-        /* get index of destination file */
-        uint64_t dst_index;
-        ret = dsync_strmap_item_index(dst_map, key, &dst_index);
+        /* get slot of destination file */
+        uint64_t dst_slot;
+        int ret = mfu_itemmap_lookup(dst_map, key, &dst_slot);
         if (ret) {
             only_src = 1;
         }
 
         /* First check exist state */
-        dsync_state src_exist_state;
-        ret = dsync_strmap_item_state(src_map, key, DCMPF_EXIST,
-            &src_exist_state);
-        assert(ret == 0);
-
-        dsync_state dst_exist_state;
-        ret = dsync_strmap_item_state(dst_map, key, DCMPF_EXIST,
-            &dst_exist_state);
-        if (only_src) {
-            assert(ret);
-        } else {
-            assert(ret == 0);
-        }
-
+        dsync_state src_exist_state = dsync_map_item_state(src_map, src_slot, DCMPF_EXIST);
         if (only_src) {
             /* This file never checked for dest */
             assert(src_exist_state == DCMPS_ONLY_SRC);
         } else {
+            dsync_state dst_exist_state = dsync_map_item_state(dst_map, dst_slot, DCMPF_EXIST);
             assert(src_exist_state == dst_exist_state);
             assert(dst_exist_state == DCMPS_COMMON);
         }
@@ -1904,24 +2027,15 @@ static void dsync_strmap_check_src(strmap* src_map,
                 continue;
             }
 
-            /* get state of src and dest */
-            dsync_state src_state;
-            ret = dsync_strmap_item_state(src_map, key, field, &src_state);
-            assert(ret == 0);
-
-            dsync_state dst_state;
-            ret = dsync_strmap_item_state(dst_map, key, field, &dst_state);
-            if (only_src) {
-                assert(ret);
-            } else {
-                assert(ret == 0);
-            }
+            /* get state of src */
+            dsync_state src_state = dsync_map_item_state(src_map, src_slot, field);
 
             if (only_src) {
                 /* all states are not checked */
                 assert(src_state == DCMPS_INIT);
             } else {
                 /* all stats of source and dest are the same */
+                dsync_state dst_state = dsync_map_item_state(dst_map, dst_slot, field);
                 assert(src_state == dst_state);
                 /* all states are either common, differ or skiped */
                 if (dsync_option_need_compare(field)) {
@@ -1939,50 +2053,34 @@ static void dsync_strmap_check_src(strmap* src_map,
 }
 
 /* loop on the dest map to check the results */
-static void dsync_strmap_check_dst(strmap* src_map,
-    strmap* dst_map)
+static void dsync_map_check_dst(mfu_itemmap* src_map,
+    mfu_itemmap* dst_map)
 {
     assert(dsync_option_need_compare(DCMPF_EXIST));
 
     /* iterate over each item in dest map */
-    const strmap_node* node;
-    strmap_foreach(dst_map, node) {
+    uint64_t dst_slot;
+    uint64_t dst_slots = mfu_itemmap_size(dst_map);
+    for (dst_slot = 0; dst_slot < dst_slots; dst_slot++) {
         /* get file name */
-        const char* key = strmap_node_key(node);
+        const char* key = mfu_itemmap_key(dst_map, dst_slot);
         int only_dest = 0;
 
-        /* get index of destination file */
-        uint64_t dst_index;
-        int ret = dsync_strmap_item_index(dst_map, key, &dst_index);
-        assert(ret == 0);
-
-        /* get index of source file */
-        uint64_t src_index;
-        ret = dsync_strmap_item_index(src_map, key, &src_index);
+        /* get slot of source file */
+        uint64_t src_slot;
+        int ret = mfu_itemmap_lookup(src_map, key, &src_slot);
         if (ret) {
             /* This file only exist in dest */
             only_dest = 1;
         }
 
         /* First check exist state */
-        dsync_state src_exist_state;
-        ret = dsync_strmap_item_state(src_map, key, DCMPF_EXIST,
-            &src_exist_state);
-        if (only_dest) {
-            assert(ret);
-        } else {
-            assert(ret == 0);
-        }
-
-        dsync_state dst_exist_state;
-        ret = dsync_strmap_item_state(dst_map, key, DCMPF_EXIST,
-            &dst_exist_state);
-        assert(ret == 0);
-
+        dsync_state dst_exist_state = dsync_map_item_state(dst_map, dst_slot, DCMPF_EXIST);
         if (only_dest) {
             /* This file never checked for dest */
             assert(dst_exist_state == DCMPS_INIT);
         } else {
+            dsync_state src_exist_state = dsync_map_item_state(src_map, src_slot, DCMPF_EXIST);
             assert(src_exist_state == dst_exist_state);
             assert(dst_exist_state == DCMPS_COMMON ||
                 dst_exist_state == DCMPS_ONLY_SRC);
@@ -1994,37 +2092,15 @@ static void dsync_strmap_check_dst(strmap* src_map,
                 continue;
             }
 
-            /* get state of src and dest */
-            dsync_state src_state;
-            ret = dsync_strmap_item_state(src_map, key, field,
-                &src_state);
-            if (only_dest) {
-                assert(ret);
-            } else {
-                assert(ret == 0);
-            }
-
-            dsync_state dst_state;
-            ret = dsync_strmap_item_state(dst_map, key, field,
-                &dst_state);
-            assert(ret == 0);
-
-            if (only_dest) {
-                /* all states are not checked */
-                assert(dst_state == DCMPS_INIT);
-            } else {
-                assert(src_state == dst_state);
-                /* all states are either common, differ or skiped */
-                assert(src_state == DCMPS_COMMON ||
-                    src_state == DCMPS_DIFFER ||
-                    src_state == DCMPS_INIT);
-            }
+            /* get state of dest */
+            dsync_state dst_state = dsync_map_item_state(dst_map, dst_slot, field);
 
             if (only_dest || dst_exist_state == DCMPS_ONLY_SRC) {
                 /* This file never checked for dest */
                 assert(dst_state == DCMPS_INIT);
             } else {
                 /* all stats of source and dest are the same */
+                dsync_state src_state = dsync_map_item_state(src_map, src_slot, field);
                 assert(src_state == dst_state);
                 /* all states are either common, differ or skiped */
                 if (dsync_option_need_compare(field)) {
@@ -2039,12 +2115,12 @@ static void dsync_strmap_check_dst(strmap* src_map,
 }
 
 /* check the result maps are valid */
-static void dsync_strmap_check(
-    strmap* src_map,
-    strmap* dst_map)
+static void dsync_map_check(
+    mfu_itemmap* src_map,
+    mfu_itemmap* dst_map)
 {
-    dsync_strmap_check_src(src_map, dst_map);
-    dsync_strmap_check_dst(src_map, dst_map);
+    dsync_map_check_src(src_map, dst_map);
+    dsync_map_check_dst(src_map, dst_map);
 }
 
 static int dsync_map_fn(
@@ -2135,15 +2211,11 @@ static void dsync_expression_print(
 
 static int dsync_expression_match(
     struct dsync_expression *expression,
-    strmap* map,
-    const char* key)
+    mfu_itemmap* map,
+    uint64_t slot)
 {
-    int ret;
     dsync_state state;
-    dsync_state exist_state;
-
-    ret = dsync_strmap_item_state(map, key, DCMPF_EXIST, &exist_state);
-    assert(ret == 0);
+    dsync_state exist_state = dsync_map_item_state(map, slot, DCMPF_EXIST);
     if (exist_state == DCMPS_ONLY_SRC) {
         /*
          * Map is source and file only exist in source.
@@ -2182,8 +2254,7 @@ static int dsync_expression_match(
     assert(exist_state == DCMPS_COMMON);
     assert(expression->field != DCMPF_EXIST);
 
-    ret = dsync_strmap_item_state(map, key, expression->field, &state);
-    assert(ret == 0);
+    state = dsync_map_item_state(map, slot, expression->field);
     /* All fields should have been compared. */
     assert(state == DCMPS_COMMON || state == DCMPS_DIFFER);
     if (expression->state == state) {
@@ -2263,8 +2334,8 @@ static void dsync_conjunction_print(
 /* if matched return 1, else return 0 */
 static int dsync_conjunction_match(
     struct dsync_conjunction *conjunction,
-    strmap* map,
-    const char* key)
+    mfu_itemmap* map,
+    uint64_t slot)
 {
     struct dsync_expression* expression;
     int matched;
@@ -2272,7 +2343,7 @@ static int dsync_conjunction_match(
     list_for_each_entry(expression,
                         &conjunction->expressions,
                         linkage) {
-        matched = dsync_expression_match(expression, map, key);
+        matched = dsync_expression_match(expression, map, slot);
         if (!matched) {
             return 0;
         }
@@ -2351,8 +2422,8 @@ static void dsync_disjunction_print(
 /* if matched return 1, else return 0 */
 static int dsync_disjunction_match(
     struct dsync_disjunction* disjunction,
-    strmap* map,
-    const char* key,
+    mfu_itemmap* map,
+    uint64_t slot,
     int is_src)
 {
     struct dsync_conjunction *conjunction;
@@ -2361,7 +2432,7 @@ static int dsync_disjunction_match(
     list_for_each_entry(conjunction,
                         &disjunction->conjunctions,
                         linkage) {
-        matched = dsync_conjunction_match(conjunction, map, key);
+        matched = dsync_conjunction_match(conjunction, map, slot);
         if (matched) {
             if (is_src)
                 mfu_flist_increase(&conjunction->src_matched_list);
@@ -2419,6 +2490,9 @@ static void dsync_option_fini(void)
     assert(list_empty(&options.outputs));
 
     mfu_free(&options.link_dest);
+    mfu_free(&options.hash_store);
+    mfu_free(&options.dir_cache);
+    mfu_free(&options.changes);
 }
 
 static void dsync_option_add_output(struct dsync_output *output, int add_at_head)
@@ -2444,30 +2518,29 @@ static void dsync_option_add_comparison(dsync_field field)
 
 static int dsync_output_flist_match(
     struct dsync_output *output,
-    strmap* map,
+    mfu_itemmap* map,
     mfu_flist flist,
     mfu_flist new_flist,
     mfu_flist *matched_flist,
     int is_src)
 {
-    const strmap_node* node;
     struct dsync_conjunction *conjunction;
 
-    /* iterate over each item in map */
-    strmap_foreach(map, node) {
-        /* get file name */
-        const char* key = strmap_node_key(node);
-
+    /* iterate over each item in map in name order */
+    uint64_t* order = mfu_itemmap_order(map);
+    uint64_t i;
+    uint64_t slots = mfu_itemmap_size(map);
+    for (i = 0; i < slots; i++) {
         /* get index of file */
-        uint64_t idx;
-        int ret = dsync_strmap_item_index(map, key, &idx);
-        assert(ret == 0);
+        uint64_t slot = order[i];
+        uint64_t idx = mfu_itemmap_index(map, slot);
 
-        if (dsync_disjunction_match(output->disjunction, map, key, is_src)) {
+        if (dsync_disjunction_match(output->disjunction, map, slot, is_src)) {
             mfu_flist_increase(matched_flist);
             mfu_flist_file_copy(flist, idx, new_flist);
         }
     }
+    mfu_free(&order);
 
     list_for_each_entry(conjunction,
                         &output->disjunction->conjunctions,
@@ -2487,9 +2560,9 @@ static int dsync_output_flist_match(
 static int dsync_output_write(
     struct dsync_output *output,
     mfu_flist src_flist,
-    strmap* src_map,
+    mfu_itemmap* src_map,
     mfu_flist dst_flist,
-    strmap* dst_map)
+    mfu_itemmap* dst_map)
 {
     int ret = 0;
     mfu_flist new_flist = mfu_flist_subset(src_flist);
@@ -2540,9 +2613,9 @@ static int dsync_output_write(
 
 static int dsync_outputs_write(
     mfu_flist src_list,
-    strmap* src_map,
+    mfu_itemmap* src_map,
     mfu_flist dst_list,
-    strmap* dst_map)
+    mfu_itemmap* dst_map)
 {
     struct dsync_output* output;
     int ret = 0;
@@ -2816,13 +2889,23 @@ int main(int argc, char **argv)
     int option_index = 0;
     static struct option long_options[] = {
         {"dryrun",        0, 0, 'n'},
+        {"adaptive-io",   0, 0, 'C'},
         {"batch-files",   1, 0, 'b'},
+        {"bwlimit",       1, 0, 'B'},
+        {"changes",       1, 0, 'L'},
         {"contents",      0, 0, 'c'},
         {"delete",        0, 0, 'D'},
+        {"delta",         0, 0, 'E'},
+        {"dir-cache",     1, 0, 'K'},
+        {"dir-cache-full", 1, 0, 'k'},
+        {"hash-store",    1, 0, 'H'},
+        {"iopslimit",     1, 0, 'I'},
         {"output",        1, 0, 'o'}, // undocumented
         {"debug",         0, 0, 'd'}, // undocumented
         {"link-dest",     1, 0, 'l'},
+        {"sort-join",     0, 0, 'J'},
         {"sparse",        0, 0, 'S'},
+        {"preallocate",   0, 0, 'F'},
         {"progress",      1, 0, 'P'},
         {"verbose",       0, 0, 'v'},
         {"quiet",         0, 0, 'q'},
@@ -2831,6 +2914,8 @@ int main(int argc, char **argv)
     };
     int ret = 0;
     int i;
+    unsigned long long bytes = 0;
+    char* endptr = NULL;
 
     /* read in command line options */
     int usage = 0;
@@ -2850,9 +2935,25 @@ int main(int argc, char **argv)
         }
 
         switch (c) {
+        case 'C':
+            mfu_copy_opts->adaptive_io = true;
+            break;
         case 'b':
             mfu_copy_opts->batch_files = atoi(optarg);
             break;
+        case 'B':
+            if (mfu_abtoull(optarg, &bytes) != MFU_SUCCESS) {
+                if (rank == 0) {
+                    MFU_LOG(MFU_LOG_ERR, "Failed to parse bandwidth limit: '%s'", optarg);
+                }
+                usage = 1;
+            } else {
+                mfu_throttle_bytes = (uint64_t) bytes;
+            }
+            break;
+        case 'L':
+            options.changes = MFU_STRDUP(optarg);
+            break;
         case 'c':
             options.contents++;
             break;
@@ -2862,6 +2963,39 @@ int main(int argc, char **argv)
         case 'D':
             options.delete = 1;
             break;
+        case 'E':
+            options.delta = 1;
+            break;
+        case 'H':
+            options.hash_store = MFU_STRDUP(optarg);
+            break;
+        case 'K':
+            options.dir_cache = MFU_STRDUP(optarg);
+            break;
+        case 'k':
+            errno = 0;
+            options.dir_cache_full = (uint64_t) strtoull(optarg, &endptr, 10);
+            if (errno != 0 || endptr == optarg || *endptr != '\0' ||
+                optarg[0] == '-' || options.dir_cache_full == 0)
+            {
+                if (rank == 0) {
+                    MFU_LOG(MFU_LOG_ERR, "Failed to parse --dir-cache-full, expected a count of at least 1: '%s'", optarg);
+                }
+                usage = 1;
+            }
+            break;
+        case 'I':
+            errno = 0;
+            mfu_throttle_ops = (uint64_t) strtoull(optarg, &endptr, 10);
+            if (errno != 0 || endptr == optarg || *endptr != '\0' ||
+                optarg[0] == '-' || mfu_throttle_ops == 0)
+            {
+                if (rank == 0) {
+                    MFU_LOG(MFU_LOG_ERR, "Failed to parse --iopslimit, expected a count of at least 1: '%s'", optarg);
+                }
+                usage = 1;
+            }
+            break;
         case 'l':
             options.link_dest = MFU_STRDUP(optarg);
             break;
@@ -2874,9 +3008,15 @@ int main(int argc, char **argv)
         case 'd':
             options.debug++;
             break;
+        case 'J':
+            options.sort_join = 1;
+            break;
         case 'S':
             mfu_copy_opts->sparse = 1;
             break;
+        case 'F':
+            mfu_copy_opts->preallocate = true;
+            break;
         case 'P':
             mfu_progress_timeout = atoi(optarg);
             break;
@@ -2910,6 +3050,38 @@ int main(int argc, char **argv)
         usage = 1;
     }
 
+    /* delta write-back is only done when comparing file contents */
+    if (options.delta && !options.contents) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "--delta requires --contents");
+        }
+        usage = 1;
+    }
+
+    /* block hashes are only used when comparing file contents */
+    if (options.hash_store != NULL && !options.contents) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "--hash-store requires --contents");
+        }
+        usage = 1;
+    }
+
+    /* link-dest items are not walked with the directory cache */
+    if (options.dir_cache != NULL && options.link_dest != NULL) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "--dir-cache cannot be used with --link-dest");
+        }
+        usage = 1;
+    }
+
+    /* a change log replaces the walks that these options hook into */
+    if (options.changes != NULL && (options.dir_cache != NULL || options.link_dest != NULL)) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "--changes cannot be used with --dir-cache or --link-dest");
+        }
+        usage = 1;
+    }
+
     /* Generate default output */
     if (list_empty(&options.outputs)) {
         /*
@@ -2996,17 +3168,38 @@ int main(int argc, char **argv)
         }
     }
 
-    /* walk source path */
-    if (rank == 0) {
-        MFU_LOG(MFU_LOG_INFO, "Walking source path");
+    /* read records of directories from the last sync, if any */
+    mfu_dircache* dircache = NULL;
+    if (options.dir_cache != NULL) {
+        dircache = mfu_dircache_read(options.dir_cache, srcpath->path, destpath->path, options.dir_cache_full);
+        mfu_dircache_walk_src(dircache, walk_opts);
+    }
+
+    int changes_rc = 0;
+    if (options.changes != NULL) {
+        /* list only paths named in the change log on both sides */
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_INFO, "Reading change log");
+        }
+        changes_rc = mfu_changes_read(options.changes, srcpath->path, destpath->path, walk_opts,
+            flist_tmp_src, flist_tmp_dst, mfu_src_file, mfu_dst_file);
+    } else {
+        /* walk source path */
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_INFO, "Walking source path");
+        }
+        mfu_flist_walk_param_paths(1, srcpath, walk_opts, flist_tmp_src, mfu_src_file);
     }
-    mfu_flist_walk_param_paths(1, srcpath, walk_opts, flist_tmp_src, mfu_src_file);
 
     /* check that we actually got something so that we don't delete
      * an entire target directory because of a typo on the source dir */
-    if (mfu_flist_global_size(flist_tmp_src) == 0) {
+    if (changes_rc != 0 || mfu_flist_global_size(flist_tmp_src) == 0) {
         if (rank == 0) {
-            MFU_LOG(MFU_LOG_ERR, "ERROR: No items found at source: `%s'", srcpath->orig);
+            if (changes_rc != 0) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to read change log: `%s'", options.changes);
+            } else {
+                MFU_LOG(MFU_LOG_ERR, "ERROR: No items found at source: `%s'", srcpath->orig);
+            }
         }
         mfu_flist_free(&flist_tmp_src);
         mfu_flist_free(&flist_tmp_dst);
@@ -3015,6 +3208,7 @@ int main(int argc, char **argv)
             mfu_param_path_free(linkpath);
             mfu_free(&linkpath);
         }
+        mfu_dircache_delete(&dircache);
         mfu_param_path_free_all(numargs, paths);
         mfu_free(&paths);
         dsync_option_fini();
@@ -3024,10 +3218,19 @@ int main(int argc, char **argv)
     }
 
     /* walk destinaton path */
-    if (rank == 0) {
-        MFU_LOG(MFU_LOG_INFO, "Walking destination path");
+    if (options.changes == NULL) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_INFO, "Walking destination path");
+        }
+        if (dircache != NULL) {
+            mfu_dircache_walk_dst(dircache, walk_opts);
+        }
+        mfu_flist_walk_param_paths(1, destpath, walk_opts, flist_tmp_dst, mfu_dst_file);
+        if (dircache != NULL) {
+            walk_opts->dir_fn  = NULL;
+            walk_opts->dir_arg = NULL;
+        }
     }
-    mfu_flist_walk_param_paths(1, destpath, walk_opts, flist_tmp_dst, mfu_dst_file);
 
     /* walk link-dest path if we have one */
     if (options.link_dest != NULL) {
@@ -3046,13 +3249,25 @@ int main(int argc, char **argv)
         path_link = linkpath->path;
     }
 
-    /* map files to ranks based on portion following prefix directory */
-    mfu_flist flist_src = mfu_flist_remap(flist_tmp_src, (mfu_flist_map_fn)dsync_map_fn, (const void*)path_src);
-    mfu_flist flist_dst = mfu_flist_remap(flist_tmp_dst, (mfu_flist_map_fn)dsync_map_fn, (const void*)path_dst);
-
+    mfu_flist flist_src;
+    mfu_flist flist_dst;
     mfu_flist flist_link = MFU_FLIST_NULL;
-    if (options.link_dest != NULL) {
-        flist_link = mfu_flist_remap(flist_tmp_link, (mfu_flist_map_fn)dsync_map_fn, (const void*)path_link);
+    if (options.sort_join) {
+        /* sort source by name, then send each item to the rank
+         * holding that range of source names */
+        mfu_flist_sort("name", &flist_tmp_src);
+        flist_src = mfu_itemmap_partition(flist_tmp_src, strlen(path_src), flist_tmp_src, strlen(path_src));
+        flist_dst = mfu_itemmap_partition(flist_tmp_src, strlen(path_src), flist_tmp_dst, strlen(path_dst));
+        if (options.link_dest != NULL) {
+            flist_link = mfu_itemmap_partition(flist_tmp_src, strlen(path_src), flist_tmp_link, strlen(path_link));
+        }
+    } else {
+        /* map files to ranks based on portion following prefix directory */
+        flist_src = mfu_flist_remap(flist_tmp_src, (mfu_flist_map_fn)dsync_map_fn, (const void*)path_src);
+        flist_dst = mfu_flist_remap(flist_tmp_dst, (mfu_flist_map_fn)dsync_map_fn, (const void*)path_dst);
+        if (options.link_dest != NULL) {
+            flist_link = mfu_flist_remap(flist_tmp_link, (mfu_flist_map_fn)dsync_map_fn, (const void*)path_link);
+        }
     }
 
     /* free original file lists */
@@ -3063,25 +3278,33 @@ int main(int argc, char **argv)
     }
 
     /* map each file name to its index and its comparison state */
-    strmap* map_src = dsync_strmap_creat(flist_src, path_src);
-    strmap* map_dst = dsync_strmap_creat(flist_dst, path_dst);
-    strmap* map_link = NULL;
+    mfu_itemmap* map_src = dsync_map_new(flist_src, strlen(path_src));
+    mfu_itemmap* map_dst = dsync_map_new(flist_dst, strlen(path_dst));
+    mfu_itemmap* map_link = NULL;
     if (options.link_dest != NULL) {
-        map_link = dsync_strmap_creat(flist_link, path_link);
+        map_link = dsync_map_new(flist_link, strlen(path_link));
     }
 
     /* compare files in map_src with those in map_dst */
-    int tmp_rc = dsync_strmap_compare(flist_src, map_src, flist_dst, map_dst, flist_link, map_link,
+    int tmp_rc = dsync_map_compare(flist_src, map_src, flist_dst, map_dst, flist_link, map_link,
         strlen(path_src), mfu_copy_opts, srcpath, destpath, linkpath, mfu_src_file, mfu_dst_file);
     if (tmp_rc < 0) {
         rc = 1;
     }
 
+    /* record directories for the next run once the sync is complete */
+    if (dircache != NULL) {
+        if (tmp_rc == 0 && !options.dry_run) {
+            mfu_dircache_write(options.dir_cache, dircache, flist_src);
+        }
+        mfu_dircache_delete(&dircache);
+    }
+
     /* free maps of file names to comparison state info */
-    strmap_delete(&map_src);
-    strmap_delete(&map_dst);
+    mfu_itemmap_delete(&map_src);
+    mfu_itemmap_delete(&map_dst);
     if (options.link_dest != NULL) {
-        strmap_delete(&map_link);
+        mfu_itemmap_delete(&map_link);
     }
 
     /* free file lists */
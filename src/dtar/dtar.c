@@ -36,20 +36,21 @@ typedef struct {
 /* The opts_blocksize option is optional and is used to specify
  * a blocksize for compression.
  * The opts_memory option is optional and is used to specify
- * memory limit for compression for each process in compression.
+ * the number of uncompressed archive bytes in each compressed member.
  * The opts_compress option is used to specify whether
- * compression/decompression should be used */
+ * the archive should be compressed when it is created */
 
 static int     opts_create    = 0;
 static int     opts_compress  = 0;
 static int     opts_verbose   = 0;
 static int     opts_debug     = 0;
 static int     opts_extract   = 0;
+static int     opts_list      = 0;
 static int     opts_preserve  = 0;
 static char*   opts_tarfile   = NULL;
 static size_t  opts_chunksize = 1024 * 1024;
 static int     opts_blocksize = 9;
-static ssize_t opts_memory    = -1;
+static ssize_t opts_memory    = 64 * 1024 * 1024;
 
 static void DTAR_abort(int code)
 {
@@ -68,16 +69,19 @@ static void print_usage(void)
 {
     printf("\n");
     printf("Usage: dtar [options] <source ...>\n");
+    printf("       dtar [options] -x [pattern ...]\n");
+    printf("       dtar [options] -t\n");
     printf("\n");
     printf("Options:\n");
     printf("  -c, --create            - create archive\n");
-    printf("  -j, --compress          - compress archive\n");
+    printf("  -j, --compress          - compress archive with bzip2\n");
     printf("  -x, --extract           - extract archive\n");
+    printf("  -t, --list              - list archive\n");
     printf("  -p, --preserve          - preserve attributes\n");
     printf("  -s, --chunksize <bytes> - chunk size (bytes)\n");
     printf("  -f, --file <filename>   - target output file\n");
     printf("  -b, --blocksize <size>  - block size (1-9)\n");
-    printf("  -m, --memory <bytes>    - memory limit (bytes)\n");
+    printf("  -m, --memory <bytes>    - archive bytes in each compressed member\n");
     printf("  -v, --verbose           - verbose output\n");
     printf("  -y, --debug             - debug output\n");
     printf("  -h, --help              - print usage\n");
@@ -95,15 +99,6 @@ int main(int argc, char** argv)
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
 
-    if (size > 1) {
-        if (rank == 0) {
-            MFU_LOG(MFU_LOG_ERR, "dtar currently only works with one MPI rank.");
-        }
-        mfu_finalize();
-        MPI_Finalize();
-        return 0;
-    }
-
     /* pointer to mfu_walk_opts */
     mfu_walk_opts_t* walk_opts = mfu_walk_opts_new();
 
@@ -112,6 +107,7 @@ int main(int argc, char** argv)
         {"create",    0, 0, 'c'},
         {"compress",  0, 0, 'j'},
         {"extract",   0, 0, 'x'},
+        {"list",      0, 0, 't'},
         {"preserve",  0, 0, 'p'},
         {"chunksize", 1, 0, 's'},
         {"file",      1, 0, 'f'},
@@ -126,7 +122,7 @@ int main(int argc, char** argv)
     int usage = 0;
     while (1) {
         int c = getopt_long(
-                    argc, argv, "cjxps:f:b:m:vyh",
+                    argc, argv, "cjxtps:f:b:m:vyh",
                     long_options, &option_index
                 );
 
@@ -135,6 +131,8 @@ int main(int argc, char** argv)
         }
 
         unsigned long long bytes;
+        long blocksize;
+        char* endptr = NULL;
         switch (c) {
             case 'c':
                 opts_create = 1;
@@ -145,21 +143,49 @@ int main(int argc, char** argv)
             case 'x':
                 opts_extract = 1;
                 break;
+            case 't':
+                opts_list = 1;
+                break;
             case 'p':
                 opts_preserve = 1;
                 break;
             case 's':
-                mfu_abtoull(optarg, &bytes);
+                if (mfu_abtoull(optarg, &bytes) != MFU_SUCCESS || bytes == 0) {
+                    if (rank == 0) {
+                        MFU_LOG(MFU_LOG_ERR, "Failed to parse --chunksize, expected a positive number of bytes: '%s'", optarg);
+                    }
+                    usage = 1;
+                    break;
+                }
                 opts_chunksize = (size_t) bytes;
                 break;
             case 'f':
                 opts_tarfile = MFU_STRDUP(optarg);
                 break;
             case 'b':
-                opts_blocksize = atoi(optarg);
+                errno = 0;
+                blocksize = strtol(optarg, &endptr, 10);
+                if (errno != 0 || endptr == optarg || *endptr != '\0' ||
+                    blocksize < 1 || blocksize > 9)
+                {
+                    if (rank == 0) {
+                        MFU_LOG(MFU_LOG_ERR, "Failed to parse --blocksize, expected a value from 1 to 9: '%s'", optarg);
+                    }
+                    usage = 1;
+                    break;
+                }
+                opts_blocksize = (int) blocksize;
                 break;
             case 'm':
-                mfu_abtoull(optarg, &bytes);
+                if (mfu_abtoull(optarg, &bytes) != MFU_SUCCESS || bytes == 0 ||
+                    bytes > (unsigned long long) SSIZE_MAX)
+                {
+                    if (rank == 0) {
+                        MFU_LOG(MFU_LOG_ERR, "Failed to parse --memory, expected a positive number of bytes: '%s'", optarg);
+                    }
+                    usage = 1;
+                    break;
+                }
                 opts_memory = (ssize_t) bytes;
                 break;
             case 'v':
@@ -200,24 +226,28 @@ int main(int argc, char** argv)
         mfu_debug_level = MFU_LOG_ERR;
     }
 
-    if (!opts_create && !opts_extract && rank == 0) {
-        MFU_LOG(MFU_LOG_ERR, "One of extract(x) or create(c) need to be specified");
+    if (!opts_create && !opts_extract && !opts_list && rank == 0) {
+        MFU_LOG(MFU_LOG_ERR, "One of extract(x), create(c), or list(t) need to be specified");
         DTAR_exit(EXIT_FAILURE);
     }
 
-    if (opts_create && opts_extract && rank == 0) {
-        MFU_LOG(MFU_LOG_ERR, "Only one of extraction(x) or create(c) can be specified");
+    if (opts_create + opts_extract + opts_list > 1 && rank == 0) {
+        MFU_LOG(MFU_LOG_ERR, "Only one of extraction(x), create(c), or list(t) can be specified");
         DTAR_exit(EXIT_FAILURE);
     }
 
-    /* when creating a tarbll, we require a file name */
-    if (opts_create && opts_tarfile == NULL) {
+    /* when creating or listing a tarbll, we require a file name */
+    if ((opts_create || opts_list) && opts_tarfile == NULL) {
         MFU_LOG(MFU_LOG_ERR, "Must specify a file name(-f)");
         DTAR_exit(EXIT_FAILURE);
     }
 
     /* done by default */
     mfu_archive_options_t archive_opts;
+    archive_opts.preserve = 0;
+    archive_opts.compress = opts_compress;
+    archive_opts.block_size  = (size_t) opts_blocksize;
+    archive_opts.member_size = (size_t) opts_memory;
     archive_opts.flags  = ARCHIVE_EXTRACT_TIME;
     archive_opts.flags |= ARCHIVE_EXTRACT_OWNER;
     archive_opts.flags |= ARCHIVE_EXTRACT_PERM;
@@ -260,29 +290,14 @@ int main(int argc, char** argv)
         mfu_param_path_check_archive(num_src_params, src_params, dest_param, &valid);
 
         /* walk path to get stats info on all files */
+        mfu_file_t* mfu_file = mfu_file_new();
         mfu_flist flist = mfu_flist_new();
-        mfu_flist_walk_param_paths(num_src_params, src_params, walk_opts, flist);
+        mfu_flist_walk_param_paths(num_src_params, src_params, walk_opts, flist, mfu_file);
+        mfu_file_delete(&mfu_file);
 
         /* create the archive file */
         mfu_flist_archive_create(flist, opts_tarfile, &archive_opts);
 
-        /* compress archive file */
-        if (opts_compress) {
-            struct stat st;
-            char fname[50];
-            char fname1[50];
-            strncpy(fname1, opts_tarfile, 50);
-            strncpy(fname, opts_tarfile, 50);
-            if ((stat(strcat(fname, ".bz2"), &st) == 0)) {
-                if (rank == 0) {
-                    printf("Output file already exists\n");
-                }
-                exit(0);
-            }
-            //dbz2_compress(opts_blocksize, opts_tarfile, opts_memory);
-            remove(fname1);
-        }
-
         /* free the file list */
         mfu_flist_free(&flist);
 
@@ -290,27 +305,10 @@ int main(int argc, char** argv)
         mfu_param_path_free_all(num_src_params, src_params);
         mfu_param_path_free(&dest_param);
     } else if (opts_extract) {
-        char* tarfile = opts_tarfile;
-        if (opts_compress) {
-            char fname[50];
-            char fname_out[50];
-            strncpy(fname, opts_tarfile, 50);
-            strncpy(fname_out, opts_tarfile, 50);
-            size_t len = strlen(fname_out);
-            fname_out[len - 4] = '\0';
-            printf("The file name is:%s %s %d", fname, fname_out, (int)len);
-            struct stat st;
-            if ((stat(fname_out, &st) == 0)) {
-                if (rank == 0) {
-                    printf("Output file already exists\n");
-                }
-                exit(0);
-            }
-            //decompress(fname, fname_out);
-            remove(fname);
-            tarfile = fname_out;
-        }
-        mfu_flist_archive_extract(tarfile, opts_verbose, archive_opts.flags);
+        /* compression is detected when reading */
+        mfu_flist_archive_extract(opts_tarfile, numpaths, pathlist, opts_verbose, archive_opts.flags);
+    } else if (opts_list) {
+        mfu_flist_archive_list(opts_tarfile, opts_verbose);
     } else {
         if (rank == 0) {
             MFU_LOG(MFU_LOG_ERR, "Neither creation or extraction is specified");
@@ -26,12 +26,13 @@
 #include <archive_entry.h>
 #include <string.h>
 #include <getopt.h>
+#include <limits.h>
+#include <fnmatch.h>
+#include <bzlib.h>
 
 #include "mfu.h"
 #include "mfu_flist_archive.h"
 
-#define DTAR_HDR_LENGTH 1536
-
 typedef enum {
     COPY_DATA
 } DTAR_operation_code_t;
@@ -70,6 +71,8 @@ int num_src_params;
 
 mfu_flist DTAR_flist;
 uint64_t* DTAR_offsets = NULL;
+uint64_t* DTAR_hdrlens = NULL;
+uint64_t* DTAR_members = NULL;
 mfu_archive_options_t DTAR_user_opts;
 DTAR_writer_t DTAR_writer;
 DTAR_statistics_t DTAR_statistics;
@@ -89,7 +92,41 @@ static void DTAR_exit(int code)
     exit(code);
 }
 
-static void DTAR_write_header(struct archive* ar, uint64_t idx, uint64_t offset)
+/* growable buffer that libarchive writes a header into */
+typedef struct {
+    char* buf;
+    size_t size;
+    size_t used;
+} DTAR_membuf_t;
+
+/* grow buffer so that it has room for len more bytes */
+static void DTAR_membuf_reserve(DTAR_membuf_t* mb, size_t len)
+{
+    if (mb->used + len > mb->size) {
+        size_t size = (mb->size == 0) ? 4096 : mb->size;
+        while (size < mb->used + len) {
+            size *= 2;
+        }
+        mb->buf = (char*) realloc(mb->buf, size);
+        if (mb->buf == NULL) {
+            MFU_ABORT(1, "Failed to allocate memory for archive");
+        }
+        mb->size = size;
+    }
+}
+
+static ssize_t DTAR_membuf_write(struct archive* a, void* data, const void* buf, size_t len)
+{
+    DTAR_membuf_t* mb = (DTAR_membuf_t*) data;
+    DTAR_membuf_reserve(mb, len);
+    memcpy(mb->buf + mb->used, buf, len);
+    mb->used += len;
+    return (ssize_t) len;
+}
+
+/* build header of item idx in memory, returns its length in bytes,
+ * which is a multiple of 512 and includes any pax extended header */
+static size_t DTAR_render_header(uint64_t idx, DTAR_membuf_t* mb)
 {
     /* allocate and entry for this item */
     struct archive_entry* entry = archive_entry_new();
@@ -100,20 +137,34 @@ static void DTAR_write_header(struct archive* ar, uint64_t idx, uint64_t offset)
     archive_entry_copy_pathname(entry, &fname[1]);
 
     if (DTAR_user_opts.preserve) {
+        /* let libarchive lstat the item by name, so that
+         * symlinks are not followed */
         struct archive* source = archive_read_disk_new();
         archive_read_disk_set_standard_lookup(source);
-        int fd = open(fname, O_RDONLY);
-        if (archive_read_disk_entry_from_file(source, entry, fd, NULL) != ARCHIVE_OK) {
-            MFU_LOG(MFU_LOG_ERR, "archive_read_disk_entry_from_file(): %s", archive_error_string(ar));
+        archive_entry_copy_sourcepath(entry, fname);
+        if (archive_read_disk_entry_from_file(source, entry, -1, NULL) != ARCHIVE_OK) {
+            MFU_LOG(MFU_LOG_ERR, "archive_read_disk_entry_from_file(): %s", archive_error_string(source));
         }
         archive_read_free(source);
-        close(fd);
     } else {
         /* TODO: read stat info from mfu_flist */
         struct stat stbuf;
         mfu_lstat(fname, &stbuf);
         archive_entry_copy_stat(entry, &stbuf);
 
+        /* set target of symlink */
+        if (S_ISLNK(stbuf.st_mode)) {
+            char target[PATH_MAX + 1];
+            ssize_t len = mfu_readlink(fname, target, sizeof(target) - 1);
+            if (len < 0) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to read link `%s' (errno=%d %s)",
+                        fname, errno, strerror(errno));
+                len = 0;
+            }
+            target[len] = '\0';
+            archive_entry_copy_symlink(entry, target);
+        }
+
         /* set user name of owner */
         const char* uname = mfu_flist_file_get_username(DTAR_flist, idx);
         archive_entry_set_uname(entry, uname);
@@ -123,31 +174,57 @@ static void DTAR_write_header(struct archive* ar, uint64_t idx, uint64_t offset)
         archive_entry_set_gname(entry, gname);
     }
 
-    /* TODO: Seems to be a bug here potentially leading to corrupted
-     * archive files.  archive_write_free also writes two blocks of
-     * NULL bytes at the end of an archive file, however, each rank
-     * will have a different view of the length of the file, so one
-     * rank may write its NULL blocks over top of the actual data
-     * written by another rank */
+    /* space in the archive was set aside for the size found in the
+     * walk, so use that size even if the file has changed since */
+    if (mfu_flist_file_get_type(DTAR_flist, idx) == MFU_TYPE_FILE) {
+        archive_entry_set_size(entry, (la_int64_t) mfu_flist_file_get_size(DTAR_flist, idx));
+    }
 
-    /* write entry info to archive */
+    /* write header to memory, without blocking, so that we can
+     * tell its exact length before the end of archive marker that
+     * libarchive adds when the archive is freed */
     struct archive* dest = archive_write_new();
     archive_write_set_format_pax(dest);
+    archive_write_set_bytes_per_block(dest, 0);
 
-    if (archive_write_open_fd(dest, DTAR_writer.fd_tar) != ARCHIVE_OK) {
-        MFU_LOG(MFU_LOG_ERR, "archive_write_open_fd(): %s", archive_error_string(ar));
+    mb->used = 0;
+    if (archive_write_open2(dest, mb, NULL, DTAR_membuf_write, NULL, NULL) != ARCHIVE_OK) {
+        MFU_LOG(MFU_LOG_ERR, "archive_write_open2(): %s", archive_error_string(dest));
     }
 
-    /* seek to offset in tar archive for this file */
-    lseek(DTAR_writer.fd_tar, offset, SEEK_SET);
-
-    /* write header for this item */
     if (archive_write_header(dest, entry) != ARCHIVE_OK) {
-        MFU_LOG(MFU_LOG_ERR, "archive_write_header(): %s", archive_error_string(ar));
+        MFU_LOG(MFU_LOG_ERR, "archive_write_header(): %s", archive_error_string(dest));
     }
+    size_t len = mb->used;
 
     archive_entry_free(entry);
     archive_write_free(dest);
+
+    return len;
+}
+
+/* write header for item idx at its offset in the tar archive,
+ * returns 0 on success and -1 on error */
+static int DTAR_write_header(uint64_t idx, uint64_t offset, DTAR_membuf_t* mb)
+{
+    /* the header is built again, and it no longer fits in the space
+     * set aside for it if the item changed since it was sized */
+    size_t len = DTAR_render_header(idx, mb);
+    if (len != DTAR_hdrlens[idx]) {
+        MFU_LOG(MFU_LOG_ERR, "Header of `%s' changed size from %llu to %llu bytes",
+                mfu_flist_file_get_name(DTAR_flist, idx),
+                (unsigned long long) DTAR_hdrlens[idx], (unsigned long long) len);
+        return -1;
+    }
+
+    ssize_t rc = pwrite(DTAR_writer.fd_tar, mb->buf, len, (off_t) offset);
+    if (rc != (ssize_t) len) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to write header to `%s' at offset %llu (errno=%d %s)",
+                DTAR_writer.name, (unsigned long long) offset, errno, strerror(errno));
+        return -1;
+    }
+
+    return 0;
 }
 
 static char* DTAR_encode_operation(DTAR_operation_code_t code, const char* operand,
@@ -220,7 +297,7 @@ static void DTAR_enqueue_copy(CIRCLE_handle* handle)
             uint64_t size = mfu_flist_file_get_size(DTAR_flist, idx);
 
             /* compute offset for first byte of file content */
-            uint64_t dataoffset = DTAR_offsets[idx] + DTAR_HDR_LENGTH;
+            uint64_t dataoffset = DTAR_offsets[idx] + DTAR_hdrlens[idx];
 
             /* compute number of chunks */
             uint64_t num_chunks = size / DTAR_user_opts.chunk_size;
@@ -257,20 +334,38 @@ static void DTAR_perform_copy(CIRCLE_handle* handle)
 
     ssize_t num_of_bytes_read = 0;
     ssize_t num_of_bytes_written = 0;
-    ssize_t total_bytes_written = 0;
+    uint64_t total_bytes_written = 0;
 
     uint64_t out_offset = op->offset + in_offset;
 
     lseek(in_fd, in_offset, SEEK_SET);
     lseek(out_fd, out_offset, SEEK_SET);
 
-    while (total_bytes_written < DTAR_user_opts.chunk_size) {
-        num_of_bytes_read = read(in_fd, &iobuf[0], sizeof(iobuf));
-        if (! num_of_bytes_read) {
-            break;
+    /* the header records the size found in the walk, so copy exactly
+     * that many bytes, and write zeros in place of data if the file
+     * has shrunk since */
+    uint64_t chunk_bytes = op->file_size - in_offset;
+    if (chunk_bytes > DTAR_user_opts.chunk_size) {
+        chunk_bytes = DTAR_user_opts.chunk_size;
+    }
+
+    while (total_bytes_written < chunk_bytes) {
+        size_t count = sizeof(iobuf);
+        if ((uint64_t) count > chunk_bytes - total_bytes_written) {
+            count = (size_t) (chunk_bytes - total_bytes_written);
+        }
+        num_of_bytes_read = read(in_fd, &iobuf[0], count);
+        if (num_of_bytes_read <= 0) {
+            memset(iobuf, 0, count);
+            num_of_bytes_read = (ssize_t) count;
         }
         num_of_bytes_written = write(out_fd, &iobuf[0], num_of_bytes_read);
-        total_bytes_written += num_of_bytes_written;
+        if (num_of_bytes_written <= 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to write to `%s' (errno=%d %s)",
+                    DTAR_writer.name, errno, strerror(errno));
+            break;
+        }
+        total_bytes_written += (uint64_t) num_of_bytes_written;
     }
 
     uint64_t num_chunks = op->file_size / DTAR_user_opts.chunk_size;
@@ -283,6 +378,7 @@ static void DTAR_perform_copy(CIRCLE_handle* handle)
         if (padding > 0 && padding != 512) {
             char* buff = (char*) calloc(padding, sizeof(char));
             write(out_fd, buff, padding);
+            free(buff);
         }
     }
 
@@ -293,6 +389,7 @@ static void DTAR_perform_copy(CIRCLE_handle* handle)
 void mfu_param_path_check_archive(int numparams, mfu_param_path* srcparams, mfu_param_path destparam, int* valid)
 {
     /* TODO: need to parallize this, rather than have every rank do the test */
+    MPI_Comm_rank(MPI_COMM_WORLD, &DTAR_rank);
 
     /* assume paths are valid */
     *valid = 1;
@@ -364,6 +461,733 @@ bcast:
     }
 }
 
+/* The index of an archive is stored next to it in a file of the same
+ * name with DTAR_INDEX_SUFFIX appended.  It starts with a header of
+ * DTAR_INDEX_HEADER_VALUES uint64 values:
+ *   version, number of entries, bytes in each path, offset of end
+ *   of the last entry, size of the archive file, compression filter,
+ *   bytes of uncompressed data in each member, mtime, mtime_nsec,
+ *   and inode of the archive file
+ * followed by one record for each entry in the order they appear in the
+ * archive, each with DTAR_INDEX_RECORD_VALUES uint64 values:
+ *   offset of header, offset of data, size, mode, mtime, offset of member
+ * and then the path of the entry, padded with NUL bytes.  Offsets of
+ * headers and data are those in the uncompressed archive.  A compressed
+ * archive is a sequence of bzip2 members, where each member but the last
+ * holds the same number of bytes of the uncompressed archive, and the
+ * offset of member is the offset in the archive file of the member that
+ * holds the first byte of the header.  In an uncompressed
+ * archive, the bytes in each member are 0, and the offset of member is the
+ * offset of the header.  Values are stored in the byte order of the host
+ * that wrote the index.  The mtime and inode of the archive are filled in
+ * once the archive is complete, so an index is only used for the archive
+ * file it was written with, and not after that file is modified or
+ * replaced by another of the same size. */
+#define DTAR_INDEX_SUFFIX ".idx"
+#define DTAR_INDEX_VERSION (4)
+#define DTAR_INDEX_HEADER_VALUES (10)
+#define DTAR_INDEX_STAMP_VALUE (7)
+#define DTAR_INDEX_RECORD_VALUES (6)
+
+/* describes an entry found in the index or while scanning an archive */
+typedef struct {
+    const char* path;      /* path of entry, NULL after the last entry */
+    uint64_t offset;       /* offset of header, or end of last entry */
+    uint64_t data_offset;  /* offset of data, 0 if not known */
+    uint64_t size;         /* size of data */
+    uint64_t mode;         /* type and permissions */
+    uint64_t mtime;        /* modification time */
+    uint64_t member;       /* file offset of member that holds the header */
+    uint64_t member_start; /* offset in uncompressed archive where member starts */
+    int filter;            /* compression filter of archive */
+} DTAR_index_entry_t;
+
+/* called for each entry in an archive, and once more with a NULL path */
+typedef void (*DTAR_index_fn)(const DTAR_index_entry_t* entry, void* arg);
+
+/* return newly allocated name of index of archive */
+static char* DTAR_index_name(const char* archivefile)
+{
+    size_t len = strlen(archivefile) + strlen(DTAR_INDEX_SUFFIX) + 1;
+    char* name = (char*) MFU_MALLOC(len);
+    snprintf(name, len, "%s%s", archivefile, DTAR_INDEX_SUFFIX);
+    return name;
+}
+
+/* state to write the index while records are added in archive order */
+typedef struct {
+    char* name;        /* name of index file */
+    MPI_File fh;       /* handle of index file */
+    uint64_t chars;    /* bytes in each path */
+    size_t elem_size;  /* bytes in each record */
+    uint64_t count;    /* number of records written by all ranks */
+    char* buf;         /* buffer to pack records into */
+    size_t bufsize;    /* size of buffer in bytes */
+} DTAR_index_writer_t;
+
+/* open index of the entries in DTAR_flist, whose headers have been sized */
+static void DTAR_index_writer_open(DTAR_index_writer_t* w, const char* archivefile)
+{
+    /* find longest path we have in the archive */
+    uint64_t idx;
+    uint64_t max = 0;
+    for (idx = 0; idx < DTAR_count; idx++) {
+        if (DTAR_hdrlens[idx] > 0) {
+            const char* fname = mfu_flist_file_get_name(DTAR_flist, idx);
+            uint64_t len = (uint64_t) strlen(&fname[1]) + 1;
+            if (len > max) {
+                max = len;
+            }
+        }
+    }
+
+    /* use an integer number of 8 byte segments for each path */
+    MPI_Allreduce(&max, &w->chars, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
+    w->chars = (w->chars + 7) / 8 * 8;
+
+    w->elem_size = DTAR_INDEX_RECORD_VALUES * 8 + (size_t) w->chars;
+    w->count = 0;
+
+    w->bufsize = 1024 * 1024;
+    if (w->bufsize < w->elem_size) {
+        w->bufsize = w->elem_size;
+    }
+    w->buf = (char*) MFU_MALLOC(w->bufsize);
+
+    w->name = DTAR_index_name(archivefile);
+
+    int amode = MPI_MODE_WRONLY | MPI_MODE_CREATE;
+    int mpirc = MPI_File_open(MPI_COMM_WORLD, w->name, amode, MPI_INFO_NULL, &w->fh);
+    if (mpirc != MPI_SUCCESS) {
+        MFU_ABORT(1, "Failed to open file for writing: `%s' rc=%d", w->name, mpirc);
+    }
+
+    /* truncate file to 0 bytes */
+    mpirc = MPI_File_set_size(w->fh, 0);
+    if (mpirc != MPI_SUCCESS) {
+        MFU_ABORT(1, "Failed to truncate file: `%s' rc=%d", w->name, mpirc);
+    }
+}
+
+/* add records for the sized items in [first, last) of DTAR_flist, the
+ * items of each rank follow those of lower ranks in the archive, must
+ * be called by all ranks */
+static void DTAR_index_writer_add(DTAR_index_writer_t* w, uint64_t first, uint64_t last)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    /* count entries we add */
+    uint64_t idx;
+    uint64_t count = 0;
+    for (idx = first; idx < last; idx++) {
+        if (DTAR_hdrlens[idx] > 0) {
+            count++;
+        }
+    }
+
+    /* compute total number of entries and the index of our first one */
+    uint64_t all_count;
+    uint64_t offset = 0;
+    MPI_Allreduce(&count, &all_count, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Exscan(&count, &offset, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) {
+        offset = 0;
+    }
+
+    /* pack records into a buffer, and write it with as many
+     * collective writes as the rank with the most records needs */
+    uint64_t bufcount = (uint64_t) (w->bufsize / w->elem_size);
+    uint64_t iters = (count + bufcount - 1) / bufcount;
+    uint64_t all_iters;
+    MPI_Allreduce(&iters, &all_iters, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
+
+    MPI_Offset write_offset = (MPI_Offset) (DTAR_INDEX_HEADER_VALUES * 8) +
+                              (MPI_Offset) ((w->count + offset) * w->elem_size);
+
+    idx = first;
+    while (all_iters > 0) {
+        char* ptr = w->buf;
+        uint64_t packcount = 0;
+        while (idx < last && packcount < bufcount) {
+            if (DTAR_hdrlens[idx] > 0) {
+                const char* fname = mfu_flist_file_get_name(DTAR_flist, idx);
+                uint64_t size = 0;
+                if (mfu_flist_file_get_type(DTAR_flist, idx) == MFU_TYPE_FILE) {
+                    size = mfu_flist_file_get_size(DTAR_flist, idx);
+                }
+
+                /* without compression, each entry is its own member */
+                uint64_t member = DTAR_offsets[idx];
+                if (DTAR_members != NULL) {
+                    member = DTAR_members[idx];
+                }
+
+                mfu_pack_uint64(&ptr, DTAR_offsets[idx]);
+                mfu_pack_uint64(&ptr, DTAR_offsets[idx] + DTAR_hdrlens[idx]);
+                mfu_pack_uint64(&ptr, size);
+                mfu_pack_uint64(&ptr, mfu_flist_file_get_mode(DTAR_flist, idx));
+                mfu_pack_uint64(&ptr, mfu_flist_file_get_mtime(DTAR_flist, idx));
+                mfu_pack_uint64(&ptr, member);
+
+                memset(ptr, 0, (size_t) w->chars);
+                strcpy(ptr, &fname[1]);
+                ptr += w->chars;
+
+                packcount++;
+            }
+            idx++;
+        }
+
+        MPI_Status status;
+        int write_count = (int) (packcount * w->elem_size);
+        int mpirc = MPI_File_write_at_all(w->fh, write_offset, w->buf, write_count, MPI_BYTE, &status);
+        if (mpirc != MPI_SUCCESS) {
+            MFU_ABORT(1, "Failed to write to file: `%s' rc=%d", w->name, mpirc);
+        }
+        write_offset += (MPI_Offset) write_count;
+
+        all_iters--;
+    }
+
+    w->count += all_count;
+}
+
+/* write header of index and close it, end is the offset of the end
+ * of the last entry in the uncompressed archive, archive_bytes is the
+ * size of the archive file, and member_bytes is the number of bytes of
+ * the uncompressed archive in each compressed member, must be called by
+ * all ranks */
+static void DTAR_index_writer_close(
+    DTAR_index_writer_t* w,
+    uint64_t end,
+    uint64_t archive_bytes,
+    int filter,
+    uint64_t member_bytes)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    if (rank == 0) {
+        MPI_Status status;
+        uint64_t header[DTAR_INDEX_HEADER_VALUES];
+        char* ptr = (char*) header;
+        mfu_pack_uint64(&ptr, DTAR_INDEX_VERSION);
+        mfu_pack_uint64(&ptr, w->count);
+        mfu_pack_uint64(&ptr, w->chars);
+        mfu_pack_uint64(&ptr, end);
+        mfu_pack_uint64(&ptr, archive_bytes);
+        mfu_pack_uint64(&ptr, (uint64_t) filter);
+        mfu_pack_uint64(&ptr, member_bytes);
+
+        /* no archive matches until DTAR_index_stamp fills these in */
+        mfu_pack_uint64(&ptr, 0);
+        mfu_pack_uint64(&ptr, 0);
+        mfu_pack_uint64(&ptr, 0);
+        int mpirc = MPI_File_write_at(w->fh, 0, header, (int) sizeof(header), MPI_BYTE, &status);
+        if (mpirc != MPI_SUCCESS) {
+            MFU_ABORT(1, "Failed to write to file: `%s' rc=%d", w->name, mpirc);
+        }
+    }
+
+    int mpirc = MPI_File_close(&w->fh);
+    if (mpirc != MPI_SUCCESS) {
+        MFU_ABORT(1, "Failed to close file: `%s' rc=%d", w->name, mpirc);
+    }
+
+    mfu_free(&w->buf);
+    mfu_free(&w->name);
+}
+
+/* record the mtime and inode of the archive in its index, call once
+ * all ranks have finished writing and closed the archive */
+static void DTAR_index_stamp(const char* archivefile)
+{
+    char* name = DTAR_index_name(archivefile);
+
+    struct stat st;
+    if (stat(archivefile, &st) != 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to stat `%s' (errno=%d %s)",
+                archivefile, errno, strerror(errno));
+        mfu_free(&name);
+        return;
+    }
+
+    uint64_t secs, nsecs;
+    mfu_stat_get_mtimes(&st, &secs, &nsecs);
+
+    uint64_t values[3];
+    char* ptr = (char*) values;
+    mfu_pack_uint64(&ptr, secs);
+    mfu_pack_uint64(&ptr, nsecs);
+    mfu_pack_uint64(&ptr, (uint64_t) st.st_ino);
+
+    int fd = mfu_open(name, O_WRONLY);
+    if (fd < 0 ||
+        pwrite(fd, values, sizeof(values), (off_t) (DTAR_INDEX_STAMP_VALUE * 8)) != (ssize_t) sizeof(values))
+    {
+        MFU_LOG(MFU_LOG_ERR, "Failed to write index `%s' (errno=%d %s)",
+                name, errno, strerror(errno));
+    }
+    if (fd >= 0) {
+        mfu_close(name, fd);
+    }
+
+    mfu_free(&name);
+}
+
+/* number of bytes of file data compressed at a time */
+#define DTAR_COMPRESS_READ_SIZE (1024 * 1024)
+
+/* compresses one member into memory as a bzip2 stream */
+typedef struct {
+    bz_stream strm;     /* state of bzip2 stream */
+    DTAR_membuf_t out;  /* compressed bytes */
+    char* iobuf;        /* buffer to read file data into */
+} DTAR_member_t;
+
+/* compress len bytes of buf into the member, and finish
+ * the stream if action is BZ_FINISH */
+static void DTAR_member_compress(DTAR_member_t* m, const char* buf, size_t len, int action)
+{
+    m->strm.next_in  = (char*) buf;
+    m->strm.avail_in = (unsigned int) len;
+    while (1) {
+        DTAR_membuf_reserve(&m->out, DTAR_COMPRESS_READ_SIZE);
+        m->strm.next_out  = m->out.buf + m->out.used;
+        m->strm.avail_out = (unsigned int) (m->out.size - m->out.used);
+
+        int rc = BZ2_bzCompress(&m->strm, action);
+        m->out.used = (size_t) (m->strm.next_out - m->out.buf);
+
+        if (action == BZ_RUN) {
+            if (rc != BZ_RUN_OK) {
+                MFU_ABORT(1, "Failed to compress archive data rc=%d", rc);
+            }
+            if (m->strm.avail_in == 0) {
+                break;
+            }
+        } else {
+            if (rc == BZ_STREAM_END) {
+                break;
+            }
+            if (rc != BZ_FINISH_OK) {
+                MFU_ABORT(1, "Failed to compress archive data rc=%d", rc);
+            }
+        }
+    }
+}
+
+/* compress len bytes of zeros into the member */
+static void DTAR_member_zeros(DTAR_member_t* m, uint64_t len)
+{
+    memset(m->iobuf, 0, DTAR_COMPRESS_READ_SIZE);
+    while (len > 0) {
+        size_t n = DTAR_COMPRESS_READ_SIZE;
+        if ((uint64_t) n > len) {
+            n = (size_t) len;
+        }
+        DTAR_member_compress(m, m->iobuf, n, BZ_RUN);
+        len -= (uint64_t) n;
+    }
+}
+
+/* start a new member */
+static void DTAR_member_begin(DTAR_member_t* m)
+{
+    m->out.used = 0;
+    memset(&m->strm, 0, sizeof(m->strm));
+    int rc = BZ2_bzCompressInit(&m->strm, (int) DTAR_user_opts.block_size, 0, 0);
+    if (rc != BZ_OK) {
+        MFU_ABORT(1, "Failed to initialize compression rc=%d", rc);
+    }
+}
+
+/* finish member, its compressed bytes are in m->out */
+static void DTAR_member_end(DTAR_member_t* m)
+{
+    DTAR_member_compress(m, NULL, 0, BZ_FINISH);
+    BZ2_bzCompressEnd(&m->strm);
+}
+
+/* compress len bytes of the data of file name, starting at offset, into
+ * the member, data past size is written as zeros, which pads the data
+ * to a full block and stands in for data of a file that has shrunk */
+static void DTAR_member_file(DTAR_member_t* m, const char* name, uint64_t size, uint64_t offset, uint64_t len)
+{
+    int fd = -1;
+    if (offset < size) {
+        fd = mfu_open(name, O_RDONLY);
+        if (fd < 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to open `%s' (errno=%d %s)",
+                    name, errno, strerror(errno));
+        }
+    }
+
+    while (len > 0) {
+        size_t n = DTAR_COMPRESS_READ_SIZE;
+        if ((uint64_t) n > len) {
+            n = (size_t) len;
+        }
+        memset(m->iobuf, 0, n);
+
+        /* read file data, leaving zeros after its end */
+        if (fd >= 0 && offset < size) {
+            size_t want = n;
+            if ((uint64_t) want > size - offset) {
+                want = (size_t) (size - offset);
+            }
+            size_t got = 0;
+            while (got < want) {
+                ssize_t nread = pread(fd, m->iobuf + got, want - got, (off_t) (offset + got));
+                if (nread <= 0) {
+                    MFU_LOG(MFU_LOG_ERR, "Failed to read `%s' (errno=%d %s)",
+                            name, errno, strerror(errno));
+                    mfu_close(name, fd);
+                    fd = -1;
+                    memset(m->iobuf, 0, n);
+                    break;
+                }
+                got += (size_t) nread;
+            }
+        }
+
+        DTAR_member_compress(m, m->iobuf, n, BZ_RUN);
+        offset += (uint64_t) n;
+        len    -= (uint64_t) n;
+    }
+
+    if (fd >= 0) {
+        mfu_close(name, fd);
+    }
+}
+
+/* write len bytes of buf to the archive at offset */
+static void DTAR_write_at(const char* buf, size_t len, uint64_t offset)
+{
+    while (len > 0) {
+        ssize_t rc = pwrite(DTAR_writer.fd_tar, buf, len, (off_t) offset);
+        if (rc <= 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to write to `%s' at offset %llu (errno=%d %s)",
+                    DTAR_writer.name, (unsigned long long) offset, errno, strerror(errno));
+            return;
+        }
+        buf    += rc;
+        len    -= (size_t) rc;
+        offset += (uint64_t) rc;
+    }
+}
+
+/* an entry sent to the rank that compresses part of it is packed as
+ * DTAR_PART_VALUES uint64 values:
+ *   offset of header, length of header, size of file data,
+ *   bytes in name, bytes of header that follow the name
+ * followed by the name and then the header, if it is included */
+#define DTAR_PART_VALUES (5)
+
+/* pack entry idx for a rank whose member covers [start, end) of the
+ * uncompressed archive, hdr holds the header of the entry */
+static void DTAR_part_pack(DTAR_membuf_t* mb, uint64_t idx, const DTAR_membuf_t* hdr,
+                           uint64_t start, uint64_t end)
+{
+    uint64_t offset = DTAR_offsets[idx];
+    uint64_t hdrlen = DTAR_hdrlens[idx];
+
+    uint64_t size = 0;
+    if (mfu_flist_file_get_type(DTAR_flist, idx) == MFU_TYPE_FILE) {
+        size = mfu_flist_file_get_size(DTAR_flist, idx);
+    }
+
+    /* only the rank that compresses the header needs it */
+    uint64_t hdrbytes = 0;
+    if (offset < end && offset + hdrlen > start) {
+        hdrbytes = hdrlen;
+    }
+
+    const char* name = mfu_flist_file_get_name(DTAR_flist, idx);
+    uint64_t namelen = (uint64_t) strlen(name) + 1;
+
+    DTAR_membuf_reserve(mb, DTAR_PART_VALUES * 8 + (size_t) namelen + (size_t) hdrbytes);
+    char* ptr = mb->buf + mb->used;
+    mfu_pack_uint64(&ptr, offset);
+    mfu_pack_uint64(&ptr, hdrlen);
+    mfu_pack_uint64(&ptr, size);
+    mfu_pack_uint64(&ptr, namelen);
+    mfu_pack_uint64(&ptr, hdrbytes);
+    memcpy(ptr, name, (size_t) namelen);
+    ptr += namelen;
+    if (hdrbytes > 0) {
+        memcpy(ptr, hdr->buf, (size_t) hdrbytes);
+        ptr += hdrbytes;
+    }
+    mb->used = (size_t) (ptr - mb->buf);
+}
+
+/* compress bytes [start, end) of the uncompressed archive into the member
+ * from the count bytes of packed entries in buf, which are in order, and
+ * the bytes after archive_size, which are the zeros of the end marker */
+static void DTAR_member_range(DTAR_member_t* m, const char* buf, size_t count,
+                              uint64_t start, uint64_t end, uint64_t archive_size)
+{
+    uint64_t pos = start;
+
+    const char* ptr = buf;
+    while (ptr < buf + count) {
+        uint64_t offset, hdrlen, size, namelen, hdrbytes;
+        mfu_unpack_uint64(&ptr, &offset);
+        mfu_unpack_uint64(&ptr, &hdrlen);
+        mfu_unpack_uint64(&ptr, &size);
+        mfu_unpack_uint64(&ptr, &namelen);
+        mfu_unpack_uint64(&ptr, &hdrbytes);
+        const char* name = ptr;
+        ptr += namelen;
+        const char* hdr = ptr;
+        ptr += hdrbytes;
+
+        /* part of the header that falls in our range */
+        uint64_t lo = (pos > offset) ? pos : offset;
+        uint64_t hi = (end < offset + hdrlen) ? end : offset + hdrlen;
+        if (lo < hi) {
+            DTAR_member_compress(m, hdr + (lo - offset), (size_t) (hi - lo), BZ_RUN);
+            pos = hi;
+        }
+
+        /* part of the data, padded to a full block, that falls in our range */
+        uint64_t data = offset + hdrlen;
+        uint64_t data_end = data + (size + 511) / 512 * 512;
+        lo = (pos > data) ? pos : data;
+        hi = (end < data_end) ? end : data_end;
+        if (lo < hi) {
+            DTAR_member_file(m, name, size, lo - data, hi - lo);
+            pos = hi;
+        }
+    }
+
+    /* the end marker follows the last entry */
+    if (pos < end) {
+        if (pos < archive_size) {
+            MFU_LOG(MFU_LOG_ERR, "Missing archive data at offset %llu",
+                    (unsigned long long) pos);
+        }
+        DTAR_member_zeros(m, end - pos);
+    }
+}
+
+/* write items of DTAR_flist, whose offsets have been set, as a sequence
+ * of bzip2 members, archive_size is the offset of the end of the last
+ * entry, adds the number of items that could not be written to errors,
+ * and returns the size of the archive file
+ *
+ * The uncompressed archive, including its end marker, is cut into
+ * pieces of DTAR_user_opts.member_size bytes, and each piece is
+ * compressed into its own member.  The pieces are handled in rounds.
+ * In each round, each rank compresses the next piece in rank order, so
+ * a large file is compressed by many ranks, and a member may start in
+ * the middle of an entry.  Before compressing, the ranks that hold the
+ * items send the headers and names of the entries that overlap each
+ * piece to the rank that compresses it.  The members of a round are
+ * then placed one after another with the sizes gathered from all ranks.
+ * A reader that decompresses the whole file sees a single tar stream,
+ * and a reader can start at the member that holds any header, dropping
+ * the bytes of the member that come before the header. */
+static uint64_t DTAR_write_compressed(const char* archivefile, uint64_t archive_size,
+                                      DTAR_membuf_t* mb, uint64_t* errors)
+{
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    uint64_t member_bytes = (uint64_t) DTAR_user_opts.member_size;
+    uint64_t total = archive_size + 1024;
+    uint64_t members = (total + member_bytes - 1) / member_bytes;
+    uint64_t round_bytes = member_bytes * (uint64_t) ranks;
+    uint64_t rounds = (total + round_bytes - 1) / round_bytes;
+
+    DTAR_members = (uint64_t*) MFU_MALLOC(DTAR_count * sizeof(uint64_t));
+
+    DTAR_member_t m;
+    memset(&m, 0, sizeof(m));
+    m.iobuf = (char*) MFU_MALLOC(DTAR_COMPRESS_READ_SIZE);
+
+    /* entries packed for each rank */
+    DTAR_membuf_t* parts = (DTAR_membuf_t*) MFU_MALLOC((size_t) ranks * sizeof(DTAR_membuf_t));
+    memset(parts, 0, (size_t) ranks * sizeof(DTAR_membuf_t));
+
+    int* sendcounts = (int*) MFU_MALLOC((size_t) ranks * sizeof(int));
+    int* senddispls = (int*) MFU_MALLOC((size_t) ranks * sizeof(int));
+    int* recvcounts = (int*) MFU_MALLOC((size_t) ranks * sizeof(int));
+    int* recvdispls = (int*) MFU_MALLOC((size_t) ranks * sizeof(int));
+    uint64_t* sizes = (uint64_t*) MFU_MALLOC((size_t) ranks * sizeof(uint64_t));
+
+    DTAR_membuf_t sendbuf = {NULL, 0, 0};
+    DTAR_membuf_t recvbuf = {NULL, 0, 0};
+
+    /* bytes of the archive file written in earlier rounds */
+    uint64_t base = 0;
+
+    /* first item that may overlap the current round, and first
+     * item whose header is in the current round or a later one */
+    uint64_t first = 0;
+    uint64_t first_header = 0;
+
+    uint64_t round;
+    for (round = 0; round < rounds; round++) {
+        uint64_t round_start = round * round_bytes;
+        uint64_t round_end = round_start + round_bytes;
+
+        /* send each entry that overlaps this round to each rank
+         * whose piece it overlaps */
+        int r;
+        for (r = 0; r < ranks; r++) {
+            parts[r].used = 0;
+        }
+        while (first < DTAR_count && DTAR_offsets[first] + DTAR_hdrlens[first] +
+               (mfu_flist_file_get_type(DTAR_flist, first) == MFU_TYPE_FILE ?
+                (mfu_flist_file_get_size(DTAR_flist, first) + 511) / 512 * 512 : 0) <= round_start)
+        {
+            first++;
+        }
+        uint64_t idx;
+        for (idx = first; idx < DTAR_count && DTAR_offsets[idx] < round_end; idx++) {
+            if (DTAR_hdrlens[idx] == 0) {
+                continue;
+            }
+
+            uint64_t offset = DTAR_offsets[idx];
+            uint64_t entry_end = offset + DTAR_hdrlens[idx];
+            if (mfu_flist_file_get_type(DTAR_flist, idx) == MFU_TYPE_FILE) {
+                entry_end += (mfu_flist_file_get_size(DTAR_flist, idx) + 511) / 512 * 512;
+            }
+
+            /* build the header again if a rank in this round needs it */
+            if (entry_end > round_start && offset + DTAR_hdrlens[idx] > round_start) {
+                size_t len = DTAR_render_header(idx, mb);
+                if (len != DTAR_hdrlens[idx]) {
+                    MFU_LOG(MFU_LOG_ERR, "Header of `%s' changed size from %llu to %llu bytes",
+                            mfu_flist_file_get_name(DTAR_flist, idx),
+                            (unsigned long long) DTAR_hdrlens[idx], (unsigned long long) len);
+                    DTAR_membuf_reserve(mb, (size_t) DTAR_hdrlens[idx]);
+                    (*errors)++;
+                }
+            }
+
+            uint64_t lo = (offset > round_start) ? offset : round_start;
+            uint64_t hi = (entry_end < round_end) ? entry_end : round_end;
+            uint64_t piece;
+            for (piece = lo / member_bytes; piece * member_bytes < hi; piece++) {
+                uint64_t start = piece * member_bytes;
+                r = (int) (piece - round * (uint64_t) ranks);
+                DTAR_part_pack(&parts[r], idx, mb, start, start + member_bytes);
+            }
+        }
+
+        /* exchange entries */
+        size_t sendtotal = 0;
+        for (r = 0; r < ranks; r++) {
+            if (parts[r].used > (size_t) INT_MAX) {
+                MFU_ABORT(1, "Too many archive entries in one round, use a smaller member size");
+            }
+            sendcounts[r] = (int) parts[r].used;
+            senddispls[r] = (int) sendtotal;
+            sendtotal += parts[r].used;
+        }
+        if (sendtotal > (size_t) INT_MAX) {
+            MFU_ABORT(1, "Too many archive entries in one round, use a smaller member size");
+        }
+        sendbuf.used = 0;
+        DTAR_membuf_reserve(&sendbuf, sendtotal + 1);
+        for (r = 0; r < ranks; r++) {
+            memcpy(sendbuf.buf + senddispls[r], parts[r].buf, parts[r].used);
+        }
+
+        MPI_Alltoall(sendcounts, 1, MPI_INT, recvcounts, 1, MPI_INT, MPI_COMM_WORLD);
+        size_t recvtotal = 0;
+        for (r = 0; r < ranks; r++) {
+            recvdispls[r] = (int) recvtotal;
+            recvtotal += (size_t) recvcounts[r];
+        }
+        if (recvtotal > (size_t) INT_MAX) {
+            MFU_ABORT(1, "Too many archive entries in one round, use a smaller member size");
+        }
+        recvbuf.used = 0;
+        DTAR_membuf_reserve(&recvbuf, recvtotal + 1);
+        MPI_Alltoallv(sendbuf.buf, sendcounts, senddispls, MPI_BYTE,
+                      recvbuf.buf, recvcounts, recvdispls, MPI_BYTE, MPI_COMM_WORLD);
+
+        /* compress our piece, entries arrive in order since each
+         * rank holds items that come after those of lower ranks */
+        uint64_t piece = round * (uint64_t) ranks + (uint64_t) rank;
+        m.out.used = 0;
+        if (piece < members) {
+            uint64_t start = piece * member_bytes;
+            uint64_t end = start + member_bytes;
+            if (end > total) {
+                end = total;
+            }
+            DTAR_member_begin(&m);
+            DTAR_member_range(&m, recvbuf.buf, recvtotal, start, end, archive_size);
+            DTAR_member_end(&m);
+        }
+
+        /* place our member after those of lower ranks */
+        uint64_t size = (uint64_t) m.out.used;
+        MPI_Allgather(&size, 1, MPI_UINT64_T, sizes, 1, MPI_UINT64_T, MPI_COMM_WORLD);
+        uint64_t offset = base;
+        for (r = 0; r < rank; r++) {
+            offset += sizes[r];
+        }
+        DTAR_write_at(m.out.buf, m.out.used, offset);
+
+        /* record the member that holds the header of each of our entries */
+        while (first_header < DTAR_count && DTAR_offsets[first_header] < round_end) {
+            uint64_t header_piece = DTAR_offsets[first_header] / member_bytes;
+            uint64_t member_offset = base;
+            for (r = 0; r < (int) (header_piece - round * (uint64_t) ranks); r++) {
+                member_offset += sizes[r];
+            }
+            DTAR_members[first_header] = member_offset;
+            first_header++;
+        }
+
+        for (r = 0; r < ranks; r++) {
+            base += sizes[r];
+        }
+    }
+
+    /* drop anything left from an earlier file of the same name */
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (rank == 0) {
+        if (ftruncate(DTAR_writer.fd_tar, (off_t) base) != 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to truncate `%s' (errno=%d %s)",
+                    DTAR_writer.name, errno, strerror(errno));
+        }
+    }
+
+    /* record where each entry is in an index next to the archive */
+    DTAR_index_writer_t index;
+    DTAR_index_writer_open(&index, archivefile);
+    DTAR_index_writer_add(&index, 0, DTAR_count);
+    DTAR_index_writer_close(&index, archive_size, base, ARCHIVE_FILTER_BZIP2, member_bytes);
+
+    int r;
+    for (r = 0; r < ranks; r++) {
+        mfu_free(&parts[r].buf);
+    }
+    mfu_free(&parts);
+    mfu_free(&sendbuf.buf);
+    mfu_free(&recvbuf.buf);
+    mfu_free(&sendcounts);
+    mfu_free(&senddispls);
+    mfu_free(&recvcounts);
+    mfu_free(&recvdispls);
+    mfu_free(&sizes);
+    mfu_free(&m.out.buf);
+    mfu_free(&m.iobuf);
+    mfu_free(&DTAR_members);
+
+    return base;
+}
+
 static void mfu_flist_archive_create_libcircle(mfu_flist flist, const char* archivefile, mfu_archive_options_t* opts)
 {
     DTAR_flist = flist;
@@ -391,9 +1215,13 @@ static void mfu_flist_archive_create_libcircle(mfu_flist flist, const char* arch
     /* get number of items in our portion of the list */
     DTAR_count = mfu_flist_size(DTAR_flist);
 
-    /* allocate memory for file sizes and offsets */
+    /* allocate memory for file sizes, offsets, and header lengths */
     uint64_t* fsizes = (uint64_t*) MFU_MALLOC(DTAR_count * sizeof(uint64_t));
     DTAR_offsets     = (uint64_t*) MFU_MALLOC(DTAR_count * sizeof(uint64_t));
+    DTAR_hdrlens     = (uint64_t*) MFU_MALLOC(DTAR_count * sizeof(uint64_t));
+
+    /* buffer to build headers in */
+    DTAR_membuf_t mb = {NULL, 0, 0};
 
     /* compute local offsets for each item and total
      * bytes we're contributing to the archive */
@@ -402,27 +1230,20 @@ static void mfu_flist_archive_create_libcircle(mfu_flist flist, const char* arch
     for (idx = 0; idx < DTAR_count; idx++) {
         /* assume the item takes no space */
         fsizes[idx] = 0;
+        DTAR_hdrlens[idx] = 0;
 
         /* identify item type to compute its size in the archive */
         mfu_filetype type = mfu_flist_file_get_type(DTAR_flist, idx);
         if (type == MFU_TYPE_DIR || type == MFU_TYPE_LINK) {
             /* directories and symlinks only need the header */
-            fsizes[idx] = DTAR_HDR_LENGTH;
+            DTAR_hdrlens[idx] = DTAR_render_header(idx, &mb);
+            fsizes[idx] = DTAR_hdrlens[idx];
         } else if (type == MFU_TYPE_FILE) {
             /* regular file requires a header, plus file content,
              * and things are packed into blocks of 512 bytes */
             uint64_t fsize = mfu_flist_file_get_size(DTAR_flist, idx);
-
-            /* determine whether file size is integer multiple of 512 bytes */
-            uint64_t rem = fsize % 512;
-            if (rem == 0) {
-                /* file content is multiple of 512 bytes, so perfect fit */
-                fsizes[idx] = fsize + DTAR_HDR_LENGTH;
-            } else {
-                /* TODO: check and explain this math */
-                fsizes[idx] = (fsize / 512 + 4) * 512;
-            }
-
+            DTAR_hdrlens[idx] = DTAR_render_header(idx, &mb);
+            fsizes[idx] = DTAR_hdrlens[idx] + (fsize + 511) / 512 * 512;
         }
 
         /* increment our local offset for this item */
@@ -430,6 +1251,13 @@ static void mfu_flist_archive_create_libcircle(mfu_flist flist, const char* arch
         offset += fsizes[idx];
     }
 
+    /* offset of end of the last entry, and size of the archive file */
+    uint64_t archive_size = 0;
+    uint64_t archive_bytes = 0;
+
+    /* number of items that could not be written */
+    uint64_t errors = 0;
+
     /* execute scan to figure our global base offset in the archive file */
     uint64_t global_offset = 0;
     MPI_Scan(&offset, &global_offset, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
@@ -440,42 +1268,65 @@ static void mfu_flist_archive_create_libcircle(mfu_flist flist, const char* arch
         DTAR_offsets[idx] += global_offset;
     }
 
-    /* create an archive */
-    struct archive* ar = archive_write_new();
+    /* compute offset of end of the last entry */
+    MPI_Allreduce(&offset, &archive_size, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
 
-    archive_write_set_format_pax(ar);
+    if (DTAR_user_opts.compress) {
+        archive_bytes = DTAR_write_compressed(archivefile, archive_size, &mb, &errors);
+        mfu_free(&mb.buf);
+    } else {
+        /* record where each entry is in an index next to the archive,
+         * the archive ends with two blocks of zeros */
+        DTAR_index_writer_t index;
+        DTAR_index_writer_open(&index, archivefile);
+        DTAR_index_writer_add(&index, 0, DTAR_count);
+        DTAR_index_writer_close(&index, archive_size, archive_size + 1024, ARCHIVE_FILTER_NONE, 0);
+
+        /* write headers for our files */
+        for (idx = 0; idx < DTAR_count; idx++) {
+            if (DTAR_hdrlens[idx] > 0) {
+                if (DTAR_write_header(idx, DTAR_offsets[idx], &mb) != 0) {
+                    errors++;
+                }
+            }
+        }
+        mfu_free(&mb.buf);
 
-    int r = archive_write_open_fd(ar, DTAR_writer.fd_tar);
-    if (r != ARCHIVE_OK) {
-        MFU_LOG(MFU_LOG_ERR, "archive_write_open_fd(): %s", archive_error_string(ar));
-        DTAR_abort(EXIT_FAILURE);
-    }
+        /* prepare libcircle */
+        CIRCLE_init(0, NULL, CIRCLE_SPLIT_EQUAL | CIRCLE_CREATE_GLOBAL | CIRCLE_TERM_TREE);
+        CIRCLE_loglevel loglevel = CIRCLE_LOG_WARN;
+        CIRCLE_enable_logging(loglevel);
 
-    /* write headers for our files */
-    for (idx = 0; idx < DTAR_count; idx++) {
-        mfu_filetype type = mfu_flist_file_get_type(DTAR_flist, idx);
-        if (type == MFU_TYPE_FILE || type == MFU_TYPE_DIR || type == MFU_TYPE_LINK) {
-            DTAR_write_header(ar, idx, DTAR_offsets[idx]);
-        }
-    }
+        /* register callbacks */
+        CIRCLE_cb_create(&DTAR_enqueue_copy);
+        CIRCLE_cb_process(&DTAR_perform_copy);
 
-    /* prepare libcircle */
-    CIRCLE_init(0, NULL, CIRCLE_SPLIT_EQUAL | CIRCLE_CREATE_GLOBAL | CIRCLE_TERM_TREE);
-    CIRCLE_loglevel loglevel = CIRCLE_LOG_WARN;
-    CIRCLE_enable_logging(loglevel);
+        /* run the libcircle job to copy data into archive file */
+        CIRCLE_begin();
+        CIRCLE_finalize();
+
+        /* wait for all ranks to finish writing */
+        MPI_Barrier(MPI_COMM_WORLD);
 
-    /* register callbacks */
-    CIRCLE_cb_create(&DTAR_enqueue_copy);
-    CIRCLE_cb_process(&DTAR_perform_copy);
+        /* write the end of archive marker of two 512-byte blocks of zeros,
+         * and drop anything left from an earlier file of the same name */
+        if (DTAR_rank == 0) {
+            char zeros[1024];
+            memset(zeros, 0, sizeof(zeros));
+            ssize_t rc = pwrite(DTAR_writer.fd_tar, zeros, sizeof(zeros), (off_t) archive_size);
+            if (rc != (ssize_t) sizeof(zeros) ||
+                ftruncate(DTAR_writer.fd_tar, (off_t) (archive_size + sizeof(zeros))) != 0)
+            {
+                MFU_LOG(MFU_LOG_ERR, "Failed to write end of archive to `%s' (errno=%d %s)",
+                        DTAR_writer.name, errno, strerror(errno));
+            }
+        }
 
-    /* run the libcircle job to copy data into archive file */
-    CIRCLE_begin();
-    CIRCLE_finalize();
+        archive_bytes = archive_size + 1024;
+    }
 
     /* compute total bytes copied */
-    uint64_t archive_size = 0;
-    MPI_Allreduce(&offset, &archive_size, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
-    DTAR_statistics.total_size = archive_size;
+    DTAR_statistics.total_size = archive_bytes;
 
     DTAR_statistics.wtime_ended = MPI_Wtime();
     time(&(DTAR_statistics.time_ended));
@@ -492,9 +1343,6 @@ static void mfu_flist_archive_create_libcircle(mfu_flist flist, const char* arch
         struct tm* localend = localtime(&(DTAR_statistics.time_ended));
         strftime(endtime_str, 256, "%b-%d-%Y, %H:%M:%S", localend);
 
-        /* add two 512 blocks at the end */
-        DTAR_statistics.total_size += 512 * 2;
-
         /* convert bandwidth to unit */
         double agg_rate_tmp;
         double agg_rate = (double) DTAR_statistics.total_size / rel_time;
@@ -504,6 +1352,9 @@ static void mfu_flist_archive_create_libcircle(mfu_flist flist, const char* arch
         MFU_LOG(MFU_LOG_INFO, "Started:    %s", starttime_str);
         MFU_LOG(MFU_LOG_INFO, "Completed:  %s", endtime_str);
         MFU_LOG(MFU_LOG_INFO, "Total archive size: %" PRIu64, DTAR_statistics.total_size);
+        if (DTAR_user_opts.compress) {
+            MFU_LOG(MFU_LOG_INFO, "Uncompressed size: %" PRIu64, archive_size + 1024);
+        }
         MFU_LOG(MFU_LOG_INFO, "Rate: %.3lf %s " \
                 "(%.3" PRIu64 " bytes in %.3lf seconds)", \
                 agg_rate_tmp, agg_rate_units, DTAR_statistics.total_size, rel_time);
@@ -512,10 +1363,27 @@ static void mfu_flist_archive_create_libcircle(mfu_flist flist, const char* arch
     /* clean up */
     mfu_free(&fsizes);
     mfu_free(&DTAR_offsets);
+    mfu_free(&DTAR_hdrlens);
 
     /* close archive file */
-    archive_write_free(ar);
     mfu_close(DTAR_writer.name, DTAR_writer.fd_tar);
+
+    /* the archive can not be read past an entry that was not written */
+    uint64_t all_errors;
+    MPI_Allreduce(&errors, &all_errors, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (all_errors > 0) {
+        if (DTAR_rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to write %" PRIu64 " items, archive `%s' is not valid",
+                    all_errors, archivefile);
+        }
+        DTAR_exit(EXIT_FAILURE);
+    }
+
+    /* the archive is complete, tie the index to it */
+    if (DTAR_rank == 0) {
+        DTAR_index_stamp(archivefile);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
 }
 
 void mfu_flist_archive_create(mfu_flist flist, const char* archivefile, mfu_archive_options_t* opts)
@@ -556,11 +1424,46 @@ static int copy_data(struct archive* ar, struct archive* aw)
     return 0;
 }
 
-void mfu_flist_archive_extract(const char* filename, bool verbose, int flags)
+/* return true if there are no patterns, or if path or one of its
+ * parent directories matches one of the patterns */
+static bool DTAR_match(const char* path, int numpatterns, const char** patterns)
 {
-    int r;
+    if (numpatterns == 0) {
+        return true;
+    }
+
+    /* directories are stored with a trailing slash */
+    char* name = MFU_STRDUP(path);
+    size_t len = strlen(name);
+    while (len > 1 && name[len - 1] == '/') {
+        name[len - 1] = '\0';
+        len--;
+    }
 
-    /* TODO: this needs to be parallelized */
+    bool match = false;
+    int i;
+    for (i = 0; i < numpatterns; i++) {
+        if (fnmatch(patterns[i], name, FNM_LEADING_DIR) == 0) {
+            match = true;
+            break;
+        }
+    }
+
+    mfu_free(&name);
+    return match;
+}
+
+/* extract archive from a single process, used for archives that
+ * must be read in order, like those that are compressed or read
+ * from stdin */
+static void DTAR_extract_serial(
+    const char* filename,
+    int numpatterns,
+    const char** patterns,
+    bool verbose,
+    int flags)
+{
+    int r;
 
     /* initiate archive object for reading */
     struct archive* a = archive_read_new();
@@ -598,6 +1501,11 @@ void mfu_flist_archive_extract(const char* filename, bool verbose, int flags)
             exit(r);
         }
 
+        /* libarchive skips the data of entries we do not read */
+        if (! DTAR_match(archive_entry_pathname(entry), numpatterns, patterns)) {
+            continue;
+        }
+
         if (verbose) {
             msg("x ");
         }
@@ -620,4 +1528,1026 @@ void mfu_flist_archive_extract(const char* filename, bool verbose, int flags)
 
     archive_read_close(a);
     archive_read_free(a);
+
+    archive_write_close(ext);
+    archive_write_free(ext);
+}
+
+/* number of bytes read from the archive file at a time */
+#define DTAR_READ_SIZE (1024 * 1024)
+
+/* reads an archive file with pread starting from a given offset,
+ * so that each rank can parse entries from its own part of the file,
+ * and decompresses bzip2 members of the archive if bzip2 is set */
+typedef struct {
+    const char* name;  /* name of archive file */
+    int fd;            /* file descriptor of archive file */
+    uint64_t offset;   /* file offset of next byte to read */
+    char* buf;         /* buffer to hold data read from file */
+    bool bzip2;        /* whether to decompress data read from file */
+    bz_stream strm;    /* state of bzip2 stream */
+    char* inbuf;       /* buffer to hold compressed data read from file */
+    bool eof;          /* whether all compressed data has been read */
+    uint64_t discard;  /* bytes of decompressed data yet to be dropped */
+} DTAR_reader_t;
+
+/* list of entries held until all ranks have extracted their data */
+typedef struct {
+    uint64_t count;
+    uint64_t capacity;
+    struct archive_entry** entries;
+    int* depths;
+} DTAR_entries_t;
+
+/* decompress data from the archive file into the reader buffer,
+ * continuing into the next member at the end of each one */
+static ssize_t DTAR_reader_read_bzip2(struct archive* a, DTAR_reader_t* reader, const void** buf)
+{
+    while (1) {
+        if (reader->strm.avail_in == 0 && ! reader->eof) {
+            ssize_t nread = pread(reader->fd, reader->inbuf, DTAR_READ_SIZE, (off_t) reader->offset);
+            if (nread < 0) {
+                archive_set_error(a, errno, "Failed to read `%s' at offset %llu",
+                                  reader->name, (unsigned long long) reader->offset);
+                return -1;
+            }
+            reader->offset += (uint64_t) nread;
+            reader->eof = (nread == 0);
+            reader->strm.next_in  = reader->inbuf;
+            reader->strm.avail_in = (unsigned int) nread;
+        }
+
+        reader->strm.next_out  = reader->buf;
+        reader->strm.avail_out = DTAR_READ_SIZE;
+        int rc = BZ2_bzDecompress(&reader->strm);
+        size_t produced = DTAR_READ_SIZE - reader->strm.avail_out;
+
+        if (rc == BZ_STREAM_END) {
+            /* start on the next member */
+            BZ2_bzDecompressEnd(&reader->strm);
+            char* next_in = reader->strm.next_in;
+            unsigned int avail_in = reader->strm.avail_in;
+            memset(&reader->strm, 0, sizeof(reader->strm));
+            BZ2_bzDecompressInit(&reader->strm, 0, 0);
+            reader->strm.next_in  = next_in;
+            reader->strm.avail_in = avail_in;
+        } else if (rc != BZ_OK) {
+            archive_set_error(a, EIO, "Failed to decompress `%s' rc=%d",
+                              reader->name, rc);
+            return -1;
+        }
+
+        if (produced == 0) {
+            if (reader->eof && reader->strm.avail_in == 0) {
+                return 0;
+            }
+            continue;
+        }
+
+        /* drop data that comes before the header we start at */
+        if (reader->discard >= (uint64_t) produced) {
+            reader->discard -= (uint64_t) produced;
+            continue;
+        }
+        *buf = reader->buf + reader->discard;
+        produced -= (size_t) reader->discard;
+        reader->discard = 0;
+        return (ssize_t) produced;
+    }
+}
+
+static ssize_t DTAR_reader_read(struct archive* a, void* data, const void** buf)
+{
+    DTAR_reader_t* reader = (DTAR_reader_t*) data;
+    if (reader->bzip2) {
+        return DTAR_reader_read_bzip2(a, reader, buf);
+    }
+
+    ssize_t nread = pread(reader->fd, reader->buf, DTAR_READ_SIZE, (off_t) reader->offset);
+    if (nread < 0) {
+        archive_set_error(a, errno, "Failed to read `%s' at offset %llu",
+                          reader->name, (unsigned long long) reader->offset);
+        return -1;
+    }
+    reader->offset += (uint64_t) nread;
+    *buf = reader->buf;
+    return nread;
+}
+
+static la_int64_t DTAR_reader_skip(struct archive* a, void* data, la_int64_t request)
+{
+    /* compressed data must be read to be skipped */
+    DTAR_reader_t* reader = (DTAR_reader_t*) data;
+    if (reader->bzip2) {
+        return 0;
+    }
+
+    /* no need to read data that is skipped, just move our offset */
+    reader->offset += (uint64_t) request;
+    return request;
+}
+
+static struct archive* DTAR_reader_open_archive(DTAR_reader_t* reader, uint64_t offset, bool filters)
+{
+    reader->offset = offset;
+
+    struct archive* a = archive_read_new();
+    archive_read_support_format_tar(a);
+
+    /* enable filters so that we can detect compressed archives */
+    if (filters) {
+        archive_read_support_filter_bzip2(a);
+        archive_read_support_filter_gzip(a);
+        archive_read_support_filter_compress(a);
+    }
+
+    int r = archive_read_open2(a, reader, NULL, DTAR_reader_read, DTAR_reader_skip, NULL);
+    if (r != ARCHIVE_OK) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open archive `%s' at offset %llu: %s",
+                reader->name, (unsigned long long) offset, archive_error_string(a));
+        archive_read_free(a);
+        return NULL;
+    }
+
+    return a;
+}
+
+/* open archive for reading starting at given offset, which must be the
+ * start of a header, returns NULL on error */
+static struct archive* DTAR_reader_open(DTAR_reader_t* reader, uint64_t offset, bool filters)
+{
+    reader->bzip2 = false;
+    return DTAR_reader_open_archive(reader, offset, filters);
+}
+
+/* open archive for reading starting at the bzip2 member at offset,
+ * dropping the first discard bytes of decompressed data to get to
+ * the start of a header, returns NULL on error */
+static struct archive* DTAR_reader_open_member(DTAR_reader_t* reader, uint64_t offset, uint64_t discard)
+{
+    memset(&reader->strm, 0, sizeof(reader->strm));
+    int rc = BZ2_bzDecompressInit(&reader->strm, 0, 0);
+    if (rc != BZ_OK) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to initialize decompression rc=%d", rc);
+        return NULL;
+    }
+    reader->inbuf   = (char*) MFU_MALLOC(DTAR_READ_SIZE);
+    reader->eof     = false;
+    reader->discard = discard;
+    reader->bzip2   = true;
+
+    struct archive* a = DTAR_reader_open_archive(reader, offset, false);
+    if (a == NULL) {
+        BZ2_bzDecompressEnd(&reader->strm);
+        mfu_free(&reader->inbuf);
+        reader->bzip2 = false;
+    }
+    return a;
+}
+
+/* free archive opened with DTAR_reader_open or DTAR_reader_open_member */
+static void DTAR_reader_close(DTAR_reader_t* reader, struct archive* a)
+{
+    archive_read_free(a);
+    if (reader->bzip2) {
+        BZ2_bzDecompressEnd(&reader->strm);
+        mfu_free(&reader->inbuf);
+        reader->bzip2 = false;
+    }
+}
+
+/* hold on to a copy of entry at the given directory depth */
+static void DTAR_entries_add(DTAR_entries_t* list, struct archive_entry* entry, int depth)
+{
+    if (list->count == list->capacity) {
+        list->capacity = (list->capacity == 0) ? 1024 : list->capacity * 2;
+        list->entries = (struct archive_entry**) realloc(list->entries,
+            list->capacity * sizeof(struct archive_entry*));
+        list->depths = (int*) realloc(list->depths, list->capacity * sizeof(int));
+        if (list->entries == NULL || list->depths == NULL) {
+            MFU_ABORT(1, "Failed to allocate memory for archive entries");
+        }
+    }
+
+    list->entries[list->count] = archive_entry_clone(entry);
+    list->depths[list->count]  = depth;
+    list->count++;
+}
+
+static void DTAR_entries_free(DTAR_entries_t* list)
+{
+    uint64_t i;
+    for (i = 0; i < list->count; i++) {
+        archive_entry_free(list->entries[i]);
+    }
+    mfu_free(&list->entries);
+    mfu_free(&list->depths);
+    list->count    = 0;
+    list->capacity = 0;
+}
+
+/* names of directories to create before extracting any files */
+typedef struct {
+    uint64_t count;
+    uint64_t capacity;
+    char** names;
+    char* last;  /* parent directory of previous entry */
+} DTAR_dirnames_t;
+
+/* add name to list, which takes ownership of it */
+static void DTAR_dirnames_add(DTAR_dirnames_t* list, char* name)
+{
+    if (list->count == list->capacity) {
+        list->capacity = (list->capacity == 0) ? 1024 : list->capacity * 2;
+        list->names = (char**) realloc(list->names, list->capacity * sizeof(char*));
+        if (list->names == NULL) {
+            MFU_ABORT(1, "Failed to allocate memory for directory names");
+        }
+    }
+    list->names[list->count] = name;
+    list->count++;
+}
+
+/* add path if it is a directory, along with any of its
+ * parent directories that do not exist yet */
+static void DTAR_dirnames_add_entry(DTAR_dirnames_t* list, const char* path, bool isdir)
+{
+    char* name = mfu_path_strdup_abs_reduce_str(path);
+    if (isdir) {
+        DTAR_dirnames_add(list, MFU_STRDUP(name));
+    }
+
+    /* entries in the same directory are usually stored together,
+     * so we only look for missing parents when the parent changes */
+    mfu_path* dir = mfu_path_from_str(name);
+    mfu_path_dirname(dir);
+    char* parent = mfu_path_strdup(dir);
+    if (list->last == NULL || strcmp(parent, list->last) != 0) {
+        mfu_free(&list->last);
+        list->last = parent;
+        while (mfu_path_components(dir) > 0) {
+            char* str = mfu_path_strdup(dir);
+            struct stat st;
+            if (mfu_lstat(str, &st) == 0) {
+                mfu_free(&str);
+                break;
+            }
+            DTAR_dirnames_add(list, str);
+            mfu_path_dirname(dir);
+        }
+    } else {
+        mfu_free(&parent);
+    }
+    mfu_path_delete(&dir);
+
+    mfu_free(&name);
+}
+
+static int DTAR_dirnames_compare(const void* a, const void* b)
+{
+    return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+/* add each distinct name to flist and free the list, directories are
+ * created with default permissions, and those in the archive get their
+ * own permissions at the end */
+static void DTAR_dirnames_to_flist(DTAR_dirnames_t* list, mfu_flist flist)
+{
+    qsort(list->names, (size_t) list->count, sizeof(char*), DTAR_dirnames_compare);
+
+    uint64_t i;
+    for (i = 0; i < list->count; i++) {
+        if (i == 0 || strcmp(list->names[i], list->names[i - 1]) != 0) {
+            uint64_t idx = mfu_flist_file_create(flist);
+            mfu_flist_file_set_name(flist, idx, list->names[i]);
+            mfu_flist_file_set_type(flist, idx, MFU_TYPE_DIR);
+            mfu_flist_file_set_detail(flist, idx, 1);
+            mfu_flist_file_set_mode(flist, idx, S_IFDIR | S_IRWXU | S_IRWXG | S_IRWXO);
+        }
+    }
+
+    for (i = 0; i < list->count; i++) {
+        mfu_free(&list->names[i]);
+    }
+    mfu_free(&list->names);
+    mfu_free(&list->last);
+    list->count    = 0;
+    list->capacity = 0;
+}
+
+/* return number of components in path of entry */
+static int DTAR_entry_depth(struct archive_entry* entry)
+{
+    mfu_path* path = mfu_path_from_str(archive_entry_pathname(entry));
+    mfu_path_reduce(path);
+    int depth = mfu_path_components(path);
+    mfu_path_delete(&path);
+    return depth;
+}
+
+/* scan headers of the archive, seeking over file data, and call fn for
+ * each entry, returns 0 on success, 1 if the archive is compressed and
+ * offsets are needed, and -1 on error */
+static int DTAR_index_scan(DTAR_reader_t* reader, bool need_offsets, DTAR_index_fn fn, void* arg)
+{
+    int rc = 0;
+
+    struct archive* a = DTAR_reader_open(reader, 0, true);
+    if (a == NULL) {
+        return -1;
+    }
+
+    /* entries of a compressed archive do not have fixed offsets */
+    if (need_offsets && archive_filter_code(a, 0) != ARCHIVE_FILTER_NONE) {
+        DTAR_reader_close(reader, a);
+        return 1;
+    }
+
+    DTAR_index_entry_t e;
+    e.data_offset = 0;
+    e.filter = archive_filter_code(a, 0);
+
+    struct archive_entry* entry;
+    while (1) {
+        /* after reading a header, libarchive reports the offset where
+         * it started, which is that of the end marker after the last one */
+        int r = archive_read_next_header(a, &entry);
+        e.offset = (uint64_t) archive_read_header_position(a);
+        e.member = e.offset;
+        e.member_start = e.offset;
+        if (r == ARCHIVE_EOF) {
+            e.path = NULL;
+            fn(&e, arg);
+            break;
+        }
+        if (r != ARCHIVE_OK && r != ARCHIVE_WARN) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to read header at offset %llu in `%s': %s",
+                    (unsigned long long) e.offset, reader->name, archive_error_string(a));
+            rc = -1;
+            break;
+        }
+
+        e.path  = archive_entry_pathname(entry);
+        e.size  = (uint64_t) archive_entry_size(entry);
+        e.mode  = (uint64_t) archive_entry_mode(entry);
+        e.mtime = (uint64_t) archive_entry_mtime(entry);
+        fn(&e, arg);
+    }
+
+    DTAR_reader_close(reader, a);
+
+    return rc;
+}
+
+/* read index of archive and call fn for each entry, returns 0 on
+ * success and -1 if there is no index that matches the archive */
+static int DTAR_index_read(const char* archivefile, DTAR_index_fn fn, void* arg)
+{
+    int rc = 0;
+
+    char* name = DTAR_index_name(archivefile);
+
+    /* skip index if there is none, or if it was written for
+     * another archive file or before the archive was modified */
+    struct stat archive_st, index_st;
+    if (stat(archivefile, &archive_st) != 0 || stat(name, &index_st) != 0) {
+        mfu_free(&name);
+        return -1;
+    }
+
+    MPI_File fh;
+    int mpirc = MPI_File_open(MPI_COMM_SELF, name, MPI_MODE_RDONLY, MPI_INFO_NULL, &fh);
+    if (mpirc != MPI_SUCCESS) {
+        MFU_LOG(MFU_LOG_WARN, "Failed to open index `%s', scanning archive", name);
+        mfu_free(&name);
+        return -1;
+    }
+
+    MPI_Status status;
+    uint64_t header[DTAR_INDEX_HEADER_VALUES];
+    mpirc = MPI_File_read_at(fh, 0, header, (int) sizeof(header), MPI_BYTE, &status);
+
+    uint64_t version, count, chars, end, archive_bytes, filter, member_bytes;
+    uint64_t mtime, mtime_nsec, ino;
+    const char* ptr = (const char*) header;
+    mfu_unpack_uint64(&ptr, &version);
+    mfu_unpack_uint64(&ptr, &count);
+    mfu_unpack_uint64(&ptr, &chars);
+    mfu_unpack_uint64(&ptr, &end);
+    mfu_unpack_uint64(&ptr, &archive_bytes);
+    mfu_unpack_uint64(&ptr, &filter);
+    mfu_unpack_uint64(&ptr, &member_bytes);
+    mfu_unpack_uint64(&ptr, &mtime);
+    mfu_unpack_uint64(&ptr, &mtime_nsec);
+    mfu_unpack_uint64(&ptr, &ino);
+
+    uint64_t archive_mtime, archive_mtime_nsec;
+    mfu_stat_get_mtimes(&archive_st, &archive_mtime, &archive_mtime_nsec);
+
+    size_t elem_size = DTAR_INDEX_RECORD_VALUES * 8 + (size_t) chars;
+    uint64_t index_bytes = DTAR_INDEX_HEADER_VALUES * 8 + count * (uint64_t) elem_size;
+    if (mpirc != MPI_SUCCESS || version != DTAR_INDEX_VERSION ||
+        archive_bytes != (uint64_t) archive_st.st_size ||
+        mtime != archive_mtime || mtime_nsec != archive_mtime_nsec ||
+        ino != (uint64_t) archive_st.st_ino ||
+        index_bytes != (uint64_t) index_st.st_size)
+    {
+        MFU_LOG(MFU_LOG_WARN, "Index `%s' does not match archive, scanning archive", name);
+        MPI_File_close(&fh);
+        mfu_free(&name);
+        return -1;
+    }
+
+    /* read records in pieces */
+    size_t bufsize = 1024 * 1024;
+    if (bufsize < elem_size) {
+        bufsize = elem_size;
+    }
+    char* buf = (char*) MFU_MALLOC(bufsize);
+    uint64_t bufcount = (uint64_t) (bufsize / elem_size);
+
+    DTAR_index_entry_t e;
+    e.filter = (int) filter;
+    MPI_Offset read_offset = (MPI_Offset) (DTAR_INDEX_HEADER_VALUES * 8);
+    uint64_t done = 0;
+    while (done < count) {
+        uint64_t n = count - done;
+        if (n > bufcount) {
+            n = bufcount;
+        }
+
+        int read_count = (int) (n * elem_size);
+        mpirc = MPI_File_read_at(fh, read_offset, buf, read_count, MPI_BYTE, &status);
+        if (mpirc != MPI_SUCCESS) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to read index `%s'", name);
+            rc = -1;
+            break;
+        }
+        read_offset += (MPI_Offset) read_count;
+
+        uint64_t i;
+        ptr = buf;
+        for (i = 0; i < n; i++) {
+            mfu_unpack_uint64(&ptr, &e.offset);
+            mfu_unpack_uint64(&ptr, &e.data_offset);
+            mfu_unpack_uint64(&ptr, &e.size);
+            mfu_unpack_uint64(&ptr, &e.mode);
+            mfu_unpack_uint64(&ptr, &e.mtime);
+            mfu_unpack_uint64(&ptr, &e.member);
+            e.member_start = e.offset;
+            if (member_bytes > 0) {
+                e.member_start = e.offset / member_bytes * member_bytes;
+            }
+            e.path = ptr;
+            ptr += chars;
+            fn(&e, arg);
+        }
+
+        done += n;
+    }
+
+    if (rc == 0) {
+        e.path   = NULL;
+        e.offset = end;
+        e.member = archive_bytes;
+        e.member_start = end;
+        fn(&e, arg);
+    }
+
+    mfu_free(&buf);
+    MPI_File_close(&fh);
+    mfu_free(&name);
+
+    return rc;
+}
+
+/* largest number of values sent in one message when handing out
+ * entries to extract, counts of MPI calls are ints */
+#define DTAR_MSG_VALUES (64 * 1024 * 1024)
+
+/* send count values from buf to rank dest in messages of at most
+ * DTAR_MSG_VALUES values */
+static void DTAR_send(const uint64_t* buf, uint64_t count, int dest)
+{
+    while (count > 0) {
+        int n = (count > DTAR_MSG_VALUES) ? DTAR_MSG_VALUES : (int) count;
+        MPI_Send((void*) buf, n, MPI_UINT64_T, dest, 0, MPI_COMM_WORLD);
+        buf   += n;
+        count -= (uint64_t) n;
+    }
+}
+
+/* receive count values into buf from rank src as sent by DTAR_send */
+static void DTAR_recv(uint64_t* buf, uint64_t count, int src)
+{
+    while (count > 0) {
+        int n = (count > DTAR_MSG_VALUES) ? DTAR_MSG_VALUES : (int) count;
+        MPI_Recv(buf, n, MPI_UINT64_T, src, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        buf   += n;
+        count -= (uint64_t) n;
+    }
+}
+
+/* entries chosen for extraction, in the order they appear in the archive */
+typedef struct {
+    int numpatterns;
+    const char** patterns;
+    uint64_t count;
+    uint64_t capacity;
+    uint64_t* offsets;      /* offset of header of each entry */
+    uint64_t* spans;        /* bytes from header to the next entry */
+    uint64_t* members;      /* file offset of member that holds each entry */
+    uint64_t* discards;     /* bytes of its member before each entry */
+    int filter;             /* compression filter of archive */
+    bool last_selected;     /* whether previous entry was chosen */
+    uint64_t last_offset;   /* offset of header of previous entry */
+    DTAR_dirnames_t dirnames;
+} DTAR_selection_t;
+
+/* add entry to selection if it matches a pattern */
+static void DTAR_select_entry(const DTAR_index_entry_t* e, void* arg)
+{
+    DTAR_selection_t* sel = (DTAR_selection_t*) arg;
+
+    /* the start of this entry is the end of the previous one */
+    if (sel->last_selected) {
+        sel->spans[sel->count - 1] = e->offset - sel->last_offset;
+    }
+    sel->last_selected = false;
+    sel->last_offset   = e->offset;
+    sel->filter        = e->filter;
+
+    if (e->path == NULL || ! DTAR_match(e->path, sel->numpatterns, sel->patterns)) {
+        return;
+    }
+
+    if (sel->count == sel->capacity) {
+        sel->capacity = (sel->capacity == 0) ? 1024 : sel->capacity * 2;
+        sel->offsets = (uint64_t*) realloc(sel->offsets, sel->capacity * sizeof(uint64_t));
+        sel->spans   = (uint64_t*) realloc(sel->spans,   sel->capacity * sizeof(uint64_t));
+        sel->members = (uint64_t*) realloc(sel->members, sel->capacity * sizeof(uint64_t));
+        sel->discards = (uint64_t*) realloc(sel->discards, sel->capacity * sizeof(uint64_t));
+        if (sel->offsets == NULL || sel->spans == NULL ||
+            sel->members == NULL || sel->discards == NULL)
+        {
+            MFU_ABORT(1, "Failed to allocate memory for archive index");
+        }
+    }
+    sel->offsets[sel->count] = e->offset;
+    sel->spans[sel->count]   = 0;
+    sel->members[sel->count] = e->member;
+    sel->discards[sel->count] = e->offset - e->member_start;
+    sel->count++;
+    sel->last_selected = true;
+
+    /* record directories, which are created before any file data is written */
+    DTAR_dirnames_add_entry(&sel->dirnames, e->path, S_ISDIR((mode_t) e->mode));
+}
+
+/* split selected entries into contiguous ranges with about the same
+ * number of archive bytes for each rank, writes number of entries for
+ * each rank to counts */
+static void DTAR_selection_split(const DTAR_selection_t* sel, int ranks, uint64_t* counts)
+{
+    uint64_t total = 0;
+    uint64_t i;
+    for (i = 0; i < sel->count; i++) {
+        total += sel->spans[i];
+    }
+
+    uint64_t pos = 0;
+    i = 0;
+    int r;
+    for (r = 0; r < ranks; r++) {
+        /* rank r gets all entries that start before limit */
+        uint64_t limit = total / (uint64_t) ranks * (uint64_t) (r + 1);
+        if (r == ranks - 1) {
+            limit = total + 1;
+        }
+
+        uint64_t first = i;
+        while (i < sel->count && pos < limit) {
+            pos += sel->spans[i];
+            i++;
+        }
+        counts[r] = i - first;
+    }
+}
+
+/* extract count entries starting with the header at offset, or if the
+ * archive is compressed, with the header that is discard bytes into the
+ * member at offset, directories and hard links are added to dirs and
+ * links to be applied once all ranks are done, returns number of errors */
+static uint64_t DTAR_extract_range(
+    DTAR_reader_t* reader,
+    uint64_t offset,
+    uint64_t discard,
+    bool compressed,
+    uint64_t count,
+    bool verbose,
+    int flags,
+    DTAR_entries_t* dirs,
+    DTAR_entries_t* links,
+    uint64_t* bytes)
+{
+    uint64_t errors = 0;
+
+    if (count == 0) {
+        return errors;
+    }
+
+    struct archive* a;
+    if (compressed) {
+        a = DTAR_reader_open_member(reader, offset, discard);
+    } else {
+        a = DTAR_reader_open(reader, offset, false);
+    }
+    if (a == NULL) {
+        return count;
+    }
+
+    struct archive* ext = archive_write_disk_new();
+    archive_write_disk_set_options(ext, flags);
+    archive_write_disk_set_standard_lookup(ext);
+
+    uint64_t i;
+    for (i = 0; i < count; i++) {
+        struct archive_entry* entry;
+        int r = archive_read_next_header(a, &entry);
+        if (r != ARCHIVE_OK && r != ARCHIVE_WARN) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to read header in `%s': %s",
+                    reader->name, archive_error_string(a));
+            errors += count - i;
+            break;
+        }
+
+        if (verbose) {
+            printf("x %s\n", archive_entry_pathname(entry));
+        }
+
+        /* directories already exist, and links may refer to files
+         * that other ranks have yet to write */
+        if (archive_entry_filetype(entry) == AE_IFDIR) {
+            DTAR_entries_add(dirs, entry, DTAR_entry_depth(entry));
+            continue;
+        }
+        if (archive_entry_hardlink(entry) != NULL) {
+            DTAR_entries_add(links, entry, 0);
+            continue;
+        }
+
+        r = archive_write_header(ext, entry);
+        if (r != ARCHIVE_OK) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to create `%s': %s",
+                    archive_entry_pathname(entry), archive_error_string(ext));
+            errors++;
+            continue;
+        }
+
+        if (copy_data(a, ext) != ARCHIVE_OK) {
+            errors++;
+        }
+        if (archive_write_finish_entry(ext) != ARCHIVE_OK) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to finish `%s': %s",
+                    archive_entry_pathname(entry), archive_error_string(ext));
+            errors++;
+        }
+
+        *bytes += (uint64_t) archive_entry_size(entry);
+    }
+
+    archive_write_close(ext);
+    archive_write_free(ext);
+
+    DTAR_reader_close(reader, a);
+
+    return errors;
+}
+
+/* write headers of held entries, only those at the given depth if
+ * depth is not negative, returns number of errors */
+static uint64_t DTAR_entries_apply(DTAR_entries_t* list, int depth, int flags)
+{
+    uint64_t errors = 0;
+
+    struct archive* ext = archive_write_disk_new();
+    archive_write_disk_set_options(ext, flags);
+    archive_write_disk_set_standard_lookup(ext);
+
+    uint64_t i;
+    for (i = 0; i < list->count; i++) {
+        if (depth >= 0 && list->depths[i] != depth) {
+            continue;
+        }
+
+        struct archive_entry* entry = list->entries[i];
+        int r = archive_write_header(ext, entry);
+        if (r == ARCHIVE_OK) {
+            r = archive_write_finish_entry(ext);
+        }
+        if (r != ARCHIVE_OK) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to extract `%s': %s",
+                    archive_entry_pathname(entry), archive_error_string(ext));
+            errors++;
+        }
+    }
+
+    /* directory permissions and timestamps are set on close */
+    if (archive_write_close(ext) != ARCHIVE_OK) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to set directory metadata: %s",
+                archive_error_string(ext));
+        errors++;
+    }
+    archive_write_free(ext);
+
+    return errors;
+}
+
+/* drop entries and directories added to selection, keeping its patterns */
+static void DTAR_selection_reset(DTAR_selection_t* sel)
+{
+    mfu_free(&sel->offsets);
+    mfu_free(&sel->spans);
+    mfu_free(&sel->members);
+    mfu_free(&sel->discards);
+
+    uint64_t i;
+    for (i = 0; i < sel->dirnames.count; i++) {
+        mfu_free(&sel->dirnames.names[i]);
+    }
+    mfu_free(&sel->dirnames.names);
+    mfu_free(&sel->dirnames.last);
+
+    int numpatterns = sel->numpatterns;
+    const char** patterns = sel->patterns;
+    memset(sel, 0, sizeof(*sel));
+    sel->numpatterns = numpatterns;
+    sel->patterns    = patterns;
+}
+
+/* find entries to extract from the index of the archive, or by scanning
+ * its headers if it has no index, must be called on rank 0, returns
+ * 0 on success, 1 if the archive is compressed, and -1 on error */
+static int DTAR_select(const char* filename, DTAR_reader_t* reader, DTAR_selection_t* sel)
+{
+    if (DTAR_index_read(filename, DTAR_select_entry, sel) == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Read index `%s%s'", filename, DTAR_INDEX_SUFFIX);
+        return 0;
+    }
+
+    /* the index may have failed part way through */
+    DTAR_selection_reset(sel);
+    return DTAR_index_scan(reader, true, DTAR_select_entry, sel);
+}
+
+void mfu_flist_archive_extract(
+    const char* filename,
+    int numpatterns,
+    const char** patterns,
+    bool verbose,
+    int flags)
+{
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* an archive read from stdin can only be read in order */
+    if (filename == NULL || strcmp(filename, "-") == 0) {
+        if (rank == 0) {
+            DTAR_extract_serial(filename, numpatterns, patterns, verbose, flags);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        return;
+    }
+
+    double wtime_started = MPI_Wtime();
+
+    /* open the archive file on all ranks */
+    DTAR_reader_t reader;
+    reader.name   = filename;
+    reader.fd     = mfu_open(filename, O_RDONLY);
+    reader.offset = 0;
+    reader.buf    = (char*) MFU_MALLOC(DTAR_READ_SIZE);
+
+    int open_ok = (reader.fd >= 0);
+    int all_ok;
+    MPI_Allreduce(&open_ok, &all_ok, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+    if (! all_ok) {
+        if (! open_ok) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to open archive `%s' (errno=%d %s)",
+                    filename, errno, strerror(errno));
+        }
+        DTAR_exit(EXIT_FAILURE);
+    }
+
+    /* rank 0 finds where each entry to be extracted starts,
+     * and it records directories so they can be created first */
+    DTAR_selection_t sel;
+    memset(&sel, 0, sizeof(sel));
+    sel.numpatterns = numpatterns;
+    sel.patterns    = patterns;
+
+    mfu_flist dirlist = mfu_flist_new();
+    mfu_flist_set_detail(dirlist, 1);
+    int status[2] = {0, ARCHIVE_FILTER_NONE};
+    if (rank == 0) {
+        status[0] = DTAR_select(filename, &reader, &sel);
+        status[1] = sel.filter;
+        DTAR_dirnames_to_flist(&sel.dirnames, dirlist);
+    }
+    MPI_Bcast(status, 2, MPI_INT, 0, MPI_COMM_WORLD);
+    bool compressed = (status[1] != ARCHIVE_FILTER_NONE);
+
+    if (status[0] < 0) {
+        DTAR_exit(EXIT_FAILURE);
+    }
+
+    /* a compressed archive without an index must be read in order */
+    if (status[0] == 1) {
+        mfu_close(filename, reader.fd);
+        mfu_free(&reader.buf);
+        mfu_flist_free(&dirlist);
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_INFO, "Archive is compressed, extracting with one process");
+            DTAR_extract_serial(filename, numpatterns, patterns, verbose, flags);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        return;
+    }
+
+    /* give each rank a contiguous range of entries, with the offset,
+     * span, member, and bytes in its member before each entry */
+    uint64_t* counts = NULL;
+    if (rank == 0) {
+        counts = (uint64_t*) MFU_MALLOC((size_t) ranks * sizeof(uint64_t));
+        DTAR_selection_split(&sel, ranks, counts);
+    }
+
+    uint64_t entries;
+    MPI_Scatter(counts, 1, MPI_UINT64_T, &entries, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    uint64_t* myinfo = (uint64_t*) MFU_MALLOC(entries * 4 * sizeof(uint64_t) + 1);
+
+    if (rank == 0) {
+        /* pack the entries of each rank in turn, and send them in
+         * pieces, since the selection may not fit in an int count */
+        uint64_t first = 0;
+        int r;
+        for (r = 0; r < ranks; r++) {
+            uint64_t* info = myinfo;
+            if (r != 0) {
+                info = (uint64_t*) MFU_MALLOC(counts[r] * 4 * sizeof(uint64_t) + 1);
+            }
+
+            uint64_t i;
+            for (i = 0; i < counts[r]; i++) {
+                info[i * 4 + 0] = sel.offsets[first + i];
+                info[i * 4 + 1] = sel.spans[first + i];
+                info[i * 4 + 2] = sel.members[first + i];
+                info[i * 4 + 3] = sel.discards[first + i];
+            }
+            first += counts[r];
+
+            if (r != 0) {
+                DTAR_send(info, counts[r] * 4, r);
+                mfu_free(&info);
+            }
+        }
+    } else {
+        DTAR_recv(myinfo, entries * 4, 0);
+    }
+
+    mfu_free(&counts);
+    mfu_free(&sel.offsets);
+    mfu_free(&sel.spans);
+    mfu_free(&sel.members);
+    mfu_free(&sel.discards);
+
+    /* create all directories before writing any files */
+    mfu_flist_summarize(dirlist);
+    mfu_flist spread = mfu_flist_spread(dirlist);
+    mfu_flist_mkdir(spread);
+    mfu_flist_free(&spread);
+    mfu_flist_free(&dirlist);
+
+    /* extract our entries, reading each run of entries that are next
+     * to each other in one pass, which for a compressed archive starts
+     * at the member that holds the first entry of the run */
+    DTAR_entries_t dirs  = {0, 0, NULL, NULL};
+    DTAR_entries_t links = {0, 0, NULL, NULL};
+    uint64_t bytes  = 0;
+    uint64_t errors = 0;
+    uint64_t i = 0;
+    while (i < entries) {
+        uint64_t first = i;
+        i++;
+        while (i < entries && myinfo[i * 4] == myinfo[(i - 1) * 4] + myinfo[(i - 1) * 4 + 1]) {
+            i++;
+        }
+        errors += DTAR_extract_range(&reader, myinfo[first * 4 + 2], myinfo[first * 4 + 3],
+                                     compressed, i - first, verbose, flags, &dirs, &links, &bytes);
+    }
+    mfu_free(&myinfo);
+
+    /* create hard links once all files have been written */
+    MPI_Barrier(MPI_COMM_WORLD);
+    errors += DTAR_entries_apply(&links, -1, flags);
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    /* set directory metadata last, from the deepest directories
+     * to the shallowest, so that setting permissions on a parent
+     * does not block access to its children */
+    int maxdepth = -1;
+    for (i = 0; i < dirs.count; i++) {
+        if (dirs.depths[i] > maxdepth) {
+            maxdepth = dirs.depths[i];
+        }
+    }
+    int depth;
+    MPI_Allreduce(MPI_IN_PLACE, &maxdepth, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    for (depth = maxdepth; depth >= 0; depth--) {
+        errors += DTAR_entries_apply(&dirs, depth, flags);
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+
+    DTAR_entries_free(&dirs);
+    DTAR_entries_free(&links);
+
+    mfu_close(filename, reader.fd);
+    mfu_free(&reader.buf);
+
+    /* report totals */
+    uint64_t values[3] = {entries, bytes, errors};
+    uint64_t totals[3];
+    MPI_Allreduce(values, totals, 3, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+    double rel_time = MPI_Wtime() - wtime_started;
+    if (rank == 0) {
+        double agg_rate_tmp;
+        double agg_rate = (rel_time > 0.0) ? (double) totals[1] / rel_time : 0.0;
+        const char* agg_rate_units;
+        mfu_format_bytes(agg_rate, &agg_rate_tmp, &agg_rate_units);
+
+        MFU_LOG(MFU_LOG_INFO, "Extracted %" PRIu64 " items, %" PRIu64 " bytes in %.3lf seconds (%.3lf %s/s)",
+                totals[0], totals[1], rel_time, agg_rate_tmp, agg_rate_units);
+        if (totals[2] > 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to extract %" PRIu64 " items", totals[2]);
+        }
+    }
+}
+
+/* print path of entry, and its mode, size, and time if verbose */
+static void DTAR_print_entry(const DTAR_index_entry_t* e, void* arg)
+{
+    if (e->path == NULL) {
+        return;
+    }
+
+    bool verbose = *(bool*) arg;
+    if (verbose) {
+        char modestr[11];
+        mfu_format_mode((mode_t) e->mode, modestr);
+
+        char timestr[64];
+        time_t mtime = (time_t) e->mtime;
+        struct tm* tm = localtime(&mtime);
+        strftime(timestr, sizeof(timestr), "%Y-%m-%d %H:%M", tm);
+
+        printf("%s %12" PRIu64 " %s %s\n", modestr, e->size, timestr, e->path);
+    } else {
+        printf("%s\n", e->path);
+    }
+}
+
+void mfu_flist_archive_list(const char* filename, bool verbose)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    /* print entries from the index if there is one, otherwise
+     * scan the headers of the archive */
+    int status = 0;
+    if (rank == 0) {
+        if (DTAR_index_read(filename, DTAR_print_entry, &verbose) != 0) {
+            DTAR_reader_t reader;
+            reader.name   = filename;
+            reader.fd     = mfu_open(filename, O_RDONLY);
+            reader.offset = 0;
+            reader.buf    = (char*) MFU_MALLOC(DTAR_READ_SIZE);
+            if (reader.fd < 0) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to open archive `%s' (errno=%d %s)",
+                        filename, errno, strerror(errno));
+                status = -1;
+            } else {
+                status = DTAR_index_scan(&reader, false, DTAR_print_entry, &verbose);
+                mfu_close(filename, reader.fd);
+            }
+            mfu_free(&reader.buf);
+        }
+        fflush(stdout);
+    }
+    MPI_Bcast(&status, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    if (status != 0) {
+        DTAR_exit(EXIT_FAILURE);
+    }
 }
@@ -1,13 +1,31 @@
 typedef struct {
     size_t  chunk_size;
-    size_t  block_size;
+    size_t  block_size;   /* bzip2 block size of compressed archive (1-9) */
+    size_t  member_size;  /* bytes of archive data in each compressed member */
     char*   dest_path;
     bool    preserve;
+    bool    compress;     /* write archive as a sequence of bzip2 members */
     int     flags;
 } mfu_archive_options_t;
 
 void mfu_param_path_check_archive(int numparams, mfu_param_path* srcparams, mfu_param_path destparam, int* valid);
 
+/* write the items of flist to an archive, if opts->compress is set, the
+ * archive is compressed with bzip2 as a sequence of members that each
+ * rank compresses in parallel */
 void mfu_flist_archive_create(mfu_flist flist, const char* archivefile, mfu_archive_options_t* opts);
 
-void mfu_flist_archive_extract(const char* filename, bool verbose, int flags);
+/* extract the archive into the current directory, if patterns are given,
+ * only the entries that match one of them, or whose parent directory
+ * does, are extracted */
+void mfu_flist_archive_extract(
+    const char* filename,
+    int numpatterns,
+    const char** patterns,
+    bool verbose,
+    int flags
+);
+
+/* print the path of each entry in the archive, using its index if it
+ * has one, and also the mode, size, and time of each entry if verbose */
+void mfu_flist_archive_list(const char* filename, bool verbose);
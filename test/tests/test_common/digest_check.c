@@ -0,0 +1,374 @@
+/*
+ * Checks of the digests in mfu_digest.h.
+ *
+ * Compares murmur3 against published MurmurHash3_x64_128 values with a
+ * seed of 0, checks that every code path of the fast digest available on
+ * this processor gives the same value as the generic one, and checks
+ * that neither digest depends on how the input is split across calls to
+ * mfu_digest_update.  The murmur3 values assume a little-endian host.
+ *
+ * Since the fast digest is not an established hash, both digests are also
+ * checked for avalanche, where flipping any input bit should flip each
+ * output bit about half the time, and for collisions and even spread over
+ * large sets of inputs that differ in few bits, which is what file data
+ * that was slightly changed looks like.
+ *
+ * Usage: digest_check
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "mfu.h"
+
+/* number of bytes of test data, enough to cover many scrambles
+ * of the fast digest plus a partial block at the end */
+#define DATA_SIZE (64 * 1024 + 77)
+
+/* murmur3 reference values */
+typedef struct {
+    const char* str;  /* input, or NULL for bytes 0..255 repeated four times */
+    uint64_t h1;
+    uint64_t h2;
+} murmur_vector;
+
+static const murmur_vector murmur_vectors[] = {
+    {"", 0x0000000000000000ULL, 0x0000000000000000ULL},
+    {"a", 0x85555565f6597889ULL, 0xe6b53a48510e895aULL},
+    {"hello", 0xcbd8a7b341bd9b02ULL, 0x5b1e906a48ae1d19ULL},
+    {"The quick brown fox jumps over the lazy dog", 0xe34bbc7bbc071b6cULL, 0x7a433ca9c49a9347ULL},
+    {NULL, 0x69d9dcce316c4c29ULL, 0xed876c1605cc45c6ULL},
+};
+
+/* returns number of vectors that do not match */
+static int check_murmur(void)
+{
+    unsigned char bytes[1024];
+    size_t i;
+    for (i = 0; i < sizeof(bytes); i++) {
+        bytes[i] = (unsigned char) i;
+    }
+
+    int errors = 0;
+    for (i = 0; i < sizeof(murmur_vectors) / sizeof(murmur_vectors[0]); i++) {
+        const murmur_vector* v = &murmur_vectors[i];
+        const void* buf = bytes;
+        size_t len = sizeof(bytes);
+        if (v->str != NULL) {
+            buf = v->str;
+            len = strlen(v->str);
+        }
+
+        mfu_digest_value value;
+        mfu_digest_buf(MFU_DIGEST_MURMUR3, buf, len, &value);
+        if (value.h[0] != v->h1 || value.h[1] != v->h2) {
+            printf("murmur3 of %llu bytes gave %016llx%016llx, expected %016llx%016llx\n",
+                   (unsigned long long) len,
+                   (unsigned long long) value.h[0], (unsigned long long) value.h[1],
+                   (unsigned long long) v->h1, (unsigned long long) v->h2);
+            errors++;
+        }
+    }
+    return errors;
+}
+
+/* compute digest of len bytes of data, passing step bytes per update,
+ * or a varying number of bytes if step is 0 */
+static void digest_split(mfu_digest_alg alg, const unsigned char* data, size_t len,
+                         size_t step, mfu_digest_value* value)
+{
+    mfu_digest_ctx ctx;
+    mfu_digest_init(&ctx, alg);
+
+    size_t i = 0;
+    size_t next = 1;
+    while (i < len) {
+        size_t n = step;
+        if (n == 0) {
+            /* walk through sizes that straddle block boundaries */
+            n = next;
+            next = (next * 7 + 3) % 200 + 1;
+        }
+        if (n > len - i) {
+            n = len - i;
+        }
+        mfu_digest_update(&ctx, data + i, n);
+        i += n;
+    }
+
+    mfu_digest_final(&ctx, value);
+}
+
+/* returns number of splits that give a different digest than a
+ * single update, for every prefix length in lens */
+static int check_splits(mfu_digest_alg alg, const char* impl, const unsigned char* data)
+{
+    static const size_t lens[] = {0, 1, 15, 16, 17, 63, 64, 65, 1023, 1024, 1025, DATA_SIZE};
+    static const size_t steps[] = {1, 3, 16, 64, 100, 4096, 0};
+
+    int errors = 0;
+    size_t i, j;
+    for (i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+        mfu_digest_value whole;
+        mfu_digest_buf(alg, data, lens[i], &whole);
+
+        for (j = 0; j < sizeof(steps) / sizeof(steps[0]); j++) {
+            mfu_digest_value split;
+            digest_split(alg, data, lens[i], steps[j], &split);
+            if (split.h[0] != whole.h[0] || split.h[1] != whole.h[1]) {
+                printf("%s (%s) of %llu bytes changed with updates of %llu bytes\n",
+                       mfu_digest_alg_name(alg), impl,
+                       (unsigned long long) lens[i], (unsigned long long) steps[j]);
+                errors++;
+            }
+        }
+    }
+    return errors;
+}
+
+/* flip each bit of inputs of these lengths and count how often each
+ * output bit flips, inputs per length gives the number of inputs */
+#define AVALANCHE_INPUTS (32)
+
+/* returns number of output bits whose flip rate is not near one half */
+static int check_avalanche(mfu_digest_alg alg, const unsigned char* data)
+{
+    static const size_t lens[] = {1, 8, 16, 63, 64, 65, 200};
+
+    int errors = 0;
+    unsigned char buf[256];
+    size_t l;
+    for (l = 0; l < sizeof(lens) / sizeof(lens[0]); l++) {
+        size_t len = lens[l];
+        uint64_t flips[128];
+        memset(flips, 0, sizeof(flips));
+        uint64_t trials = 0;
+
+        size_t in;
+        for (in = 0; in < AVALANCHE_INPUTS; in++) {
+            memcpy(buf, data + in * len, len);
+            mfu_digest_value base;
+            mfu_digest_buf(alg, buf, len, &base);
+
+            size_t bit;
+            for (bit = 0; bit < len * 8; bit++) {
+                buf[bit / 8] ^= (unsigned char) (1 << (bit % 8));
+                mfu_digest_value value;
+                mfu_digest_buf(alg, buf, len, &value);
+                buf[bit / 8] ^= (unsigned char) (1 << (bit % 8));
+
+                int k;
+                for (k = 0; k < 128; k++) {
+                    uint64_t diff = base.h[k / 64] ^ value.h[k / 64];
+                    flips[k] += (diff >> (k % 64)) & 1;
+                }
+                trials++;
+            }
+        }
+
+        /* with at least 256 trials per bit, a rate outside 0.5 +/- 6
+         * standard deviations means the bit depends poorly on the input */
+        double sigma = 0.5 / sqrt((double) trials);
+        int k;
+        for (k = 0; k < 128; k++) {
+            double rate = (double) flips[k] / (double) trials;
+            if (fabs(rate - 0.5) > 6.0 * sigma) {
+                printf("%s of %llu bytes flips output bit %d at rate %.3f\n",
+                       mfu_digest_alg_name(alg), (unsigned long long) len, k, rate);
+                errors++;
+            }
+        }
+    }
+    return errors;
+}
+
+/* number of inputs hashed to look for collisions */
+#define SPREAD_INPUTS (1 << 20)
+
+/* sort digests as 128-bit values */
+static int value_cmp(const void* a, const void* b)
+{
+    const mfu_digest_value* va = (const mfu_digest_value*) a;
+    const mfu_digest_value* vb = (const mfu_digest_value*) b;
+    int i;
+    for (i = 0; i < 2; i++) {
+        if (va->h[i] != vb->h[i]) {
+            return (va->h[i] < vb->h[i]) ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+/* sort digests by their low 32 bits */
+static int low_cmp(const void* a, const void* b)
+{
+    uint32_t la = (uint32_t) ((const mfu_digest_value*) a)->h[0];
+    uint32_t lb = (uint32_t) ((const mfu_digest_value*) b)->h[0];
+    return (la < lb) ? -1 : (la > lb);
+}
+
+/* hash SPREAD_INPUTS inputs that differ in few bits: counters in a
+ * 16-byte buffer, a 1024-byte block with two bits set, and the test
+ * data with one byte changed, then check that no two digests are
+ * equal, that truncating them to 32 bits gives about as many
+ * collisions as a random function, and that their low 16 bits spread
+ * evenly over all values, returns number of failed checks */
+static int check_spread(mfu_digest_alg alg, const unsigned char* data)
+{
+    static const char* kinds[] = {"counters", "two bits set", "one byte changed"};
+
+    mfu_digest_value* values = (mfu_digest_value*) malloc(SPREAD_INPUTS * sizeof(mfu_digest_value));
+    uint32_t* buckets = (uint32_t*) malloc(65536 * sizeof(uint32_t));
+    unsigned char* buf = (unsigned char*) malloc(DATA_SIZE);
+
+    int errors = 0;
+    int kind;
+    for (kind = 0; kind < 3; kind++) {
+        size_t n;
+        for (n = 0; n < SPREAD_INPUTS; n++) {
+            if (kind == 0) {
+                uint64_t words[2] = {(uint64_t) n, 0};
+                mfu_digest_buf(alg, words, sizeof(words), &values[n]);
+            } else if (kind == 1) {
+                /* pick the n-th pair of distinct bits of 8192 */
+                size_t a = n % 8192;
+                size_t b = (a + 1 + n / 8192) % 8192;
+                memset(buf, 0, 1024);
+                buf[a / 8] |= (unsigned char) (1 << (a % 8));
+                buf[b / 8] |= (unsigned char) (1 << (b % 8));
+                mfu_digest_buf(alg, buf, 1024, &values[n]);
+            } else {
+                /* change each of 4096 bytes to 256 different values */
+                size_t len = 4096;
+                size_t pos = n % len;
+                memcpy(buf, data, len);
+                buf[pos] = (unsigned char) (data[pos] + 1 + (n / len) % 255);
+                if (n / len == 255) {
+                    /* change the length instead */
+                    len = pos;
+                }
+                mfu_digest_buf(alg, buf, len, &values[n]);
+            }
+        }
+
+        /* no two of the inputs are equal, so no two digests should be */
+        qsort(values, SPREAD_INPUTS, sizeof(mfu_digest_value), value_cmp);
+        uint64_t dups = 0;
+        for (n = 1; n < SPREAD_INPUTS; n++) {
+            if (value_cmp(&values[n - 1], &values[n]) == 0) {
+                dups++;
+            }
+        }
+        if (dups > 0) {
+            printf("%s of %s gave %llu colliding digests\n",
+                   mfu_digest_alg_name(alg), kinds[kind], (unsigned long long) dups);
+            errors++;
+        }
+
+        /* a random function maps 2^20 inputs to about 2^40 / 2^33 = 128
+         * pairs of equal 32-bit values, allow for chance */
+        qsort(values, SPREAD_INPUTS, sizeof(mfu_digest_value), low_cmp);
+        uint64_t pairs = 0;
+        for (n = 1; n < SPREAD_INPUTS; n++) {
+            if (low_cmp(&values[n - 1], &values[n]) == 0) {
+                pairs++;
+            }
+        }
+        if (pairs < 64 || pairs > 224) {
+            printf("%s of %s gave %llu collisions in 32 bits, expected about 128\n",
+                   mfu_digest_alg_name(alg), kinds[kind], (unsigned long long) pairs);
+            errors++;
+        }
+
+        /* chi-square of the low 16 bits over 65536 buckets, with 16
+         * expected in each, has mean 65535 and deviation 362 */
+        memset(buckets, 0, 65536 * sizeof(uint32_t));
+        for (n = 0; n < SPREAD_INPUTS; n++) {
+            buckets[values[n].h[0] & 0xffff]++;
+        }
+        double chi = 0.0;
+        for (n = 0; n < 65536; n++) {
+            double d = (double) buckets[n] - 16.0;
+            chi += d * d / 16.0;
+        }
+        if (fabs(chi - 65535.0) > 6.0 * 362.0) {
+            printf("%s of %s spreads unevenly, chi-square %.0f, expected about 65535\n",
+                   mfu_digest_alg_name(alg), kinds[kind], chi);
+            errors++;
+        }
+    }
+
+    free(buf);
+    free(buckets);
+    free(values);
+    return errors;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 1) {
+        printf("Usage: digest_check\n");
+        return 1;
+    }
+
+    /* test data from a fixed generator */
+    unsigned char* data = (unsigned char*) malloc(DATA_SIZE);
+    uint64_t x = 0x0123456789abcdefULL;
+    size_t i;
+    for (i = 0; i < DATA_SIZE; i++) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        data[i] = (unsigned char) (x >> 56);
+    }
+
+    int errors = check_murmur();
+    errors += check_splits(MFU_DIGEST_MURMUR3, "generic", data);
+    errors += check_avalanche(MFU_DIGEST_MURMUR3, data);
+    errors += check_spread(MFU_DIGEST_MURMUR3, data);
+
+    /* digests from the generic path to compare the others against */
+    static const size_t lens[] = {0, 1, 63, 64, 65, 1024, 1100, DATA_SIZE};
+    size_t count = sizeof(lens) / sizeof(lens[0]);
+    mfu_digest_value expect[sizeof(lens) / sizeof(lens[0])];
+    mfu_digest_set_impl("generic");
+    for (i = 0; i < count; i++) {
+        mfu_digest_buf(MFU_DIGEST_FAST, data, lens[i], &expect[i]);
+    }
+
+    /* all paths give the same digest, so checking the quality
+     * of the generic one covers them all */
+    errors += check_avalanche(MFU_DIGEST_FAST, data);
+    errors += check_spread(MFU_DIGEST_FAST, data);
+
+    const char* impls[] = {"generic", "sse2", "avx2"};
+    size_t j;
+    for (j = 0; j < sizeof(impls) / sizeof(impls[0]); j++) {
+        if (mfu_digest_set_impl(impls[j]) != 0) {
+            printf("fast digest %s is not available, skipping it\n", impls[j]);
+            continue;
+        }
+        printf("checking fast digest %s\n", mfu_digest_impl(MFU_DIGEST_FAST));
+
+        for (i = 0; i < count; i++) {
+            mfu_digest_value value;
+            mfu_digest_buf(MFU_DIGEST_FAST, data, lens[i], &value);
+            if (value.h[0] != expect[i].h[0] || value.h[1] != expect[i].h[1]) {
+                printf("fast (%s) of %llu bytes differs from generic\n",
+                       impls[j], (unsigned long long) lens[i]);
+                errors++;
+            }
+        }
+        errors += check_splits(MFU_DIGEST_FAST, impls[j], data);
+    }
+
+    free(data);
+
+    if (errors > 0) {
+        printf("%d digest checks failed\n", errors);
+        return 1;
+    }
+    printf("all digest checks passed\n");
+    return 0;
+}
@@ -0,0 +1,218 @@
+/*
+ * Checks that mfu_flist_writer writes the same bytes as
+ * mfu_flist_write_cache and mfu_flist_write_text.
+ *
+ * Walks a directory with and without stat, and for several selections of
+ * the items, writes a list of the selected items with the whole-list
+ * writers and streams the same items through mfu_flist_writer, flushing
+ * after every few items.  The two files must match byte for byte, and
+ * when nothing is selected, neither writer may create a cache file.
+ *
+ * Usage: flist_writer_check <dir> <prefix of files to write>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "mpi.h"
+#include "mfu.h"
+
+/* number of items added to a writer between flushes */
+#define FLUSH_ITEMS 3
+
+/* selections of items */
+enum {
+    SELECT_ALL,   /* every item */
+    SELECT_ODD,   /* every other item on each rank */
+    SELECT_LATE,  /* every item on ranks other than 0 */
+    SELECT_NONE,  /* no items */
+    SELECTIONS
+};
+
+static const char* select_names[SELECTIONS] = {"all", "odd", "late", "none"};
+
+static int selected(int selection, uint64_t idx)
+{
+    switch (selection) {
+        case SELECT_ALL:
+            return 1;
+        case SELECT_ODD:
+            return (int) (idx & 1);
+        case SELECT_LATE:
+            return (mfu_rank != 0);
+        default:
+            return 0;
+    }
+}
+
+/* returns 0 if both files are missing or both have the same bytes,
+ * called by rank 0 */
+static int compare_files(const char* a, const char* b)
+{
+    FILE* fa = fopen(a, "r");
+    FILE* fb = fopen(b, "r");
+    if (fa == NULL || fb == NULL) {
+        int rc = (fa != NULL || fb != NULL);
+        if (rc) {
+            printf("ERROR: only one of %s and %s exists\n", a, b);
+        }
+        if (fa != NULL) {
+            fclose(fa);
+        }
+        if (fb != NULL) {
+            fclose(fb);
+        }
+        return rc;
+    }
+
+    int rc = 0;
+    uint64_t pos = 0;
+    while (1) {
+        int ca = fgetc(fa);
+        int cb = fgetc(fb);
+        if (ca != cb) {
+            printf("ERROR: %s and %s differ at byte %llu\n",
+                a, b, (unsigned long long) pos
+            );
+            rc = 1;
+            break;
+        }
+        if (ca == EOF) {
+            break;
+        }
+        pos++;
+    }
+
+    fclose(fa);
+    fclose(fb);
+    return rc;
+}
+
+/* writes the selected items of flist both ways and compares the files,
+ * returns the number of mismatches */
+static int check_writer(mfu_flist flist, const char* prefix, const char* label, int cache, int selection)
+{
+    char whole[1024];
+    char stream[1024];
+    snprintf(whole,  sizeof(whole),  "%s.%s.%s.%s.whole",  prefix, label, cache ? "cache" : "text", select_names[selection]);
+    snprintf(stream, sizeof(stream), "%s.%s.%s.%s.stream", prefix, label, cache ? "cache" : "text", select_names[selection]);
+
+    if (mfu_rank == 0) {
+        unlink(whole);
+        unlink(stream);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    /* write a list of the selected items in one go */
+    mfu_flist subset = mfu_flist_subset(flist);
+    uint64_t size = mfu_flist_size(flist);
+    uint64_t idx;
+    for (idx = 0; idx < size; idx++) {
+        if (selected(selection, idx)) {
+            mfu_flist_file_copy(flist, idx, subset);
+        }
+    }
+    mfu_flist_summarize(subset);
+    if (cache) {
+        mfu_flist_write_cache(whole, subset);
+    } else {
+        mfu_flist_write_text(whole, subset);
+    }
+    mfu_flist_free(&subset);
+
+    /* stream the same items, flushes are collective, so every rank
+     * flushes once for each group of items on the rank with the most */
+    mfu_flist_writer* w = mfu_flist_writer_new(stream, flist, cache);
+    uint64_t count = 0;
+    for (idx = 0; idx < size; idx++) {
+        if (selected(selection, idx)) {
+            mfu_flist_writer_count(w, flist, idx);
+            count++;
+        }
+    }
+    mfu_flist_writer_start(w);
+
+    uint64_t groups = (count + FLUSH_ITEMS - 1) / FLUSH_ITEMS;
+    uint64_t all_groups;
+    MPI_Allreduce(&groups, &all_groups, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
+
+    idx = 0;
+    uint64_t group;
+    for (group = 0; group < all_groups; group++) {
+        uint64_t added = 0;
+        while (added < FLUSH_ITEMS && idx < size) {
+            if (selected(selection, idx)) {
+                mfu_flist_writer_add(w, flist, idx);
+                added++;
+            }
+            idx++;
+        }
+        mfu_flist_writer_flush(w);
+    }
+    mfu_flist_writer_close(&w);
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    int errors = 0;
+    if (mfu_rank == 0) {
+        errors = compare_files(whole, stream);
+        if (errors == 0) {
+            unlink(whole);
+            unlink(stream);
+        }
+    }
+    MPI_Bcast(&errors, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    return errors;
+}
+
+int main(int argc, char** argv)
+{
+    MPI_Init(&argc, &argv);
+    mfu_init();
+
+    if (argc != 3) {
+        if (mfu_rank == 0) {
+            printf("Usage: %s <dir> <prefix of files to write>\n", argv[0]);
+        }
+        mfu_finalize();
+        MPI_Finalize();
+        return 1;
+    }
+
+    const char* dir    = argv[1];
+    const char* prefix = argv[2];
+
+    mfu_file_t* mfu_file = mfu_file_new();
+    mfu_walk_opts_t* walk_opts = mfu_walk_opts_new();
+
+    int errors = 0;
+    int use_stat;
+    for (use_stat = 0; use_stat <= 1; use_stat++) {
+        const char* label = use_stat ? "stat" : "nostat";
+
+        mfu_flist flist = mfu_flist_new();
+        walk_opts->use_stat = use_stat;
+        mfu_flist_walk_path(dir, walk_opts, flist, mfu_file);
+
+        int selection;
+        for (selection = 0; selection < SELECTIONS; selection++) {
+            errors += check_writer(flist, prefix, label, 1, selection);
+            errors += check_writer(flist, prefix, label, 0, selection);
+        }
+
+        mfu_flist_free(&flist);
+    }
+
+    mfu_walk_opts_delete(&walk_opts);
+    mfu_file_delete(&mfu_file);
+
+    if (errors > 0 && mfu_rank == 0) {
+        printf("ERROR: %d files differ\n", errors);
+    }
+
+    mfu_finalize();
+    MPI_Finalize();
+    return (errors > 0);
+}
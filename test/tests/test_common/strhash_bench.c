@@ -0,0 +1,209 @@
+/*
+ * Microbenchmark comparing strhash and strmap.
+ *
+ * Inserts N keys shaped like file paths, looks each of them up in a
+ * different order, looks up N keys that are not present, and then
+ * unsets every other key, checking results along the way.
+ *
+ * Usage: strhash_bench <strhash|strmap> <count>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "mpi.h"
+#include "mfu.h"
+#include "strmap.h"
+#include "strhash.h"
+
+/* return resident set size of this process in kilobytes */
+static long rss_kb(void)
+{
+    long kb = 0;
+    char line[256];
+    FILE* f = fopen("/proc/self/status", "r");
+    if (f != NULL) {
+        while (fgets(line, sizeof(line), f) != NULL) {
+            if (strncmp(line, "VmRSS:", 6) == 0) {
+                kb = atol(line + 6);
+            }
+        }
+        fclose(f);
+    }
+    return kb;
+}
+
+/* generate the key for item i, miss selects keys that are never inserted */
+static void make_key(char* buf, size_t size, uint64_t i, int miss)
+{
+    snprintf(buf, size, "/scratch/%s/dir%03llu/sub%03llu/file_%llu.dat",
+        miss ? "other" : "proj",
+        (unsigned long long) (i % 997), (unsigned long long) (i % 101),
+        (unsigned long long) i);
+}
+
+/* check that a key can be set to NULL and then to a short value,
+ * returns number of incorrect results */
+static int check_null_value(void)
+{
+    int errors = 0;
+    strhash* map = strhash_new();
+
+    strhash_set(map, "key", "abc");
+    strhash_set(map, "key", NULL);
+    if (strhash_get(map, "key") != NULL) {
+        errors++;
+    }
+
+    strhash_set(map, "key", "x");
+    const char* v = strhash_get(map, "key");
+    if (v == NULL || strcmp(v, "x") != 0) {
+        errors++;
+    }
+
+    if (strhash_size(map) != 1) {
+        errors++;
+    }
+
+    strhash_delete(&map);
+    return errors;
+}
+
+static void report(const char* what, uint64_t count, double secs)
+{
+    printf("  %-8s %12.0f ops/sec  (%.2f s)\n", what, (double) count / secs, secs);
+}
+
+int main(int argc, char** argv)
+{
+    MPI_Init(&argc, &argv);
+    mfu_init();
+
+    if (argc != 3) {
+        printf("Usage: %s <strhash|strmap> <count>\n", argv[0]);
+        mfu_finalize();
+        MPI_Finalize();
+        return 1;
+    }
+
+    int use_hash = (strcmp(argv[1], "strhash") == 0);
+    uint64_t count = strtoull(argv[2], NULL, 10);
+
+    /* lookups visit keys with a stride coprime to count */
+    uint64_t stride = 7919;
+    while (count > 0 && count % stride == 0) {
+        stride += 2;
+    }
+
+    strmap* smap = NULL;
+    strhash* hmap = NULL;
+    if (use_hash) {
+        hmap = strhash_new();
+    } else {
+        smap = strmap_new();
+    }
+
+    char key[256];
+    char val[32];
+    long rss_start = rss_kb();
+    int errors = 0;
+    uint64_t i;
+
+    printf("%s with %llu keys\n", argv[1], (unsigned long long) count);
+
+    if (use_hash) {
+        errors += check_null_value();
+    }
+
+    /* time to generate keys alone, which is included in every result below */
+    double start = MPI_Wtime();
+    size_t total = 0;
+    for (i = 0; i < count; i++) {
+        make_key(key, sizeof(key), i, 0);
+        total += strlen(key);
+    }
+    report("keygen", count, MPI_Wtime() - start);
+    if (total == 0) {
+        errors++;
+    }
+
+    /* insert */
+    start = MPI_Wtime();
+    for (i = 0; i < count; i++) {
+        make_key(key, sizeof(key), i, 0);
+        snprintf(val, sizeof(val), "%llu", (unsigned long long) i);
+        if (use_hash) {
+            strhash_set(hmap, key, val);
+        } else {
+            strmap_set(smap, key, val);
+        }
+    }
+    report("insert", count, MPI_Wtime() - start);
+    long rss_full = rss_kb();
+
+    /* look up every key */
+    start = MPI_Wtime();
+    uint64_t idx = 0;
+    for (i = 0; i < count; i++) {
+        idx = (idx + stride) % count;
+        make_key(key, sizeof(key), idx, 0);
+        const char* v = use_hash ? strhash_get(hmap, key) : strmap_get(smap, key);
+        if (v == NULL || strtoull(v, NULL, 10) != idx) {
+            errors++;
+        }
+    }
+    report("hit", count, MPI_Wtime() - start);
+
+    /* look up keys that are not present */
+    start = MPI_Wtime();
+    for (i = 0; i < count; i++) {
+        make_key(key, sizeof(key), i, 1);
+        const char* v = use_hash ? strhash_get(hmap, key) : strmap_get(smap, key);
+        if (v != NULL) {
+            errors++;
+        }
+    }
+    report("miss", count, MPI_Wtime() - start);
+
+    /* remove every other key and check the rest are still found */
+    start = MPI_Wtime();
+    for (i = 0; i < count; i += 2) {
+        make_key(key, sizeof(key), i, 0);
+        if (use_hash) {
+            strhash_unset(hmap, key);
+        } else {
+            strmap_unset(smap, key);
+        }
+    }
+    report("unset", (count + 1) / 2, MPI_Wtime() - start);
+
+    uint64_t size = use_hash ? strhash_size(hmap) : strmap_size(smap);
+    if (size != count / 2) {
+        errors++;
+    }
+    for (i = 0; i < count; i++) {
+        make_key(key, sizeof(key), i, 0);
+        const char* v = use_hash ? strhash_get(hmap, key) : strmap_get(smap, key);
+        if ((i % 2 == 0) != (v == NULL)) {
+            errors++;
+        }
+    }
+
+    printf("  memory   %12ld MB\n", (rss_full - rss_start) / 1024);
+
+    if (use_hash) {
+        strhash_delete(&hmap);
+    } else {
+        strmap_delete(&smap);
+    }
+
+    if (errors > 0) {
+        printf("ERROR: %d incorrect results\n", errors);
+    }
+
+    mfu_finalize();
+    MPI_Finalize();
+    return (errors > 0);
+}
@@ -0,0 +1,34 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   Checks murmur3 against reference values, checks that every version of
+#   the fast digest gives the same value, checks that digests do not
+#   depend on how the input is split, and checks both digests for
+#   avalanche, collisions, and even spread.  The digest_check program is built
+#   with the other test helpers under the test directory of the build tree.
+#
+#   Usage: test_digest.sh <digest_check binary>
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+DIGEST_CHECK_BIN=${DIGEST_CHECK_BIN:-${1}}
+
+echo "Using digest_check binary at: $DIGEST_CHECK_BIN"
+
+if [[ ! -x $DIGEST_CHECK_BIN ]]; then
+	echo "Failed to find digest_check binary: $DIGEST_CHECK_BIN"
+	exit 1
+fi
+
+$DIGEST_CHECK_BIN
+if [[ $? -ne 0 ]]; then
+	echo "Digest checks failed"
+	exit 1
+fi
+
+exit 0
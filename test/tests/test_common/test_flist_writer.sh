@@ -0,0 +1,59 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   Checks that mfu_flist_writer, which streams dcmp --output reports,
+#   writes the same bytes as mfu_flist_write_cache and mfu_flist_write_text
+#   for lists with and without stat detail and for items selected unevenly
+#   across ranks.  The flist_writer_check program is built with the other
+#   test helpers under the test directory of the build tree.
+#
+#   Usage: test_flist_writer.sh <flist_writer_check binary> <mpirun> <dir>
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+FLIST_WRITER_CHECK_BIN=${FLIST_WRITER_CHECK_BIN:-${1}}
+FLIST_WRITER_MPIRUN_BIN=${FLIST_WRITER_MPIRUN_BIN:-${2}}
+FLIST_WRITER_DIR=${FLIST_WRITER_DIR:-${3}}
+
+echo "Using flist_writer_check binary at: $FLIST_WRITER_CHECK_BIN"
+echo "Using mpirun binary at: $FLIST_WRITER_MPIRUN_BIN"
+echo "Using directory at: $FLIST_WRITER_DIR"
+
+if [[ ! -x $FLIST_WRITER_CHECK_BIN ]]; then
+	echo "Failed to find flist_writer_check binary: $FLIST_WRITER_CHECK_BIN"
+	exit 1
+fi
+
+TREE=$FLIST_WRITER_DIR/flist_writer_tree
+OUT=$FLIST_WRITER_DIR/flist_writer_out
+
+rm -rf $TREE $OUT
+mkdir -p $TREE/a/b $TREE/c $OUT
+
+# names of many lengths, so records of variable and fixed length differ
+for i in $(seq 1 40); do
+	name=$(printf "%0${i}d" $i)
+	head -c $((i * 37)) /dev/urandom > $TREE/a/$name
+	mkdir -p $TREE/c/d$name
+done
+for i in 1 2 3; do
+	echo $i > $TREE/a/b/f$i
+done
+ln -s a/b/f1 $TREE/link
+
+for np in 1 3 5; do
+	$FLIST_WRITER_MPIRUN_BIN -np $np $FLIST_WRITER_CHECK_BIN $TREE $OUT/out
+	if [[ $? -ne 0 ]]; then
+		echo "Writer output differs on $np ranks"
+		exit 1
+	fi
+done
+
+rm -rf $TREE $OUT
+
+exit 0
@@ -0,0 +1,37 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   Runs a microbenchmark of insert and lookup throughput for strhash
+#   and strmap, checking that both return correct results.  The
+#   strhash_bench program is built with the other test helpers under
+#   the test directory of the build tree.
+#
+#   Usage: test_strhash_bench.sh <strhash_bench binary> [counts]
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+STRHASH_BENCH_BIN=${STRHASH_BENCH_BIN:-${1}}
+MFU_BENCH_COUNTS=${MFU_BENCH_COUNTS:-${2:-"1000000 10000000"}}
+
+echo "Using strhash_bench binary at: $STRHASH_BENCH_BIN"
+echo "Using key counts: $MFU_BENCH_COUNTS"
+
+BENCH=$STRHASH_BENCH_BIN
+if [[ ! -x $BENCH ]]; then
+	echo "Failed to find strhash_bench binary: $BENCH"
+	exit 1
+fi
+
+rc=0
+for count in $MFU_BENCH_COUNTS; do
+	for impl in strhash strmap; do
+		$BENCH $impl $count || rc=1
+	done
+done
+
+exit $rc
@@ -0,0 +1,148 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   A test to check that dbcast, run with several processes on a node,
+#   copies a file and a directory tree so that the destination matches
+#   the source, and that over an existing copy it sends only the blocks
+#   that differ and still leaves a copy that matches the source.  Also
+#   checks that dbcast rejects a pipeline depth that is not a count of at
+#   least 2.
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+DBCAST_TEST_BIN=${DBCAST_TEST_BIN:-${1}}
+DBCAST_MPIRUN_BIN=${DBCAST_MPIRUN_BIN:-${2}}
+DBCAST_SRC_DIR=${DBCAST_SRC_DIR:-${3}}
+DBCAST_DEST_DIR=${DBCAST_DEST_DIR:-${4}}
+
+echo "Using dbcast binary at: $DBCAST_TEST_BIN"
+echo "Using mpirun binary at: $DBCAST_MPIRUN_BIN"
+echo "Using src directory at: $DBCAST_SRC_DIR"
+echo "Using dest directory at: $DBCAST_DEST_DIR"
+
+SRC=$DBCAST_SRC_DIR/dbcast
+DEST=$DBCAST_DEST_DIR/dbcast
+LOG=$DBCAST_DEST_DIR/dbcast.log
+
+cleanup()
+{
+	rm -rf $SRC $DEST
+	rm -f $LOG
+}
+
+# run dbcast on np processes, all on this node
+run_dbcast()
+{
+	np=$1
+	shift
+	$DBCAST_MPIRUN_BIN -np $np $DBCAST_TEST_BIN "$@" > $LOG 2>&1
+	if [[ $? -ne 0 ]]; then
+		cat $LOG
+		echo "Failed to run cmd: $DBCAST_MPIRUN_BIN -np $np $DBCAST_TEST_BIN $@"
+		exit 1
+	fi
+}
+
+check_file()
+{
+	cmp $SRC/big $DEST/big
+	if [[ $? -ne 0 ]]; then
+		echo "CMP mismatch: $SRC/big $DEST/big ($1)"
+		exit 1
+	fi
+}
+
+check_tree()
+{
+	diff -r --no-dereference $SRC/tree $DEST/tree
+	if [[ $? -ne 0 ]]; then
+		echo "Copied tree differs: $SRC/tree $DEST/tree ($1)"
+		exit 1
+	fi
+}
+
+check_log()
+{
+	grep -q "$1" $LOG
+	if [[ $? -ne 0 ]]; then
+		cat $LOG
+		echo "Expected dbcast to log: $1"
+		exit 1
+	fi
+}
+
+# dbcast must refuse the option value with an error and copy nothing
+check_reject()
+{
+	rm -rf $DEST/big
+	$DBCAST_MPIRUN_BIN -np 2 $DBCAST_TEST_BIN "$@" $SRC/big $DEST/big > $LOG 2>&1
+	grep -q "Failed to parse" $LOG
+	if [[ $? -ne 0 || -e $DEST/big ]]; then
+		cat $LOG
+		echo "Expected dbcast to reject options: $@"
+		exit 1
+	fi
+}
+
+cleanup
+mkdir -p $SRC $DEST
+
+# a file that ends in a partial block and a partial chunk
+head -c 5000000 /dev/urandom > $SRC/big
+
+mkdir -p $SRC/tree/a/b $SRC/tree/empty_dir
+for i in 1 2 3 4 5 6 7 8; do
+	head -c $((i * 70001)) /dev/urandom > $SRC/tree/a/f$i
+	echo "small $i" > $SRC/tree/a/b/s$i
+done
+: > $SRC/tree/zero
+ln -s a/f1 $SRC/tree/link
+
+for np in 2 4; do
+	rm -rf $DEST/big $DEST/tree
+
+	# copy a file to a new destination
+	run_dbcast $np -s 1MB -c 256KB $SRC/big $DEST/big
+	check_file "new copy on $np ranks"
+
+	# an existing copy that matches is not written again
+	run_dbcast $np -s 1MB -c 256KB $SRC/big $DEST/big
+	check_log "sending 0 blocks"
+	check_file "matching copy on $np ranks"
+
+	# change one byte, only the chunk that holds it is sent
+	printf X | dd of=$DEST/big bs=1 seek=2500000 conv=notrunc 2>/dev/null
+	run_dbcast $np -s 1MB -c 256KB $SRC/big $DEST/big
+	check_log "sending 1 blocks (262144 bytes)"
+	check_file "changed copy on $np ranks"
+
+	# a copy that is too short gets the chunks it lacks
+	truncate -s 3000000 $DEST/big
+	run_dbcast $np -s 1MB -c 256KB $SRC/big $DEST/big
+	check_file "short copy on $np ranks"
+
+	# copy a tree, and again over the existing copy
+	run_dbcast $np -s 1MB -c 256KB $SRC/tree $DEST/tree
+	check_tree "new tree on $np ranks"
+	echo "changed" > $DEST/tree/a/b/s1
+	run_dbcast $np -s 1MB -c 256KB $SRC/tree $DEST/tree
+	check_tree "existing tree on $np ranks"
+done
+
+for opts in "-D 0" "-D 1" "-D -3" "-D abc" "-D 4x" "-D 99999999999"; do
+	check_reject $opts
+done
+
+# the smallest depth works
+rm -rf $DEST/big
+run_dbcast 4 -D 2 -s 1MB -c 256KB $SRC/big $DEST/big
+check_file "depth 2"
+
+cleanup
+
+exit 0
@@ -420,3 +420,157 @@ test_10()
 }
 
 run_test 10 "Same, extras and diff comparison"
+
+test_11()
+{
+	# build trees that share some entries and differ in others
+	for d in a a/b c; do
+		mkdir -p $TEST_SRC/$d $TEST_DST/$d
+		for i in 1 2 3 4 5; do
+			echo "$d $i" > $TEST_SRC/$d/$tfile.$i
+			cp -p $TEST_SRC/$d/$tfile.$i $TEST_DST/$d/$tfile.$i
+		done
+	done
+	echo changed > $TEST_DST/a/b/$tfile.3
+	touch $TEST_SRC/c/only_src $TEST_DST/a/only_dst
+	rm -f $TEST_DST/c/$tfile.2
+	mkdir $TEST_DST/c/$tfile.2
+
+	# the sort-merge join must find the same items as the hash join
+	for expr in EXIST=DIFFER EXIST=COMMON TYPE=DIFFER CONTENT=DIFFER; do
+		$DCMP -t -o $expr:$OUTPUT_FILE.hash $TEST_SRC $TEST_DST
+		$DCMP -t --sort-join -o $expr:$OUTPUT_FILE.sort $TEST_SRC $TEST_DST
+		diff <(awk '{print $NF}' $OUTPUT_FILE.hash | sort) \
+			<(awk '{print $NF}' $OUTPUT_FILE.sort | sort) \
+			|| error "--sort-join differs for $expr"
+	done
+	rm -f $OUTPUT_FILE.hash $OUTPUT_FILE.sort
+	return 0
+}
+run_test 11 "check --sort-join matches default join"
+
+test_12()
+{
+	mkdir -p $TEST_SRC/$tdir $TEST_DST/$tdir
+	for i in 1 2 3; do
+		echo $i > $TEST_SRC/$tdir/$tfile.$i
+		cp -p $TEST_SRC/$tdir/$tfile.$i $TEST_DST/$tdir/$tfile.$i
+	done
+	echo changed > $TEST_DST/$tdir/$tfile.2
+	touch $TEST_SRC/only_src $TEST_DST/only_dst
+
+	# compare cache files written by dwalk against a live walk
+	$DWALK -o $OUTPUT_FILE.src $TEST_SRC
+	$DWALK -o $OUTPUT_FILE.dst $TEST_DST
+	for expr in EXIST=ONLY_SRC EXIST=ONLY_DEST CONTENT=DIFFER; do
+		$DCMP -t --lite -o $expr:$OUTPUT_FILE.live $TEST_SRC $TEST_DST
+		$DCMP -t -o $expr:$OUTPUT_FILE.cache \
+			--src-cache $OUTPUT_FILE.src --dst-cache $OUTPUT_FILE.dst
+		diff <(awk '{print $NF}' $OUTPUT_FILE.live | sort) \
+			<(awk '{print $NF}' $OUTPUT_FILE.cache | sort) \
+			|| error "--src-cache/--dst-cache differs for $expr"
+	done
+	rm -f $OUTPUT_FILE.src $OUTPUT_FILE.dst $OUTPUT_FILE.live $OUTPUT_FILE.cache
+	return 0
+}
+run_test 12 "check --src-cache and --dst-cache match a live comparison"
+
+test_13()
+{
+	mkdir -p $TEST_SRC/$tdir $TEST_DST/$tdir
+	for i in 1 2 3 4; do
+		dd if=/dev/urandom of=$TEST_SRC/$tdir/$tfile.$i bs=1M count=$i \
+			2>/dev/null
+		cp -p $TEST_SRC/$tdir/$tfile.$i $TEST_DST/$tdir/$tfile.$i
+	done
+
+	# a change that keeps size and mtime must still be found,
+	# whether digests come from the store or are computed
+	printf X | dd of=$TEST_DST/$tdir/$tfile.3 bs=1 seek=1500000 \
+		conv=notrunc 2>/dev/null
+	touch -r $TEST_SRC/$tdir/$tfile.3 $TEST_DST/$tdir/$tfile.3
+	rm -f $OUTPUT_FILE.store
+	for run in 1 2; do
+		$DCMP -t -o CONTENT=DIFFER:$OUTPUT_FILE.live $TEST_SRC $TEST_DST
+		$DCMP -t --hash-store $OUTPUT_FILE.store \
+			-o CONTENT=DIFFER:$OUTPUT_FILE.hash $TEST_SRC $TEST_DST \
+			> $OUTPUT_FILE.log 2>&1
+		[ -f $OUTPUT_FILE.store ] || error "--hash-store file not written"
+		diff <(awk '{print $NF}' $OUTPUT_FILE.live | sort) \
+			<(awk '{print $NF}' $OUTPUT_FILE.hash | sort) \
+			|| error "--hash-store differs in run $run"
+
+		# the first run reads all 10MB of both trees, the
+		# second only the 3MB of the one file that changed
+		bytes=20971520
+		[ $run -eq 2 ] && bytes=3145728
+		grep -q "Bytes read: .* ($bytes bytes)" $OUTPUT_FILE.log || \
+			error "--hash-store did not read $bytes bytes in run $run"
+
+		# fix the file for the second run, which rereads only it
+		cp -p $TEST_SRC/$tdir/$tfile.3 $TEST_DST/$tdir/$tfile.3
+	done
+	rm -f $OUTPUT_FILE.store $OUTPUT_FILE.live $OUTPUT_FILE.hash \
+		$OUTPUT_FILE.log
+	return 0
+}
+run_test 13 "check --hash-store matches a byte comparison"
+
+test_14()
+{
+	mkdir -p $TEST_SRC/$tdir $TEST_DST/$tdir
+	for i in 1 2 3; do
+		dd if=/dev/zero of=$TEST_SRC/$tdir/$tfile.$i bs=1M count=3 \
+			2>/dev/null
+		cp -p $TEST_SRC/$tdir/$tfile.$i $TEST_DST/$tdir/$tfile.$i
+	done
+
+	# one change in a later chunk, and changes in two chunks,
+	# of which the report must give the earlier one
+	printf X | dd of=$TEST_DST/$tdir/$tfile.1 bs=1 seek=2500000 \
+		conv=notrunc 2>/dev/null
+	printf X | dd of=$TEST_DST/$tdir/$tfile.2 bs=1 seek=100 \
+		conv=notrunc 2>/dev/null
+	printf X | dd of=$TEST_DST/$tdir/$tfile.2 bs=1 seek=2000000 \
+		conv=notrunc 2>/dev/null
+	touch -r $TEST_SRC/$tdir/$tfile.1 $TEST_DST/$tdir/$tfile.1
+	touch -r $TEST_SRC/$tdir/$tfile.2 $TEST_DST/$tdir/$tfile.2
+
+	$DCMP -v $TEST_SRC $TEST_DST > $OUTPUT_FILE.log 2>&1
+	grep "Contents differ at offset" $OUTPUT_FILE.log | \
+		sed 's/.*Contents differ/Contents differ/' | sort > $OUTPUT_FILE.offsets
+	diff $OUTPUT_FILE.offsets - <<-EOF || error "wrong offsets reported"
+	Contents differ at offset 100: \`$TEST_SRC/$tdir/$tfile.2'
+	Contents differ at offset 2500000: \`$TEST_SRC/$tdir/$tfile.1'
+	EOF
+	rm -f $OUTPUT_FILE.log $OUTPUT_FILE.offsets
+	return 0
+}
+run_test 14 "check -v reports where each file first differs"
+
+test_15()
+{
+	# names whose walk order differs from name order
+	for f in zz a m b9 b10 q $tdir/x $tdir/a k; do
+		mkdir -p $(dirname $TEST_SRC/$f) $(dirname $TEST_DST/$f)
+		echo $f > $TEST_SRC/$f
+		cp -p $TEST_SRC/$f $TEST_DST/$f
+	done
+
+	# source items come first in name order, then dest items
+	$DCMP -t -o EXIST=COMMON:$OUTPUT_FILE $TEST_SRC $TEST_DST
+	(cd $TEST_SRC && find . | sed "s|^\.|$TEST_SRC|" | LC_ALL=C sort; \
+	 cd $TEST_DST && find . | sed "s|^\.|$TEST_DST|" | LC_ALL=C sort) \
+		> $OUTPUT_FILE.expect
+	diff <(awk '{print $NF}' $OUTPUT_FILE) $OUTPUT_FILE.expect \
+		|| error "items are not written in name order"
+
+	# with --sort-join, both lists are merged in name order
+	$DCMP -t --sort-join -o EXIST=COMMON:$OUTPUT_FILE $TEST_SRC $TEST_DST
+	diff <(awk '{print $NF}' $OUTPUT_FILE | sed "s|^$TEST_DST|$TEST_SRC|") \
+		<(LC_ALL=C sort $OUTPUT_FILE.expect | sed "s|^$TEST_DST|$TEST_SRC|" | LC_ALL=C sort) \
+		|| error "--sort-join items are not written in name order"
+	rm -f $OUTPUT_FILE $OUTPUT_FILE.expect
+	return 0
+}
+run_test 15 "check -o writes items in name order"
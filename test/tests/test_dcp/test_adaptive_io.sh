@@ -0,0 +1,114 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   A test to check that dcp --adaptive-io copies large files correctly,
+#   with aligned and unaligned chunk sizes and with --sparse, which must
+#   keep the holes of a large file, and, when
+#   fincore is available, that a large copied file is left out of the page
+#   cache, while a copy without the option stays cached.
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+DCP_TEST_BIN=${DCP_TEST_BIN:-${1}}
+DCP_MPIRUN_BIN=${DCP_MPIRUN_BIN:-${2}}
+DCP_CMP_BIN=${DCP_CMP_BIN:-${3}}
+DCP_SRC_DIR=${DCP_SRC_DIR:-${4}}
+DCP_DEST_DIR=${DCP_DEST_DIR:-${5}}
+
+echo "Using dcp binary at: $DCP_TEST_BIN"
+echo "Using mpirun binary at: $DCP_MPIRUN_BIN"
+echo "Using cmp binary at: $DCP_CMP_BIN"
+echo "Using src directory at: $DCP_SRC_DIR"
+echo "Using dest directory at: $DCP_DEST_DIR"
+
+SRC=$DCP_SRC_DIR/adaptive_io
+DEST=$DCP_DEST_DIR/adaptive_io
+
+# at least 64MB to use adaptive I/O, and not a multiple of the block size
+BIG_SIZE=70000123
+
+# at most this many bytes of the large copy may stay in the page cache
+MAX_CACHED=$((4 * 1024 * 1024))
+
+FINCORE=`which fincore 2>/dev/null`
+if [[ -z $FINCORE ]]; then
+	echo "fincore not found, skipping page cache checks"
+fi
+
+run_dcp()
+{
+	rm -rf $DEST
+	$DCP_MPIRUN_BIN -np 4 $DCP_TEST_BIN "$@" $SRC $DEST > /dev/null 2>&1
+	if [[ $? -ne 0 ]]; then
+		echo "Failed to run cmd: $DCP_MPIRUN_BIN -np 4 $DCP_TEST_BIN $@ $SRC $DEST"
+		exit 1
+	fi
+}
+
+# print number of bytes of a file in the page cache
+cached_bytes()
+{
+	$FINCORE -b -n -o RES $1 | tr -d ' '
+}
+
+check_same()
+{
+	for f in `ls $SRC`; do
+		$DCP_CMP_BIN $SRC/$f $DEST/$f
+		if [[ $? -ne 0 ]]; then
+			echo "CMP mismatch: $SRC/$f $DEST/$f ($1)"
+			exit 1
+		fi
+	done
+}
+
+rm -rf $SRC $DEST
+mkdir -p $SRC
+head -c $BIG_SIZE /dev/urandom > $SRC/big
+head -c 1000 /dev/urandom > $SRC/small
+dd if=/dev/urandom of=$SRC/holes bs=1M count=2 seek=70 2>/dev/null
+
+for opts in "--adaptive-io" "--adaptive-io -k 3000000" "--adaptive-io --sparse"; do
+	run_dcp $opts
+
+	# check the cache before cmp reads the copy back in
+	if [[ -n $FINCORE ]]; then
+		cached=`cached_bytes $DEST/big`
+		if [[ $cached -gt $MAX_CACHED ]]; then
+			echo "Expected at most $MAX_CACHED bytes of $DEST/big in the page cache, found $cached ($opts)"
+			exit 1
+		fi
+	fi
+
+	check_same "$opts"
+
+	# only the 2MB of data past the hole is allocated
+	if [[ $opts == *--sparse* ]]; then
+		allocated=$((`stat -c "%b * %B" $DEST/holes`))
+		if [[ $allocated -gt $((3 * 1024 * 1024)) ]]; then
+			echo "Expected $DEST/holes to stay sparse, found $allocated bytes allocated ($opts)"
+			exit 1
+		fi
+	fi
+done
+
+# without the option, the copy stays cached, which shows that the
+# check above measures the effect of the option
+if [[ -n $FINCORE ]]; then
+	run_dcp
+	cached=`cached_bytes $DEST/big`
+	if [[ $cached -le $MAX_CACHED ]]; then
+		echo "Expected $DEST/big to be in the page cache without --adaptive-io, found $cached bytes"
+		exit 1
+	fi
+	check_same "default"
+fi
+
+rm -rf $SRC $DEST
+
+exit 0
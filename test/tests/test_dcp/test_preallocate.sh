@@ -0,0 +1,108 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   A test to check that dcp --preallocate allocates each nonempty
+#   destination file to its full size when it is created, that it does not
+#   without the option or with --sparse, and that the copies match the
+#   source, also when an existing destination file was larger.
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+DCP_TEST_BIN=${DCP_TEST_BIN:-${1}}
+DCP_MPIRUN_BIN=${DCP_MPIRUN_BIN:-${2}}
+DCP_CMP_BIN=${DCP_CMP_BIN:-${3}}
+DCP_SRC_DIR=${DCP_SRC_DIR:-${4}}
+DCP_DEST_DIR=${DCP_DEST_DIR:-${5}}
+
+echo "Using dcp binary at: $DCP_TEST_BIN"
+echo "Using mpirun binary at: $DCP_MPIRUN_BIN"
+echo "Using cmp binary at: $DCP_CMP_BIN"
+echo "Using src directory at: $DCP_SRC_DIR"
+echo "Using dest directory at: $DCP_DEST_DIR"
+
+SRC=$DCP_SRC_DIR/preallocate
+DEST=$DCP_DEST_DIR/preallocate
+
+# copy SRC to DEST with the given options, the output is kept in OUTPUT
+run_dcp()
+{
+	OUTPUT=`$DCP_MPIRUN_BIN -np 4 $DCP_TEST_BIN --debug dbg -k 512KB "$@" 2>&1`
+	if [[ $? -ne 0 ]]; then
+		echo "$OUTPUT"
+		echo "Failed to run cmd: $DCP_MPIRUN_BIN -np 4 $DCP_TEST_BIN --debug dbg -k 512KB $@"
+		exit 1
+	fi
+}
+
+check_same()
+{
+	for f in `ls $SRC`; do
+		$DCP_CMP_BIN $SRC/$f $DEST/$f
+		if [[ $? -ne 0 ]]; then
+			echo "CMP mismatch: $SRC/$f $DEST/$f ($1)"
+			exit 1
+		fi
+	done
+}
+
+# check the number of files that dcp preallocated
+check_count()
+{
+	count=`echo "$OUTPUT" | grep -c "Preallocated [0-9]* bytes"`
+	if [[ $count -ne $1 ]]; then
+		echo "$OUTPUT"
+		echo "Expected $1 preallocated files, found $count ($2)"
+		exit 1
+	fi
+}
+
+rm -rf $SRC $DEST
+mkdir -p $SRC
+
+# Create files with sizes that do not fall on chunk boundaries.
+for i in 1 2 3; do
+	dd if=/dev/urandom of=$SRC/file$i bs=1M count=$((i * 2)) 2>/dev/null
+	echo "tail $i" >> $SRC/file$i
+done
+touch $SRC/empty
+
+# every nonempty file is allocated to its full size
+run_dcp --preallocate $SRC $DEST
+check_count 3 "preallocate"
+for i in 1 2 3; do
+	size=`stat -c %s $SRC/file$i`
+	echo "$OUTPUT" | grep -q "Preallocated $size bytes: \`$DEST/file$i'"
+	if [[ $? -ne 0 ]]; then
+		echo "$OUTPUT"
+		echo "Expected $DEST/file$i to be preallocated to $size bytes"
+		exit 1
+	fi
+done
+check_same "preallocate"
+
+# a larger existing file ends up with the size of the source
+rm -f $DEST/file1
+head -c 9000000 /dev/urandom > $DEST/file1
+run_dcp --preallocate $SRC/file1 $DEST/file1
+check_count 1 "larger destination"
+check_same "larger destination"
+
+# nothing is preallocated without the option or with --sparse
+rm -rf $DEST
+run_dcp $SRC $DEST
+check_count 0 "default"
+check_same "default"
+
+rm -rf $DEST
+run_dcp --preallocate --sparse $SRC $DEST
+check_count 0 "sparse"
+check_same "sparse"
+
+rm -rf $SRC $DEST
+
+exit 0
@@ -0,0 +1,67 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   A test to check that dcp copies a tree correctly when it copies items
+#   while the source is still being walked, including files large enough
+#   to be deferred until after the walk.
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+DCP_TEST_BIN=${DCP_TEST_BIN:-${1}}
+DCP_MPIRUN_BIN=${DCP_MPIRUN_BIN:-${2}}
+DCP_DIFF_BIN=${DCP_DIFF_BIN:-${3}}
+DCP_SRC_DIR=${DCP_SRC_DIR:-${4}}
+DCP_DEST_DIR=${DCP_DEST_DIR:-${5}}
+
+echo "Using dcp binary at: $DCP_TEST_BIN"
+echo "Using mpirun binary at: $DCP_MPIRUN_BIN"
+echo "Using diff binary at: $DCP_DIFF_BIN"
+echo "Using src directory at: $DCP_SRC_DIR"
+echo "Using dest directory at: $DCP_DEST_DIR"
+
+rm -rf $DCP_SRC_DIR/stream
+rm -rf $DCP_DEST_DIR/stream
+mkdir -p $DCP_SRC_DIR/stream
+
+# Create a few levels of directories with small files, a symlink,
+# an empty file, and files larger than the chunk size.
+for d in a a/b a/b/c d; do
+	mkdir -p $DCP_SRC_DIR/stream/$d
+	for i in 1 2 3 4 5 6 7 8; do
+		dd if=/dev/urandom of=$DCP_SRC_DIR/stream/$d/file$i bs=1K count=$((i * 17)) 2>/dev/null
+	done
+done
+dd if=/dev/urandom of=$DCP_SRC_DIR/stream/a/b/big bs=1M count=5 2>/dev/null
+echo "tail" >> $DCP_SRC_DIR/stream/a/b/big
+touch $DCP_SRC_DIR/stream/d/empty
+ln -s ../a/file1 $DCP_SRC_DIR/stream/d/link
+chmod 750 $DCP_SRC_DIR/stream/a/b
+
+$DCP_MPIRUN_BIN -np 3 $DCP_TEST_BIN --stream -p $DCP_SRC_DIR/stream $DCP_DEST_DIR/stream
+if [[ $? -ne 0 ]]; then
+	echo "Failed to run cmd: $DCP_MPIRUN_BIN -np 3 $DCP_TEST_BIN --stream -p $DCP_SRC_DIR/stream $DCP_DEST_DIR/stream"
+	exit 1
+fi
+
+$DCP_DIFF_BIN -r --no-dereference $DCP_SRC_DIR/stream $DCP_DEST_DIR/stream
+if [[ $? -ne 0 ]]; then
+	echo "DIFF mismatch: $DCP_SRC_DIR/stream $DCP_DEST_DIR/stream"
+	exit 1
+fi
+
+SRC_MODE=`stat -c %a $DCP_SRC_DIR/stream/a/b`
+DEST_MODE=`stat -c %a $DCP_DEST_DIR/stream/a/b`
+if [[ "$SRC_MODE" != "$DEST_MODE" ]]; then
+	echo "Directory mode mismatch: $SRC_MODE $DEST_MODE"
+	exit 1
+fi
+
+rm -rf $DCP_SRC_DIR/stream
+rm -rf $DCP_DEST_DIR/stream
+
+exit 0
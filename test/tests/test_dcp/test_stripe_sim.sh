@@ -0,0 +1,92 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   A test to check that dcp copies correctly when chunks are aligned to a
+#   simulated stripe layout and ordered by OST, and that the OST schedule
+#   is printed.  Also checks that --stripe-align copies correctly when the
+#   OST of a chunk is not known, and off Lustre, that no chunk is assigned
+#   an OST.
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+DCP_TEST_BIN=${DCP_TEST_BIN:-${1}}
+DCP_MPIRUN_BIN=${DCP_MPIRUN_BIN:-${2}}
+DCP_CMP_BIN=${DCP_CMP_BIN:-${3}}
+DCP_SRC_DIR=${DCP_SRC_DIR:-${4}}
+DCP_DEST_DIR=${DCP_DEST_DIR:-${5}}
+
+echo "Using dcp binary at: $DCP_TEST_BIN"
+echo "Using mpirun binary at: $DCP_MPIRUN_BIN"
+echo "Using cmp binary at: $DCP_CMP_BIN"
+echo "Using src directory at: $DCP_SRC_DIR"
+echo "Using dest directory at: $DCP_DEST_DIR"
+
+rm -rf $DCP_SRC_DIR/stripe_sim
+rm -rf $DCP_DEST_DIR/stripe_sim
+mkdir -p $DCP_SRC_DIR/stripe_sim
+
+# Create files with sizes that do not fall on stripe boundaries.
+for i in 1 2 3 4 5; do
+	dd if=/dev/urandom of=$DCP_SRC_DIR/stripe_sim/file$i bs=1M count=$((i * 3)) 2>/dev/null
+	echo "tail $i" >> $DCP_SRC_DIR/stripe_sim/file$i
+done
+touch $DCP_SRC_DIR/stripe_sim/empty
+
+OUTPUT=`$DCP_MPIRUN_BIN -np 4 $DCP_TEST_BIN --stripe-sim 1MB:4:8 -k 512KB $DCP_SRC_DIR/stripe_sim $DCP_DEST_DIR/stripe_sim 2>&1`
+if [[ $? -ne 0 ]]; then
+	echo "$OUTPUT"
+	echo "Failed to run cmd: $DCP_MPIRUN_BIN -np 4 $DCP_TEST_BIN --stripe-sim 1MB:4:8 -k 512KB $DCP_SRC_DIR/stripe_sim $DCP_DEST_DIR/stripe_sim"
+	exit 1
+fi
+
+echo "$OUTPUT" | grep -q "OST conflicts"
+if [[ $? -ne 0 ]]; then
+	echo "$OUTPUT"
+	echo "OST schedule was not printed"
+	exit 1
+fi
+
+for f in `ls $DCP_SRC_DIR/stripe_sim`; do
+	$DCP_CMP_BIN $DCP_SRC_DIR/stripe_sim/$f $DCP_DEST_DIR/stripe_sim/$f
+	if [[ $? -ne 0 ]]; then
+		echo "CMP mismatch: $DCP_SRC_DIR/stripe_sim/$f $DCP_DEST_DIR/stripe_sim/$f"
+		exit 1
+	fi
+done
+
+# Without a simulated layout, chunks of files with no stripe layout
+# have no OST and are copied in list order.
+rm -rf $DCP_DEST_DIR/stripe_sim
+OUTPUT=`$DCP_MPIRUN_BIN -np 4 $DCP_TEST_BIN --stripe-align --debug dbg -k 512KB $DCP_SRC_DIR/stripe_sim $DCP_DEST_DIR/stripe_sim 2>&1`
+if [[ $? -ne 0 ]]; then
+	echo "$OUTPUT"
+	echo "Failed to run cmd: $DCP_MPIRUN_BIN -np 4 $DCP_TEST_BIN --stripe-align --debug dbg -k 512KB $DCP_SRC_DIR/stripe_sim $DCP_DEST_DIR/stripe_sim"
+	exit 1
+fi
+
+if [[ `stat -f -c %T $DCP_SRC_DIR` != "lustre" ]]; then
+	echo "$OUTPUT" | grep -q "no chunk has a known OST"
+	if [[ $? -ne 0 ]]; then
+		echo "$OUTPUT"
+		echo "Expected no chunk to have a known OST"
+		exit 1
+	fi
+fi
+
+for f in `ls $DCP_SRC_DIR/stripe_sim`; do
+	$DCP_CMP_BIN $DCP_SRC_DIR/stripe_sim/$f $DCP_DEST_DIR/stripe_sim/$f
+	if [[ $? -ne 0 ]]; then
+		echo "CMP mismatch: $DCP_SRC_DIR/stripe_sim/$f $DCP_DEST_DIR/stripe_sim/$f"
+		exit 1
+	fi
+done
+
+rm -rf $DCP_SRC_DIR/stripe_sim
+rm -rf $DCP_DEST_DIR/stripe_sim
+
+exit 0
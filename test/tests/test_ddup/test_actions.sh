@@ -0,0 +1,179 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   A test to check each ddup --action.  A group of identical files is
+#   acted on, then the contents, owner, inode, and link count of every
+#   file are checked.  When run as root, one duplicate is given to
+#   another user, which hardlink must skip and reflink must preserve.
+#
+#   reflink and dedupe-range need a file system that can share extents,
+#   like Btrfs or XFS.  On other file systems, the test checks that ddup
+#   fails and leaves every file as it was.
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+DDUP_TEST_BIN=${DDUP_TEST_BIN:-${1}}
+DDUP_MPIRUN_BIN=${DDUP_MPIRUN_BIN:-${2}}
+DDUP_TEST_DIR=${DDUP_TEST_DIR:-${3}}
+
+echo "Using ddup binary at: $DDUP_TEST_BIN"
+echo "Using mpirun binary at: $DDUP_MPIRUN_BIN"
+echo "Using test directory at: $DDUP_TEST_DIR"
+
+DIR=$DDUP_TEST_DIR/ddup_actions
+LOG=$DDUP_TEST_DIR/ddup_actions.log
+
+# user to give f3 to, only root can change the owner
+OTHER=""
+if [[ $(id -u) -eq 0 ]]; then
+	OTHER=$(id -u nobody 2>/dev/null)
+fi
+
+# f1, f2, and f3 are identical, f1 is kept as the first in sort order
+setup()
+{
+	rm -rf $DIR
+	mkdir -p $DIR
+	dd if=/dev/urandom of=$DIR/f1 bs=64K count=16 2>/dev/null
+	cp $DIR/f1 $DIR/f2
+	cp $DIR/f1 $DIR/f3
+	cp $DIR/f1 $DIR/orig
+	echo "unique" > $DIR/u
+	if [[ -n $OTHER ]]; then
+		chown $OTHER $DIR/f3
+	fi
+
+	# keep the reference copy out of the walk
+	mkdir -p $DDUP_TEST_DIR/ddup_orig
+	mv $DIR/orig $DDUP_TEST_DIR/ddup_orig/f
+
+	INODE1=$(stat -c %i $DIR/f1)
+	INODE2=$(stat -c %i $DIR/f2)
+	INODE3=$(stat -c %i $DIR/f3)
+	OWNER3=$(stat -c %u $DIR/f3)
+}
+
+# run ddup with the given action, expect is 0 if it should succeed
+run_ddup()
+{
+	action=$1
+	expect=$2
+	$DDUP_MPIRUN_BIN -np 2 $DDUP_TEST_BIN --action $action $DIR > $LOG 2>&1
+	rc=$?
+	if [[ $expect -eq 0 && $rc -ne 0 ]] || [[ $expect -ne 0 && $rc -eq 0 ]]; then
+		cat $LOG
+		echo "Unexpected exit code $rc from ddup --action $action"
+		exit 1
+	fi
+}
+
+# check_file <name> <inode> <links> <owner>
+check_file()
+{
+	f=$DIR/$1
+	cmp $DDUP_TEST_DIR/ddup_orig/f $f
+	if [[ $? -ne 0 ]]; then
+		echo "Contents of $f changed"
+		exit 1
+	fi
+	if [[ $(stat -c %i $f) -ne $2 ]]; then
+		echo "Expected $f to have inode $2, it has $(stat -c %i $f)"
+		exit 1
+	fi
+	if [[ $(stat -c %h $f) -ne $3 ]]; then
+		echo "Expected $f to have $3 links, it has $(stat -c %h $f)"
+		exit 1
+	fi
+	if [[ $(stat -c %u $f) -ne $4 ]]; then
+		echo "Expected $f to be owned by $4, it is owned by $(stat -c %u $f)"
+		exit 1
+	fi
+}
+
+# check that no temporary files were left behind
+check_clean()
+{
+	if ls $DIR | grep -q "\.ddup\."; then
+		ls -l $DIR
+		echo "ddup left temporary files in $DIR"
+		exit 1
+	fi
+}
+
+ME=$(id -u)
+
+# does this file system share extents between files
+setup
+SHARE=0
+cp --reflink=always $DIR/f1 $DDUP_TEST_DIR/ddup_orig/probe 2>/dev/null && SHARE=1
+rm -f $DDUP_TEST_DIR/ddup_orig/probe
+echo "File system shares extents: $SHARE"
+
+# hardlink: f2 becomes a link to f1, f3 is skipped if it has another owner
+if [[ -n $OTHER ]]; then
+	run_ddup hardlink 1
+	check_file f1 $INODE1 2 $ME
+	check_file f2 $INODE1 2 $ME
+	check_file f3 $INODE3 1 $OTHER
+else
+	run_ddup hardlink 0
+	check_file f1 $INODE1 3 $ME
+	check_file f2 $INODE1 3 $ME
+	check_file f3 $INODE1 3 $ME
+fi
+check_clean
+
+# reflink: each duplicate is a new file with the owner of the old one
+setup
+if [[ $SHARE -eq 1 ]]; then
+	run_ddup reflink 0
+	check_file f1 $INODE1 1 $ME
+	check_file f2 $(stat -c %i $DIR/f2) 1 $ME
+	check_file f3 $(stat -c %i $DIR/f3) 1 $OWNER3
+	if [[ $(stat -c %i $DIR/f2) -eq $INODE2 ]]; then
+		echo "Expected reflink to replace $DIR/f2"
+		exit 1
+	fi
+else
+	run_ddup reflink 1
+	check_file f1 $INODE1 1 $ME
+	check_file f2 $INODE2 1 $ME
+	check_file f3 $INODE3 1 $OWNER3
+fi
+check_clean
+
+# dedupe-range: files keep their inodes, and a second run reclaims
+# nothing because the extents are already shared
+setup
+if [[ $SHARE -eq 1 ]]; then
+	run_ddup dedupe-range 0
+	grep -q "Replaced 2 duplicates" $LOG
+	if [[ $? -ne 0 ]]; then
+		cat $LOG
+		echo "Expected dedupe-range to share both duplicates"
+		exit 1
+	fi
+	run_ddup dedupe-range 0
+	grep -q "reclaimed 0.000 B" $LOG
+	if [[ $? -ne 0 ]]; then
+		cat $LOG
+		echo "Expected a second dedupe-range to reclaim nothing"
+		exit 1
+	fi
+else
+	run_ddup dedupe-range 1
+fi
+check_file f1 $INODE1 1 $ME
+check_file f2 $INODE2 1 $ME
+check_file f3 $INODE3 1 $OWNER3
+check_clean
+
+rm -rf $DIR $DDUP_TEST_DIR/ddup_orig
+rm -f $LOG
+
+exit 0
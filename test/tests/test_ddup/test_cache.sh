@@ -0,0 +1,97 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   A test to check that ddup --cache reuses the digests it recorded for
+#   files that have not changed, and hashes a file again once it changes,
+#   even if its size and mtime stay the same.
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+DDUP_TEST_BIN=${DDUP_TEST_BIN:-${1}}
+DDUP_MPIRUN_BIN=${DDUP_MPIRUN_BIN:-${2}}
+DDUP_TEST_DIR=${DDUP_TEST_DIR:-${3}}
+
+echo "Using ddup binary at: $DDUP_TEST_BIN"
+echo "Using mpirun binary at: $DDUP_MPIRUN_BIN"
+echo "Using test directory at: $DDUP_TEST_DIR"
+
+DIR=$DDUP_TEST_DIR/ddup_cache
+CACHE=$DDUP_TEST_DIR/ddup_cache.cache
+LOG=$DDUP_TEST_DIR/ddup_cache.log
+
+# run ddup with the cache, check that it found cached digests for
+# the given number of files, and keep the duplicates it reported
+run_ddup()
+{
+	found=$1
+	out=$2
+	$DDUP_MPIRUN_BIN -np 3 $DDUP_TEST_BIN --cache $CACHE $DIR > $LOG 2>&1
+	if [[ $? -ne 0 ]]; then
+		cat $LOG
+		echo "Failed to run cmd: $DDUP_MPIRUN_BIN -np 3 $DDUP_TEST_BIN --cache $CACHE $DIR"
+		exit 1
+	fi
+	grep -q "Found cached digests for $found of 6 candidate files" $LOG
+	if [[ $? -ne 0 ]]; then
+		cat $LOG
+		echo "Expected ddup to find cached digests for $found files"
+		exit 1
+	fi
+	grep "^$DIR/" $LOG | sort > $out
+}
+
+rm -rf $DIR
+rm -f $CACHE $LOG
+mkdir -p $DIR
+
+# six files of the same size, g1 and g2 are copies of f1 and f2
+for i in 1 2 3 4; do
+	dd if=/dev/urandom of=$DIR/f$i bs=64K count=2 2>/dev/null
+done
+cp -p $DIR/f1 $DIR/g1
+cp -p $DIR/f2 $DIR/g2
+
+# the first run hashes everything, the second reuses every digest
+# and must report the same duplicates
+run_ddup 0 $LOG.1
+if [[ ! -f $CACHE ]]; then
+	echo "Digest cache was not written: $CACHE"
+	exit 1
+fi
+run_ddup 6 $LOG.2
+diff $LOG.1 $LOG.2
+if [[ $? -ne 0 ]]; then
+	echo "Duplicates differ when digests come from the cache"
+	exit 1
+fi
+if [[ $(wc -l < $LOG.2) -ne 4 ]]; then
+	cat $LOG.2
+	echo "Expected 4 duplicate files"
+	exit 1
+fi
+
+# change a byte of g1 but keep its size and mtime, only its ctime
+# changes, so it is hashed again and is no longer a duplicate of f1
+printf X | dd of=$DIR/g1 bs=1 seek=1000 conv=notrunc 2>/dev/null
+touch -r $DIR/f1 $DIR/g1
+run_ddup 5 $LOG.3
+if grep -q "^$DIR/g1 \|^$DIR/f1 " $LOG.3; then
+	cat $LOG.3
+	echo "Changed file was still reported as a duplicate"
+	exit 1
+fi
+if [[ $(wc -l < $LOG.3) -ne 2 ]]; then
+	cat $LOG.3
+	echo "Expected 2 duplicate files"
+	exit 1
+fi
+
+rm -rf $DIR
+rm -f $CACHE $LOG $LOG.1 $LOG.2 $LOG.3
+
+exit 0
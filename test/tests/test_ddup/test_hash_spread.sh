@@ -0,0 +1,88 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   A test to check that ddup hashes each candidate file end to end on a
+#   single process, that the files are spread over all processes, and that
+#   it reports the SHA256 of each whole duplicate file, the same on any
+#   number of processes.  Files that match in size and in their first and
+#   last blocks, but differ in between, must be hashed and not reported.
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+DDUP_TEST_BIN=${DDUP_TEST_BIN:-${1}}
+DDUP_MPIRUN_BIN=${DDUP_MPIRUN_BIN:-${2}}
+DDUP_TEST_DIR=${DDUP_TEST_DIR:-${3}}
+
+echo "Using ddup binary at: $DDUP_TEST_BIN"
+echo "Using mpirun binary at: $DDUP_MPIRUN_BIN"
+echo "Using test directory at: $DDUP_TEST_DIR"
+
+DIR=$DDUP_TEST_DIR/ddup_spread
+LOG=$DDUP_TEST_DIR/ddup_spread.log
+BLOCK=$DDUP_TEST_DIR/ddup_spread.block
+
+rm -rf $DIR
+rm -f $LOG $LOG.* $BLOCK
+mkdir -p $DIR
+
+# Files f$i and g$i are copies, and h$i has the size and the first and
+# last 1MB blocks of f$i, but one byte in between differs.
+head -c 1048576 /dev/urandom > $BLOCK
+for i in 1 2 3 4 5 6; do
+	(cat $BLOCK; head -c $((i * 300000)) /dev/urandom; cat $BLOCK) > $DIR/f$i
+	cp $DIR/f$i $DIR/g$i
+	cp $DIR/f$i $DIR/h$i
+	printf X | dd of=$DIR/h$i bs=1 seek=$((1048576 + i * 1000)) conv=notrunc 2>/dev/null
+done
+rm -f $BLOCK
+
+# the expected report, each copy with the SHA256 of the whole file
+for i in 1 2 3 4 5 6; do
+	for f in f$i g$i; do
+		echo "$DIR/$f `sha256sum $DIR/$f | cut -d' ' -f1`"
+	done
+done | sort > $LOG.expected
+
+for np in 1 3 4; do
+	$DDUP_MPIRUN_BIN -np $np $DDUP_TEST_BIN -d dbg $DIR > $LOG 2>&1
+	if [[ $? -ne 0 ]]; then
+		cat $LOG
+		echo "Failed to run cmd: $DDUP_MPIRUN_BIN -np $np $DDUP_TEST_BIN -d dbg $DIR"
+		exit 1
+	fi
+
+	# every file passes the probe and is hashed once, by one process
+	for f in `ls $DIR`; do
+		count=`grep -c "hashing file \"$DIR/$f\"" $LOG`
+		if [[ $count -ne 1 ]]; then
+			cat $LOG
+			echo "Expected $DIR/$f to be hashed once on $np processes, found $count"
+			exit 1
+		fi
+	done
+
+	# the files are spread over all processes
+	ranks=`grep "hashing file" $LOG | sed 's/^\[[^]]*\] \[\([0-9]*\)\].*/\1/' | sort -u | wc -l`
+	if [[ $ranks -ne $np ]]; then
+		cat $LOG
+		echo "Expected files to be hashed on $np processes, found $ranks"
+		exit 1
+	fi
+
+	grep "^$DIR/" $LOG | sort > $LOG.$np
+	diff $LOG.expected $LOG.$np
+	if [[ $? -ne 0 ]]; then
+		echo "Unexpected duplicates or digests on $np processes"
+		exit 1
+	fi
+done
+
+rm -rf $DIR
+rm -f $LOG $LOG.*
+
+exit 0
@@ -0,0 +1,90 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   A test to check that dsync --changes brings the paths named in a change
+#   log up to date, including new and removed directories, and leaves paths
+#   that are not named alone.
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+DSYNC_TEST_BIN=${DSYNC_TEST_BIN:-${1}}
+DSYNC_MPIRUN_BIN=${DSYNC_MPIRUN_BIN:-${2}}
+DSYNC_CMP_BIN=${DSYNC_CMP_BIN:-${3}}
+DSYNC_SRC_DIR=${DSYNC_SRC_DIR:-${4}}
+DSYNC_DEST_DIR=${DSYNC_DEST_DIR:-${5}}
+
+echo "Using dsync binary at: $DSYNC_TEST_BIN"
+echo "Using mpirun binary at: $DSYNC_MPIRUN_BIN"
+echo "Using cmp binary at: $DSYNC_CMP_BIN"
+echo "Using src directory at: $DSYNC_SRC_DIR"
+echo "Using dest directory at: $DSYNC_DEST_DIR"
+
+DSYNC_LOG=$DSYNC_DEST_DIR/changes.log
+
+rm -rf $DSYNC_SRC_DIR/changes
+rm -rf $DSYNC_DEST_DIR/changes
+mkdir -p $DSYNC_SRC_DIR/changes/a/old $DSYNC_SRC_DIR/changes/b
+
+for i in 1 2 3; do
+	echo "a$i" > $DSYNC_SRC_DIR/changes/a/f$i
+	echo "old$i" > $DSYNC_SRC_DIR/changes/a/old/f$i
+	echo "b$i" > $DSYNC_SRC_DIR/changes/b/f$i
+done
+cp -a $DSYNC_SRC_DIR/changes $DSYNC_DEST_DIR/changes
+
+# Modify, remove, and add files and directories in the source, but
+# leave one modified file out of the change log.
+echo "modified" > $DSYNC_SRC_DIR/changes/a/f1
+rm $DSYNC_SRC_DIR/changes/a/f2
+rm -rf $DSYNC_SRC_DIR/changes/a/old
+mkdir -p $DSYNC_SRC_DIR/changes/new/deep
+echo "new" > $DSYNC_SRC_DIR/changes/new/deep/f1
+echo "unlisted" > $DSYNC_SRC_DIR/changes/b/f1
+
+cat > $DSYNC_LOG <<EOT
+# events from a change log consumer
+MODIFY a/f1
+DELETE $DSYNC_SRC_DIR/changes/a/f2
+RMDIR a/old
+MKDIR new
+EOT
+
+$DSYNC_MPIRUN_BIN -np 3 $DSYNC_TEST_BIN --changes $DSYNC_LOG --delete \
+	$DSYNC_SRC_DIR/changes $DSYNC_DEST_DIR/changes
+if [[ $? -ne 0 ]]; then
+	echo "Failed to run cmd: $DSYNC_MPIRUN_BIN -np 3 $DSYNC_TEST_BIN --changes $DSYNC_LOG --delete $DSYNC_SRC_DIR/changes $DSYNC_DEST_DIR/changes"
+	exit 1
+fi
+
+for f in a/f1 a/f3 new/deep/f1; do
+	$DSYNC_CMP_BIN $DSYNC_SRC_DIR/changes/$f $DSYNC_DEST_DIR/changes/$f
+	if [[ $? -ne 0 ]]; then
+		echo "CMP mismatch: $DSYNC_SRC_DIR/changes/$f $DSYNC_DEST_DIR/changes/$f"
+		exit 1
+	fi
+done
+
+for f in a/f2 a/old; do
+	if [[ -e $DSYNC_DEST_DIR/changes/$f ]]; then
+		echo "Removed path still exists: $DSYNC_DEST_DIR/changes/$f"
+		exit 1
+	fi
+done
+
+# The unlisted change must not have been synced.
+$DSYNC_CMP_BIN -s $DSYNC_SRC_DIR/changes/b/f1 $DSYNC_DEST_DIR/changes/b/f1
+if [[ $? -eq 0 ]]; then
+	echo "Path not named in change log was synced: $DSYNC_DEST_DIR/changes/b/f1"
+	exit 1
+fi
+
+rm -rf $DSYNC_SRC_DIR/changes
+rm -rf $DSYNC_DEST_DIR/changes
+rm -f $DSYNC_LOG
+
+exit 0
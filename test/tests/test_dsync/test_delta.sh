@@ -0,0 +1,81 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   A test to check that dsync --contents --delta brings a destination file
+#   up to date when only scattered blocks of it differ from the source,
+#   without changing its size or other files.
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+DSYNC_TEST_BIN=${DSYNC_TEST_BIN:-${1}}
+DSYNC_MPIRUN_BIN=${DSYNC_MPIRUN_BIN:-${2}}
+DSYNC_CMP_BIN=${DSYNC_CMP_BIN:-${3}}
+DSYNC_SRC_DIR=${DSYNC_SRC_DIR:-${4}}
+DSYNC_DEST_DIR=${DSYNC_DEST_DIR:-${5}}
+
+echo "Using dsync binary at: $DSYNC_TEST_BIN"
+echo "Using mpirun binary at: $DSYNC_MPIRUN_BIN"
+echo "Using cmp binary at: $DSYNC_CMP_BIN"
+echo "Using src directory at: $DSYNC_SRC_DIR"
+echo "Using dest directory at: $DSYNC_DEST_DIR"
+
+rm -rf $DSYNC_SRC_DIR/delta
+rm -rf $DSYNC_DEST_DIR/delta
+mkdir -p $DSYNC_SRC_DIR/delta
+
+# Create a file spanning several chunks and a small one, copy them,
+# then change a few bytes, a run of blocks across a buffer boundary,
+# and the tail of the destination copies.
+dd if=/dev/urandom of=$DSYNC_SRC_DIR/delta/big bs=1M count=70 2>/dev/null
+echo "tail" >> $DSYNC_SRC_DIR/delta/big
+echo "small file" > $DSYNC_SRC_DIR/delta/small
+cp -a $DSYNC_SRC_DIR/delta $DSYNC_DEST_DIR/delta
+
+for off in 0 5000 4190000 67108860; do
+	printf XXXX | dd of=$DSYNC_DEST_DIR/delta/big bs=1 seek=$off \
+		conv=notrunc 2>/dev/null
+done
+dd if=/dev/urandom of=$DSYNC_DEST_DIR/delta/big bs=1K seek=4000 count=300 \
+	conv=notrunc 2>/dev/null
+printf "TAIL" | dd of=$DSYNC_DEST_DIR/delta/big bs=1 seek=73400320 \
+	conv=notrunc 2>/dev/null
+echo "SMALL FILE" > $DSYNC_DEST_DIR/delta/small
+
+$DSYNC_MPIRUN_BIN -np 3 $DSYNC_TEST_BIN --contents --delta $DSYNC_SRC_DIR/delta $DSYNC_DEST_DIR/delta \
+	> $DSYNC_DEST_DIR/delta.log 2>&1
+if [[ $? -ne 0 ]]; then
+	cat $DSYNC_DEST_DIR/delta.log
+	echo "Failed to run cmd: $DSYNC_MPIRUN_BIN -np 3 $DSYNC_TEST_BIN --contents --delta $DSYNC_SRC_DIR/delta $DSYNC_DEST_DIR/delta"
+	exit 1
+fi
+
+# Of the 4KB blocks, big has 2 changed at the start, 75 in the run,
+# 1 before the 64MB chunk boundary, and its partial last block, and
+# small has 1.  The first two and the run are each rewritten in one
+# write.  Copying both files in 1MB buffers takes 64 + 7 + 1 writes.
+grep -q "Delta rewrote 80 blocks in 5 writes, a full rewrite would issue 72 writes" \
+	$DSYNC_DEST_DIR/delta.log
+if [[ $? -ne 0 ]]; then
+	cat $DSYNC_DEST_DIR/delta.log
+	echo "Unexpected delta write counts"
+	exit 1
+fi
+rm -f $DSYNC_DEST_DIR/delta.log
+
+for f in big small; do
+	$DSYNC_CMP_BIN $DSYNC_SRC_DIR/delta/$f $DSYNC_DEST_DIR/delta/$f
+	if [[ $? -ne 0 ]]; then
+		echo "CMP mismatch: $DSYNC_SRC_DIR/delta/$f $DSYNC_DEST_DIR/delta/$f"
+		exit 1
+	fi
+done
+
+rm -rf $DSYNC_SRC_DIR/delta
+rm -rf $DSYNC_DEST_DIR/delta
+
+exit 0
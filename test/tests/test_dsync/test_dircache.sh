@@ -0,0 +1,101 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   A test to check that dsync --dir-cache still finds files added to
+#   changed directories when it skips unchanged ones, and that a forced
+#   full walk finds changes to files in unchanged directories.
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+DSYNC_TEST_BIN=${DSYNC_TEST_BIN:-${1}}
+DSYNC_MPIRUN_BIN=${DSYNC_MPIRUN_BIN:-${2}}
+DSYNC_CMP_BIN=${DSYNC_CMP_BIN:-${3}}
+DSYNC_SRC_DIR=${DSYNC_SRC_DIR:-${4}}
+DSYNC_DEST_DIR=${DSYNC_DEST_DIR:-${5}}
+
+echo "Using dsync binary at: $DSYNC_TEST_BIN"
+echo "Using mpirun binary at: $DSYNC_MPIRUN_BIN"
+echo "Using cmp binary at: $DSYNC_CMP_BIN"
+echo "Using src directory at: $DSYNC_SRC_DIR"
+echo "Using dest directory at: $DSYNC_DEST_DIR"
+
+DSYNC_CACHE=$DSYNC_DEST_DIR/dircache.cache
+
+rm -rf $DSYNC_SRC_DIR/dircache
+rm -rf $DSYNC_DEST_DIR/dircache
+rm -f $DSYNC_CACHE
+mkdir -p $DSYNC_SRC_DIR/dircache/a/b $DSYNC_SRC_DIR/dircache/c
+
+for i in 1 2 3; do
+	echo "a$i" > $DSYNC_SRC_DIR/dircache/a/f$i
+	echo "b$i" > $DSYNC_SRC_DIR/dircache/a/b/f$i
+	echo "c$i" > $DSYNC_SRC_DIR/dircache/c/f$i
+done
+
+run_dsync()
+{
+	$DSYNC_MPIRUN_BIN -np 3 $DSYNC_TEST_BIN --dir-cache $DSYNC_CACHE "$@" \
+		$DSYNC_SRC_DIR/dircache $DSYNC_DEST_DIR/dircache
+	if [[ $? -ne 0 ]]; then
+		echo "Failed to run cmd: $DSYNC_MPIRUN_BIN -np 3 $DSYNC_TEST_BIN --dir-cache $DSYNC_CACHE $@ $DSYNC_SRC_DIR/dircache $DSYNC_DEST_DIR/dircache"
+		exit 1
+	fi
+}
+
+check_file()
+{
+	$DSYNC_CMP_BIN $DSYNC_SRC_DIR/dircache/$1 $DSYNC_DEST_DIR/dircache/$1
+	if [[ $? -ne 0 ]]; then
+		echo "CMP mismatch: $DSYNC_SRC_DIR/dircache/$1 $DSYNC_DEST_DIR/dircache/$1"
+		exit 1
+	fi
+}
+
+# The first run walks everything and records the directories.
+run_dsync
+if [[ ! -f $DSYNC_CACHE ]]; then
+	echo "Directory cache was not written: $DSYNC_CACHE"
+	exit 1
+fi
+
+# Add a file to one directory and rewrite a file in another, the new
+# file must be found, while the rewritten one is left for a full walk.
+# Sleep so the new entry changes the directory mtime.
+sleep 1
+echo "new" > $DSYNC_SRC_DIR/dircache/a/b/new
+echo "changed" > $DSYNC_SRC_DIR/dircache/c/f1
+run_dsync
+check_file a/b/new
+
+# The cache skipped the unchanged directory, so the rewritten file
+# must still differ.
+$DSYNC_CMP_BIN -s $DSYNC_SRC_DIR/dircache/c/f1 $DSYNC_DEST_DIR/dircache/c/f1
+if [[ $? -eq 0 ]]; then
+	echo "Unchanged directory was walked: $DSYNC_SRC_DIR/dircache/c"
+	exit 1
+fi
+
+# A count of 0 and counts that are not plain numbers are rejected.
+for count in 0 10K 5x -1; do
+	$DSYNC_MPIRUN_BIN -np 3 $DSYNC_TEST_BIN --dir-cache $DSYNC_CACHE --dir-cache-full $count \
+		$DSYNC_SRC_DIR/dircache $DSYNC_DEST_DIR/dircache > /dev/null 2>&1
+	if [[ $? -eq 0 ]]; then
+		echo "dsync accepted --dir-cache-full $count"
+		exit 1
+	fi
+done
+
+# A full walk on every run finds the rewritten file.
+run_dsync --dir-cache-full 1
+check_file c/f1
+
+rm -rf $DSYNC_SRC_DIR/dircache
+rm -rf $DSYNC_DEST_DIR/dircache
+rm -f $DSYNC_CACHE
+
+exit 0
@@ -0,0 +1,106 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   A test to check that dsync --contents --hash-store reuses the digests
+#   it stored for files that have not changed, reads files that changed,
+#   and still finds and fixes a change that keeps size and mtime.
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+DSYNC_TEST_BIN=${DSYNC_TEST_BIN:-${1}}
+DSYNC_MPIRUN_BIN=${DSYNC_MPIRUN_BIN:-${2}}
+DSYNC_CMP_BIN=${DSYNC_CMP_BIN:-${3}}
+DSYNC_SRC_DIR=${DSYNC_SRC_DIR:-${4}}
+DSYNC_DEST_DIR=${DSYNC_DEST_DIR:-${5}}
+
+echo "Using dsync binary at: $DSYNC_TEST_BIN"
+echo "Using mpirun binary at: $DSYNC_MPIRUN_BIN"
+echo "Using cmp binary at: $DSYNC_CMP_BIN"
+echo "Using src directory at: $DSYNC_SRC_DIR"
+echo "Using dest directory at: $DSYNC_DEST_DIR"
+
+STORE=$DSYNC_DEST_DIR/hashstore.store
+LOG=$DSYNC_DEST_DIR/hashstore.log
+
+# run dsync with the hash store and check the number of bytes it read
+run_dsync()
+{
+	bytes=$1
+	shift
+	$DSYNC_MPIRUN_BIN -np 3 $DSYNC_TEST_BIN --contents "$@" \
+		$DSYNC_SRC_DIR/hashstore $DSYNC_DEST_DIR/hashstore > $LOG 2>&1
+	if [[ $? -ne 0 ]]; then
+		cat $LOG
+		echo "Failed to run cmd: $DSYNC_MPIRUN_BIN -np 3 $DSYNC_TEST_BIN --contents $@ $DSYNC_SRC_DIR/hashstore $DSYNC_DEST_DIR/hashstore"
+		exit 1
+	fi
+	if [[ -n $bytes ]]; then
+		grep -q "Bytes read *: .* ($bytes bytes)" $LOG
+		if [[ $? -ne 0 ]]; then
+			cat $LOG
+			echo "Expected dsync to read $bytes bytes"
+			exit 1
+		fi
+	fi
+}
+
+check_same()
+{
+	for i in 1 2 3 4; do
+		$DSYNC_CMP_BIN $DSYNC_SRC_DIR/hashstore/f$i $DSYNC_DEST_DIR/hashstore/f$i
+		if [[ $? -ne 0 ]]; then
+			echo "CMP mismatch: $DSYNC_SRC_DIR/hashstore/f$i $DSYNC_DEST_DIR/hashstore/f$i"
+			exit 1
+		fi
+	done
+}
+
+rm -rf $DSYNC_SRC_DIR/hashstore
+rm -rf $DSYNC_DEST_DIR/hashstore
+rm -f $STORE $LOG
+mkdir -p $DSYNC_SRC_DIR/hashstore
+
+for i in 1 2 3 4; do
+	dd if=/dev/urandom of=$DSYNC_SRC_DIR/hashstore/f$i bs=1M count=$i 2>/dev/null
+done
+cp -a $DSYNC_SRC_DIR/hashstore $DSYNC_DEST_DIR/hashstore
+
+# Settle the metadata of the destination, a sync that changes it
+# also changes the ctime recorded in the store.
+run_dsync ""
+
+# The first run with the store reads all 10MB of both trees, the
+# second finds digests for every file and reads nothing.
+run_dsync 20971520 --hash-store $STORE
+if [[ ! -f $STORE ]]; then
+	echo "Hash store was not written: $STORE"
+	exit 1
+fi
+run_dsync 0 --hash-store $STORE
+
+# Change a byte of f3 in the destination without changing its size
+# or mtime, only that file has a new ctime and is hashed again, and
+# then the differing pair is compared block by block to fix it.
+printf X | dd of=$DSYNC_DEST_DIR/hashstore/f3 bs=1 seek=1500000 \
+	conv=notrunc 2>/dev/null
+touch -r $DSYNC_SRC_DIR/hashstore/f3 $DSYNC_DEST_DIR/hashstore/f3
+run_dsync "" --hash-store $STORE
+check_same
+
+grep -q "Read block hashes for 7 of 8 files" $LOG
+if [[ $? -ne 0 ]]; then
+	cat $LOG
+	echo "Expected digests of all files but the changed one to be reused"
+	exit 1
+fi
+
+rm -rf $DSYNC_SRC_DIR/hashstore
+rm -rf $DSYNC_DEST_DIR/hashstore
+rm -f $STORE $LOG
+
+exit 0
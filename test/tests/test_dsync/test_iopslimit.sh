@@ -0,0 +1,80 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   A test to check that dsync --iopslimit holds the rate of metadata
+#   operations of all processes to the limit, and that it rejects counts
+#   that are not plain positive numbers.
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+DSYNC_TEST_BIN=${DSYNC_TEST_BIN:-${1}}
+DSYNC_MPIRUN_BIN=${DSYNC_MPIRUN_BIN:-${2}}
+DSYNC_CMP_BIN=${DSYNC_CMP_BIN:-${3}}
+DSYNC_SRC_DIR=${DSYNC_SRC_DIR:-${4}}
+DSYNC_DEST_DIR=${DSYNC_DEST_DIR:-${5}}
+
+echo "Using dsync binary at: $DSYNC_TEST_BIN"
+echo "Using mpirun binary at: $DSYNC_MPIRUN_BIN"
+echo "Using cmp binary at: $DSYNC_CMP_BIN"
+echo "Using src directory at: $DSYNC_SRC_DIR"
+echo "Using dest directory at: $DSYNC_DEST_DIR"
+
+# number of empty files to create, and operations per second to allow,
+# creating them takes at least FILES / LIMIT seconds
+FILES=60
+LIMIT=20
+
+rm -rf $DSYNC_SRC_DIR/iopslimit
+rm -rf $DSYNC_DEST_DIR/iopslimit
+mkdir -p $DSYNC_SRC_DIR/iopslimit
+
+for i in $(seq 1 $FILES); do
+	touch $DSYNC_SRC_DIR/iopslimit/f$i
+done
+
+# Counts that are not plain positive numbers are rejected.
+for count in 0 -5 abc 10K 1.5; do
+	$DSYNC_MPIRUN_BIN -np 3 $DSYNC_TEST_BIN --iopslimit $count \
+		$DSYNC_SRC_DIR/iopslimit $DSYNC_DEST_DIR/iopslimit > /dev/null 2>&1
+	if [[ $? -eq 0 ]]; then
+		echo "dsync accepted --iopslimit $count"
+		exit 1
+	fi
+done
+if [[ -d $DSYNC_DEST_DIR/iopslimit ]]; then
+	echo "dsync copied with a rejected --iopslimit"
+	exit 1
+fi
+
+start=$(date +%s.%N)
+$DSYNC_MPIRUN_BIN -np 3 $DSYNC_TEST_BIN --iopslimit $LIMIT \
+	$DSYNC_SRC_DIR/iopslimit $DSYNC_DEST_DIR/iopslimit
+if [[ $? -ne 0 ]]; then
+	echo "Failed to run cmd: $DSYNC_MPIRUN_BIN -np 3 $DSYNC_TEST_BIN --iopslimit $LIMIT $DSYNC_SRC_DIR/iopslimit $DSYNC_DEST_DIR/iopslimit"
+	exit 1
+fi
+end=$(date +%s.%N)
+
+for i in $(seq 1 $FILES); do
+	if [[ ! -f $DSYNC_DEST_DIR/iopslimit/f$i ]]; then
+		echo "File was not copied: $DSYNC_DEST_DIR/iopslimit/f$i"
+		exit 1
+	fi
+done
+
+# Allow some slack for the burst each process may save up.
+awk -v s=$start -v e=$end -v n=$FILES -v l=$LIMIT 'BEGIN { exit !(e - s >= 0.8 * n / l) }'
+if [[ $? -ne 0 ]]; then
+	echo "Created $FILES files in $(awk -v s=$start -v e=$end 'BEGIN { print e - s }') seconds, faster than $LIMIT per second"
+	exit 1
+fi
+
+rm -rf $DSYNC_SRC_DIR/iopslimit
+rm -rf $DSYNC_DEST_DIR/iopslimit
+
+exit 0
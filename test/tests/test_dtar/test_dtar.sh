@@ -0,0 +1,104 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   A test to check that dtar creates archives that tar can read and that
+#   it extracts them in parallel, using the index or by scanning the
+#   archive.  See test_dtar_index.sh for listing, patterns, and checks of
+#   the index itself, and test_dtar_bzip2.sh for compressed archives.
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+DTAR_TEST_BIN=${DTAR_TEST_BIN:-${1}}
+DTAR_MPIRUN_BIN=${DTAR_MPIRUN_BIN:-${2}}
+DTAR_TAR_BIN=${DTAR_TAR_BIN:-${3}}
+DTAR_SRC_DIR=${DTAR_SRC_DIR:-${4}}
+DTAR_DEST_DIR=${DTAR_DEST_DIR:-${5}}
+
+echo "Using dtar binary at: $DTAR_TEST_BIN"
+echo "Using mpirun binary at: $DTAR_MPIRUN_BIN"
+echo "Using tar binary at: $DTAR_TAR_BIN"
+echo "Using src directory at: $DTAR_SRC_DIR"
+echo "Using dest directory at: $DTAR_DEST_DIR"
+
+# dtar stores absolute paths without the leading slash
+SRC=$DTAR_SRC_DIR/dtar
+REL=${SRC#/}
+ARCHIVE=$DTAR_DEST_DIR/dtar.tar
+OUT=$DTAR_DEST_DIR/dtar_out
+
+cleanup()
+{
+	rm -rf $SRC $OUT
+	rm -f $ARCHIVE $ARCHIVE.idx
+}
+
+run_dtar()
+{
+	$DTAR_MPIRUN_BIN -np 3 $DTAR_TEST_BIN "$@"
+	if [[ $? -ne 0 ]]; then
+		echo "Failed to run cmd: $DTAR_MPIRUN_BIN -np 3 $DTAR_TEST_BIN $@"
+		exit 1
+	fi
+}
+
+# compare the source tree with the copy extracted under $OUT
+check_tree()
+{
+	diff -r $SRC $OUT/$REL
+	if [[ $? -ne 0 ]]; then
+		echo "Extracted tree differs: $SRC $OUT/$REL ($1)"
+		exit 1
+	fi
+}
+
+# extract the archive with dtar into an empty $OUT
+extract()
+{
+	rm -rf $OUT
+	mkdir -p $OUT
+	(cd $OUT && run_dtar -x -f $ARCHIVE "$@")
+}
+
+cleanup
+mkdir -p $DTAR_DEST_DIR
+mkdir -p $SRC/a/b/c $SRC/d/e $SRC/empty
+for i in 1 2 3 4 5; do
+	echo "file $i" > $SRC/a/f$i
+	head -c $((i * 1000)) /dev/urandom > $SRC/a/b/f$i
+	head -c $((i * 512)) /dev/urandom > $SRC/d/e/f$i
+done
+: > $SRC/a/b/c/zero
+head -c 3000000 /dev/urandom > $SRC/d/big
+ln -s ../a/f1 $SRC/d/link
+mkdir -p $SRC/long_name_xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx
+echo "long" > $SRC/long_name_xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx/f
+
+run_dtar -c -f $ARCHIVE $SRC
+
+# tar reads the archive
+rm -rf $OUT
+mkdir -p $OUT
+(cd $OUT && $DTAR_TAR_BIN -xf $ARCHIVE)
+if [[ $? -ne 0 ]]; then
+	echo "Failed to extract $ARCHIVE with $DTAR_TAR_BIN"
+	exit 1
+fi
+check_tree "tar"
+
+# extract in parallel using the index
+extract
+check_tree "index"
+
+# extract by scanning the archive
+rm -f $ARCHIVE.idx
+extract
+check_tree "scan"
+
+cleanup
+
+exit 0
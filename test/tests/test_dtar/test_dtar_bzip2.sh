@@ -0,0 +1,145 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   A test to check that dtar -j writes a bzip2 archive of many members
+#   that tar can read, that dtar lists and extracts it in parallel using
+#   the index or by scanning the archive, and that dtar rejects a zero or
+#   malformed --memory, --chunksize, or --blocksize.
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+DTAR_TEST_BIN=${DTAR_TEST_BIN:-${1}}
+DTAR_MPIRUN_BIN=${DTAR_MPIRUN_BIN:-${2}}
+DTAR_TAR_BIN=${DTAR_TAR_BIN:-${3}}
+DTAR_SRC_DIR=${DTAR_SRC_DIR:-${4}}
+DTAR_DEST_DIR=${DTAR_DEST_DIR:-${5}}
+
+echo "Using dtar binary at: $DTAR_TEST_BIN"
+echo "Using mpirun binary at: $DTAR_MPIRUN_BIN"
+echo "Using tar binary at: $DTAR_TAR_BIN"
+echo "Using src directory at: $DTAR_SRC_DIR"
+echo "Using dest directory at: $DTAR_DEST_DIR"
+
+# dtar stores absolute paths without the leading slash
+SRC=$DTAR_SRC_DIR/dtar_bzip2
+REL=${SRC#/}
+ARCHIVE=$DTAR_DEST_DIR/dtar_bzip2.tar.bz2
+OUT=$DTAR_DEST_DIR/dtar_bzip2_out
+LOG=$DTAR_DEST_DIR/dtar_bzip2.log
+
+cleanup()
+{
+	rm -rf $SRC $OUT
+	rm -f $ARCHIVE $ARCHIVE.idx $LOG
+}
+
+run_dtar()
+{
+	$DTAR_MPIRUN_BIN -np 3 $DTAR_TEST_BIN "$@" > $LOG 2>&1
+	if [[ $? -ne 0 ]]; then
+		cat $LOG
+		echo "Failed to run cmd: $DTAR_MPIRUN_BIN -np 3 $DTAR_TEST_BIN $@"
+		exit 1
+	fi
+}
+
+# compare the source tree with the copy extracted under $OUT
+check_tree()
+{
+	diff -r $SRC $OUT/$REL
+	if [[ $? -ne 0 ]]; then
+		echo "Extracted tree differs: $SRC $OUT/$REL ($1)"
+		exit 1
+	fi
+}
+
+# extract the archive with dtar into an empty $OUT
+extract()
+{
+	rm -rf $OUT
+	mkdir -p $OUT
+	(cd $OUT && run_dtar -x -v -f $ARCHIVE "$@")
+}
+
+# dtar must refuse the option value with an error and write no archive
+check_reject()
+{
+	rm -f $ARCHIVE $ARCHIVE.idx
+	$DTAR_MPIRUN_BIN -np 1 $DTAR_TEST_BIN -c -j "$@" -f $ARCHIVE $SRC > $LOG 2>&1
+	grep -q "Failed to parse" $LOG
+	if [[ $? -ne 0 || -e $ARCHIVE ]]; then
+		cat $LOG
+		echo "Expected dtar to reject options: $@"
+		exit 1
+	fi
+}
+
+cleanup
+mkdir -p $DTAR_DEST_DIR
+mkdir -p $SRC/a/b $SRC/empty
+for i in 1 2 3 4 5; do
+	echo "file $i" > $SRC/a/f$i
+	head -c $((i * 1000)) /dev/urandom > $SRC/a/b/f$i
+done
+: > $SRC/a/zero
+head -c 3000000 /dev/urandom > $SRC/big
+ln -s a/f1 $SRC/link
+
+for opts in "-m 0" "-m abc" "-m -1" "-s 0" "-s 1x" "-b 0" "-b 10" "-b x" "-b 5k"; do
+	check_reject $opts
+done
+
+# Small members make the large file span many of them, and most
+# members then start in the middle of an entry.
+run_dtar -c -j -b 1 -m 100000 -f $ARCHIVE $SRC
+members=$(grep -c -a -o $'BZh1\x31\x41\x59\x26\x53\x59' $ARCHIVE)
+if [[ $members -lt 30 ]]; then
+	echo "Expected at least 30 bzip2 members, found $members"
+	exit 1
+fi
+
+# tar reads the members as one stream
+rm -rf $OUT
+mkdir -p $OUT
+(cd $OUT && $DTAR_TAR_BIN -xjf $ARCHIVE)
+if [[ $? -ne 0 ]]; then
+	echo "Failed to extract $ARCHIVE with $DTAR_TAR_BIN"
+	exit 1
+fi
+check_tree "tar"
+
+# dtar lists the same entries as tar
+$DTAR_TAR_BIN -tjf $ARCHIVE | sed 's#/$##' | sort > $DTAR_DEST_DIR/tar_list
+run_dtar -t -f $ARCHIVE
+sed 's#/$##' $LOG | sort > $DTAR_DEST_DIR/dtar_list
+diff $DTAR_DEST_DIR/tar_list $DTAR_DEST_DIR/dtar_list
+rc=$?
+rm -f $DTAR_DEST_DIR/tar_list $DTAR_DEST_DIR/dtar_list
+if [[ $rc -ne 0 ]]; then
+	echo "dtar -t and tar -t list different entries"
+	exit 1
+fi
+
+# extract in parallel from the member that holds each header
+extract
+check_tree "index"
+grep -q "Read index" $LOG
+if [[ $? -ne 0 ]]; then
+	cat $LOG
+	echo "Expected dtar to use the index"
+	exit 1
+fi
+
+# extract by scanning the archive, which is serial
+rm -f $ARCHIVE.idx
+extract
+check_tree "scan"
+
+cleanup
+
+exit 0
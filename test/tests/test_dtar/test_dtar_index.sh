@@ -0,0 +1,155 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   A test to check that dtar writes an index next to the archive, uses it
+#   to list and extract entries, also with patterns, and ignores an index
+#   once the archive was modified or replaced by another of the same size.
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+DTAR_TEST_BIN=${DTAR_TEST_BIN:-${1}}
+DTAR_MPIRUN_BIN=${DTAR_MPIRUN_BIN:-${2}}
+DTAR_TAR_BIN=${DTAR_TAR_BIN:-${3}}
+DTAR_SRC_DIR=${DTAR_SRC_DIR:-${4}}
+DTAR_DEST_DIR=${DTAR_DEST_DIR:-${5}}
+
+echo "Using dtar binary at: $DTAR_TEST_BIN"
+echo "Using mpirun binary at: $DTAR_MPIRUN_BIN"
+echo "Using tar binary at: $DTAR_TAR_BIN"
+echo "Using src directory at: $DTAR_SRC_DIR"
+echo "Using dest directory at: $DTAR_DEST_DIR"
+
+# dtar stores absolute paths without the leading slash
+SRC=$DTAR_SRC_DIR/dtar_index
+REL=${SRC#/}
+ARCHIVE=$DTAR_DEST_DIR/dtar_index.tar
+OUT=$DTAR_DEST_DIR/dtar_index_out
+LOG=$DTAR_DEST_DIR/dtar_index.log
+
+cleanup()
+{
+	rm -rf $SRC $OUT
+	rm -f $ARCHIVE $ARCHIVE.idx $ARCHIVE.new $ARCHIVE.new.idx $ARCHIVE.old.idx $LOG
+}
+
+run_dtar()
+{
+	$DTAR_MPIRUN_BIN -np 3 $DTAR_TEST_BIN "$@"
+	if [[ $? -ne 0 ]]; then
+		echo "Failed to run cmd: $DTAR_MPIRUN_BIN -np 3 $DTAR_TEST_BIN $@"
+		exit 1
+	fi
+}
+
+# compare the source tree with the copy extracted under $OUT
+check_tree()
+{
+	diff -r $SRC $OUT/$REL
+	if [[ $? -ne 0 ]]; then
+		echo "Extracted tree differs: $SRC $OUT/$REL ($1)"
+		exit 1
+	fi
+}
+
+# extract the archive with dtar into an empty $OUT, logging to $LOG
+extract()
+{
+	rm -rf $OUT
+	mkdir -p $OUT
+	(cd $OUT && run_dtar -x -v -f $ARCHIVE "$@" > $LOG 2>&1)
+}
+
+# check whether the last extract used the index, yes or no
+check_index_used()
+{
+	grep -q "Read index" $LOG
+	used=$?
+	if [[ $1 == yes && $used -ne 0 ]]; then
+		cat $LOG
+		echo "Index was not used: $ARCHIVE.idx ($2)"
+		exit 1
+	fi
+	if [[ $1 == no && $used -eq 0 ]]; then
+		cat $LOG
+		echo "Index was used although it does not match: $ARCHIVE.idx ($2)"
+		exit 1
+	fi
+}
+
+# check that dtar lists the same entries as tar
+check_list()
+{
+	run_dtar -t -f $ARCHIVE | sed 's#/$##' | sort > $DTAR_DEST_DIR/dtar_list
+	$DTAR_TAR_BIN -tf $ARCHIVE | sed 's#/$##' | sort > $DTAR_DEST_DIR/tar_list
+	diff $DTAR_DEST_DIR/tar_list $DTAR_DEST_DIR/dtar_list
+	if [[ $? -ne 0 ]]; then
+		echo "Listing of $ARCHIVE differs from $DTAR_TAR_BIN ($1)"
+		exit 1
+	fi
+	rm -f $DTAR_DEST_DIR/dtar_list $DTAR_DEST_DIR/tar_list
+}
+
+cleanup
+mkdir -p $DTAR_DEST_DIR
+mkdir -p $SRC/a/b/c $SRC/d/e
+for i in 1 2 3 4 5; do
+	echo "file $i" > $SRC/a/f$i
+	head -c $((i * 1000)) /dev/urandom > $SRC/a/b/f$i
+	head -c $((i * 512)) /dev/urandom > $SRC/d/e/f$i
+done
+head -c 3000000 /dev/urandom > $SRC/d/big
+ln -s ../a/f1 $SRC/d/link
+
+run_dtar -c -f $ARCHIVE $SRC
+if [[ ! -f $ARCHIVE.idx ]]; then
+	echo "Index was not written: $ARCHIVE.idx"
+	exit 1
+fi
+check_list "index"
+
+# extract in parallel using the index
+extract
+check_index_used yes "fresh index"
+check_tree "index"
+
+# extract only the entries under a/b
+extract "$REL/a/b"
+diff -r $SRC/a/b $OUT/$REL/a/b
+if [[ $? -ne 0 || -e $OUT/$REL/d || -e $OUT/$REL/a/f1 ]]; then
+	echo "Extracting pattern $REL/a/b gave the wrong entries"
+	exit 1
+fi
+
+# A modified archive no longer matches its index.
+touch $ARCHIVE
+extract
+check_index_used no "archive touched"
+check_tree "touched"
+
+# Rename a file to a name of the same length and write a new archive
+# of the same size in place of the old one, keeping the old index.
+# The old index would list the old name.
+run_dtar -c -f $ARCHIVE $SRC
+cp $ARCHIVE.idx $ARCHIVE.old.idx
+mv $SRC/a/f1 $SRC/a/g1
+ln -sf ../a/g1 $SRC/d/link
+run_dtar -c -f $ARCHIVE.new $SRC
+if [[ $(stat -c %s $ARCHIVE) -ne $(stat -c %s $ARCHIVE.new) ]]; then
+	echo "Archives were expected to have the same size: $ARCHIVE $ARCHIVE.new"
+	exit 1
+fi
+mv $ARCHIVE.new $ARCHIVE
+cp $ARCHIVE.old.idx $ARCHIVE.idx
+check_list "replaced"
+extract
+check_index_used no "archive replaced"
+check_tree "replaced"
+
+cleanup
+
+exit 0